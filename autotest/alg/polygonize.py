@@ -221,11 +221,61 @@ def polygonize_4():
     else:
         return 'fail'
 
+###############################################################################
+# Test that the single pass and multithreaded algorithms produce the same
+# polygons as the default one, possibly in a different order.
+
+def polygonize_features( src_band, options ):
+
+    mem_drv = ogr.GetDriverByName( 'Memory' )
+    mem_ds = mem_drv.CreateDataSource( 'out' )
+
+    mem_layer = mem_ds.CreateLayer( 'poly', None, ogr.wkbPolygon )
+
+    fd = ogr.FieldDefn( 'DN', ogr.OFTInteger )
+    mem_layer.CreateField( fd )
+
+    gdal.Polygonize( src_band, None, mem_layer, 0, options )
+
+    features = []
+    feat = mem_layer.GetNextFeature()
+    while feat is not None:
+        features.append( '%d %s' % (feat.GetField('DN'),
+                                    feat.GetGeometryRef().ExportToWkt()) )
+        feat.Destroy()
+        feat = mem_layer.GetNextFeature()
+
+    features.sort()
+    return features
+
+def polygonize_5():
+
+    if not gdaltest.have_ng:
+        return 'skip'
+
+    src_ds = gdal.Open('data/polygonize_in_2.grd')
+    src_band = src_ds.GetRasterBand(1)
+
+    for connectedness in [ [], ['8CONNECTED=8'] ]:
+        ref = polygonize_features( src_band, connectedness )
+        if len(ref) == 0:
+            gdaltest.post_reason( 'got no feature' )
+            return 'fail'
+
+        for options in [ ['STREAMING=YES'], ['NUM_THREADS=2'] ]:
+            got = polygonize_features( src_band, connectedness + options )
+            if got != ref:
+                gdaltest.post_reason( 'got different polygons with %s' % str(connectedness + options) )
+                return 'fail'
+
+    return 'success'
+
 gdaltest_list = [
     polygonize_1,
     polygonize_2,
     polygonize_3,
-    polygonize_4
+    polygonize_4,
+    polygonize_5
     ]
 
 if __name__ == '__main__':
@@ -30,6 +30,7 @@
 
 import os
 import sys
+import struct
 
 sys.path.append( '../pymod' )
 
@@ -121,9 +122,86 @@ def proximity_2():
     else:
         return 'success' 
 
+###############################################################################
+# Test the exact distance transform, with the options of proximity_2 and
+# with several threads. On this small image it gives the same results as
+# the default algorithm.
+
+def proximity_3():
+
+    if gdaltest.have_ng == 0:
+        return 'skip'
+
+    drv = gdal.GetDriverByName( 'GTiff' )
+    src_ds = gdal.Open('data/pat.tif')
+    src_band = src_ds.GetRasterBand(1)
+
+    dst_ds = drv.Create('tmp/proximity_3.tif', 25, 25, 1, gdal.GDT_Float32 )
+    dst_band = dst_ds.GetRasterBand(1)
+
+    gdal.ComputeProximity( src_band, dst_band,
+                           options = [ 'ALGORITHM=EXACT',
+                                       'VALUES=65,64',
+                                       'MAXDIST=12',
+                                       'NODATA=-1',
+                                       'FIXED_BUF_VAL=255' ] )
+
+    cs = dst_band.Checksum()
+    if cs != 3256:
+        print('Got: ', cs)
+        gdaltest.post_reason( 'got wrong checksum' )
+        return 'fail'
+
+    dst_ds = drv.Create('tmp/proximity_3.tif', 25, 25, 1, gdal.GDT_Byte )
+    dst_band = dst_ds.GetRasterBand(1)
+
+    gdal.ComputeProximity( src_band, dst_band,
+                           options = [ 'ALGORITHM=EXACT',
+                                       'NUM_THREADS=3' ] )
+
+    cs = dst_band.Checksum()
+
+    dst_band = None
+    dst_ds = None
+
+    drv.Delete( 'tmp/proximity_3.tif' )
+
+    if cs != 1941:
+        print('Got: ', cs)
+        gdaltest.post_reason( 'got wrong checksum' )
+        return 'fail'
+
+    # A pixel whose nearest target is not the nearest target of any of
+    # its neighbours : propagation gets 3 instead of sqrt(8).
+    mem_drv = gdal.GetDriverByName( 'MEM' )
+    src_ds = mem_drv.Create( '', 12, 12, 1, gdal.GDT_Byte )
+    src_band = src_ds.GetRasterBand(1)
+    for (x, y) in [ (10, 7), (3, 8), (7, 8), (6, 10) ]:
+        src_band.WriteRaster( x, y, 1, 1, struct.pack('B', 1) )
+
+    for options in [ [], [ 'ALGORITHM=EXACT' ],
+                     [ 'ALGORITHM=EXACT', 'NUM_THREADS=3' ] ]:
+        dst_ds = mem_drv.Create( '', 12, 12, 1, gdal.GDT_Float32 )
+        dst_band = dst_ds.GetRasterBand(1)
+        gdal.ComputeProximity( src_band, dst_band, options = options )
+
+        val = struct.unpack( 'f', dst_band.ReadRaster( 9, 10, 1, 1 ) )[0]
+        if len(options) == 0:
+            expected = 3.0
+        else:
+            expected = 8 ** 0.5
+        if abs(val - expected) > 1e-5:
+            print(options)
+            print('Got: ', val)
+            gdaltest.post_reason( 'got wrong distance' )
+            return 'fail'
+
+    return 'success'
+
 gdaltest_list = [
     proximity_1,
-    proximity_2
+    proximity_2,
+    proximity_3
     ]
 
 if __name__ == '__main__':
@@ -224,12 +224,52 @@ def sieve_5():
     else:
         return 'success' 
 
+###############################################################################
+# Check that the multi-threaded strip processing gives the same result as
+# the default processing.
+
+def sieve_6():
+
+    try:
+        x = gdal.SieveFilter
+    except:
+        return 'skip'
+
+    drv = gdal.GetDriverByName( 'MEM' )
+
+    for filename in ['data/sieve_src.grd', 'data/unmergable.grd',
+                     'data/sieve_2634.grd']:
+        for connectedness in [4, 8]:
+            src_ds = gdal.Open(filename)
+            src_band = src_ds.GetRasterBand(1)
+
+            cs = []
+            for options in [ [], ['NUM_THREADS=3'],
+                             ['NUM_THREADS=2', 'WORKING_MEMORY=0.0001'] ]:
+                dst_ds = drv.Create('', src_ds.RasterXSize, 
+                                    src_ds.RasterYSize, 1, gdal.GDT_Byte )
+                dst_band = dst_ds.GetRasterBand(1)
+
+                gdal.SieveFilter( src_band, None, dst_band, 2, connectedness,
+                                  options )
+
+                cs.append( dst_band.Checksum() )
+                dst_ds = None
+
+            if cs[1] != cs[0] or cs[2] != cs[0]:
+                print(filename, connectedness, cs)
+                gdaltest.post_reason( 'got different checksums' )
+                return 'fail'
+
+    return 'success' 
+
 gdaltest_list = [
     sieve_1,
     sieve_2,
     sieve_3,
     sieve_4,
-    sieve_5
+    sieve_5,
+    sieve_6
     ]
 
 if __name__ == '__main__':
@@ -30,6 +30,7 @@
 #include <string>
 #include <fstream>
 #include "cpl_list.h"
+#include "cpl_multiproc.h"
 #include "cpl_hash_set.h"
 #include "cpl_string.h"
 
@@ -659,5 +660,98 @@ namespace tut
         ensure( "9g", EQUAL(oNVL.FetchNameValue("D"),"DD") );
     }
 
+    // Jobs counting how many of them run at the same time
+    static void* job_mutex = NULL;
+    static int running_jobs = 0;
+    static int max_running_jobs = 0;
+
+    static CPLErr count_job(void* data)
+    {
+        CPLAcquireMutex(job_mutex, 1000.0);
+        running_jobs++;
+        if (running_jobs > max_running_jobs)
+            max_running_jobs = running_jobs;
+        CPLReleaseMutex(job_mutex);
+
+        CPLSleep(0.02);
+
+        CPLAcquireMutex(job_mutex, 1000.0);
+        running_jobs--;
+        CPLReleaseMutex(job_mutex);
+
+        return *((CPLErr*) data);
+    }
+
+    // Test CPLRunJobs(): all the jobs are run, the worst error is
+    // returned, and GDAL_NUM_THREADS limits the number of threads
+    template<>
+    template<>
+    void object::test<10>()
+    {
+        const int job_count = 8;
+        CPLErr errors[job_count];
+        void* data[job_count];
+
+        for (int i = 0; i < job_count; i++)
+        {
+            errors[i] = (3 == i) ? CE_Warning : CE_None;
+            data[i] = errors + i;
+        }
+
+        job_mutex = CPLCreateMutex();
+        CPLReleaseMutex(job_mutex);
+
+        max_running_jobs = 0;
+        CPLErr err = CPLRunJobs(count_job, data, job_count);
+        int max_unlimited = max_running_jobs;
+
+        CPLSetConfigOption("GDAL_NUM_THREADS", "2");
+        max_running_jobs = 0;
+        CPLErr limited_err = CPLRunJobs(count_job, data, job_count);
+        int max_limited = max_running_jobs;
+        CPLSetConfigOption("GDAL_NUM_THREADS", NULL);
+
+        CPLDestroyMutex(job_mutex);
+        job_mutex = NULL;
+
+        ensure_equals("Wrong error", err, CE_Warning);
+        ensure_equals("Wrong error with GDAL_NUM_THREADS", limited_err,
+                      CE_Warning);
+        ensure("Jobs not run concurrently", max_unlimited > 1);
+        ensure("GDAL_NUM_THREADS ignored", max_limited <= 2);
+    }
+
+    // Try to take a mutex held by the main thread, without waiting
+    static void try_mutex(void* data)
+    {
+        void** args = (void**) data;
+        *((int*) args[1]) = CPLAcquireMutex(args[0], 0.0);
+        if (*((int*) args[1]))
+            CPLReleaseMutex(args[0]);
+    }
+
+    // Test CPLAcquireMutex() with a 0.0 timeout, which does not wait
+    template<>
+    template<>
+    void object::test<11>()
+    {
+        void* mutex = CPLCreateMutex();
+        int acquired = -1;
+        void* args[2] = { mutex, &acquired };
+
+        CPLJoinableThread* thread = CPLCreateJoinableThread(try_mutex, args);
+        ensure("Can't create thread", NULL != thread);
+        CPLJoinThread(thread);
+        int acquired_held = acquired;
+        CPLReleaseMutex(mutex);
+
+        thread = CPLCreateJoinableThread(try_mutex, args);
+        CPLJoinThread(thread);
+        CPLDestroyMutex(mutex);
+
+        ensure("Mutex held by another thread acquired", 0 == acquired_held);
+        ensure("Free mutex not acquired", 1 == acquired);
+    }
+
 } // namespace tut
 
@@ -32,7 +32,13 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include <tut.h>
 #include <gdal.h>
+#include <gdal_alg.h>
 #include <gdal_priv.h>
+#include <vrtdataset.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <math.h>
+#include <string.h>
 #include <string>
 
 namespace tut
@@ -127,4 +133,1039 @@ namespace tut
 #endif
     }
 
+    // Compute block checksums of a band and return the manifest
+    static char** compute_manifest(GDALRasterBandH band, const char* option,
+                                   int threads)
+    {
+        char** options = NULL;
+        char** manifest = NULL;
+
+        if (NULL != option)
+            options = CSLAddString(options, option);
+        options = CSLSetNameValue(options, "NUM_THREADS",
+                                  CPLSPrintf("%d", threads));
+
+        CPLErr err = GDALComputeBlockChecksums(band, options, &manifest,
+                                               NULL, NULL);
+        CSLDestroy(options);
+        ensure_equals("GDALComputeBlockChecksums() failed", err, CE_None);
+
+        return manifest;
+    }
+
+    // Test GDALComputeBlockChecksums() and GDALCompareBlockChecksums()
+    template<>
+    template<>
+    void object::test<6>()
+    {
+        const int xsize = 300;
+        const int ysize = 200;
+        const int block_size = 64;
+        const char* filename = "/vsimem/test_gdal_checksums.tif";
+        const char* create_options[] = { "TILED=YES", "BLOCKXSIZE=64",
+                                         "BLOCKYSIZE=64", NULL };
+        GInt16 line[xsize];
+
+        GDALDatasetH ds = GDALCreate(GDALGetDriverByName("GTiff"), filename,
+                                     xsize, ysize, 1, GDT_Int16,
+                                     (char**) create_options);
+        ensure("Can't create dataset", NULL != ds);
+        GDALRasterBandH band = GDALGetRasterBand(ds, 1);
+
+        for (int y = 0; y < ysize; y++)
+        {
+            for (int x = 0; x < xsize; x++)
+                line[x] = (GInt16) ((x * 13 + y * 7) % 1000 - 500);
+            GDALRasterIO(band, GF_Write, 0, y, xsize, 1, line, xsize, 1,
+                         GDT_Int16, 0, 0);
+        }
+
+        // The manifest layout, and the same hashes whatever the number
+        // of threads
+        char** manifest = compute_manifest(band, NULL, 1);
+        char** threaded = compute_manifest(band, NULL, 4);
+        int changed_count = -1;
+
+        ensure("Wrong manifest layout",
+               EQUAL(CSLFetchNameValueDef(manifest, "BLOCK_XSIZE", ""), "64")
+               && EQUAL(CSLFetchNameValueDef(manifest, "RASTER_YSIZE", ""),
+                        "200")
+               && NULL != CSLFetchNameValue(manifest, "ROW_3")
+               && NULL == CSLFetchNameValue(manifest, "ROW_4"));
+
+        int same = GDALCompareBlockChecksums(manifest, threaded,
+                                             &changed_count, NULL);
+        CSLDestroy(threaded);
+        ensure("Hashes depend on the number of threads",
+               same && 0 == changed_count);
+
+        // The manifest is only saved as metadata when asked to
+        ensure("Manifest stored without STORE=YES",
+               NULL == GDALGetMetadata(band, "BLOCK_CHECKSUMS"));
+
+        CSLDestroy(compute_manifest(band, "STORE=YES", 1));
+        ensure("Manifest not stored with STORE=YES",
+               GDALCompareBlockChecksums(manifest,
+                                         GDALGetMetadata(band,
+                                                         "BLOCK_CHECKSUMS"),
+                                         &changed_count, NULL)
+               && 0 == changed_count);
+
+        // Change one pixel and find its block
+        GInt16 value = 12345;
+        int* changed = NULL;
+
+        GDALRasterIO(band, GF_Write, 2 * block_size + 5, block_size + 7, 1, 1,
+                     &value, 1, 1, GDT_Int16, 0, 0);
+
+        char** modified = compute_manifest(band, NULL, 3);
+        same = GDALCompareBlockChecksums(manifest, modified,
+                                         &changed_count, &changed);
+        int right_block = (same && 1 == changed_count
+                           && 2 == changed[0] && 1 == changed[1]);
+        CPLFree(changed);
+        CSLDestroy(modified);
+        ensure("Wrong changed blocks", right_block);
+
+        // Manifests with different block sizes can not be compared
+        char** other = compute_manifest(band, "BLOCK_YSIZE=32", 1);
+        same = GDALCompareBlockChecksums(manifest, other,
+                                         &changed_count, NULL);
+        CSLDestroy(other);
+        ensure("Manifests of different block sizes compared", !same);
+
+        CSLDestroy(manifest);
+        GDALClose(ds);
+        GDALDeleteDataset(NULL, filename);
+    }
+
+    // Create a summary test dataset: two Float32 bands, the first one
+    // with a few nodata pixels, and a Byte band
+    const int summary_xsize = 300;
+    const int summary_ysize = 200;
+    const double summary_nodata = -9999.0;
+
+    static int is_summary_nodata(int band, int x, int y)
+    {
+        return 1 == band && 0 == (x + y) % 37;
+    }
+
+    static GDALDatasetH create_summary_dataset(const char* filename)
+    {
+        const char* create_options[] = { "INTERLEAVE=PIXEL", "TILED=YES",
+                                         "BLOCKXSIZE=64", "BLOCKYSIZE=64",
+                                         NULL };
+        GDALDatasetH ds = GDALCreate(GDALGetDriverByName("GTiff"), filename,
+                                     summary_xsize, summary_ysize, 3,
+                                     GDT_Float32, (char**) create_options);
+        ensure("Can't create dataset", NULL != ds);
+
+        float line[summary_xsize];
+
+        GDALSetRasterNoDataValue(GDALGetRasterBand(ds, 1), summary_nodata);
+        for (int band = 1; band <= 3; band++)
+        {
+            for (int y = 0; y < summary_ysize; y++)
+            {
+                for (int x = 0; x < summary_xsize; x++)
+                {
+                    if (3 == band)
+                        line[x] = (float) ((x * 7 + y * 3) % 256);
+                    else if (is_summary_nodata(band, x, y))
+                        line[x] = (float) summary_nodata;
+                    else
+                        line[x] = (float) (band * 100 * sin(x / 30.0)
+                                           * cos(y / 20.0));
+                }
+                GDALRasterIO(GDALGetRasterBand(ds, band), GF_Write,
+                             0, y, summary_xsize, 1, line, summary_xsize, 1,
+                             GDT_Float32, 0, 0);
+            }
+        }
+
+        return ds;
+    }
+
+    // Test GDALDatasetComputeRasterSummary() against the usual statistics,
+    // histogram and checksum functions
+    template<>
+    template<>
+    void object::test<7>()
+    {
+        const char* filename = "/vsimem/test_gdal_summary.tif";
+
+        GDALClose(create_summary_dataset(filename));
+        GDALDatasetH ds = GDALOpen(filename, GA_ReadOnly);
+        ensure("Can't open dataset", NULL != ds);
+
+        ensure_equals("ComputeRasterSummary() failed",
+                      GDALDatasetComputeRasterSummary(ds, 0, NULL, NULL,
+                                                      NULL, NULL), CE_None);
+
+        for (int band = 1; band <= 3; band++)
+        {
+            GDALRasterBandH hband = GDALGetRasterBand(ds, band);
+            double min, max, mean, stddev;
+            double ref_min, ref_max, ref_mean, ref_stddev;
+
+            ensure_equals("No statistics saved",
+                          GDALGetRasterStatistics(hband, FALSE, FALSE,
+                                                  &min, &max, &mean, &stddev),
+                          CE_None);
+
+            const char* checksum =
+                GDALGetMetadataItem(hband, "STATISTICS_CHECKSUM", NULL);
+            ensure("No checksum saved", NULL != checksum);
+            ensure_equals("Wrong checksum", atoi(checksum),
+                          GDALChecksumImage(hband, 0, 0,
+                                            summary_xsize, summary_ysize));
+
+            int expected_count = 0;
+            for (int y = 0; y < summary_ysize; y++)
+                for (int x = 0; x < summary_xsize; x++)
+                    if (!is_summary_nodata(band, x, y))
+                        expected_count++;
+
+            const char* valid_count =
+                GDALGetMetadataItem(hband, "STATISTICS_VALID_COUNT", NULL);
+            ensure("No valid count saved", NULL != valid_count);
+            ensure_equals("Wrong valid count", atoi(valid_count),
+                          expected_count);
+
+            int buckets = 0;
+            int* histogram = NULL;
+            int ref_histogram[256];
+            CPLErr err = GDALGetDefaultHistogram(hband, &ref_min, &ref_max,
+                                                 &buckets, &histogram, FALSE,
+                                                 NULL, NULL);
+            int same = FALSE;
+            if (CE_None == err && 256 == buckets)
+            {
+                GDALGetRasterHistogram(hband, ref_min, ref_max, 256,
+                                       ref_histogram, TRUE, FALSE,
+                                       NULL, NULL);
+                same = (0 == memcmp(histogram, ref_histogram,
+                                    sizeof(ref_histogram)));
+            }
+            CPLFree(histogram);
+            ensure("No histogram saved", CE_None == err && 256 == buckets);
+            ensure("Wrong histogram", same);
+
+            // The saved statistics are rounded
+            GDALComputeRasterStatistics(hband, FALSE, &ref_min, &ref_max,
+                                        &ref_mean, &ref_stddev, NULL, NULL);
+            ensure("Wrong statistics",
+                   fabs(min - ref_min) < 1e-6 && fabs(max - ref_max) < 1e-6
+                   && fabs(mean - ref_mean) < 1e-6
+                   && fabs(stddev - ref_stddev) < 1e-6);
+        }
+
+        GDALClose(ds);
+        GDALDeleteDataset(NULL, filename);
+    }
+
+    // Test that GDALDatasetComputeRasterSummary() with STATISTICS=NO does
+    // not leave the approximate statistics used for the histogram bounds
+    template<>
+    template<>
+    void object::test<8>()
+    {
+        const char* filename = "/vsimem/test_gdal_summary_nostats.tif";
+
+        GDALClose(create_summary_dataset(filename));
+        GDALDatasetH ds = GDALOpen(filename, GA_ReadOnly);
+        ensure("Can't open dataset", NULL != ds);
+
+        char** options = NULL;
+        options = CSLSetNameValue(options, "STATISTICS", "NO");
+        options = CSLSetNameValue(options, "HISTOGRAM_BUCKETS", "16");
+        CPLErr err = GDALDatasetComputeRasterSummary(ds, 0, NULL, options,
+                                                     NULL, NULL);
+        CSLDestroy(options);
+        ensure_equals("ComputeRasterSummary(STATISTICS=NO) failed",
+                      err, CE_None);
+
+        for (int band = 1; band <= 3; band++)
+        {
+            GDALRasterBandH hband = GDALGetRasterBand(ds, band);
+            double min, max;
+            int buckets = 0;
+            int* histogram = NULL;
+
+            ensure("Statistics saved with STATISTICS=NO",
+                   NULL == GDALGetMetadataItem(hband, "STATISTICS_MINIMUM",
+                                               NULL)
+                   && NULL == GDALGetMetadataItem(hband, "STATISTICS_MEAN",
+                                                  NULL));
+
+            err = GDALGetDefaultHistogram(hband, &min, &max, &buckets,
+                                          &histogram, FALSE, NULL, NULL);
+            CPLFree(histogram);
+            ensure("No histogram saved with STATISTICS=NO",
+                   CE_None == err && 16 == buckets && min < max);
+        }
+
+        GDALClose(ds);
+        GDALDeleteDataset(NULL, filename);
+    }
+
+    // Band of 16 line blocks computed on the fly, for the swath copy
+    // tests.  Reading the block row failing_row fails.
+    const int swath_xsize = 1024;
+    const int swath_ysize = 2048;
+    const int swath_block_lines = 16;
+    const int swath_bands = 3;
+    const int swath_failing_row = 100;
+
+    static GByte swath_pixel(int band, int x, int y)
+    {
+        return (GByte) ((band * 50 + x * 3 + y * 7) % 256);
+    }
+
+    class SwathPatternBand : public GDALRasterBand
+    {
+        int failing_row_;
+
+    public:
+        SwathPatternBand(GDALDataset* ds, int band, int failing_row)
+        {
+            poDS = ds;
+            nBand = band;
+            nRasterXSize = swath_xsize;
+            nRasterYSize = swath_ysize;
+            nBlockXSize = swath_xsize;
+            nBlockYSize = swath_block_lines;
+            eDataType = GDT_Byte;
+            failing_row_ = failing_row;
+        }
+
+        virtual CPLErr IReadBlock(int, int y_block, void* data)
+        {
+            if (y_block == failing_row_)
+            {
+                CPLError(CE_Failure, CPLE_FileIO,
+                         "Cannot read block row %d.", y_block);
+                return CE_Failure;
+            }
+
+            for (int y = 0; y < swath_block_lines; y++)
+                for (int x = 0; x < swath_xsize; x++)
+                    ((GByte*) data)[y * swath_xsize + x] =
+                        swath_pixel(nBand, x, y_block * swath_block_lines + y);
+            return CE_None;
+        }
+    };
+
+    class SwathPatternDataset : public GDALDataset
+    {
+    public:
+        SwathPatternDataset(int failing_row)
+        {
+            nRasterXSize = swath_xsize;
+            nRasterYSize = swath_ysize;
+            for (int i = 1; i <= swath_bands; i++)
+                SetBand(i, new SwathPatternBand(this, i, failing_row));
+        }
+    };
+
+    static double swath_progress = 0.0;
+    static double swath_progress_at_error = -1.0;
+    static int swath_errors = 0;
+
+    static int CPL_STDCALL swath_count_progress(double complete, const char*,
+                                                void*)
+    {
+        swath_progress = complete;
+        return TRUE;
+    }
+
+    static void CPL_STDCALL swath_count_errors(CPLErr err_class, int,
+                                               const char*)
+    {
+        // Handlers are per thread, so only the errors reported by the
+        // calling thread get here
+        if (CE_Failure == err_class)
+        {
+            swath_errors++;
+            swath_progress_at_error = swath_progress;
+        }
+    }
+
+    // Copy a pattern dataset into a MEM one, by swaths of 1 MB
+    static CPLErr swath_copy(int failing_row, GDALDataset** dst_ds)
+    {
+        SwathPatternDataset src_ds(failing_row);
+        GDALDataset* ds = (GDALDataset*)
+            GDALCreate(GDALGetDriverByName("MEM"), "", swath_xsize,
+                       swath_ysize, swath_bands, GDT_Byte, NULL);
+        char** options = CSLSetNameValue(NULL, "INTERLEAVE", "PIXEL");
+
+        swath_progress = 0.0;
+        swath_progress_at_error = -1.0;
+        swath_errors = 0;
+
+        // The smallest swaths
+        CPLSetConfigOption("GDAL_SWATH_SIZE", "1000000");
+        CPLPushErrorHandler(swath_count_errors);
+        CPLErr err = GDALDatasetCopyWholeRaster((GDALDatasetH) &src_ds,
+                                                (GDALDatasetH) ds, options,
+                                                swath_count_progress, NULL);
+        CPLPopErrorHandler();
+        CPLSetConfigOption("GDAL_SWATH_SIZE", NULL);
+        CSLDestroy(options);
+
+        *dst_ds = ds;
+        return err;
+    }
+
+    // Test GDALDatasetCopyWholeRaster() with the given number of swath
+    // buffers (GDAL_SWATH_BUFFERS) and prefetch setting (GDAL_PREFETCH)
+    static void test_swath_copy(const char* buffers, const char* prefetch)
+    {
+        GDALDataset* ds = NULL;
+
+        CPLSetConfigOption("GDAL_SWATH_BUFFERS", buffers);
+        CPLSetConfigOption("GDAL_PREFETCH", prefetch);
+
+        // A successful copy has all the pixels
+        CPLErr err = swath_copy(-1, &ds);
+        int same = TRUE;
+        GByte line[swath_xsize];
+        for (int band = 1; band <= swath_bands && same; band++)
+        {
+            for (int y = 0; y < swath_ysize && same; y++)
+            {
+                ds->GetRasterBand(band)->RasterIO(GF_Read, 0, y,
+                                                  swath_xsize, 1, line,
+                                                  swath_xsize, 1, GDT_Byte,
+                                                  0, 0);
+                for (int x = 0; x < swath_xsize; x++)
+                    if (line[x] != swath_pixel(band, x, y))
+                        same = FALSE;
+            }
+        }
+        delete ds;
+
+        // A read error is reported by the calling thread, once the
+        // swaths before the failing one are written, and stops the copy.
+        // With 320 line swaths, the failing block starts the sixth one.
+        double expected = (double) (swath_failing_row * swath_block_lines)
+            / swath_ysize;
+        CPLErr fail_err = swath_copy(swath_failing_row, &ds);
+        delete ds;
+
+        CPLSetConfigOption("GDAL_SWATH_BUFFERS", NULL);
+        CPLSetConfigOption("GDAL_PREFETCH", NULL);
+
+        ensure_equals("Copy failed", err, CE_None);
+        ensure("Wrong pixels", same);
+        ensure_equals("Read error ignored", fail_err, CE_Failure);
+        ensure("Read error not reported", swath_errors > 0);
+        ensure("Read error reported at the wrong swath",
+               fabs(swath_progress_at_error - expected) < 1e-6
+               && swath_progress == swath_progress_at_error);
+    }
+
+    // Test GDALDatasetCopyWholeRaster() without the swath reader thread
+    template<>
+    template<>
+    void object::test<9>()
+    {
+        test_swath_copy("1", NULL);
+    }
+
+    // Test GDALDatasetCopyWholeRaster() with the swath reader thread
+    template<>
+    template<>
+    void object::test<10>()
+    {
+        test_swath_copy("3", NULL);
+    }
+
+    // Test the write-behind of dirty blocks: write a raster several times
+    // as large as the cache, line by line, so that the dirty blocks go
+    // above the high water mark
+    template<>
+    template<>
+    void object::test<11>()
+    {
+        const int xsize = 1500;
+        const int ysize = 1500;
+        const int bands = 2;
+        const char* filename = "/vsimem/test_gdal_write_behind.tif";
+        const char* create_options[] = { "TILED=YES", "BLOCKXSIZE=256",
+                                         "BLOCKYSIZE=256", NULL };
+        GInt16 line[xsize];
+        GIntBig cache_max = GDALGetCacheMax64();
+
+        // A row of tiles of both bands is 1.5 MB
+        GDALSetCacheMax64(2 * 1024 * 1024);
+        GDALResetCacheStatistics();
+
+        // Checked when the dataset is created
+        CPLSetConfigOption("GDAL_CACHE_WRITE_BEHIND", "YES");
+        GDALDatasetH ds = GDALCreate(GDALGetDriverByName("GTiff"), filename,
+                                     xsize, ysize, bands, GDT_Int16,
+                                     (char**) create_options);
+        CPLSetConfigOption("GDAL_CACHE_WRITE_BEHIND", NULL);
+        ensure("Can't create dataset", NULL != ds);
+
+        for (int y = 0; y < ysize; y++)
+        {
+            for (int band = 1; band <= bands; band++)
+            {
+                for (int x = 0; x < xsize; x++)
+                    line[x] = (GInt16) ((x * 7 + y * 13 + band * 1000) % 30000);
+                GDALRasterIO(GDALGetRasterBand(ds, band), GF_Write,
+                             0, y, xsize, 1, line, xsize, 1, GDT_Int16, 0, 0);
+            }
+        }
+
+        char** stats = GDALGetCacheStatistics();
+        int flushes = atoi(CSLFetchNameValueDef(stats, "WRITE_BEHIND_FLUSHES",
+                                                "0"));
+        CSLDestroy(stats);
+        GDALClose(ds);
+
+        // All the blocks, whoever wrote them, must have the right pixels
+        int same = TRUE;
+
+        ds = GDALOpen(filename, GA_ReadOnly);
+        for (int band = 1; band <= bands && same; band++)
+        {
+            for (int y = 0; y < ysize && same; y++)
+            {
+                GDALRasterIO(GDALGetRasterBand(ds, band), GF_Read,
+                             0, y, xsize, 1, line, xsize, 1, GDT_Int16, 0, 0);
+                for (int x = 0; x < xsize; x++)
+                    if (line[x] != (GInt16) ((x * 7 + y * 13 + band * 1000)
+                                             % 30000))
+                        same = FALSE;
+            }
+        }
+        GDALClose(ds);
+        GDALDeleteDataset(NULL, filename);
+        GDALSetCacheMax64(cache_max);
+
+        ensure("No block written by the background writer", flushes > 0);
+        ensure("Wrong pixels with write-behind", same);
+    }
+
+    // Band of 256x256 blocks computed on the fly, that can tell whether a
+    // block is cached, for the cache priority tests
+    const int tile_size = 256;
+    const int tile_blocks = 8;
+
+    class TileBand : public GDALRasterBand
+    {
+    public:
+        TileBand(GDALDataset* ds)
+        {
+            poDS = ds;
+            nBand = 1;
+            nRasterXSize = nRasterYSize = tile_size * tile_blocks;
+            nBlockXSize = nBlockYSize = tile_size;
+            eDataType = GDT_Byte;
+        }
+
+        virtual CPLErr IReadBlock(int x_block, int y_block, void* data)
+        {
+            memset(data, x_block + y_block, tile_size * tile_size);
+            return CE_None;
+        }
+
+        void read_row(int y_block)
+        {
+            for (int x_block = 0; x_block < tile_blocks; x_block++)
+            {
+                GDALRasterBlock* block = GetLockedBlockRef(x_block, y_block);
+                if (NULL != block)
+                    block->DropLock();
+            }
+        }
+
+        int is_row_cached(int y_block)
+        {
+            for (int x_block = 0; x_block < tile_blocks; x_block++)
+            {
+                GDALRasterBlock* block =
+                    TryGetLockedBlockRef(x_block, y_block);
+                if (NULL == block)
+                    return FALSE;
+                block->DropLock();
+            }
+            return TRUE;
+        }
+    };
+
+    // Tile band always allocated at the same address, as a band allocated
+    // where a destroyed one was
+    class ReusedTileBand : public TileBand
+    {
+    public:
+        ReusedTileBand(GDALDataset* ds) : TileBand(ds) {}
+
+        static void* operator new(size_t)
+        {
+            static double storage[sizeof(ReusedTileBand) / sizeof(double)
+                                  + 1];
+            return storage;
+        }
+
+        static void operator delete(void*) {}
+    };
+
+    class TileDataset : public GDALDataset
+    {
+    public:
+        TileDataset(int reused_band = FALSE)
+        {
+            nRasterXSize = nRasterYSize = tile_size * tile_blocks;
+            if (reused_band)
+                SetBand(1, new ReusedTileBand(this));
+            else
+                SetBand(1, new TileBand(this));
+        }
+
+        TileBand* tile_band()
+        {
+            return (TileBand*) GetRasterBand(1);
+        }
+
+        void read_all()
+        {
+            for (int y_block = 0; y_block < tile_blocks; y_block++)
+                tile_band()->read_row(y_block);
+        }
+
+        GIntBig cache_used()
+        {
+            char** stats = GetCacheStatistics();
+            GIntBig used = (GIntBig)
+                atof(CSLFetchNameValueDef(stats, "CACHE_USED", "-1"));
+            CSLDestroy(stats);
+            return used;
+        }
+    };
+
+    // Test the cache priorities and quotas: scanning datasets twice as
+    // large as the cache must evict the blocks of the lower priority
+    // classes first, and a dataset with a quota must evict its own blocks
+    template<>
+    template<>
+    void object::test<12>()
+    {
+        GIntBig cache_max = GDALGetCacheMax64();
+
+        // 32 blocks in the cache
+        GDALSetCacheMax64(2 * 1024 * 1024);
+
+        TileDataset pinned_ds, normal_ds, streaming_ds, quota_ds;
+        GIntBig new_cache_max = GDALGetCacheMax64();
+        GIntBig quota = 4 * tile_size * tile_size;
+
+        pinned_ds.SetCachePriority(GBP_Pinned);
+        streaming_ds.SetCachePriority(GBP_Streaming);
+        quota_ds.SetCacheQuota(quota);
+
+        pinned_ds.tile_band()->read_row(0);
+        normal_ds.tile_band()->read_row(0);
+
+        // Streaming blocks go before the older normal ones
+        streaming_ds.read_all();
+
+        int normal_kept = normal_ds.tile_band()->is_row_cached(0);
+        int pinned_kept = pinned_ds.tile_band()->is_row_cached(0);
+
+        // Normal blocks go before the pinned ones, and the streaming
+        // blocks are kept under their reserve
+        normal_ds.read_all();
+
+        int pinned_kept_normal = pinned_ds.tile_band()->is_row_cached(0);
+        GIntBig streaming_used = streaming_ds.cache_used();
+
+        // A dataset above its quota evicts its own blocks, even if the
+        // others are older or have a lower priority
+        quota_ds.read_all();
+
+        GIntBig quota_used = quota_ds.cache_used();
+        GIntBig streaming_used_quota = streaming_ds.cache_used();
+        int pinned_kept_quota = pinned_ds.tile_band()->is_row_cached(0);
+
+        pinned_ds.FlushCache();
+        normal_ds.FlushCache();
+        streaming_ds.FlushCache();
+        quota_ds.FlushCache();
+        GDALSetCacheMax64(cache_max);
+
+        ensure("Normal blocks evicted before streaming ones", normal_kept);
+        ensure("Pinned blocks evicted before streaming ones", pinned_kept);
+        ensure("Pinned blocks evicted before normal ones",
+               pinned_kept_normal);
+        ensure("Streaming blocks above their reserve",
+               streaming_used <= new_cache_max / 10);
+        ensure("Dataset above its quota", quota_used <= quota);
+        ensure("Blocks of other datasets evicted for a quota",
+               streaming_used_quota == streaming_used);
+        ensure("Pinned blocks evicted for a quota", pinned_kept_quota);
+    }
+
+    // Band of 16 line blocks that are slow to read, and that counts the
+    // reads, and the concurrent ones, for the prefetch tests
+    const int slow_block_lines = 16;
+    const int slow_blocks = 8;
+
+    class SlowBand : public GDALRasterBand
+    {
+    public:
+        volatile int reads_;
+        volatile int concurrent_reads_;
+        volatile int reading_;
+
+        SlowBand(GDALDataset* ds)
+        {
+            poDS = ds;
+            nBand = 1;
+            nRasterXSize = 64;
+            nRasterYSize = slow_block_lines * slow_blocks;
+            nBlockXSize = 64;
+            nBlockYSize = slow_block_lines;
+            eDataType = GDT_Byte;
+            reads_ = 0;
+            concurrent_reads_ = 0;
+            reading_ = FALSE;
+        }
+
+        virtual CPLErr IReadBlock(int, int y_block, void* data)
+        {
+            if (reading_)
+                concurrent_reads_++;
+            reading_ = TRUE;
+            reads_++;
+
+            CPLSleep(0.05);
+            memset(data, y_block + 1, nBlockXSize * nBlockYSize);
+
+            reading_ = FALSE;
+            return CE_None;
+        }
+    };
+
+    class SlowDataset : public GDALDataset
+    {
+    public:
+        SlowDataset()
+        {
+            nRasterXSize = 64;
+            nRasterYSize = slow_block_lines * slow_blocks;
+            SetBand(1, new SlowBand(this));
+        }
+    };
+
+    // Test GDALDataset::StartPrefetch(): blocks requested while the
+    // prefetch is loading them must be read once, completely, and never
+    // concurrently
+    template<>
+    template<>
+    void object::test<13>()
+    {
+        SlowDataset ds;
+        SlowBand* band = (SlowBand*) ds.GetRasterBand(1);
+
+        ensure("Prefetch started by default",
+               !ds.StartPrefetch(0, 0, ds.GetRasterXSize(),
+                                 ds.GetRasterYSize(), 1, NULL));
+
+        CPLSetConfigOption("GDAL_PREFETCH", "YES");
+        int started = ds.StartPrefetch(0, 0, ds.GetRasterXSize(),
+                                       ds.GetRasterYSize(), 1, NULL);
+        CPLSetConfigOption("GDAL_PREFETCH", NULL);
+        ensure("Prefetch not started", started);
+
+        // The first block is being loaded, the last one is not yet
+        CPLSleep(0.01);
+        int y_blocks[] = { 0, slow_blocks - 1 };
+        int same = TRUE;
+
+        for (int i = 0; i < 2; i++)
+        {
+            GDALRasterBlock* block = band->GetLockedBlockRef(0, y_blocks[i]);
+            if (NULL == block)
+            {
+                same = FALSE;
+                continue;
+            }
+
+            GByte* data = (GByte*) block->GetDataRef();
+            for (int j = 0; j < 64 * slow_block_lines; j++)
+            {
+                if (data[j] != y_blocks[i] + 1)
+                {
+                    same = FALSE;
+                    break;
+                }
+            }
+            block->DropLock();
+        }
+
+        ds.WaitForPrefetch();
+        ensure("Block used before being read by the prefetch", same);
+        ensure_equals("Wrong number of block reads", (int) band->reads_,
+                      slow_blocks);
+        ensure("Concurrent block reads", 0 == band->concurrent_reads_);
+    }
+
+    // Band of 16 line blocks computed on the fly, for the prefetch stress
+    // test
+    const int stress_xsize = 256;
+    const int stress_ysize = 1024;
+    const int stress_block_lines = 16;
+    const int stress_window_lines = 64;
+
+    static GByte stress_pixel(int band, int x, int y)
+    {
+        return (GByte) ((band * 37 + x * 5 + y * 11) % 256);
+    }
+
+    class StressBand : public GDALRasterBand
+    {
+    public:
+        StressBand(GDALDataset* ds, int band)
+        {
+            poDS = ds;
+            nBand = band;
+            nRasterXSize = stress_xsize;
+            nRasterYSize = stress_ysize;
+            nBlockXSize = stress_xsize;
+            nBlockYSize = stress_block_lines;
+            eDataType = GDT_Byte;
+        }
+
+        virtual CPLErr IReadBlock(int, int y_block, void* data)
+        {
+            for (int y = 0; y < stress_block_lines; y++)
+                for (int x = 0; x < stress_xsize; x++)
+                    ((GByte*) data)[y * stress_xsize + x] =
+                        stress_pixel(nBand, x,
+                                     y_block * stress_block_lines + y);
+            return CE_None;
+        }
+    };
+
+    class StressDataset : public GDALDataset
+    {
+    public:
+        StressDataset()
+        {
+            nRasterXSize = stress_xsize;
+            nRasterYSize = stress_ysize;
+            SetBand(1, new StressBand(this, 1));
+            SetBand(2, new StressBand(this, 2));
+        }
+    };
+
+    // Stress the prefetch with a cache holding only two windows: each
+    // prefetched window is partly evicted by the dirty blocks of another
+    // dataset before being read, and must still be read right.  The
+    // other dataset is only written once the prefetch is done, as the
+    // prefetch must not run while another thread evicts blocks.
+    template<>
+    template<>
+    void object::test<14>()
+    {
+        const char* filename = "/vsimem/test_gdal_prefetch_stress.tif";
+        const int window_bytes = stress_xsize * stress_window_lines * 2;
+        GIntBig cache_max = GDALGetCacheMax64();
+        GByte* window = (GByte*) CPLMalloc(window_bytes);
+
+        GDALSetCacheMax64(2 * window_bytes);
+        CPLSetConfigOption("GDAL_PREFETCH", "YES");
+
+        StressDataset src_ds;
+        GDALDataset* dst_ds = (GDALDataset*)
+            GDALCreate(GDALGetDriverByName("GTiff"), filename, stress_xsize,
+                       stress_ysize, 2, GDT_Byte, NULL);
+        ensure("Can't create dataset", NULL != dst_ds);
+
+        int started = 0;
+        int same = TRUE;
+        int within_cache = TRUE;
+
+        src_ds.RasterIO(GF_Read, 0, 0, stress_xsize, stress_window_lines,
+                        window, stress_xsize, stress_window_lines, GDT_Byte,
+                        2, NULL, 0, 0, 0);
+
+        for (int y = 0; y < stress_ysize; y += stress_window_lines)
+        {
+            int next_y = y + stress_window_lines;
+            if (next_y < stress_ysize
+                && src_ds.StartPrefetch(0, next_y, stress_xsize,
+                                        stress_window_lines, 2, NULL))
+                started++;
+            src_ds.WaitForPrefetch();
+
+            if (GDALGetCacheUsed64() > GDALGetCacheMax64())
+                within_cache = FALSE;
+
+            dst_ds->RasterIO(GF_Write, 0, y, stress_xsize,
+                             stress_window_lines, window, stress_xsize,
+                             stress_window_lines, GDT_Byte, 2, NULL,
+                             0, 0, 0);
+            if (next_y >= stress_ysize)
+                break;
+
+            src_ds.RasterIO(GF_Read, 0, next_y, stress_xsize,
+                            stress_window_lines, window, stress_xsize,
+                            stress_window_lines, GDT_Byte, 2, NULL,
+                            0, 0, 0);
+            for (int band = 1; band <= 2 && same; band++)
+                for (int line = 0; line < stress_window_lines && same; line++)
+                    for (int x = 0; x < stress_xsize; x++)
+                        if (window[((band - 1) * stress_window_lines + line)
+                                   * stress_xsize + x]
+                            != stress_pixel(band, x, next_y + line))
+                        {
+                            same = FALSE;
+                            break;
+                        }
+        }
+
+        CPLSetConfigOption("GDAL_PREFETCH", NULL);
+
+        // The copy, written while its source was prefetched
+        GByte line[stress_xsize];
+        int copied = TRUE;
+        for (int band = 1; band <= 2 && copied; band++)
+        {
+            for (int y = 0; y < stress_ysize && copied; y++)
+            {
+                dst_ds->GetRasterBand(band)->RasterIO(GF_Read, 0, y,
+                                                      stress_xsize, 1, line,
+                                                      stress_xsize, 1,
+                                                      GDT_Byte, 0, 0);
+                for (int x = 0; x < stress_xsize; x++)
+                    if (line[x] != stress_pixel(band, x, y))
+                        copied = FALSE;
+            }
+        }
+
+        GDALClose((GDALDatasetH) dst_ds);
+        GDALDeleteDataset(NULL, filename);
+        src_ds.FlushCache();
+        GDALSetCacheMax64(cache_max);
+        CPLFree(window);
+
+        ensure("No prefetch started", started > 0);
+        ensure("Prefetch above the cache size", within_cache);
+        ensure("Wrong pixels read after the prefetch", same);
+        ensure("Wrong pixels written during the prefetch", copied);
+    }
+
+    // Test GDALDatasetCopyWholeRaster() without the swath reader thread,
+    // but with the next swath prefetched
+    template<>
+    template<>
+    void object::test<15>()
+    {
+        test_swath_copy("1", "YES");
+    }
+
+    // Test the 2Q policy: the blocks evicted from the probation list are
+    // protected when loaded again, but those of a destroyed band are not
+    // for a new band allocated at the same address
+    template<>
+    template<>
+    void object::test<16>()
+    {
+        GIntBig cache_max = GDALGetCacheMax64();
+
+        // 32 blocks in the cache, 8 in the probation list, and a history
+        // of 16 blocks
+        CPLSetConfigOption("GDAL_CACHE_POLICY", "2Q");
+        GDALSetCacheMax64(2 * 1024 * 1024);
+
+        // Pinned blocks, so that the cache is never empty, as the history
+        // is cleared with it
+        TileDataset pinned_ds, other_ds, third_ds;
+        pinned_ds.SetCachePriority(GBP_Pinned);
+        pinned_ds.tile_band()->read_row(0);
+
+        // Row 4, the last one evicted in full, ends in the history
+        TileDataset* old_ds = new TileDataset(TRUE);
+        GDALRasterBand* old_band = old_ds->tile_band();
+        old_ds->read_all();
+        delete old_ds;
+
+        TileDataset* new_ds = new TileDataset(TRUE);
+        int same_address = new_ds->tile_band() == old_band;
+
+        // Row 4 of the new band goes to the probation list, and is the
+        // first to be evicted
+        new_ds->tile_band()->read_row(4);
+        other_ds.read_all();
+        int stale_kept = new_ds->tile_band()->is_row_cached(4);
+
+        // Row 4 of the other dataset ends in the history, and is protected
+        // once loaded again
+        other_ds.tile_band()->read_row(4);
+        third_ds.read_all();
+        int evicted_kept = other_ds.tile_band()->is_row_cached(4);
+
+        delete new_ds;
+        pinned_ds.FlushCache();
+        other_ds.FlushCache();
+        third_ds.FlushCache();
+        CPLSetConfigOption("GDAL_CACHE_POLICY", NULL);
+        GDALSetCacheMax64(cache_max);
+
+        ensure("Band not allocated at the same address", same_address);
+        ensure("Blocks protected by the history of a destroyed band",
+               !stale_kept);
+        ensure("Recently evicted blocks not protected", evicted_kept);
+    }
+
+    // Test that the source index of a VRT band follows the destination
+    // window of a source moved after it was added
+    template<>
+    template<>
+    void object::test<17>()
+    {
+        GDALDriver* mem_drv = (GDALDriver*) GDALGetDriverByName("MEM");
+        ensure("MEM driver not available", mem_drv != NULL);
+
+        GDALDataset* src_ds = mem_drv->Create("", 10, 10, 1, GDT_Byte, NULL);
+        GDALDataset* moved_ds = mem_drv->Create("", 10, 10, 1, GDT_Byte, NULL);
+        src_ds->GetRasterBand(1)->Fill(7);
+        moved_ds->GetRasterBand(1)->Fill(9);
+
+        // A 10x10 tiling of 99 sources, the bottom right tile being empty
+        VRTDataset* vrt_ds = (VRTDataset*) VRTCreate(100, 100);
+        vrt_ds->AddBand(GDT_Byte, NULL);
+        VRTSourcedRasterBand* band =
+            (VRTSourcedRasterBand*) vrt_ds->GetRasterBand(1);
+        for( int i = 0; i < 99; i++ )
+        {
+            GDALDataset* ds = (i == 0) ? moved_ds : src_ds;
+            band->AddSimpleSource(ds->GetRasterBand(1), 0, 0, 10, 10,
+                                  (i % 10) * 10, (i / 10) * 10, 10, 10);
+        }
+
+        GByte before = 255;
+        band->RasterIO(GF_Read, 95, 95, 1, 1, &before, 1, 1, GDT_Byte, 0, 0);
+
+        // Move the first source to the empty tile
+        ((VRTSimpleSource*) band->papoSources[0])->SetDstWindow(90, 90, 10, 10);
+        band->FlushCache();
+
+        GByte after = 255;
+        band->RasterIO(GF_Read, 95, 95, 1, 1, &after, 1, 1, GDT_Byte, 0, 0);
+
+        GDALClose(vrt_ds);
+        GDALClose(src_ds);
+        GDALClose(moved_ds);
+
+        ensure_equals("Empty tile not empty", (int) before, 0);
+        ensure_equals("Moved source not read", (int) after, 9);
+    }
+
 } // namespace tut
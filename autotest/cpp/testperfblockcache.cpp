@@ -0,0 +1,182 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  Compare the replacement policies of the raster block cache by
+ *           replaying mixed access traces.
+ *
+ ******************************************************************************
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "gdal_priv.h"
+
+#define BLOCK_SIZE      256
+#define CACHE_BLOCKS    256     /* 16 MB of 256x256 Byte blocks */
+#define TILE_BLOCKS     64      /* tiled dataset of 64x64 blocks */
+#define SCAN_BLOCKS     48      /* scanned dataset of 48x48 blocks */
+#define HOT_BLOCKS      128     /* working set of the tile reads */
+#define N_ACCESSES      200000
+
+/************************************************************************/
+/*                          TraceRasterBand                             */
+/*                                                                      */
+/*      Band with the blocks of the cache, and no I/O.                  */
+/************************************************************************/
+
+class TraceRasterBand : public GDALRasterBand
+{
+  public:
+    TraceRasterBand( GDALDataset *poDSIn, int nBlocks )
+    {
+        poDS = poDSIn;
+        nBand = 1;
+        nRasterXSize = nRasterYSize = nBlocks * BLOCK_SIZE;
+        nBlockXSize = nBlockYSize = BLOCK_SIZE;
+        eDataType = GDT_Byte;
+    }
+
+    virtual CPLErr IReadBlock( int nXOff, int nYOff, void *pData )
+    {
+        memset( pData, (nXOff + nYOff) % 256, BLOCK_SIZE * BLOCK_SIZE );
+        return CE_None;
+    }
+};
+
+class TraceDataset : public GDALDataset
+{
+  public:
+    TraceDataset( int nBlocks )
+    {
+        nRasterXSize = nRasterYSize = nBlocks * BLOCK_SIZE;
+        SetBand( 1, new TraceRasterBand( this, nBlocks ) );
+    }
+};
+
+/************************************************************************/
+/*                               Random()                               */
+/************************************************************************/
+
+static unsigned int nSeed = 1;
+
+static int Random( int nMax )
+{
+    nSeed = nSeed * 1103515245 + 12345;
+    return (int) ((nSeed >> 8) % nMax);
+}
+
+/************************************************************************/
+/*                               Access()                               */
+/************************************************************************/
+
+static void Access( GDALDataset *poDS, int nBlock, int nBlocksPerRow )
+{
+    GDALRasterBlock *poBlock = poDS->GetRasterBand(1)->GetLockedBlockRef(
+        nBlock % nBlocksPerRow, nBlock / nBlocksPerRow );
+
+    if( poBlock != NULL )
+        poBlock->DropLock();
+}
+
+/************************************************************************/
+/*                             HitRatio()                               */
+/************************************************************************/
+
+static double HitRatio( char **papszStats )
+{
+    double dfHits = atof( CSLFetchNameValue( papszStats, "HITS" ) );
+    double dfMisses = atof( CSLFetchNameValue( papszStats, "MISSES" ) );
+
+    CSLDestroy( papszStats );
+
+    return dfHits + dfMisses > 0 ? 100.0 * dfHits / (dfHits + dfMisses) : 0.0;
+}
+
+/************************************************************************/
+/*                             RunTrace()                               */
+/*                                                                      */
+/*      "tiles": random tile reads, 90% of them in a working set        */
+/*      smaller than the cache.                                         */
+/*      "tiles+scans": the same, with a full scan of another dataset    */
+/*      larger than the cache every 5000 reads.                         */
+/*      "loop": repeated sequential reads of a set slightly larger      */
+/*      than the cache.                                                 */
+/************************************************************************/
+
+static void RunTrace( const char *pszTrace, const char *pszPolicy )
+{
+    CPLSetConfigOption( "GDAL_CACHE_POLICY", pszPolicy );
+    GDALSetCacheMax64( CACHE_BLOCKS * BLOCK_SIZE * BLOCK_SIZE );
+    GDALResetCacheStatistics();
+
+    TraceDataset *poTiles = new TraceDataset( TILE_BLOCKS );
+    TraceDataset *poScan = new TraceDataset( SCAN_BLOCKS );
+    int nTiles = TILE_BLOCKS * TILE_BLOCKS;
+    clock_t nStart = clock();
+
+    nSeed = 1;
+    for( int i = 0; i < N_ACCESSES; i++ )
+    {
+        if( EQUAL(pszTrace, "loop") )
+        {
+            Access( poTiles, i % (CACHE_BLOCKS + CACHE_BLOCKS / 4),
+                    TILE_BLOCKS );
+            continue;
+        }
+
+        if( Random(10) == 0 )
+            Access( poTiles, Random(nTiles), TILE_BLOCKS );
+        else
+            Access( poTiles, Random(HOT_BLOCKS) * (nTiles / HOT_BLOCKS),
+                    TILE_BLOCKS );
+
+        if( EQUAL(pszTrace, "tiles+scans") && i % 5000 == 4999 )
+        {
+            for( int j = 0; j < SCAN_BLOCKS * SCAN_BLOCKS; j++ )
+                Access( poScan, j, SCAN_BLOCKS );
+        }
+    }
+
+    double dfTime = (clock() - nStart) * 1.0 / CLOCKS_PER_SEC;
+
+    printf( "%-12s %-4s : tile hits %5.1f %%, all hits %5.1f %%, %.2f s\n",
+            pszTrace, pszPolicy,
+            HitRatio( poTiles->GetCacheStatistics() ),
+            HitRatio( GDALGetCacheStatistics() ), dfTime );
+
+    delete poTiles;
+    delete poScan;
+}
+
+int main( int argc, char* argv[] )
+{
+    const char *apszTraces[] = { "tiles", "tiles+scans", "loop" };
+    const char *apszPolicies[] = { "LRU", "2Q" };
+
+    for( int iTrace = 0; iTrace < 3; iTrace++ )
+    {
+        for( int iPolicy = 0; iPolicy < 2; iPolicy++ )
+            RunTrace( apszTraces[iTrace], apszPolicies[iPolicy] );
+    }
+
+    return 0;
+}
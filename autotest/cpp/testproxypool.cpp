@@ -0,0 +1,220 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  Stress test of the proxy dataset pool with a VRT mosaic made
+ *           of many sources, read concurrently by several threads.
+ *
+ ******************************************************************************
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include <cpl_conv.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <gdal.h>
+
+#define TILE_SIZE   16
+#define TILES_X     25
+#define TILES_Y     20
+#define N_THREADS   8
+#define N_ITERS     2
+
+static volatile int nErrors = 0;
+static void* hMutex = NULL;
+
+static int TileValue(int iTileX, int iTileY)
+{
+    return (iTileX + iTileY * TILES_X) % 251;
+}
+
+/************************************************************************/
+/*                             CreateVRT()                              */
+/************************************************************************/
+
+static void CreateVRT()
+{
+    GDALDriverH hDriver = GDALGetDriverByName("GTiff");
+    GByte abyTile[TILE_SIZE * TILE_SIZE];
+    CPLString osVRT;
+    int iTileX, iTileY;
+
+    osVRT.Printf("<VRTDataset rasterXSize=\"%d\" rasterYSize=\"%d\">\n"
+                 "  <VRTRasterBand dataType=\"Byte\" band=\"1\">\n",
+                 TILE_SIZE * TILES_X, TILE_SIZE * TILES_Y);
+
+    for(iTileY = 0; iTileY < TILES_Y; iTileY++)
+    {
+        for(iTileX = 0; iTileX < TILES_X; iTileX++)
+        {
+            CPLString osTile;
+            osTile.Printf("/vsimem/testproxypool/tile_%d_%d.tif", iTileX, iTileY);
+
+            GDALDatasetH hDS = GDALCreate(hDriver, osTile, TILE_SIZE, TILE_SIZE,
+                                          1, GDT_Byte, NULL);
+            memset(abyTile, TileValue(iTileX, iTileY), sizeof(abyTile));
+            GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Write,
+                         0, 0, TILE_SIZE, TILE_SIZE, abyTile,
+                         TILE_SIZE, TILE_SIZE, GDT_Byte, 0, 0);
+            GDALClose(hDS);
+
+            osVRT += CPLSPrintf(
+                "    <SimpleSource>\n"
+                "      <SourceFilename relativeToVRT=\"0\">%s</SourceFilename>\n"
+                "      <SourceBand>1</SourceBand>\n"
+                "      <SourceProperties RasterXSize=\"%d\" RasterYSize=\"%d\" DataType=\"Byte\" BlockXSize=\"%d\" BlockYSize=\"%d\"/>\n"
+                "      <SrcRect xOff=\"0\" yOff=\"0\" xSize=\"%d\" ySize=\"%d\"/>\n"
+                "      <DstRect xOff=\"%d\" yOff=\"%d\" xSize=\"%d\" ySize=\"%d\"/>\n"
+                "    </SimpleSource>\n",
+                osTile.c_str(), TILE_SIZE, TILE_SIZE, TILE_SIZE, TILE_SIZE,
+                TILE_SIZE, TILE_SIZE,
+                iTileX * TILE_SIZE, iTileY * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+        }
+    }
+
+    osVRT += "  </VRTRasterBand>\n</VRTDataset>\n";
+
+    VSILFILE* fp = VSIFOpenL("/vsimem/testproxypool/mosaic.vrt", "wb");
+    VSIFWriteL(osVRT.c_str(), 1, osVRT.size(), fp);
+    VSIFCloseL(fp);
+}
+
+/************************************************************************/
+/*                             ReadThread()                             */
+/************************************************************************/
+
+static void ReadThread(void* pData)
+{
+    int iThread = *(int*)pData;
+    int nXSize = TILE_SIZE * TILES_X;
+    int nLines = TILE_SIZE * 2;
+    GByte* pabyLine = (GByte*) CPLMalloc(nXSize * nLines);
+    int nLocalErrors = 0;
+
+    for(int iIter = 0; iIter < N_ITERS; iIter++)
+    {
+        /* Each thread opens its own VRT, so the sources are opened */
+        /* by the pool on its behalf */
+        GDALDatasetH hDS = GDALOpen("/vsimem/testproxypool/mosaic.vrt", GA_ReadOnly);
+        if (hDS == NULL)
+        {
+            nLocalErrors ++;
+            break;
+        }
+
+        /* Go through the mosaic from a different starting row in each */
+        /* thread so that they don't walk over the sources in lockstep */
+        for(int iRow = 0; iRow < TILES_Y / 2; iRow++)
+        {
+            int iTileY = ((iRow + iThread * 3) % (TILES_Y / 2)) * 2;
+            if (GDALRasterIO(GDALGetRasterBand(hDS, 1), GF_Read,
+                             0, iTileY * TILE_SIZE, nXSize, nLines,
+                             pabyLine, nXSize, nLines, GDT_Byte, 0, 0) != CE_None)
+            {
+                nLocalErrors ++;
+                continue;
+            }
+
+            for(int iLine = 0; iLine < nLines; iLine++)
+            {
+                for(int iX = 0; iX < nXSize; iX++)
+                {
+                    if (pabyLine[iLine * nXSize + iX] !=
+                        TileValue(iX / TILE_SIZE, iTileY + iLine / TILE_SIZE))
+                    {
+                        nLocalErrors ++;
+                        break;
+                    }
+                }
+            }
+        }
+
+        GDALClose(hDS);
+    }
+
+    CPLFree(pabyLine);
+
+    CPLAcquireMutex(hMutex, 1000.0);
+    nErrors += nLocalErrors;
+    CPLReleaseMutex(hMutex);
+}
+
+/************************************************************************/
+/*                             RunThreads()                             */
+/************************************************************************/
+
+static void RunThreads()
+{
+    CPLJoinableThread* ahThreads[N_THREADS];
+    int anThreadId[N_THREADS];
+    int i;
+
+    for(i = 0; i < N_THREADS; i++)
+    {
+        anThreadId[i] = i;
+        ahThreads[i] = CPLCreateJoinableThread(ReadThread, &anThreadId[i]);
+    }
+
+    for(i = 0; i < N_THREADS; i++)
+        CPLJoinThread(ahThreads[i]);
+}
+
+/************************************************************************/
+/*                                main()                                */
+/************************************************************************/
+
+int main(int argc, char* argv[])
+{
+    int i;
+
+    /* Much less pool entries than sources, to force a lot of recycling */
+    CPLSetConfigOption("GDAL_MAX_DATASET_POOL_SIZE", "32");
+
+    GDALAllRegister();
+
+    CreateVRT();
+
+    hMutex = CPLCreateMutex();
+    CPLReleaseMutex(hMutex);
+
+    RunThreads();
+
+    /* One entry per shard : a shard whose entry is in use must take */
+    /* one from the other shards */
+    CPLSetConfigOption("GDAL_DATASET_POOL_SHARDS", "32");
+    RunThreads();
+
+    CPLDestroyMutex(hMutex);
+
+    char** papszFiles = VSIReadDir("/vsimem/testproxypool");
+    for(i = 0; papszFiles != NULL && papszFiles[i] != NULL; i++)
+        VSIUnlink(CPLFormFilename("/vsimem/testproxypool", papszFiles[i], NULL));
+    CSLDestroy(papszFiles);
+
+    GDALDestroyDriverManager();
+
+    if (nErrors != 0)
+    {
+        printf("testproxypool: %d errors\n", nErrors);
+        return 1;
+    }
+
+    printf("testproxypool: success\n");
+    return 0;
+}
@@ -293,6 +293,49 @@ def stats_nan_8():
 
     return 'success'
 
+###############################################################################
+# Test that statistics and histograms computed with several threads are
+# the ones computed with a single thread.
+
+def stats_num_threads():
+
+    if gdaltest.gtiff_drv is None:
+        return 'skip'
+
+    for filename in [ 'data/byte.tif', 'data/int16.tif', 'data/float32.tif' ]:
+        src_ds = gdal.Open( filename )
+        ds = gdaltest.gtiff_drv.CreateCopy( '/vsimem/stats_num_threads.tif',
+                                            src_ds, options = [ 'TILED=YES',
+                                            'BLOCKXSIZE=16', 'BLOCKYSIZE=16' ] )
+        src_ds = None
+
+        band = ds.GetRasterBand(1)
+        ref_stats = band.ComputeStatistics( False )
+        ref_hist = band.GetHistogram( approx_ok = 0 )
+
+        gdal.SetConfigOption( 'GDAL_NUM_THREADS', '3' )
+        stats = band.ComputeStatistics( False )
+        hist = band.GetHistogram( approx_ok = 0 )
+        gdal.SetConfigOption( 'GDAL_NUM_THREADS', None )
+
+        ds = None
+        gdaltest.gtiff_drv.Delete( '/vsimem/stats_num_threads.tif' )
+
+        for i in range(4):
+            if abs(stats[i] - ref_stats[i]) > 1e-8 * (1 + abs(ref_stats[i])):
+                gdaltest.post_reason( 'did not get expected stats for %s' % filename )
+                print(stats)
+                print(ref_stats)
+                return 'fail'
+
+        if hist != ref_hist:
+            gdaltest.post_reason( 'did not get expected histogram for %s' % filename )
+            print(hist)
+            print(ref_hist)
+            return 'fail'
+
+    return 'success'
+
 ###############################################################################
 # Run tests
 
@@ -307,7 +350,8 @@ gdaltest_list = [
     stats_nan_5,
     stats_nan_6,
     stats_nan_7,
-    stats_nan_8
+    stats_nan_8,
+    stats_num_threads
     ]
 
 if __name__ == '__main__':
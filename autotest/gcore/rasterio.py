@@ -298,13 +298,196 @@ def rasterio_6():
 
     return 'success'
 
+###############################################################################
+# Test block aligned reads that bypass the block cache (GTiff and MEM)
+
+def rasterio_7():
+
+    # Reference data read through the block cache
+    gdal.SetConfigOption('GDAL_FORCE_CACHING', 'YES')
+    src_ds = gdal.Open('data/byte.tif')
+    ref_data = src_ds.GetRasterBand(1).ReadRaster(0, 0, 20, 20)
+    gdal.SetConfigOption('GDAL_FORCE_CACHING', None)
+
+    for (drv_name, filename, options) in [
+            ('GTiff', 'tmp/rasterio7.tif', [ 'TILED=YES', 'BLOCKXSIZE=16', 'BLOCKYSIZE=16' ]),
+            ('GTiff', 'tmp/rasterio7.tif', []),
+            ('MEM', '', []) ]:
+
+        drv = gdal.GetDriverByName(drv_name)
+        ds = drv.CreateCopy(filename, src_ds, options = options)
+        if filename != '':
+            ds = None
+            ds = gdal.Open(filename)
+
+        (blockxsize, blockysize) = ds.GetRasterBand(1).GetBlockSize()
+
+        # A whole block, and a column of whole blocks
+        for ysize in [ blockysize, blockysize * (20 // blockysize) ]:
+            data = ds.GetRasterBand(1).ReadRaster(0, 0, blockxsize, ysize)
+            expected_data = ref_data[0:0]
+            for y in range(ysize):
+                expected_data = expected_data + ref_data[y * 20:y * 20 + blockxsize]
+            if data != expected_data:
+                gdaltest.post_reason('fail')
+                print(drv_name, options, ysize)
+                return 'fail'
+
+        # The block cache must win over the file for a dirty block
+        if filename != '':
+            ds = None
+            ds = gdal.Open(filename, gdal.GA_Update)
+        ds.GetRasterBand(1).WriteRaster(0, 0, blockxsize, blockysize, ' ' * (blockxsize * blockysize))
+        data = ds.GetRasterBand(1).ReadRaster(0, 0, blockxsize, blockysize)
+        if data != (' ' * (blockxsize * blockysize)).encode('ascii'):
+            gdaltest.post_reason('fail')
+            print(drv_name, options)
+            return 'fail'
+
+        ds = None
+        if filename != '':
+            drv.Delete(filename)
+
+    return 'success'
+
+###############################################################################
+# Test dataset level reads of a pixel interleaved GTiff, that de-interleave
+# the driver blocks directly into the buffer
+
+def rasterio_8():
+
+    src_ds = gdal.Open('data/stefan_full_rgba.tif')
+    ds = gdal.GetDriverByName('GTiff').CreateCopy('tmp/rasterio8.tif', src_ds,
+                options = [ 'TILED=YES', 'BLOCKXSIZE=64', 'BLOCKYSIZE=32' ])
+    src_ds = None
+    ds = None
+
+    # Reference values read band per band through the block cache
+    ds = gdal.Open('tmp/rasterio8.tif')
+    band_data = []
+    for i in range(4):
+        band_data.append(ds.GetRasterBand(i + 1).ReadRaster(3, 5, 100, 70))
+    ds = None
+
+    ds = gdal.Open('tmp/rasterio8.tif')
+    for band_list in [ [1, 2, 3, 4], [3, 2, 1], [4, 2] ]:
+
+        # Band sequential buffer
+        data = ds.ReadRaster(3, 5, 100, 70, band_list = band_list)
+        expected_data = band_data[0][0:0]
+        for band in band_list:
+            expected_data = expected_data + band_data[band - 1]
+        if data != expected_data:
+            gdaltest.post_reason('fail')
+            print(band_list)
+            return 'fail'
+
+        # Pixel interleaved buffer
+        nbands = len(band_list)
+        data = ds.ReadRaster(3, 5, 100, 70, band_list = band_list,
+                             buf_pixel_space = nbands,
+                             buf_line_space = nbands * 100,
+                             buf_band_space = 1)
+        for i in range(nbands):
+            if data[i::nbands] != band_data[band_list[i] - 1]:
+                gdaltest.post_reason('fail')
+                print(band_list, i)
+                return 'fail'
+    ds = None
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/rasterio8.tif')
+
+    return 'success'
+
+###############################################################################
+# Test that a missing block of a sparse pixel interleaved GTiff goes through
+# the block cache alone, and not the following blocks
+
+def rasterio_9():
+
+    ds = gdal.GetDriverByName('GTiff').Create('tmp/rasterio9.tif', 128, 128, 3,
+                options = [ 'TILED=YES', 'BLOCKXSIZE=32', 'BLOCKYSIZE=32',
+                            'SPARSE_OK=YES' ])
+    # All the tiles but the top left one
+    ds.WriteRaster(32, 0, 96, 32, 'x' * (96 * 32 * 3))
+    ds.WriteRaster(0, 32, 128, 96, 'x' * (128 * 96 * 3))
+    ds = None
+
+    ds = gdal.Open('tmp/rasterio9.tif')
+    cache_used = gdal.GetCacheUsed()
+    data = ds.ReadRaster(0, 0, 128, 128, buf_pixel_space = 3,
+                         buf_line_space = 3 * 128, buf_band_space = 1)
+    cache_used = gdal.GetCacheUsed() - cache_used
+    ds = None
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/rasterio9.tif')
+
+    if cache_used != 32 * 32 * 3:
+        gdaltest.post_reason('fail')
+        print(cache_used)
+        return 'fail'
+
+    expected_data = ''
+    for y in range(128):
+        if y < 32:
+            expected_data = expected_data + '\0' * (32 * 3) + 'x' * (96 * 3)
+        else:
+            expected_data = expected_data + 'x' * (128 * 3)
+    if data != expected_data.encode('ascii'):
+        gdaltest.post_reason('fail')
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test that a block column read that does not start or end on a block
+# boundary only reads its first and last blocks through the block cache
+
+def rasterio_10():
+
+    src_ds = gdal.Open('data/byte.tif')
+    ds = gdal.GetDriverByName('GTiff').CreateCopy('tmp/rasterio10.tif', src_ds,
+                options = [ 'TILED=YES', 'BLOCKXSIZE=16', 'BLOCKYSIZE=16' ])
+    src_ds = None
+    ds = None
+
+    # Reference data read through the block cache
+    ds = gdal.Open('tmp/rasterio10.tif')
+    ref_data = ds.GetRasterBand(1).ReadRaster(0, 0, 16, 20)
+    ds = None
+
+    ds = gdal.Open('tmp/rasterio10.tif')
+    cache_used = gdal.GetCacheUsed()
+    data = ds.GetRasterBand(1).ReadRaster(0, 3, 16, 17)
+    cache_used = gdal.GetCacheUsed() - cache_used
+    ds = None
+
+    gdal.GetDriverByName('GTiff').Delete('tmp/rasterio10.tif')
+
+    if data != ref_data[3 * 16:]:
+        gdaltest.post_reason('fail')
+        return 'fail'
+
+    # The first block is partly requested, and the second one is the
+    # partial bottom block
+    if cache_used != 2 * 16 * 16:
+        gdaltest.post_reason('fail')
+        print(cache_used)
+        return 'fail'
+
+    return 'success'
+
 gdaltest_list = [
     rasterio_1,
     rasterio_2,
     rasterio_3,
     rasterio_4,
     rasterio_5,
-    rasterio_6 ]
+    rasterio_6,
+    rasterio_7,
+    rasterio_8,
+    rasterio_9,
+    rasterio_10 ]
 
 if __name__ == '__main__':
 
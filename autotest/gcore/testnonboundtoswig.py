@@ -359,9 +359,341 @@ def testnonboundtoswig_VRTDerivedBands():
 
     return 'success'
 
+###############################################################################
+# Test VSIGetSharedCacheStatistics()
+
+def testnonboundtoswig_VSIGetSharedCacheStatistics():
+
+    if gdal_handle is None:
+        return 'skip'
+
+    gdal_handle.VSICleanupSharedCache.argtypes = [ ]
+    gdal_handle.VSICleanupSharedCache.restype = None
+
+    gdal_handle.VSIGetSharedCacheStatistics.argtypes = [ ctypes.POINTER(ctypes.c_ulonglong),
+                                                         ctypes.POINTER(ctypes.c_ulonglong),
+                                                         ctypes.POINTER(ctypes.c_ulonglong),
+                                                         ctypes.POINTER(ctypes.c_ulonglong) ]
+    gdal_handle.VSIGetSharedCacheStatistics.restype = None
+
+    gdal_handle.VSICleanupSharedCache()
+
+    gdal.SetConfigOption('VSI_CACHE', 'YES')
+    gdal.SetConfigOption('VSI_CACHE_SHARED', 'YES')
+    for i in range(2):
+        ds = gdal.Open('data/byte.tif')
+        ds.GetRasterBand(1).Checksum()
+        ds = None
+    gdal.SetConfigOption('VSI_CACHE', None)
+    gdal.SetConfigOption('VSI_CACHE_SHARED', None)
+
+    hits = ctypes.c_ulonglong(0)
+    misses = ctypes.c_ulonglong(0)
+    used = ctypes.c_ulonglong(0)
+    max_size = ctypes.c_ulonglong(0)
+    gdal_handle.VSIGetSharedCacheStatistics(ctypes.byref(hits), ctypes.byref(misses),
+                                            ctypes.byref(used), ctypes.byref(max_size))
+
+    gdal_handle.VSICleanupSharedCache()
+
+    if misses.value == 0 or hits.value == 0:
+        gdaltest.post_reason('fail')
+        print(hits.value, misses.value)
+        return 'fail'
+
+    if used.value != os.stat('data/byte.tif').st_size or max_size.value != 25000000:
+        gdaltest.post_reason('fail')
+        print(used.value, max_size.value)
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test GDALDatasetAdviseRead() with PREFETCH=YES
+
+def testnonboundtoswig_GDALDatasetAdviseReadPrefetch():
+
+    if gdal_handle is None:
+        return 'skip'
+
+    gdal_handle_stdcall.GDALOpen.argtypes = [ ctypes.c_char_p, ctypes.c_int]
+    gdal_handle_stdcall.GDALOpen.restype = ctypes.c_void_p
+
+    gdal_handle_stdcall.GDALClose.argtypes = [ ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALClose.restype = None
+
+    gdal_handle_stdcall.GDALDatasetAdviseRead.argtypes = [ ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALDatasetAdviseRead.restype = ctypes.c_int
+
+    gdal_handle_stdcall.GDALGetRasterBand.argtypes = [ ctypes.c_void_p, ctypes.c_int ]
+    gdal_handle_stdcall.GDALGetRasterBand.restype = ctypes.c_void_p
+
+    gdal_handle_stdcall.GDALChecksumImage.argtypes = [ ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int ]
+    gdal_handle_stdcall.GDALChecksumImage.restype = ctypes.c_int
+
+    filename = 'data/rgbsmall.tif'
+    option = 'PREFETCH=YES'
+    if version_info >= (3,0,0):
+        filename = bytes(filename, 'utf-8')
+        option = bytes(option, 'utf-8')
+
+    options = (ctypes.c_char_p * 2)(option, None)
+
+    native_ds = gdal_handle_stdcall.GDALOpen(filename, gdal.GA_ReadOnly)
+    if native_ds is None:
+        gdaltest.post_reason('fail')
+        return 'fail'
+
+    # Prefetching is disabled by default
+    gdal.SetConfigOption('GDAL_PREFETCH', 'YES')
+    ret = gdal_handle_stdcall.GDALDatasetAdviseRead(native_ds, 0, 0, 50, 50, 50, 50, gdal.GDT_Byte, 0, None, options)
+    if ret != 0:
+        gdal.SetConfigOption('GDAL_PREFETCH', None)
+        gdaltest.post_reason('fail')
+        print(ret)
+        gdal_handle_stdcall.GDALClose(native_ds)
+        return 'fail'
+
+    cs = []
+    for i in range(3):
+        native_band = gdal_handle_stdcall.GDALGetRasterBand(native_ds, i + 1)
+        cs.append(gdal_handle_stdcall.GDALChecksumImage(native_band, 0, 0, 50, 50))
+
+    # Closing while a prefetch is still pending must be safe too
+    gdal_handle_stdcall.GDALDatasetAdviseRead(native_ds, 0, 0, 50, 50, 50, 50, gdal.GDT_Byte, 0, None, options)
+    gdal_handle_stdcall.GDALClose(native_ds)
+    gdal.SetConfigOption('GDAL_PREFETCH', None)
+
+    if cs != [ 21212, 21053, 21349 ]:
+        gdaltest.post_reason('fail')
+        print(cs)
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test GDALGetCacheStatistics()
+
+def testnonboundtoswig_GDALGetCacheStatistics():
+
+    if gdal_handle is None:
+        return 'skip'
+
+    gdal_handle_stdcall.GDALGetCacheStatistics.argtypes = [ ]
+    gdal_handle_stdcall.GDALGetCacheStatistics.restype = ctypes.POINTER(ctypes.c_char_p)
+
+    gdal_handle.CSLDestroy.argtypes = [ ctypes.POINTER(ctypes.c_char_p) ]
+    gdal_handle.CSLDestroy.restype = None
+
+    def get_cache_statistics():
+        stats = {}
+        native_list = gdal_handle_stdcall.GDALGetCacheStatistics()
+        i = 0
+        while native_list[i] is not None:
+            item = native_list[i]
+            if version_info >= (3,0,0):
+                item = str(item, 'utf-8')
+            (key, value) = item.split('=')
+            stats[key] = float(value)
+            i = i + 1
+        gdal_handle.CSLDestroy(native_list)
+        return stats
+
+    stats_before = get_cache_statistics()
+
+    ds = gdal.GetDriverByName('GTiff').Create('/vsimem/cache_statistics.tif', 100, 100)
+    ds.GetRasterBand(1).Fill(1)
+    stats_dirty = get_cache_statistics()
+    ds = None
+    stats_after = get_cache_statistics()
+
+    gdal.Unlink('/vsimem/cache_statistics.tif')
+
+    for key in [ 'CACHE_MAX', 'CACHE_USED', 'CACHE_DIRTY', 'EVICTIONS',
+                 'SYNC_FLUSHES', 'SYNC_FLUSH_TIME', 'WRITE_BEHIND_FLUSHES' ]:
+        if key not in stats_dirty:
+            gdaltest.post_reason('fail')
+            print(key)
+            return 'fail'
+
+    if stats_dirty['CACHE_DIRTY'] < stats_before['CACHE_DIRTY'] + 100 * 100:
+        gdaltest.post_reason('fail')
+        print(stats_before, stats_dirty)
+        return 'fail'
+
+    if stats_after['CACHE_DIRTY'] != stats_before['CACHE_DIRTY']:
+        gdaltest.post_reason('fail')
+        print(stats_before, stats_after)
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test GDALDatasetGetCacheStatistics()
+
+def testnonboundtoswig_GDALDatasetGetCacheStatistics():
+
+    if gdal_handle is None:
+        return 'skip'
+
+    gdal_handle_stdcall.GDALOpen.argtypes = [ ctypes.c_char_p, ctypes.c_int]
+    gdal_handle_stdcall.GDALOpen.restype = ctypes.c_void_p
+
+    gdal_handle_stdcall.GDALClose.argtypes = [ ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALClose.restype = None
+
+    gdal_handle_stdcall.GDALGetRasterBand.argtypes = [ ctypes.c_void_p, ctypes.c_int ]
+    gdal_handle_stdcall.GDALGetRasterBand.restype = ctypes.c_void_p
+
+    gdal_handle_stdcall.GDALChecksumImage.argtypes = [ ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int ]
+    gdal_handle_stdcall.GDALChecksumImage.restype = ctypes.c_int
+
+    gdal_handle_stdcall.GDALDatasetGetCacheStatistics.argtypes = [ ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALDatasetGetCacheStatistics.restype = ctypes.POINTER(ctypes.c_char_p)
+
+    gdal_handle.CSLDestroy.argtypes = [ ctypes.POINTER(ctypes.c_char_p) ]
+    gdal_handle.CSLDestroy.restype = None
+
+    def get_dataset_cache_statistics(native_ds):
+        stats = {}
+        native_list = gdal_handle_stdcall.GDALDatasetGetCacheStatistics(native_ds)
+        i = 0
+        while native_list[i] is not None:
+            item = native_list[i]
+            if version_info >= (3,0,0):
+                item = str(item, 'utf-8')
+            (key, value) = item.split('=')
+            stats[key] = float(value)
+            i = i + 1
+        gdal_handle.CSLDestroy(native_list)
+        return stats
+
+    filename = 'data/byte.tif'
+    if version_info >= (3,0,0):
+        filename = bytes(filename, 'utf-8')
+
+    native_ds = gdal_handle_stdcall.GDALOpen(filename, gdal.GA_ReadOnly)
+    if native_ds is None:
+        gdaltest.post_reason('fail')
+        return 'fail'
+    native_band = gdal_handle_stdcall.GDALGetRasterBand(native_ds, 1)
+
+    stats_open = get_dataset_cache_statistics(native_ds)
+    gdal_handle_stdcall.GDALChecksumImage(native_band, 0, 0, 20, 20)
+    stats_first = get_dataset_cache_statistics(native_ds)
+    gdal_handle_stdcall.GDALChecksumImage(native_band, 0, 0, 20, 20)
+    stats_second = get_dataset_cache_statistics(native_ds)
+
+    gdal_handle_stdcall.GDALClose(native_ds)
+
+    if stats_open['CACHE_USED'] != 0 or stats_open['MISSES'] != 0 or stats_open['HITS'] != 0:
+        gdaltest.post_reason('fail')
+        print(stats_open)
+        return 'fail'
+
+    if stats_first['MISSES'] == 0 or stats_first['BYTES_READ'] < 20 * 20:
+        gdaltest.post_reason('fail')
+        print(stats_first)
+        return 'fail'
+
+    if stats_second['MISSES'] != stats_first['MISSES'] or \
+       stats_second['BYTES_READ'] != stats_first['BYTES_READ'] or \
+       stats_second['HITS'] <= stats_first['HITS']:
+        gdaltest.post_reason('fail')
+        print(stats_first, stats_second)
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test the block cache quota and priority of a dataset
+
+def testnonboundtoswig_GDALDatasetSetCacheQuota():
+
+    if gdal_handle is None:
+        return 'skip'
+
+    gdal_handle_stdcall.GDALOpen.argtypes = [ ctypes.c_char_p, ctypes.c_int]
+    gdal_handle_stdcall.GDALOpen.restype = ctypes.c_void_p
+
+    gdal_handle_stdcall.GDALClose.argtypes = [ ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALClose.restype = None
+
+    gdal_handle_stdcall.GDALGetRasterBand.argtypes = [ ctypes.c_void_p, ctypes.c_int ]
+    gdal_handle_stdcall.GDALGetRasterBand.restype = ctypes.c_void_p
+
+    gdal_handle_stdcall.GDALChecksumImage.argtypes = [ ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int ]
+    gdal_handle_stdcall.GDALChecksumImage.restype = ctypes.c_int
+
+    gdal_handle_stdcall.GDALDatasetSetCacheQuota.argtypes = [ ctypes.c_void_p, ctypes.c_longlong ]
+    gdal_handle_stdcall.GDALDatasetSetCacheQuota.restype = None
+
+    gdal_handle_stdcall.GDALDatasetGetCacheQuota.argtypes = [ ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALDatasetGetCacheQuota.restype = ctypes.c_longlong
+
+    gdal_handle_stdcall.GDALDatasetSetCachePriority.argtypes = [ ctypes.c_void_p, ctypes.c_int ]
+    gdal_handle_stdcall.GDALDatasetSetCachePriority.restype = None
+
+    gdal_handle_stdcall.GDALGetRasterCachePriority.argtypes = [ ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALGetRasterCachePriority.restype = ctypes.c_int
+
+    gdal_handle_stdcall.GDALDatasetGetCacheStatistics.argtypes = [ ctypes.c_void_p ]
+    gdal_handle_stdcall.GDALDatasetGetCacheStatistics.restype = ctypes.POINTER(ctypes.c_char_p)
+
+    gdal_handle.CSLFetchNameValue.argtypes = [ ctypes.POINTER(ctypes.c_char_p), ctypes.c_char_p ]
+    gdal_handle.CSLFetchNameValue.restype = ctypes.c_char_p
+
+    gdal_handle.CSLDestroy.argtypes = [ ctypes.POINTER(ctypes.c_char_p) ]
+    gdal_handle.CSLDestroy.restype = None
+
+    key = 'CACHE_USED'
+    filename = 'data/utmsmall.tif'
+    if version_info >= (3,0,0):
+        key = bytes(key, 'utf-8')
+        filename = bytes(filename, 'utf-8')
+
+    # utmsmall.tif has two strips of 100x81 bytes
+    cache_used = []
+    for quota in [ 0, 1 ]:
+        native_ds = gdal_handle_stdcall.GDALOpen(filename, gdal.GA_ReadOnly)
+        if native_ds is None:
+            gdaltest.post_reason('fail')
+            return 'fail'
+        native_band = gdal_handle_stdcall.GDALGetRasterBand(native_ds, 1)
+
+        gdal_handle_stdcall.GDALDatasetSetCacheQuota(native_ds, quota)
+        if gdal_handle_stdcall.GDALDatasetGetCacheQuota(native_ds) != quota:
+            gdaltest.post_reason('fail')
+            return 'fail'
+
+        gdal_handle_stdcall.GDALDatasetSetCachePriority(native_ds, 0)
+        if gdal_handle_stdcall.GDALGetRasterCachePriority(native_band) != 0:
+            gdaltest.post_reason('fail')
+            return 'fail'
+
+        gdal_handle_stdcall.GDALChecksumImage(native_band, 0, 0, 100, 100)
+
+        native_list = gdal_handle_stdcall.GDALDatasetGetCacheStatistics(native_ds)
+        cache_used.append(int(gdal_handle.CSLFetchNameValue(native_list, key)))
+        gdal_handle.CSLDestroy(native_list)
+
+        gdal_handle_stdcall.GDALClose(native_ds)
+
+    if cache_used != [ 2 * 100 * 81, 100 * 81 ]:
+        gdaltest.post_reason('fail')
+        print(cache_used)
+        return 'fail'
+
+    return 'success'
+
 gdaltest_list = [ testnonboundtoswig_init,
                   testnonboundtoswig_GDALSimpleImageWarp,
-                  testnonboundtoswig_VRTDerivedBands ]
+                  testnonboundtoswig_VRTDerivedBands,
+                  testnonboundtoswig_VSIGetSharedCacheStatistics,
+                  testnonboundtoswig_GDALDatasetAdviseReadPrefetch,
+                  testnonboundtoswig_GDALGetCacheStatistics,
+                  testnonboundtoswig_GDALDatasetGetCacheStatistics,
+                  testnonboundtoswig_GDALDatasetSetCacheQuota ]
 
 if __name__ == '__main__':
 
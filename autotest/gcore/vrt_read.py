@@ -244,6 +244,149 @@ def vrt_read_5():
 
     return 'success'
 
+###############################################################################
+# Test reading a mosaic with enough sources for them to be spatially indexed
+
+def vrt_read_6():
+
+    xml = '<VRTDataset rasterXSize="200" rasterYSize="200">\n'
+    xml += '  <VRTRasterBand dataType="Byte" band="1">\n'
+    for j in range(10):
+        for i in range(10):
+            xml += """    <SimpleSource>
+      <SourceFilename relativeToVRT="0">data/byte.tif</SourceFilename>
+      <SourceBand>1</SourceBand>
+      <SrcRect xOff="0" yOff="0" xSize="20" ySize="20"/>
+      <DstRect xOff="%d" yOff="%d" xSize="20" ySize="20"/>
+    </SimpleSource>
+""" % (i * 20, j * 20)
+    xml += '  </VRTRasterBand>\n</VRTDataset>\n'
+
+    ds = gdal.Open(xml)
+    for (xoff, yoff) in [ (0, 0), (20, 0), (180, 180), (100, 40) ]:
+        cs = ds.GetRasterBand(1).Checksum(xoff, yoff, 20, 20)
+        if cs != 4672:
+            gdaltest.post_reason('fail')
+            print(xoff, yoff, cs)
+            return 'fail'
+    data_idx = ds.GetRasterBand(1).ReadRaster(7, 13, 150, 101)
+    data_sub_idx = ds.GetRasterBand(1).ReadRaster(7, 13, 150, 101, 50, 33)
+    ds = None
+
+    gdal.SetConfigOption('VRT_SOURCE_INDEX', 'NO')
+    ds = gdal.Open(xml)
+    data = ds.GetRasterBand(1).ReadRaster(7, 13, 150, 101)
+    data_sub = ds.GetRasterBand(1).ReadRaster(7, 13, 150, 101, 50, 33)
+    ds = None
+    gdal.SetConfigOption('VRT_SOURCE_INDEX', None)
+
+    if data_idx != data or data_sub_idx != data_sub:
+        gdaltest.post_reason('did not get same result with and without index')
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test reading the sources of a mosaic with several threads
+
+def vrt_read_7():
+
+    src_ds = gdal.Open('data/byte.tif')
+    xml = '<VRTDataset rasterXSize="300" rasterYSize="300" numThreads="4">\n'
+    xml += '  <VRTRasterBand dataType="Byte" band="1">\n'
+    for j in range(15):
+        for i in range(15):
+            filename = '/vsimem/vrt_read_7_%d_%d.tif' % (i, j)
+            gdal.GetDriverByName('GTiff').CreateCopy(filename, src_ds)
+            # Make the tiles overlap, and read some of them twice
+            xml += """    <SimpleSource>
+      <SourceFilename relativeToVRT="0">%s</SourceFilename>
+      <SourceBand>1</SourceBand>
+      <SrcRect xOff="0" yOff="0" xSize="20" ySize="20"/>
+      <DstRect xOff="%d" yOff="%d" xSize="22" ySize="22"/>
+    </SimpleSource>
+""" % (filename, i * 20, j * 20)
+            if (i + j) % 5 == 0:
+                xml += """    <SimpleSource>
+      <SourceFilename relativeToVRT="0">/vsimem/vrt_read_7_0_0.tif</SourceFilename>
+      <SourceBand>1</SourceBand>
+      <SrcRect xOff="5" yOff="5" xSize="10" ySize="10"/>
+      <DstRect xOff="%d" yOff="%d" xSize="10" ySize="10"/>
+    </SimpleSource>
+""" % (i * 20 + 3, j * 20 + 3)
+    xml += '  </VRTRasterBand>\n</VRTDataset>\n'
+    src_ds = None
+
+    ds = gdal.Open(xml)
+    data_mt = ds.GetRasterBand(1).ReadRaster(0, 0, 300, 300)
+    ds = None
+
+    ds = gdal.Open(xml.replace('numThreads="4"', 'numThreads="1"'))
+    data = ds.GetRasterBand(1).ReadRaster(0, 0, 300, 300)
+    ds = None
+
+    for j in range(15):
+        for i in range(15):
+            gdal.Unlink('/vsimem/vrt_read_7_%d_%d.tif' % (i, j))
+
+    if data_mt != data:
+        gdaltest.post_reason('did not get same result with several threads')
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Test that the error of a source read by a worker thread is reported
+
+def vrt_read_8():
+
+    src_ds = gdal.Open('data/byte.tif')
+    xml = '<VRTDataset rasterXSize="300" rasterYSize="300" numThreads="4">\n'
+    xml += '  <VRTRasterBand dataType="Byte" band="1">\n'
+    for j in range(15):
+        for i in range(15):
+            filename = '/vsimem/vrt_read_8_%d_%d.tif' % (i, j)
+            gdal.GetDriverByName('GTiff').CreateCopy(filename, src_ds)
+            xml += """    <SimpleSource>
+      <SourceFilename relativeToVRT="0">%s</SourceFilename>
+      <SourceBand>1</SourceBand>
+      <SrcRect xOff="0" yOff="0" xSize="20" ySize="20"/>
+      <DstRect xOff="%d" yOff="%d" xSize="20" ySize="20"/>
+    </SimpleSource>
+""" % (filename, i * 20, j * 20)
+    xml += '  </VRTRasterBand>\n</VRTDataset>\n'
+    src_ds = None
+
+    # Truncate the imagery of one of the tiles
+    f = gdal.VSIFOpenL('/vsimem/vrt_read_8_7_7.tif', 'rb')
+    data = gdal.VSIFReadL(1, 600, f)
+    gdal.VSIFCloseL(f)
+    f = gdal.VSIFOpenL('/vsimem/vrt_read_8_7_7.tif', 'wb')
+    gdal.VSIFWriteL(data, 1, 600, f)
+    gdal.VSIFCloseL(f)
+
+    ds = gdal.Open(xml)
+    gdal.ErrorReset()
+    gdal.PushErrorHandler('CPLQuietErrorHandler')
+    data = ds.GetRasterBand(1).ReadRaster(0, 0, 300, 300)
+    gdal.PopErrorHandler()
+    ds = None
+
+    for j in range(15):
+        for i in range(15):
+            gdal.Unlink('/vsimem/vrt_read_8_%d_%d.tif' % (i, j))
+
+    if data is not None:
+        gdaltest.post_reason('expected the read to fail')
+        return 'fail'
+
+    if gdal.GetLastErrorMsg().find('vrt_read_8_7_7.tif') < 0:
+        gdaltest.post_reason('did not get expected error message')
+        print(gdal.GetLastErrorMsg())
+        return 'fail'
+
+    return 'success'
+
 for item in init_list:
     ut = gdaltest.GDALTest( 'VRT', item[0], item[1], item[2] )
     if ut is None:
@@ -256,6 +399,9 @@ gdaltest_list.append( vrt_read_2 )
 gdaltest_list.append( vrt_read_3 )
 gdaltest_list.append( vrt_read_4 )
 gdaltest_list.append( vrt_read_5 )
+gdaltest_list.append( vrt_read_6 )
+gdaltest_list.append( vrt_read_7 )
+gdaltest_list.append( vrt_read_8 )
 
 if __name__ == '__main__':
 
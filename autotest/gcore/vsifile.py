@@ -136,9 +136,68 @@ def vsifile_3():
 
     return 'success'
 
+###############################################################################
+# Test reading through the shared VSI_CACHE with several handles
+
+def vsifile_4():
+
+    filename = 'tmp/vsifile_4.bin'
+
+    fp = gdal.VSIFOpenL(filename, 'wb')
+    data = ''.join([ chr(ord('a') + (i % 26)) for i in range(100000) ])
+    gdal.VSIFWriteL(data, 1, len(data), fp)
+    gdal.VSIFCloseL(fp)
+
+    gdal.SetConfigOption('VSI_CACHE', 'YES')
+    gdal.SetConfigOption('VSI_CACHE_SHARED', 'YES')
+    fp1 = gdal.VSIFOpenL(filename, 'rb')
+    fp2 = gdal.VSIFOpenL(filename, 'rb')
+    gdal.SetConfigOption('VSI_CACHE', None)
+    gdal.SetConfigOption('VSI_CACHE_SHARED', None)
+
+    ret = 'success'
+    for (fp, offset, size) in [ (fp1, 0, 100), (fp2, 50, 40000),
+                                (fp1, 32760, 10), (fp2, 99990, 100),
+                                (fp1, 70000, 30000) ]:
+        gdal.VSIFSeekL(fp, offset, 0)
+        got = gdal.VSIFReadL(1, size, fp)
+        if sys.version_info >= (3,0,0):
+            got = got.decode('ascii')
+        if got != data[offset:offset+size]:
+            gdaltest.post_reason('fail')
+            print(offset, size)
+            ret = 'fail'
+
+    gdal.VSIFCloseL(fp1)
+    gdal.VSIFCloseL(fp2)
+
+    # Rewriting the file must not leave stale content in the shared cache
+    fp = gdal.VSIFOpenL(filename, 'wb')
+    gdal.VSIFWriteL(data.upper(), 1, len(data), fp)
+    gdal.VSIFCloseL(fp)
+
+    gdal.SetConfigOption('VSI_CACHE', 'YES')
+    gdal.SetConfigOption('VSI_CACHE_SHARED', 'YES')
+    fp = gdal.VSIFOpenL(filename, 'rb')
+    gdal.SetConfigOption('VSI_CACHE', None)
+    gdal.SetConfigOption('VSI_CACHE_SHARED', None)
+    got = gdal.VSIFReadL(1, 10, fp)
+    if sys.version_info >= (3,0,0):
+        got = got.decode('ascii')
+    gdal.VSIFCloseL(fp)
+    if got != data[0:10].upper():
+        gdaltest.post_reason('fail')
+        print(got)
+        ret = 'fail'
+
+    gdal.Unlink(filename)
+
+    return ret
+
 gdaltest_list = [ vsifile_1,
                   vsifile_2,
-                  vsifile_3 ]
+                  vsifile_3,
+                  vsifile_4 ]
 
 if __name__ == '__main__':
 
@@ -175,6 +175,95 @@ def vrtderived_4():
 
     return 'success'
 
+###############################################################################
+# Check a derived band computed from a band math expression
+
+def vrtderived_5():
+
+    xml = """<VRTDataset rasterXSize="20" rasterYSize="20">
+  <VRTRasterBand dataType="Float32" band="1" subClass="VRTDerivedRasterBand">
+    <PixelFunctionExpression>if(B1 &gt; 100, (B1-B2)/(B1+B2), -1)</PixelFunctionExpression>
+    <SimpleSource>
+      <SourceFilename relativeToVRT="0">data/byte.tif</SourceFilename>
+      <SourceBand>1</SourceBand>
+    </SimpleSource>
+    <ComplexSource>
+      <SourceFilename relativeToVRT="0">data/byte.tif</SourceFilename>
+      <SourceBand>1</SourceBand>
+      <ScaleOffset>10</ScaleOffset>
+    </ComplexSource>
+  </VRTRasterBand>
+</VRTDataset>"""
+
+    ds = gdal.Open(xml)
+    import struct
+    src_ds = gdal.Open('data/byte.tif')
+    src = struct.unpack('B' * 400, src_ds.ReadRaster(0, 0, 20, 20))
+    got = struct.unpack('f' * 400, ds.GetRasterBand(1).ReadRaster(0, 0, 20, 20))
+    for i in range(400):
+        if src[i] > 100:
+            expected = -10.0 / (2 * src[i] + 10)
+        else:
+            expected = -1
+        if abs(got[i] - expected) > 1e-6:
+            gdaltest.post_reason('did not get expected value')
+            print(i, got[i], expected)
+            return 'fail'
+    ds = None
+
+    # Invalid expressions are reported at opening
+    gdal.PushErrorHandler('CPLQuietErrorHandler')
+    ds = gdal.Open(xml.replace('B1 &gt; 100', 'B3 &gt; 100'))
+    gdal.PopErrorHandler()
+    if ds is not None:
+        gdaltest.post_reason('reference to missing source not detected')
+        return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Check that the expression can be set at band creation and is serialized
+
+def vrtderived_6():
+    filename = 'tmp/derived.vrt'
+    vrt_ds = gdal.GetDriverByName('VRT').Create(filename, 20, 20, 0)
+
+    options = [
+        'subClass=VRTDerivedRasterBand',
+        'PixelFunctionExpression=B1*2',
+    ]
+    vrt_ds.AddBand(gdal.GDT_Int16, options)
+
+    md = {}
+    md['source_0'] = """<SimpleSource>
+      <SourceFilename>data/byte.tif</SourceFilename>
+      <SourceBand>1</SourceBand>
+    </SimpleSource>"""
+    vrt_ds.GetRasterBand(1).SetMetadata(md, 'vrt_sources')
+    vrt_ds = None
+
+    xmlstring = open(filename).read()
+    if xmlstring.find('<PixelFunctionExpression>B1*2</PixelFunctionExpression>') < 0:
+        gdaltest.post_reason('expression not serialized')
+        print(xmlstring)
+        return 'fail'
+
+    import struct
+    src_ds = gdal.Open('data/byte.tif')
+    src = struct.unpack('B' * 400, src_ds.ReadRaster(0, 0, 20, 20))
+    ds = gdal.Open(filename)
+    got = struct.unpack('h' * 400, ds.GetRasterBand(1).ReadRaster(0, 0, 20, 20))
+    ds = None
+    gdal.Unlink(filename)
+
+    for i in range(400):
+        if got[i] != 2 * src[i]:
+            gdaltest.post_reason('did not get expected value')
+            print(i, got[i], src[i])
+            return 'fail'
+
+    return 'success'
+
 ###############################################################################
 # Cleanup.
 
@@ -190,6 +279,8 @@ gdaltest_list = [
     vrtderived_2,
     vrtderived_3,
     vrtderived_4,
+    vrtderived_5,
+    vrtderived_6,
     vrtderived_cleanup,
 ]
 
@@ -30,6 +30,7 @@
 
 import os
 import sys
+import struct
 import gdal
 
 sys.path.append( '../pymod' )
@@ -145,6 +146,82 @@ def vrtfilt_5():
 
     return 'success'
 
+###############################################################################
+# Verify that a separable kernel gives the same result when it is applied
+# as two 1D passes or as a full 2D kernel
+
+def vrtfilt_6():
+
+    coefs = [ 1, 4, 6, 4, 1 ]
+    coefs = ' '.join([ str(a * b) for a in coefs for b in coefs ])
+
+    vrt_xml = """<VRTDataset rasterXSize="50" rasterYSize="50">
+  <VRTRasterBand dataType="Float32" band="1">
+    <KernelFilteredSource>
+      <SourceFilename>data/rgbsmall.tif</SourceFilename>
+      <SourceBand>1</SourceBand>
+      <Kernel normalized="1">
+        <Size>5</Size>
+        <Coefs>%s</Coefs>
+      </Kernel>
+    </KernelFilteredSource>
+  </VRTRasterBand>
+</VRTDataset>""" % coefs
+
+    ds = gdal.Open(vrt_xml)
+    data_separable = struct.unpack('f' * 2500, ds.GetRasterBand(1).ReadRaster(0, 0, 50, 50))
+    ds = None
+
+    gdal.SetConfigOption('VRT_SEPARABLE_KERNEL', 'NO')
+    ds = gdal.Open(vrt_xml)
+    data_2d = struct.unpack('f' * 2500, ds.GetRasterBand(1).ReadRaster(0, 0, 50, 50))
+    ds = None
+    gdal.SetConfigOption('VRT_SEPARABLE_KERNEL', None)
+
+    for i in range(2500):
+        if abs(data_separable[i] - data_2d[i]) > 1e-3:
+            gdaltest.post_reason('got %f and %f at pixel %d' % (data_separable[i], data_2d[i], i))
+            return 'fail'
+
+    return 'success'
+
+###############################################################################
+# Verify that a request processed by several strips of lines gives the
+# same result as requests of a single line
+
+def vrtfilt_7():
+
+    src_ds = gdal.GetDriverByName('GTiff').Create('/vsimem/vrtfilt_7.tif', 20000, 40)
+    data = ''.join([ chr((i * 7) % 256) for i in range(20000) ])
+    for i in range(40):
+        src_ds.GetRasterBand(1).WriteRaster(0, i, 20000, 1, data[i:] + data[0:i])
+    src_ds = None
+
+    vrt_xml = """<VRTDataset rasterXSize="20000" rasterYSize="40">
+  <VRTRasterBand dataType="Byte" band="1">
+    <KernelFilteredSource>
+      <SourceFilename>/vsimem/vrtfilt_7.tif</SourceFilename>
+      <SourceBand>1</SourceBand>
+      <Kernel normalized="1">
+        <Size>3</Size>
+        <Coefs>1 2 1 2 4 2 1 2 1</Coefs>
+      </Kernel>
+    </KernelFilteredSource>
+  </VRTRasterBand>
+</VRTDataset>"""
+
+    ds = gdal.Open(vrt_xml)
+    data = ds.GetRasterBand(1).ReadRaster(0, 0, 20000, 40)
+    for i in range(40):
+        if ds.GetRasterBand(1).ReadRaster(0, i, 20000, 1) != data[i * 20000:(i + 1) * 20000]:
+            gdaltest.post_reason('difference at line %d' % i)
+            return 'fail'
+    ds = None
+
+    gdal.Unlink('/vsimem/vrtfilt_7.tif')
+
+    return 'success'
+
 ###############################################################################
 # Cleanup.
 
@@ -157,6 +234,8 @@ gdaltest_list = [
     vrtfilt_3,
     vrtfilt_4,
     vrtfilt_5,
+    vrtfilt_6,
+    vrtfilt_7,
     vrtfilt_cleanup ]
 
 if __name__ == '__main__':
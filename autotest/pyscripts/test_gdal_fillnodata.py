@@ -64,12 +64,59 @@ def test_gdal_fillnodata_1():
 
     return 'success'
 
+###############################################################################
+# Check that the multi-threaded strip processing gives the same result as
+# the default processing.
+
+def test_gdal_fillnodata_2():
+
+    if gdaltest.have_ng == 0:
+        return 'skip'
+
+    script_path = test_py_scripts.get_py_script('gdal_fillnodata')
+    if script_path is None:
+        return 'skip'
+
+    src_ds = gdal.Open('../gcore/data/byte.tif')
+    ds = gdal.GetDriverByName('GTiff').CreateCopy('tmp/test_gdal_fillnodata_2_src.tif', src_ds)
+    ds.GetRasterBand(1).SetNoDataValue(0)
+    ds.GetRasterBand(1).WriteRaster(5, 3, 6, 4, '\0' * 24)
+    ds.GetRasterBand(1).WriteRaster(0, 12, 20, 2, '\0' * 40)
+    cs_src = ds.GetRasterBand(1).Checksum()
+    ds = None
+    src_ds = None
+
+    test_py_scripts.run_py_script(script_path, 'gdal_fillnodata', '-si 2 tmp/test_gdal_fillnodata_2_src.tif tmp/test_gdal_fillnodata_2.tif')
+    test_py_scripts.run_py_script(script_path, 'gdal_fillnodata', '-si 2 -o NUM_THREADS=3 tmp/test_gdal_fillnodata_2_src.tif tmp/test_gdal_fillnodata_2_mt.tif')
+
+    ds = gdal.Open('tmp/test_gdal_fillnodata_2.tif')
+    cs = ds.GetRasterBand(1).Checksum()
+    ds = None
+
+    ds = gdal.Open('tmp/test_gdal_fillnodata_2_mt.tif')
+    cs_mt = ds.GetRasterBand(1).Checksum()
+    ds = None
+
+    if cs == cs_src:
+        gdaltest.post_reason('nodata pixels were not filled')
+        return 'fail'
+
+    if cs_mt != cs:
+        print(cs, cs_mt)
+        gdaltest.post_reason('got different checksums')
+        return 'fail'
+
+    return 'success'
+
 ###############################################################################
 # Cleanup
 
 def test_gdal_fillnodata_cleanup():
 
-    lst = [ 'tmp/test_gdal_fillnodata_1.tif' ]
+    lst = [ 'tmp/test_gdal_fillnodata_1.tif',
+            'tmp/test_gdal_fillnodata_2_src.tif',
+            'tmp/test_gdal_fillnodata_2.tif',
+            'tmp/test_gdal_fillnodata_2_mt.tif' ]
     for filename in lst:
         try:
             os.remove(filename)
@@ -80,6 +127,7 @@ def test_gdal_fillnodata_cleanup():
 
 gdaltest_list = [
     test_gdal_fillnodata_1,
+    test_gdal_fillnodata_2,
     test_gdal_fillnodata_cleanup
     ]
 
@@ -395,6 +395,58 @@ def test_gdal_contour_5():
     else:
         return 'success'
 
+###############################################################################
+# Test that the streaming generator produces the same contours whatever the
+# number of threads (-num_threads selects the streaming generator)
+
+def test_gdal_contour_6():
+    if test_cli_utilities.get_gdal_contour_path() is None:
+        return 'skip'
+
+    for name in ['contour_st', 'contour_mt']:
+        try:
+            ogr.GetDriverByName('ESRI Shapefile').DeleteDataSource('tmp/%s.shp' % name)
+        except:
+            pass
+
+    gdaltest.runexternal(test_cli_utilities.get_gdal_contour_path() + ' -a elev -i 10 -num_threads 1 ../gdrivers/data/n43.dt0 tmp/contour_st.shp')
+    gdaltest.runexternal(test_cli_utilities.get_gdal_contour_path() + ' -a elev -i 10 -num_threads 3 ../gdrivers/data/n43.dt0 tmp/contour_mt.shp')
+
+    contours = []
+    for name in ['contour_st', 'contour_mt']:
+        ds = ogr.Open('tmp/%s.shp' % name)
+        lyr = ds.GetLayer(0)
+        lines = []
+        feat = lyr.GetNextFeature()
+        while feat is not None:
+            geom = feat.GetGeometryRef()
+            points = []
+            for i in range(geom.GetPointCount()):
+                points.append((geom.GetX(i), geom.GetY(i)))
+            lines.append((feat.GetField('elev'), points))
+            feat = lyr.GetNextFeature()
+        ds.Destroy()
+        lines.sort()
+        contours.append(lines)
+
+    if len(contours[0]) == 0 or len(contours[0]) != len(contours[1]):
+        print('Got %d and %d features' % (len(contours[0]), len(contours[1])))
+        return 'fail'
+
+    for i in range(len(contours[0])):
+        (elev1, points1) = contours[0][i]
+        (elev2, points2) = contours[1][i]
+        if elev1 != elev2 or len(points1) != len(points2):
+            print('Feature %d: elev %f / %f, %d / %d points' % (i, elev1, elev2, len(points1), len(points2)))
+            return 'fail'
+        for j in range(len(points1)):
+            if abs(points1[j][0] - points2[j][0]) > 1e-8 \
+               or abs(points1[j][1] - points2[j][1]) > 1e-8:
+                print('Feature %d, point %d: %s / %s' % (i, j, str(points1[j]), str(points2[j])))
+                return 'fail'
+
+    return 'success'
+
 ###############################################################################
 # Cleanup
 
@@ -405,6 +457,8 @@ def test_gdal_contour_cleanup():
     ogr.GetDriverByName('ESRI Shapefile').DeleteDataSource('tmp/contour.shp')
     ogr.GetDriverByName('ESRI Shapefile').DeleteDataSource('tmp/contour_orientation1.shp')
     ogr.GetDriverByName('ESRI Shapefile').DeleteDataSource('tmp/contour_orientation2.shp')
+    ogr.GetDriverByName('ESRI Shapefile').DeleteDataSource('tmp/contour_st.shp')
+    ogr.GetDriverByName('ESRI Shapefile').DeleteDataSource('tmp/contour_mt.shp')
     try:
         os.remove('tmp/gdal_contour.tif')
         os.remove('tmp/gdal_contour_orientation.tif')
@@ -420,6 +474,7 @@ gdaltest_list = [
     test_gdal_contour_3,
     test_gdal_contour_4,
     test_gdal_contour_5,
+    test_gdal_contour_6,
     test_gdal_contour_cleanup
     ]
 
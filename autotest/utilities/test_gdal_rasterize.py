@@ -299,6 +299,37 @@ def test_gdal_rasterize_5():
 
     return 'success'
 
+###############################################################################
+# Test -num_threads on a raster large enough to be burnt in several chunks
+
+def test_gdal_rasterize_6():
+
+    if test_cli_utilities.get_gdal_rasterize_path() is None:
+        return 'skip'
+
+    if not os.path.exists('tmp/n43dt0.shp'):
+        return 'skip'
+
+    gdaltest.runexternal(test_cli_utilities.get_gdal_rasterize_path() + ' -3d tmp/n43dt0.shp tmp/test_gdal_rasterize_6_ref.tif -l n43dt0 -ts 4000 1000 -ot Float64 -co COMPRESS=DEFLATE -q')
+    gdaltest.runexternal(test_cli_utilities.get_gdal_rasterize_path() + ' -3d tmp/n43dt0.shp tmp/test_gdal_rasterize_6.tif -l n43dt0 -ts 4000 1000 -ot Float64 -co COMPRESS=DEFLATE -num_threads 3 -q')
+
+    ds_ref = gdal.Open('tmp/test_gdal_rasterize_6_ref.tif')
+    ds = gdal.Open('tmp/test_gdal_rasterize_6.tif')
+
+    cs_ref = ds_ref.GetRasterBand(1).Checksum()
+    cs = ds.GetRasterBand(1).Checksum()
+
+    ds_ref = None
+    ds = None
+
+    if cs != cs_ref:
+        gdaltest.post_reason('did not get expected checksum')
+        print(cs)
+        print(cs_ref)
+        return 'fail'
+
+    return 'success'
+
 ###########################################
 def test_gdal_rasterize_cleanup():
 
@@ -317,6 +348,9 @@ def test_gdal_rasterize_cleanup():
     os.unlink('tmp/test_gdal_rasterize_5.csv')
     os.unlink('tmp/test_gdal_rasterize_5.vrt')
 
+    gdal.GetDriverByName('GTiff').Delete( 'tmp/test_gdal_rasterize_6_ref.tif' )
+    gdal.GetDriverByName('GTiff').Delete( 'tmp/test_gdal_rasterize_6.tif' )
+
     return 'success'
 
 gdaltest_list = [
@@ -325,6 +359,7 @@ gdaltest_list = [
     test_gdal_rasterize_3,
     test_gdal_rasterize_4,
     test_gdal_rasterize_5,
+    test_gdal_rasterize_6,
     test_gdal_rasterize_cleanup
     ]
 
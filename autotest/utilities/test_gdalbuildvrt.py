@@ -450,6 +450,81 @@ def test_gdalbuildvrt_12():
 
     return 'success'
 
+###############################################################################
+# Test -num_threads option
+
+def test_gdalbuildvrt_13():
+    if test_cli_utilities.get_gdalbuildvrt_path() is None:
+        return 'skip'
+
+    gdaltest.runexternal(test_cli_utilities.get_gdalbuildvrt_path() + ' -num_threads 3 tmp/mosaic.vrt tmp/gdalbuildvrt1.tif tmp/gdalbuildvrt2.tif tmp/gdalbuildvrt3.tif tmp/gdalbuildvrt4.tif')
+
+    return test_gdalbuildvrt_check()
+
+###############################################################################
+# Test -incremental option
+
+def test_gdalbuildvrt_14_create_tile(filename, xmin):
+
+    srs = osr.SpatialReference()
+    srs.SetWellKnownGeogCS( 'WGS84' )
+
+    ds = gdal.GetDriverByName('GTiff').Create(filename, 10, 10, 1)
+    ds.SetProjection( srs.ExportToWkt() )
+    ds.SetGeoTransform( [ xmin, 0.1, 0, 49, 0, -0.1 ] )
+    ds.GetRasterBand(1).Fill(255)
+    ds = None
+
+    # Pretend the file has been there for a long time
+    os.utime(filename, (1000000000, 1000000000))
+
+def test_gdalbuildvrt_14():
+    if test_cli_utilities.get_gdalbuildvrt_path() is None:
+        return 'skip'
+
+    try:
+        os.remove('tmp/gdalbuildvrt14.vrt')
+    except:
+        pass
+
+    test_gdalbuildvrt_14_create_tile('tmp/gdalbuildvrt14_1.tif', 2)
+    test_gdalbuildvrt_14_create_tile('tmp/gdalbuildvrt14_2.tif', 3)
+
+    cmd = test_cli_utilities.get_gdalbuildvrt_path() + ' -incremental tmp/gdalbuildvrt14.vrt tmp/gdalbuildvrt14_1.tif tmp/gdalbuildvrt14_2.tif'
+    gdaltest.runexternal(cmd)
+
+    ds = gdal.Open('tmp/gdalbuildvrt14.vrt')
+    if ds.RasterXSize != 20:
+        gdaltest.post_reason('Wrong raster width : %d' % ds.RasterXSize)
+        return 'fail'
+    if not ds.GetMetadata('xml:GDALBUILDVRT'):
+        gdaltest.post_reason('Expected the properties of the files in the VRT')
+        return 'fail'
+    ds = None
+
+    # Replace the second file by a file of the same size, with the same
+    # modification time : the properties stored in the VRT are reused
+    test_gdalbuildvrt_14_create_tile('tmp/gdalbuildvrt14_2.tif', 5)
+    gdaltest.runexternal(cmd)
+
+    ds = gdal.Open('tmp/gdalbuildvrt14.vrt')
+    if ds.RasterXSize != 20:
+        gdaltest.post_reason('Wrong raster width : %d' % ds.RasterXSize)
+        return 'fail'
+    ds = None
+
+    # Now update the modification time : the file is opened again
+    os.utime('tmp/gdalbuildvrt14_2.tif', (1000000010, 1000000010))
+    gdaltest.runexternal(cmd)
+
+    ds = gdal.Open('tmp/gdalbuildvrt14.vrt')
+    if ds.RasterXSize != 40:
+        gdaltest.post_reason('Wrong raster width : %d' % ds.RasterXSize)
+        return 'fail'
+    ds = None
+
+    return 'success'
+
 ###############################################################################
 # Cleanup
 
@@ -467,6 +542,7 @@ def test_gdalbuildvrt_cleanup():
     gdal.GetDriverByName('VRT').Delete('tmp/gdalbuildvrt10.vrt')
     gdal.GetDriverByName('VRT').Delete('tmp/gdalbuildvrt11.vrt')
     gdal.GetDriverByName('VRT').Delete('tmp/gdalbuildvrt12.vrt')
+    gdal.GetDriverByName('VRT').Delete('tmp/gdalbuildvrt14.vrt')
 
     drv = gdal.GetDriverByName('GTiff')
 
@@ -481,6 +557,8 @@ def test_gdalbuildvrt_cleanup():
     drv.Delete('tmp/test_gdalbuildvrt_10_2.tif')
     drv.Delete('tmp/test_gdalbuildvrt_11_1.tif')
     drv.Delete('tmp/test_gdalbuildvrt_11_2.tif')
+    drv.Delete('tmp/gdalbuildvrt14_1.tif')
+    drv.Delete('tmp/gdalbuildvrt14_2.tif')
     try:
         os.remove('tmp/filelist.txt')
     except:
@@ -502,6 +580,8 @@ gdaltest_list = [
     test_gdalbuildvrt_10,
     test_gdalbuildvrt_11,
     test_gdalbuildvrt_12,
+    test_gdalbuildvrt_13,
+    test_gdalbuildvrt_14,
     test_gdalbuildvrt_cleanup
     ]
 
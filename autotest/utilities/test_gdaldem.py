@@ -30,6 +30,7 @@
 
 import sys
 import os
+import struct
 
 sys.path.append( '../pymod' )
 
@@ -102,6 +103,29 @@ def test_gdaldem_hillshade_compute_edges():
 
     return 'success'
 
+###############################################################################
+# Test gdaldem hillshade with -num_threads (strips computed in several threads)
+
+def test_gdaldem_hillshade_num_threads():
+    if test_cli_utilities.get_gdaldem_path() is None:
+        return 'skip'
+
+    gdaltest.runexternal(test_cli_utilities.get_gdaldem_path() + ' hillshade -compute_edges -num_threads 3 -s 111120 -z 30 ../gdrivers/data/n43.dt0 tmp/n43_hillshade_num_threads.tif')
+
+    ds = gdal.Open('tmp/n43_hillshade_num_threads.tif')
+    if ds is None:
+        return 'fail'
+
+    cs = ds.GetRasterBand(1).Checksum()
+    if cs != 50239:
+        gdaltest.post_reason('Bad checksum')
+        print(cs)
+        return 'fail'
+
+    ds = None
+
+    return 'success'
+
 ###############################################################################
 # Test gdaldem hillshade with -az parameter
 
@@ -488,6 +512,69 @@ def test_gdaldem_color_relief_from_float32_to_png():
 
     return 'success'
     
+###############################################################################
+# Test gdaldem color relief from a Float32 dataset large enough to use the
+# lookup buckets, with nodata and NaN pixels : the result must be the same
+# as the one computed without buckets on smaller pieces of it.
+
+def test_gdaldem_color_relief_from_float32_big():
+    if test_cli_utilities.get_gdaldem_path() is None:
+        return 'skip'
+    if test_cli_utilities.get_gdal_translate_path() is None:
+        return 'skip'
+
+    src_ds = gdal.Open('../gdrivers/data/n43.dt0')
+    data = src_ds.GetRasterBand(1).ReadRaster(0, 0, 121, 121, 363, 363,
+                                              gdal.GDT_Float32)
+    src_ds = None
+
+    ds = gdal.GetDriverByName('GTiff').Create('tmp/n43_float32_big.tif',
+                                              363, 363, 1, gdal.GDT_Float32)
+    ds.GetRasterBand(1).SetNoDataValue(-9999)
+    ds.GetRasterBand(1).WriteRaster(0, 0, 363, 363, data)
+    for i in range(0, 363, 7):
+        ds.GetRasterBand(1).WriteRaster(i, (i * 5) % 363, 1, 1,
+                                        struct.pack('f', -9999))
+        ds.GetRasterBand(1).WriteRaster(i, (i * 11 + 3) % 363, 1, 1,
+                                        struct.pack('f', float('nan')))
+    ds = None
+
+    f = open('tmp/color_file_nv.txt', 'wt')
+    f.write(open('data/color_file.txt', 'rt').read())
+    f.write('nv 0 0 0 0\n')
+    f.close()
+
+    gdaltest.runexternal(test_cli_utilities.get_gdaldem_path() + ' color-relief -alpha tmp/n43_float32_big.tif tmp/color_file_nv.txt tmp/n43_colorrelief_from_float32_big.tif')
+    ds = gdal.Open('tmp/n43_colorrelief_from_float32_big.tif')
+    if ds is None:
+        return 'fail'
+
+    # The first pixel is nodata
+    if struct.unpack('B', ds.GetRasterBand(4).ReadRaster(0, 0, 1, 1))[0] != 0:
+        gdaltest.post_reason('nodata pixel not transparent')
+        return 'fail'
+
+    for (xoff, yoff, xsize, ysize) in [ (0, 0, 182, 182), (182, 0, 181, 182),
+                                        (0, 182, 182, 181), (182, 182, 181, 181) ]:
+        gdaltest.runexternal(test_cli_utilities.get_gdal_translate_path() + ' -srcwin %d %d %d %d tmp/n43_float32_big.tif tmp/n43_float32_part.tif' % (xoff, yoff, xsize, ysize))
+        gdaltest.runexternal(test_cli_utilities.get_gdaldem_path() + ' color-relief -alpha tmp/n43_float32_part.tif tmp/color_file_nv.txt tmp/n43_colorrelief_from_float32_part.tif')
+        part_ds = gdal.Open('tmp/n43_colorrelief_from_float32_part.tif')
+        if part_ds is None:
+            return 'fail'
+
+        for iBand in range(4):
+            if ds.GetRasterBand(iBand+1).ReadRaster(xoff, yoff, xsize, ysize) != \
+               part_ds.GetRasterBand(iBand+1).ReadRaster(0, 0, xsize, ysize):
+                print(xoff, yoff, iBand+1)
+                gdaltest.post_reason('Bad color')
+                return 'fail'
+
+        part_ds = None
+
+    ds = None
+
+    return 'success'
+
 ###############################################################################
 # Test gdaldem color relief with -nearest_color_entry
 
@@ -562,6 +649,10 @@ def test_gdaldem_cleanup():
         os.remove('tmp/n43_hillshade_compute_edges.tif')
     except:
         pass
+    try:
+        os.remove('tmp/n43_hillshade_num_threads.tif')
+    except:
+        pass
     try:
         os.remove('tmp/pyramid.tif')
         os.remove('tmp/pyramid_shaded.tif')
@@ -616,6 +707,14 @@ def test_gdaldem_cleanup():
         os.remove('tmp/n43_colorrelief_nearest.tif')
     except:
         pass
+    try:
+        os.remove('tmp/n43_float32_big.tif')
+        os.remove('tmp/n43_float32_part.tif')
+        os.remove('tmp/color_file_nv.txt')
+        os.remove('tmp/n43_colorrelief_from_float32_big.tif')
+        os.remove('tmp/n43_colorrelief_from_float32_part.tif')
+    except:
+        pass
     try:
         os.remove('tmp/n43_colorrelief_nearest.vrt')
     except:
@@ -625,6 +724,7 @@ def test_gdaldem_cleanup():
 gdaltest_list = [
     test_gdaldem_hillshade,
     test_gdaldem_hillshade_compute_edges,
+    test_gdaldem_hillshade_num_threads,
     test_gdaldem_hillshade_azimuth,
     test_gdaldem_hillshade_png,
     test_gdaldem_hillshade_png_compute_edges,
@@ -636,6 +736,7 @@ gdaltest_list = [
     test_gdaldem_color_relief_from_float32,
     test_gdaldem_color_relief_png,
     test_gdaldem_color_relief_from_float32_to_png,
+    test_gdaldem_color_relief_from_float32_big,
     test_gdaldem_color_relief_nearest_color_entry,
     test_gdaldem_color_relief_nearest_color_entry_vrt,
     test_gdaldem_cleanup
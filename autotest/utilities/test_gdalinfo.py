@@ -30,6 +30,7 @@
 
 import sys
 import os
+import shutil
 
 sys.path.append( '../pymod' )
 
@@ -233,6 +234,38 @@ def test_gdalinfo_10():
 
     return 'success'
 
+###############################################################################
+# Test that -checksum reports the checksum saved in the .aux.xml file by
+# GDALDatasetComputeRasterSummary() instead of computing it again
+
+def test_gdalinfo_11():
+    if test_cli_utilities.get_gdalinfo_path() is None:
+        return 'skip'
+
+    shutil.copy('../gcore/data/byte.tif', 'tmp/test_gdalinfo_11.tif')
+    f = open('tmp/test_gdalinfo_11.tif.aux.xml', 'wt')
+    f.write("""<PAMDataset>
+  <PAMRasterBand band="1">
+    <Metadata>
+      <MDI key="STATISTICS_CHECKSUM">1234</MDI>
+    </Metadata>
+  </PAMRasterBand>
+</PAMDataset>
+""")
+    f.close()
+
+    ret = gdaltest.runexternal(test_cli_utilities.get_gdalinfo_path() + ' -checksum tmp/test_gdalinfo_11.tif')
+
+    os.remove('tmp/test_gdalinfo_11.tif')
+    os.remove('tmp/test_gdalinfo_11.tif.aux.xml')
+
+    if ret.find('Checksum=1234') == -1:
+        gdaltest.post_reason( 'did not get the saved checksum.' )
+        print(ret)
+        return 'fail'
+
+    return 'success'
+
 gdaltest_list = [
     test_gdalinfo_1,
     test_gdalinfo_2,
@@ -243,7 +276,8 @@ gdaltest_list = [
     test_gdalinfo_7,
     test_gdalinfo_8,
     test_gdalinfo_9,
-    test_gdalinfo_10
+    test_gdalinfo_10,
+    test_gdalinfo_11
     ]
 
 
@@ -31,6 +31,11 @@
 #include "gdal_priv.h"
 #include "gdal_alg.h"
 #include "ogr_api.h"
+#include "ogr_geometry.h"
+#include "cpl_multiproc.h"
+#include "cpl_string.h"
+#include <vector>
+#include <algorithm>
 
 CPL_CVSID("$Id$");
 
@@ -46,63 +51,187 @@ CPL_CVSID("$Id$");
 
 #define JOIN_DIST 0.0001
 
+// The size of the cells of the hash of open contour ends.  It must be at
+// least twice JOIN_DIST so that the ends within JOIN_DIST of a point are
+// always in one of the (at most) 2x2 cells around it.
+
+#define JOIN_CELL_SIZE (4 * JOIN_DIST)
+
+// The lists of contours kept by a level.  Lists 0 and 1 alternate as the
+// lists of the open contours extended on the current line and of those
+// not extended on it yet.
+
+#define CONTOUR_LIST_NONE      -1
+#define CONTOUR_LIST_CLOSED     2
+
+// The number of contours batched before being written out to the layer.
+
+#define CONTOUR_BATCH_SIZE 1000
+
+class GDALContourItem;
+
+/************************************************************************/
+/*                            GDALContourEnd                            */
+/*                                                                      */
+/*      One of the two ends of an open contour, as stored in the        */
+/*      end point hash of its level.                                    */
+/************************************************************************/
+
+typedef struct GDALContourEnd_s
+{
+    double  dfX;
+    double  dfY;
+    GIntBig nCellX;
+    GIntBig nCellY;
+
+    GDALContourItem         *poItem;
+    struct GDALContourEnd_s *psNext;
+} GDALContourEnd;
+
 /************************************************************************/
 /*                           GDALContourItem                            */
 /************************************************************************/
 class GDALContourItem
 {
 public:
-    int    bRecentlyAccessed;
     double dfLevel;
 
     int  nPoints;
     int  nMaxPoints;
+    int  nFirstPoint;
     double *padfX;
     double *padfY;
 
     int bLeftIsHigh;
+    int bClosed;
 
-    double dfTailX;
+    GDALContourEnd   asEnds[2];
+
+    int              nList;
+    GDALContourItem *poPrev;
+    GDALContourItem *poNext;
 
     GDALContourItem( double dfLevel );
     ~GDALContourItem();
 
+    void   AddPoint( double dfX, double dfY, int bAtHead );
+    void   MakeRoomFor( int nNewPoints, int bAtHead );
+    void   Merge( GDALContourItem *poOther, int bAtHead,
+                  int bFromOtherHead, int bSkipFirst );
+    void   PrepareEjection();
+};
+
+/************************************************************************/
+/*                           GDALContourLevel                           */
+/*                                                                      */
+/*      The open contours of a level are found by their ends in a       */
+/*      hash keyed on the end position, and are kept in lists by        */
+/*      state so that ejecting the ones not extended on a line does     */
+/*      not need to visit the others.                                   */
+/************************************************************************/
+class GDALContourLevel
+{
+    double dfLevel;
+
+    int    nHashSize;
+    int    nEndCount;
+    GDALContourEnd **papsHash;
+
+    GDALContourItem *apoLists[3];
+    int    iTouchedList;
+
+    int    HashCell( GIntBig nCellX, GIntBig nCellY );
+    void   InsertEnd( GDALContourEnd *psEnd );
+    void   RemoveEnd( GDALContourEnd *psEnd );
+    void   UpdateEnd( GDALContourEnd *psEnd );
+    GDALContourEnd *FindEnd( double dfX, double dfY,
+                             GDALContourEnd *psExclude );
+
+    void   Link( GDALContourItem *poItem, int nList );
+    void   Unlink( GDALContourItem *poItem );
+
+    GDALContourItem *ConnectEnds( GDALContourEnd *psEnd1,
+                                  GDALContourEnd *psEnd2, int bCoincident );
+
+public:
+    GDALContourLevel( double );
+    ~GDALContourLevel();
+
+    double GetLevel() { return dfLevel; }
+    void   AddSegment( double dfX1, double dfY1, double dfX2, double dfY2,
+                       int bLeftHigh );
+    void   AddContour( GDALContourItem *poItem );
+    GDALContourItem *PopContour( int bOnlyUnused );
+    void   EndLine();
+};
+
+/************************************************************************/
+/*                        GDALSortedContourItem                         */
+/*                                                                      */
+/*      An open contour of the generator used by default, which         */
+/*      only grows at its tail.                                         */
+/************************************************************************/
+class GDALSortedContourItem
+{
+public:
+    int    bRecentlyAccessed;
+    double dfLevel;
+
+    int  nPoints;
+    int  nMaxPoints;
+    double *padfX;
+    double *padfY;
+
+    int bLeftIsHigh;
+
+    double dfTailX;
+
+    GDALSortedContourItem( double dfLevel );
+    ~GDALSortedContourItem();
+
     int    AddSegment( double dfXStart, double dfYStart,
                        double dfXEnd, double dfYEnd, int bLeftHigh );
     void   MakeRoomFor( int );
-    int    Merge( GDALContourItem * );
+    int    Merge( GDALSortedContourItem * );
     void   PrepareEjection();
 };
 
 /************************************************************************/
-/*                           GDALContourLevel                           */
+/*                        GDALSortedContourLevel                        */
+/*                                                                      */
+/*      The open contours of a level, sorted on the X of their tail.    */
 /************************************************************************/
-class GDALContourLevel 
+class GDALSortedContourLevel 
 {
     double dfLevel;
 
     int nEntryMax;
     int nEntryCount;
-    GDALContourItem **papoEntries;
+    GDALSortedContourItem **papoEntries;
     
 public:
-    GDALContourLevel( double );
-    ~GDALContourLevel();
+    GDALSortedContourLevel( double );
+    ~GDALSortedContourLevel();
 
     double GetLevel() { return dfLevel; }
     int    GetContourCount() { return nEntryCount; }
-    GDALContourItem *GetContour( int i) { return papoEntries[i]; }
+    GDALSortedContourItem *GetContour( int i) { return papoEntries[i]; }
     void   AdjustContour( int );
     void   RemoveContour( int );
     int    FindContour( double dfX, double dfY );
-    int    InsertContour( GDALContourItem * );
+    int    InsertContour( GDALSortedContourItem * );
 };
 
 /************************************************************************/
 /*                         GDALContourGenerator                         */
+/*                                                                      */
+/*      Walks the raster and computes the contour segments of each      */
+/*      pixel, leaving how they are joined into contours to the         */
+/*      subclasses.                                                     */
 /************************************************************************/
 class GDALContourGenerator
 {
+protected:
     int    nWidth;
     int    nHeight;
     int    iLine;
@@ -110,22 +239,19 @@ class GDALContourGenerator
     double *padfLastLine;
     double *padfThisLine;
 
-    int    nLevelMax;
-    int    nLevelCount;
-    GDALContourLevel **papoLevels;
-
-    int    iLastLevel;
-    
     int     bNoDataActive;
     double  dfNoDataValue;
 
     int     bFixedLevels;
+    std::vector<double> adfFixedLevels;
     double  dfContourInterval;
     double  dfContourOffset;
 
-    CPLErr AddSegment( double dfLevel, 
-                       double dfXStart, double dfYStart,
-                       double dfXEnd, double dfYEnd, int bLeftHigh );
+    virtual CPLErr AddSegment( double dfLevel, 
+                               double dfXStart, double dfYStart,
+                               double dfXEnd, double dfYEnd,
+                               int bLeftHigh ) = 0;
+    virtual void   StartLine() {}
 
     CPLErr ProcessPixel( int iPixel );
     CPLErr ProcessRect( double, double, double, 
@@ -137,7 +263,7 @@ class GDALContourGenerator
                       double, double, double, 
                       double, double, int *, double *, double * );
 
-    GDALContourLevel *FindLevel( double dfLevel );
+    void   PerturbLine( double *padfLine );
 
 public:
     GDALContourWriter pfnWriter;
@@ -145,7 +271,7 @@ public:
 
     GDALContourGenerator( int nWidth, int nHeight,
                           GDALContourWriter pfnWriter, void *pWriterCBData );
-    ~GDALContourGenerator();
+    virtual ~GDALContourGenerator();
 
     void                SetNoData( double dfNoDataValue );
     void                SetContourLevels( double dfContourInterval, 
@@ -155,8 +281,81 @@ public:
 
     void                SetFixedLevels( int, double * );
     CPLErr              FeedLine( double *padfScanline );
-    CPLErr              EjectContours( int bOnlyUnused = FALSE );
-    
+    virtual CPLErr      EjectContours( int bOnlyUnused = FALSE ) = 0;
+};
+
+/************************************************************************/
+/*                      GDALSortedContourGenerator                      */
+/*                                                                      */
+/*      The generator used by default.  The open contours of a level    */
+/*      are kept in an array sorted on the X of their tail, and are     */
+/*      written out once the scan has moved past them, after being      */
+/*      merged with the other contours they touch.                      */
+/************************************************************************/
+class GDALSortedContourGenerator : public GDALContourGenerator
+{
+    int    nLevelMax;
+    int    nLevelCount;
+    GDALSortedContourLevel **papoLevels;
+
+    virtual CPLErr AddSegment( double dfLevel, 
+                               double dfXStart, double dfYStart,
+                               double dfXEnd, double dfYEnd,
+                               int bLeftHigh );
+    virtual void   StartLine();
+
+    GDALSortedContourLevel *FindLevel( double dfLevel );
+
+public:
+    GDALSortedContourGenerator( int nWidth, int nHeight,
+                                GDALContourWriter pfnWriter,
+                                void *pWriterCBData );
+    virtual ~GDALSortedContourGenerator();
+
+    virtual CPLErr      EjectContours( int bOnlyUnused = FALSE );
+};
+
+/************************************************************************/
+/*                    GDALStreamingContourGenerator                     */
+/*                                                                      */
+/*      The generator used with the STREAMING option.  The open         */
+/*      contours are found through a hash of their ends, are joined     */
+/*      as soon as a segment connects them, and are written out as      */
+/*      soon as they are complete.  It can also contour a strip of      */
+/*      the raster.                                                     */
+/************************************************************************/
+class GDALStreamingContourGenerator : public GDALContourGenerator
+{
+    int    nLevelMax;
+    int    nLevelCount;
+    GDALContourLevel **papoLevels;
+
+    double  dfSeamTop;
+    double  dfSeamBottom;
+    std::vector<GDALContourItem *> apoSeamContours;
+
+    virtual CPLErr AddSegment( double dfLevel, 
+                               double dfXStart, double dfYStart,
+                               double dfXEnd, double dfYEnd,
+                               int bLeftHigh );
+
+    int    IsOnSeam( double dfY );
+
+    GDALContourLevel *FindLevel( double dfLevel );
+
+public:
+    GDALStreamingContourGenerator( int nWidth, int nHeight,
+                                   GDALContourWriter pfnWriter,
+                                   void *pWriterCBData );
+    virtual ~GDALStreamingContourGenerator();
+
+    void                SetStrip( int iStartLine, int iEndLine,
+                                  double *padfPrevScanline );
+    virtual CPLErr      EjectContours( int bOnlyUnused = FALSE );
+
+    std::vector<GDALContourItem *> &GetSeamContours()
+        { return apoSeamContours; }
+    void                AddSeamContour( GDALContourItem *poItem );
 };
 
 /************************************************************************/
@@ -169,8 +368,8 @@ GDAL_CG_Create( int nWidth, int nHeight, int bNoDataSet, double dfNoDataValue,
                 GDALContourWriter pfnWriter, void *pCBData )
 
 {
-    GDALContourGenerator *poCG = new GDALContourGenerator( nWidth, nHeight, 
-                                                           pfnWriter, pCBData );
+    GDALContourGenerator *poCG = 
+        new GDALSortedContourGenerator( nWidth, nHeight, pfnWriter, pCBData );
 
     if( bNoDataSet )
         poCG->SetNoData( dfNoDataValue );
@@ -231,9 +430,6 @@ GDALContourGenerator::GDALContourGenerator( int nWidthIn, int nHeightIn,
     dfContourInterval = 10.0;
     dfContourOffset = 0.0;
 
-    nLevelMax = 0;
-    nLevelCount = 0;
-    papoLevels = NULL;
     bFixedLevels = FALSE;
 }
 
@@ -244,12 +440,6 @@ GDALContourGenerator::GDALContourGenerator( int nWidthIn, int nHeightIn,
 GDALContourGenerator::~GDALContourGenerator()
 
 {
-    int i;
-
-    for( i = 0; i < nLevelCount; i++ )
-        delete papoLevels[i];
-    CPLFree( papoLevels );
-
     CPLFree( padfLastLine );
     CPLFree( padfThisLine );
 }
@@ -263,8 +453,12 @@ void GDALContourGenerator::SetFixedLevels( int nFixedLevelCount,
 
 {
     bFixedLevels = TRUE;
-    for( int i = 0; i < nFixedLevelCount; i++ )
-        FindLevel( padfFixedLevels[i] );
+    adfFixedLevels.assign( padfFixedLevels, 
+                           padfFixedLevels + nFixedLevelCount );
+    std::sort( adfFixedLevels.begin(), adfFixedLevels.end() );
+    adfFixedLevels.erase( std::unique( adfFixedLevels.begin(), 
+                                       adfFixedLevels.end() ),
+                          adfFixedLevels.end() );
 }
 
 /************************************************************************/
@@ -465,6 +659,7 @@ CPLErr GDALContourGenerator::ProcessRect(
     */
     if( bFixedLevels )
     {
+        int nLevelCount = (int) adfFixedLevels.size();
         int nStart=0, nEnd=nLevelCount-1, nMiddle;
 
         iStartLevel = -1;
@@ -472,7 +667,7 @@ CPLErr GDALContourGenerator::ProcessRect(
         {
             nMiddle = (nEnd + nStart) / 2;
             
-            double dfMiddleLevel = papoLevels[nMiddle]->GetLevel();
+            double dfMiddleLevel = adfFixedLevels[nMiddle];
             
             if( dfMiddleLevel < dfMin )
                 nStart = nMiddle + 1;
@@ -490,7 +685,7 @@ CPLErr GDALContourGenerator::ProcessRect(
 
         iEndLevel = iStartLevel;
         while( iEndLevel < nLevelCount-1 
-               && papoLevels[iEndLevel+1]->GetLevel() < dfMax )
+               && adfFixedLevels[iEndLevel+1] < dfMax )
             iEndLevel++;
 
         if( iStartLevel >= nLevelCount )
@@ -524,7 +719,7 @@ CPLErr GDALContourGenerator::ProcessRect(
         double dfLevel;
 
         if( bFixedLevels )
-            dfLevel = papoLevels[iLevel]->GetLevel();
+            dfLevel = adfFixedLevels[iLevel];
         else
             dfLevel = iLevel * dfContourInterval + dfContourOffset;
 
@@ -667,51 +862,29 @@ void GDALContourGenerator::Intersect( double dfVal1, double dfX1, double dfY1,
 }
 
 /************************************************************************/
-/*                             AddSegment()                             */
+/*                            PerturbLine()                             */
+/*                                                                      */
+/*      Perturb any values that occur exactly on level boundaries.      */
 /************************************************************************/
 
-CPLErr GDALContourGenerator::AddSegment( double dfLevel, 
-                                         double dfX1, double dfY1,
-                                         double dfX2, double dfY2,
-                                         int bLeftHigh)
+void GDALContourGenerator::PerturbLine( double *padfLine )
 
 {
-    GDALContourLevel *poLevel = FindLevel( dfLevel );
-    GDALContourItem *poTarget;
-    int iTarget;
-
-/* -------------------------------------------------------------------- */
-/*      Check all active contours for any that this might attach        */
-/*      to. Eventually this should be recoded to find the contours      */
-/*      of the correct level more efficiently.                          */
-/* -------------------------------------------------------------------- */
-
-    if( dfY1 < dfY2 )
-        iTarget = poLevel->FindContour( dfX1, dfY1 );
-    else
-        iTarget = poLevel->FindContour( dfX2, dfY2 );
+    int iPixel;
 
-    if( iTarget != -1 )
+    for( iPixel = 0; iPixel < nWidth; iPixel++ )
     {
-        poTarget = poLevel->GetContour( iTarget );
+        if( bNoDataActive && padfLine[iPixel] == dfNoDataValue )
+            continue;
 
-        poTarget->AddSegment( dfX1, dfY1, dfX2, dfY2, bLeftHigh );
+        double dfLevel = (padfLine[iPixel] - dfContourOffset)
+            / dfContourInterval;
 
-        poLevel->AdjustContour( iTarget );
-        
-        return CE_None;
+        if( dfLevel - (int) dfLevel == 0.0 )
+        {
+            padfLine[iPixel] += dfContourInterval * FUDGE_EXACT;
+        }
     }
-
-/* -------------------------------------------------------------------- */
-/*      No existing contour found, lets create a new one.               */
-/* -------------------------------------------------------------------- */
-    poTarget = new GDALContourItem( dfLevel );
-
-    poTarget->AddSegment( dfX1, dfY1, dfX2, dfY2, bLeftHigh );
-
-    poLevel->InsertContour( poTarget );
-
-    return CE_None;
 }
 
 /************************************************************************/
@@ -745,21 +918,7 @@ CPLErr GDALContourGenerator::FeedLine( double *padfScanline )
 /* -------------------------------------------------------------------- */
 /*      Perturb any values that occur exactly on level boundaries.      */
 /* -------------------------------------------------------------------- */
-    int iPixel;
-
-    for( iPixel = 0; iPixel < nWidth; iPixel++ )
-    {
-        if( bNoDataActive && padfThisLine[iPixel] == dfNoDataValue )
-            continue;
-
-        double dfLevel = (padfThisLine[iPixel] - dfContourOffset) 
-            / dfContourInterval;
-
-        if( dfLevel - (int) dfLevel == 0.0 )
-        {
-            padfThisLine[iPixel] += dfContourInterval * FUDGE_EXACT;
-        }
-    }
+    PerturbLine( padfThisLine );
 
 /* -------------------------------------------------------------------- */
 /*      If this is the first line we need to initialize the previous    */
@@ -771,23 +930,13 @@ CPLErr GDALContourGenerator::FeedLine( double *padfScanline )
         iLine = 0;
     }
 
-/* -------------------------------------------------------------------- */
-/*      Clear the recently used flags on the contours so we can         */
-/*      check later which ones were touched for this scanline.          */
-/* -------------------------------------------------------------------- */
-    int iLevel, iContour;
-
-    for( iLevel = 0; iLevel < nLevelCount; iLevel++ )
-    {
-        GDALContourLevel *poLevel = papoLevels[iLevel];
-
-        for( iContour = 0; iContour < poLevel->GetContourCount(); iContour++ )
-            poLevel->GetContour( iContour )->bRecentlyAccessed = FALSE;
-    }
+    StartLine();
 
 /* -------------------------------------------------------------------- */
 /*      Process each pixel.                                             */
 /* -------------------------------------------------------------------- */
+    int iPixel;
+
     for( iPixel = 0; iPixel < nWidth+1; iPixel++ )
     {
         CPLErr eErr = ProcessPixel( iPixel );
@@ -809,91 +958,187 @@ CPLErr GDALContourGenerator::FeedLine( double *padfScanline )
 }
 
 /************************************************************************/
-/*                           EjectContours()                            */
+/* ==================================================================== */
+/*                    GDALStreamingContourGenerator                     */
+/* ==================================================================== */
 /************************************************************************/
 
-CPLErr GDALContourGenerator::EjectContours( int bOnlyUnused )
+/************************************************************************/
+/*                   GDALStreamingContourGenerator()                    */
+/************************************************************************/
 
+GDALStreamingContourGenerator::GDALStreamingContourGenerator(
+    int nWidthIn, int nHeightIn, GDALContourWriter pfnWriterIn, 
+    void *pWriterCBDataIn )
+        : GDALContourGenerator( nWidthIn, nHeightIn, 
+                                pfnWriterIn, pWriterCBDataIn )
 {
-    int iLevel;
-    CPLErr eErr = CE_None;
+    nLevelMax = 0;
+    nLevelCount = 0;
+    papoLevels = NULL;
 
-/* -------------------------------------------------------------------- */
-/*      Process all contours of all levels that match our criteria      */
-/* -------------------------------------------------------------------- */
-    for( iLevel = 0; iLevel < nLevelCount && eErr == CE_None; iLevel++ )
-    {
-        GDALContourLevel *poLevel = papoLevels[iLevel];
-        int iContour;
+    // Contour points are never above line -0.5: no seam.
+    dfSeamTop = -1.0;
+    dfSeamBottom = -1.0;
+}
 
-        for( iContour = 0; 
-             iContour < poLevel->GetContourCount() && eErr == CE_None; 
-             /* increment in loop if we don't consume it. */ )
-        {
-            int  iC2;
-            GDALContourItem *poTarget = poLevel->GetContour( iContour );
-            
-            if( bOnlyUnused && poTarget->bRecentlyAccessed )
-            {
-                iContour++;
-                continue;
-            }
+/************************************************************************/
+/*                   ~GDALStreamingContourGenerator()                   */
+/************************************************************************/
 
-            poLevel->RemoveContour( iContour );
+GDALStreamingContourGenerator::~GDALStreamingContourGenerator()
 
-            // Try to find another contour we can merge with in this level.
-            
-            for( iC2 = 0; iC2 < poLevel->GetContourCount(); iC2++ )
-            {
-                GDALContourItem *poOther = poLevel->GetContour( iC2 );
+{
+    int i;
 
-                if( poOther->Merge( poTarget ) )
-                    break;
-            }
+    for( i = 0; i < nLevelCount; i++ )
+        delete papoLevels[i];
+    CPLFree( papoLevels );
 
-            // If we didn't merge it, then eject (write) it out. 
-            if( iC2 == poLevel->GetContourCount() )
-            {
-                if( pfnWriter != NULL )
-                {
-                    // If direction is wrong, then reverse before ejecting.
-                    poTarget->PrepareEjection();
+    for( i = 0; i < (int) apoSeamContours.size(); i++ )
+        delete apoSeamContours[i];
+}
 
-                    eErr = pfnWriter( poTarget->dfLevel, poTarget->nPoints, 
-                                      poTarget->padfX, poTarget->padfY, 
-                                      pWriterCBData );
-                }
-            }
+/************************************************************************/
+/*                              SetStrip()                              */
+/*                                                                      */
+/*      Restrict the generator to the lines iStartLine to iEndLine-1    */
+/*      of a larger raster, the scanline before iStartLine being        */
+/*      passed in if any.  Contours with an end on the strip top or     */
+/*      bottom edge are not written but kept aside as seam contours,    */
+/*      to be joined with those of the neighbouring strips.             */
+/************************************************************************/
 
-            delete poTarget;
-        }
+void GDALStreamingContourGenerator::SetStrip( int iStartLine, int iEndLine,
+                                              double *padfPrevScanline )
+
+{
+    if( iStartLine > 0 )
+    {
+        memcpy( padfThisLine, padfPrevScanline, sizeof(double) * nWidth );
+        PerturbLine( padfThisLine );
+        iLine = iStartLine;
+        dfSeamTop = iStartLine - 0.5;
     }
 
-    return eErr;
+    if( iEndLine < nHeight )
+        dfSeamBottom = iEndLine - 0.5;
 }
 
 /************************************************************************/
-/*                             FindLevel()                              */
+/*                              IsOnSeam()                              */
 /************************************************************************/
 
-GDALContourLevel *GDALContourGenerator::FindLevel( double dfLevel )
+int GDALStreamingContourGenerator::IsOnSeam( double dfY )
 
 {
-    int nStart=0, nEnd=nLevelCount-1, nMiddle;
+    return fabs(dfY - dfSeamTop) < JOIN_DIST
+        || fabs(dfY - dfSeamBottom) < JOIN_DIST;
+}
 
-/* -------------------------------------------------------------------- */
-/*      Binary search to find the requested level.                      */
-/* -------------------------------------------------------------------- */
-    while( nStart <= nEnd )
-    {
-        nMiddle = (nEnd + nStart) / 2;
+/************************************************************************/
+/*                           AddSeamContour()                           */
+/*                                                                      */
+/*      Join a seam contour of a strip with the ones already added.     */
+/************************************************************************/
 
-        double dfMiddleLevel = papoLevels[nMiddle]->GetLevel();
+void GDALStreamingContourGenerator::AddSeamContour( GDALContourItem *poItem )
 
-        if( dfMiddleLevel < dfLevel )
-            nStart = nMiddle + 1;
-        else if( dfMiddleLevel > dfLevel )
-            nEnd = nMiddle - 1;
+{
+    FindLevel( poItem->dfLevel )->AddContour( poItem );
+}
+
+/************************************************************************/
+/*                             AddSegment()                             */
+/************************************************************************/
+
+CPLErr GDALStreamingContourGenerator::AddSegment( double dfLevel, 
+                                                  double dfX1, double dfY1,
+                                                  double dfX2, double dfY2,
+                                                  int bLeftHigh )
+
+{
+    FindLevel( dfLevel )->AddSegment( dfX1, dfY1, dfX2, dfY2, bLeftHigh );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                           EjectContours()                            */
+/*                                                                      */
+/*      Write out the closed contours, and the open ones that were      */
+/*      not extended on this line (or all of them if bOnlyUnused is     */
+/*      FALSE).  As contours are joined as soon as a segment            */
+/*      connects them, these cannot grow anymore.                       */
+/************************************************************************/
+
+CPLErr GDALStreamingContourGenerator::EjectContours( int bOnlyUnused )
+
+{
+    int iLevel;
+    CPLErr eErr = CE_None;
+
+/* -------------------------------------------------------------------- */
+/*      Process all contours of all levels that match our criteria      */
+/* -------------------------------------------------------------------- */
+    for( iLevel = 0; iLevel < nLevelCount && eErr == CE_None; iLevel++ )
+    {
+        GDALContourLevel *poLevel = papoLevels[iLevel];
+        GDALContourItem *poTarget;
+
+        while( eErr == CE_None
+               && (poTarget = poLevel->PopContour( bOnlyUnused )) != NULL )
+        {
+            // Contours ending on a strip edge are joined later on.
+            if( !poTarget->bClosed
+                && (IsOnSeam( poTarget->padfY[0] )
+                    || IsOnSeam( poTarget->padfY[poTarget->nPoints-1] )) )
+            {
+                apoSeamContours.push_back( poTarget );
+                continue;
+            }
+
+            if( pfnWriter != NULL )
+            {
+                // If direction is wrong, then reverse before ejecting.
+                poTarget->PrepareEjection();
+
+                eErr = pfnWriter( poTarget->dfLevel, poTarget->nPoints,
+                                  poTarget->padfX, poTarget->padfY,
+                                  pWriterCBData );
+            }
+
+            delete poTarget;
+        }
+
+        poLevel->EndLine();
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                             FindLevel()                              */
+/************************************************************************/
+
+GDALContourLevel *GDALStreamingContourGenerator::FindLevel( double dfLevel )
+
+{
+    int nStart=0, nEnd=nLevelCount-1, nMiddle;
+
+/* -------------------------------------------------------------------- */
+/*      Binary search to find the requested level.                      */
+/* -------------------------------------------------------------------- */
+    while( nStart <= nEnd )
+    {
+        nMiddle = (nEnd + nStart) / 2;
+
+        double dfMiddleLevel = papoLevels[nMiddle]->GetLevel();
+
+        if( dfMiddleLevel < dfLevel )
+            nStart = nMiddle + 1;
+        else if( dfMiddleLevel > dfLevel )
+            nEnd = nMiddle - 1;
         else
             return papoLevels[nMiddle];
     }
@@ -934,9 +1179,14 @@ GDALContourLevel::GDALContourLevel( double dfLevelIn )
 
 {
     dfLevel = dfLevelIn;
-    nEntryMax = 0;
-    nEntryCount = 0;
-    papoEntries = NULL;
+    nHashSize = 0;
+    nEndCount = 0;
+    papsHash = NULL;
+
+    apoLists[0] = NULL;
+    apoLists[1] = NULL;
+    apoLists[CONTOUR_LIST_CLOSED] = NULL;
+    iTouchedList = 0;
 }
 
 /************************************************************************/
@@ -946,449 +1196,1937 @@ GDALContourLevel::GDALContourLevel( double dfLevelIn )
 GDALContourLevel::~GDALContourLevel()
 
 {
-    CPLAssert( nEntryCount == 0 );
-    CPLFree( papoEntries );
+    for( int iList = 0; iList < 3; iList++ )
+    {
+        while( apoLists[iList] != NULL )
+        {
+            GDALContourItem *poItem = apoLists[iList];
+            apoLists[iList] = poItem->poNext;
+            delete poItem;
+        }
+    }
+
+    CPLFree( papsHash );
 }
 
 /************************************************************************/
-/*                           AdjustContour()                            */
-/*                                                                      */
-/*      Assume the indicated contour's tail may have changed, and       */
-/*      adjust it up or down in the list of contours to re-establish    */
-/*      proper ordering.                                                */
+/*                         GDALContourCell()                            */
 /************************************************************************/
 
-void GDALContourLevel::AdjustContour( int iChanged )
+static GIntBig GDALContourCell( double dfValue )
 
 {
-    while( iChanged > 0 
-         && papoEntries[iChanged]->dfTailX < papoEntries[iChanged-1]->dfTailX )
-    {
-        GDALContourItem *poTemp = papoEntries[iChanged];
-        papoEntries[iChanged] = papoEntries[iChanged-1];
-        papoEntries[iChanged-1] = poTemp;
-        iChanged--;
-    }
-
-    while( iChanged < nEntryCount-1
-         && papoEntries[iChanged]->dfTailX > papoEntries[iChanged+1]->dfTailX )
-    {
-        GDALContourItem *poTemp = papoEntries[iChanged];
-        papoEntries[iChanged] = papoEntries[iChanged+1];
-        papoEntries[iChanged+1] = poTemp;
-        iChanged++;
-    }
+    return (GIntBig) floor( dfValue / JOIN_CELL_SIZE );
 }
 
 /************************************************************************/
-/*                           RemoveContour()                            */
+/*                              HashCell()                              */
 /************************************************************************/
 
-void GDALContourLevel::RemoveContour( int iTarget )
+int GDALContourLevel::HashCell( GIntBig nCellX, GIntBig nCellY )
 
 {
-    if( iTarget < nEntryCount )
-        memmove( papoEntries + iTarget, papoEntries + iTarget + 1, 
-                 (nEntryCount - iTarget - 1) * sizeof(void*) );
-    nEntryCount--;
+    return (int) ((((GUIntBig) nCellX) * 73856093
+                   ^ ((GUIntBig) nCellY) * 19349663) & (nHashSize - 1));
 }
 
 /************************************************************************/
-/*                            FindContour()                             */
+/*                             InsertEnd()                              */
 /*                                                                      */
-/*      Perform a binary search to find the requested "tail"            */
-/*      location.  If not available return -1.  In theory there can     */
-/*      be more than one contour with the same tail X and different     */
-/*      Y tails ... ensure we check against them all.                   */
+/*      Add a contour end to the hash, growing it if needed.  The       */
+/*      end position must be set.                                      */
 /************************************************************************/
 
-int GDALContourLevel::FindContour( double dfX, double dfY )
+void GDALContourLevel::InsertEnd( GDALContourEnd *psEnd )
 
 {
-    int nStart = 0, nEnd = nEntryCount-1, nMiddle;
-
-    while( nEnd >= nStart )
+    if( nEndCount >= nHashSize )
     {
-        nMiddle = (nEnd + nStart) / 2;
+        int nOldSize = nHashSize;
+        GDALContourEnd **papsOldHash = papsHash;
 
-        double dfMiddleX = papoEntries[nMiddle]->dfTailX;
+        nHashSize = (nHashSize == 0) ? 64 : nHashSize * 2;
+        papsHash = (GDALContourEnd **)
+            CPLCalloc( sizeof(GDALContourEnd *), nHashSize );
 
-        if( dfMiddleX < dfX )
-            nStart = nMiddle + 1;
-        else if( dfMiddleX > dfX )
-            nEnd = nMiddle - 1;
-        else
+        for( int i = 0; i < nOldSize; i++ )
         {
-            while( nMiddle > 0 
-                   && fabs(papoEntries[nMiddle]->dfTailX-dfX) < JOIN_DIST )
-                nMiddle--;
-
-            while( nMiddle < nEntryCount
-                   && fabs(papoEntries[nMiddle]->dfTailX-dfX) < JOIN_DIST )
+            while( papsOldHash[i] != NULL )
             {
-                if( fabs(papoEntries[nMiddle]->padfY[papoEntries[nMiddle]->nPoints-1] - dfY) < JOIN_DIST )
-                    return nMiddle;
-                nMiddle++;
-            }
+                GDALContourEnd *psOld = papsOldHash[i];
+                int iHash = HashCell( psOld->nCellX, psOld->nCellY );
 
-            return -1;
+                papsOldHash[i] = psOld->psNext;
+                psOld->psNext = papsHash[iHash];
+                papsHash[iHash] = psOld;
+            }
         }
+        CPLFree( papsOldHash );
     }
 
-    return -1;
+    psEnd->nCellX = GDALContourCell( psEnd->dfX );
+    psEnd->nCellY = GDALContourCell( psEnd->dfY );
+
+    int iHash = HashCell( psEnd->nCellX, psEnd->nCellY );
+    psEnd->psNext = papsHash[iHash];
+    papsHash[iHash] = psEnd;
+    nEndCount++;
 }
 
 /************************************************************************/
-/*                           InsertContour()                            */
-/*                                                                      */
-/*      Ensure the newly added contour is placed in order according     */
-/*      to the X value relative to the other contours.                  */
+/*                             RemoveEnd()                              */
 /************************************************************************/
 
-int GDALContourLevel::InsertContour( GDALContourItem *poNewContour )
+void GDALContourLevel::RemoveEnd( GDALContourEnd *psEnd )
 
 {
-/* -------------------------------------------------------------------- */
-/*      Find where to insert by binary search.                          */
-/* -------------------------------------------------------------------- */
-    int nStart = 0, nEnd = nEntryCount-1, nMiddle;
+    GDALContourEnd **ppsLink =
+        papsHash + HashCell( psEnd->nCellX, psEnd->nCellY );
 
-    while( nEnd >= nStart )
-    {
-        nMiddle = (nEnd + nStart) / 2;
+    while( *ppsLink != psEnd )
+        ppsLink = &((*ppsLink)->psNext);
 
-        double dfMiddleX = papoEntries[nMiddle]->dfTailX;
+    *ppsLink = psEnd->psNext;
+    psEnd->psNext = NULL;
+    nEndCount--;
+}
 
-        if( dfMiddleX < poNewContour->dfLevel )
-            nStart = nMiddle + 1;
-        else if( dfMiddleX > poNewContour->dfLevel )
-            nEnd = nMiddle - 1;
-        else
-        {
-            nEnd = nMiddle - 1;
-            break;
-        }
-    }
+/************************************************************************/
+/*                             UpdateEnd()                              */
+/*                                                                      */
+/*      Move an end in the hash after the first or last point of its    */
+/*      contour changed.                                                */
+/************************************************************************/
 
-/* -------------------------------------------------------------------- */
-/*      Do we need to grow the array?                                   */
-/* -------------------------------------------------------------------- */
-    if( nEntryMax == nEntryCount )
-    {
-        nEntryMax = nEntryMax * 2 + 10;
-        papoEntries = (GDALContourItem **) 
-            CPLRealloc( papoEntries, sizeof(void*) * nEntryMax );
-    }
+void GDALContourLevel::UpdateEnd( GDALContourEnd *psEnd )
 
-/* -------------------------------------------------------------------- */
-/*      Insert the new contour at the appropriate location.             */
-/* -------------------------------------------------------------------- */
-    if( nEntryCount - nEnd - 1 > 0 )
-        memmove( papoEntries + nEnd + 2, papoEntries + nEnd + 1, 
-                 (nEntryCount - nEnd - 1) * sizeof(void*) );
-    papoEntries[nEnd+1] = poNewContour;
-    nEntryCount++;
+{
+    GDALContourItem *poItem = psEnd->poItem;
+    int iPoint = (psEnd == poItem->asEnds) ? 0 : poItem->nPoints - 1;
 
-    return nEnd+1;
+    RemoveEnd( psEnd );
+    psEnd->dfX = poItem->padfX[iPoint];
+    psEnd->dfY = poItem->padfY[iPoint];
+    InsertEnd( psEnd );
 }
 
-
 /************************************************************************/
-/* ==================================================================== */
-/*                           GDALContourItem                            */
-/* ==================================================================== */
+/*                              FindEnd()                               */
+/*                                                                      */
+/*      Find an open contour end within JOIN_DIST of a point, other     */
+/*      than psExclude.  Returns NULL if there is none.                 */
 /************************************************************************/
 
+GDALContourEnd *GDALContourLevel::FindEnd( double dfX, double dfY,
+                                           GDALContourEnd *psExclude )
+
+{
+    if( nEndCount == 0 )
+        return NULL;
+
+    GIntBig anCellX[2], anCellY[2];
+    int iX, iY;
+
+    anCellX[0] = GDALContourCell( dfX - JOIN_DIST );
+    anCellX[1] = GDALContourCell( dfX + JOIN_DIST );
+    anCellY[0] = GDALContourCell( dfY - JOIN_DIST );
+    anCellY[1] = GDALContourCell( dfY + JOIN_DIST );
+
+    for( iX = 0; iX < 2; iX++ )
+    {
+        if( iX == 1 && anCellX[1] == anCellX[0] )
+            break;
+
+        for( iY = 0; iY < 2; iY++ )
+        {
+            if( iY == 1 && anCellY[1] == anCellY[0] )
+                break;
+
+            GDALContourEnd *psEnd =
+                papsHash[HashCell( anCellX[iX], anCellY[iY] )];
+
+            for( ; psEnd != NULL; psEnd = psEnd->psNext )
+            {
+                if( psEnd != psExclude
+                    && fabs(psEnd->dfX - dfX) < JOIN_DIST
+                    && fabs(psEnd->dfY - dfY) < JOIN_DIST )
+                    return psEnd;
+            }
+        }
+    }
+
+    return NULL;
+}
+
 /************************************************************************/
-/*                          GDALContourItem()                           */
+/*                                Link()                                */
+/*                                                                      */
+/*      Move a contour to one of the lists.                             */
 /************************************************************************/
 
-GDALContourItem::GDALContourItem( double dfLevelIn )
+void GDALContourLevel::Link( GDALContourItem *poItem, int nList )
 
 {
-    dfLevel = dfLevelIn;
-    bRecentlyAccessed = FALSE;
-    nPoints = 0;
-    nMaxPoints = 0;
-    padfX = NULL;
-    padfY = NULL;
-    
-    bLeftIsHigh = FALSE;
+    if( poItem->nList == nList )
+        return;
 
-    dfTailX = 0.0;
+    Unlink( poItem );
+
+    poItem->nList = nList;
+    poItem->poPrev = NULL;
+    poItem->poNext = apoLists[nList];
+    if( apoLists[nList] != NULL )
+        apoLists[nList]->poPrev = poItem;
+    apoLists[nList] = poItem;
 }
 
 /************************************************************************/
-/*                          ~GDALContourItem()                          */
+/*                               Unlink()                               */
 /************************************************************************/
 
-GDALContourItem::~GDALContourItem()
+void GDALContourLevel::Unlink( GDALContourItem *poItem )
 
 {
-    CPLFree( padfX );
-    CPLFree( padfY );
+    if( poItem->nList == CONTOUR_LIST_NONE )
+        return;
+
+    if( poItem->poPrev != NULL )
+        poItem->poPrev->poNext = poItem->poNext;
+    else
+        apoLists[poItem->nList] = poItem->poNext;
+
+    if( poItem->poNext != NULL )
+        poItem->poNext->poPrev = poItem->poPrev;
+
+    poItem->nList = CONTOUR_LIST_NONE;
+    poItem->poPrev = NULL;
+    poItem->poNext = NULL;
 }
 
 /************************************************************************/
-/*                             AddSegment()                             */
+/*                            ConnectEnds()                             */
+/*                                                                      */
+/*      Connect two open contours by their ends, or close a contour     */
+/*      if both ends are its own.  If bCoincident is TRUE the two       */
+/*      ends are the same point, otherwise they are joined by a         */
+/*      segment.  Returns the resulting contour.                        */
 /************************************************************************/
 
-int GDALContourItem::AddSegment( double dfXStart, double dfYStart, 
-                                 double dfXEnd, double dfYEnd,
-                                 int bLeftHigh)
+GDALContourItem *GDALContourLevel::ConnectEnds( GDALContourEnd *psEnd1,
+                                                GDALContourEnd *psEnd2,
+                                                int bCoincident )
 
 {
-    MakeRoomFor( nPoints + 1 );
+    GDALContourItem *poItem = psEnd1->poItem;
+    GDALContourItem *poOther = psEnd2->poItem;
 
-/* -------------------------------------------------------------------- */
-/*      If there are no segments, just add now.                         */
-/* -------------------------------------------------------------------- */
-    if( nPoints == 0 )
+    if( poItem == poOther )
     {
-        nPoints = 2;
-
-        padfX[0] = dfXStart;
-        padfY[0] = dfYStart;
-        padfX[1] = dfXEnd;
-        padfY[1] = dfYEnd;
-        bRecentlyAccessed = TRUE;
+        RemoveEnd( poItem->asEnds + 0 );
+        RemoveEnd( poItem->asEnds + 1 );
 
-        dfTailX = padfX[1];
+        // Close exactly on the first point.
+        if( bCoincident )
+        {
+            poItem->padfX[poItem->nPoints-1] = poItem->padfX[0];
+            poItem->padfY[poItem->nPoints-1] = poItem->padfY[0];
+        }
+        else
+            poItem->AddPoint( poItem->padfX[0], poItem->padfY[0], FALSE );
 
-        // Here we know that the left of this vector is the high side
-        bLeftIsHigh = bLeftHigh;
+        poItem->bClosed = TRUE;
+        Link( poItem, CONTOUR_LIST_CLOSED );
 
-        return TRUE;
+        return poItem;
     }
 
 /* -------------------------------------------------------------------- */
-/*      Try to matching up with one of the ends, and insert.            */
+/*      Copy the shorter contour into the longer one.                   */
 /* -------------------------------------------------------------------- */
-    if( fabs(padfX[nPoints-1]-dfXStart) < JOIN_DIST 
-             && fabs(padfY[nPoints-1]-dfYStart) < JOIN_DIST )
+    if( poOther->nPoints > poItem->nPoints )
     {
-        padfX[nPoints] = dfXEnd;
-        padfY[nPoints] = dfYEnd;
-        nPoints++;
+        GDALContourEnd *psTemp = psEnd1;
+        psEnd1 = psEnd2;
+        psEnd2 = psTemp;
 
-        bRecentlyAccessed = TRUE;
+        poItem = psEnd1->poItem;
+        poOther = psEnd2->poItem;
+    }
 
-        dfTailX = dfXEnd;
+    RemoveEnd( poOther->asEnds + 0 );
+    RemoveEnd( poOther->asEnds + 1 );
+    Unlink( poOther );
 
-        return TRUE;
-    }
-    else if( fabs(padfX[nPoints-1]-dfXEnd) < JOIN_DIST 
-             && fabs(padfY[nPoints-1]-dfYEnd) < JOIN_DIST )
+    poItem->Merge( poOther, psEnd1 == poItem->asEnds,
+                   psEnd2 == poOther->asEnds, bCoincident );
+    delete poOther;
+
+    UpdateEnd( psEnd1 );
+    Link( poItem, iTouchedList );
+
+    return poItem;
+}
+
+/************************************************************************/
+/*                             AddSegment()                             */
+/*                                                                      */
+/*      Add a segment, extending or joining the open contours it        */
+/*      touches, or starting a new contour.                             */
+/************************************************************************/
+
+void GDALContourLevel::AddSegment( double dfX1, double dfY1,
+                                   double dfX2, double dfY2, int bLeftHigh )
+
+{
+    // A segment shorter than JOIN_DIST would connect its ends with each
+    // other, which are merged anyway.
+    if( fabs(dfX1 - dfX2) < JOIN_DIST && fabs(dfY1 - dfY2) < JOIN_DIST )
+        return;
+
+    GDALContourEnd *psEnd1 = FindEnd( dfX1, dfY1, NULL );
+    GDALContourEnd *psEnd2 = FindEnd( dfX2, dfY2, psEnd1 );
+
+    if( psEnd1 != NULL && psEnd2 != NULL )
     {
-        padfX[nPoints] = dfXStart;
-        padfY[nPoints] = dfYStart;
-        nPoints++;
+        ConnectEnds( psEnd1, psEnd2, FALSE );
+        return;
+    }
 
-        bRecentlyAccessed = TRUE;
+/* -------------------------------------------------------------------- */
+/*      No existing contour found, lets create a new one.               */
+/* -------------------------------------------------------------------- */
+    if( psEnd1 == NULL && psEnd2 == NULL )
+    {
+        GDALContourItem *poItem = new GDALContourItem( dfLevel );
 
-        dfTailX = dfXStart;
+        poItem->AddPoint( dfX1, dfY1, FALSE );
+        poItem->AddPoint( dfX2, dfY2, FALSE );
 
-        return TRUE;
+        // Here we know that the left of this vector is the high side
+        poItem->bLeftIsHigh = bLeftHigh;
+
+        for( int iEnd = 0; iEnd < 2; iEnd++ )
+        {
+            poItem->asEnds[iEnd].dfX = poItem->padfX[iEnd];
+            poItem->asEnds[iEnd].dfY = poItem->padfY[iEnd];
+            InsertEnd( poItem->asEnds + iEnd );
+        }
+
+        Link( poItem, iTouchedList );
+        return;
     }
+
+/* -------------------------------------------------------------------- */
+/*      Extend the contour at the matching end.                         */
+/* -------------------------------------------------------------------- */
+    GDALContourEnd *psEnd = psEnd1 ? psEnd1 : psEnd2;
+    GDALContourItem *poItem = psEnd->poItem;
+    int bAtHead = (psEnd == poItem->asEnds);
+
+    if( psEnd1 != NULL )
+        poItem->AddPoint( dfX2, dfY2, bAtHead );
     else
-        return FALSE;
+        poItem->AddPoint( dfX1, dfY1, bAtHead );
+
+    UpdateEnd( psEnd );
+    Link( poItem, iTouchedList );
 }
- 
+
+/************************************************************************/
+/*                             AddContour()                             */
+/*                                                                      */
+/*      Add an open contour, joining it with the open contours whose    */
+/*      ends match its own.                                             */
+/************************************************************************/
+
+void GDALContourLevel::AddContour( GDALContourItem *poNew )
+
+{
+    int nLast = poNew->nPoints - 1;
+    double dfTailX = poNew->padfX[nLast];
+    double dfTailY = poNew->padfY[nLast];
+
+    GDALContourEnd *psHead = FindEnd( poNew->padfX[0], poNew->padfY[0],
+                                      NULL );
+
+    poNew->bClosed = FALSE;
+    poNew->asEnds[0].dfX = poNew->padfX[0];
+    poNew->asEnds[0].dfY = poNew->padfY[0];
+    poNew->asEnds[1].dfX = dfTailX;
+    poNew->asEnds[1].dfY = dfTailY;
+    InsertEnd( poNew->asEnds + 0 );
+    InsertEnd( poNew->asEnds + 1 );
+    Link( poNew, iTouchedList );
+
+    GDALContourItem *poItem = poNew;
+
+    if( psHead != NULL )
+        poItem = ConnectEnds( poNew->asEnds + 0, psHead, TRUE );
+
+    if( !poItem->bClosed )
+    {
+        GDALContourEnd *psTail = poItem->asEnds + 1;
+
+        if( psTail->dfX != dfTailX || psTail->dfY != dfTailY )
+            psTail = poItem->asEnds + 0;
+
+        GDALContourEnd *psOther = FindEnd( dfTailX, dfTailY, psTail );
+        if( psOther != NULL )
+            ConnectEnds( psTail, psOther, TRUE );
+    }
+}
+
+/************************************************************************/
+/*                             PopContour()                             */
+/*                                                                      */
+/*      Take out the next contour to eject: a closed one, or an open    */
+/*      one not extended on this line, or any if bOnlyUnused is         */
+/*      FALSE.  Returns NULL if there is none.                          */
+/************************************************************************/
+
+GDALContourItem *GDALContourLevel::PopContour( int bOnlyUnused )
+
+{
+    GDALContourItem *poItem = apoLists[CONTOUR_LIST_CLOSED];
+
+    if( poItem == NULL )
+        poItem = apoLists[1 - iTouchedList];
+
+    if( poItem == NULL && !bOnlyUnused )
+        poItem = apoLists[iTouchedList];
+
+    if( poItem == NULL )
+        return NULL;
+
+    Unlink( poItem );
+
+    if( !poItem->bClosed )
+    {
+        RemoveEnd( poItem->asEnds + 0 );
+        RemoveEnd( poItem->asEnds + 1 );
+    }
+
+    return poItem;
+}
+
+/************************************************************************/
+/*                              EndLine()                               */
+/*                                                                      */
+/*      Once the untouched contours are ejected, the touched ones       */
+/*      become the untouched ones of the next line.                     */
+/************************************************************************/
+
+void GDALContourLevel::EndLine()
+
+{
+    CPLAssert( apoLists[1 - iTouchedList] == NULL );
+
+    iTouchedList = 1 - iTouchedList;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                           GDALContourItem                            */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                          GDALContourItem()                           */
+/************************************************************************/
+
+GDALContourItem::GDALContourItem( double dfLevelIn )
+
+{
+    dfLevel = dfLevelIn;
+    nPoints = 0;
+    nMaxPoints = 0;
+    nFirstPoint = 0;
+    padfX = NULL;
+    padfY = NULL;
+
+    bLeftIsHigh = FALSE;
+    bClosed = FALSE;
+
+    for( int iEnd = 0; iEnd < 2; iEnd++ )
+    {
+        asEnds[iEnd].dfX = 0.0;
+        asEnds[iEnd].dfY = 0.0;
+        asEnds[iEnd].nCellX = 0;
+        asEnds[iEnd].nCellY = 0;
+        asEnds[iEnd].poItem = this;
+        asEnds[iEnd].psNext = NULL;
+    }
+
+    nList = CONTOUR_LIST_NONE;
+    poPrev = NULL;
+    poNext = NULL;
+}
+
+/************************************************************************/
+/*                          ~GDALContourItem()                          */
+/************************************************************************/
+
+GDALContourItem::~GDALContourItem()
+
+{
+    if( padfX != NULL )
+    {
+        CPLFree( padfX - nFirstPoint );
+        CPLFree( padfY - nFirstPoint );
+    }
+}
+
+/************************************************************************/
+/*                              AddPoint()                              */
+/************************************************************************/
+
+void GDALContourItem::AddPoint( double dfX, double dfY, int bAtHead )
+
+{
+    MakeRoomFor( 1, bAtHead );
+
+    if( bAtHead )
+    {
+        padfX--;
+        padfY--;
+        nFirstPoint--;
+
+        padfX[0] = dfX;
+        padfY[0] = dfY;
+    }
+    else
+    {
+        padfX[nPoints] = dfX;
+        padfY[nPoints] = dfY;
+    }
+
+    nPoints++;
+}
+
 /************************************************************************/
 /*                               Merge()                                */
+/*                                                                      */
+/*      Add the points of another contour at the head or tail of        */
+/*      this one, starting from its head or tail end.  If bSkipFirst    */
+/*      is TRUE, that first point is a duplicate of our end and is      */
+/*      not added.                                                      */
 /************************************************************************/
 
-int GDALContourItem::Merge( GDALContourItem *poOther )
+void GDALContourItem::Merge( GDALContourItem *poOther, int bAtHead,
+                             int bFromOtherHead, int bSkipFirst )
 
 {
-    if( poOther->dfLevel != dfLevel )
-        return FALSE;
+    int nSkip = bSkipFirst ? 1 : 0;
+    int nNewPoints = poOther->nPoints - nSkip;
+    int nOldPoints = nPoints;
+    int i;
+
+    MakeRoomFor( nNewPoints, bAtHead );
+
+    if( bAtHead )
+    {
+        padfX -= nNewPoints;
+        padfY -= nNewPoints;
+        nFirstPoint -= nNewPoints;
+    }
+    nPoints += nNewPoints;
+
+    for( i = 0; i < nNewPoints; i++ )
+    {
+        int iSrc = bFromOtherHead ? i + nSkip
+                                  : poOther->nPoints - 1 - nSkip - i;
+        int iDst = bAtHead ? nNewPoints - 1 - i : nOldPoints + i;
+
+        padfX[iDst] = poOther->padfX[iSrc];
+        padfY[iDst] = poOther->padfY[iSrc];
+    }
+}
+
+/************************************************************************/
+/*                            MakeRoomFor()                             */
+/*                                                                      */
+/*      Make room for nNewPoints more points at the head or tail.       */
+/*      The points are kept in the middle of the buffers so that       */
+/*      contours can grow at both ends.                                 */
+/************************************************************************/
+
+void GDALContourItem::MakeRoomFor( int nNewPoints, int bAtHead )
+
+{
+    if( bAtHead ? nFirstPoint >= nNewPoints
+                : nFirstPoint + nPoints + nNewPoints <= nMaxPoints )
+        return;
+
+    int nNewMaxPoints = (nPoints + nNewPoints) * 2 + 50;
+    int nNewFirstPoint = (nNewMaxPoints - nPoints) / 2;
+    double *padfNewX = (double *) CPLMalloc(sizeof(double) * nNewMaxPoints);
+    double *padfNewY = (double *) CPLMalloc(sizeof(double) * nNewMaxPoints);
+
+    if( padfX != NULL )
+    {
+        memcpy( padfNewX + nNewFirstPoint, padfX, sizeof(double) * nPoints );
+        memcpy( padfNewY + nNewFirstPoint, padfY, sizeof(double) * nPoints );
+        CPLFree( padfX - nFirstPoint );
+        CPLFree( padfY - nFirstPoint );
+    }
+
+    nMaxPoints = nNewMaxPoints;
+    nFirstPoint = nNewFirstPoint;
+    padfX = padfNewX + nFirstPoint;
+    padfY = padfNewY + nFirstPoint;
+}
+
+/************************************************************************/
+/*                          PrepareEjection()                           */
+/************************************************************************/
+
+void GDALContourItem::PrepareEjection()
+
+{
+    /* If left side is the high side, then reverse to get curve normal
+    ** pointing downwards
+    */
+    if( bLeftIsHigh )
+    {
+        int i;
+
+        // Reverse the arrays
+        for( i = 0; i < nPoints / 2; i++ )
+        {
+            double dfTemp;
+            dfTemp = padfX[i];
+            padfX[i] = padfX[ nPoints - i - 1];
+            padfX[ nPoints - i - 1] = dfTemp;
+
+            dfTemp = padfY[i];
+            padfY[i] = padfY[ nPoints - i - 1];
+            padfY[ nPoints - i - 1] = dfTemp;
+        }
+    }
+
+    /* Start closed rings on their lowest point (the leftmost one in
+    ** case of ties), so that they do not depend on the order in which
+    ** their parts were joined.
+    */
+    if( bClosed && nPoints > 2 )
+    {
+        int i, iStart = 0;
+
+        for( i = 1; i < nPoints - 1; i++ )
+        {
+            if( padfY[i] > padfY[iStart]
+                || (padfY[i] == padfY[iStart] && padfX[i] < padfX[iStart]) )
+                iStart = i;
+        }
+
+        if( iStart > 0 )
+        {
+            std::rotate( padfX, padfX + iStart, padfX + nPoints - 1 );
+            std::rotate( padfY, padfY + iStart, padfY + nPoints - 1 );
+            padfX[nPoints-1] = padfX[0];
+            padfY[nPoints-1] = padfY[0];
+        }
+    }
+}
+
+
+/************************************************************************/
+/* ==================================================================== */
+/*                      GDALSortedContourGenerator                      */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                     GDALSortedContourGenerator()                     */
+/************************************************************************/
+
+GDALSortedContourGenerator::GDALSortedContourGenerator(
+    int nWidthIn, int nHeightIn, GDALContourWriter pfnWriterIn, 
+    void *pWriterCBDataIn )
+        : GDALContourGenerator( nWidthIn, nHeightIn, 
+                                pfnWriterIn, pWriterCBDataIn )
+{
+    nLevelMax = 0;
+    nLevelCount = 0;
+    papoLevels = NULL;
+}
+
+/************************************************************************/
+/*                    ~GDALSortedContourGenerator()                     */
+/************************************************************************/
+
+GDALSortedContourGenerator::~GDALSortedContourGenerator()
+
+{
+    int i;
+
+    for( i = 0; i < nLevelCount; i++ )
+        delete papoLevels[i];
+    CPLFree( papoLevels );
+}
+
+/************************************************************************/
+/*                             AddSegment()                             */
+/************************************************************************/
+
+CPLErr GDALSortedContourGenerator::AddSegment( double dfLevel, 
+                                               double dfX1, double dfY1,
+                                               double dfX2, double dfY2,
+                                               int bLeftHigh )
+
+{
+    GDALSortedContourLevel *poLevel = FindLevel( dfLevel );
+    GDALSortedContourItem *poTarget;
+    int iTarget;
 
 /* -------------------------------------------------------------------- */
-/*      Try to matching up with one of the ends, and insert.            */
+/*      Check all active contours for any that this might attach        */
+/*      to. Eventually this should be recoded to find the contours      */
+/*      of the correct level more efficiently.                          */
 /* -------------------------------------------------------------------- */
-    if( fabs(padfX[nPoints-1]-poOther->padfX[0]) < JOIN_DIST 
-        && fabs(padfY[nPoints-1]-poOther->padfY[0]) < JOIN_DIST )
+
+    if( dfY1 < dfY2 )
+        iTarget = poLevel->FindContour( dfX1, dfY1 );
+    else
+        iTarget = poLevel->FindContour( dfX2, dfY2 );
+
+    if( iTarget != -1 )
     {
-        MakeRoomFor( nPoints + poOther->nPoints - 1 );
+        poTarget = poLevel->GetContour( iTarget );
 
-        memcpy( padfX + nPoints, poOther->padfX + 1, 
-                sizeof(double) * (poOther->nPoints-1) );
-        memcpy( padfY + nPoints, poOther->padfY + 1, 
-                sizeof(double) * (poOther->nPoints-1) );
-        nPoints += poOther->nPoints - 1;
+        poTarget->AddSegment( dfX1, dfY1, dfX2, dfY2, bLeftHigh );
 
-        bRecentlyAccessed = TRUE;
+        poLevel->AdjustContour( iTarget );
+        
+        return CE_None;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      No existing contour found, lets create a new one.               */
+/* -------------------------------------------------------------------- */
+    poTarget = new GDALSortedContourItem( dfLevel );
+
+    poTarget->AddSegment( dfX1, dfY1, dfX2, dfY2, bLeftHigh );
+
+    poLevel->InsertContour( poTarget );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                             StartLine()                              */
+/************************************************************************/
+
+void GDALSortedContourGenerator::StartLine()
+
+{
+/* -------------------------------------------------------------------- */
+/*      Clear the recently used flags on the contours so we can         */
+/*      check later which ones were touched for this scanline.          */
+/* -------------------------------------------------------------------- */
+    int iLevel, iContour;
+
+    for( iLevel = 0; iLevel < nLevelCount; iLevel++ )
+    {
+        GDALSortedContourLevel *poLevel = papoLevels[iLevel];
+
+        for( iContour = 0; iContour < poLevel->GetContourCount(); iContour++ )
+            poLevel->GetContour( iContour )->bRecentlyAccessed = FALSE;
+    }
+}
+
+/************************************************************************/
+/*                           EjectContours()                            */
+/************************************************************************/
+
+CPLErr GDALSortedContourGenerator::EjectContours( int bOnlyUnused )
+
+{
+    int iLevel;
+    CPLErr eErr = CE_None;
+
+/* -------------------------------------------------------------------- */
+/*      Process all contours of all levels that match our criteria      */
+/* -------------------------------------------------------------------- */
+    for( iLevel = 0; iLevel < nLevelCount && eErr == CE_None; iLevel++ )
+    {
+        GDALSortedContourLevel *poLevel = papoLevels[iLevel];
+        int iContour;
+
+        for( iContour = 0; 
+             iContour < poLevel->GetContourCount() && eErr == CE_None; 
+             /* increment in loop if we don't consume it. */ )
+        {
+            int  iC2;
+            GDALSortedContourItem *poTarget = poLevel->GetContour( iContour );
+            
+            if( bOnlyUnused && poTarget->bRecentlyAccessed )
+            {
+                iContour++;
+                continue;
+            }
+
+            poLevel->RemoveContour( iContour );
+
+            // Try to find another contour we can merge with in this level.
+            
+            for( iC2 = 0; iC2 < poLevel->GetContourCount(); iC2++ )
+            {
+                GDALSortedContourItem *poOther = poLevel->GetContour( iC2 );
+
+                if( poOther->Merge( poTarget ) )
+                    break;
+            }
+
+            // If we didn't merge it, then eject (write) it out. 
+            if( iC2 == poLevel->GetContourCount() )
+            {
+                if( pfnWriter != NULL )
+                {
+                    // If direction is wrong, then reverse before ejecting.
+                    poTarget->PrepareEjection();
+
+                    eErr = pfnWriter( poTarget->dfLevel, poTarget->nPoints, 
+                                      poTarget->padfX, poTarget->padfY, 
+                                      pWriterCBData );
+                }
+            }
+
+            delete poTarget;
+        }
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                             FindLevel()                              */
+/************************************************************************/
+
+GDALSortedContourLevel *GDALSortedContourGenerator::FindLevel( double dfLevel )
+
+{
+    int nStart=0, nEnd=nLevelCount-1, nMiddle;
+
+/* -------------------------------------------------------------------- */
+/*      Binary search to find the requested level.                      */
+/* -------------------------------------------------------------------- */
+    while( nStart <= nEnd )
+    {
+        nMiddle = (nEnd + nStart) / 2;
+
+        double dfMiddleLevel = papoLevels[nMiddle]->GetLevel();
+
+        if( dfMiddleLevel < dfLevel )
+            nStart = nMiddle + 1;
+        else if( dfMiddleLevel > dfLevel )
+            nEnd = nMiddle - 1;
+        else
+            return papoLevels[nMiddle];
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Didn't find the level, create a new one and insert it in        */
+/*      order.                                                          */
+/* -------------------------------------------------------------------- */
+    GDALSortedContourLevel *poLevel = new GDALSortedContourLevel( dfLevel );
+
+    if( nLevelMax == nLevelCount )
+    {
+        nLevelMax = nLevelMax * 2 + 10;
+        papoLevels = (GDALSortedContourLevel **) 
+            CPLRealloc( papoLevels, sizeof(void*) * nLevelMax );
+    }
+
+    if( nLevelCount - nEnd - 1 > 0 )
+        memmove( papoLevels + nEnd + 2, papoLevels + nEnd + 1, 
+                 (nLevelCount - nEnd - 1) * sizeof(void*) );
+    papoLevels[nEnd+1] = poLevel;
+    nLevelCount++;
+
+    return poLevel;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                        GDALSortedContourLevel                        */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                       GDALSortedContourLevel()                       */
+/************************************************************************/
+
+GDALSortedContourLevel::GDALSortedContourLevel( double dfLevelIn )
+
+{
+    dfLevel = dfLevelIn;
+    nEntryMax = 0;
+    nEntryCount = 0;
+    papoEntries = NULL;
+}
+
+/************************************************************************/
+/*                      ~GDALSortedContourLevel()                       */
+/************************************************************************/
+
+GDALSortedContourLevel::~GDALSortedContourLevel()
+
+{
+    CPLAssert( nEntryCount == 0 );
+    CPLFree( papoEntries );
+}
+
+/************************************************************************/
+/*                           AdjustContour()                            */
+/*                                                                      */
+/*      Assume the indicated contour's tail may have changed, and       */
+/*      adjust it up or down in the list of contours to re-establish    */
+/*      proper ordering.                                                */
+/************************************************************************/
+
+void GDALSortedContourLevel::AdjustContour( int iChanged )
+
+{
+    while( iChanged > 0 
+         && papoEntries[iChanged]->dfTailX < papoEntries[iChanged-1]->dfTailX )
+    {
+        GDALSortedContourItem *poTemp = papoEntries[iChanged];
+        papoEntries[iChanged] = papoEntries[iChanged-1];
+        papoEntries[iChanged-1] = poTemp;
+        iChanged--;
+    }
+
+    while( iChanged < nEntryCount-1
+         && papoEntries[iChanged]->dfTailX > papoEntries[iChanged+1]->dfTailX )
+    {
+        GDALSortedContourItem *poTemp = papoEntries[iChanged];
+        papoEntries[iChanged] = papoEntries[iChanged+1];
+        papoEntries[iChanged+1] = poTemp;
+        iChanged++;
+    }
+}
+
+/************************************************************************/
+/*                           RemoveContour()                            */
+/************************************************************************/
+
+void GDALSortedContourLevel::RemoveContour( int iTarget )
+
+{
+    if( iTarget < nEntryCount )
+        memmove( papoEntries + iTarget, papoEntries + iTarget + 1, 
+                 (nEntryCount - iTarget - 1) * sizeof(void*) );
+    nEntryCount--;
+}
+
+/************************************************************************/
+/*                            FindContour()                             */
+/*                                                                      */
+/*      Perform a binary search to find the requested "tail"            */
+/*      location.  If not available return -1.  In theory there can     */
+/*      be more than one contour with the same tail X and different     */
+/*      Y tails ... ensure we check against them all.                   */
+/************************************************************************/
+
+int GDALSortedContourLevel::FindContour( double dfX, double dfY )
+
+{
+    int nStart = 0, nEnd = nEntryCount-1, nMiddle;
+
+    while( nEnd >= nStart )
+    {
+        nMiddle = (nEnd + nStart) / 2;
+
+        double dfMiddleX = papoEntries[nMiddle]->dfTailX;
+
+        if( dfMiddleX < dfX )
+            nStart = nMiddle + 1;
+        else if( dfMiddleX > dfX )
+            nEnd = nMiddle - 1;
+        else
+        {
+            while( nMiddle > 0 
+                   && fabs(papoEntries[nMiddle]->dfTailX-dfX) < JOIN_DIST )
+                nMiddle--;
+
+            while( nMiddle < nEntryCount
+                   && fabs(papoEntries[nMiddle]->dfTailX-dfX) < JOIN_DIST )
+            {
+                if( fabs(papoEntries[nMiddle]->padfY[papoEntries[nMiddle]->nPoints-1] - dfY) < JOIN_DIST )
+                    return nMiddle;
+                nMiddle++;
+            }
+
+            return -1;
+        }
+    }
+
+    return -1;
+}
+
+/************************************************************************/
+/*                           InsertContour()                            */
+/*                                                                      */
+/*      Ensure the newly added contour is placed in order according     */
+/*      to the X value relative to the other contours.                  */
+/************************************************************************/
+
+int GDALSortedContourLevel::InsertContour( GDALSortedContourItem *poNewContour )
+
+{
+/* -------------------------------------------------------------------- */
+/*      Find where to insert by binary search.                          */
+/* -------------------------------------------------------------------- */
+    int nStart = 0, nEnd = nEntryCount-1, nMiddle;
+
+    while( nEnd >= nStart )
+    {
+        nMiddle = (nEnd + nStart) / 2;
+
+        double dfMiddleX = papoEntries[nMiddle]->dfTailX;
+
+        if( dfMiddleX < poNewContour->dfLevel )
+            nStart = nMiddle + 1;
+        else if( dfMiddleX > poNewContour->dfLevel )
+            nEnd = nMiddle - 1;
+        else
+        {
+            nEnd = nMiddle - 1;
+            break;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Do we need to grow the array?                                   */
+/* -------------------------------------------------------------------- */
+    if( nEntryMax == nEntryCount )
+    {
+        nEntryMax = nEntryMax * 2 + 10;
+        papoEntries = (GDALSortedContourItem **) 
+            CPLRealloc( papoEntries, sizeof(void*) * nEntryMax );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Insert the new contour at the appropriate location.             */
+/* -------------------------------------------------------------------- */
+    if( nEntryCount - nEnd - 1 > 0 )
+        memmove( papoEntries + nEnd + 2, papoEntries + nEnd + 1, 
+                 (nEntryCount - nEnd - 1) * sizeof(void*) );
+    papoEntries[nEnd+1] = poNewContour;
+    nEntryCount++;
+
+    return nEnd+1;
+}
+
+
+/************************************************************************/
+/* ==================================================================== */
+/*                        GDALSortedContourItem                         */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                       GDALSortedContourItem()                        */
+/************************************************************************/
+
+GDALSortedContourItem::GDALSortedContourItem( double dfLevelIn )
+
+{
+    dfLevel = dfLevelIn;
+    bRecentlyAccessed = FALSE;
+    nPoints = 0;
+    nMaxPoints = 0;
+    padfX = NULL;
+    padfY = NULL;
+    
+    bLeftIsHigh = FALSE;
+
+    dfTailX = 0.0;
+}
+
+/************************************************************************/
+/*                       ~GDALSortedContourItem()                       */
+/************************************************************************/
+
+GDALSortedContourItem::~GDALSortedContourItem()
+
+{
+    CPLFree( padfX );
+    CPLFree( padfY );
+}
+
+/************************************************************************/
+/*                             AddSegment()                             */
+/************************************************************************/
+
+int GDALSortedContourItem::AddSegment( double dfXStart, double dfYStart, 
+                                 double dfXEnd, double dfYEnd,
+                                 int bLeftHigh)
+
+{
+    MakeRoomFor( nPoints + 1 );
+
+/* -------------------------------------------------------------------- */
+/*      If there are no segments, just add now.                         */
+/* -------------------------------------------------------------------- */
+    if( nPoints == 0 )
+    {
+        nPoints = 2;
+
+        padfX[0] = dfXStart;
+        padfY[0] = dfYStart;
+        padfX[1] = dfXEnd;
+        padfY[1] = dfYEnd;
+        bRecentlyAccessed = TRUE;
+
+        dfTailX = padfX[1];
+
+        // Here we know that the left of this vector is the high side
+        bLeftIsHigh = bLeftHigh;
+
+        return TRUE;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Try to matching up with one of the ends, and insert.            */
+/* -------------------------------------------------------------------- */
+    if( fabs(padfX[nPoints-1]-dfXStart) < JOIN_DIST 
+             && fabs(padfY[nPoints-1]-dfYStart) < JOIN_DIST )
+    {
+        padfX[nPoints] = dfXEnd;
+        padfY[nPoints] = dfYEnd;
+        nPoints++;
+
+        bRecentlyAccessed = TRUE;
+
+        dfTailX = dfXEnd;
+
+        return TRUE;
+    }
+    else if( fabs(padfX[nPoints-1]-dfXEnd) < JOIN_DIST 
+             && fabs(padfY[nPoints-1]-dfYEnd) < JOIN_DIST )
+    {
+        padfX[nPoints] = dfXStart;
+        padfY[nPoints] = dfYStart;
+        nPoints++;
+
+        bRecentlyAccessed = TRUE;
+
+        dfTailX = dfXStart;
+
+        return TRUE;
+    }
+    else
+        return FALSE;
+}
+ 
+/************************************************************************/
+/*                               Merge()                                */
+/************************************************************************/
+
+int GDALSortedContourItem::Merge( GDALSortedContourItem *poOther )
+
+{
+    if( poOther->dfLevel != dfLevel )
+        return FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      Try to matching up with one of the ends, and insert.            */
+/* -------------------------------------------------------------------- */
+    if( fabs(padfX[nPoints-1]-poOther->padfX[0]) < JOIN_DIST 
+        && fabs(padfY[nPoints-1]-poOther->padfY[0]) < JOIN_DIST )
+    {
+        MakeRoomFor( nPoints + poOther->nPoints - 1 );
+
+        memcpy( padfX + nPoints, poOther->padfX + 1, 
+                sizeof(double) * (poOther->nPoints-1) );
+        memcpy( padfY + nPoints, poOther->padfY + 1, 
+                sizeof(double) * (poOther->nPoints-1) );
+        nPoints += poOther->nPoints - 1;
+
+        bRecentlyAccessed = TRUE;
+
+        dfTailX = padfX[nPoints-1];
+
+        return TRUE;
+    }
+    else if( fabs(padfX[0]-poOther->padfX[poOther->nPoints-1]) < JOIN_DIST 
+             && fabs(padfY[0]-poOther->padfY[poOther->nPoints-1]) < JOIN_DIST )
+    {
+        MakeRoomFor( nPoints + poOther->nPoints - 1 );
+
+        memmove( padfX + poOther->nPoints - 1, padfX, 
+                sizeof(double) * nPoints );
+        memmove( padfY + poOther->nPoints - 1, padfY, 
+                sizeof(double) * nPoints );
+        memcpy( padfX, poOther->padfX, 
+                sizeof(double) * (poOther->nPoints-1) );
+        memcpy( padfY, poOther->padfY, 
+                sizeof(double) * (poOther->nPoints-1) );
+        nPoints += poOther->nPoints - 1;
+
+        bRecentlyAccessed = TRUE;
+
+        dfTailX = padfX[nPoints-1];
+
+        return TRUE;
+    }
+    else if( fabs(padfX[nPoints-1]-poOther->padfX[poOther->nPoints-1]) < JOIN_DIST 
+        && fabs(padfY[nPoints-1]-poOther->padfY[poOther->nPoints-1]) < JOIN_DIST )
+    {
+        int i;
+
+        MakeRoomFor( nPoints + poOther->nPoints - 1 );
+
+        for( i = 0; i < poOther->nPoints-1; i++ )
+        {
+            padfX[i+nPoints] = poOther->padfX[poOther->nPoints-i-2];
+            padfY[i+nPoints] = poOther->padfY[poOther->nPoints-i-2];
+        }
+
+        nPoints += poOther->nPoints - 1;
+
+        bRecentlyAccessed = TRUE;
+
+        dfTailX = padfX[nPoints-1];
+
+        return TRUE;
+    }
+    else if( fabs(padfX[0]-poOther->padfX[0]) < JOIN_DIST 
+        && fabs(padfY[0]-poOther->padfY[0]) < JOIN_DIST )
+    {
+        int i;
+
+        MakeRoomFor( nPoints + poOther->nPoints - 1 );
+
+        memmove( padfX + poOther->nPoints - 1, padfX, 
+                sizeof(double) * nPoints );
+        memmove( padfY + poOther->nPoints - 1, padfY, 
+                sizeof(double) * nPoints );
+
+        for( i = 0; i < poOther->nPoints-1; i++ )
+        {
+            padfX[i] = poOther->padfX[poOther->nPoints - i - 1];
+            padfY[i] = poOther->padfY[poOther->nPoints - i - 1];
+        }
+
+        nPoints += poOther->nPoints - 1;
+
+        bRecentlyAccessed = TRUE;
+
+        dfTailX = padfX[nPoints-1];
+
+        return TRUE;
+    }
+    else
+        return FALSE;
+}
+
+/************************************************************************/
+/*                            MakeRoomFor()                             */
+/************************************************************************/
+
+void GDALSortedContourItem::MakeRoomFor( int nNewPoints )
+
+{
+    if( nNewPoints > nMaxPoints )
+    {
+        nMaxPoints = nNewPoints * 2 + 50;
+        padfX = (double *) CPLRealloc(padfX,sizeof(double) * nMaxPoints);
+        padfY = (double *) CPLRealloc(padfY,sizeof(double) * nMaxPoints);
+    }
+}
+
+/************************************************************************/
+/*                          PrepareEjection()                           */
+/************************************************************************/
+
+void GDALSortedContourItem::PrepareEjection()
+
+{
+    /* If left side is the high side, then reverse to get curve normal
+    ** pointing downwards
+    */
+    if( bLeftIsHigh )
+    {
+        int i;
+
+        // Reverse the arrays
+        for( i = 0; i < nPoints / 2; i++ )
+        {
+            double dfTemp;
+            dfTemp = padfX[i];
+            padfX[i] = padfX[ nPoints - i - 1];
+            padfX[ nPoints - i - 1] = dfTemp;
+            
+            dfTemp = padfY[i];
+            padfY[i] = padfY[ nPoints - i - 1];
+            padfY[ nPoints - i - 1] = dfTemp;
+        }
+    }
+}
+
+
+/************************************************************************/
+/* ==================================================================== */
+/*                   Additional C Callable Functions                    */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                       OGRContourWriterLine()                         */
+/*                                                                      */
+/*      Build the georeferenced geometry of a contour.                  */
+/************************************************************************/
+
+static OGRGeometryH OGRContourWriterLine( OGRContourWriterInfo *poInfo,
+                                          double dfLevel, int nPoints,
+                                          const double *padfX,
+                                          const double *padfY )
+
+{
+    OGRLineString *poLine = new OGRLineString();
+    int iPoint;
+
+    poLine->setNumPoints( nPoints );
+
+    for( iPoint = 0; iPoint < nPoints; iPoint++ )
+    {
+        poLine->setPoint( iPoint,
+                          poInfo->adfGeoTransform[0]
+                          + poInfo->adfGeoTransform[1] * padfX[iPoint]
+                          + poInfo->adfGeoTransform[2] * padfY[iPoint],
+                          poInfo->adfGeoTransform[3]
+                          + poInfo->adfGeoTransform[4] * padfX[iPoint]
+                          + poInfo->adfGeoTransform[5] * padfY[iPoint],
+                          dfLevel );
+    }
+
+    return (OGRGeometryH) poLine;
+}
+
+/************************************************************************/
+/*                          OGRContourWriter()                          */
+/************************************************************************/
+
+CPLErr OGRContourWriter( double dfLevel,
+                         int nPoints, double *padfX, double *padfY,
+                         void *pInfo )
+
+{
+    OGRContourWriterInfo *poInfo = (OGRContourWriterInfo *) pInfo;
+    OGRFeatureH hFeat;
+
+    hFeat = OGR_F_Create( OGR_L_GetLayerDefn( (OGRLayerH) poInfo->hLayer ) );
+
+    if( poInfo->nIDField != -1 )
+        OGR_F_SetFieldInteger( hFeat, poInfo->nIDField, poInfo->nNextID++ );
+
+    if( poInfo->nElevField != -1 )
+        OGR_F_SetFieldDouble( hFeat, poInfo->nElevField, dfLevel );
+
+    OGR_F_SetGeometryDirectly( hFeat,
+                               OGRContourWriterLine( poInfo, dfLevel, nPoints,
+                                                     padfX, padfY ) );
+
+    OGR_L_CreateFeature( (OGRLayerH) poInfo->hLayer, hFeat );
+    OGR_F_Destroy( hFeat );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                           GDALContourBatch                           */
+/*                                                                      */
+/*      Contours waiting to be written out to the layer.  If psInfo     */
+/*      is set, the batch is written out every CONTOUR_BATCH_SIZE       */
+/*      contours, otherwise only when Flush() is called.                */
+/* ==================================================================== */
+/************************************************************************/
+
+class GDALContourBatch
+{
+public:
+    OGRContourWriterInfo *psInfo;
+
+    std::vector<double> adfLevels;
+    std::vector<int>    anPointCounts;
+    std::vector<double> adfX;
+    std::vector<double> adfY;
+
+    GDALContourBatch() : psInfo(NULL) {}
+
+    CPLErr Flush( OGRContourWriterInfo *psInfoIn );
+};
+
+/************************************************************************/
+/*                               Flush()                                */
+/*                                                                      */
+/*      Write out the contours of the batch, reusing a single           */
+/*      feature.                                                        */
+/************************************************************************/
+
+CPLErr GDALContourBatch::Flush( OGRContourWriterInfo *psInfoIn )
+
+{
+    if( adfLevels.empty() )
+        return CE_None;
+
+    OGRLayerH hLayer = (OGRLayerH) psInfoIn->hLayer;
+    OGRFeatureH hFeat = OGR_F_Create( OGR_L_GetLayerDefn( hLayer ) );
+    size_t iPoint = 0;
+
+    for( size_t i = 0; i < adfLevels.size(); i++ )
+    {
+        OGR_F_SetFID( hFeat, OGRNullFID );
+
+        if( psInfoIn->nIDField != -1 )
+            OGR_F_SetFieldInteger( hFeat, psInfoIn->nIDField,
+                                   psInfoIn->nNextID++ );
+
+        if( psInfoIn->nElevField != -1 )
+            OGR_F_SetFieldDouble( hFeat, psInfoIn->nElevField,
+                                  adfLevels[i] );
+
+        OGR_F_SetGeometryDirectly(
+            hFeat, OGRContourWriterLine( psInfoIn, adfLevels[i],
+                                         anPointCounts[i],
+                                         &adfX[iPoint], &adfY[iPoint] ) );
+
+        OGR_L_CreateFeature( hLayer, hFeat );
+
+        iPoint += anPointCounts[i];
+    }
+
+    OGR_F_Destroy( hFeat );
+
+    std::vector<double>().swap( adfLevels );
+    std::vector<int>().swap( anPointCounts );
+    std::vector<double>().swap( adfX );
+    std::vector<double>().swap( adfY );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                       GDALContourBatchWriter()                       */
+/************************************************************************/
+
+static CPLErr GDALContourBatchWriter( double dfLevel,
+                                      int nPoints, double *padfX,
+                                      double *padfY, void *pInfo )
+
+{
+    GDALContourBatch *poBatch = (GDALContourBatch *) pInfo;
+
+    poBatch->adfLevels.push_back( dfLevel );
+    poBatch->anPointCounts.push_back( nPoints );
+    poBatch->adfX.insert( poBatch->adfX.end(), padfX, padfX + nPoints );
+    poBatch->adfY.insert( poBatch->adfY.end(), padfY, padfY + nPoints );
+
+    if( poBatch->psInfo != NULL
+        && (int) poBatch->adfLevels.size() >= CONTOUR_BATCH_SIZE )
+        return poBatch->Flush( poBatch->psInfo );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                      Multithreaded generation                        */
+/*                                                                      */
+/*      The raster is split in strips of lines that are contoured       */
+/*      independently in several threads.  Each strip batches its       */
+/*      contours, that are written out in strip order by the main       */
+/*      thread, except those ending on a strip edge: these are          */
+/*      joined together at the end.                                     */
+/* ==================================================================== */
+/************************************************************************/
+
+// The minimum number of lines of a strip.
+
+#define CONTOUR_MIN_STRIP_LINES 16
+
+class GDALContourStrip
+{
+public:
+    int              iStartLine;
+    int              iEndLine;
+    int              bDone;
+
+    GDALContourBatch oBatch;
+    std::vector<GDALContourItem *> apoSeamContours;
+
+    ~GDALContourStrip()
+        {
+            for( size_t i = 0; i < apoSeamContours.size(); i++ )
+                delete apoSeamContours[i];
+        }
+};
+
+class GDALContourJob
+{
+public:
+    GDALRasterBandH hBand;
+    int             nXSize;
+    int             nYSize;
+
+    double          dfContourInterval;
+    double          dfContourBase;
+    int             nFixedLevelCount;
+    double         *padfFixedLevels;
+    int             bUseNoData;
+    double          dfNoDataValue;
+
+    std::vector<GDALContourStrip *> apoStrips;
+    int             nNextFlush;
+
+    void           *hMutex;
+    CPLErr          eErr;
+    int             nNextStrip;
+    int             nLinesDone;
+
+    OGRContourWriterInfo *psInfo;
+    GDALProgressFunc pfnProgress;
+    void           *pProgressArg;
+};
+
+/************************************************************************/
+/*                          GDALContourSetup()                          */
+/************************************************************************/
+
+static void GDALContourSetup( GDALContourGenerator *poCG,
+                              GDALContourJob *psJob )
+
+{
+    if( psJob->nFixedLevelCount > 0 )
+        poCG->SetFixedLevels( psJob->nFixedLevelCount,
+                              psJob->padfFixedLevels );
+    else
+        poCG->SetContourLevels( psJob->dfContourInterval,
+                                psJob->dfContourBase );
+
+    if( psJob->bUseNoData )
+        poCG->SetNoData( psJob->dfNoDataValue );
+}
+
+/************************************************************************/
+/*                         GDALContourSetError()                        */
+/************************************************************************/
+
+static void GDALContourSetError( GDALContourJob *psJob, CPLErr eErr )
+
+{
+    CPLAcquireMutex( psJob->hMutex, 1000.0 );
+    if( psJob->eErr == CE_None )
+        psJob->eErr = eErr;
+    CPLReleaseMutex( psJob->hMutex );
+}
+
+/************************************************************************/
+/*                       GDALContourLinesDone()                         */
+/*                                                                      */
+/*      Account for processed lines, and report progress from the       */
+/*      main thread.                                                    */
+/************************************************************************/
+
+static CPLErr GDALContourLinesDone( GDALContourJob *psJob, int nLines,
+                                    int bMainThread )
+
+{
+    CPLAcquireMutex( psJob->hMutex, 1000.0 );
+    psJob->nLinesDone += nLines;
+    double dfComplete = psJob->nLinesDone / (double) psJob->nYSize;
+    CPLErr eErr = psJob->eErr;
+    CPLReleaseMutex( psJob->hMutex );
+
+    if( bMainThread && eErr == CE_None
+        && !psJob->pfnProgress( dfComplete, "", psJob->pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                       GDALContourProcessStrip()                      */
+/************************************************************************/
+
+static CPLErr GDALContourProcessStrip( GDALContourJob *psJob,
+                                       GDALContourStrip *poStrip,
+                                       int bMainThread )
+
+{
+    int nXSize = psJob->nXSize;
+    double *padfScanline;
+    CPLErr eErr = CE_None;
+    int iLine;
+
+    padfScanline = (double *) VSIMalloc2( sizeof(double), nXSize );
+    if( padfScanline == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VSIMalloc(): Out of memory in GDALContourGenerate" );
+        return CE_Failure;
+    }
+
+    GDALStreamingContourGenerator oCG( nXSize, psJob->nYSize,
+                                       GDALContourBatchWriter,
+                                       &poStrip->oBatch );
+
+    GDALContourSetup( &oCG, psJob );
+
+    if( poStrip->iStartLine == 0 )
+        oCG.SetStrip( 0, poStrip->iEndLine, NULL );
+
+/* -------------------------------------------------------------------- */
+/*      Feed the lines of the strip, starting with the one above.       */
+/* -------------------------------------------------------------------- */
+    for( iLine = MAX(0, poStrip->iStartLine - 1);
+         iLine < poStrip->iEndLine && eErr == CE_None; iLine++ )
+    {
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        eErr = GDALRasterIO( psJob->hBand, GF_Read, 0, iLine, nXSize, 1,
+                             padfScanline, nXSize, 1, GDT_Float64, 0, 0 );
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( eErr != CE_None )
+            break;
+
+        if( iLine < poStrip->iStartLine )
+            oCG.SetStrip( poStrip->iStartLine, poStrip->iEndLine,
+                          padfScanline );
+        else
+        {
+            eErr = oCG.FeedLine( padfScanline );
+            if( eErr == CE_None )
+                eErr = GDALContourLinesDone( psJob, 1, bMainThread );
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Set aside the contours still open at the strip bottom.          */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None && poStrip->iEndLine < psJob->nYSize )
+        eErr = oCG.EjectContours( FALSE );
+
+    poStrip->apoSeamContours.swap( oCG.GetSeamContours() );
+
+    CPLFree( padfScanline );
+
+    CPLAcquireMutex( psJob->hMutex, 1000.0 );
+    poStrip->bDone = TRUE;
+    CPLReleaseMutex( psJob->hMutex );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                        GDALContourFlushStrips()                      */
+/*                                                                      */
+/*      Write out the contours of the strips done so far, in order.     */
+/*      Only called from the main thread.                               */
+/************************************************************************/
+
+static CPLErr GDALContourFlushStrips( GDALContourJob *psJob )
+
+{
+    CPLErr eErr = CE_None;
+
+    while( eErr == CE_None
+           && psJob->nNextFlush < (int) psJob->apoStrips.size() )
+    {
+        GDALContourStrip *poStrip = psJob->apoStrips[psJob->nNextFlush];
+
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        int bDone = poStrip->bDone;
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( !bDone )
+            break;
+
+        eErr = poStrip->oBatch.Flush( psJob->psInfo );
+        psJob->nNextFlush++;
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                        GDALContourRunStrips()                        */
+/************************************************************************/
+
+static CPLErr GDALContourRunStrips( GDALContourJob *psJob, int bMainThread )
+
+{
+    while( TRUE )
+    {
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        int iStrip = psJob->nNextStrip++;
+        int bStop = (iStrip >= (int) psJob->apoStrips.size()
+                     || psJob->eErr != CE_None);
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( bStop )
+            return CE_None;
+
+        CPLErr eErr = GDALContourProcessStrip( psJob,
+                                               psJob->apoStrips[iStrip],
+                                               bMainThread );
+
+        if( eErr == CE_None && bMainThread )
+            eErr = GDALContourFlushStrips( psJob );
+
+        if( eErr != CE_None )
+        {
+            GDALContourSetError( psJob, eErr );
+            return eErr;
+        }
+    }
+}
+
+typedef struct
+{
+    GDALContourJob *psJob;
+    int             bMainThread;    /* the one writing the contours */
+} GDALContourThreadData;
+
+static CPLErr GDALContourStripsJob( void *pData )
+
+{
+    GDALContourThreadData *psThreadData = (GDALContourThreadData *) pData;
+
+    return GDALContourRunStrips( psThreadData->psJob,
+                                 psThreadData->bMainThread );
+}
+
+/************************************************************************/
+/*                     GDALContourGenerateStrips()                      */
+/************************************************************************/
+
+static CPLErr GDALContourGenerateStrips( GDALContourJob *psJob,
+                                         int nThreads, int nStripLines )
 
-        dfTailX = padfX[nPoints-1];
+{
+    int iThread, iStrip;
 
-        return TRUE;
-    }
-    else if( fabs(padfX[0]-poOther->padfX[poOther->nPoints-1]) < JOIN_DIST 
-             && fabs(padfY[0]-poOther->padfY[poOther->nPoints-1]) < JOIN_DIST )
+    for( int iStartLine = 0; iStartLine < psJob->nYSize;
+         iStartLine += nStripLines )
     {
-        MakeRoomFor( nPoints + poOther->nPoints - 1 );
+        GDALContourStrip *poStrip = new GDALContourStrip();
 
-        memmove( padfX + poOther->nPoints - 1, padfX, 
-                sizeof(double) * nPoints );
-        memmove( padfY + poOther->nPoints - 1, padfY, 
-                sizeof(double) * nPoints );
-        memcpy( padfX, poOther->padfX, 
-                sizeof(double) * (poOther->nPoints-1) );
-        memcpy( padfY, poOther->padfY, 
-                sizeof(double) * (poOther->nPoints-1) );
-        nPoints += poOther->nPoints - 1;
+        poStrip->iStartLine = iStartLine;
+        poStrip->iEndLine = MIN(iStartLine + nStripLines, psJob->nYSize);
+        poStrip->bDone = FALSE;
+        psJob->apoStrips.push_back( poStrip );
+    }
 
-        bRecentlyAccessed = TRUE;
+    psJob->hMutex = CPLCreateMutex();
+    CPLReleaseMutex( psJob->hMutex );
 
-        dfTailX = padfX[nPoints-1];
+/* -------------------------------------------------------------------- */
+/*      Contour the strips.                                             */
+/* -------------------------------------------------------------------- */
+    GDALContourThreadData *pasThreadData = (GDALContourThreadData *)
+        CPLCalloc( sizeof(GDALContourThreadData), nThreads );
+    void **papThreadData = (void **) CPLCalloc( sizeof(void *), nThreads );
 
-        return TRUE;
-    }
-    else if( fabs(padfX[nPoints-1]-poOther->padfX[poOther->nPoints-1]) < JOIN_DIST 
-        && fabs(padfY[nPoints-1]-poOther->padfY[poOther->nPoints-1]) < JOIN_DIST )
+    for( iThread = 0; iThread < nThreads; iThread++ )
     {
-        int i;
-
-        MakeRoomFor( nPoints + poOther->nPoints - 1 );
-
-        for( i = 0; i < poOther->nPoints-1; i++ )
-        {
-            padfX[i+nPoints] = poOther->padfX[poOther->nPoints-i-2];
-            padfY[i+nPoints] = poOther->padfY[poOther->nPoints-i-2];
-        }
+        pasThreadData[iThread].psJob = psJob;
+        pasThreadData[iThread].bMainThread = (iThread == 0);
+        papThreadData[iThread] = pasThreadData + iThread;
+    }
 
-        nPoints += poOther->nPoints - 1;
+    /* The first job is run by this thread, which writes out the */
+    /* contours of the strips done so far after each of its strips. */
+    CPLErr eErr = CPLRunJobs( GDALContourStripsJob, papThreadData, nThreads );
 
-        bRecentlyAccessed = TRUE;
+    CPLFree( papThreadData );
+    CPLFree( pasThreadData );
 
-        dfTailX = padfX[nPoints-1];
+    if( eErr == CE_None )
+        eErr = GDALContourFlushStrips( psJob );
 
-        return TRUE;
-    }
-    else if( fabs(padfX[0]-poOther->padfX[0]) < JOIN_DIST 
-        && fabs(padfY[0]-poOther->padfY[0]) < JOIN_DIST )
+/* -------------------------------------------------------------------- */
+/*      Join the contours crossing the strip edges, and write them      */
+/*      out.                                                            */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None )
     {
-        int i;
-
-        MakeRoomFor( nPoints + poOther->nPoints - 1 );
+        GDALContourBatch oBatch;
+        GDALStreamingContourGenerator oCG( psJob->nXSize, psJob->nYSize,
+                                           GDALContourBatchWriter, &oBatch );
 
-        memmove( padfX + poOther->nPoints - 1, padfX, 
-                sizeof(double) * nPoints );
-        memmove( padfY + poOther->nPoints - 1, padfY, 
-                sizeof(double) * nPoints );
+        oBatch.psInfo = psJob->psInfo;
 
-        for( i = 0; i < poOther->nPoints-1; i++ )
+        for( iStrip = 0; iStrip < (int) psJob->apoStrips.size(); iStrip++ )
         {
-            padfX[i] = poOther->padfX[poOther->nPoints - i - 1];
-            padfY[i] = poOther->padfY[poOther->nPoints - i - 1];
+            std::vector<GDALContourItem *> &apoSeamContours =
+                psJob->apoStrips[iStrip]->apoSeamContours;
+
+            for( size_t i = 0; i < apoSeamContours.size(); i++ )
+                oCG.AddSeamContour( apoSeamContours[i] );
+            apoSeamContours.clear();
         }
 
-        nPoints += poOther->nPoints - 1;
+        eErr = oCG.EjectContours( FALSE );
+        if( eErr == CE_None )
+            eErr = oBatch.Flush( psJob->psInfo );
+    }
 
-        bRecentlyAccessed = TRUE;
+    for( iStrip = 0; iStrip < (int) psJob->apoStrips.size(); iStrip++ )
+        delete psJob->apoStrips[iStrip];
+    psJob->apoStrips.clear();
 
-        dfTailX = padfX[nPoints-1];
+    CPLDestroyMutex( psJob->hMutex );
+    psJob->hMutex = NULL;
 
-        return TRUE;
+    if( eErr == CE_None
+        && !psJob->pfnProgress( 1.0, "", psJob->pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        eErr = CE_Failure;
     }
-    else
-        return FALSE;
+
+    return eErr;
 }
 
 /************************************************************************/
-/*                            MakeRoomFor()                             */
+/*                     GDALContourGenerateInternal()                    */
 /************************************************************************/
 
-void GDALContourItem::MakeRoomFor( int nNewPoints )
+static CPLErr
+GDALContourGenerateInternal( GDALRasterBandH hBand,
+                             double dfContourInterval, double dfContourBase,
+                             int nFixedLevelCount, double *padfFixedLevels,
+                             int bUseNoData, double dfNoDataValue,
+                             void *hLayer, int iIDField, int iElevField,
+                             int bStreaming, int nThreads,
+                             GDALProgressFunc pfnProgress, void *pProgressArg )
 
 {
-    if( nNewPoints > nMaxPoints )
+    OGRContourWriterInfo oCWI;
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    if( !pfnProgress( 0.0, "", pProgressArg ) )
     {
-        nMaxPoints = nNewPoints * 2 + 50;
-        padfX = (double *) CPLRealloc(padfX,sizeof(double) * nMaxPoints);
-        padfY = (double *) CPLRealloc(padfY,sizeof(double) * nMaxPoints);
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
     }
-}
 
-/************************************************************************/
-/*                          PrepareEjection()                           */
-/************************************************************************/
+/* -------------------------------------------------------------------- */
+/*      Setup contour writer information.                               */
+/* -------------------------------------------------------------------- */
+    GDALDatasetH hSrcDS;
 
-void GDALContourItem::PrepareEjection()
+    oCWI.hLayer = (OGRLayerH) hLayer;
 
-{
-    /* If left side is the high side, then reverse to get curve normal
-    ** pointing downwards
-    */
-    if( bLeftIsHigh )
-    {
-        int i;
+    oCWI.nElevField = iElevField;
+    oCWI.nIDField = iIDField;
 
-        // Reverse the arrays
-        for( i = 0; i < nPoints / 2; i++ )
-        {
-            double dfTemp;
-            dfTemp = padfX[i];
-            padfX[i] = padfX[ nPoints - i - 1];
-            padfX[ nPoints - i - 1] = dfTemp;
-            
-            dfTemp = padfY[i];
-            padfY[i] = padfY[ nPoints - i - 1];
-            padfY[ nPoints - i - 1] = dfTemp;
-        }
-    }
-}
+    hSrcDS = GDALGetBandDataset( hBand );
+    GDALGetGeoTransform( hSrcDS, oCWI.adfGeoTransform );
+    oCWI.nNextID = 0;
 
+/* -------------------------------------------------------------------- */
+/*      Setup the job description.                                      */
+/* -------------------------------------------------------------------- */
+    GDALContourJob sJob;
+    int nXSize = GDALGetRasterBandXSize( hBand );
+    int nYSize = GDALGetRasterBandYSize( hBand );
 
-/************************************************************************/
-/* ==================================================================== */
-/*                   Additional C Callable Functions                    */
-/* ==================================================================== */
-/************************************************************************/
+    sJob.hBand = hBand;
+    sJob.nXSize = nXSize;
+    sJob.nYSize = nYSize;
+    sJob.dfContourInterval = dfContourInterval;
+    sJob.dfContourBase = dfContourBase;
+    sJob.nFixedLevelCount = nFixedLevelCount;
+    sJob.padfFixedLevels = padfFixedLevels;
+    sJob.bUseNoData = bUseNoData;
+    sJob.dfNoDataValue = dfNoDataValue;
+    sJob.nNextFlush = 0;
+    sJob.hMutex = NULL;
+    sJob.eErr = CE_None;
+    sJob.nNextStrip = 0;
+    sJob.nLinesDone = 0;
+    sJob.psInfo = &oCWI;
+    sJob.pfnProgress = pfnProgress;
+    sJob.pProgressArg = pProgressArg;
 
-/************************************************************************/
-/*                          OGRContourWriter()                          */
-/************************************************************************/
+/* -------------------------------------------------------------------- */
+/*      Use strips if there are enough lines for each thread.           */
+/* -------------------------------------------------------------------- */
+    if( bStreaming && nThreads > 1 )
+    {
+        int nStripLines = MAX( CONTOUR_MIN_STRIP_LINES,
+                               nYSize / (4 * nThreads) );
 
-CPLErr OGRContourWriter( double dfLevel, 
-                         int nPoints, double *padfX, double *padfY, 
-                         void *pInfo )
+        if( nYSize >= 2 * nStripLines )
+            return GDALContourGenerateStrips( &sJob, nThreads, nStripLines );
+    }
 
-{
-    OGRContourWriterInfo *poInfo = (OGRContourWriterInfo *) pInfo;
-    OGRFeatureH hFeat;
-    OGRGeometryH hGeom;
-    int iPoint;
+/* -------------------------------------------------------------------- */
+/*      Setup contour generator.                                        */
+/* -------------------------------------------------------------------- */
+    GDALContourBatch oBatch;
+    GDALContourGenerator *poCG;
 
-    hFeat = OGR_F_Create( OGR_L_GetLayerDefn( (OGRLayerH) poInfo->hLayer ) );
+    if( bStreaming )
+        poCG = new GDALStreamingContourGenerator( nXSize, nYSize, 
+                                                  GDALContourBatchWriter,
+                                                  &oBatch );
+    else
+        poCG = new GDALSortedContourGenerator( nXSize, nYSize, 
+                                               GDALContourBatchWriter,
+                                               &oBatch );
 
-    if( poInfo->nIDField != -1 )
-        OGR_F_SetFieldInteger( hFeat, poInfo->nIDField, poInfo->nNextID++ );
+    oBatch.psInfo = &oCWI;
+    GDALContourSetup( poCG, &sJob );
 
-    if( poInfo->nElevField != -1 )
-        OGR_F_SetFieldDouble( hFeat, poInfo->nElevField, dfLevel );
-    
-    hGeom = OGR_G_CreateGeometry( wkbLineString );
-    
-    for( iPoint = nPoints-1; iPoint >= 0; iPoint-- )
+/* -------------------------------------------------------------------- */
+/*      Feed the data into the contour generator.                       */
+/* -------------------------------------------------------------------- */
+    int iLine;
+    double *padfScanline;
+    CPLErr eErr = CE_None;
+
+    padfScanline = (double *) VSIMalloc(sizeof(double) * nXSize);
+    if (padfScanline == NULL)
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VSIMalloc(): Out of memory in GDALContourGenerate" );
+        delete poCG;
+        return CE_Failure;
+    }
+
+    for( iLine = 0; iLine < nYSize && eErr == CE_None; iLine++ )
     {
-        OGR_G_SetPoint( hGeom, iPoint,
-                        poInfo->adfGeoTransform[0] 
-                        + poInfo->adfGeoTransform[1] * padfX[iPoint]
-                        + poInfo->adfGeoTransform[2] * padfY[iPoint],
-                        poInfo->adfGeoTransform[3] 
-                        + poInfo->adfGeoTransform[4] * padfX[iPoint]
-                        + poInfo->adfGeoTransform[5] * padfY[iPoint],
-                        dfLevel );
+        GDALRasterIO( hBand, GF_Read, 0, iLine, nXSize, 1,
+                      padfScanline, nXSize, 1, GDT_Float64, 0, 0 );
+        eErr = poCG->FeedLine( padfScanline );
+
+        if( eErr == CE_None
+            && !pfnProgress( (iLine+1) / (double) nYSize, "", pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
     }
 
-    OGR_F_SetGeometryDirectly( hFeat, hGeom );
+    CPLFree( padfScanline );
+    delete poCG;
 
-    OGR_L_CreateFeature( (OGRLayerH) poInfo->hLayer, hFeat );
-    OGR_F_Destroy( hFeat );
+    if( eErr == CE_None )
+        eErr = oBatch.Flush( &oCWI );
 
-    return CE_None;
+    return eErr;
 }
 #endif // OGR_ENABLED
 
@@ -1544,78 +3282,123 @@ CPLErr GDALContourGenerate( GDALRasterBandH hBand,
 #else
     VALIDATE_POINTER1( hBand, "GDALContourGenerate", CE_Failure );
 
-    OGRContourWriterInfo oCWI;
-
-    if( pfnProgress == NULL )
-        pfnProgress = GDALDummyProgress;
-
-    if( !pfnProgress( 0.0, "", pProgressArg ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
-
-/* -------------------------------------------------------------------- */
-/*      Setup contour writer information.                               */
-/* -------------------------------------------------------------------- */
-    GDALDatasetH hSrcDS;
-
-    oCWI.hLayer = (OGRLayerH) hLayer;
-
-    oCWI.nElevField = iElevField;
-    oCWI.nIDField = iIDField;
-
-    hSrcDS = GDALGetBandDataset( hBand );
-    GDALGetGeoTransform( hSrcDS, oCWI.adfGeoTransform );
-    oCWI.nNextID = 0;
-
-/* -------------------------------------------------------------------- */
-/*      Setup contour generator.                                        */
-/* -------------------------------------------------------------------- */
-    int nXSize = GDALGetRasterBandXSize( hBand );
-    int nYSize = GDALGetRasterBandYSize( hBand );
-
-    GDALContourGenerator oCG( nXSize, nYSize, OGRContourWriter, &oCWI );
+    return GDALContourGenerateInternal( hBand, dfContourInterval, dfContourBase,
+                                        nFixedLevelCount, padfFixedLevels,
+                                        bUseNoData, dfNoDataValue,
+                                        hLayer, iIDField, iElevField, 
+                                        FALSE, 1, pfnProgress, pProgressArg );
+#endif // OGR_ENABLED
+}
 
-    if( nFixedLevelCount > 0 )
-        oCG.SetFixedLevels( nFixedLevelCount, padfFixedLevels );
-    else
-        oCG.SetContourLevels( dfContourInterval, dfContourBase );
+/************************************************************************/
+/*                       GDALContourGenerateEx()                        */
+/************************************************************************/
 
-    if( bUseNoData )
-        oCG.SetNoData( dfNoDataValue );
+/**
+ * Create vector contours from raster DEM.
+ *
+ * This is the same as GDALContourGenerate(), with the parameters passed
+ * as a list of options, and the additional ability to find the contour
+ * ends through a hash and to contour strips of the raster in several
+ * threads.
+ *
+ * The following options are supported:
+ * <ul>
+ * <li>LEVEL_INTERVAL=f: The elevation interval between contours generated.
+ * <li>LEVEL_BASE=f: The "base" relative to which contour intervals are
+ * applied.  Defaults to 0.
+ * <li>FIXED_LEVELS=f[,f]*: The list of fixed contour levels at which
+ * contours should be generated.  If set, LEVEL_INTERVAL and LEVEL_BASE
+ * are ignored.  One of LEVEL_INTERVAL or FIXED_LEVELS must be set.
+ * <li>NODATA=f: The value to use as a "nodata" value.
+ * <li>ID_FIELD=d: The field index where a unique id should be written
+ * for each feature (contour) written.
+ * <li>ELEV_FIELD=d: The field index where the elevation value of the
+ * contour should be written.
+ * <li>STREAMING=YES: Find the open contours through a hash of their ends
+ * instead of a sorted array, join them as soon as a segment connects them,
+ * and write each contour out as soon as it is complete, which is faster on
+ * rasters with many contours.  The contours cover the same lines, but they
+ * are written out in a different order, closed rings start and end on
+ * their vertex nearest to the bottom of the raster (the leftmost one in
+ * case of ties), and segments shorter than the distance used to join
+ * contour ends are dropped.  Defaults to NO.
+ * <li>NUM_THREADS=n: The number of threads among which horizontal strips
+ * of the raster are shared.  Implies STREAMING=YES.  The contours crossing
+ * strip edges are joined once all strips are done, so the contours are the
+ * same whatever the number of threads, but the order in which they are
+ * written out depends on it.  Defaults to 1.
+ * </ul>
+ *
+ * @param hBand The band to read raster data from.  The whole band will be
+ * processed.
+ *
+ * @param hLayer the layer to which new contour vectors will be written.
+ * Each contour will have a LINESTRING geometry attached to it.
+ *
+ * @param papszOptions the list of options, as NAME=VALUE strings.
+ *
+ * @param pfnProgress a GDALProgressFunc that may be used to report progress
+ * to the user, or to interrupt the algorithm.  May be NULL if not required.
+ *
+ * @param pProgressArg the callback data for the pfnProgress function.
+ *
+ * @return CE_None on success or CE_Failure if an error occurs.
+ *
+ * @since GDAL 1.10
+ */
 
-/* -------------------------------------------------------------------- */
-/*      Feed the data into the contour generator.                       */
-/* -------------------------------------------------------------------- */
-    int iLine;
-    double *padfScanline;
-    CPLErr eErr = CE_None;
+CPLErr GDALContourGenerateEx( GDALRasterBandH hBand, void *hLayer,
+                              char **papszOptions,
+                              GDALProgressFunc pfnProgress, void *pProgressArg )
 
-    padfScanline = (double *) VSIMalloc(sizeof(double) * nXSize);
-    if (padfScanline == NULL)
+{
+#ifndef OGR_ENABLED
+    CPLError(CE_Failure, CPLE_NotSupported, "GDALContourGenerateEx() unimplemented in a non OGR build");
+    return CE_Failure;
+#else
+    VALIDATE_POINTER1( hBand, "GDALContourGenerateEx", CE_Failure );
+
+    double dfContourInterval =
+        CPLAtof( CSLFetchNameValueDef( papszOptions, "LEVEL_INTERVAL", "0" ) );
+    double dfContourBase =
+        CPLAtof( CSLFetchNameValueDef( papszOptions, "LEVEL_BASE", "0" ) );
+    const char *pszNoData = CSLFetchNameValue( papszOptions, "NODATA" );
+    int iIDField =
+        atoi( CSLFetchNameValueDef( papszOptions, "ID_FIELD", "-1" ) );
+    int iElevField =
+        atoi( CSLFetchNameValueDef( papszOptions, "ELEV_FIELD", "-1" ) );
+    const char *pszNumThreads = CSLFetchNameValue( papszOptions, 
+                                                   "NUM_THREADS" );
+    int nThreads = pszNumThreads ? MAX(1, atoi(pszNumThreads)) : 1;
+    int bStreaming = pszNumThreads != NULL
+        || CSLTestBoolean( CSLFetchNameValueDef( papszOptions, 
+                                                 "STREAMING", "NO" ) );
+
+    std::vector<double> adfFixedLevels;
+    char **papszFixedLevels =
+        CSLTokenizeString2( CSLFetchNameValueDef( papszOptions,
+                                                  "FIXED_LEVELS", "" ),
+                            ",", 0 );
+    for( int i = 0; papszFixedLevels != NULL && papszFixedLevels[i] != NULL;
+         i++ )
+        adfFixedLevels.push_back( CPLAtof( papszFixedLevels[i] ) );
+    CSLDestroy( papszFixedLevels );
+
+    if( dfContourInterval == 0.0 && adfFixedLevels.empty() )
     {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                  "VSIMalloc(): Out of memory in GDALContourGenerate" );
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "GDALContourGenerateEx(): LEVEL_INTERVAL or FIXED_LEVELS "
+                  "must be specified." );
         return CE_Failure;
     }
 
-    for( iLine = 0; iLine < nYSize && eErr == CE_None; iLine++ )
-    {
-        GDALRasterIO( hBand, GF_Read, 0, iLine, nXSize, 1, 
-                      padfScanline, nXSize, 1, GDT_Float64, 0, 0 );
-        eErr = oCG.FeedLine( padfScanline );
-
-        if( eErr == CE_None 
-            && !pfnProgress( (iLine+1) / (double) nYSize, "", pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
-    }
-
-    CPLFree( padfScanline );
-
-    return eErr;
+    return GDALContourGenerateInternal(
+        hBand, dfContourInterval, dfContourBase,
+        (int) adfFixedLevels.size(),
+        adfFixedLevels.empty() ? NULL : &adfFixedLevels[0],
+        pszNoData != NULL, pszNoData ? CPLAtof( pszNoData ) : 0.0,
+        hLayer, iIDField, iElevField, bStreaming, nThreads,
+        pfnProgress, pProgressArg );
 #endif // OGR_ENABLED
 }
@@ -63,6 +63,15 @@ int CPL_DLL CPL_STDCALL GDALDitherRGB2PCT( GDALRasterBandH hRed,
 
 int CPL_DLL CPL_STDCALL GDALChecksumImage( GDALRasterBandH hBand, 
                                int nXOff, int nYOff, int nXSize, int nYSize );
+
+CPLErr CPL_DLL CPL_STDCALL
+GDALComputeBlockChecksums( GDALRasterBandH hBand, char **papszOptions,
+                           char ***ppapszManifest,
+                           GDALProgressFunc pfnProgress, void *pProgressArg );
+
+int CPL_DLL CPL_STDCALL
+GDALCompareBlockChecksums( char **papszManifest1, char **papszManifest2,
+                           int *pnChangedBlocks, int **ppanChangedBlocks );
                                
 CPLErr CPL_DLL CPL_STDCALL 
 GDALComputeProximity( GDALRasterBandH hSrcBand, 
@@ -294,6 +303,30 @@ GDALContourGenerate( GDALRasterBandH hBand,
                             void *hLayer, int iIDField, int iElevField,
                             GDALProgressFunc pfnProgress, void *pProgressArg );
 
+CPLErr CPL_DLL
+GDALContourGenerateEx( GDALRasterBandH hBand, void *hLayer,
+                       char **papszOptions,
+                       GDALProgressFunc pfnProgress, void *pProgressArg );
+
+/************************************************************************/
+/*      DEM processing - hillshade, slope, aspect, TRI, TPI, roughness. */
+/************************************************************************/
+
+typedef void *GDALDEMProcessorH;
+
+GDALDEMProcessorH CPL_DLL
+GDALDEMCreateProcessor( GDALRasterBandH hSrcBand, const char *pszProcessing,
+                        char **papszOptions );
+CPLErr CPL_DLL
+GDALDEMProcessLines( GDALDEMProcessorH hProcessor,
+                     int nYOff, int nYSize, float *pafDstBuf );
+void CPL_DLL GDALDEMDestroyProcessor( GDALDEMProcessorH hProcessor );
+
+CPLErr CPL_DLL
+GDALDEMProcessBand( GDALRasterBandH hSrcBand, GDALRasterBandH hDstBand,
+                    const char *pszProcessing, char **papszOptions,
+                    GDALProgressFunc pfnProgress, void *pProgressArg );
+
 /************************************************************************/
 /*      Rasterizer API - geometries burned into GDAL raster.            */
 /************************************************************************/
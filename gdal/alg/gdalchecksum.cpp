@@ -29,6 +29,8 @@
 
 #include "gdal_alg.h"
 #include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_multiproc.h"
 
 CPL_CVSID("$Id$");
 
@@ -169,3 +171,545 @@ GDALChecksumImage( GDALRasterBandH hBand,
     return nChecksum;
 }
                        
+
+/************************************************************************/
+/* ==================================================================== */
+/*                     Block checksum manifests                         */
+/* ==================================================================== */
+/************************************************************************/
+
+#define BLOCK_CHECKSUMS_DOMAIN    "BLOCK_CHECKSUMS"
+#define BLOCK_CHECKSUMS_ALGORITHM "MURMUR64A"
+
+/************************************************************************/
+/*                       GDALHashBlockMurmur64()                        */
+/*                                                                      */
+/*      MurmurHash64A by Austin Appleby (public domain), reading the    */
+/*      data as little endian 64 bit words so that the result does      */
+/*      not depend on the host byte order.                              */
+/************************************************************************/
+
+static GUIntBig GDALHashBlockMurmur64( const GByte *pabyData, size_t nLen,
+                                       GUIntBig nSeed )
+
+{
+    const GUIntBig m = (((GUIntBig) 0xc6a4a793) << 32) | 0x5bd1e995;
+    const int r = 47;
+    GUIntBig h = nSeed ^ (nLen * m);
+    size_t i, nWords = nLen / 8;
+
+    for( i = 0; i < nWords; i++ )
+    {
+        GUIntBig k;
+
+        memcpy( &k, pabyData + i * 8, 8 );
+        CPL_LSBPTR64( &k );
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    const GByte *pabyTail = pabyData + nWords * 8;
+    switch( nLen & 7 )
+    {
+      case 7: h ^= ((GUIntBig) pabyTail[6]) << 48;
+      case 6: h ^= ((GUIntBig) pabyTail[5]) << 40;
+      case 5: h ^= ((GUIntBig) pabyTail[4]) << 32;
+      case 4: h ^= ((GUIntBig) pabyTail[3]) << 24;
+      case 3: h ^= ((GUIntBig) pabyTail[2]) << 16;
+      case 2: h ^= ((GUIntBig) pabyTail[1]) << 8;
+      case 1: h ^= ((GUIntBig) pabyTail[0]);
+              h *= m;
+    };
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+typedef struct
+{
+    GDALRasterBandH hBand;
+    GDALDataType    eDataType;
+    int             nBlockXSize;
+    int             nBlockYSize;
+    int             nBlocksPerRow;
+    int             nBlocksPerColumn;
+    GUIntBig       *panHashes;
+
+    void           *hMutex;
+    CPLErr          eErr;
+    int             nNextBlock;
+    int             nBlocksDone;
+
+    GDALProgressFunc pfnProgress;
+    void           *pProgressArg;
+} GDALBlockChecksumJob;
+
+/************************************************************************/
+/*                     GDALBlockChecksumRunBlocks()                     */
+/*                                                                      */
+/*      Hash blocks until there are none left.  The reads are           */
+/*      serialized on the job mutex, while hashing runs concurrently.   */
+/*      Progress is only reported from the main thread.                 */
+/************************************************************************/
+
+static CPLErr GDALBlockChecksumRunBlocks( GDALBlockChecksumJob *psJob,
+                                          int bMainThread )
+
+{
+    int nXSize = GDALGetRasterBandXSize( psJob->hBand );
+    int nYSize = GDALGetRasterBandYSize( psJob->hBand );
+    int nDataTypeSize = GDALGetDataTypeSize( psJob->eDataType ) / 8;
+    int nBlockCount = psJob->nBlocksPerRow * psJob->nBlocksPerColumn;
+    CPLErr eErr = CE_None;
+
+    GByte *pabyBlock = (GByte *)
+        VSIMalloc3( nDataTypeSize, psJob->nBlockXSize, psJob->nBlockYSize );
+    if( pabyBlock == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VSIMalloc(): Out of memory in "
+                  "GDALComputeBlockChecksums" );
+        eErr = CE_Failure;
+    }
+
+    while( TRUE )
+    {
+        if( psJob->hMutex )
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        if( eErr != CE_None && psJob->eErr == CE_None )
+            psJob->eErr = eErr;
+        int iBlock = psJob->nNextBlock++;
+        int bStop = (iBlock >= nBlockCount || psJob->eErr != CE_None);
+
+        int nXOff = 0, nYOff = 0, nReqXSize = 0, nReqYSize = 0;
+        if( !bStop )
+        {
+            nXOff = (iBlock % psJob->nBlocksPerRow) * psJob->nBlockXSize;
+            nYOff = (iBlock / psJob->nBlocksPerRow) * psJob->nBlockYSize;
+            nReqXSize = MIN(psJob->nBlockXSize, nXSize - nXOff);
+            nReqYSize = MIN(psJob->nBlockYSize, nYSize - nYOff);
+
+            eErr = GDALRasterIO( psJob->hBand, GF_Read,
+                                 nXOff, nYOff, nReqXSize, nReqYSize,
+                                 pabyBlock, nReqXSize, nReqYSize,
+                                 psJob->eDataType, 0, 0 );
+        }
+        if( psJob->hMutex )
+            CPLReleaseMutex( psJob->hMutex );
+
+        if( bStop )
+            break;
+        if( eErr != CE_None )
+            continue;
+
+/* -------------------------------------------------------------------- */
+/*      Hash the values in little endian order.  The size of the        */
+/*      block is part of the seed so that blocks of different shapes    */
+/*      holding the same bytes do not collide.                          */
+/* -------------------------------------------------------------------- */
+        size_t nValues = (size_t) nReqXSize * nReqYSize;
+#ifdef CPL_MSB
+        if( nDataTypeSize > 1 )
+        {
+            if( GDALDataTypeIsComplex( psJob->eDataType ) )
+                GDALSwapWords( pabyBlock, nDataTypeSize / 2, 2 * nValues,
+                               nDataTypeSize / 2 );
+            else
+                GDALSwapWords( pabyBlock, nDataTypeSize, nValues,
+                               nDataTypeSize );
+        }
+#endif
+        psJob->panHashes[iBlock] =
+            GDALHashBlockMurmur64( pabyBlock, nValues * nDataTypeSize,
+                                   (((GUIntBig) nReqXSize) << 32)
+                                   | (GUInt32) nReqYSize );
+
+        if( psJob->hMutex )
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        psJob->nBlocksDone++;
+        double dfComplete = psJob->nBlocksDone / (double) nBlockCount;
+        if( psJob->hMutex )
+            CPLReleaseMutex( psJob->hMutex );
+
+        if( bMainThread
+            && !psJob->pfnProgress( dfComplete, NULL, psJob->pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
+    }
+
+    CPLFree( pabyBlock );
+
+    return eErr;
+}
+
+typedef struct
+{
+    GDALBlockChecksumJob *psJob;
+    int             bMainThread;    /* the one reporting progress */
+} GDALBlockChecksumThreadData;
+
+static CPLErr GDALBlockChecksumJobFunc( void *pData )
+
+{
+    GDALBlockChecksumThreadData *psThreadData =
+        (GDALBlockChecksumThreadData *) pData;
+
+    return GDALBlockChecksumRunBlocks( psThreadData->psJob,
+                                       psThreadData->bMainThread );
+}
+
+/************************************************************************/
+/*                     GDALComputeBlockChecksums()                      */
+/************************************************************************/
+
+/**
+ * Compute a manifest of per block checksums of a band.
+ *
+ * Unlike GDALChecksumImage(), which reduces a whole region to a single
+ * 16bit value, this computes a 64bit hash of the raw values of each block
+ * of the band, so that two versions of a raster can be compared to find
+ * the blocks that changed (see GDALCompareBlockChecksums()).  The hash
+ * does not depend on the host byte order.  Blocks are hashed
+ * concurrently when several threads are requested.
+ *
+ * The manifest is a list of NAME=VALUE strings:
+ * <ul>
+ * <li>ALGORITHM: the hash function, currently MURMUR64A.
+ * <li>DATA_TYPE: the data type of the hashed values.
+ * <li>RASTER_XSIZE, RASTER_YSIZE: the size of the band.
+ * <li>BLOCK_XSIZE, BLOCK_YSIZE: the size of the hashed blocks.
+ * <li>ROW_<i>n</i>: the space separated hashes, as 16 hexadecimal digits,
+ * of the blocks of the <i>n</i>th row of blocks, starting at 0.
+ * </ul>
+ *
+ * If STORE=YES is passed, the manifest is also set as the
+ * "BLOCK_CHECKSUMS" metadata domain of the band, which PAM enabled
+ * drivers persist in the .aux.xml file, so that it can be fetched
+ * later with GDALGetMetadata() without reading the raster again.
+ *
+ * The following options are supported:
+ * <ul>
+ * <li>BLOCK_XSIZE=n, BLOCK_YSIZE=n: The size of the hashed blocks.
+ * Defaults to the natural block size of the band.  Manifests can only be
+ * compared if they use the same block size.
+ * <li>NUM_THREADS=n: The number of threads to use.  Defaults to 1.
+ * <li>STORE=YES/NO: Whether to set the manifest as band metadata.
+ * Defaults to NO.
+ * </ul>
+ *
+ * @param hBand the raster band to read from.
+ * @param papszOptions the list of options, as NAME=VALUE strings.
+ * @param ppapszManifest if not NULL, receives a copy of the manifest to be
+ * freed with CSLDestroy().
+ * @param pfnProgress a GDALProgressFunc that may be used to report progress
+ * to the user, or to interrupt the algorithm.  May be NULL if not required.
+ * @param pProgressArg the callback data for the pfnProgress function.
+ *
+ * @return CE_None on success or CE_Failure if an error occurs.
+ *
+ * @since GDAL 1.10
+ */
+
+CPLErr CPL_STDCALL
+GDALComputeBlockChecksums( GDALRasterBandH hBand, char **papszOptions,
+                           char ***ppapszManifest,
+                           GDALProgressFunc pfnProgress, void *pProgressArg )
+
+{
+    VALIDATE_POINTER1( hBand, "GDALComputeBlockChecksums", CE_Failure );
+
+    if( ppapszManifest != NULL )
+        *ppapszManifest = NULL;
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    int nXSize = GDALGetRasterBandXSize( hBand );
+    int nYSize = GDALGetRasterBandYSize( hBand );
+    GDALDataType eDataType = GDALGetRasterDataType( hBand );
+    int nBlockXSize, nBlockYSize;
+
+    GDALGetBlockSize( hBand, &nBlockXSize, &nBlockYSize );
+    nBlockXSize = atoi( CSLFetchNameValueDef( papszOptions, "BLOCK_XSIZE",
+                                              CPLSPrintf("%d", nBlockXSize) ) );
+    nBlockYSize = atoi( CSLFetchNameValueDef( papszOptions, "BLOCK_YSIZE",
+                                              CPLSPrintf("%d", nBlockYSize) ) );
+    if( nBlockXSize <= 0 || nBlockYSize <= 0 )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "GDALComputeBlockChecksums(): invalid block size %dx%d.",
+                  nBlockXSize, nBlockYSize );
+        return CE_Failure;
+    }
+
+    nBlockXSize = MIN(nBlockXSize, nXSize);
+    nBlockYSize = MIN(nBlockYSize, nYSize);
+
+    if( !pfnProgress( 0.0, NULL, pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Hash all the blocks.                                            */
+/* -------------------------------------------------------------------- */
+    GDALBlockChecksumJob sJob;
+
+    sJob.hBand = hBand;
+    sJob.eDataType = eDataType;
+    sJob.nBlockXSize = nBlockXSize;
+    sJob.nBlockYSize = nBlockYSize;
+    sJob.nBlocksPerRow = (nXSize + nBlockXSize - 1) / nBlockXSize;
+    sJob.nBlocksPerColumn = (nYSize + nBlockYSize - 1) / nBlockYSize;
+    sJob.panHashes = (GUIntBig *)
+        VSIMalloc3( sizeof(GUIntBig), sJob.nBlocksPerRow,
+                    sJob.nBlocksPerColumn );
+    sJob.hMutex = NULL;
+    sJob.eErr = CE_None;
+    sJob.nNextBlock = 0;
+    sJob.nBlocksDone = 0;
+    sJob.pfnProgress = pfnProgress;
+    sJob.pProgressArg = pProgressArg;
+
+    if( sJob.panHashes == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VSIMalloc(): Out of memory in "
+                  "GDALComputeBlockChecksums" );
+        return CE_Failure;
+    }
+
+    int nBlockCount = sJob.nBlocksPerRow * sJob.nBlocksPerColumn;
+    int nThreads =
+        atoi( CSLFetchNameValueDef( papszOptions, "NUM_THREADS", "1" ) );
+    nThreads = MIN(nThreads, nBlockCount);
+
+    if( nThreads > 1 )
+    {
+        int iThread;
+
+        sJob.hMutex = CPLCreateMutex();
+        CPLReleaseMutex( sJob.hMutex );
+
+        GDALBlockChecksumThreadData *pasThreadData =
+            (GDALBlockChecksumThreadData *)
+            CPLCalloc( sizeof(GDALBlockChecksumThreadData), nThreads );
+        void **papThreadData = (void **)
+            CPLCalloc( sizeof(void *), nThreads );
+
+        for( iThread = 0; iThread < nThreads; iThread++ )
+        {
+            pasThreadData[iThread].psJob = &sJob;
+            pasThreadData[iThread].bMainThread = (iThread == 0);
+            papThreadData[iThread] = pasThreadData + iThread;
+        }
+
+        /* The first job is run by this thread */
+        CPLErr eErr = CPLRunJobs( GDALBlockChecksumJobFunc, papThreadData,
+                                  nThreads );
+        if( sJob.eErr == CE_None )
+            sJob.eErr = eErr;
+
+        CPLFree( papThreadData );
+        CPLFree( pasThreadData );
+
+        CPLDestroyMutex( sJob.hMutex );
+    }
+    else
+        GDALBlockChecksumRunBlocks( &sJob, TRUE );
+
+    if( sJob.eErr != CE_None )
+    {
+        CPLFree( sJob.panHashes );
+        return sJob.eErr;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Format the manifest.  The list is allocated at once rather      */
+/*      than grown with CSLSetNameValue() as it has one entry per row   */
+/*      of blocks.                                                      */
+/* -------------------------------------------------------------------- */
+    char **papszManifest = (char **)
+        CPLCalloc( sizeof(char *), 6 + sJob.nBlocksPerColumn + 1 );
+    int iRow, iCol, iItem = 0;
+    char *pszRow = (char *) CPLMalloc( 17 * sJob.nBlocksPerRow + 1 );
+
+    papszManifest[iItem++] =
+        CPLStrdup( "ALGORITHM=" BLOCK_CHECKSUMS_ALGORITHM );
+    papszManifest[iItem++] =
+        CPLStrdup( CPLSPrintf( "DATA_TYPE=%s",
+                               GDALGetDataTypeName( eDataType ) ) );
+    papszManifest[iItem++] =
+        CPLStrdup( CPLSPrintf( "RASTER_XSIZE=%d", nXSize ) );
+    papszManifest[iItem++] =
+        CPLStrdup( CPLSPrintf( "RASTER_YSIZE=%d", nYSize ) );
+    papszManifest[iItem++] =
+        CPLStrdup( CPLSPrintf( "BLOCK_XSIZE=%d", nBlockXSize ) );
+    papszManifest[iItem++] =
+        CPLStrdup( CPLSPrintf( "BLOCK_YSIZE=%d", nBlockYSize ) );
+
+    for( iRow = 0; iRow < sJob.nBlocksPerColumn; iRow++ )
+    {
+        char *pszOut = pszRow;
+
+        for( iCol = 0; iCol < sJob.nBlocksPerRow; iCol++ )
+        {
+            GUIntBig nHash =
+                sJob.panHashes[iRow * sJob.nBlocksPerRow + iCol];
+
+            sprintf( pszOut, "%s%08x%08x", (iCol > 0) ? " " : "",
+                     (GUInt32) (nHash >> 32), (GUInt32) nHash );
+            pszOut += strlen( pszOut );
+        }
+
+        papszManifest[iItem++] =
+            CPLStrdup( CPLSPrintf( "ROW_%d=%s", iRow, pszRow ) );
+    }
+
+    CPLFree( pszRow );
+    CPLFree( sJob.panHashes );
+
+    if( CSLFetchBoolean( papszOptions, "STORE", FALSE ) )
+        GDALSetMetadata( hBand, papszManifest, BLOCK_CHECKSUMS_DOMAIN );
+
+    if( ppapszManifest != NULL )
+        *ppapszManifest = papszManifest;
+    else
+        CSLDestroy( papszManifest );
+
+    if( !pfnProgress( 1.0, NULL, pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                     GDALCompareBlockChecksums()                      */
+/************************************************************************/
+
+/**
+ * Find the blocks that differ between two block checksum manifests.
+ *
+ * The manifests are typically computed by GDALComputeBlockChecksums() on
+ * two versions of a raster, or fetched from the "BLOCK_CHECKSUMS" metadata
+ * domain of their bands.  They can only be compared if they have the same
+ * algorithm, data type, raster size and block size.
+ *
+ * @param papszManifest1 the first manifest.
+ * @param papszManifest2 the second manifest.
+ * @param pnChangedBlocks receives the number of blocks that differ.  May be
+ * NULL.
+ * @param ppanChangedBlocks if not NULL, receives an array, to be freed with
+ * CPLFree(), of the block offsets (x then y, in blocks) of the blocks that
+ * differ.
+ *
+ * @return TRUE if the manifests could be compared, or FALSE if they are
+ * not compatible or are malformed, in which case all blocks should be
+ * considered as changed.
+ *
+ * @since GDAL 1.10
+ */
+
+int CPL_STDCALL
+GDALCompareBlockChecksums( char **papszManifest1, char **papszManifest2,
+                           int *pnChangedBlocks, int **ppanChangedBlocks )
+
+{
+    static const char * const apszLayoutKeys[] =
+        { "ALGORITHM", "DATA_TYPE", "RASTER_XSIZE", "RASTER_YSIZE",
+          "BLOCK_XSIZE", "BLOCK_YSIZE" };
+    int i;
+
+    if( pnChangedBlocks != NULL )
+        *pnChangedBlocks = 0;
+    if( ppanChangedBlocks != NULL )
+        *ppanChangedBlocks = NULL;
+
+    for( i = 0; i < (int) (sizeof(apszLayoutKeys) / sizeof(char *)); i++ )
+    {
+        const char *pszValue1 =
+            CSLFetchNameValue( papszManifest1, apszLayoutKeys[i] );
+        const char *pszValue2 =
+            CSLFetchNameValue( papszManifest2, apszLayoutKeys[i] );
+
+        if( pszValue1 == NULL || pszValue2 == NULL
+            || !EQUAL(pszValue1, pszValue2) )
+            return FALSE;
+    }
+
+    int nXSize = atoi( CSLFetchNameValue( papszManifest1, "RASTER_XSIZE" ) );
+    int nYSize = atoi( CSLFetchNameValue( papszManifest1, "RASTER_YSIZE" ) );
+    int nBlockXSize = atoi( CSLFetchNameValue( papszManifest1, "BLOCK_XSIZE" ) );
+    int nBlockYSize = atoi( CSLFetchNameValue( papszManifest1, "BLOCK_YSIZE" ) );
+
+    if( nXSize <= 0 || nYSize <= 0 || nBlockXSize <= 0 || nBlockYSize <= 0 )
+        return FALSE;
+
+    int nBlocksPerRow = (nXSize + nBlockXSize - 1) / nBlockXSize;
+    int nBlocksPerColumn = (nYSize + nBlockYSize - 1) / nBlockYSize;
+    int nChanged = 0, nMaxChanged = 0;
+    int *panChanged = NULL;
+    int iRow, iCol;
+
+/* -------------------------------------------------------------------- */
+/*      Compare the hashes row by row.  Each hash is 16 characters,     */
+/*      followed by a space but for the last one.                       */
+/* -------------------------------------------------------------------- */
+    for( iRow = 0; iRow < nBlocksPerColumn; iRow++ )
+    {
+        char szKey[32];
+
+        sprintf( szKey, "ROW_%d", iRow );
+        const char *pszRow1 = CSLFetchNameValue( papszManifest1, szKey );
+        const char *pszRow2 = CSLFetchNameValue( papszManifest2, szKey );
+
+        if( pszRow1 == NULL || pszRow2 == NULL
+            || (int) strlen(pszRow1) != 17 * nBlocksPerRow - 1
+            || (int) strlen(pszRow2) != 17 * nBlocksPerRow - 1 )
+        {
+            CPLFree( panChanged );
+            return FALSE;
+        }
+
+        for( iCol = 0; iCol < nBlocksPerRow; iCol++ )
+        {
+            if( !EQUALN(pszRow1 + 17 * iCol, pszRow2 + 17 * iCol, 16) )
+            {
+                if( ppanChangedBlocks != NULL )
+                {
+                    if( nChanged == nMaxChanged )
+                    {
+                        nMaxChanged = nMaxChanged * 2 + 16;
+                        panChanged = (int *)
+                            CPLRealloc( panChanged,
+                                        sizeof(int) * 2 * nMaxChanged );
+                    }
+                    panChanged[2 * nChanged] = iCol;
+                    panChanged[2 * nChanged + 1] = iRow;
+                }
+                nChanged++;
+            }
+        }
+    }
+
+    if( pnChangedBlocks != NULL )
+        *pnChangedBlocks = nChanged;
+    if( ppanChangedBlocks != NULL )
+        *ppanChangedBlocks = panChanged;
+
+    return TRUE;
+}
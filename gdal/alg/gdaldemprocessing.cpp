@@ -0,0 +1,1445 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL DEM Utilities
+ * Purpose:  Hillshade, slope, aspect, TRI, TPI and roughness computation
+ *           from a DEM band, shared by gdaldem and library callers.
+ * Authors:  Matthew Perry, perrygeo at gmail.com
+ *           Even Rouault, even dot rouault at mines dash paris dot org
+ *           Howard Butler, hobu.inc at gmail.com
+ *           Chris Yesson, chris dot yesson at ioz dot ac dot uk
+ *
+ ******************************************************************************
+ * Copyright (c) 2006, 2009 Matthew Perry
+ * Copyright (c) 2009 Even Rouault
+ * Portions derived from GRASS 4.1 (public domain) See
+ * http://trac.osgeo.org/gdal/ticket/2975 for more information regarding
+ * history of this code
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************
+ *
+ * Slope and aspect calculations based on original method for GRASS GIS 4.1
+ * by Michael Shapiro, U.S.Army Construction Engineering Research Laboratory
+ *    Olga Waupotitsch, U.S.Army Construction Engineering Research Laboratory
+ *    Marjorie Larson, U.S.Army Construction Engineering Research Laboratory
+ * as found in GRASS's r.slope.aspect module.
+ *
+ * Horn's formula is used to find the first order derivatives in x and y directions
+ * for slope and aspect calculations: Horn, B. K. P. (1981).
+ * "Hill Shading and the Reflectance Map", Proceedings of the IEEE, 69(1):14-47.
+ *
+ * Other reference :
+ * Burrough, P.A. and McDonell, R.A., 1998. Principles of Geographical Information
+ * Systems. p. 190.
+ *
+ * Shaded relief based on original method for GRASS GIS 4.1 by Jim Westervelt,
+ * U.S. Army Construction Engineering Research Laboratory
+ * as found in GRASS's r.shaded.relief (formerly shade.rel.sh) module.
+ * ref: "r.mapcalc: An Algebra for GIS and Image Processing",
+ * by Michael Shapiro and Jim Westervelt, U.S. Army Construction Engineering
+ * Research Laboratory (March/1991)
+ *
+ * TRI - Terrain Ruggedness Index is as descibed in Wilson et al (2007)
+ * this is based on the method of Valentine et al. (2004)
+ *
+ * TPI - Topographic Position Index follows the description in Wilson et al (2007), following Weiss (2001)
+ * The radius is fixed at 1 cell width/height
+ *
+ * Roughness - follows the definition in Wilson et al. (2007), which follows Dartnell (2000)
+ *
+ * See apps/gdaldem.cpp for the full references of TRI/TPI/Roughness.
+ ****************************************************************************/
+
+#include "gdal_alg.h"
+#include "gdal_priv.h"
+#include "cpl_conv.h"
+#include "cpl_string.h"
+#include "cpl_multiproc.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define GDAL_DEM_SSE2
+#include <emmintrin.h>
+#endif
+
+CPL_CVSID("$Id$");
+
+#ifndef M_PI
+# define M_PI  3.1415926535897932384626433832795
+#endif
+
+#define INTERPOL(a,b) ((bSrcHasNoData && (ARE_REAL_EQUAL(a, fSrcNoDataValue) || ARE_REAL_EQUAL(b, fSrcNoDataValue))) ? fSrcNoDataValue : 2 * (a) - (b))
+
+/* Number of lines processed at once, unless the source blocks suggest */
+/* another value. */
+#define DEM_STRIP_LINES 64
+
+typedef float (*GDALDEMAlg) (float* pafWindow, float fDstNoDataValue, void* pData);
+
+/* Computes the pixels nStart to nEnd-1 of a line, none of their 3x3 */
+/* windows containing nodata. */
+typedef void (*GDALDEMRowFunc) ( const float *pafUp, const float *pafCur,
+                                 const float *pafDown, int nStart, int nEnd,
+                                 float *pafOut, float fDstNoDataValue,
+                                 void *pData );
+
+/************************************************************************/
+/*                         GDALHillshade()                              */
+/************************************************************************/
+
+typedef struct
+{
+    double nsres;
+    double ewres;
+    double sin_altRadians;
+    double cos_altRadians_mul_z_scale_factor_mul_cos_az;
+    double cos_altRadians_mul_z_scale_factor_mul_sin_az;
+    double square_z_scale_factor;
+} GDALHillshadeAlgData;
+
+/* Unoptimized formulas are :
+    x = psData->z*((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
+        (afWin[2] + afWin[5] + afWin[5] + afWin[8])) /
+        (8.0 * psData->ewres * psData->scale);
+
+    y = psData->z*((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
+        (afWin[0] + afWin[1] + afWin[1] + afWin[2])) /
+        (8.0 * psData->nsres * psData->scale);
+
+    slope = M_PI / 2 - atan(sqrt(x*x + y*y));
+
+    aspect = atan2(y,x);
+
+    cang = sin(alt * degreesToRadians) * sin(slope) +
+           cos(alt * degreesToRadians) * cos(slope) *
+           cos(az * degreesToRadians - M_PI/2 - aspect);
+
+   As sqrt(x*x + y*y) * sin(aspect - az) = y * cos(az) - x * sin(az),
+   neither atan2() nor sin() are needed per pixel.
+*/
+
+static inline float GDALHillshadeValue( GDALHillshadeAlgData* psData,
+                                        double x, double y )
+{
+    double xx_plus_yy = x * x + y * y;
+
+    double cang = (psData->sin_altRadians -
+           (y * psData->cos_altRadians_mul_z_scale_factor_mul_cos_az -
+            x * psData->cos_altRadians_mul_z_scale_factor_mul_sin_az)) /
+           sqrt(1 + psData->square_z_scale_factor * xx_plus_yy);
+
+    if (cang <= 0.0)
+        cang = 1.0;
+    else
+        cang = 1.0 + (254.0 * cang);
+
+    return (float) cang;
+}
+
+float GDALHillshadeAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    GDALHillshadeAlgData* psData = (GDALHillshadeAlgData*)pData;
+    double x, y;
+
+    x = ((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
+        (afWin[2] + afWin[5] + afWin[5] + afWin[8])) / psData->ewres;
+
+    y = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
+        (afWin[0] + afWin[1] + afWin[1] + afWin[2])) / psData->nsres;
+
+    return GDALHillshadeValue(psData, x, y);
+}
+
+float GDALHillshadeZevenbergenThorneAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    GDALHillshadeAlgData* psData = (GDALHillshadeAlgData*)pData;
+    double x, y;
+
+    x = (afWin[3] - afWin[5]) / psData->ewres;
+
+    y = (afWin[7] - afWin[1]) / psData->nsres;
+
+    return GDALHillshadeValue(psData, x, y);
+}
+
+static void* GDALCreateHillshadeData(double* adfGeoTransform,
+                                     double z,
+                                     double scale,
+                                     double alt,
+                                     double az,
+                                     int bZevenbergenThorne)
+{
+    GDALHillshadeAlgData* pData =
+        (GDALHillshadeAlgData*)CPLMalloc(sizeof(GDALHillshadeAlgData));
+
+    const double degreesToRadians = M_PI / 180.0;
+    pData->nsres = adfGeoTransform[5];
+    pData->ewres = adfGeoTransform[1];
+    pData->sin_altRadians = sin(alt * degreesToRadians);
+    double z_scale_factor = z / (((bZevenbergenThorne) ? 2 : 8) * scale);
+    double cos_altRadians_mul_z_scale_factor =
+        cos(alt * degreesToRadians) * z_scale_factor;
+    pData->cos_altRadians_mul_z_scale_factor_mul_cos_az =
+        cos_altRadians_mul_z_scale_factor * cos(az * degreesToRadians);
+    pData->cos_altRadians_mul_z_scale_factor_mul_sin_az =
+        cos_altRadians_mul_z_scale_factor * sin(az * degreesToRadians);
+    pData->square_z_scale_factor = z_scale_factor * z_scale_factor;
+    return pData;
+}
+
+#ifdef GDAL_DEM_SSE2
+
+/************************************************************************/
+/*                       GDALHillshadeRowSSE2()                         */
+/*                                                                      */
+/*      Same computation as GDALHillshadeAlg() and                      */
+/*      GDALHillshadeZevenbergenThorneAlg(), 4 pixels at a time: the    */
+/*      float sums in single precision, the rest in double precision    */
+/*      so that the result is the same as the one pixel version.        */
+/************************************************************************/
+
+template<int bZevenbergenThorne>
+static void GDALHillshadeRowSSE2( const float *pafUp, const float *pafCur,
+                                  const float *pafDown, int nStart, int nEnd,
+                                  float *pafOut, float fDstNoDataValue,
+                                  void *pData )
+{
+    GDALHillshadeAlgData* psData = (GDALHillshadeAlgData*)pData;
+    const __m128d xmm_ewres = _mm_set1_pd(psData->ewres);
+    const __m128d xmm_nsres = _mm_set1_pd(psData->nsres);
+    const __m128d xmm_sin_alt = _mm_set1_pd(psData->sin_altRadians);
+    const __m128d xmm_cos_az = _mm_set1_pd(
+                    psData->cos_altRadians_mul_z_scale_factor_mul_cos_az);
+    const __m128d xmm_sin_az = _mm_set1_pd(
+                    psData->cos_altRadians_mul_z_scale_factor_mul_sin_az);
+    const __m128d xmm_square_z = _mm_set1_pd(psData->square_z_scale_factor);
+    const __m128d xmm_zero = _mm_setzero_pd();
+    const __m128d xmm_one = _mm_set1_pd(1.0);
+    const __m128d xmm_254 = _mm_set1_pd(254.0);
+    int j = nStart;
+
+    for( ; j + 4 <= nEnd; j += 4 )
+    {
+        __m128 xmm_x, xmm_y;
+
+        if( bZevenbergenThorne )
+        {
+            xmm_x = _mm_sub_ps(_mm_loadu_ps(pafCur + j - 1),
+                               _mm_loadu_ps(pafCur + j + 1));
+            xmm_y = _mm_sub_ps(_mm_loadu_ps(pafDown + j),
+                               _mm_loadu_ps(pafUp + j));
+        }
+        else
+        {
+            __m128 xmm_up_l = _mm_loadu_ps(pafUp + j - 1);
+            __m128 xmm_up_r = _mm_loadu_ps(pafUp + j + 1);
+            __m128 xmm_cur_l = _mm_loadu_ps(pafCur + j - 1);
+            __m128 xmm_cur_r = _mm_loadu_ps(pafCur + j + 1);
+            __m128 xmm_down_l = _mm_loadu_ps(pafDown + j - 1);
+            __m128 xmm_down_r = _mm_loadu_ps(pafDown + j + 1);
+            __m128 xmm_up = _mm_loadu_ps(pafUp + j);
+            __m128 xmm_down = _mm_loadu_ps(pafDown + j);
+
+            xmm_x = _mm_sub_ps(
+                _mm_add_ps(_mm_add_ps(_mm_add_ps(xmm_up_l, xmm_cur_l),
+                                      xmm_cur_l), xmm_down_l),
+                _mm_add_ps(_mm_add_ps(_mm_add_ps(xmm_up_r, xmm_cur_r),
+                                      xmm_cur_r), xmm_down_r));
+            xmm_y = _mm_sub_ps(
+                _mm_add_ps(_mm_add_ps(_mm_add_ps(xmm_down_l, xmm_down),
+                                      xmm_down), xmm_down_r),
+                _mm_add_ps(_mm_add_ps(_mm_add_ps(xmm_up_l, xmm_up),
+                                      xmm_up), xmm_up_r));
+        }
+
+        __m128d axmm_cang[2];
+        for( int k = 0; k < 2; k++ )
+        {
+            __m128d xmm_xd = _mm_div_pd(_mm_cvtps_pd(xmm_x), xmm_ewres);
+            __m128d xmm_yd = _mm_div_pd(_mm_cvtps_pd(xmm_y), xmm_nsres);
+            __m128d xmm_xx_plus_yy = _mm_add_pd(_mm_mul_pd(xmm_xd, xmm_xd),
+                                                _mm_mul_pd(xmm_yd, xmm_yd));
+            __m128d xmm_cang = _mm_div_pd(
+                _mm_sub_pd(xmm_sin_alt,
+                           _mm_sub_pd(_mm_mul_pd(xmm_yd, xmm_cos_az),
+                                      _mm_mul_pd(xmm_xd, xmm_sin_az))),
+                _mm_sqrt_pd(_mm_add_pd(xmm_one,
+                                       _mm_mul_pd(xmm_square_z,
+                                                  xmm_xx_plus_yy))));
+            __m128d xmm_le_zero = _mm_cmple_pd(xmm_cang, xmm_zero);
+            xmm_cang = _mm_add_pd(xmm_one, _mm_mul_pd(xmm_254, xmm_cang));
+            axmm_cang[k] = _mm_or_pd(_mm_and_pd(xmm_le_zero, xmm_one),
+                                     _mm_andnot_pd(xmm_le_zero, xmm_cang));
+
+            xmm_x = _mm_movehl_ps(xmm_x, xmm_x);
+            xmm_y = _mm_movehl_ps(xmm_y, xmm_y);
+        }
+
+        _mm_storeu_ps(pafOut + j,
+                      _mm_movelh_ps(_mm_cvtpd_ps(axmm_cang[0]),
+                                    _mm_cvtpd_ps(axmm_cang[1])));
+    }
+
+    for( ; j < nEnd; j++ )
+    {
+        float afWin[9];
+
+        afWin[0] = pafUp[j-1];
+        afWin[1] = pafUp[j];
+        afWin[2] = pafUp[j+1];
+        afWin[3] = pafCur[j-1];
+        afWin[4] = pafCur[j];
+        afWin[5] = pafCur[j+1];
+        afWin[6] = pafDown[j-1];
+        afWin[7] = pafDown[j];
+        afWin[8] = pafDown[j+1];
+
+        pafOut[j] = bZevenbergenThorne ?
+            GDALHillshadeZevenbergenThorneAlg(afWin, fDstNoDataValue, pData) :
+            GDALHillshadeAlg(afWin, fDstNoDataValue, pData);
+    }
+}
+
+#endif /* def GDAL_DEM_SSE2 */
+
+/************************************************************************/
+/*                         GDALSlope()                                  */
+/************************************************************************/
+
+typedef struct
+{
+    double nsres;
+    double ewres;
+    double scale;
+    int    slopeFormat;
+} GDALSlopeAlgData;
+
+float GDALSlopeHornAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    const double radiansToDegrees = 180.0 / M_PI;
+    GDALSlopeAlgData* psData = (GDALSlopeAlgData*)pData;
+    double dx, dy, key;
+
+    dx = ((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
+          (afWin[2] + afWin[5] + afWin[5] + afWin[8]))/psData->ewres;
+
+    dy = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
+          (afWin[0] + afWin[1] + afWin[1] + afWin[2]))/psData->nsres;
+
+    key = (dx * dx + dy * dy);
+
+    if (psData->slopeFormat == 1)
+        return (float) (atan(sqrt(key) / (8*psData->scale)) * radiansToDegrees);
+    else
+        return (float) (100*(sqrt(key) / (8*psData->scale)));
+}
+
+float GDALSlopeZevenbergenThorneAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    const double radiansToDegrees = 180.0 / M_PI;
+    GDALSlopeAlgData* psData = (GDALSlopeAlgData*)pData;
+    double dx, dy, key;
+
+    dx = (afWin[3] - afWin[5])/psData->ewres;
+
+    dy = (afWin[7] - afWin[1])/psData->nsres;
+
+    key = (dx * dx + dy * dy);
+
+    if (psData->slopeFormat == 1)
+        return (float) (atan(sqrt(key) / (2*psData->scale)) * radiansToDegrees);
+    else
+        return (float) (100*(sqrt(key) / (2*psData->scale)));
+}
+
+static void* GDALCreateSlopeData(double* adfGeoTransform,
+                                 double scale,
+                                 int slopeFormat)
+{
+    GDALSlopeAlgData* pData =
+        (GDALSlopeAlgData*)CPLMalloc(sizeof(GDALSlopeAlgData));
+
+    pData->nsres = adfGeoTransform[5];
+    pData->ewres = adfGeoTransform[1];
+    pData->scale = scale;
+    pData->slopeFormat = slopeFormat;
+    return pData;
+}
+
+/************************************************************************/
+/*                         GDALAspect()                                 */
+/************************************************************************/
+
+typedef struct
+{
+    int bAngleAsAzimuth;
+} GDALAspectAlgData;
+
+float GDALAspectAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    const double degreesToRadians = M_PI / 180.0;
+    GDALAspectAlgData* psData = (GDALAspectAlgData*)pData;
+    double dx, dy;
+    float aspect;
+
+    dx = ((afWin[2] + afWin[5] + afWin[5] + afWin[8]) -
+          (afWin[0] + afWin[3] + afWin[3] + afWin[6]));
+
+    dy = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
+          (afWin[0] + afWin[1] + afWin[1] + afWin[2]));
+
+    aspect = (float) (atan2(dy,-dx) / degreesToRadians);
+
+    if (dx == 0 && dy == 0)
+    {
+        /* Flat area */
+        aspect = fDstNoDataValue;
+    }
+    else if ( psData->bAngleAsAzimuth )
+    {
+        if (aspect > 90.0)
+            aspect = 450.0f - aspect;
+        else
+            aspect = 90.0f - aspect;
+    }
+    else
+    {
+        if (aspect < 0)
+            aspect += 360.0;
+    }
+
+    if (aspect == 360.0)
+        aspect = 0.0;
+
+    return aspect;
+}
+
+float GDALAspectZevenbergenThorneAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    const double degreesToRadians = M_PI / 180.0;
+    GDALAspectAlgData* psData = (GDALAspectAlgData*)pData;
+    double dx, dy;
+    float aspect;
+
+    dx = (afWin[5] - afWin[3]);
+
+    dy = (afWin[7] - afWin[1]);
+
+    aspect = (float) (atan2(dy,-dx) / degreesToRadians);
+
+    if (dx == 0 && dy == 0)
+    {
+        /* Flat area */
+        aspect = fDstNoDataValue;
+    }
+    else if ( psData->bAngleAsAzimuth )
+    {
+        if (aspect > 90.0)
+            aspect = 450.0f - aspect;
+        else
+            aspect = 90.0f - aspect;
+    }
+    else
+    {
+        if (aspect < 0)
+            aspect += 360.0;
+    }
+
+    if (aspect == 360.0)
+        aspect = 0.0;
+
+    return aspect;
+}
+
+static void* GDALCreateAspectData(int bAngleAsAzimuth)
+{
+    GDALAspectAlgData* pData =
+        (GDALAspectAlgData*)CPLMalloc(sizeof(GDALAspectAlgData));
+
+    pData->bAngleAsAzimuth = bAngleAsAzimuth;
+    return pData;
+}
+
+/************************************************************************/
+/*                         GDALTRIAlg()                                 */
+/************************************************************************/
+
+float GDALTRIAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    // Terrain Ruggedness is average difference in height
+    return (fabs(afWin[0]-afWin[4]) +
+            fabs(afWin[1]-afWin[4]) +
+            fabs(afWin[2]-afWin[4]) +
+            fabs(afWin[3]-afWin[4]) +
+            fabs(afWin[5]-afWin[4]) +
+            fabs(afWin[6]-afWin[4]) +
+            fabs(afWin[7]-afWin[4]) +
+            fabs(afWin[8]-afWin[4]))/8;
+}
+
+/************************************************************************/
+/*                         GDALTPIAlg()                                 */
+/************************************************************************/
+
+float GDALTPIAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    // Terrain Position is the difference between
+    // The central cell and the mean of the surrounding cells
+    return afWin[4] -
+            ((afWin[0]+
+              afWin[1]+
+              afWin[2]+
+              afWin[3]+
+              afWin[5]+
+              afWin[6]+
+              afWin[7]+
+              afWin[8])/8);
+}
+
+/************************************************************************/
+/*                     GDALRoughnessAlg()                               */
+/************************************************************************/
+
+float GDALRoughnessAlg (float* afWin, float fDstNoDataValue, void* pData)
+{
+    // Roughness is the largest difference
+    //  between any two cells
+
+    float pafRoughnessMin = afWin[0];
+    float pafRoughnessMax = afWin[0];
+
+    for ( int k = 1; k < 9; k++)
+    {
+        if (afWin[k] > pafRoughnessMax)
+        {
+            pafRoughnessMax=afWin[k];
+        }
+        if (afWin[k] < pafRoughnessMin)
+        {
+            pafRoughnessMin=afWin[k];
+        }
+    }
+    return pafRoughnessMax - pafRoughnessMin;
+}
+
+/************************************************************************/
+/*                          GDALDEMProcessRow()                         */
+/*                                                                      */
+/*      Instantiated for each algorithm, so that it gets inlined in     */
+/*      the pixel loop instead of being called through a pointer.       */
+/************************************************************************/
+
+template<GDALDEMAlg pfnAlg>
+static void GDALDEMProcessRow( const float *pafUp, const float *pafCur,
+                               const float *pafDown, int nStart, int nEnd,
+                               float *pafOut, float fDstNoDataValue,
+                               void *pData )
+{
+    for( int j = nStart; j < nEnd; j++ )
+    {
+        float afWin[9];
+
+        afWin[0] = pafUp[j-1];
+        afWin[1] = pafUp[j];
+        afWin[2] = pafUp[j+1];
+        afWin[3] = pafCur[j-1];
+        afWin[4] = pafCur[j];
+        afWin[5] = pafCur[j+1];
+        afWin[6] = pafDown[j-1];
+        afWin[7] = pafDown[j];
+        afWin[8] = pafDown[j+1];
+
+        pafOut[j] = pfnAlg(afWin, fDstNoDataValue, pData);
+    }
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                           GDALDEMProcessor                           */
+/* ==================================================================== */
+/************************************************************************/
+
+class GDALDEMProcessor
+{
+  public:
+    GDALRasterBandH hSrcBand;
+    int             nXSize;
+    int             nYSize;
+
+    int             bSrcHasNoData;
+    float           fSrcNoDataValue;
+    float           fDstNoDataValue;
+
+    /* Compute at edges and near nodata, rather than writing nodata */
+    int             bComputeAtEdges;
+
+    GDALDEMAlg      pfnAlg;
+    GDALDEMRowFunc  pfnRow;
+    void           *pAlgData;
+
+                    GDALDEMProcessor();
+                   ~GDALDEMProcessor();
+
+    float           ComputeVal( float *afWin );
+    void            ProcessRow( const float *pafUp, const float *pafCur,
+                                const float *pafDown, const GByte *pabyColMask,
+                                int bFirstOrLastRow, float *pafOut );
+    CPLErr          ProcessLines( int nYOff, int nLines,
+                                  float *pafSrcBuf, GByte *pabyMaskBuf,
+                                  float *pafDstBuf, void *hIOMutex );
+};
+
+/************************************************************************/
+/*                          GDALDEMProcessor()                          */
+/************************************************************************/
+
+GDALDEMProcessor::GDALDEMProcessor()
+
+{
+    hSrcBand = NULL;
+    nXSize = 0;
+    nYSize = 0;
+    bSrcHasNoData = FALSE;
+    fSrcNoDataValue = 0.0;
+    fDstNoDataValue = 0.0;
+    bComputeAtEdges = FALSE;
+    pfnAlg = NULL;
+    pfnRow = NULL;
+    pAlgData = NULL;
+}
+
+/************************************************************************/
+/*                         ~GDALDEMProcessor()                          */
+/************************************************************************/
+
+GDALDEMProcessor::~GDALDEMProcessor()
+
+{
+    CPLFree( pAlgData );
+}
+
+/************************************************************************/
+/*                             ComputeVal()                             */
+/*                                                                      */
+/*      Compute a pixel whose 3x3 window may contain nodata.            */
+/************************************************************************/
+
+float GDALDEMProcessor::ComputeVal( float* afWin )
+{
+    if (bSrcHasNoData && ARE_REAL_EQUAL(afWin[4], fSrcNoDataValue))
+    {
+        return fDstNoDataValue;
+    }
+    else if (bSrcHasNoData)
+    {
+        int k;
+        for(k=0;k<9;k++)
+        {
+            if (ARE_REAL_EQUAL(afWin[k], fSrcNoDataValue))
+            {
+                if (bComputeAtEdges)
+                    afWin[k] = afWin[4];
+                else
+                    return fDstNoDataValue;
+            }
+        }
+    }
+
+    return pfnAlg(afWin, fDstNoDataValue, pAlgData);
+}
+
+/************************************************************************/
+/*                             ProcessRow()                             */
+/*                                                                      */
+/*      Compute one line from the lines above and below.  If not        */
+/*      NULL, pabyColMask is set for columns having nodata on one of    */
+/*      those three lines.  At the left and right edges, the missing    */
+/*      column is extrapolated from the two nearest ones, or just       */
+/*      replaced by the edge column on the first and last lines.        */
+/************************************************************************/
+
+void GDALDEMProcessor::ProcessRow( const float *pafUp, const float *pafCur,
+                                   const float *pafDown,
+                                   const GByte *pabyColMask,
+                                   int bFirstOrLastRow, float *pafOut )
+
+{
+    int j;
+
+/* -------------------------------------------------------------------- */
+/*      Inner pixels, by runs of windows without nodata.                */
+/* -------------------------------------------------------------------- */
+    if( pabyColMask == NULL )
+    {
+        pfnRow( pafUp, pafCur, pafDown, 1, nXSize - 1, pafOut,
+                fDstNoDataValue, pAlgData );
+    }
+    else
+    {
+        j = 1;
+        while( j < nXSize - 1 )
+        {
+            int nRunEnd = j;
+            while( nRunEnd < nXSize - 1
+                   && !(pabyColMask[nRunEnd-1] | pabyColMask[nRunEnd]
+                        | pabyColMask[nRunEnd+1]) )
+                nRunEnd++;
+
+            if( nRunEnd > j )
+            {
+                pfnRow( pafUp, pafCur, pafDown, j, nRunEnd, pafOut,
+                        fDstNoDataValue, pAlgData );
+                j = nRunEnd;
+                continue;
+            }
+
+            float afWin[9];
+            afWin[0] = pafUp[j-1];
+            afWin[1] = pafUp[j];
+            afWin[2] = pafUp[j+1];
+            afWin[3] = pafCur[j-1];
+            afWin[4] = pafCur[j];
+            afWin[5] = pafCur[j+1];
+            afWin[6] = pafDown[j-1];
+            afWin[7] = pafDown[j];
+            afWin[8] = pafDown[j+1];
+
+            pafOut[j] = ComputeVal( afWin );
+            j++;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Left and right edges.                                           */
+/* -------------------------------------------------------------------- */
+    if( !bComputeAtEdges )
+    {
+        // Exclude the edges
+        pafOut[0] = fDstNoDataValue;
+        if (nXSize > 1)
+            pafOut[nXSize - 1] = fDstNoDataValue;
+        return;
+    }
+
+    for( int iEdge = 0; iEdge < 2; iEdge++ )
+    {
+        float afWin[9];
+
+        j = (iEdge == 0) ? 0 : nXSize - 1;
+        int jmin = (j == 0) ? j : j - 1;
+        int jmax = (j == nXSize - 1) ? j : j + 1;
+
+        if( bFirstOrLastRow )
+        {
+            afWin[0] = pafUp[jmin];
+            afWin[1] = pafUp[j];
+            afWin[2] = pafUp[jmax];
+            afWin[3] = pafCur[jmin];
+            afWin[4] = pafCur[j];
+            afWin[5] = pafCur[jmax];
+            afWin[6] = pafDown[jmin];
+            afWin[7] = pafDown[j];
+            afWin[8] = pafDown[jmax];
+        }
+        else if( iEdge == 0 )
+        {
+            afWin[0] = INTERPOL(pafUp[j], pafUp[j+1]);
+            afWin[1] = pafUp[j];
+            afWin[2] = pafUp[j+1];
+            afWin[3] = INTERPOL(pafCur[j], pafCur[j+1]);
+            afWin[4] = pafCur[j];
+            afWin[5] = pafCur[j+1];
+            afWin[6] = INTERPOL(pafDown[j], pafDown[j+1]);
+            afWin[7] = pafDown[j];
+            afWin[8] = pafDown[j+1];
+        }
+        else
+        {
+            afWin[0] = pafUp[j-1];
+            afWin[1] = pafUp[j];
+            afWin[2] = INTERPOL(pafUp[j], pafUp[j-1]);
+            afWin[3] = pafCur[j-1];
+            afWin[4] = pafCur[j];
+            afWin[5] = INTERPOL(pafCur[j], pafCur[j-1]);
+            afWin[6] = pafDown[j-1];
+            afWin[7] = pafDown[j];
+            afWin[8] = INTERPOL(pafDown[j], pafDown[j-1]);
+        }
+
+        pafOut[j] = ComputeVal( afWin );
+    }
+}
+
+/************************************************************************/
+/*                            ProcessLines()                            */
+/*                                                                      */
+/*      Compute nLines lines from nYOff into pafDstBuf.  pafSrcBuf      */
+/*      must hold nLines+2 lines, and pabyMaskBuf nLines+3 lines of     */
+/*      bytes.  Source reads are done under hIOMutex if not NULL.       */
+/************************************************************************/
+
+CPLErr GDALDEMProcessor::ProcessLines( int nYOff, int nLines,
+                                       float *pafSrcBuf, GByte *pabyMaskBuf,
+                                       float *pafDstBuf, void *hIOMutex )
+
+{
+    int i, j;
+
+/* -------------------------------------------------------------------- */
+/*      Read the lines with one line above and below if any.  Line      */
+/*      nYOff + i - 1 goes in slot i.                                   */
+/* -------------------------------------------------------------------- */
+    int nFirstLine = MAX(0, nYOff - 1);
+    int nLastLine = MIN(nYSize - 1, nYOff + nLines);
+    CPLErr eErr;
+
+    if( hIOMutex )
+        CPLAcquireMutex( hIOMutex, 1000.0 );
+    eErr = GDALRasterIO( hSrcBand, GF_Read,
+                         0, nFirstLine, nXSize, nLastLine - nFirstLine + 1,
+                         pafSrcBuf + (nFirstLine - nYOff + 1) * nXSize,
+                         nXSize, nLastLine - nFirstLine + 1,
+                         GDT_Float32, 0, 0 );
+    if( hIOMutex )
+        CPLReleaseMutex( hIOMutex );
+
+    if( eErr != CE_None )
+        return eErr;
+
+/* -------------------------------------------------------------------- */
+/*      Extrapolate the lines above the first and below the last one.   */
+/* -------------------------------------------------------------------- */
+    if( bComputeAtEdges && nYOff == 0 )
+    {
+        float *pafVirt = pafSrcBuf;
+        const float *pafFirst = pafSrcBuf + nXSize;
+        const float *pafSecond = pafSrcBuf + 2 * nXSize;
+
+        for( j = 0; j < nXSize; j++ )
+            pafVirt[j] = INTERPOL(pafFirst[j], pafSecond[j]);
+    }
+    if( bComputeAtEdges && nYOff + nLines == nYSize )
+    {
+        float *pafVirt = pafSrcBuf + (nLines + 1) * nXSize;
+        const float *pafLast = pafSrcBuf + nLines * nXSize;
+        const float *pafBeforeLast = pafSrcBuf + (nLines - 1) * nXSize;
+
+        for( j = 0; j < nXSize; j++ )
+            pafVirt[j] = INTERPOL(pafLast[j], pafBeforeLast[j]);
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Flag the nodata pixels of each line, and the lines that have    */
+/*      any.  The last mask line is used to combine three of them.      */
+/* -------------------------------------------------------------------- */
+    int *pabLineHasNoData = NULL;
+    GByte *pabyColMask = pabyMaskBuf + (nLines + 2) * nXSize;
+
+    if( bSrcHasNoData )
+    {
+        int iFirstSlot = (nYOff == 0 && !bComputeAtEdges) ? 1 : 0;
+        int iLastSlot = (nYOff + nLines == nYSize && !bComputeAtEdges) ?
+                                                        nLines : nLines + 1;
+
+        pabLineHasNoData = (int *) CPLCalloc( sizeof(int), nLines + 2 );
+        for( i = iFirstSlot; i <= iLastSlot; i++ )
+        {
+            const float *pafLine = pafSrcBuf + i * nXSize;
+            GByte *pabyMask = pabyMaskBuf + i * nXSize;
+
+            for( j = 0; j < nXSize; j++ )
+            {
+                pabyMask[j] = ARE_REAL_EQUAL(pafLine[j], fSrcNoDataValue);
+                pabLineHasNoData[i] |= pabyMask[j];
+            }
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Compute each line.                                              */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < nLines; i++ )
+    {
+        int iLine = nYOff + i;
+        float *pafOut = pafDstBuf + i * nXSize;
+
+        if( !bComputeAtEdges && (iLine == 0 || iLine == nYSize - 1) )
+        {
+            // Exclude the edges
+            for( j = 0; j < nXSize; j++ )
+                pafOut[j] = fDstNoDataValue;
+            continue;
+        }
+
+        const GByte *pabyMask = NULL;
+
+        if( pabLineHasNoData != NULL
+            && (pabLineHasNoData[i] || pabLineHasNoData[i+1]
+                || pabLineHasNoData[i+2]) )
+        {
+            const GByte *pabyUp = pabyMaskBuf + i * nXSize;
+            const GByte *pabyCur = pabyUp + nXSize;
+            const GByte *pabyDown = pabyCur + nXSize;
+
+            for( j = 0; j < nXSize; j++ )
+                pabyColMask[j] = pabyUp[j] | pabyCur[j] | pabyDown[j];
+            pabyMask = pabyColMask;
+        }
+
+        ProcessRow( pafSrcBuf + i * nXSize,
+                    pafSrcBuf + (i + 1) * nXSize,
+                    pafSrcBuf + (i + 2) * nXSize,
+                    pabyMask,
+                    iLine == 0 || iLine == nYSize - 1,
+                    pafOut );
+    }
+
+    CPLFree( pabLineHasNoData );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                       GDALDEMCreateProcessor()                       */
+/************************************************************************/
+
+/**
+ * Prepare the computation of a DEM derived product.
+ *
+ * This prepares the computation of one of the products of the gdaldem
+ * utility that depend on the 3x3 neighbourhood of each pixel, that can
+ * then be computed by groups of lines with GDALDEMProcessLines().  See
+ * GDALDEMProcessBand() for the list of supported products and options.
+ *
+ * In addition, the DST_NODATA=f option gives the value written for
+ * pixels that cannot be computed.  It defaults to 0.
+ *
+ * The geotransform of the dataset of hSrcBand gives the pixel size used
+ * by hillshade and slope.
+ *
+ * @param hSrcBand the DEM band.
+ * @param pszProcessing the product to compute.
+ * @param papszOptions the list of options, as NAME=VALUE strings.
+ *
+ * @return a handle to pass to GDALDEMProcessLines(), to destroy with
+ * GDALDEMDestroyProcessor(), or NULL on error.
+ *
+ * @since GDAL 1.10
+ */
+
+GDALDEMProcessorH GDALDEMCreateProcessor( GDALRasterBandH hSrcBand,
+                                          const char *pszProcessing,
+                                          char **papszOptions )
+
+{
+    VALIDATE_POINTER1( hSrcBand, "GDALDEMCreateProcessor", NULL );
+    VALIDATE_POINTER1( pszProcessing, "GDALDEMCreateProcessor", NULL );
+
+    const char *pszAlg = CSLFetchNameValueDef( papszOptions, "ALG", "Horn" );
+    int bZevenbergenThorne = EQUAL(pszAlg, "ZevenbergenThorne");
+
+    if( !bZevenbergenThorne && !EQUAL(pszAlg, "Horn") )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "Unsupported value for ALG : %s", pszAlg );
+        return NULL;
+    }
+
+    double adfGeoTransform[6] = { 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+    GDALDatasetH hSrcDS = GDALGetBandDataset( hSrcBand );
+    double dfScale =
+        CPLAtof( CSLFetchNameValueDef( papszOptions, "SCALE", "1" ) );
+
+    if( hSrcDS != NULL )
+        GDALGetGeoTransform( hSrcDS, adfGeoTransform );
+
+    GDALDEMProcessor *poProc = new GDALDEMProcessor();
+
+/* -------------------------------------------------------------------- */
+/*      Pick the algorithm and its row function.                        */
+/* -------------------------------------------------------------------- */
+    if( EQUAL(pszProcessing, "hillshade") || EQUAL(pszProcessing, "shade") )
+    {
+        poProc->pAlgData = GDALCreateHillshadeData(
+            adfGeoTransform,
+            CPLAtof( CSLFetchNameValueDef( papszOptions, "Z_FACTOR", "1" ) ),
+            dfScale,
+            CPLAtof( CSLFetchNameValueDef( papszOptions, "ALTITUDE", "45" ) ),
+            CPLAtof( CSLFetchNameValueDef( papszOptions, "AZIMUTH", "315" ) ),
+            bZevenbergenThorne );
+        if( bZevenbergenThorne )
+        {
+            poProc->pfnAlg = GDALHillshadeZevenbergenThorneAlg;
+#ifdef GDAL_DEM_SSE2
+            poProc->pfnRow = GDALHillshadeRowSSE2<TRUE>;
+#else
+            poProc->pfnRow =
+                GDALDEMProcessRow<GDALHillshadeZevenbergenThorneAlg>;
+#endif
+        }
+        else
+        {
+            poProc->pfnAlg = GDALHillshadeAlg;
+#ifdef GDAL_DEM_SSE2
+            poProc->pfnRow = GDALHillshadeRowSSE2<FALSE>;
+#else
+            poProc->pfnRow = GDALDEMProcessRow<GDALHillshadeAlg>;
+#endif
+        }
+    }
+    else if( EQUAL(pszProcessing, "slope") )
+    {
+        const char *pszFormat =
+            CSLFetchNameValueDef( papszOptions, "SLOPE_FORMAT", "DEGREES" );
+
+        // 0 = 'percent' or 1 = 'degrees'
+        poProc->pAlgData = GDALCreateSlopeData( adfGeoTransform, dfScale,
+                                                !EQUAL(pszFormat, "PERCENT") );
+        if( bZevenbergenThorne )
+        {
+            poProc->pfnAlg = GDALSlopeZevenbergenThorneAlg;
+            poProc->pfnRow = GDALDEMProcessRow<GDALSlopeZevenbergenThorneAlg>;
+        }
+        else
+        {
+            poProc->pfnAlg = GDALSlopeHornAlg;
+            poProc->pfnRow = GDALDEMProcessRow<GDALSlopeHornAlg>;
+        }
+    }
+    else if( EQUAL(pszProcessing, "aspect") )
+    {
+        poProc->pAlgData = GDALCreateAspectData(
+            !CSLFetchBoolean( papszOptions, "TRIGONOMETRIC", FALSE ) );
+        if( bZevenbergenThorne )
+        {
+            poProc->pfnAlg = GDALAspectZevenbergenThorneAlg;
+            poProc->pfnRow = GDALDEMProcessRow<GDALAspectZevenbergenThorneAlg>;
+        }
+        else
+        {
+            poProc->pfnAlg = GDALAspectAlg;
+            poProc->pfnRow = GDALDEMProcessRow<GDALAspectAlg>;
+        }
+    }
+    else if( EQUAL(pszProcessing, "TRI") )
+    {
+        poProc->pfnAlg = GDALTRIAlg;
+        poProc->pfnRow = GDALDEMProcessRow<GDALTRIAlg>;
+    }
+    else if( EQUAL(pszProcessing, "TPI") )
+    {
+        poProc->pfnAlg = GDALTPIAlg;
+        poProc->pfnRow = GDALDEMProcessRow<GDALTPIAlg>;
+    }
+    else if( EQUAL(pszProcessing, "roughness") )
+    {
+        poProc->pfnAlg = GDALRoughnessAlg;
+        poProc->pfnRow = GDALDEMProcessRow<GDALRoughnessAlg>;
+    }
+    else
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "Unsupported DEM processing : %s", pszProcessing );
+        delete poProc;
+        return NULL;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Setup the rest of the processor.                                */
+/* -------------------------------------------------------------------- */
+    poProc->hSrcBand = hSrcBand;
+    poProc->nXSize = GDALGetRasterBandXSize( hSrcBand );
+    poProc->nYSize = GDALGetRasterBandYSize( hSrcBand );
+    poProc->fSrcNoDataValue = (float)
+        GDALGetRasterNoDataValue( hSrcBand, &poProc->bSrcHasNoData );
+    poProc->fDstNoDataValue = (float)
+        CPLAtof( CSLFetchNameValueDef( papszOptions, "DST_NODATA", "0" ) );
+    poProc->bComputeAtEdges =
+        CSLFetchBoolean( papszOptions, "COMPUTE_EDGES", FALSE )
+        && poProc->nXSize >= 2 && poProc->nYSize >= 2;
+
+    return (GDALDEMProcessorH) poProc;
+}
+
+/************************************************************************/
+/*                        GDALDEMProcessLines()                         */
+/************************************************************************/
+
+/**
+ * Compute lines of a DEM derived product.
+ *
+ * The source lines needed are read from the band given to
+ * GDALDEMCreateProcessor().  A processor must not be used by several
+ * threads at the same time.
+ *
+ * @param hProcessor the handle returned by GDALDEMCreateProcessor().
+ * @param nYOff the first line to compute.
+ * @param nYSize the number of lines to compute.
+ * @param pafDstBuf the buffer into which the nYSize lines are written,
+ * of the width of the source band.
+ *
+ * @return CE_None on success or CE_Failure if an error occurs.
+ *
+ * @since GDAL 1.10
+ */
+
+CPLErr GDALDEMProcessLines( GDALDEMProcessorH hProcessor,
+                            int nYOff, int nYSize, float *pafDstBuf )
+
+{
+    VALIDATE_POINTER1( hProcessor, "GDALDEMProcessLines", CE_Failure );
+
+    GDALDEMProcessor *poProc = (GDALDEMProcessor *) hProcessor;
+
+    if( nYOff < 0 || nYSize <= 0 || nYOff + nYSize > poProc->nYSize )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "GDALDEMProcessLines(): lines %d to %d out of range.",
+                  nYOff, nYOff + nYSize - 1 );
+        return CE_Failure;
+    }
+
+    int nXSize = poProc->nXSize;
+    float *pafSrcBuf = (float *)
+        VSIMalloc3( sizeof(float), nXSize, nYSize + 2 );
+    GByte *pabyMaskBuf = (GByte *) VSIMalloc2( nXSize, nYSize + 3 );
+
+    if( pafSrcBuf == NULL || pabyMaskBuf == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VSIMalloc(): Out of memory in GDALDEMProcessLines" );
+        CPLFree( pafSrcBuf );
+        CPLFree( pabyMaskBuf );
+        return CE_Failure;
+    }
+
+    CPLErr eErr = poProc->ProcessLines( nYOff, nYSize, pafSrcBuf,
+                                        pabyMaskBuf, pafDstBuf, NULL );
+
+    CPLFree( pafSrcBuf );
+    CPLFree( pabyMaskBuf );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                      GDALDEMDestroyProcessor()                       */
+/************************************************************************/
+
+/**
+ * Destroy a processor created with GDALDEMCreateProcessor().
+ *
+ * @param hProcessor the handle to destroy, may be NULL.
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALDEMDestroyProcessor( GDALDEMProcessorH hProcessor )
+
+{
+    delete (GDALDEMProcessor *) hProcessor;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                         GDALDEMProcessBand()                         */
+/* ==================================================================== */
+/************************************************************************/
+
+typedef struct
+{
+    GDALDEMProcessor *poProc;
+    GDALRasterBandH hDstBand;
+    int             nStripLines;
+
+    void           *hMutex;
+    CPLErr          eErr;
+    int             nNextStrip;
+    int             nLinesDone;
+
+    GDALProgressFunc pfnProgress;
+    void           *pProgressArg;
+} GDALDEMJob;
+
+/************************************************************************/
+/*                          GDALDEMRunStrips()                          */
+/*                                                                      */
+/*      Compute strips until there are none left.  Progress is only     */
+/*      reported from the main thread.                                  */
+/************************************************************************/
+
+static CPLErr GDALDEMRunStrips( GDALDEMJob *psJob, int bMainThread )
+
+{
+    GDALDEMProcessor *poProc = psJob->poProc;
+    int nXSize = poProc->nXSize;
+    int nStripLines = psJob->nStripLines;
+    CPLErr eErr = CE_None;
+
+    float *pafSrcBuf = (float *)
+        VSIMalloc3( sizeof(float), nXSize, nStripLines + 2 );
+    GByte *pabyMaskBuf = (GByte *) VSIMalloc2( nXSize, nStripLines + 3 );
+    float *pafDstBuf = (float *)
+        VSIMalloc3( sizeof(float), nXSize, nStripLines );
+
+    if( pafSrcBuf == NULL || pabyMaskBuf == NULL || pafDstBuf == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VSIMalloc(): Out of memory in GDALDEMProcessBand" );
+        eErr = CE_Failure;
+    }
+
+    while( TRUE )
+    {
+        if( psJob->hMutex )
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        if( eErr != CE_None && psJob->eErr == CE_None )
+            psJob->eErr = eErr;
+        int nYOff = psJob->nNextStrip * nStripLines;
+        psJob->nNextStrip++;
+        int bStop = (nYOff >= poProc->nYSize || psJob->eErr != CE_None);
+        if( psJob->hMutex )
+            CPLReleaseMutex( psJob->hMutex );
+
+        if( bStop )
+            break;
+
+        int nLines = MIN(nStripLines, poProc->nYSize - nYOff);
+
+        eErr = poProc->ProcessLines( nYOff, nLines, pafSrcBuf, pabyMaskBuf,
+                                     pafDstBuf, psJob->hMutex );
+        if( eErr != CE_None )
+            continue;
+
+        if( psJob->hMutex )
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        eErr = GDALRasterIO( psJob->hDstBand, GF_Write,
+                             0, nYOff, nXSize, nLines,
+                             pafDstBuf, nXSize, nLines, GDT_Float32, 0, 0 );
+        psJob->nLinesDone += nLines;
+        double dfComplete = psJob->nLinesDone / (double) poProc->nYSize;
+        if( psJob->hMutex )
+            CPLReleaseMutex( psJob->hMutex );
+
+        if( eErr == CE_None && bMainThread
+            && !psJob->pfnProgress( dfComplete, NULL, psJob->pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
+    }
+
+    CPLFree( pafSrcBuf );
+    CPLFree( pabyMaskBuf );
+    CPLFree( pafDstBuf );
+
+    return eErr;
+}
+
+typedef struct
+{
+    GDALDEMJob     *psJob;
+    int             bMainThread;    /* the one reporting progress */
+} GDALDEMThreadData;
+
+static CPLErr GDALDEMStripsJob( void *pData )
+
+{
+    GDALDEMThreadData *psThreadData = (GDALDEMThreadData *) pData;
+
+    return GDALDEMRunStrips( psThreadData->psJob, psThreadData->bMainThread );
+}
+
+/**
+ * Compute a DEM derived product into a band.
+ *
+ * This computes one of the products of the gdaldem utility that depend
+ * on the 3x3 neighbourhood of each pixel: "hillshade", "slope", "aspect",
+ * "TRI", "TPI" or "roughness".  The raster is processed by horizontal
+ * strips, which may be shared among several threads.
+ *
+ * The following options are supported:
+ * <ul>
+ * <li>ALG=Horn/ZevenbergenThorne: The formula used for the slope
+ * based products (hillshade, slope and aspect).  Defaults to Horn.
+ * <li>Z_FACTOR=f: Vertical exaggeration for hillshade.  Defaults to 1.
+ * <li>SCALE=f: Ratio of vertical units to horizontal units for hillshade
+ * and slope.  Defaults to 1.
+ * <li>AZIMUTH=f: Azimuth of the light for hillshade, in degrees.
+ * Defaults to 315.
+ * <li>ALTITUDE=f: Altitude of the light for hillshade, in degrees.
+ * Defaults to 45.
+ * <li>SLOPE_FORMAT=DEGREES/PERCENT: Unit of slope.  Defaults to DEGREES.
+ * <li>TRIGONOMETRIC=YES/NO: Whether aspect is given as a trigonometric
+ * angle rather than an azimuth.  Defaults to NO.
+ * <li>COMPUTE_EDGES=YES/NO: Whether to compute the pixels at the raster
+ * edges and next to nodata pixels, rather than setting them to nodata.
+ * Defaults to NO.
+ * <li>NUM_THREADS=n: The number of threads to use.  Defaults to 1.
+ * </ul>
+ *
+ * The nodata value of hDstBand, or 0 if it has none, is written for
+ * the pixels that cannot be computed.  The geotransform of the dataset
+ * of hSrcBand gives the pixel size used by hillshade and slope.
+ *
+ * @param hSrcBand the DEM band.
+ * @param hDstBand the band to write to, of the same size as hSrcBand.
+ * @param pszProcessing the product to compute.
+ * @param papszOptions the list of options, as NAME=VALUE strings.
+ * @param pfnProgress a GDALProgressFunc that may be used to report progress
+ * to the user, or to interrupt the algorithm.  May be NULL if not required.
+ * @param pProgressArg the callback data for the pfnProgress function.
+ *
+ * @return CE_None on success or CE_Failure if an error occurs.
+ *
+ * @since GDAL 1.10
+ */
+
+CPLErr GDALDEMProcessBand( GDALRasterBandH hSrcBand,
+                           GDALRasterBandH hDstBand,
+                           const char *pszProcessing,
+                           char **papszOptions,
+                           GDALProgressFunc pfnProgress,
+                           void *pProgressArg )
+
+{
+    VALIDATE_POINTER1( hSrcBand, "GDALDEMProcessBand", CE_Failure );
+    VALIDATE_POINTER1( hDstBand, "GDALDEMProcessBand", CE_Failure );
+
+    int nXSize = GDALGetRasterBandXSize( hSrcBand );
+    int nYSize = GDALGetRasterBandYSize( hSrcBand );
+
+    if( GDALGetRasterBandXSize( hDstBand ) != nXSize
+        || GDALGetRasterBandYSize( hDstBand ) != nYSize )
+    {
+        CPLError( CE_Failure, CPLE_IllegalArg,
+                  "GDALDEMProcessBand(): source and destination bands "
+                  "must have the same size." );
+        return CE_Failure;
+    }
+
+    if (pfnProgress == NULL)
+        pfnProgress = GDALDummyProgress;
+
+/* -------------------------------------------------------------------- */
+/*      Initialize progress counter.                                    */
+/* -------------------------------------------------------------------- */
+    if( !pfnProgress( 0.0, NULL, pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Setup the processor, writing the nodata value of the            */
+/*      destination band where nothing can be computed.                 */
+/* -------------------------------------------------------------------- */
+    int bDstHasNoData = FALSE;
+    double dfDstNoDataValue =
+        GDALGetRasterNoDataValue( hDstBand, &bDstHasNoData );
+    char **papszProcOptions = CSLDuplicate( papszOptions );
+
+    papszProcOptions = CSLSetNameValue(
+        papszProcOptions, "DST_NODATA",
+        CPLSPrintf( "%.18g", bDstHasNoData ? dfDstNoDataValue : 0.0 ) );
+
+    GDALDEMProcessor *poProc = (GDALDEMProcessor *)
+        GDALDEMCreateProcessor( hSrcBand, pszProcessing, papszProcOptions );
+    CSLDestroy( papszProcOptions );
+
+    if( poProc == NULL )
+        return CE_Failure;
+
+/* -------------------------------------------------------------------- */
+/*      Process strips of whole source blocks if they are not too       */
+/*      high.                                                           */
+/* -------------------------------------------------------------------- */
+    int nBlockXSize, nBlockYSize;
+    int nStripLines = DEM_STRIP_LINES;
+
+    GDALGetBlockSize( hSrcBand, &nBlockXSize, &nBlockYSize );
+    if( nBlockYSize < nStripLines )
+        nStripLines = ((nStripLines + nBlockYSize - 1) / nBlockYSize)
+                                                            * nBlockYSize;
+    else if( nBlockYSize <= 8 * DEM_STRIP_LINES )
+        nStripLines = nBlockYSize;
+
+    GDALDEMJob sJob;
+
+    sJob.poProc = poProc;
+    sJob.hDstBand = hDstBand;
+    sJob.nStripLines = nStripLines;
+    sJob.hMutex = NULL;
+    sJob.eErr = CE_None;
+    sJob.nNextStrip = 0;
+    sJob.nLinesDone = 0;
+    sJob.pfnProgress = pfnProgress;
+    sJob.pProgressArg = pProgressArg;
+
+    int nThreads =
+        atoi( CSLFetchNameValueDef( papszOptions, "NUM_THREADS", "1" ) );
+    nThreads = MIN(nThreads, (nYSize + nStripLines - 1) / nStripLines);
+
+/* -------------------------------------------------------------------- */
+/*      Process the strips, in the worker threads if any, and in        */
+/*      this thread.                                                    */
+/* -------------------------------------------------------------------- */
+    if( nThreads > 1 )
+    {
+        int iThread;
+
+        sJob.hMutex = CPLCreateMutex();
+        CPLReleaseMutex( sJob.hMutex );
+
+        GDALDEMThreadData *pasThreadData = (GDALDEMThreadData *)
+            CPLCalloc( sizeof(GDALDEMThreadData), nThreads );
+        void **papThreadData = (void **)
+            CPLCalloc( sizeof(void *), nThreads );
+
+        for( iThread = 0; iThread < nThreads; iThread++ )
+        {
+            pasThreadData[iThread].psJob = &sJob;
+            pasThreadData[iThread].bMainThread = (iThread == 0);
+            papThreadData[iThread] = pasThreadData + iThread;
+        }
+
+        /* The first job is run by this thread */
+        CPLErr eErr = CPLRunJobs( GDALDEMStripsJob, papThreadData, nThreads );
+        if( sJob.eErr == CE_None )
+            sJob.eErr = eErr;
+
+        CPLFree( papThreadData );
+        CPLFree( pasThreadData );
+
+        CPLDestroyMutex( sJob.hMutex );
+    }
+    else
+        GDALDEMRunStrips( &sJob, TRUE );
+
+    GDALDEMDestroyProcessor( (GDALDEMProcessorH) poProc );
+
+    if( sJob.eErr == CE_None
+        && !pfnProgress( 1.0, NULL, pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        sJob.eErr = CE_Failure;
+    }
+
+    return sJob.eErr;
+}
@@ -30,6 +30,7 @@
 #include "gdal_alg.h"
 #include "cpl_conv.h"
 #include "cpl_string.h"
+#include "cpl_multiproc.h"
 
 CPL_CVSID("$Id$");
 
@@ -39,6 +40,16 @@ ProcessProximityLine( GInt32 *panSrcScanline, int *panNearX, int *panNearY,
                       float *pafProximity,
                       int nTargetValues, int *panTargetValues );
 
+static CPLErr
+ComputeExactProximity( GDALRasterBandH hSrcBand,
+                       GDALRasterBandH hProximityBand,
+                       int nXSize, int nYSize, double dfMaxDist,
+                       double dfDistMult, float fNoDataValue,
+                       int bFixedBufVal, double dfFixedBufVal,
+                       int nTargetValues, int *panTargetValues,
+                       int nThreads,
+                       GDALProgressFunc pfnProgress, void * pProgressArg );
+
 /************************************************************************/
 /*                        GDALComputeProximity()                        */
 /************************************************************************/
@@ -88,6 +99,21 @@ queried for a nodata value.  If one is not found, 65535 will be used.
 
 If this option is set, all pixels within the MAXDIST threadhold are
 set to this fixed value instead of to a proximity distance.  
+
+  ALGORITHM=[PROPAGATION]/EXACT
+
+The default PROPAGATION algorithm carries the nearest target found so far
+from neighbouring pixels in a top-down and a bottom-up pass, which is
+fast but may slightly overestimate some distances.  EXACT computes the 
+exact euclidean distance transform with a column pass followed by a row 
+lower envelope pass, in time linear in the number of pixels whatever 
+MAXDIST is.  The raster is processed by strips of lines, so it does not 
+need to fit in memory.  (starting with GDAL 1.10)
+
+  NUM_THREADS=n
+
+Number of threads computing the rows of the EXACT algorithm. Defaults 
+to 1.  (starting with GDAL 1.10)
 */
 
 
@@ -221,6 +247,33 @@ GDALComputeProximity( GDALRasterBandH hSrcBand,
         return CE_Failure;
     }
 
+/* -------------------------------------------------------------------- */
+/*      The exact distance transform has its own processing loop.      */
+/* -------------------------------------------------------------------- */
+    pszOpt = CSLFetchNameValueDef( papszOptions, "ALGORITHM", "PROPAGATION" );
+    if( EQUAL(pszOpt, "EXACT") )
+    {
+        int nThreads = 
+            MAX( 1, atoi(CSLFetchNameValueDef( papszOptions, "NUM_THREADS",
+                                               "1" )) );
+        CPLErr eErr = 
+            ComputeExactProximity( hSrcBand, hProximityBand, nXSize, nYSize,
+                                   dfMaxDist, dfDistMult, fNoDataValue,
+                                   bFixedBufVal, dfFixedBufVal,
+                                   nTargetValues, panTargetValues, nThreads,
+                                   pfnProgress, pProgressArg );
+        CPLFree(panTargetValues);
+        return eErr;
+    }
+    else if( !EQUAL(pszOpt, "PROPAGATION") )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Unrecognised ALGORITHM value '%s', should be PROPAGATION or EXACT.",
+                  pszOpt );
+        CPLFree(panTargetValues);
+        return CE_Failure;
+    }
+
 /* -------------------------------------------------------------------- */
 /*      We need a signed type for the working proximity values kept     */
 /*      on disk.  If our proximity band is not signed, then create a    */
@@ -536,3 +589,438 @@ ProcessProximityLine( GInt32 *panSrcScanline, int *panNearX, int *panNearY,
 
     return CE_None;
 }
+
+/************************************************************************/
+/* ==================================================================== */
+/*      Exact euclidean distance transform.                             */
+/*                                                                      */
+/*      The column pass computes, for each pixel, the vertical          */
+/*      distance G to the nearest target of its column, top-down in     */
+/*      a first pass over the image (kept in a work band) and           */
+/*      bottom-up in a second pass.  Each line of the second pass is    */
+/*      then done by computing the lower envelope of the parabolas      */
+/*      (x - q)^2 + G(q)^2 of the line, as described in "Distance       */
+/*      Transforms of Sampled Functions" by Felzenszwalb and            */
+/*      Huttenlocher.  Both passes are linear in the number of pixels.  */
+/* ==================================================================== */
+/************************************************************************/
+
+/* Approximate size of the working buffers of a strip of lines */
+#define PROXIMITY_STRIP_BYTES   (16*1024*1024)
+
+typedef struct
+{
+    int         nXSize;
+    int         nLines;
+    GInt32     *panG;
+    float      *pafProximity;
+    GInt32      nInfinite;
+    double      dfMaxDist2;
+    double      dfDistMult;
+    float       fNoDataValue;
+    int         bFixedBufVal;
+    double      dfFixedBufVal;
+
+    void       *hJobMutex;
+    int         iNextLine;
+} ProximityStripQueue;
+
+typedef struct
+{
+    ProximityStripQueue *psQueue;
+    int        *panV;
+    double     *padfZ;
+} ProximityThreadData;
+
+/************************************************************************/
+/*                           IsTargetPixel()                            */
+/************************************************************************/
+
+static int IsTargetPixel( GInt32 nValue,
+                          int nTargetValues, int *panTargetValues )
+
+{
+    if( nTargetValues == 0 )
+        return nValue != 0;
+
+    for( int i = 0; i < nTargetValues; i++ )
+    {
+        if( nValue == panTargetValues[i] )
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/************************************************************************/
+/*                       ProcessExactProximityLine()                    */
+/*                                                                      */
+/*      Compute the distances of one line from the vertical distances   */
+/*      of its pixels to their nearest column target.  panV and padfZ   */
+/*      are scratch buffers of nXSize values.                           */
+/************************************************************************/
+
+static void
+ProcessExactProximityLine( ProximityStripQueue *psQ, int iLine,
+                           int *panV, double *padfZ )
+
+{
+    const GInt32 *panG = psQ->panG + (size_t) iLine * psQ->nXSize;
+    float *pafProximity = psQ->pafProximity + (size_t) iLine * psQ->nXSize;
+    int nXSize = psQ->nXSize;
+    int k = -1, q, iPixel;
+
+/* -------------------------------------------------------------------- */
+/*      Build the lower envelope of the parabolas, skipping the         */
+/*      columns without any target.                                     */
+/* -------------------------------------------------------------------- */
+    for( q = 0; q < nXSize; q++ )
+    {
+        if( panG[q] >= psQ->nInfinite )
+            continue;
+
+        double dfFQ = (double) panG[q] * panG[q] + (double) q * q;
+        double dfS = 0.0;
+
+        while( k >= 0 )
+        {
+            int p = panV[k];
+
+            dfS = (dfFQ - ((double) panG[p] * panG[p] + (double) p * p))
+                / (2.0 * (q - p));
+            if( dfS <= padfZ[k] )
+                k--;
+            else
+                break;
+        }
+
+        k++;
+        panV[k] = q;
+        padfZ[k] = (k == 0) ? -1e300 : dfS;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      No target at all above or below this line.                      */
+/* -------------------------------------------------------------------- */
+    if( k < 0 )
+    {
+        for( iPixel = 0; iPixel < nXSize; iPixel++ )
+            pafProximity[iPixel] = psQ->fNoDataValue;
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Walk along the envelope to compute the distances.               */
+/* -------------------------------------------------------------------- */
+    int nEnvelope = k + 1;
+
+    k = 0;
+    for( iPixel = 0; iPixel < nXSize; iPixel++ )
+    {
+        while( k + 1 < nEnvelope && padfZ[k+1] < iPixel )
+            k++;
+
+        int p = panV[k];
+        double dfDist2 = (double) (iPixel - p) * (iPixel - p)
+            + (double) panG[p] * panG[p];
+
+        if( dfDist2 > psQ->dfMaxDist2 )
+            pafProximity[iPixel] = psQ->fNoDataValue;
+        else if( dfDist2 == 0.0 )
+            pafProximity[iPixel] = 0.0;
+        else if( psQ->bFixedBufVal )
+            pafProximity[iPixel] = (float) psQ->dfFixedBufVal;
+        else
+            pafProximity[iPixel] = (float) (sqrt(dfDist2) * psQ->dfDistMult);
+    }
+}
+
+/************************************************************************/
+/*                      RunExactProximityJobs()                         */
+/************************************************************************/
+
+static void RunExactProximityJobs( ProximityStripQueue *psQ,
+                                   int *panV, double *padfZ )
+
+{
+    while( TRUE )
+    {
+        int iLine;
+
+        CPLAcquireMutex( psQ->hJobMutex, 1000.0 );
+        iLine = psQ->iNextLine++;
+        CPLReleaseMutex( psQ->hJobMutex );
+
+        if( iLine >= psQ->nLines )
+            break;
+
+        ProcessExactProximityLine( psQ, iLine, panV, padfZ );
+    }
+}
+
+/************************************************************************/
+/*                        ExactProximityJob()                           */
+/*                                                                      */
+/*      Run by each thread of CPLRunJobs(), with its own buffers.       */
+/************************************************************************/
+
+static CPLErr ExactProximityJob( void *pThreadData )
+
+{
+    ProximityThreadData *psData = (ProximityThreadData *) pThreadData;
+
+    RunExactProximityJobs( psData->psQueue, psData->panV, psData->padfZ );
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                       ComputeExactProximity()                        */
+/************************************************************************/
+
+static CPLErr
+ComputeExactProximity( GDALRasterBandH hSrcBand,
+                       GDALRasterBandH hProximityBand,
+                       int nXSize, int nYSize, double dfMaxDist,
+                       double dfDistMult, float fNoDataValue,
+                       int bFixedBufVal, double dfFixedBufVal,
+                       int nTargetValues, int *panTargetValues,
+                       int nThreads,
+                       GDALProgressFunc pfnProgress, void * pProgressArg )
+
+{
+    CPLErr eErr = CE_None;
+    int i, iThread;
+
+/* -------------------------------------------------------------------- */
+/*      The vertical distances of the first pass are kept in the        */
+/*      proximity band if it can hold them exactly, or otherwise in     */
+/*      a temporary file.                                               */
+/* -------------------------------------------------------------------- */
+    GDALRasterBandH hWorkBand = hProximityBand;
+    GDALDatasetH hWorkDS = NULL;
+    GDALDataType eProxType = GDALGetRasterDataType( hProximityBand );
+
+    if( eProxType != GDT_Int32 && eProxType != GDT_UInt32
+        && eProxType != GDT_Float32 && eProxType != GDT_Float64 )
+    {
+        GDALDriverH hDriver = GDALGetDriverByName("GTiff");
+        if (hDriver == NULL)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined,
+                     "GDALComputeProximity needs GTiff driver");
+            return CE_Failure;
+        }
+        CPLString osTmpFile = CPLGenerateTempFilename( "proximity" );
+        hWorkDS = GDALCreate( hDriver, osTmpFile,
+                              nXSize, nYSize, 1, GDT_Int32, NULL );
+        if (hWorkDS == NULL)
+            return CE_Failure;
+        hWorkBand = GDALGetRasterBand( hWorkDS, 1 );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Allocate the buffers of a strip of lines.                       */
+/* -------------------------------------------------------------------- */
+    int nStripLines = (int)
+        MAX( 1, MIN( nYSize, PROXIMITY_STRIP_BYTES / ((GIntBig) nXSize * 12) ) );
+    size_t nStripPixels = (size_t) nStripLines * nXSize;
+    GInt32 *panSrc = (GInt32 *) VSIMalloc2( sizeof(GInt32), nStripPixels );
+    GInt32 *panG = (GInt32 *) VSIMalloc2( sizeof(GInt32), nStripPixels );
+    float *pafProximity = (float *) VSIMalloc2( sizeof(float), nStripPixels );
+    GInt32 *panColumnG = (GInt32 *) VSIMalloc2( sizeof(GInt32), nXSize );
+
+    nThreads = MAX( 1, MIN( nThreads, nStripLines ) );
+    ProximityThreadData *pasThreadData = (ProximityThreadData *)
+        CPLCalloc( sizeof(ProximityThreadData), nThreads );
+    void **papThreadData = (void **) CPLCalloc( sizeof(void *), nThreads );
+    int bAllocOK = ( panSrc != NULL && panG != NULL && pafProximity != NULL
+                     && panColumnG != NULL );
+
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        pasThreadData[iThread].panV = 
+            (int *) VSIMalloc2( sizeof(int), nXSize );
+        pasThreadData[iThread].padfZ = 
+            (double *) VSIMalloc2( sizeof(double), nXSize );
+        if( pasThreadData[iThread].panV == NULL
+            || pasThreadData[iThread].padfZ == NULL )
+            bAllocOK = FALSE;
+    }
+
+    if( !bAllocOK )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory, 
+                  "Out of memory allocating working buffers.");
+        eErr = CE_Failure;
+    }
+
+    ProximityStripQueue sQueue;
+
+    sQueue.nXSize = nXSize;
+    sQueue.nLines = 0;
+    sQueue.panG = panG;
+    sQueue.pafProximity = pafProximity;
+    sQueue.nInfinite = nXSize + nYSize;
+    sQueue.dfMaxDist2 = dfMaxDist * dfMaxDist;
+    sQueue.dfDistMult = dfDistMult;
+    sQueue.fNoDataValue = fNoDataValue;
+    sQueue.bFixedBufVal = bFixedBufVal;
+    sQueue.dfFixedBufVal = dfFixedBufVal;
+    sQueue.hJobMutex = CPLCreateMutex();
+    sQueue.iNextLine = 0;
+    CPLReleaseMutex( sQueue.hJobMutex );
+
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        pasThreadData[iThread].psQueue = &sQueue;
+        papThreadData[iThread] = pasThreadData + iThread;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Top-down column pass.                                           */
+/* -------------------------------------------------------------------- */
+    int iStripStart, iLine, iPixel;
+
+    if( bAllocOK )
+    {
+        for( i = 0; i < nXSize; i++ )
+            panColumnG[i] = sQueue.nInfinite;
+    }
+
+    for( iStripStart = 0; 
+         eErr == CE_None && iStripStart < nYSize; 
+         iStripStart += nStripLines )
+    {
+        int nLines = MIN( nStripLines, nYSize - iStripStart );
+
+        eErr = GDALRasterIO( hSrcBand, GF_Read, 0, iStripStart, nXSize, nLines,
+                             panSrc, nXSize, nLines, GDT_Int32, 0, 0 );
+        if( eErr != CE_None )
+            break;
+
+        for( iLine = 0; iLine < nLines; iLine++ )
+        {
+            GInt32 *panSrcLine = panSrc + (size_t) iLine * nXSize;
+            GInt32 *panGLine = panG + (size_t) iLine * nXSize;
+
+            for( iPixel = 0; iPixel < nXSize; iPixel++ )
+            {
+                if( IsTargetPixel( panSrcLine[iPixel],
+                                   nTargetValues, panTargetValues ) )
+                    panColumnG[iPixel] = 0;
+                else if( panColumnG[iPixel] < sQueue.nInfinite )
+                    panColumnG[iPixel]++;
+                panGLine[iPixel] = panColumnG[iPixel];
+            }
+        }
+
+        eErr = GDALRasterIO( hWorkBand, GF_Write, 0, iStripStart, nXSize, nLines,
+                             panG, nXSize, nLines, GDT_Int32, 0, 0 );
+
+        if( eErr == CE_None
+            && !pfnProgress( 0.5 * (iStripStart + nLines) / (double) nYSize, 
+                             "", pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Bottom-up column pass, then row pass of each strip.             */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None )
+    {
+        for( i = 0; i < nXSize; i++ )
+            panColumnG[i] = sQueue.nInfinite;
+    }
+
+    int iStripEnd;
+
+    for( iStripEnd = nYSize; 
+         eErr == CE_None && iStripEnd > 0; 
+         iStripEnd = iStripStart )
+    {
+        int nLines;
+
+        iStripStart = MAX( 0, iStripEnd - nStripLines );
+        nLines = iStripEnd - iStripStart;
+
+        eErr = GDALRasterIO( hSrcBand, GF_Read, 0, iStripStart, nXSize, nLines,
+                             panSrc, nXSize, nLines, GDT_Int32, 0, 0 );
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( hWorkBand, GF_Read, 
+                                 0, iStripStart, nXSize, nLines,
+                                 panG, nXSize, nLines, GDT_Int32, 0, 0 );
+        if( eErr != CE_None )
+            break;
+
+        for( iLine = nLines - 1; iLine >= 0; iLine-- )
+        {
+            GInt32 *panSrcLine = panSrc + (size_t) iLine * nXSize;
+            GInt32 *panGLine = panG + (size_t) iLine * nXSize;
+
+            for( iPixel = 0; iPixel < nXSize; iPixel++ )
+            {
+                if( IsTargetPixel( panSrcLine[iPixel],
+                                   nTargetValues, panTargetValues ) )
+                    panColumnG[iPixel] = 0;
+                else if( panColumnG[iPixel] < sQueue.nInfinite )
+                    panColumnG[iPixel]++;
+                if( panColumnG[iPixel] < panGLine[iPixel] )
+                    panGLine[iPixel] = panColumnG[iPixel];
+            }
+        }
+
+/* -------------------------------------------------------------------- */
+/*      The lines of the strip are independent of each other, so       */
+/*      they are shared between the threads.                            */
+/* -------------------------------------------------------------------- */
+        sQueue.nLines = nLines;
+        sQueue.iNextLine = 0;
+
+        eErr = CPLRunJobs( ExactProximityJob, papThreadData,
+                           MIN( nThreads, nLines ) );
+        if( eErr != CE_None )
+            break;
+
+        eErr = GDALRasterIO( hProximityBand, GF_Write, 
+                             0, iStripStart, nXSize, nLines,
+                             pafProximity, nXSize, nLines, GDT_Float32, 0, 0 );
+
+        if( eErr == CE_None
+            && !pfnProgress( 0.5 + 0.5 * (nYSize - iStripStart) / (double) nYSize, 
+                             "", pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Cleanup                                                         */
+/* -------------------------------------------------------------------- */
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        CPLFree( pasThreadData[iThread].panV );
+        CPLFree( pasThreadData[iThread].padfZ );
+    }
+    CPLFree( pasThreadData );
+    CPLFree( papThreadData );
+    CPLDestroyMutex( sQueue.hJobMutex );
+
+    CPLFree( panSrc );
+    CPLFree( panG );
+    CPLFree( pafProximity );
+    CPLFree( panColumnG );
+
+    if( hWorkDS != NULL )
+    {
+        CPLString osProxFile = GDALGetDescription( hWorkDS );
+        GDALClose( hWorkDS );
+        GDALDeleteDataset( GDALGetDriverByName( "GTiff" ), osProxFile );
+    }
+
+    return eErr;
+}
@@ -30,6 +30,7 @@
 #include <vector>
 
 #include "gdal_alg.h"
+#include "cpl_multiproc.h"
 #include "gdal_alg_priv.h"
 #include "gdal_priv.h"
 #include "ogr_api.h"
@@ -422,6 +423,263 @@ gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
     }
 }
 
+/************************************************************************/
+/*                       GDALRasterizeChunkQueue                        */
+/*                                                                      */
+/*      Chunks of lines of a GDALRasterizeGeometries() call, shared     */
+/*      between the threads.  hMutex protects the job counters and      */
+/*      the dataset IO.                                                 */
+/************************************************************************/
+
+typedef struct
+{
+    GDALDataset   *poDS;
+    int            nBandCount;
+    int           *panBandList;
+    GDALDataType   eType;
+    int            nYChunkSize;
+    int            nChunks;
+
+    int            nGeomCount;
+    OGRGeometryH  *pahGeometries;
+    double        *padfGeomBurnValue;
+    int            bAllTouched;
+    GDALBurnValueSrc eBurnValueSource;
+
+    /* Geometries to burn in each chunk, or empty to burn them all */
+    std::vector< std::vector<int> > aanChunkGeoms;
+
+    void          *hMutex;
+    int            iNextChunk;
+    int            nChunksDone;
+    CPLErr         eErr;
+
+    GDALProgressFunc pfnProgress;
+    void          *pProgressArg;
+} GDALRasterizeChunkQueue;
+
+typedef struct
+{
+    GDALRasterizeChunkQueue *psQueue;
+    unsigned char *pabyChunkBuf;
+    GDALTransformerFunc pfnTransformer;
+    void          *pTransformArg;
+    int            bOwnTransformer;
+    int            bMainThread;     /* the one reporting progress */
+} GDALRasterizeThreadData;
+
+/************************************************************************/
+/*                    GDALBucketGeometriesByChunk()                     */
+/*                                                                      */
+/*      Find the range of lines each geometry may burn, and add it      */
+/*      to the list of each chunk of that range.  With an affine        */
+/*      transformer the corners of the envelope are enough, otherwise   */
+/*      all the points are transformed.  The range is widened by a      */
+/*      line on each side to be safe with rounding.                     */
+/************************************************************************/
+
+static void GDALBucketGeometriesByChunk( GDALRasterizeChunkQueue *psQueue,
+                                         GDALTransformerFunc pfnTransformer,
+                                         void *pTransformArg,
+                                         int bAffineTransformer )
+
+{
+    int nYSize = psQueue->poDS->GetRasterYSize();
+    int iShape;
+
+    psQueue->aanChunkGeoms.resize( psQueue->nChunks );
+
+    for( iShape = 0; iShape < psQueue->nGeomCount; iShape++ )
+    {
+        OGRGeometry *poShape = (OGRGeometry *) psQueue->pahGeometries[iShape];
+        std::vector<double> aPointX;
+        std::vector<double> aPointY;
+
+        if( poShape == NULL )
+            continue;
+
+        if( bAffineTransformer )
+        {
+            OGREnvelope sEnvelope;
+
+            poShape->getEnvelope( &sEnvelope );
+            aPointX.push_back( sEnvelope.MinX );
+            aPointY.push_back( sEnvelope.MinY );
+            aPointX.push_back( sEnvelope.MaxX );
+            aPointY.push_back( sEnvelope.MinY );
+            aPointX.push_back( sEnvelope.MinX );
+            aPointY.push_back( sEnvelope.MaxY );
+            aPointX.push_back( sEnvelope.MaxX );
+            aPointY.push_back( sEnvelope.MaxY );
+        }
+        else
+        {
+            std::vector<double> aPointVariant;
+            std::vector<int> aPartSize;
+
+            GDALCollectRingsFromGeometry( poShape, aPointX, aPointY, 
+                                          aPointVariant, aPartSize, 
+                                          GBV_UserBurnValue );
+            if( aPointX.empty() )
+                continue;
+        }
+
+        int *panSuccess = (int *) CPLCalloc(sizeof(int),aPointX.size());
+        pfnTransformer( pTransformArg, FALSE, aPointX.size(), 
+                        &(aPointX[0]), &(aPointY[0]), NULL, panSuccess );
+        CPLFree( panSuccess );
+
+        double dfMinY = aPointY[0], dfMaxY = aPointY[0];
+        int    bValid = TRUE;
+        unsigned int i;
+
+        for( i = 0; i < aPointY.size(); i++ )
+        {
+            /* Not a number, be safe and burn it everywhere */
+            if( !(aPointY[i] == aPointY[i]) )
+                bValid = FALSE;
+            dfMinY = MIN( dfMinY, aPointY[i] );
+            dfMaxY = MAX( dfMaxY, aPointY[i] );
+        }
+
+        int iFirstChunk = 0, iLastChunk = psQueue->nChunks - 1;
+
+        if( bValid )
+        {
+            dfMinY = floor(dfMinY) - 1;
+            dfMaxY = floor(dfMaxY) + 1;
+            if( dfMaxY < 0 || dfMinY >= nYSize )
+                continue;
+
+            iFirstChunk = (int) MAX( dfMinY, 0 ) / psQueue->nYChunkSize;
+            iLastChunk = (int) MIN( dfMaxY, nYSize - 1 ) / psQueue->nYChunkSize;
+        }
+
+        for( int iChunk = iFirstChunk; iChunk <= iLastChunk; iChunk++ )
+            psQueue->aanChunkGeoms[iChunk].push_back( iShape );
+    }
+}
+
+/************************************************************************/
+/*                       GDALRasterizeNextChunk()                       */
+/*                                                                      */
+/*      Read, burn and write the next chunk of the queue.  Returns      */
+/*      FALSE when there is nothing left to do.                         */
+/************************************************************************/
+
+static int GDALRasterizeNextChunk( GDALRasterizeThreadData *psData )
+
+{
+    GDALRasterizeChunkQueue *psQueue = psData->psQueue;
+    GDALDataset *poDS = psQueue->poDS;
+    int iChunk;
+    CPLErr eErr;
+
+    CPLAcquireMutex( psQueue->hMutex, 1000.0 );
+    if( psQueue->eErr != CE_None || psQueue->iNextChunk >= psQueue->nChunks )
+    {
+        CPLReleaseMutex( psQueue->hMutex );
+        return FALSE;
+    }
+    iChunk = psQueue->iNextChunk++;
+
+    int iY = iChunk * psQueue->nYChunkSize;
+    int nThisYChunkSize = MIN( psQueue->nYChunkSize, 
+                               poDS->GetRasterYSize() - iY );
+
+    eErr = 
+        poDS->RasterIO(GF_Read, 
+                       0, iY, poDS->GetRasterXSize(), nThisYChunkSize, 
+                       psData->pabyChunkBuf,
+                       poDS->GetRasterXSize(), nThisYChunkSize,
+                       psQueue->eType, psQueue->nBandCount, 
+                       psQueue->panBandList, 0, 0, 0 );
+    if( eErr != CE_None )
+        psQueue->eErr = eErr;
+    CPLReleaseMutex( psQueue->hMutex );
+
+    if( eErr != CE_None )
+        return FALSE;
+
+    int nShapes = psQueue->nGeomCount;
+    const int *panShapes = NULL;
+
+    if( !psQueue->aanChunkGeoms.empty() )
+    {
+        nShapes = (int) psQueue->aanChunkGeoms[iChunk].size();
+        if( nShapes > 0 )
+            panShapes = &(psQueue->aanChunkGeoms[iChunk][0]);
+    }
+
+    for( int i = 0; i < nShapes; i++ )
+    {
+        int iShape = panShapes ? panShapes[i] : i;
+
+        gv_rasterize_one_shape( psData->pabyChunkBuf, iY,
+                                poDS->GetRasterXSize(), nThisYChunkSize,
+                                psQueue->nBandCount, psQueue->eType, 
+                                psQueue->bAllTouched,
+                                (OGRGeometry *) psQueue->pahGeometries[iShape],
+                                psQueue->padfGeomBurnValue 
+                                    + iShape*psQueue->nBandCount,
+                                psQueue->eBurnValueSource,
+                                psData->pfnTransformer, psData->pTransformArg );
+    }
+
+    CPLAcquireMutex( psQueue->hMutex, 1000.0 );
+    eErr = 
+        poDS->RasterIO( GF_Write, 0, iY,
+                        poDS->GetRasterXSize(), nThisYChunkSize, 
+                        psData->pabyChunkBuf,
+                        poDS->GetRasterXSize(), nThisYChunkSize, 
+                        psQueue->eType, psQueue->nBandCount, 
+                        psQueue->panBandList, 0, 0, 0 );
+    if( eErr != CE_None )
+        psQueue->eErr = eErr;
+    psQueue->nChunksDone++;
+    CPLReleaseMutex( psQueue->hMutex );
+
+    return eErr == CE_None;
+}
+
+/************************************************************************/
+/*                          GDALRasterizeJob()                          */
+/*                                                                      */
+/*      Burn chunks until there are none left.  Progress is only        */
+/*      reported from the main thread.                                  */
+/************************************************************************/
+
+static CPLErr GDALRasterizeJob( void *pThreadData )
+
+{
+    GDALRasterizeThreadData *psData = (GDALRasterizeThreadData *) pThreadData;
+    GDALRasterizeChunkQueue *psQueue = psData->psQueue;
+
+    while( GDALRasterizeNextChunk( psData ) )
+    {
+        if( !psData->bMainThread )
+            continue;
+
+        CPLAcquireMutex( psQueue->hMutex, 1000.0 );
+        double dfComplete = psQueue->nChunksDone / (double) psQueue->nChunks;
+        CPLReleaseMutex( psQueue->hMutex );
+
+        if( !psQueue->pfnProgress( dfComplete, "", psQueue->pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            CPLAcquireMutex( psQueue->hMutex, 1000.0 );
+            psQueue->eErr = CE_Failure;
+            CPLReleaseMutex( psQueue->hMutex );
+        }
+    }
+
+    CPLAcquireMutex( psQueue->hMutex, 1000.0 );
+    CPLErr eErr = psQueue->eErr;
+    CPLReleaseMutex( psQueue->hMutex );
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                      GDALRasterizeGeometries()                       */
 /************************************************************************/
@@ -467,6 +725,9 @@ gv_rasterize_one_shape( unsigned char *pabyChunkBuf, int nYOff,
  * Defaults to GDALBurnValueSrc.GBV_UserBurnValue in which case just the
  * dfBurnValue is burned. This is implemented only for points and lines for
  * now. The M value may be supported in the future.</dd>
+ * <dt>"NUM_THREADS":</dt> <dd>Number of threads burning chunks of lines
+ * of the raster concurrently (GDAL >= 1.10).  Defaults to 1.  Only used
+ * when pfnTransformer is NULL.</dd>
  * </dl>
  * @param pfnProgress the progress function to report completion.
  * @param pProgressArg callback data for progress function.
@@ -487,8 +748,6 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
 {
     GDALDataType   eType;
     int            nYChunkSize, nScanlineBytes;
-    unsigned char *pabyChunkBuf;
-    int            iY;
     GDALDataset *poDS = (GDALDataset *) hDS;
 
     if( pfnProgress == NULL )
@@ -551,72 +810,130 @@ CPLErr GDALRasterizeGeometries( GDALDatasetH hDS,
     nYChunkSize = 10000000 / nScanlineBytes;
     if( nYChunkSize > poDS->GetRasterYSize() )
         nYChunkSize = poDS->GetRasterYSize();
+    if( nYChunkSize < 1 )
+        nYChunkSize = 1;
 
-    pabyChunkBuf = (unsigned char *) VSIMalloc(nYChunkSize * nScanlineBytes);
-    if( pabyChunkBuf == NULL )
+    GDALRasterizeChunkQueue sQueue;
+
+    sQueue.poDS = poDS;
+    sQueue.nBandCount = nBandCount;
+    sQueue.panBandList = panBandList;
+    sQueue.eType = eType;
+    sQueue.nYChunkSize = nYChunkSize;
+    sQueue.nChunks = (poDS->GetRasterYSize() + nYChunkSize - 1) / nYChunkSize;
+    sQueue.nGeomCount = nGeomCount;
+    sQueue.pahGeometries = pahGeometries;
+    sQueue.padfGeomBurnValue = padfGeomBurnValue;
+    sQueue.bAllTouched = bAllTouched;
+    sQueue.eBurnValueSource = eBurnValueSource;
+    sQueue.hMutex = NULL;
+    sQueue.iNextChunk = 0;
+    sQueue.nChunksDone = 0;
+    sQueue.eErr = CE_None;
+    sQueue.pfnProgress = pfnProgress;
+    sQueue.pProgressArg = pProgressArg;
+
+/* -------------------------------------------------------------------- */
+/*      With several chunks, find which chunks each geometry may        */
+/*      touch, so that each chunk only goes through its own ones.       */
+/*      The geometries keep their order within a chunk.                 */
+/* -------------------------------------------------------------------- */
+    if( sQueue.nChunks > 1 )
+        GDALBucketGeometriesByChunk( &sQueue, pfnTransformer, pTransformArg,
+                                     bNeedToFreeTransformer );
+
+/* -------------------------------------------------------------------- */
+/*      Prepare the worker threads, each one with its own buffer and    */
+/*      transformer.  We cannot duplicate a caller provided             */
+/*      transformer, so it restricts us to the current thread.          */
+/* -------------------------------------------------------------------- */
+    int nThreads = atoi(CSLFetchNameValueDef( papszOptions, "NUM_THREADS", "1" ));
+    nThreads = MAX( 1, MIN( nThreads, sQueue.nChunks ) );
+    if( nThreads > 1 && !bNeedToFreeTransformer )
     {
-        CPLError( CE_Failure, CPLE_OutOfMemory, 
-                  "Unable to allocate rasterization buffer." );
-        return CE_Failure;
+        CPLDebug( "GDAL", "Rasterizing with a caller provided transformer, "
+                  "using a single thread." );
+        nThreads = 1;
+    }
+
+    std::vector<GDALRasterizeThreadData> asThreadData( nThreads );
+    int iThread;
+
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        GDALRasterizeThreadData *psData = &asThreadData[iThread];
+
+        psData->psQueue = &sQueue;
+        psData->pabyChunkBuf = NULL;
+        psData->pfnTransformer = pfnTransformer;
+        psData->pTransformArg = pTransformArg;
+        psData->bOwnTransformer = FALSE;
+        psData->bMainThread = (iThread == 0);
+
+        if( iThread > 0 )
+        {
+            psData->pTransformArg = 
+                GDALCreateGenImgProjTransformer( NULL, NULL, hDS, NULL, 
+                                                 FALSE, 0.0, 0);
+            if( psData->pTransformArg == NULL )
+            {
+                CPLError( CE_Failure, CPLE_AppDefined, 
+                          "Unable to create the transformer of rasterization "
+                          "thread %d.", iThread );
+                sQueue.eErr = CE_Failure;
+                break;
+            }
+            psData->bOwnTransformer = TRUE;
+        }
+
+        psData->pabyChunkBuf = (unsigned char *) 
+            VSIMalloc(nYChunkSize * nScanlineBytes);
+        if( psData->pabyChunkBuf == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OutOfMemory, 
+                      "Unable to allocate rasterization buffer." );
+            sQueue.eErr = CE_Failure;
+            break;
+        }
     }
 
 /* ==================================================================== */
-/*      Loop over image in designated chunks.                           */
+/*      Process the chunks with the worker threads and this one.        */
+/*      Progress is only reported from this thread.                     */
 /* ==================================================================== */
     CPLErr  eErr = CE_None;
 
     pfnProgress( 0.0, NULL, pProgressArg );
 
-    for( iY = 0; 
-         iY < poDS->GetRasterYSize() && eErr == CE_None; 
-         iY += nYChunkSize )
-    {
-        int	nThisYChunkSize;
-        int     iShape;
-
-        nThisYChunkSize = nYChunkSize;
-        if( nThisYChunkSize + iY > poDS->GetRasterYSize() )
-            nThisYChunkSize = poDS->GetRasterYSize() - iY;
-
-        eErr = 
-            poDS->RasterIO(GF_Read, 
-                           0, iY, poDS->GetRasterXSize(), nThisYChunkSize, 
-                           pabyChunkBuf,poDS->GetRasterXSize(),nThisYChunkSize,
-                           eType, nBandCount, panBandList,
-                           0, 0, 0 );
-        if( eErr != CE_None )
-            break;
+    sQueue.hMutex = CPLCreateMutex();
+    CPLReleaseMutex( sQueue.hMutex );
 
-        for( iShape = 0; iShape < nGeomCount; iShape++ )
-        {
-            gv_rasterize_one_shape( pabyChunkBuf, iY,
-                                    poDS->GetRasterXSize(), nThisYChunkSize,
-                                    nBandCount, eType, bAllTouched,
-                                    (OGRGeometry *) pahGeometries[iShape],
-                                    padfGeomBurnValue + iShape*nBandCount,
-                                    eBurnValueSource,
-                                    pfnTransformer, pTransformArg );
-        }
+    if( sQueue.eErr == CE_None )
+    {
+        std::vector<void *> apThreadData( nThreads );
 
-        eErr = 
-            poDS->RasterIO( GF_Write, 0, iY,
-                            poDS->GetRasterXSize(), nThisYChunkSize, 
-                            pabyChunkBuf,
-                            poDS->GetRasterXSize(), nThisYChunkSize, 
-                            eType, nBandCount, panBandList, 0, 0, 0 );
+        for( iThread = 0; iThread < nThreads; iThread++ )
+            apThreadData[iThread] = &asThreadData[iThread];
 
-        if( !pfnProgress((iY+nThisYChunkSize)/((double)poDS->GetRasterYSize()),
-                         "", pProgressArg ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-        }
+        /* The first job is run by this thread */
+        eErr = CPLRunJobs( GDALRasterizeJob, &apThreadData[0], nThreads );
     }
-    
+    else
+        eErr = sQueue.eErr;
+
+    if( eErr == CE_None )
+        pfnProgress( 1.0, "", pProgressArg );
+
 /* -------------------------------------------------------------------- */
 /*      cleanup                                                         */
 /* -------------------------------------------------------------------- */
-    VSIFree( pabyChunkBuf );
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        VSIFree( asThreadData[iThread].pabyChunkBuf );
+        if( asThreadData[iThread].bOwnTransformer )
+            GDALDestroyTransformer( asThreadData[iThread].pTransformArg );
+    }
+    CPLDestroyMutex( sQueue.hMutex );
     
     if( bNeedToFreeTransformer )
         GDALDestroyTransformer( pTransformArg );
@@ -29,7 +29,11 @@
 
 #include "gdal_alg_priv.h"
 #include "cpl_conv.h"
+#include "cpl_multiproc.h"
+#include "cpl_string.h"
 #include <vector>
+#include <map>
+#include <algorithm>
 
 CPL_CVSID("$Id$");
 
@@ -128,6 +132,919 @@ static inline void CompareNeighbour( int nPolyId1, int nPolyId2,
         anBigNeighbour[nPolyId2] = nPolyId1;
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*                     Strip based sieve filter                         */
+/*                                                                      */
+/*      The raster is split in horizontal strips, each with its own     */
+/*      polygon enumerator.  The polygons of adjacent strips are        */
+/*      joined using the last and first lines of the strips.  The       */
+/*      largest neighbour search remembers the position of the pixel    */
+/*      comparison that found each neighbour, so the results of the     */
+/*      strips can be combined into the neighbour the single            */
+/*      threaded pass over the whole raster would have found.           */
+/* ==================================================================== */
+/************************************************************************/
+
+class GDALSieveStrip 
+{
+public:
+    GDALSieveStrip( int nConnectedness ) : oEnum( nConnectedness ) {}
+
+    int         nYStart;
+    int         nYEnd;
+    int         nIdOffset;      /* of the strip polygons in the global ids */
+
+    GDALRasterPolygonEnumerator oEnum;
+    std::vector<int>    anPolySizes;
+
+    /* masked values and polygon ids of the first and last lines */
+    std::vector<GInt32> anFirstLineVal;
+    std::vector<GInt32> anFirstLineId;
+    std::vector<GInt32> anLastLineVal;
+    std::vector<GInt32> anLastLineId;
+
+    /* global polygon ids of the last line of the previous strip */
+    std::vector<int>    anAboveLineId;
+
+    /* largest neighbour found in this strip for the polygons of the    */
+    /* strip, and for the polygons of the line above the strip, with    */
+    /* the position of the comparison that found it.                    */
+    std::vector<int>    anBigNeighbour;
+    std::vector<GIntBig> anBigNeighbourPos;
+    std::map< int, std::pair<int,GIntBig> > oMapAboveBigNeighbour;
+};
+
+class GDALSieveJob 
+{
+public:
+    GDALRasterBandH hSrcBand;
+    GDALRasterBandH hMaskBand;
+    GDALRasterBandH hDstBand;
+    int         nConnectedness;
+    int         nXSize;
+    int         nYSize;
+    int         nChunkLines;
+    int         nPass;
+
+    std::vector<GDALSieveStrip*> apoStrips;
+
+    /* indexed by global polygon id */
+    std::vector<int>    anPolyIdMap;
+    std::vector<int>    anPolySizes;
+    std::vector<GInt32> anPolyValue;
+    std::vector<int>    anBigNeighbour;
+    std::vector<GIntBig> anBigNeighbourPos;
+
+    /* protects the members below, and raster IO */
+    void       *hMutex;
+    CPLErr      eErr;
+    int         nNextStrip;
+    int         nLinesDone;
+
+    GDALProgressFunc pfnProgress;
+    void       *pProgressArg;
+    double      dfProgressBase;
+};
+
+/************************************************************************/
+/*                         GDALSieveReadLines()                         */
+/*                                                                      */
+/*      Read source lines, optionally keeping the unmasked values.      */
+/************************************************************************/
+
+static CPLErr GDALSieveReadLines( GDALSieveJob *psJob, int iY, int nLines,
+                                  GInt32 *panVal, GInt32 *panRawVal,
+                                  GByte *pabyMask )
+
+{
+    int nXSize = psJob->nXSize;
+    CPLErr eErr;
+
+    CPLAcquireMutex( psJob->hMutex, 1000.0 );
+
+    eErr = psJob->eErr;
+    if( eErr == CE_None )
+        eErr = GDALRasterIO( psJob->hSrcBand, GF_Read, 0, iY, nXSize, nLines,
+                             panVal, nXSize, nLines, GDT_Int32, 0, 0 );
+
+    if( eErr == CE_None && psJob->hMaskBand != NULL )
+        eErr = GDALRasterIO( psJob->hMaskBand, GF_Read, 0, iY, nXSize, nLines,
+                             pabyMask, nXSize, nLines, GDT_Byte, 0, 0 );
+
+    CPLReleaseMutex( psJob->hMutex );
+
+    if( eErr != CE_None )
+        return eErr;
+
+    if( panRawVal != NULL )
+        memcpy( panRawVal, panVal, sizeof(GInt32) * nXSize * nLines );
+
+    if( psJob->hMaskBand != NULL )
+    {
+        int i;
+        for( i = 0; i < nXSize * nLines; i++ )
+        {
+            if( pabyMask[i] == 0 )
+                panVal[i] = GP_NODATA_MARKER;
+        }
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                       GDALSieveLinesDone()                           */
+/*                                                                      */
+/*      Account for processed lines, and report progress from the       */
+/*      main thread.                                                    */
+/************************************************************************/
+
+static CPLErr GDALSieveLinesDone( GDALSieveJob *psJob, int nLines, 
+                                  int bMainThread )
+
+{
+    CPLAcquireMutex( psJob->hMutex, 1000.0 );
+    psJob->nLinesDone += nLines;
+    double dfComplete = psJob->dfProgressBase 
+        + 0.25 * psJob->nLinesDone / (double) psJob->nYSize;
+    CPLReleaseMutex( psJob->hMutex );
+
+    if( psJob->nPass == 3 )
+        dfComplete = 0.5 + 0.5 * (dfComplete - 0.5) / 0.25;
+
+    if( bMainThread 
+        && !psJob->pfnProgress( dfComplete, "", psJob->pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                     GDALSieveUpdateNeighbour()                       */
+/************************************************************************/
+
+static inline void GDALSieveUpdateNeighbour( GDALSieveJob *psJob,
+                                             GDALSieveStrip *poStrip,
+                                             int iLocalId, int nPolyId,
+                                             int nNeighbourId, GIntBig nPos )
+
+{
+    int *pnBig;
+    GIntBig *pnBigPos;
+
+    if( iLocalId >= 0 )
+    {
+        pnBig = &(poStrip->anBigNeighbour[iLocalId]);
+        pnBigPos = &(poStrip->anBigNeighbourPos[iLocalId]);
+    }
+    else
+    {
+        std::map< int, std::pair<int,GIntBig> >::iterator oIter = 
+            poStrip->oMapAboveBigNeighbour.find( nPolyId );
+
+        if( oIter == poStrip->oMapAboveBigNeighbour.end() )
+            oIter = poStrip->oMapAboveBigNeighbour.insert( 
+                std::pair< int, std::pair<int,GIntBig> >( 
+                    nPolyId, std::pair<int,GIntBig>( -1, 0 ) ) ).first;
+
+        pnBig = &(oIter->second.first);
+        pnBigPos = &(oIter->second.second);
+    }
+
+    if( *pnBig == -1 
+        || psJob->anPolySizes[*pnBig] < psJob->anPolySizes[nNeighbourId] )
+    {
+        *pnBig = nNeighbourId;
+        *pnBigPos = nPos;
+    }
+}
+
+/************************************************************************/
+/*                      GDALSieveCompareNeighbour()                     */
+/*                                                                      */
+/*      Same as CompareNeighbour() with global polygon ids, for         */
+/*      polygons given by their strip id, or -1 for the line above      */
+/*      the strip.                                                      */
+/************************************************************************/
+
+static inline void GDALSieveCompareNeighbour( GDALSieveJob *psJob,
+                                              GDALSieveStrip *poStrip,
+                                              int iLocalId1, int nPolyId1,
+                                              int iLocalId2, int nPolyId2,
+                                              GIntBig nPos )
+
+{
+    if( nPolyId1 == nPolyId2 )
+        return;
+
+    if( psJob->anPolyValue[nPolyId1] == GP_NODATA_MARKER
+        || psJob->anPolyValue[nPolyId2] == GP_NODATA_MARKER )
+        return;
+
+    GDALSieveUpdateNeighbour( psJob, poStrip, iLocalId1, nPolyId1, 
+                              nPolyId2, nPos );
+    GDALSieveUpdateNeighbour( psJob, poStrip, iLocalId2, nPolyId2, 
+                              nPolyId1, nPos );
+}
+
+/************************************************************************/
+/*                        GDALSieveProcessStrip()                       */
+/*                                                                      */
+/*      Run the current pass on one strip:                              */
+/*       1) enumerate the polygons of the strip, and their sizes.       */
+/*       2) find the largest neighbour of the polygons.                 */
+/*       3) write the merged pixel values.                              */
+/************************************************************************/
+
+static CPLErr GDALSieveProcessStrip( GDALSieveJob *psJob, 
+                                     GDALSieveStrip *poStrip,
+                                     int bMainThread )
+
+{
+    int nXSize = psJob->nXSize;
+    int nChunkLines = psJob->nChunkLines;
+    int nPass = psJob->nPass;
+    int bEight = (psJob->nConnectedness == 8);
+    CPLErr eErr = CE_None;
+
+    GInt32 *panChunkVal = (GInt32 *) 
+        VSIMalloc3( sizeof(GInt32), nXSize, nChunkLines );
+    GInt32 *panChunkRaw = (nPass == 3) ? (GInt32 *) 
+        VSIMalloc3( sizeof(GInt32), nXSize, nChunkLines ) : NULL;
+    GByte *pabyChunkMask = (psJob->hMaskBand != NULL) ? (GByte *)
+        VSIMalloc2( nXSize, nChunkLines ) : NULL;
+    GInt32 *panSavedLineVal = (GInt32 *) VSIMalloc2(sizeof(GInt32), nXSize);
+    GInt32 *panLastLineId = (GInt32 *) VSIMalloc2(sizeof(GInt32), nXSize);
+    GInt32 *panThisLineId = (GInt32 *) VSIMalloc2(sizeof(GInt32), nXSize);
+    int *panLastLocal = (int *) VSIMalloc2(sizeof(int), nXSize);
+    int *panThisLocal = (int *) VSIMalloc2(sizeof(int), nXSize);
+    int *panLastGlobal = (int *) VSIMalloc2(sizeof(int), nXSize);
+    int *panThisGlobal = (int *) VSIMalloc2(sizeof(int), nXSize);
+
+    if( panChunkVal == NULL || (nPass == 3 && panChunkRaw == NULL)
+        || (psJob->hMaskBand != NULL && pabyChunkMask == NULL)
+        || panSavedLineVal == NULL 
+        || panLastLineId == NULL || panThisLineId == NULL 
+        || panLastLocal == NULL || panThisLocal == NULL 
+        || panLastGlobal == NULL || panThisGlobal == NULL )
+    {
+        CPLError(CE_Failure, CPLE_OutOfMemory,
+                 "Could not allocate enough memory for temporary buffers");
+        eErr = CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      The second and third passes use a new enumerator, mapped to     */
+/*      the polygons of the first pass.                                 */
+/* -------------------------------------------------------------------- */
+    GDALRasterPolygonEnumerator oSecondEnum( psJob->nConnectedness );
+    GDALRasterPolygonEnumerator *poEnum = 
+        (nPass == 1) ? &(poStrip->oEnum) : &oSecondEnum;
+    int *panPolyIdMap = (nPass == 1) ? NULL : poStrip->oEnum.panPolyIdMap;
+
+    if( nPass == 2 && eErr == CE_None )
+    {
+        poStrip->anBigNeighbour.resize( poStrip->oEnum.nNextPolygonId, -1 );
+        poStrip->anBigNeighbourPos.resize( poStrip->oEnum.nNextPolygonId, 0 );
+    }
+
+    int iY, iX;
+    GInt32 *panLastLineVal = NULL;
+
+    for( iY = poStrip->nYStart; eErr == CE_None && iY < poStrip->nYEnd; iY++ )
+    {
+        int iLine = (iY - poStrip->nYStart) % nChunkLines;
+        int nLines = MIN(nChunkLines, poStrip->nYEnd - (iY - iLine));
+
+/* -------------------------------------------------------------------- */
+/*      Load a new chunk of lines.                                      */
+/* -------------------------------------------------------------------- */
+        if( iLine == 0 )
+        {
+            if( panLastLineVal != NULL )
+            {
+                memcpy( panSavedLineVal, panLastLineVal, 
+                        sizeof(GInt32) * nXSize );
+                panLastLineVal = panSavedLineVal;
+            }
+
+            eErr = GDALSieveReadLines( psJob, iY, nLines, panChunkVal, 
+                                       panChunkRaw, pabyChunkMask );
+            if( eErr != CE_None )
+                break;
+        }
+
+        GInt32 *panThisLineVal = panChunkVal + iLine * nXSize;
+
+        poEnum->ProcessLine( panLastLineVal, panThisLineVal, 
+                             panLastLineVal ? panLastLineId : NULL, 
+                             panThisLineId, nXSize );
+
+/* -------------------------------------------------------------------- */
+/*      First pass: accumulate polygon sizes.                           */
+/* -------------------------------------------------------------------- */
+        if( nPass == 1 )
+        {
+            if( poEnum->nNextPolygonId > (int) poStrip->anPolySizes.size() )
+                poStrip->anPolySizes.resize( poEnum->nNextPolygonId );
+
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                int iPoly = panThisLineId[iX]; 
+
+                if( poStrip->anPolySizes[iPoly] < MY_MAX_INT )
+                    poStrip->anPolySizes[iPoly] += 1;
+            }
+
+            if( iY == poStrip->nYStart )
+            {
+                poStrip->anFirstLineVal.assign( panThisLineVal, 
+                                                panThisLineVal + nXSize );
+                poStrip->anFirstLineId.assign( panThisLineId, 
+                                               panThisLineId + nXSize );
+            }
+            if( iY == poStrip->nYEnd - 1 )
+            {
+                poStrip->anLastLineVal.assign( panThisLineVal, 
+                                               panThisLineVal + nXSize );
+                poStrip->anLastLineId.assign( panThisLineId, 
+                                              panThisLineId + nXSize );
+            }
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Second pass: compare neighbours in the same order as            */
+/*      GDALSieveFilter() does, pixel positions giving that order.      */
+/* -------------------------------------------------------------------- */
+        else if( nPass == 2 )
+        {
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                panThisLocal[iX] = panPolyIdMap[panThisLineId[iX]];
+                panThisGlobal[iX] = 
+                    psJob->anPolyIdMap[poStrip->nIdOffset + panThisLocal[iX]];
+            }
+
+            int bHaveAbove = (iY > 0);
+
+            if( iY == poStrip->nYStart && bHaveAbove )
+            {
+                for( iX = 0; iX < nXSize; iX++ )
+                {
+                    panLastLocal[iX] = -1;
+                    panLastGlobal[iX] = poStrip->anAboveLineId[iX];
+                }
+            }
+
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                GIntBig nPos = (((GIntBig) iY) * nXSize + iX) * 4;
+
+                if( bHaveAbove )
+                {
+                    GDALSieveCompareNeighbour( 
+                        psJob, poStrip, 
+                        panThisLocal[iX], panThisGlobal[iX], 
+                        panLastLocal[iX], panLastGlobal[iX], nPos );
+
+                    if( iX > 0 && bEight )
+                        GDALSieveCompareNeighbour( 
+                            psJob, poStrip, 
+                            panThisLocal[iX], panThisGlobal[iX], 
+                            panLastLocal[iX-1], panLastGlobal[iX-1], nPos+1 );
+
+                    if( iX < nXSize-1 && bEight )
+                        GDALSieveCompareNeighbour( 
+                            psJob, poStrip, 
+                            panThisLocal[iX], panThisGlobal[iX], 
+                            panLastLocal[iX+1], panLastGlobal[iX+1], nPos+2 );
+                }
+
+                if( iX > 0 )
+                    GDALSieveCompareNeighbour( 
+                        psJob, poStrip, 
+                        panThisLocal[iX], panThisGlobal[iX], 
+                        panThisLocal[iX-1], panThisGlobal[iX-1], nPos+3 );
+            }
+
+            std::swap( panLastLocal, panThisLocal );
+            std::swap( panLastGlobal, panThisGlobal );
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Third pass: remap the pixel values of the merged polygons.      */
+/* -------------------------------------------------------------------- */
+        else
+        {
+            GInt32 *panThisLineWriteVal = panChunkRaw + iLine * nXSize;
+
+            for( iX = 0; iX < nXSize; iX++ )
+            {
+                int nPolyId = psJob->anPolyIdMap[
+                    poStrip->nIdOffset + panPolyIdMap[panThisLineId[iX]]];
+
+                if( psJob->anBigNeighbour[nPolyId] != -1 )
+                    panThisLineWriteVal[iX] = 
+                        psJob->anPolyValue[psJob->anBigNeighbour[nPolyId]];
+            }
+        }
+
+        panLastLineVal = panThisLineVal;
+        std::swap( panLastLineId, panThisLineId );
+
+/* -------------------------------------------------------------------- */
+/*      Write out the chunk in the third pass, and report progress.     */
+/* -------------------------------------------------------------------- */
+        if( iLine == nLines - 1 )
+        {
+            int iChunkY = iY - iLine;
+
+            if( nPass == 3 )
+            {
+                CPLAcquireMutex( psJob->hMutex, 1000.0 );
+                eErr = GDALRasterIO( psJob->hDstBand, GF_Write, 
+                                     0, iChunkY, nXSize, nLines, 
+                                     panChunkRaw, nXSize, nLines, 
+                                     GDT_Int32, 0, 0 );
+                CPLReleaseMutex( psJob->hMutex );
+            }
+
+            if( eErr == CE_None )
+                eErr = GDALSieveLinesDone( psJob, nLines, bMainThread );
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Make the first pass polygon ids final, and push the sizes of    */
+/*      merged polygon fragments into the merged polygon.               */
+/* -------------------------------------------------------------------- */
+    if( nPass == 1 && eErr == CE_None )
+    {
+        GDALRasterPolygonEnumerator &oEnum = poStrip->oEnum;
+        int iPoly;
+
+        oEnum.CompleteMerges();
+
+        for( iPoly = 0; iPoly < oEnum.nNextPolygonId; iPoly++ )
+        {
+            if( oEnum.panPolyIdMap[iPoly] != iPoly )
+            {
+                GIntBig nSize = poStrip->anPolySizes[oEnum.panPolyIdMap[iPoly]];
+
+                nSize += poStrip->anPolySizes[iPoly];
+            
+                if( nSize > MY_MAX_INT )
+                    nSize = MY_MAX_INT;
+
+                poStrip->anPolySizes[oEnum.panPolyIdMap[iPoly]] = (int)nSize;
+                poStrip->anPolySizes[iPoly] = 0;
+            }
+        }
+
+        for( iX = 0; iX < nXSize; iX++ )
+        {
+            poStrip->anFirstLineId[iX] = 
+                oEnum.panPolyIdMap[poStrip->anFirstLineId[iX]];
+            poStrip->anLastLineId[iX] = 
+                oEnum.panPolyIdMap[poStrip->anLastLineId[iX]];
+        }
+    }
+
+    CPLFree( panChunkVal );
+    CPLFree( panChunkRaw );
+    CPLFree( pabyChunkMask );
+    CPLFree( panSavedLineVal );
+    CPLFree( panLastLineId );
+    CPLFree( panThisLineId );
+    CPLFree( panLastLocal );
+    CPLFree( panThisLocal );
+    CPLFree( panLastGlobal );
+    CPLFree( panThisGlobal );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                        GDALSieveRunStrips()                          */
+/************************************************************************/
+
+static CPLErr GDALSieveRunStrips( GDALSieveJob *psJob, int bMainThread )
+
+{
+    while( TRUE )
+    {
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        int iStrip = psJob->nNextStrip++;
+        int bStop = (iStrip >= (int) psJob->apoStrips.size() 
+                     || psJob->eErr != CE_None);
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( bStop )
+            return CE_None;
+
+        CPLErr eErr = GDALSieveProcessStrip( psJob, psJob->apoStrips[iStrip],
+                                             bMainThread );
+
+        if( eErr != CE_None )
+        {
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+            if( psJob->eErr == CE_None )
+                psJob->eErr = eErr;
+            CPLReleaseMutex( psJob->hMutex );
+            return eErr;
+        }
+    }
+}
+
+typedef struct
+{
+    GDALSieveJob   *psJob;
+    int             bMainThread;    /* the one reporting progress */
+} GDALSieveThreadData;
+
+static CPLErr GDALSieveStripsJob( void *pData )
+
+{
+    GDALSieveThreadData *psThreadData = (GDALSieveThreadData *) pData;
+
+    return GDALSieveRunStrips( psThreadData->psJob,
+                               psThreadData->bMainThread );
+}
+
+/************************************************************************/
+/*                          GDALSieveRunPass()                          */
+/*                                                                      */
+/*      Run one pass over all strips in nThreads threads, this one      */
+/*      included.                                                       */
+/************************************************************************/
+
+static CPLErr GDALSieveRunPass( GDALSieveJob *psJob, int nPass, 
+                                int nThreads )
+
+{
+    int iThread;
+
+    psJob->nPass = nPass;
+    psJob->nNextStrip = 0;
+    psJob->nLinesDone = 0;
+    psJob->dfProgressBase = 0.25 * (nPass - 1);
+
+    GDALSieveThreadData *pasThreadData = (GDALSieveThreadData *) 
+        CPLCalloc( sizeof(GDALSieveThreadData), nThreads );
+    void **papThreadData = (void **) CPLCalloc( sizeof(void *), nThreads );
+
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        pasThreadData[iThread].psJob = psJob;
+        pasThreadData[iThread].bMainThread = (iThread == 0);
+        papThreadData[iThread] = pasThreadData + iThread;
+    }
+
+    /* The first job is run by this thread */
+    CPLErr eErr = CPLRunJobs( GDALSieveStripsJob, papThreadData, nThreads );
+
+    CPLFree( papThreadData );
+    CPLFree( pasThreadData );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GDALSieveFindRoot()                          */
+/************************************************************************/
+
+static int GDALSieveFindRoot( std::vector<int> &anPolyIdMap, int nPolyId )
+
+{
+    while( anPolyIdMap[nPolyId] != nPolyId )
+    {
+        anPolyIdMap[nPolyId] = anPolyIdMap[anPolyIdMap[nPolyId]];
+        nPolyId = anPolyIdMap[nPolyId];
+    }
+
+    return nPolyId;
+}
+
+/************************************************************************/
+/*                    GDALSieveMergeStripPolygons()                     */
+/*                                                                      */
+/*      Assign global ids to the polygons of the strips, and merge      */
+/*      the polygons connected across strip boundaries with the         */
+/*      rules of GDALRasterPolygonEnumerator::ProcessLine().            */
+/************************************************************************/
+
+static void GDALSieveMergeStripPolygons( GDALSieveJob *psJob )
+
+{
+    std::vector<GDALSieveStrip*> &apoStrips = psJob->apoStrips;
+    std::vector<int> &anPolyIdMap = psJob->anPolyIdMap;
+    int nXSize = psJob->nXSize;
+    int nPolys = 0;
+    size_t iStrip;
+    int iPoly, iX;
+
+    for( iStrip = 0; iStrip < apoStrips.size(); iStrip++ )
+    {
+        apoStrips[iStrip]->nIdOffset = nPolys;
+        nPolys += apoStrips[iStrip]->oEnum.nNextPolygonId;
+    }
+
+    anPolyIdMap.resize( nPolys );
+    psJob->anPolyValue.resize( nPolys );
+
+    for( iStrip = 0; iStrip < apoStrips.size(); iStrip++ )
+    {
+        GDALSieveStrip *poStrip = apoStrips[iStrip];
+
+        for( iPoly = 0; iPoly < poStrip->oEnum.nNextPolygonId; iPoly++ )
+        {
+            anPolyIdMap[poStrip->nIdOffset + iPoly] = 
+                poStrip->nIdOffset + poStrip->oEnum.panPolyIdMap[iPoly];
+            psJob->anPolyValue[poStrip->nIdOffset + iPoly] = 
+                poStrip->oEnum.panPolyValue[iPoly];
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Join the polygons across strip boundaries.                      */
+/* -------------------------------------------------------------------- */
+    for( iStrip = 1; iStrip < apoStrips.size(); iStrip++ )
+    {
+        GDALSieveStrip *poAbove = apoStrips[iStrip-1];
+        GDALSieveStrip *poStrip = apoStrips[iStrip];
+        GInt32 *panLastVal = &(poAbove->anLastLineVal[0]);
+        GInt32 *panThisVal = &(poStrip->anFirstLineVal[0]);
+
+        for( iX = 0; iX < nXSize; iX++ )
+        {
+            int iAboveX;
+
+            if( iX > 0 && panThisVal[iX] == panThisVal[iX-1] )
+                iAboveX = (panLastVal[iX] == panThisVal[iX]) ? iX : -1;
+            else if( panLastVal[iX] == panThisVal[iX] )
+                iAboveX = iX;
+            else if( iX > 0 && psJob->nConnectedness == 8 
+                     && panLastVal[iX-1] == panThisVal[iX] )
+                iAboveX = iX - 1;
+            else if( iX < nXSize-1 && psJob->nConnectedness == 8 
+                     && panLastVal[iX+1] == panThisVal[iX] )
+                iAboveX = iX + 1;
+            else
+                iAboveX = -1;
+
+            if( iAboveX < 0 )
+                continue;
+
+            int nId1 = GDALSieveFindRoot( 
+                anPolyIdMap, poAbove->nIdOffset + poAbove->anLastLineId[iAboveX] );
+            int nId2 = GDALSieveFindRoot( 
+                anPolyIdMap, poStrip->nIdOffset + poStrip->anFirstLineId[iX] );
+
+            if( nId1 < nId2 )
+                anPolyIdMap[nId2] = nId1;
+            else if( nId2 < nId1 )
+                anPolyIdMap[nId1] = nId2;
+        }
+    }
+
+    for( iPoly = 0; iPoly < nPolys; iPoly++ )
+        anPolyIdMap[iPoly] = GDALSieveFindRoot( anPolyIdMap, iPoly );
+
+/* -------------------------------------------------------------------- */
+/*      Sum the sizes of the polygon fragments of the strips.           */
+/* -------------------------------------------------------------------- */
+    std::vector<GIntBig> anSizes( nPolys, 0 );
+
+    for( iStrip = 0; iStrip < apoStrips.size(); iStrip++ )
+    {
+        GDALSieveStrip *poStrip = apoStrips[iStrip];
+
+        for( iPoly = 0; iPoly < poStrip->oEnum.nNextPolygonId; iPoly++ )
+            anSizes[anPolyIdMap[poStrip->nIdOffset + iPoly]] += 
+                poStrip->anPolySizes[iPoly];
+
+        std::vector<int>().swap( poStrip->anPolySizes );
+    }
+
+    psJob->anPolySizes.resize( nPolys );
+    for( iPoly = 0; iPoly < nPolys; iPoly++ )
+        psJob->anPolySizes[iPoly] = (int) MIN(anSizes[iPoly], MY_MAX_INT);
+
+/* -------------------------------------------------------------------- */
+/*      Keep the global ids of the line above each strip.               */
+/* -------------------------------------------------------------------- */
+    for( iStrip = 1; iStrip < apoStrips.size(); iStrip++ )
+    {
+        GDALSieveStrip *poAbove = apoStrips[iStrip-1];
+        GDALSieveStrip *poStrip = apoStrips[iStrip];
+
+        poStrip->anAboveLineId.resize( nXSize );
+        for( iX = 0; iX < nXSize; iX++ )
+            poStrip->anAboveLineId[iX] = 
+                anPolyIdMap[poAbove->nIdOffset + poAbove->anLastLineId[iX]];
+    }
+
+    for( iStrip = 0; iStrip < apoStrips.size(); iStrip++ )
+    {
+        GDALSieveStrip *poStrip = apoStrips[iStrip];
+
+        std::vector<GInt32>().swap( poStrip->anFirstLineVal );
+        std::vector<GInt32>().swap( poStrip->anFirstLineId );
+        std::vector<GInt32>().swap( poStrip->anLastLineVal );
+        std::vector<GInt32>().swap( poStrip->anLastLineId );
+    }
+}
+
+/************************************************************************/
+/*                   GDALSieveMergeBigNeighbours()                      */
+/*                                                                      */
+/*      Combine the largest neighbours found by the strips, keeping     */
+/*      the first one found in raster order among the largest.          */
+/************************************************************************/
+
+static void GDALSieveMergeBigNeighbour( GDALSieveJob *psJob, int nPolyId,
+                                        int nBig, GIntBig nBigPos )
+
+{
+    int nCurrent = psJob->anBigNeighbour[nPolyId];
+
+    if( nBig == -1 )
+        return;
+
+    if( nCurrent == -1 
+        || psJob->anPolySizes[nCurrent] < psJob->anPolySizes[nBig]
+        || (psJob->anPolySizes[nCurrent] == psJob->anPolySizes[nBig]
+            && nBigPos < psJob->anBigNeighbourPos[nPolyId]) )
+    {
+        psJob->anBigNeighbour[nPolyId] = nBig;
+        psJob->anBigNeighbourPos[nPolyId] = nBigPos;
+    }
+}
+
+static void GDALSieveMergeBigNeighbours( GDALSieveJob *psJob )
+
+{
+    size_t iStrip;
+
+    psJob->anBigNeighbour.assign( psJob->anPolyIdMap.size(), -1 );
+    psJob->anBigNeighbourPos.assign( psJob->anPolyIdMap.size(), 0 );
+
+    for( iStrip = 0; iStrip < psJob->apoStrips.size(); iStrip++ )
+    {
+        GDALSieveStrip *poStrip = psJob->apoStrips[iStrip];
+        int iPoly;
+
+        for( iPoly = 0; iPoly < (int) poStrip->anBigNeighbour.size(); iPoly++ )
+        {
+            GDALSieveMergeBigNeighbour( 
+                psJob, psJob->anPolyIdMap[poStrip->nIdOffset + iPoly],
+                poStrip->anBigNeighbour[iPoly], 
+                poStrip->anBigNeighbourPos[iPoly] );
+        }
+
+        std::map< int, std::pair<int,GIntBig> >::iterator oIter;
+        for( oIter = poStrip->oMapAboveBigNeighbour.begin();
+             oIter != poStrip->oMapAboveBigNeighbour.end(); ++oIter )
+        {
+            GDALSieveMergeBigNeighbour( psJob, oIter->first, 
+                                        oIter->second.first, 
+                                        oIter->second.second );
+        }
+
+        std::vector<int>().swap( poStrip->anBigNeighbour );
+        std::vector<GIntBig>().swap( poStrip->anBigNeighbourPos );
+        poStrip->oMapAboveBigNeighbour.clear();
+    }
+
+    std::vector<GIntBig>().swap( psJob->anBigNeighbourPos );
+}
+
+/************************************************************************/
+/*                        GDALSieveFilterMT()                           */
+/************************************************************************/
+
+static CPLErr 
+GDALSieveFilterMT( GDALRasterBandH hSrcBand, GDALRasterBandH hMaskBand,
+                   GDALRasterBandH hDstBand,
+                   int nSizeThreshold, int nConnectedness,
+                   int nThreads, double dfWorkingMemory,
+                   GDALProgressFunc pfnProgress, 
+                   void * pProgressArg )
+
+{
+    GDALSieveJob sJob;
+    int nXSize = GDALGetRasterBandXSize( hSrcBand );
+    int nYSize = GDALGetRasterBandYSize( hSrcBand );
+    int iStrip, nStrips;
+
+    sJob.hSrcBand = hSrcBand;
+    sJob.hMaskBand = hMaskBand;
+    sJob.hDstBand = hDstBand;
+    sJob.nConnectedness = nConnectedness;
+    sJob.nXSize = nXSize;
+    sJob.nYSize = nYSize;
+    sJob.eErr = CE_None;
+    sJob.pfnProgress = pfnProgress;
+    sJob.pProgressArg = pProgressArg;
+
+/* -------------------------------------------------------------------- */
+/*      Each thread reads chunks of lines fitting in the working        */
+/*      memory: values, unmasked values and mask.                       */
+/* -------------------------------------------------------------------- */
+    sJob.nChunkLines = (int) 
+        MAX(1, MIN(nYSize, dfWorkingMemory / nThreads / (9.0 * nXSize)));
+
+    nStrips = MIN( 4 * nThreads, nYSize );
+    for( iStrip = 0; iStrip < nStrips; iStrip++ )
+    {
+        GDALSieveStrip *poStrip = new GDALSieveStrip( nConnectedness );
+
+        poStrip->nYStart = (int) (iStrip * (double) nYSize / nStrips);
+        poStrip->nYEnd = (int) ((iStrip+1) * (double) nYSize / nStrips);
+        poStrip->nIdOffset = 0;
+        sJob.apoStrips.push_back( poStrip );
+    }
+
+    sJob.hMutex = CPLCreateMutex();
+    CPLReleaseMutex( sJob.hMutex );
+
+/* -------------------------------------------------------------------- */
+/*      Enumerate the polygons, and their sizes.                        */
+/* -------------------------------------------------------------------- */
+    CPLErr eErr = GDALSieveRunPass( &sJob, 1, nThreads );
+
+    if( eErr == CE_None )
+    {
+        GDALSieveMergeStripPolygons( &sJob );
+
+        eErr = GDALSieveRunPass( &sJob, 2, nThreads );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      If our biggest neighbour is still smaller than the              */
+/*      threshold, leave the polygon alone, as GDALSieveFilter()        */
+/*      does.                                                           */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None )
+    {
+        int nFailedMerges = 0;
+        int nIsolatedSmall = 0;
+        int nSieveTargets = 0;
+        int iPoly;
+
+        GDALSieveMergeBigNeighbours( &sJob );
+
+        for( iPoly = 0; iPoly < (int) sJob.anPolyIdMap.size(); iPoly++ )
+        {
+            if( sJob.anPolyIdMap[iPoly] != iPoly )
+                continue;
+
+            if( sJob.anPolyValue[iPoly] == GP_NODATA_MARKER )
+                continue;
+
+            if( sJob.anPolySizes[iPoly] >= nSizeThreshold )
+            {
+                sJob.anBigNeighbour[iPoly] = -1;
+                continue;
+            }
+
+            nSieveTargets++;
+
+            if( sJob.anBigNeighbour[iPoly] == -1 )
+            {
+                nIsolatedSmall++;
+                continue;
+            }
+
+            if( sJob.anPolySizes[sJob.anBigNeighbour[iPoly]] 
+                >= nSizeThreshold )
+                continue;
+
+            nFailedMerges++;
+            sJob.anBigNeighbour[iPoly] = -1;
+        }
+
+        CPLDebug( "GDALSieveFilter", 
+                  "Small Polygons: %d, Isolated: %d, Unmergable: %d",
+                  nSieveTargets, nIsolatedSmall, nFailedMerges );
+
+/* -------------------------------------------------------------------- */
+/*      Apply the merges.                                               */
+/* -------------------------------------------------------------------- */
+        eErr = GDALSieveRunPass( &sJob, 3, nThreads );
+    }
+
+    CPLDestroyMutex( sJob.hMutex );
+    for( iStrip = 0; iStrip < nStrips; iStrip++ )
+        delete sJob.apoStrips[iStrip];
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                          GDALSieveFilter()                           */
 /************************************************************************/
@@ -169,8 +1086,15 @@ static inline void CompareNeighbour( int nPolyId1, int nPolyId2,
  * @param nConnectedness either 4 indicating that diagonal pixels are not
  * considered directly adjacent for polygon membership purposes or 8
  * indicating they are. 
- * @param papszOptions algorithm options in name=value list form.  None currently
- * supported.
+ * @param papszOptions algorithm options in name=value list form.  The 
+ * following options are supported (GDAL >= 1.10):
+ * <ul>
+ * <li>NUM_THREADS=n: process the raster as horizontal strips in n threads. 
+ * The result is identical to the single threaded processing.</li>
+ * <li>WORKING_MEMORY=n: memory in megabytes used by the threads for pixel 
+ * buffers, 64 by default.  This does not include the memory used for the
+ * polygon information.</li>
+ * </ul>
  * @param pfnProgress callback for reporting algorithm progress matching the
  * GDALProgressFunc() semantics.  May be NULL.
  * @param pProgressArg callback argument passed to pfnProgress.
@@ -193,6 +1117,22 @@ GDALSieveFilter( GDALRasterBandH hSrcBand, GDALRasterBandH hMaskBand,
     if( pfnProgress == NULL )
         pfnProgress = GDALDummyProgress;
 
+/* -------------------------------------------------------------------- */
+/*      Use the strip based implementation if requested.                */
+/* -------------------------------------------------------------------- */
+    int nThreads = atoi( CSLFetchNameValueDef( papszOptions, 
+                                               "NUM_THREADS", "1" ) );
+    double dfWorkingMemory = 
+        CPLAtof( CSLFetchNameValueDef( papszOptions, 
+                                       "WORKING_MEMORY", "64" ) ) 
+        * 1024 * 1024;
+
+    if( nThreads > 1 && GDALGetRasterBandYSize( hSrcBand ) > 1 )
+        return GDALSieveFilterMT( hSrcBand, hMaskBand, hDstBand, 
+                                  nSizeThreshold, nConnectedness, 
+                                  nThreads, dfWorkingMemory,
+                                  pfnProgress, pProgressArg );
+
 /* -------------------------------------------------------------------- */
 /*      Allocate working buffers.                                       */
 /* -------------------------------------------------------------------- */
@@ -337,6 +337,9 @@ private:
     int             nChunkListMax;
     int            *panChunkList;
 
+    /* Chunk whose source window is prefetched while warping the current one */
+    int            *panPrefetchChunk;
+
     int             bReportTimings;
     unsigned long   nLastTimeReported;
 
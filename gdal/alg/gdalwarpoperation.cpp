@@ -28,6 +28,7 @@
  ****************************************************************************/
 
 #include "gdalwarper.h"
+#include "gdal_priv.h"
 #include "cpl_string.h"
 #include "cpl_multiproc.h"
 #include "ogr_api.h"
@@ -129,6 +130,7 @@ GDALWarpOperation::GDALWarpOperation()
     nChunkListCount = 0;
     nChunkListMax = 0;
     panChunkList = NULL;
+    panPrefetchChunk = NULL;
 
     bReportTimings = FALSE;
     nLastTimeReported = 0;
@@ -698,6 +700,13 @@ CPLErr GDALWarpOperation::ChunkAndWarpImage(
         double dfProgressBase = dfPixelsProcessed / dfTotalPixels;
         double dfProgressScale = dfChunkPixels / dfTotalPixels;
 
+        /* Source data of the next chunk is loaded in the background */
+        /* while this one is being warped and written. */
+        if( iChunk + 1 < nChunkListCount )
+            panPrefetchChunk = panChunkList + (iChunk+1)*8;
+        else
+            panPrefetchChunk = NULL;
+
         eErr = WarpRegion( panThisChunk[0], panThisChunk[1], 
                            panThisChunk[2], panThisChunk[3],
                            panThisChunk[4], panThisChunk[5],
@@ -705,11 +714,16 @@ CPLErr GDALWarpOperation::ChunkAndWarpImage(
                            dfProgressBase, dfProgressScale);
 
         if( eErr != CE_None )
+        {
+            panPrefetchChunk = NULL;
+            ((GDALDataset *) psOptions->hSrcDS)->WaitForPrefetch( TRUE );
             return eErr;
+        }
 
         dfPixelsProcessed += dfChunkPixels;
     }
 
+    panPrefetchChunk = NULL;
     WipeChunkList();
 
     psOptions->pfnProgress( 1.00001, "", psOptions->pProgressArg );
@@ -1751,6 +1765,20 @@ CPLErr GDALWarpOperation::WarpRegionToBuffer(
         }
     }
         
+/* -------------------------------------------------------------------- */
+/*      All source reading for this chunk is done, so we can start      */
+/*      loading the source window of the next one in the background,    */
+/*      if GDAL_PREFETCH is enabled.                                    */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None && panPrefetchChunk != NULL && hIOMutex == NULL
+        && psOptions->hSrcDS != psOptions->hDstDS )
+    {
+        ((GDALDataset *) psOptions->hSrcDS)->StartPrefetch( 
+            panPrefetchChunk[4], panPrefetchChunk[5],
+            panPrefetchChunk[6], panPrefetchChunk[7],
+            psOptions->nBandCount, psOptions->panSrcBands );
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Release IO Mutex, and acquire warper mutex.                     */
 /* -------------------------------------------------------------------- */
@@ -29,6 +29,10 @@
 #include "gdal_alg_priv.h"
 #include "cpl_conv.h"
 #include "cpl_string.h"
+#include "cpl_multiproc.h"
+#include <algorithm>
+#include <map>
+#include <set>
 #include <vector>
 
 CPL_CVSID("$Id$");
@@ -56,6 +60,9 @@ public:
 
     std::vector< std::vector<int> > aanXY;
 
+    /* index of the strings by their last vertex, used by AddSegment() */
+    std::multimap< std::pair<int,int>, int > oMapStringEnds;
+
     void             AddSegment( int x1, int y1, int x2, int y2 );
     void             Dump();
     void             Coalesce();
@@ -85,6 +92,51 @@ void RPolygon::Dump()
     }
 }
 
+/************************************************************************/
+/*                          Coalesce helpers                            */
+/*                                                                      */
+/*      Strings indexed by their first or last vertex.                  */
+/************************************************************************/
+
+typedef std::map< std::pair<int,int>, std::set<int> > RPolygonVertexIndex;
+
+static void RPIndexAdd( RPolygonVertexIndex &oIndex, int nX, int nY, 
+                        int iString )
+
+{
+    oIndex[std::pair<int,int>( nX, nY )].insert( iString );
+}
+
+static void RPIndexRemove( RPolygonVertexIndex &oIndex, int nX, int nY, 
+                           int iString )
+
+{
+    RPolygonVertexIndex::iterator oIter = 
+        oIndex.find( std::pair<int,int>( nX, nY ) );
+
+    oIter->second.erase( iString );
+    if( oIter->second.empty() )
+        oIndex.erase( oIter );
+}
+
+/* Return the lowest string index >= iFrom, or -1 */
+static int RPIndexFind( RPolygonVertexIndex &oIndex, int nX, int nY, 
+                        int iFrom )
+
+{
+    RPolygonVertexIndex::iterator oIter = 
+        oIndex.find( std::pair<int,int>( nX, nY ) );
+
+    if( oIter == oIndex.end() )
+        return -1;
+
+    std::set<int>::iterator oSetIter = oIter->second.lower_bound( iFrom );
+    if( oSetIter == oIter->second.end() )
+        return -1;
+
+    return *oSetIter;
+}
+
 /************************************************************************/
 /*                              Coalesce()                              */
 /************************************************************************/
@@ -94,6 +146,24 @@ void RPolygon::Coalesce()
 {
     size_t iBaseString;
 
+    oMapStringEnds.clear();
+
+/* -------------------------------------------------------------------- */
+/*      Index the strings by their first and last vertex so the         */
+/*      following strings that can be merged are found without          */
+/*      scanning them all.                                              */
+/* -------------------------------------------------------------------- */
+    RPolygonVertexIndex oStarts, oEnds;
+
+    for( iBaseString = 0; iBaseString < aanXY.size(); iBaseString++ )
+    {
+        std::vector<int> &anString = aanXY[iBaseString];
+
+        RPIndexAdd( oStarts, anString[0], anString[1], (int) iBaseString );
+        RPIndexAdd( oEnds, anString[anString.size()-2], 
+                    anString[anString.size()-1], (int) iBaseString );
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Iterate over loops starting from the first, trying to merge     */
 /*      other segments into them.                                       */
@@ -110,32 +180,64 @@ void RPolygon::Coalesce()
 /* -------------------------------------------------------------------- */
         while( bMergeHappened )
         {
-            size_t iString;
+            int iFrom = (int) iBaseString + 1;
 
             bMergeHappened = FALSE;
 
 /* -------------------------------------------------------------------- */
-/*      Loop over the following strings, trying to find one we can      */
-/*      merge onto the end of our base string.                          */
+/*      Walk the following strings in order, merging any that start     */
+/*      or end where our base string ends.                              */
 /* -------------------------------------------------------------------- */
-            for( iString = iBaseString+1; 
-                 iString < aanXY.size(); 
-                 iString++ )
+            while( TRUE )
             {
+                int nEndX = anBase[anBase.size()-2];
+                int nEndY = anBase[anBase.size()-1];
+                int iStart = RPIndexFind( oStarts, nEndX, nEndY, iFrom );
+                int iEnd = RPIndexFind( oEnds, nEndX, nEndY, iFrom );
+                int iString, iDirection;
+
+                if( iStart < 0 && iEnd < 0 )
+                    break;
+
+                if( iStart >= 0 && (iEnd < 0 || iStart <= iEnd) )
+                {
+                    iString = iStart;
+                    iDirection = 1;
+                }
+                else
+                {
+                    iString = iEnd;
+                    iDirection = -1;
+                }
+
+                // Merge() moves the last string in place of the merged one.
+                int iLast = (int) aanXY.size() - 1;
                 std::vector<int> &anString = aanXY[iString];
+                std::vector<int> &anLast = aanXY[iLast];
 
-                if( anBase[anBase.size()-2] == anString[0]
-                    && anBase[anBase.size()-1] == anString[1] )
+                RPIndexRemove( oStarts, anString[0], anString[1], iString );
+                RPIndexRemove( oEnds, anString[anString.size()-2], 
+                               anString[anString.size()-1], iString );
+                if( iString < iLast )
                 {
-                    Merge( iBaseString, iString, 1 );
-                    bMergeHappened = TRUE;
+                    RPIndexRemove( oStarts, anLast[0], anLast[1], iLast );
+                    RPIndexRemove( oEnds, anLast[anLast.size()-2], 
+                                   anLast[anLast.size()-1], iLast );
                 }
-                else if( anBase[anBase.size()-2] == anString[anString.size()-2]
-                         && anBase[anBase.size()-1] == anString[anString.size()-1] )
+
+                Merge( (int) iBaseString, iString, iDirection );
+                bMergeHappened = TRUE;
+
+                if( iString < iLast )
                 {
-                    Merge( iBaseString, iString, -1 );
-                    bMergeHappened = TRUE;
+                    std::vector<int> &anMoved = aanXY[iString];
+
+                    RPIndexAdd( oStarts, anMoved[0], anMoved[1], iString );
+                    RPIndexAdd( oEnds, anMoved[anMoved.size()-2], 
+                                anMoved[anMoved.size()-1], iString );
                 }
+
+                iFrom = iString + 1;
             }
         }
 
@@ -192,13 +294,37 @@ void RPolygon::AddSegment( int x1, int y1, int x2, int y2 )
     nLastLineUpdated = MAX(y1, y2);
 
 /* -------------------------------------------------------------------- */
-/*      Is there an existing string ending with this?                   */
+/*      Is there an existing string ending with this?  If several       */
+/*      strings qualify, the first one is used.                         */
 /* -------------------------------------------------------------------- */
-    size_t iString;
+    std::multimap< std::pair<int,int>, int >::iterator oIter, oEnd, oBest;
+    int iBestString = -1;
 
-    for( iString = 0; iString < aanXY.size(); iString++ )
+    oIter = oMapStringEnds.lower_bound( std::pair<int,int>( x1, y1 ) );
+    oEnd = oMapStringEnds.upper_bound( std::pair<int,int>( x1, y1 ) );
+    for( ; oIter != oEnd; ++oIter )
     {
-        std::vector<int> &anString = aanXY[iString];
+        if( iBestString < 0 || oIter->second < iBestString )
+        {
+            iBestString = oIter->second;
+            oBest = oIter;
+        }
+    }
+
+    oIter = oMapStringEnds.lower_bound( std::pair<int,int>( x2, y2 ) );
+    oEnd = oMapStringEnds.upper_bound( std::pair<int,int>( x2, y2 ) );
+    for( ; oIter != oEnd; ++oIter )
+    {
+        if( iBestString < 0 || oIter->second < iBestString )
+        {
+            iBestString = oIter->second;
+            oBest = oIter;
+        }
+    }
+
+    if( iBestString >= 0 )
+    {
+        std::vector<int> &anString = aanXY[iBestString];
         size_t nSSize = anString.size();
         
         if( anString[nSSize-2] == x1 
@@ -215,29 +341,30 @@ void RPolygon::AddSegment( int x1, int y1, int x2, int y2 )
             y1 = nTemp;
         }
 
-        if( anString[nSSize-2] == x2 
-            && anString[nSSize-1] == y2 )
-        {
-            // We are going to add a segment, but should we just extend 
-            // an existing segment already going in the right direction?
+        // We are going to add a segment, but should we just extend 
+        // an existing segment already going in the right direction?
 
-            int nLastLen = MAX(ABS(anString[nSSize-4]-anString[nSSize-2]),
-                               ABS(anString[nSSize-3]-anString[nSSize-1]));
+        int nLastLen = MAX(ABS(anString[nSSize-4]-anString[nSSize-2]),
+                           ABS(anString[nSSize-3]-anString[nSSize-1]));
             
-            if( nSSize >= 4 
-                && (anString[nSSize-4] - anString[nSSize-2]
-                    == (anString[nSSize-2] - x1)*nLastLen)
-                && (anString[nSSize-3] - anString[nSSize-1]
-                    == (anString[nSSize-1] - y1)*nLastLen) )
-            {
-                anString.pop_back();
-                anString.pop_back();
-            }
-
-            anString.push_back( x1 );
-            anString.push_back( y1 );
-            return;
+        if( nSSize >= 4 
+            && (anString[nSSize-4] - anString[nSSize-2]
+                == (anString[nSSize-2] - x1)*nLastLen)
+            && (anString[nSSize-3] - anString[nSSize-1]
+                == (anString[nSSize-1] - y1)*nLastLen) )
+        {
+            anString.pop_back();
+            anString.pop_back();
         }
+
+        anString.push_back( x1 );
+        anString.push_back( y1 );
+
+        oMapStringEnds.erase( oBest );
+        oMapStringEnds.insert( 
+            std::pair< std::pair<int,int>, int >( 
+                std::pair<int,int>( x1, y1 ), iBestString ) );
+        return;
     }
 
 /* -------------------------------------------------------------------- */
@@ -252,6 +379,10 @@ void RPolygon::AddSegment( int x1, int y1, int x2, int y2 )
     anString.push_back( x2 );
     anString.push_back( y2 );
 
+    oMapStringEnds.insert( 
+        std::pair< std::pair<int,int>, int >( 
+            std::pair<int,int>( x2, y2 ), (int) nSize ) );
+
     return;
 }
 
@@ -430,96 +561,1106 @@ GPMaskImageData( GDALRasterBandH hMaskBand, GByte* pabyMaskLine, int iY, int nXS
 
     return eErr;
 }
-#endif // OGR_ENABLED
 
 /************************************************************************/
-/*                           GDALPolygonize()                           */
+/* ==================================================================== */
+/*                             GPComponent                              */
+/*                                                                      */
+/*      Edges collected for one connected region by the streaming       */
+/*      polygonizer.  Horizontal edges are stored as runs, and the      */
+/*      edges are only turned into a RPolygon once the region is        */
+/*      known to be complete.                                           */
+/* ==================================================================== */
 /************************************************************************/
 
-/**
- * Create polygon coverage from raster data.
- *
- * This function creates vector polygons for all connected regions of pixels in
- * the raster sharing a common pixel value.  Optionally each polygon may be
- * labelled with the pixel value in an attribute.  Optionally a mask band
- * can be provided to determine which pixels are eligible for processing.
- *
- * Note that currently the source pixel band values are read into a
- * signed 32bit integer buffer (Int32), so floating point or complex 
- * bands will be implicitly truncated before processing. If you want to use a
- * version using 32bit float buffers, see GDALFPolygonize() at fpolygonize.cpp.
- *
- * Polygon features will be created on the output layer, with polygon 
- * geometries representing the polygons.  The polygon geometries will be
- * in the georeferenced coordinate system of the image (based on the
- * geotransform of the source dataset).  It is acceptable for the output
- * layer to already have features.  Note that GDALPolygonize() does not
- * set the coordinate system on the output layer.  Application code should
- * do this when the layer is created, presumably matching the raster 
- * coordinate system. 
- *
- * The algorithm used attempts to minimize memory use so that very large
- * rasters can be processed.  However, if the raster has many polygons 
- * or very large/complex polygons, the memory use for holding polygon 
- * enumerations and active polygon geometries may grow to be quite large. 
- *
- * The algorithm will generally produce very dense polygon geometries, with
- * edges that follow exactly on pixel boundaries for all non-interior pixels.
- * For non-thematic raster data (such as satellite images) the result will
- * essentially be one small polygon per pixel, and memory and output layer
- * sizes will be substantial.  The algorithm is primarily intended for 
- * relatively simple thematic imagery, masks, and classification results. 
- * 
- * @param hSrcBand the source raster band to be processed.
- * @param hMaskBand an optional mask band.  All pixels in the mask band with a 
- * value other than zero will be considered suitable for collection as 
- * polygons.  
- * @param hOutLayer the vector feature layer to which the polygons should
- * be written. 
- * @param iPixValField the attribute field index indicating the feature
- * attribute into which the pixel value of the polygon should be written.
- * @param papszOptions a name/value list of additional options
- * <dl>
- * <dt>"8CONNECTED":</dt> May be set to "8" to use 8 connectedness.
- * Otherwise 4 connectedness will be applied to the algorithm
- * </dl>
- * @param pfnProgress callback for reporting algorithm progress matching the
- * GDALProgressFunc() semantics.  May be NULL.
- * @param pProgressArg callback argument passed to pfnProgress.
- * 
- * @return CE_None on success or CE_Failure on a failure.
- */
+typedef struct
+{
+    GInt32  nY;
+    GInt32  nX;     /* pixel nX-1 is on the left of, or above, the edge */
+    GInt32  nLen;   /* number of horizontal edges, or 0 for a vertical one */
+} GPEdgeRun;
 
-CPLErr CPL_STDCALL
-GDALPolygonize( GDALRasterBandH hSrcBand, 
-                GDALRasterBandH hMaskBand,
-                OGRLayerH hOutLayer, int iPixValField, 
-                char **papszOptions,
-                GDALProgressFunc pfnProgress, 
-                void * pProgressArg )
+static bool GPEdgeRunLess( const GPEdgeRun &sA, const GPEdgeRun &sB )
+{
+    if( sA.nY != sB.nY )
+        return sA.nY < sB.nY;
+    return sA.nX < sB.nX;
+}
+
+class GPComponent {
+public:
+    GPComponent( GInt32 nValueIn ) 
+        { nValue = nValueIn; bTouchesTop = FALSE;
+          nRunY = -1; nRunX = 0; nRunLen = 0; }
+
+    GInt32           nValue;
+
+    /* TRUE if the region has pixels on the line above the strip */
+    int              bTouchesTop;
+
+    std::vector<GPEdgeRun> aoEdges;
+
+    /* start, length pairs of the pixels on the line above the strip */
+    std::vector<int> anTopRuns;
+
+    /* horizontal run being extended */
+    int              nRunY;
+    int              nRunX;
+    int              nRunLen;
+
+    void             AddHorizontalEdge( int nY, int nX )
+        {
+            if( nRunLen > 0 && nRunY == nY && nRunX + nRunLen == nX )
+                nRunLen++;
+            else
+            {
+                FlushRun();
+                nRunY = nY;
+                nRunX = nX;
+                nRunLen = 1;
+            }
+        }
+
+    void             AddVerticalEdge( int nY, int nX )
+        {
+            GPEdgeRun sEdge;
+            sEdge.nY = nY;
+            sEdge.nX = nX;
+            sEdge.nLen = 0;
+            aoEdges.push_back( sEdge );
+        }
+
+    void             FlushRun();
+    void             Absorb( GPComponent *poOther );
+    RPolygon        *BuildRPolygon();
+};
+
+/************************************************************************/
+/*                              FlushRun()                              */
+/************************************************************************/
+
+void GPComponent::FlushRun()
 
 {
-#ifndef OGR_ENABLED
-    CPLError(CE_Failure, CPLE_NotSupported, "GDALPolygonize() unimplemented in a non OGR build");
-    return CE_Failure;
-#else
-    VALIDATE_POINTER1( hSrcBand, "GDALPolygonize", CE_Failure );
-    VALIDATE_POINTER1( hOutLayer, "GDALPolygonize", CE_Failure );
+    if( nRunLen > 0 )
+    {
+        GPEdgeRun sEdge;
+        sEdge.nY = nRunY;
+        sEdge.nX = nRunX;
+        sEdge.nLen = nRunLen;
+        aoEdges.push_back( sEdge );
+        nRunLen = 0;
+    }
+}
 
-    if( pfnProgress == NULL )
-        pfnProgress = GDALDummyProgress;
+/************************************************************************/
+/*                               Absorb()                               */
+/*                                                                      */
+/*      Move the edges of another region of the same polygon into       */
+/*      this one.                                                       */
+/************************************************************************/
 
-    int nConnectedness = CSLFetchNameValue( papszOptions, "8CONNECTED" ) ? 8 : 4;
+void GPComponent::Absorb( GPComponent *poOther )
 
-/* -------------------------------------------------------------------- */
-/*      Confirm our output layer will support feature creation.         */
-/* -------------------------------------------------------------------- */
-    if( !OGR_L_TestCapability( hOutLayer, OLCSequentialWrite ) )
+{
+    FlushRun();
+    poOther->FlushRun();
+
+    aoEdges.insert( aoEdges.end(), 
+                    poOther->aoEdges.begin(), poOther->aoEdges.end() );
+    anTopRuns.insert( anTopRuns.end(), 
+                      poOther->anTopRuns.begin(), poOther->anTopRuns.end() );
+    bTouchesTop |= poOther->bTouchesTop;
+
+    std::vector<GPEdgeRun>().swap( poOther->aoEdges );
+    std::vector<int>().swap( poOther->anTopRuns );
+}
+
+/************************************************************************/
+/*                           BuildRPolygon()                            */
+/*                                                                      */
+/*      Add the edges to a RPolygon in the order used by                */
+/*      GDALPolygonize() so the resulting rings are the same.  The      */
+/*      runs are only expanded one line at a time.                      */
+/************************************************************************/
+
+RPolygon *GPComponent::BuildRPolygon()
+
+{
+    RPolygon *poRPoly = new RPolygon( nValue );
+    std::vector<GUInt32> anKeys;
+    size_t iEdge = 0;
+
+    FlushRun();
+    std::sort( aoEdges.begin(), aoEdges.end(), GPEdgeRunLess );
+
+    while( iEdge < aoEdges.size() )
     {
-        CPLError( CE_Failure, CPLE_AppDefined,
-                  "Output feature layer does not appear to support creation\n"
-                  "of features in GDALPolygonize()." );
-        return CE_Failure;
+        int nY = aoEdges[iEdge].nY;
+        size_t iKey;
+
+        anKeys.resize( 0 );
+        for( ; iEdge < aoEdges.size() && aoEdges[iEdge].nY == nY; iEdge++ )
+        {
+            const GPEdgeRun &sEdge = aoEdges[iEdge];
+
+            if( sEdge.nLen == 0 )
+                anKeys.push_back( (((GUInt32) sEdge.nX) << 1) | 1 );
+            else
+            {
+                for( int i = 0; i < sEdge.nLen; i++ )
+                    anKeys.push_back( ((GUInt32) (sEdge.nX + i)) << 1 );
+            }
+        }
+
+        std::sort( anKeys.begin(), anKeys.end() );
+
+        for( iKey = 0; iKey < anKeys.size(); iKey++ )
+        {
+            int iX = (int) (anKeys[iKey] >> 1);
+
+            if( anKeys[iKey] & 1 )
+                poRPoly->AddSegment( iX, nY, iX, nY+1 );
+            else
+                poRPoly->AddSegment( iX-1, nY, iX, nY );
+        }
+    }
+
+    std::vector<GPEdgeRun>().swap( aoEdges );
+
+    return poRPoly;
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                         GPStreamPolygonizer                          */
+/*                                                                      */
+/*      Single pass polygonizer of a strip of lines.  Pixels are        */
+/*      labelled with the same rules as GDALRasterPolygonEnumerator     */
+/*      in a union-find structure only holding the regions of the      */
+/*      current line, and a region is written as soon as a line does    */
+/*      not extend it anymore.                                          */
+/*                                                                      */
+/*      When the strip does not start at the top of the raster, the     */
+/*      line above it is labelled too, and the regions touching it or   */
+/*      the last line of the strip are kept aside to be stitched with   */
+/*      the neighbouring strips.                                        */
+/* ==================================================================== */
+/************************************************************************/
+
+typedef struct
+{
+    GDALRasterBandH  hSrcBand;
+    GDALRasterBandH  hMaskBand;
+    OGRLayerH        hOutLayer;
+    int              iPixValField;
+    double          *padfGeoTransform;
+    int              nConnectedness;
+    int              nXSize;
+    int              nYSize;
+
+    /* protects the fields below, raster IO and feature writing, */
+    /* NULL when not threaded */
+    void            *hMutex;
+
+    CPLErr           eErr;
+    int              nLinesDone;
+    int              nNextStrip;
+    int              nStrips;
+    class GPStreamPolygonizer **papoStrips;
+
+    GDALProgressFunc pfnProgress;
+    void            *pProgressArg;
+} GPStreamInfo;
+
+class GPStreamPolygonizer {
+    GPStreamInfo    *psInfo;
+    int              nXSize;
+
+    std::vector<int>          anParent;
+    std::vector<GPComponent*> apoComp;
+    std::vector<int>          anNewId;
+    std::vector<GPComponent*> apoNewComp;
+
+    int              NewLabel( GInt32 nValue );
+    int              Find( int iNode );
+    void             Union( int iNode1, int iNode2 );
+    void             LabelLine( const GInt32 *panLastVal, const int *panLastLab,
+                                const GInt32 *panThisVal, int *panThisLab );
+    void             ResolveLine( int *panLab );
+    void             AddLineEdges( int iY, 
+                                   const GInt32 *panLastVal, const int *panLastLab,
+                                   const GInt32 *panThisVal, const int *panThisLab );
+    CPLErr           Advance( const int *panLastLab, int *panThisLab );
+    CPLErr           Complete( GPComponent *poComp );
+    int              Defer( GPComponent *poComp );
+    CPLErr           ReadLine( int iY, GInt32 *panVal, GByte *pabyMask );
+
+public:
+    GPStreamPolygonizer( GPStreamInfo *psInfoIn );
+    ~GPStreamPolygonizer();
+
+    /* regions kept for stitching, and which of them covers each pixel */
+    /* of the line above the strip and of its last line */
+    std::vector<GPComponent*> apoDeferred;
+    std::vector<int>          anTopDeferred;
+    std::vector<int>          anBottomDeferred;
+
+    CPLErr           ProcessStrip( int nYStart, int nYEnd, int bMainThread );
+};
+
+/************************************************************************/
+/*                        GPStreamPolygonizer()                         */
+/************************************************************************/
+
+GPStreamPolygonizer::GPStreamPolygonizer( GPStreamInfo *psInfoIn )
+
+{
+    psInfo = psInfoIn;
+    nXSize = psInfo->nXSize;
+}
+
+/************************************************************************/
+/*                        ~GPStreamPolygonizer()                        */
+/************************************************************************/
+
+GPStreamPolygonizer::~GPStreamPolygonizer()
+
+{
+    size_t i;
+
+    for( i = 0; i < apoComp.size(); i++ )
+        delete apoComp[i];
+    for( i = 0; i < apoDeferred.size(); i++ )
+        delete apoDeferred[i];
+}
+
+/************************************************************************/
+/*                              NewLabel()                              */
+/************************************************************************/
+
+int GPStreamPolygonizer::NewLabel( GInt32 nValue )
+
+{
+    int iNode = (int) anParent.size();
+
+    anParent.push_back( iNode );
+    apoComp.push_back( new GPComponent( nValue ) );
+
+    return iNode;
+}
+
+/************************************************************************/
+/*                                Find()                                */
+/************************************************************************/
+
+int GPStreamPolygonizer::Find( int iNode )
+
+{
+    while( anParent[iNode] != iNode )
+    {
+        anParent[iNode] = anParent[anParent[iNode]];
+        iNode = anParent[iNode];
+    }
+
+    return iNode;
+}
+
+/************************************************************************/
+/*                               Union()                                */
+/************************************************************************/
+
+void GPStreamPolygonizer::Union( int iNode1, int iNode2 )
+
+{
+    iNode1 = Find( iNode1 );
+    iNode2 = Find( iNode2 );
+
+    if( iNode1 == iNode2 )
+        return;
+
+    // Keep the region with the most edges so as to copy the fewest.
+    if( apoComp[iNode1]->aoEdges.size() < apoComp[iNode2]->aoEdges.size() )
+        std::swap( iNode1, iNode2 );
+
+    anParent[iNode2] = iNode1;
+    apoComp[iNode1]->Absorb( apoComp[iNode2] );
+    delete apoComp[iNode2];
+    apoComp[iNode2] = NULL;
+}
+
+/************************************************************************/
+/*                             LabelLine()                              */
+/*                                                                      */
+/*      Same rules as GDALRasterPolygonEnumerator::ProcessLine().       */
+/************************************************************************/
+
+void GPStreamPolygonizer::LabelLine( const GInt32 *panLastVal, 
+                                     const int *panLastLab,
+                                     const GInt32 *panThisVal, 
+                                     int *panThisLab )
+
+{
+    int i;
+    int bEight = (psInfo->nConnectedness == 8);
+
+    if( panLastVal == NULL )
+    {
+        for( i = 0; i < nXSize; i++ )
+        {
+            if( i == 0 || panThisVal[i] != panThisVal[i-1] )
+                panThisLab[i] = NewLabel( panThisVal[i] );
+            else
+                panThisLab[i] = panThisLab[i-1];
+        }
+        return;
+    }
+
+    for( i = 0; i < nXSize; i++ )
+    {
+        if( i > 0 && panThisVal[i] == panThisVal[i-1] )
+        {
+            panThisLab[i] = panThisLab[i-1];
+
+            if( panLastVal[i] == panThisVal[i] 
+                && panLastLab[i] != panThisLab[i] )
+                Union( panLastLab[i], panThisLab[i] );
+        }
+        else if( panLastVal[i] == panThisVal[i] )
+        {
+            panThisLab[i] = panLastLab[i];
+        }
+        else if( i > 0 && bEight && panLastVal[i-1] == panThisVal[i] )
+        {
+            panThisLab[i] = panLastLab[i-1];
+        }
+        else if( i < nXSize-1 && bEight 
+                 && panLastVal[i+1] == panThisVal[i] )
+        {
+            panThisLab[i] = panLastLab[i+1];
+        }
+        else
+            panThisLab[i] = NewLabel( panThisVal[i] );
+    }
+}
+
+/************************************************************************/
+/*                            ResolveLine()                             */
+/************************************************************************/
+
+void GPStreamPolygonizer::ResolveLine( int *panLab )
+
+{
+    for( int i = 0; i < nXSize; i++ )
+        panLab[i] = Find( panLab[i] );
+}
+
+/************************************************************************/
+/*                            AddLineEdges()                            */
+/*                                                                      */
+/*      Add the pixel edges between the last line and this one, and     */
+/*      between the pixels of this line, to the regions on both         */
+/*      sides.  Either line may be NULL outside of the raster.  The     */
+/*      labels must be resolved to their roots.                         */
+/************************************************************************/
+
+void GPStreamPolygonizer::AddLineEdges( int iY, 
+                                        const GInt32 *panLastVal, 
+                                        const int *panLastLab,
+                                        const GInt32 *panThisVal, 
+                                        const int *panThisLab )
+
+{
+    int i;
+
+    for( i = 0; i < nXSize; i++ )
+    {
+        if( panThisVal == NULL || panLastVal == NULL 
+            || panThisVal[i] != panLastVal[i] )
+        {
+            if( panThisVal != NULL )
+                apoComp[panThisLab[i]]->AddHorizontalEdge( iY, i+1 );
+            if( panLastVal != NULL )
+                apoComp[panLastLab[i]]->AddHorizontalEdge( iY, i+1 );
+        }
+    }
+
+    if( panThisVal == NULL )
+        return;
+
+    apoComp[panThisLab[0]]->AddVerticalEdge( iY, 0 );
+    for( i = 1; i < nXSize; i++ )
+    {
+        if( panThisVal[i] != panThisVal[i-1] )
+        {
+            apoComp[panThisLab[i-1]]->AddVerticalEdge( iY, i );
+            apoComp[panThisLab[i]]->AddVerticalEdge( iY, i );
+        }
+    }
+    apoComp[panThisLab[nXSize-1]]->AddVerticalEdge( iY, nXSize );
+}
+
+/************************************************************************/
+/*                              Advance()                               */
+/*                                                                      */
+/*      Complete the regions of the last line that do not continue      */
+/*      on this one, and renumber the regions of this line so the       */
+/*      union-find structure does not grow with the raster.             */
+/************************************************************************/
+
+CPLErr GPStreamPolygonizer::Advance( const int *panLastLab, int *panThisLab )
+
+{
+    CPLErr eErr = CE_None;
+    int i;
+
+    anNewId.assign( anParent.size(), -1 );
+    apoNewComp.resize( 0 );
+
+    if( panThisLab != NULL )
+    {
+        for( i = 0; i < nXSize; i++ )
+        {
+            int iRoot = panThisLab[i];
+
+            if( anNewId[iRoot] < 0 )
+            {
+                anNewId[iRoot] = (int) apoNewComp.size();
+                apoNewComp.push_back( apoComp[iRoot] );
+            }
+            panThisLab[i] = anNewId[iRoot];
+        }
+    }
+
+    if( panLastLab != NULL )
+    {
+        for( i = 0; i < nXSize; i++ )
+        {
+            int iRoot = panLastLab[i];
+
+            if( anNewId[iRoot] == -1 )
+            {
+                CPLErr eCompErr = Complete( apoComp[iRoot] );
+                if( eErr == CE_None )
+                    eErr = eCompErr;
+                anNewId[iRoot] = -2;
+            }
+        }
+    }
+
+    apoComp.swap( apoNewComp );
+    anParent.resize( apoComp.size() );
+    for( i = 0; i < (int) anParent.size(); i++ )
+        anParent[i] = i;
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                               Defer()                                */
+/************************************************************************/
+
+int GPStreamPolygonizer::Defer( GPComponent *poComp )
+
+{
+    int iDeferred = (int) apoDeferred.size();
+    size_t i;
+
+    poComp->FlushRun();
+    apoDeferred.push_back( poComp );
+
+    for( i = 0; i + 1 < poComp->anTopRuns.size(); i += 2 )
+    {
+        int nStart = poComp->anTopRuns[i];
+        int nEnd = nStart + poComp->anTopRuns[i+1];
+
+        for( int iX = nStart; iX < nEnd; iX++ )
+            anTopDeferred[iX] = iDeferred;
+    }
+    std::vector<int>().swap( poComp->anTopRuns );
+
+    return iDeferred;
+}
+
+/************************************************************************/
+/*                       GPEmitComponent()                              */
+/************************************************************************/
+
+static CPLErr GPEmitComponent( GPStreamInfo *psInfo, GPComponent *poComp )
+
+{
+    CPLErr eErr = CE_None;
+
+    if( psInfo->hMaskBand == NULL || poComp->nValue != GP_NODATA_MARKER )
+    {
+        RPolygon *poRPoly = poComp->BuildRPolygon();
+
+        if( psInfo->hMutex )
+            CPLAcquireMutex( psInfo->hMutex, 1000.0 );
+
+        eErr = EmitPolygonToLayer( psInfo->hOutLayer, psInfo->iPixValField,
+                                   poRPoly, psInfo->padfGeoTransform );
+
+        if( psInfo->hMutex )
+            CPLReleaseMutex( psInfo->hMutex );
+
+        delete poRPoly;
+    }
+
+    delete poComp;
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                              Complete()                              */
+/************************************************************************/
+
+CPLErr GPStreamPolygonizer::Complete( GPComponent *poComp )
+
+{
+    if( poComp->bTouchesTop )
+    {
+        Defer( poComp );
+        return CE_None;
+    }
+
+    return GPEmitComponent( psInfo, poComp );
+}
+
+/************************************************************************/
+/*                              ReadLine()                              */
+/************************************************************************/
+
+CPLErr GPStreamPolygonizer::ReadLine( int iY, GInt32 *panVal, 
+                                      GByte *pabyMask )
+
+{
+    CPLErr eErr;
+
+    if( psInfo->hMutex )
+        CPLAcquireMutex( psInfo->hMutex, 1000.0 );
+
+    eErr = psInfo->eErr;
+
+    if( eErr == CE_None )
+        eErr = GDALRasterIO( psInfo->hSrcBand, GF_Read, 0, iY, nXSize, 1, 
+                             panVal, nXSize, 1, GDT_Int32, 0, 0 );
+
+    if( eErr == CE_None && psInfo->hMaskBand != NULL )
+        eErr = GPMaskImageData( psInfo->hMaskBand, pabyMask, iY, nXSize, 
+                                panVal );
+
+    if( psInfo->hMutex )
+        CPLReleaseMutex( psInfo->hMutex );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                            ProcessStrip()                            */
+/*                                                                      */
+/*      Polygonize lines nYStart to nYEnd-1.  Progress is only          */
+/*      reported from the main thread.                                  */
+/************************************************************************/
+
+CPLErr GPStreamPolygonizer::ProcessStrip( int nYStart, int nYEnd, 
+                                          int bMainThread )
+
+{
+    CPLErr eErr = CE_None;
+    int nYSize = psInfo->nYSize;
+    GInt32 *panLastVal = (GInt32 *) VSIMalloc2(sizeof(GInt32), nXSize);
+    GInt32 *panThisVal = (GInt32 *) VSIMalloc2(sizeof(GInt32), nXSize);
+    int *panLastLab = (int *) VSIMalloc2(sizeof(int), nXSize);
+    int *panThisLab = (int *) VSIMalloc2(sizeof(int), nXSize);
+    GByte *pabyMaskLine = (psInfo->hMaskBand != NULL) ? 
+        (GByte *) VSIMalloc(nXSize) : NULL;
+
+    if (panLastVal == NULL || panThisVal == NULL ||
+        panLastLab == NULL || panThisLab == NULL ||
+        (psInfo->hMaskBand != NULL && pabyMaskLine == NULL))
+    {
+        CPLError(CE_Failure, CPLE_OutOfMemory,
+                 "Could not allocate enough memory for temporary buffers");
+        eErr = CE_Failure;
+    }
+
+    if( nYStart > 0 )
+        anTopDeferred.resize( nXSize );
+
+/* -------------------------------------------------------------------- */
+/*      Process the line above the strip, if any, the lines of the      */
+/*      strip, and a line past the raster for the last strip.          */
+/* -------------------------------------------------------------------- */
+    int iY;
+    int bHaveLast = FALSE;
+    int nYLast = (nYEnd == nYSize) ? nYSize : nYEnd - 1;
+
+    for( iY = MAX(nYStart-1,0); eErr == CE_None && iY <= nYLast; iY++ )
+    {
+        int bPastRaster = (iY == nYSize);
+
+        if( !bPastRaster )
+        {
+            eErr = ReadLine( iY, panThisVal, pabyMaskLine );
+            if( eErr != CE_None )
+                break;
+
+            LabelLine( bHaveLast ? panLastVal : NULL, panLastLab, 
+                       panThisVal, panThisLab );
+            ResolveLine( panThisLab );
+        }
+
+        if( bHaveLast )
+            ResolveLine( panLastLab );
+
+        if( iY < nYStart )
+        {
+            // Line above the strip: only remember which pixels it covers.
+            for( int i = 0; i < nXSize; i++ )
+            {
+                GPComponent *poComp = apoComp[panThisLab[i]];
+
+                poComp->bTouchesTop = TRUE;
+                if( i > 0 && panThisLab[i] == panThisLab[i-1] )
+                    poComp->anTopRuns[poComp->anTopRuns.size()-1]++;
+                else
+                {
+                    poComp->anTopRuns.push_back( i );
+                    poComp->anTopRuns.push_back( 1 );
+                }
+            }
+        }
+        else
+        {
+            AddLineEdges( iY, bHaveLast ? panLastVal : NULL, panLastLab,
+                          bPastRaster ? NULL : panThisVal, panThisLab );
+        }
+
+        eErr = Advance( bHaveLast ? panLastLab : NULL, 
+                        bPastRaster ? NULL : panThisLab );
+
+        GInt32 *panTmp = panLastVal;
+        panLastVal = panThisVal;
+        panThisVal = panTmp;
+
+        int *panTmpLab = panLastLab;
+        panLastLab = panThisLab;
+        panThisLab = panTmpLab;
+
+        bHaveLast = TRUE;
+
+/* -------------------------------------------------------------------- */
+/*      Report progress, and support interrupts.                        */
+/* -------------------------------------------------------------------- */
+        if( iY < nYStart || bPastRaster )
+            continue;
+
+        int nLinesDone;
+
+        if( psInfo->hMutex )
+            CPLAcquireMutex( psInfo->hMutex, 1000.0 );
+        nLinesDone = ++psInfo->nLinesDone;
+        if( psInfo->hMutex )
+            CPLReleaseMutex( psInfo->hMutex );
+
+        if( eErr == CE_None && bMainThread
+            && !psInfo->pfnProgress( nLinesDone / (double) nYSize, 
+                                     "", psInfo->pProgressArg ) )
+        {
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+            eErr = CE_Failure;
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Keep the regions reaching the last line of the strip for        */
+/*      stitching.                                                      */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None && nYEnd < nYSize )
+    {
+        std::vector<int> anDeferredId( apoComp.size() );
+        size_t i;
+
+        for( i = 0; i < apoComp.size(); i++ )
+            anDeferredId[i] = Defer( apoComp[i] );
+        apoComp.resize( 0 );
+        anParent.resize( 0 );
+
+        anBottomDeferred.resize( nXSize );
+        for( int iX = 0; iX < nXSize; iX++ )
+            anBottomDeferred[iX] = anDeferredId[panLastLab[iX]];
+    }
+
+    CPLFree( panThisLab );
+    CPLFree( panLastLab );
+    CPLFree( panThisVal );
+    CPLFree( panLastVal );
+    CPLFree( pabyMaskLine );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                          GPStitchStrips()                            */
+/*                                                                      */
+/*      Merge the regions of adjacent strips sharing pixels and emit    */
+/*      the resulting polygons.                                         */
+/************************************************************************/
+
+static int GPFindRoot( std::vector<int> &anParent, int iNode )
+
+{
+    while( anParent[iNode] != iNode )
+    {
+        anParent[iNode] = anParent[anParent[iNode]];
+        iNode = anParent[iNode];
+    }
+
+    return iNode;
+}
+
+static CPLErr GPStitchStrips( GPStreamInfo *psInfo )
+
+{
+    std::vector<int> anOffset( psInfo->nStrips + 1 );
+    std::vector<GPComponent*> apoComp;
+    int iStrip, iX;
+    size_t i;
+
+    for( iStrip = 0; iStrip < psInfo->nStrips; iStrip++ )
+    {
+        GPStreamPolygonizer *poStrip = psInfo->papoStrips[iStrip];
+
+        anOffset[iStrip] = (int) apoComp.size();
+        apoComp.insert( apoComp.end(), poStrip->apoDeferred.begin(), 
+                        poStrip->apoDeferred.end() );
+        poStrip->apoDeferred.resize( 0 );
+    }
+
+    std::vector<int> anParent( apoComp.size() );
+    for( i = 0; i < anParent.size(); i++ )
+        anParent[i] = (int) i;
+
+/* -------------------------------------------------------------------- */
+/*      The last line of a strip is the line above the next one.        */
+/*      Always attach to the lowest index to be deterministic.          */
+/* -------------------------------------------------------------------- */
+    for( iStrip = 0; iStrip + 1 < psInfo->nStrips; iStrip++ )
+    {
+        GPStreamPolygonizer *poStrip = psInfo->papoStrips[iStrip];
+        GPStreamPolygonizer *poNext = psInfo->papoStrips[iStrip+1];
+
+        for( iX = 0; iX < psInfo->nXSize; iX++ )
+        {
+            int iRoot1 = GPFindRoot( anParent, anOffset[iStrip] 
+                                     + poStrip->anBottomDeferred[iX] );
+            int iRoot2 = GPFindRoot( anParent, anOffset[iStrip+1] 
+                                     + poNext->anTopDeferred[iX] );
+
+            if( iRoot1 < iRoot2 )
+                anParent[iRoot2] = iRoot1;
+            else if( iRoot2 < iRoot1 )
+                anParent[iRoot1] = iRoot2;
+        }
+    }
+
+    for( i = 0; i < apoComp.size(); i++ )
+    {
+        int iRoot = GPFindRoot( anParent, (int) i );
+
+        if( iRoot != (int) i )
+        {
+            apoComp[iRoot]->Absorb( apoComp[i] );
+            delete apoComp[i];
+            apoComp[i] = NULL;
+        }
+    }
+
+    CPLErr eErr = CE_None;
+
+    for( i = 0; i < apoComp.size(); i++ )
+    {
+        if( apoComp[i] == NULL )
+            continue;
+
+        if( eErr == CE_None )
+            eErr = GPEmitComponent( psInfo, apoComp[i] );
+        else
+            delete apoComp[i];
+    }
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                          GPRunStripJobs()                            */
+/************************************************************************/
+
+static CPLErr GPRunStripJobs( GPStreamInfo *psInfo, int bMainThread )
+
+{
+    while( TRUE )
+    {
+        CPLAcquireMutex( psInfo->hMutex, 1000.0 );
+        int iStrip = psInfo->nNextStrip++;
+        int bStop = (iStrip >= psInfo->nStrips || psInfo->eErr != CE_None);
+        CPLReleaseMutex( psInfo->hMutex );
+
+        if( bStop )
+            return CE_None;
+
+        int nYStart = (int) (iStrip * (double) psInfo->nYSize 
+                             / psInfo->nStrips);
+        int nYEnd = (int) ((iStrip+1) * (double) psInfo->nYSize 
+                           / psInfo->nStrips);
+        CPLErr eErr = psInfo->papoStrips[iStrip]->ProcessStrip( 
+            nYStart, nYEnd, bMainThread );
+
+        if( eErr != CE_None )
+        {
+            CPLAcquireMutex( psInfo->hMutex, 1000.0 );
+            if( psInfo->eErr == CE_None )
+                psInfo->eErr = eErr;
+            CPLReleaseMutex( psInfo->hMutex );
+            return eErr;
+        }
+    }
+}
+
+typedef struct
+{
+    GPStreamInfo   *psInfo;
+    int             bMainThread;    /* the one reporting progress */
+} GPStreamThreadData;
+
+static CPLErr GPStreamJob( void *pData )
+
+{
+    GPStreamThreadData *psThreadData = (GPStreamThreadData *) pData;
+
+    return GPRunStripJobs( psThreadData->psInfo, psThreadData->bMainThread );
+}
+
+/************************************************************************/
+/*                       GPPolygonizeStreaming()                        */
+/************************************************************************/
+
+static CPLErr GPPolygonizeStreaming( GDALRasterBandH hSrcBand, 
+                                     GDALRasterBandH hMaskBand,
+                                     OGRLayerH hOutLayer, int iPixValField, 
+                                     int nConnectedness, int nThreads,
+                                     GDALProgressFunc pfnProgress, 
+                                     void * pProgressArg )
+
+{
+    GPStreamInfo sInfo;
+    int nXSize = GDALGetRasterBandXSize( hSrcBand );
+    int nYSize = GDALGetRasterBandYSize( hSrcBand );
+
+/* -------------------------------------------------------------------- */
+/*      Get the geotransform, if there is one, so we can convert the    */
+/*      vectors into georeferenced coordinates.                         */
+/* -------------------------------------------------------------------- */
+    GDALDatasetH hSrcDS = GDALGetBandDataset( hSrcBand );
+    double adfGeoTransform[6] = { 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+
+    if( hSrcDS )
+        GDALGetGeoTransform( hSrcDS, adfGeoTransform );
+
+    memset( &sInfo, 0, sizeof(sInfo) );
+    sInfo.hSrcBand = hSrcBand;
+    sInfo.hMaskBand = hMaskBand;
+    sInfo.hOutLayer = hOutLayer;
+    sInfo.iPixValField = iPixValField;
+    sInfo.padfGeoTransform = adfGeoTransform;
+    sInfo.nConnectedness = nConnectedness;
+    sInfo.nXSize = nXSize;
+    sInfo.nYSize = nYSize;
+    sInfo.eErr = CE_None;
+    sInfo.pfnProgress = pfnProgress;
+    sInfo.pProgressArg = pProgressArg;
+
+/* -------------------------------------------------------------------- */
+/*      Single strip case.                                              */
+/* -------------------------------------------------------------------- */
+    int nStrips = MIN( 2 * nThreads, nYSize / 16 );
+
+    if( nThreads <= 1 || nStrips <= 1 )
+    {
+        GPStreamPolygonizer oPolygonizer( &sInfo );
+
+        return oPolygonizer.ProcessStrip( 0, nYSize, TRUE );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Polygonize strips in threads, the main thread taking its        */
+/*      share of the jobs.                                              */
+/* -------------------------------------------------------------------- */
+    int i;
+
+    nThreads = MIN( nThreads, nStrips );
+    sInfo.nStrips = nStrips;
+    sInfo.papoStrips = (GPStreamPolygonizer **) 
+        CPLMalloc( sizeof(GPStreamPolygonizer *) * nStrips );
+    for( i = 0; i < nStrips; i++ )
+        sInfo.papoStrips[i] = new GPStreamPolygonizer( &sInfo );
+
+    sInfo.hMutex = CPLCreateMutex();
+    CPLReleaseMutex( sInfo.hMutex );
+
+    GPStreamThreadData *pasThreadData = (GPStreamThreadData *) 
+        CPLCalloc( sizeof(GPStreamThreadData), nThreads );
+    void **papThreadData = (void **) CPLCalloc( sizeof(void *), nThreads );
+
+    for( i = 0; i < nThreads; i++ )
+    {
+        pasThreadData[i].psInfo = &sInfo;
+        pasThreadData[i].bMainThread = (i == 0);
+        papThreadData[i] = pasThreadData + i;
+    }
+
+    /* The first job is run by this thread */
+    CPLErr eErr = CPLRunJobs( GPStreamJob, papThreadData, nThreads );
+
+    CPLFree( papThreadData );
+    CPLFree( pasThreadData );
+
+/* -------------------------------------------------------------------- */
+/*      Stitch the polygons crossing strip boundaries.                  */
+/* -------------------------------------------------------------------- */
+    CPLDestroyMutex( sInfo.hMutex );
+    sInfo.hMutex = NULL;
+
+    if( eErr == CE_None )
+        eErr = GPStitchStrips( &sInfo );
+
+    for( i = 0; i < nStrips; i++ )
+        delete sInfo.papoStrips[i];
+    CPLFree( sInfo.papoStrips );
+
+    return eErr;
+}
+
+#endif // OGR_ENABLED
+
+/************************************************************************/
+/*                           GDALPolygonize()                           */
+/************************************************************************/
+
+/**
+ * Create polygon coverage from raster data.
+ *
+ * This function creates vector polygons for all connected regions of pixels in
+ * the raster sharing a common pixel value.  Optionally each polygon may be
+ * labelled with the pixel value in an attribute.  Optionally a mask band
+ * can be provided to determine which pixels are eligible for processing.
+ *
+ * Note that currently the source pixel band values are read into a
+ * signed 32bit integer buffer (Int32), so floating point or complex 
+ * bands will be implicitly truncated before processing. If you want to use a
+ * version using 32bit float buffers, see GDALFPolygonize() at fpolygonize.cpp.
+ *
+ * Polygon features will be created on the output layer, with polygon 
+ * geometries representing the polygons.  The polygon geometries will be
+ * in the georeferenced coordinate system of the image (based on the
+ * geotransform of the source dataset).  It is acceptable for the output
+ * layer to already have features.  Note that GDALPolygonize() does not
+ * set the coordinate system on the output layer.  Application code should
+ * do this when the layer is created, presumably matching the raster 
+ * coordinate system. 
+ *
+ * The algorithm used attempts to minimize memory use so that very large
+ * rasters can be processed.  However, if the raster has many polygons 
+ * or very large/complex polygons, the memory use for holding polygon 
+ * enumerations and active polygon geometries may grow to be quite large. 
+ *
+ * The algorithm will generally produce very dense polygon geometries, with
+ * edges that follow exactly on pixel boundaries for all non-interior pixels.
+ * For non-thematic raster data (such as satellite images) the result will
+ * essentially be one small polygon per pixel, and memory and output layer
+ * sizes will be substantial.  The algorithm is primarily intended for 
+ * relatively simple thematic imagery, masks, and classification results. 
+ * 
+ * @param hSrcBand the source raster band to be processed.
+ * @param hMaskBand an optional mask band.  All pixels in the mask band with a 
+ * value other than zero will be considered suitable for collection as 
+ * polygons.  
+ * @param hOutLayer the vector feature layer to which the polygons should
+ * be written. 
+ * @param iPixValField the attribute field index indicating the feature
+ * attribute into which the pixel value of the polygon should be written.
+ * @param papszOptions a name/value list of additional options
+ * <dl>
+ * <dt>"8CONNECTED":</dt> May be set to "8" to use 8 connectedness.
+ * Otherwise 4 connectedness will be applied to the algorithm
+ * <dt>"STREAMING":</dt> (GDAL >= 1.10) May be set to "YES" to polygonize
+ * the raster in a single pass, writing each polygon as soon as the last
+ * line it covers has been read.  Memory use is then bounded by the polygons
+ * crossing the current line instead of growing with the number of polygons
+ * of the raster.  The polygons are the same, but they are written in a
+ * different order.
+ * <dt>"NUM_THREADS":</dt> (GDAL >= 1.10) Number of threads (default 1).
+ * Implies STREAMING=YES.  The raster is split in horizontal strips that
+ * are polygonized concurrently, and the polygons crossing strip boundaries
+ * are written at the end.
+ * </dl>
+ * @param pfnProgress callback for reporting algorithm progress matching the
+ * GDALProgressFunc() semantics.  May be NULL.
+ * @param pProgressArg callback argument passed to pfnProgress.
+ * 
+ * @return CE_None on success or CE_Failure on a failure.
+ */
+
+CPLErr CPL_STDCALL
+GDALPolygonize( GDALRasterBandH hSrcBand, 
+                GDALRasterBandH hMaskBand,
+                OGRLayerH hOutLayer, int iPixValField, 
+                char **papszOptions,
+                GDALProgressFunc pfnProgress, 
+                void * pProgressArg )
+
+{
+#ifndef OGR_ENABLED
+    CPLError(CE_Failure, CPLE_NotSupported, "GDALPolygonize() unimplemented in a non OGR build");
+    return CE_Failure;
+#else
+    VALIDATE_POINTER1( hSrcBand, "GDALPolygonize", CE_Failure );
+    VALIDATE_POINTER1( hOutLayer, "GDALPolygonize", CE_Failure );
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    int nConnectedness = CSLFetchNameValue( papszOptions, "8CONNECTED" ) ? 8 : 4;
+
+/* -------------------------------------------------------------------- */
+/*      Confirm our output layer will support feature creation.         */
+/* -------------------------------------------------------------------- */
+    if( !OGR_L_TestCapability( hOutLayer, OLCSequentialWrite ) )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "Output feature layer does not appear to support creation\n"
+                  "of features in GDALPolygonize()." );
+        return CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Use the single pass algorithm if requested.                     */
+/* -------------------------------------------------------------------- */
+    const char *pszNumThreads = CSLFetchNameValue( papszOptions, 
+                                                   "NUM_THREADS" );
+
+    if( pszNumThreads != NULL 
+        || CSLTestBoolean( CSLFetchNameValueDef( papszOptions, 
+                                                 "STREAMING", "NO" ) ) )
+    {
+        int nThreads = pszNumThreads ? MAX(1, atoi(pszNumThreads)) : 1;
+
+        return GPPolygonizeStreaming( hSrcBand, hMaskBand, 
+                                      hOutLayer, iPixValField, 
+                                      nConnectedness, nThreads,
+                                      pfnProgress, pProgressArg );
     }
 
 /* -------------------------------------------------------------------- */
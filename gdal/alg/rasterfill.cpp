@@ -30,6 +30,8 @@
 #include "gdal_alg.h"
 #include "cpl_conv.h"
 #include "cpl_string.h"
+#include "cpl_multiproc.h"
+#include <algorithm>
 
 CPL_CVSID("$Id$");
 
@@ -346,6 +348,681 @@ if( quad_value != nNoDataVal ) 						\
     }									\
 }
 
+/************************************************************************/
+/*                         GDALFillNodataLine()                         */
+/*                                                                      */
+/*      Interpolate the nodata pixels of one scanline in the bottom     */
+/*      to top pass, from the "last known value" of each column         */
+/*      found by the top down pass (TopDown) and by the bottom up       */
+/*      pass on the lines below (Last).  The bottom up information      */
+/*      including this line is returned in This, and the pixels         */
+/*      that were interpolated are flagged in pabyFiltMask.             */
+/************************************************************************/
+
+static void
+GDALFillNodataLine( int iY, int nXSize, 
+                    double dfMaxSearchDist, int nMaxSearchDist,
+                    GUInt32 nNoDataVal,
+                    GByte *pabyMask, float *pafScanline, 
+                    GUInt32 *panLastY, float *pafLastValue,
+                    GUInt32 *panThisY, float *pafThisValue,
+                    GUInt32 *panTopDownY, float *pafTopDownValue,
+                    GByte *pabyFiltMask )
+
+{
+    int iX;
+    const size_t nXBytes = (size_t) MAX(nXSize, 0);
+
+/* -------------------------------------------------------------------- */
+/*      Figure out the most recent pixel for each column.               */
+/* -------------------------------------------------------------------- */
+        
+    for( iX = 0; iX < nXSize; iX++ )
+    {
+        if( pabyMask[iX] )
+        {
+            pafThisValue[iX] = pafScanline[iX];
+            panThisY[iX] = iY;
+        }
+        else if( panLastY[iX] - iY <= dfMaxSearchDist )
+        {
+            pafThisValue[iX] = pafLastValue[iX];
+            panThisY[iX] = panLastY[iX];
+        }
+        else
+        {
+            panThisY[iX] = nNoDataVal;
+        }
+    }
+        
+/* -------------------------------------------------------------------- */
+/*      Attempt to interpolate any pixels that are nodata.              */
+/* -------------------------------------------------------------------- */
+    memset( pabyFiltMask, 0, nXBytes );
+    for( iX = 0; iX < nXSize; iX++ )
+    {
+        int iStep, iQuad;
+        int nThisMaxSearchDist = nMaxSearchDist;
+
+        // If this was a valid target - no change.
+        if( pabyMask[iX] )
+            continue;
+
+        // Quadrants 0:topleft, 1:bottomleft, 2:topright, 3:bottomright
+        double adfQuadDist[4];
+        double adfQuadValue[4];
+
+        for( iQuad = 0; iQuad < 4; iQuad++ )
+            adfQuadDist[iQuad] = dfMaxSearchDist + 1.0;
+            
+        // Step left and right by one pixel searching for the closest 
+        // target value for each quadrant. 
+        for( iStep = 0; iStep < nThisMaxSearchDist; iStep++ )
+        {
+            int iLeftX = MAX(0,iX - iStep);
+            int iRightX = MIN(nXSize-1,iX + iStep);
+                
+            // top left includes current line 
+            QUAD_CHECK(adfQuadDist[0],adfQuadValue[0], 
+                       iLeftX, panTopDownY[iLeftX], iX, iY,
+                       pafTopDownValue[iLeftX] );
+
+            // bottom left 
+            QUAD_CHECK(adfQuadDist[1],adfQuadValue[1], 
+                       iLeftX, panLastY[iLeftX], iX, iY, 
+                       pafLastValue[iLeftX] );
+
+            // top right and bottom right do no include center pixel.
+            if( iStep == 0 )
+                 continue;
+                    
+            // top right includes current line 
+            QUAD_CHECK(adfQuadDist[2],adfQuadValue[2], 
+                       iRightX, panTopDownY[iRightX], iX, iY,
+                       pafTopDownValue[iRightX] );
+
+            // bottom right
+            QUAD_CHECK(adfQuadDist[3],adfQuadValue[3], 
+                       iRightX, panLastY[iRightX], iX, iY,
+                       pafLastValue[iRightX] );
+
+            // every four steps, recompute maximum distance.
+            if( (iStep & 0x3) == 0 )
+                nThisMaxSearchDist = (int) floor(
+                    MAX(MAX(adfQuadDist[0],adfQuadDist[1]),
+                        MAX(adfQuadDist[2],adfQuadDist[3])) );
+        }
+
+        double dfWeightSum = 0.0;
+        double dfValueSum = 0.0;
+            
+        for( iQuad = 0; iQuad < 4; iQuad++ )
+        {
+            if( adfQuadDist[iQuad] <= dfMaxSearchDist )
+            {
+                double dfWeight = 1.0 / adfQuadDist[iQuad];
+
+                dfWeightSum += dfWeight;
+                dfValueSum += adfQuadValue[iQuad] * dfWeight;
+            }
+        }
+
+        if( dfWeightSum > 0.0 )
+        {
+            pabyMask[iX] = 255;
+            pabyFiltMask[iX] = 255;
+            pafScanline[iX] = (float) (dfValueSum / dfWeightSum);
+        }
+
+    }
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                     Strip based processing                           */
+/*                                                                      */
+/*      The bottom to top interpolation pass and the smoothing          */
+/*      filter are run on horizontal strips in several threads.         */
+/*      The interpolation of a strip starts from the bottom up          */
+/*      "last known values" of the line below it, collected during      */
+/*      the top down pass.  The smoothing of a strip is computed        */
+/*      over the strip extended by nIterations lines on both sides,     */
+/*      the values of those halo lines being read before any strip      */
+/*      is written.                                                     */
+/* ==================================================================== */
+/************************************************************************/
+
+typedef struct
+{
+    int         nYStart;
+    int         nYEnd;
+
+    /* bottom up information of the line below the strip */
+    GUInt32    *panBelowY;
+    float      *pafBelowValue;
+} GDALFillStrip;
+
+typedef struct 
+{
+    int         nPass;          /* 1: interpolation, 2: smoothing */
+    int         nXSize;
+    int         nYSize;
+    int         nChunkLines;
+
+    GDALRasterBandH hTargetBand;
+    GDALRasterBandH hMaskBand;
+    GDALRasterBandH hYBand;
+    GDALRasterBandH hValBand;
+    GDALRasterBandH hFiltMaskBand;
+
+    double      dfMaxSearchDist;
+    int         nMaxSearchDist;
+    GUInt32     nNoDataVal;
+
+    int         nIterations;
+    /* target values of the nIterations lines around each strip start */
+    float     **papafHaloValues;
+
+    int         nStrips;
+    GDALFillStrip *pasStrips;
+
+    /* protects the members below, and raster IO */
+    void       *hMutex;
+    CPLErr      eErr;
+    int         nNextStrip;
+    int         nLinesDone;
+
+    GDALProgressFunc pfnProgress;
+    void       *pProgressArg;
+    double      dfProgressMin;
+    double      dfProgressMax;
+} GDALFillJob;
+
+/************************************************************************/
+/*                        GDALFillLinesDone()                           */
+/************************************************************************/
+
+static CPLErr GDALFillLinesDone( GDALFillJob *psJob, int nLines, 
+                                 int bMainThread )
+
+{
+    CPLAcquireMutex( psJob->hMutex, 1000.0 );
+    psJob->nLinesDone += nLines;
+    double dfComplete = psJob->dfProgressMin 
+        + (psJob->dfProgressMax - psJob->dfProgressMin) 
+        * psJob->nLinesDone / (double) psJob->nYSize;
+    CPLReleaseMutex( psJob->hMutex );
+
+    if( bMainThread 
+        && !psJob->pfnProgress( dfComplete, 
+                                psJob->nPass == 1 ? "Filling..." 
+                                : "Smoothing Filter...",
+                                psJob->pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                       GDALFillInterpolateStrip()                     */
+/*                                                                      */
+/*      Run the bottom to top pass of GDALFillNodata() on one strip,    */
+/*      by chunks of lines.                                             */
+/************************************************************************/
+
+static CPLErr GDALFillInterpolateStrip( GDALFillJob *psJob, 
+                                        GDALFillStrip *psStrip, 
+                                        int bMainThread )
+
+{
+    int nXSize = psJob->nXSize;
+    int nChunkLines = psJob->nChunkLines;
+    CPLErr eErr = CE_None;
+
+    GByte *pabyMask = (GByte *) VSIMalloc2( nXSize, nChunkLines );
+    GByte *pabyFiltMask = (GByte *) VSIMalloc2( nXSize, nChunkLines );
+    float *pafScanline = (float *) 
+        VSIMalloc3( sizeof(float), nXSize, nChunkLines );
+    GUInt32 *panTopDownY = (GUInt32 *) 
+        VSIMalloc3( sizeof(GUInt32), nXSize, nChunkLines );
+    float *pafTopDownValue = (float *) 
+        VSIMalloc3( sizeof(float), nXSize, nChunkLines );
+    GUInt32 *panLastY = (GUInt32 *) VSIMalloc2( nXSize, sizeof(GUInt32) );
+    GUInt32 *panThisY = (GUInt32 *) VSIMalloc2( nXSize, sizeof(GUInt32) );
+    float *pafLastValue = (float *) VSIMalloc2( nXSize, sizeof(float) );
+    float *pafThisValue = (float *) VSIMalloc2( nXSize, sizeof(float) );
+
+    if( pabyMask == NULL || pabyFiltMask == NULL || pafScanline == NULL
+        || panTopDownY == NULL || pafTopDownValue == NULL 
+        || panLastY == NULL || panThisY == NULL 
+        || pafLastValue == NULL || pafThisValue == NULL )
+    {
+        CPLError(CE_Failure, CPLE_OutOfMemory,
+                 "Could not allocate enough memory for temporary buffers");
+        eErr = CE_Failure;
+    }
+    else
+    {
+        memcpy( panLastY, psStrip->panBelowY, sizeof(GUInt32) * nXSize );
+        memcpy( pafLastValue, psStrip->pafBelowValue, sizeof(float) * nXSize );
+    }
+
+    int iChunkEnd;
+
+    for( iChunkEnd = psStrip->nYEnd; 
+         eErr == CE_None && iChunkEnd > psStrip->nYStart; 
+         iChunkEnd -= nChunkLines )
+    {
+        int iChunkStart = MAX(psStrip->nYStart, iChunkEnd - nChunkLines);
+        int nLines = iChunkEnd - iChunkStart;
+        int iY;
+
+/* -------------------------------------------------------------------- */
+/*      Read the chunk.                                                 */
+/* -------------------------------------------------------------------- */
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+
+        eErr = psJob->eErr;
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hMaskBand, GF_Read, 
+                                 0, iChunkStart, nXSize, nLines, 
+                                 pabyMask, nXSize, nLines, GDT_Byte, 0, 0 );
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hTargetBand, GF_Read, 
+                                 0, iChunkStart, nXSize, nLines, 
+                                 pafScanline, nXSize, nLines, 
+                                 GDT_Float32, 0, 0 );
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hYBand, GF_Read, 
+                                 0, iChunkStart, nXSize, nLines, 
+                                 panTopDownY, nXSize, nLines, 
+                                 GDT_UInt32, 0, 0 );
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hValBand, GF_Read, 
+                                 0, iChunkStart, nXSize, nLines, 
+                                 pafTopDownValue, nXSize, nLines, 
+                                 GDT_Float32, 0, 0 );
+
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( eErr != CE_None )
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Interpolate the lines from bottom to top.                       */
+/* -------------------------------------------------------------------- */
+        for( iY = iChunkEnd - 1; iY >= iChunkStart; iY-- )
+        {
+            int nOffset = (iY - iChunkStart) * nXSize;
+
+            GDALFillNodataLine( iY, nXSize, psJob->dfMaxSearchDist, 
+                                psJob->nMaxSearchDist, psJob->nNoDataVal,
+                                pabyMask + nOffset, pafScanline + nOffset,
+                                panLastY, pafLastValue, 
+                                panThisY, pafThisValue,
+                                panTopDownY + nOffset, 
+                                pafTopDownValue + nOffset, 
+                                pabyFiltMask + nOffset );
+
+            std::swap( panLastY, panThisY );
+            std::swap( pafLastValue, pafThisValue );
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Write out the updated data and mask information.                */
+/* -------------------------------------------------------------------- */
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+
+        eErr = GDALRasterIO( psJob->hTargetBand, GF_Write, 
+                             0, iChunkStart, nXSize, nLines, 
+                             pafScanline, nXSize, nLines, 
+                             GDT_Float32, 0, 0 );
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hFiltMaskBand, GF_Write, 
+                                 0, iChunkStart, nXSize, nLines, 
+                                 pabyFiltMask, nXSize, nLines, 
+                                 GDT_Byte, 0, 0 );
+
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( eErr == CE_None )
+            eErr = GDALFillLinesDone( psJob, nLines, bMainThread );
+    }
+
+    CPLFree( pabyMask );
+    CPLFree( pabyFiltMask );
+    CPLFree( pafScanline );
+    CPLFree( panTopDownY );
+    CPLFree( pafTopDownValue );
+    CPLFree( panLastY );
+    CPLFree( panThisY );
+    CPLFree( pafLastValue );
+    CPLFree( pafThisValue );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GDALFillSmoothStrip()                        */
+/*                                                                      */
+/*      Apply the nIterations smoothing passes of GDALMultiFilter()     */
+/*      to one strip.  Each pass computes the lines of the extended     */
+/*      strip from the lines of the previous pass, except the first     */
+/*      and last lines of the raster which are left unchanged.  The     */
+/*      lines at the ends of the extended strip that are not the        */
+/*      raster edges become wrong, but no more than nIterations         */
+/*      lines, which are not part of the strip.                         */
+/************************************************************************/
+
+static CPLErr GDALFillSmoothStrip( GDALFillJob *psJob, int iStrip,
+                                   int bMainThread )
+
+{
+    GDALFillStrip *psStrip = psJob->pasStrips + iStrip;
+    int nXSize = psJob->nXSize;
+    int nYSize = psJob->nYSize;
+    int nIterations = psJob->nIterations;
+    int nWinStart = MAX(0, psStrip->nYStart - nIterations);
+    int nWinEnd = MIN(nYSize, psStrip->nYEnd + nIterations);
+    int nWinLines = nWinEnd - nWinStart;
+    int nLines = psStrip->nYEnd - psStrip->nYStart;
+    CPLErr eErr = CE_None;
+
+    GByte *pabyTMask = (GByte *) VSIMalloc2( nXSize, nWinLines );
+    GByte *pabyFMask = (GByte *) VSIMalloc2( nXSize, nWinLines );
+    float *pafLastPass = (float *) 
+        VSIMalloc3( sizeof(float), nXSize, nWinLines );
+    float *pafThisPass = (float *) 
+        VSIMalloc3( sizeof(float), nXSize, nWinLines );
+
+    if( pabyTMask == NULL || pabyFMask == NULL 
+        || pafLastPass == NULL || pafThisPass == NULL )
+    {
+        CPLError(CE_Failure, CPLE_OutOfMemory,
+                 "Could not allocate enough memory for temporary buffers");
+        eErr = CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Read the masks of the extended strip, and the values of the     */
+/*      strip itself.                                                   */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None )
+    {
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+
+        eErr = psJob->eErr;
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hMaskBand, GF_Read, 
+                                 0, nWinStart, nXSize, nWinLines, 
+                                 pabyTMask, nXSize, nWinLines, 
+                                 GDT_Byte, 0, 0 );
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hFiltMaskBand, GF_Read, 
+                                 0, nWinStart, nXSize, nWinLines, 
+                                 pabyFMask, nXSize, nWinLines, 
+                                 GDT_Byte, 0, 0 );
+        if( eErr == CE_None )
+            eErr = GDALRasterIO( psJob->hTargetBand, GF_Read, 
+                                 0, psStrip->nYStart, nXSize, nLines, 
+                                 pafLastPass 
+                                 + (psStrip->nYStart - nWinStart) * nXSize, 
+                                 nXSize, nLines, GDT_Float32, 0, 0 );
+
+        CPLReleaseMutex( psJob->hMutex );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Take the values of the lines above and below from the halo      */
+/*      lines read before the first strip was written.                  */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None )
+    {
+        if( iStrip > 0 )
+        {
+            int nHaloLines = psStrip->nYStart - nWinStart;
+
+            memcpy( pafLastPass, 
+                    psJob->papafHaloValues[iStrip] 
+                    + (nIterations - nHaloLines) * nXSize,
+                    sizeof(float) * nXSize * nHaloLines );
+        }
+        if( iStrip < psJob->nStrips - 1 )
+        {
+            memcpy( pafLastPass + (psStrip->nYEnd - nWinStart) * nXSize,
+                    psJob->papafHaloValues[iStrip+1] + nIterations * nXSize,
+                    sizeof(float) * nXSize * (nWinEnd - psStrip->nYEnd) );
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Apply the filter passes.                                        */
+/* -------------------------------------------------------------------- */
+    int iPass, iLine;
+
+    for( iPass = 0; eErr == CE_None && iPass < nIterations; iPass++ )
+    {
+        for( iLine = 0; iLine < nWinLines; iLine++ )
+        {
+            int iY = nWinStart + iLine;
+
+            if( iLine == 0 || iLine == nWinLines - 1 
+                || iY < 1 || iY >= nYSize-1 )
+            {
+                memcpy( pafThisPass + iLine * nXSize, 
+                        pafLastPass + iLine * nXSize, 
+                        sizeof(float) * nXSize );
+                continue;
+            }
+
+            GDALFilterLine( 
+                pafLastPass + (iLine-1) * nXSize,
+                pafLastPass + iLine * nXSize, 
+                pafLastPass + (iLine+1) * nXSize, 
+                pafThisPass + iLine * nXSize,
+                pabyTMask + (iLine-1) * nXSize,
+                pabyTMask + iLine * nXSize,
+                pabyTMask + (iLine+1) * nXSize,
+                pabyFMask + iLine * nXSize, 
+                nXSize );
+        }
+
+        std::swap( pafLastPass, pafThisPass );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Write out the strip.                                            */
+/* -------------------------------------------------------------------- */
+    if( eErr == CE_None )
+    {
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        eErr = GDALRasterIO( psJob->hTargetBand, GF_Write, 
+                             0, psStrip->nYStart, nXSize, nLines, 
+                             pafLastPass 
+                             + (psStrip->nYStart - nWinStart) * nXSize, 
+                             nXSize, nLines, GDT_Float32, 0, 0 );
+        CPLReleaseMutex( psJob->hMutex );
+    }
+
+    if( eErr == CE_None )
+        eErr = GDALFillLinesDone( psJob, nLines, bMainThread );
+
+    CPLFree( pabyTMask );
+    CPLFree( pabyFMask );
+    CPLFree( pafLastPass );
+    CPLFree( pafThisPass );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GDALFillRunStrips()                          */
+/************************************************************************/
+
+static CPLErr GDALFillRunStrips( GDALFillJob *psJob, int bMainThread )
+
+{
+    while( TRUE )
+    {
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        int iStrip = psJob->nNextStrip++;
+        int bStop = (iStrip >= psJob->nStrips || psJob->eErr != CE_None);
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( bStop )
+            return CE_None;
+
+        CPLErr eErr;
+        if( psJob->nPass == 1 )
+            eErr = GDALFillInterpolateStrip( psJob, psJob->pasStrips + iStrip,
+                                             bMainThread );
+        else
+            eErr = GDALFillSmoothStrip( psJob, iStrip, bMainThread );
+
+        if( eErr != CE_None )
+        {
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+            if( psJob->eErr == CE_None )
+                psJob->eErr = eErr;
+            CPLReleaseMutex( psJob->hMutex );
+            return eErr;
+        }
+    }
+}
+
+typedef struct
+{
+    GDALFillJob    *psJob;
+    int             bMainThread;    /* the one reporting progress */
+} GDALFillThreadData;
+
+static CPLErr GDALFillStripsJob( void *pData )
+
+{
+    GDALFillThreadData *psThreadData = (GDALFillThreadData *) pData;
+
+    return GDALFillRunStrips( psThreadData->psJob, psThreadData->bMainThread );
+}
+
+/************************************************************************/
+/*                          GDALFillRunPass()                           */
+/*                                                                      */
+/*      Run one pass over all strips in nThreads threads, this one      */
+/*      included.                                                       */
+/************************************************************************/
+
+static CPLErr GDALFillRunPass( GDALFillJob *psJob, int nPass, int nThreads )
+
+{
+    int iThread;
+
+    psJob->nPass = nPass;
+    psJob->nNextStrip = 0;
+    psJob->nLinesDone = 0;
+
+    GDALFillThreadData *pasThreadData = (GDALFillThreadData *) 
+        CPLCalloc( sizeof(GDALFillThreadData), nThreads );
+    void **papThreadData = (void **) CPLCalloc( sizeof(void *), nThreads );
+
+    for( iThread = 0; iThread < nThreads; iThread++ )
+    {
+        pasThreadData[iThread].psJob = psJob;
+        pasThreadData[iThread].bMainThread = (iThread == 0);
+        papThreadData[iThread] = pasThreadData + iThread;
+    }
+
+    /* The first job is run by this thread */
+    CPLErr eErr = CPLRunJobs( GDALFillStripsJob, papThreadData, nThreads );
+
+    CPLFree( papThreadData );
+    CPLFree( pasThreadData );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         GDALMultiFilterMT()                          */
+/*                                                                      */
+/*      Same as GDALMultiFilter(), on strips of at most nStripLines     */
+/*      lines.                                                          */
+/************************************************************************/
+
+static CPLErr
+GDALMultiFilterMT( GDALFillJob *psJob, int nIterations, 
+                   int nStripLines, int nThreads )
+
+{
+    int nXSize = psJob->nXSize;
+    int nYSize = psJob->nYSize;
+    int nStrips = (nYSize + nStripLines - 1) / nStripLines;
+    int iStrip;
+    CPLErr eErr = CE_None;
+
+    if( !psJob->pfnProgress( psJob->dfProgressMin, "Smoothing Filter...", 
+                             psJob->pProgressArg ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    psJob->nIterations = nIterations;
+    psJob->nStrips = nStrips;
+    psJob->pasStrips = (GDALFillStrip *) 
+        CPLCalloc( sizeof(GDALFillStrip), nStrips );
+    psJob->papafHaloValues = (float **) CPLCalloc( sizeof(float*), nStrips );
+
+/* -------------------------------------------------------------------- */
+/*      Read the nIterations lines above and below each strip start,    */
+/*      which are needed by the neighbouring strips.                    */
+/* -------------------------------------------------------------------- */
+    for( iStrip = 0; iStrip < nStrips && eErr == CE_None; iStrip++ )
+    {
+        GDALFillStrip *psStrip = psJob->pasStrips + iStrip;
+
+        psStrip->nYStart = iStrip * nStripLines;
+        psStrip->nYEnd = MIN(nYSize, psStrip->nYStart + nStripLines);
+
+        if( iStrip == 0 )
+            continue;
+
+        int nHaloStart = MAX(0, psStrip->nYStart - nIterations);
+        int nHaloEnd = MIN(nYSize, psStrip->nYStart + nIterations);
+
+        psJob->papafHaloValues[iStrip] = (float *)
+            VSIMalloc3( sizeof(float), nXSize, 2 * nIterations );
+        if( psJob->papafHaloValues[iStrip] == NULL )
+        {
+            CPLError(CE_Failure, CPLE_OutOfMemory,
+                     "Could not allocate enough memory for temporary buffers");
+            eErr = CE_Failure;
+            break;
+        }
+
+        eErr = GDALRasterIO( psJob->hTargetBand, GF_Read, 
+                             0, nHaloStart, nXSize, nHaloEnd - nHaloStart, 
+                             psJob->papafHaloValues[iStrip] 
+                             + (nHaloStart - psStrip->nYStart + nIterations)
+                             * nXSize, 
+                             nXSize, nHaloEnd - nHaloStart, 
+                             GDT_Float32, 0, 0 );
+    }
+
+    if( eErr == CE_None )
+        eErr = GDALFillRunPass( psJob, 2, nThreads );
+
+    for( iStrip = 0; iStrip < nStrips; iStrip++ )
+        CPLFree( psJob->papafHaloValues[iStrip] );
+    CPLFree( psJob->papafHaloValues );
+    CPLFree( psJob->pasStrips );
+    psJob->papafHaloValues = NULL;
+    psJob->pasStrips = NULL;
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                           GDALFillNodata()                           */
 /************************************************************************/
@@ -375,8 +1052,16 @@ if( quad_value != nNoDataVal ) 						\
  * @param bDeprecatedOption unused argument, should be zero.
  * @param nSmoothingIterations the number of 3x3 smoothing filter passes to 
  * run (0 or more).
- * @param papszOptions additional name=value options in a string list (none 
- * supported at this time - just pass NULL).
+ * @param papszOptions additional name=value options in a string list.  The
+ * following options are supported (GDAL >= 1.10):
+ * <ul>
+ * <li>NUM_THREADS=n: run the interpolation and the smoothing on horizontal
+ * strips in n threads.  The result is identical to the single threaded 
+ * processing.</li>
+ * <li>WORKING_MEMORY=n: memory in megabytes used by the threads for line 
+ * buffers, 64 by default.  The smoothing also keeps 2*nSmoothingIterations
+ * lines around each strip boundary.</li>
+ * </ul>
  * @param pfnProgress the progress function to report completion.
  * @param pProgressArg callback data for progress function.
  * 
@@ -423,6 +1108,21 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
     if( hMaskBand == NULL )
         hMaskBand = GDALGetMaskBand( hTargetBand );
 
+/* -------------------------------------------------------------------- */
+/*      Multi-threaded processing options.  Strips are only used when   */
+/*      the nodata "last y" value cannot be taken for a line within     */
+/*      the search distance, as the serial pass relies on values left   */
+/*      over from previous lines in that case.                          */
+/* -------------------------------------------------------------------- */
+    int nThreads = atoi( CSLFetchNameValueDef( papszOptions, 
+                                               "NUM_THREADS", "1" ) );
+    double dfWorkingMemory = 
+        CPLAtof( CSLFetchNameValueDef( papszOptions, 
+                                       "WORKING_MEMORY", "64" ) ) 
+        * 1024 * 1024;
+    int bUseStrips = nThreads > 1 && nYSize > 1
+        && (double) nNoDataVal - nYSize > dfMaxSearchDist + 1.0;
+
     /* If there are smoothing iterations, reserve 10% of the progress for them */
     double dfProgressRatio = (nSmoothingIterations > 0) ? 0.9 : 1.0;
 
@@ -506,6 +1206,12 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
     GByte   *pabyMask, *pabyFiltMask;
     int     iX;
     int     iY;
+    GDALFillJob sJob;
+    int     nStrips = 0;
+    int     iStrip;
+    int    *panNextStrip = NULL;
+
+    memset( &sJob, 0, sizeof(sJob) );
 
     panLastY = (GUInt32 *) VSICalloc(nXSize,sizeof(GUInt32));
     panThisY = (GUInt32 *) VSICalloc(nXSize,sizeof(GUInt32));
@@ -532,6 +1238,54 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
         panLastY[iX] = nNoDataVal;
     }
 
+/* -------------------------------------------------------------------- */
+/*      Setup the strips of the bottom to top pass.  The top down       */
+/*      pass records for each strip the first valid pixel below it      */
+/*      in each column (panNextStrip being the first strip not yet      */
+/*      resolved in the column).                                        */
+/* -------------------------------------------------------------------- */
+    if( bUseStrips )
+    {
+        nStrips = MIN(4 * nThreads, nYSize);
+
+        sJob.pasStrips = (GDALFillStrip *) 
+            CPLCalloc( sizeof(GDALFillStrip), nStrips );
+        panNextStrip = (int *) VSICalloc( nXSize, sizeof(int) );
+        if( panNextStrip == NULL )
+            eErr = CE_Failure;
+
+        for( iStrip = 0; iStrip < nStrips; iStrip++ )
+        {
+            GDALFillStrip *psStrip = sJob.pasStrips + iStrip;
+
+            psStrip->nYStart = (int) (iStrip * (double) nYSize / nStrips);
+            psStrip->nYEnd = (int) ((iStrip+1) * (double) nYSize / nStrips);
+
+            if( iStrip == nStrips - 1 || eErr != CE_None )
+                continue;
+
+            psStrip->panBelowY = (GUInt32 *) 
+                VSIMalloc2( nXSize, sizeof(GUInt32) );
+            psStrip->pafBelowValue = (float *) 
+                VSICalloc( nXSize, sizeof(float) );
+            if( psStrip->panBelowY == NULL || psStrip->pafBelowValue == NULL )
+            {
+                eErr = CE_Failure;
+                continue;
+            }
+
+            for( iX = 0; iX < nXSize; iX++ )
+                psStrip->panBelowY[iX] = nNoDataVal;
+        }
+
+        if( eErr != CE_None )
+        {
+            CPLError(CE_Failure, CPLE_OutOfMemory,
+                     "Could not allocate enough memory for temporary buffers");
+            goto end;
+        }
+    }
+
 /* ==================================================================== */
 /*      Make first pass from top to bottom collecting the "last         */
 /*      known value" for each column and writing it out to the work     */
@@ -578,6 +1332,25 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
                 panThisY[iX] = nNoDataVal;
             }
         }
+
+        for( iX = 0; bUseStrips && iX < nXSize; iX++ )
+        {
+            if( !pabyMask[iX] )
+                continue;
+
+            while( panNextStrip[iX] < nStrips - 1 
+                   && sJob.pasStrips[panNextStrip[iX]].nYEnd <= iY )
+            {
+                GDALFillStrip *psStrip = sJob.pasStrips + panNextStrip[iX];
+
+                if( iY - psStrip->nYEnd <= dfMaxSearchDist )
+                {
+                    psStrip->panBelowY[iX] = iY;
+                    psStrip->pafBelowValue[iX] = pafScanline[iX];
+                }
+                panNextStrip[iX]++;
+            }
+        }
         
 /* -------------------------------------------------------------------- */
 /*      Write out best index/value to working files.                    */
@@ -622,7 +1395,48 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
 /*      bottom to top and use it in combination with the top to         */
 /*      bottom search info to interpolate.                              */
 /* ==================================================================== */
-    for( iY = nYSize-1; iY >= 0 && eErr == CE_None; iY-- )
+    if( bUseStrips && eErr == CE_None )
+    {
+        sJob.nXSize = nXSize;
+        sJob.nYSize = nYSize;
+        sJob.nChunkLines = (int) 
+            MAX(1, MIN(nYSize, dfWorkingMemory / nThreads / (14.0 * nXSize)));
+        sJob.hTargetBand = hTargetBand;
+        sJob.hMaskBand = hMaskBand;
+        sJob.hYBand = hYBand;
+        sJob.hValBand = hValBand;
+        sJob.hFiltMaskBand = hFiltMaskBand;
+        sJob.dfMaxSearchDist = dfMaxSearchDist;
+        sJob.nMaxSearchDist = nMaxSearchDist;
+        sJob.nNoDataVal = nNoDataVal;
+        sJob.nStrips = nStrips;
+        sJob.eErr = CE_None;
+        sJob.pfnProgress = pfnProgress;
+        sJob.pProgressArg = pProgressArg;
+        sJob.dfProgressMin = dfProgressRatio * 0.5;
+        sJob.dfProgressMax = dfProgressRatio;
+
+        // The last strip starts from where the top down pass ended.
+        sJob.pasStrips[nStrips-1].panBelowY = panLastY;
+        sJob.pasStrips[nStrips-1].pafBelowValue = pafLastValue;
+
+        sJob.hMutex = CPLCreateMutex();
+        CPLReleaseMutex( sJob.hMutex );
+
+        eErr = GDALFillRunPass( &sJob, 1, nThreads );
+
+        sJob.pasStrips[nStrips-1].panBelowY = NULL;
+        sJob.pasStrips[nStrips-1].pafBelowValue = NULL;
+        for( iStrip = 0; iStrip < nStrips; iStrip++ )
+        {
+            CPLFree( sJob.pasStrips[iStrip].panBelowY );
+            CPLFree( sJob.pasStrips[iStrip].pafBelowValue );
+        }
+        CPLFree( sJob.pasStrips );
+        sJob.pasStrips = NULL;
+    }
+
+    for( iY = nYSize-1; iY >= 0 && eErr == CE_None && !bUseStrips; iY-- )
     {
         eErr = 
             GDALRasterIO( hMaskBand, GF_Read, 0, iY, nXSize, 1, 
@@ -638,28 +1452,6 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
         if( eErr != CE_None )
             break;
         
-/* -------------------------------------------------------------------- */
-/*      Figure out the most recent pixel for each column.               */
-/* -------------------------------------------------------------------- */
-        
-        for( iX = 0; iX < nXSize; iX++ )
-        {
-            if( pabyMask[iX] )
-            {
-                pafThisValue[iX] = pafScanline[iX];
-                panThisY[iX] = iY;
-            }
-            else if( panLastY[iX] - iY <= dfMaxSearchDist )
-            {
-                pafThisValue[iX] = pafLastValue[iX];
-                panThisY[iX] = panLastY[iX];
-            }
-            else
-            {
-                panThisY[iX] = nNoDataVal;
-            }
-        }
-        
 /* -------------------------------------------------------------------- */
 /*      Load the last y and corresponding value from the top down pass. */
 /* -------------------------------------------------------------------- */
@@ -680,83 +1472,10 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
 /* -------------------------------------------------------------------- */
 /*      Attempt to interpolate any pixels that are nodata.              */
 /* -------------------------------------------------------------------- */
-        memset( pabyFiltMask, 0, nXSize );
-        for( iX = 0; iX < nXSize; iX++ )
-        {
-            int iStep, iQuad;
-            int nThisMaxSearchDist = nMaxSearchDist;
-
-            // If this was a valid target - no change.
-            if( pabyMask[iX] )
-                continue;
-
-            // Quadrants 0:topleft, 1:bottomleft, 2:topright, 3:bottomright
-            double adfQuadDist[4];
-            double adfQuadValue[4];
-
-            for( iQuad = 0; iQuad < 4; iQuad++ )
-                adfQuadDist[iQuad] = dfMaxSearchDist + 1.0;
-            
-            // Step left and right by one pixel searching for the closest 
-            // target value for each quadrant. 
-            for( iStep = 0; iStep < nThisMaxSearchDist; iStep++ )
-            {
-                int iLeftX = MAX(0,iX - iStep);
-                int iRightX = MIN(nXSize-1,iX + iStep);
-                
-                // top left includes current line 
-                QUAD_CHECK(adfQuadDist[0],adfQuadValue[0], 
-                           iLeftX, panTopDownY[iLeftX], iX, iY,
-                           pafTopDownValue[iLeftX] );
-
-                // bottom left 
-                QUAD_CHECK(adfQuadDist[1],adfQuadValue[1], 
-                           iLeftX, panLastY[iLeftX], iX, iY, 
-                           pafLastValue[iLeftX] );
-
-                // top right and bottom right do no include center pixel.
-                if( iStep == 0 )
-                     continue;
-                    
-                // top right includes current line 
-                QUAD_CHECK(adfQuadDist[2],adfQuadValue[2], 
-                           iRightX, panTopDownY[iRightX], iX, iY,
-                           pafTopDownValue[iRightX] );
-
-                // bottom right
-                QUAD_CHECK(adfQuadDist[3],adfQuadValue[3], 
-                           iRightX, panLastY[iRightX], iX, iY,
-                           pafLastValue[iRightX] );
-
-                // every four steps, recompute maximum distance.
-                if( (iStep & 0x3) == 0 )
-                    nThisMaxSearchDist = (int) floor(
-                        MAX(MAX(adfQuadDist[0],adfQuadDist[1]),
-                            MAX(adfQuadDist[2],adfQuadDist[3])) );
-            }
-
-            double dfWeightSum = 0.0;
-            double dfValueSum = 0.0;
-            
-            for( iQuad = 0; iQuad < 4; iQuad++ )
-            {
-                if( adfQuadDist[iQuad] <= dfMaxSearchDist )
-                {
-                    double dfWeight = 1.0 / adfQuadDist[iQuad];
-
-                    dfWeightSum += dfWeight;
-                    dfValueSum += adfQuadValue[iQuad] * dfWeight;
-                }
-            }
-
-            if( dfWeightSum > 0.0 )
-            {
-                pabyMask[iX] = 255;
-                pabyFiltMask[iX] = 255;
-                pafScanline[iX] = (float) (dfValueSum / dfWeightSum);
-            }
-
-        }
+        GDALFillNodataLine( iY, nXSize, dfMaxSearchDist, nMaxSearchDist,
+                            nNoDataVal, pabyMask, pafScanline,
+                            panLastY, pafLastValue, panThisY, pafThisValue,
+                            panTopDownY, pafTopDownValue, pabyFiltMask );
 
 /* -------------------------------------------------------------------- */
 /*      Write out the updated data and mask information.                */
@@ -810,21 +1529,52 @@ GDALFillNodata( GDALRasterBandH hTargetBand,
         // force masks to be to flushed and recomputed.
         GDALFlushRasterCache( hMaskBand );
 
-        void *pScaledProgress;
-        pScaledProgress =
-            GDALCreateScaledProgress( dfProgressRatio, 1.0, pfnProgress, NULL );
+        if( bUseStrips )
+        {
+            int nStripLines = (int) 
+                (dfWorkingMemory / nThreads / (10.0 * nXSize)) 
+                - 2 * nSmoothingIterations;
+
+            nStripLines = MAX(1, MIN(nStripLines, 
+                                     (nYSize + nThreads - 1) / nThreads));
+
+            sJob.dfProgressMin = dfProgressRatio;
+            sJob.dfProgressMax = 1.0;
+
+            eErr = GDALMultiFilterMT( &sJob, nSmoothingIterations, 
+                                      nStripLines, nThreads );
+        }
+        else
+        {
+            void *pScaledProgress;
+            pScaledProgress =
+                GDALCreateScaledProgress( dfProgressRatio, 1.0, 
+                                          pfnProgress, NULL );
 
-        eErr = GDALMultiFilter( hTargetBand, hMaskBand, hFiltMaskBand, 
-                                nSmoothingIterations,
-                                GDALScaledProgress, pScaledProgress );
+            eErr = GDALMultiFilter( hTargetBand, hMaskBand, hFiltMaskBand, 
+                                    nSmoothingIterations,
+                                    GDALScaledProgress, pScaledProgress );
 
-        GDALDestroyScaledProgress( pScaledProgress );
+            GDALDestroyScaledProgress( pScaledProgress );
+        }
     }
 
 /* -------------------------------------------------------------------- */
 /*      Close and clean up temporary files. Free working buffers        */
 /* -------------------------------------------------------------------- */
 end:
+    if( sJob.hMutex != NULL )
+        CPLDestroyMutex( sJob.hMutex );
+    if( sJob.pasStrips != NULL )
+    {
+        for( iStrip = 0; iStrip < nStrips - 1; iStrip++ )
+        {
+            CPLFree( sJob.pasStrips[iStrip].panBelowY );
+            CPLFree( sJob.pasStrips[iStrip].pafBelowValue );
+        }
+        CPLFree( sJob.pasStrips );
+    }
+    CPLFree(panNextStrip);
     CPLFree(panLastY);
     CPLFree(panThisY);
     CPLFree(panTopDownY);
@@ -70,7 +70,7 @@ static void Usage()
         "Usage: gdal_contour [-b <band>] [-a <attribute_name>] [-3d] [-inodata]\n"
         "                    [-snodata n] [-f <formatname>] [-i <interval>]\n"
         "                    [-off <offset>] [-fl <level> <level>...]\n" 
-        "                    [-nln <outlayername>] [-q]\n"
+        "                    [-nln <outlayername>] [-num_threads n] [-q]\n"
         "                    <src_filename> <dst_filename>\n" );
     exit( 1 );
 }
@@ -94,6 +94,7 @@ int main( int argc, char ** argv )
     int    nFixedLevelCount = 0;
     const char *pszNewLayerName = "contour";
     int bQuiet = FALSE;
+    int nThreads = 0;
     GDALProgressFunc pfnProgress = NULL;
 
     /* Check that we are running against at least GDAL 1.4 */
@@ -162,6 +163,10 @@ int main( int argc, char ** argv )
         {
             pszNewLayerName = argv[++i];
         }
+        else if( EQUAL(argv[i],"-num_threads")  && i < argc-1 )
+        {
+            nThreads = atoi(argv[++i]);
+        }
         else if( EQUAL(argv[i],"-inodata") )
         {
             bIgnoreNoData = TRUE;
@@ -276,16 +281,50 @@ int main( int argc, char ** argv )
 /*      Invoke.                                                         */
 /* -------------------------------------------------------------------- */
     CPLErr eErr;
-    
-    eErr = GDALContourGenerate( hBand, dfInterval, dfOffset, 
-                         nFixedLevelCount, adfFixedLevels,
-                         bNoDataSet, dfNoData, hLayer, 
-                         OGR_FD_GetFieldIndex( OGR_L_GetLayerDefn( hLayer ), 
-                                               "ID" ), 
-                         (pszElevAttrib == NULL) ? -1 :
-                                 OGR_FD_GetFieldIndex( OGR_L_GetLayerDefn( hLayer ), 
-                                                       pszElevAttrib ), 
-                         pfnProgress, NULL );
+    char **papszOptions = NULL;
+
+    if( nFixedLevelCount > 0 )
+    {
+        CPLString osLevels;
+
+        for( i = 0; i < nFixedLevelCount; i++ )
+        {
+            if( i > 0 )
+                osLevels += ",";
+            osLevels += CPLSPrintf( "%.18g", adfFixedLevels[i] );
+        }
+        papszOptions = CSLSetNameValue( papszOptions, "FIXED_LEVELS",
+                                        osLevels );
+    }
+    else
+    {
+        papszOptions = CSLSetNameValue( papszOptions, "LEVEL_INTERVAL",
+                                        CPLSPrintf( "%.18g", dfInterval ) );
+        papszOptions = CSLSetNameValue( papszOptions, "LEVEL_BASE",
+                                        CPLSPrintf( "%.18g", dfOffset ) );
+    }
+
+    if( bNoDataSet )
+        papszOptions = CSLSetNameValue( papszOptions, "NODATA",
+                                        CPLSPrintf( "%.18g", dfNoData ) );
+
+    papszOptions = CSLSetNameValue( papszOptions, "ID_FIELD",
+        CPLSPrintf( "%d", OGR_FD_GetFieldIndex( OGR_L_GetLayerDefn( hLayer ),
+                                                "ID" ) ) );
+    if( pszElevAttrib != NULL )
+        papszOptions = CSLSetNameValue( papszOptions, "ELEV_FIELD",
+            CPLSPrintf( "%d",
+                        OGR_FD_GetFieldIndex( OGR_L_GetLayerDefn( hLayer ),
+                                              pszElevAttrib ) ) );
+
+    if( nThreads > 0 )
+        papszOptions = CSLSetNameValue( papszOptions, "NUM_THREADS",
+                                        CPLSPrintf( "%d", nThreads ) );
+
+    eErr = GDALContourGenerateEx( hBand, hLayer, papszOptions,
+                                  pfnProgress, NULL );
+
+    CSLDestroy( papszOptions );
 
     OGR_DS_Destroy( hDS );
     GDALClose( hSrcDS );
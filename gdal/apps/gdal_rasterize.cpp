@@ -76,7 +76,7 @@ static void Usage()
         "       [-a_nodata value] [-init value]*\n"
         "       [-te xmin ymin xmax ymax] [-tr xres yres] [-tap] [-ts width height]\n"
         "       [-ot {Byte/Int16/UInt16/UInt32/Int32/Float32/Float64/\n"
-        "             CInt16/CInt32/CFloat32/CFloat64}] [-q]\n"
+        "             CInt16/CInt32/CFloat32/CFloat64}] [-num_threads n] [-q]\n"
         "       <src_datasource> <dst_filename>\n" );
     exit( 1 );
 }
@@ -569,6 +569,11 @@ int main( int argc, char ** argv )
             papszRasterizeOptions = 
                 CSLSetNameValue( papszRasterizeOptions, "ALL_TOUCHED", "TRUE" );
         }
+        else if( EQUAL(argv[i],"-num_threads") && i < argc-1 )
+        {
+            papszRasterizeOptions = 
+                CSLSetNameValue( papszRasterizeOptions, "NUM_THREADS", argv[++i] );
+        }
         else if( EQUAL(argv[i],"-burn") && i < argc-1 )
         {
             if (strchr(argv[i+1], ' '))
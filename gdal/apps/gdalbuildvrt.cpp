@@ -29,6 +29,8 @@
 
 #include "gdal_proxy.h"
 #include "cpl_string.h"
+#include "cpl_minixml.h"
+#include "cpl_multiproc.h"
 #include "vrt/gdal_vrt.h"
 #include "vrt/vrtdataset.h"
 
@@ -39,6 +41,9 @@
 
 CPL_CVSID("$Id$");
 
+#include <map>
+#include <vector>
+
 #define GEOTRSFRM_TOPLEFT_X            0
 #define GEOTRSFRM_WE_RES               1
 #define GEOTRSFRM_ROTATION_PARAM1      2
@@ -54,6 +59,19 @@ typedef enum
     USER_RESOLUTION
 } ResolutionStrategy;
 
+/* Metadata domain of the VRT where the properties of the input files */
+/* are stored by the -incremental mode */
+#define FILE_RECORDS_DOMAIN "xml:GDALBUILDVRT"
+
+typedef struct
+{
+    GDALColorInterp        colorInterpretation;
+    GDALDataType           dataType;
+    GDALColorTableH        colorTable;
+    int                    bHasNoData;
+    double                 noDataValue;
+} BandProperty;
+
 typedef struct
 {
     int    isFileOK;
@@ -68,16 +86,20 @@ typedef struct
     int    bHasDatasetMask;
     int    nMaskBlockXSize;
     int    nMaskBlockYSize;
-} DatasetProperty;
 
-typedef struct
-{
-    GDALColorInterp        colorInterpretation;
-    GDALDataType           dataType;
-    GDALColorTableH        colorTable;
-    int                    bHasNoData;
-    double                 noDataValue;
-} BandProperty;
+    /* Properties of the file, as probed before it is analysed */
+    int    bOpened;
+    char  *pszProjectionRef;
+    int    bGotGeoTransform;
+    int    nBandCount;
+    BandProperty *pasBandProperties;
+    char **papszSubdatasets;
+
+    /* Size and modification time of the file, for the -incremental mode */
+    int     bStatOK;
+    GIntBig nFileSize;
+    GIntBig nMTime;
+} DatasetProperty;
 
 /************************************************************************/
 /*                               Usage()                                */
@@ -91,7 +113,8 @@ static void Usage()
             "                    [-tr xres yres] [-tap] [-separate] [-allow_projection_difference] [-q]\n"
             "                    [-te xmin ymin xmax ymax] [-addalpha] [-hidenodata] \n"
             "                    [-srcnodata \"value [value...]\"] [-vrtnodata \"value [value...]\"] \n"
-            "                    [-input_file_list my_liste.txt] [-overwrite] output.vrt [gdalfile]*\n"
+            "                    [-input_file_list my_liste.txt] [-overwrite]\n"
+            "                    [-num_threads n] [-incremental] output.vrt [gdalfile]*\n"
             "\n"
             "eg.\n"
             "  % gdalbuildvrt doq_index.vrt doq/*.tif\n"
@@ -108,6 +131,8 @@ static void Usage()
             "  o If one GDAL dataset is made of several subdatasets and has 0 raster bands, its\n"
             "    datasets will be added to the VRT rather than the dataset itself.\n"
             "  o By default, only datasets of same projection and band characteristics may be added to the VRT.\n"
+            "  o With -incremental, the properties of the input files are stored in the VRT, and only\n"
+            "    the files that are new or have changed since the previous run are opened again.\n"
             );
     exit( 1 );
 }
@@ -216,10 +241,24 @@ class VRTBuilder
     int                 nVRTNoDataCount;
     int                 bHasRunBuild;
     int                 bHasDatasetMask;
+    int                 nNumThreads;
+    int                 bIncremental;
 
-    int         AnalyseRaster(GDALDatasetH hDS, const char* dsFileName,
+    /* Files probed by the previous run, in the -incremental mode */
+    CPLXMLNode         *psPreviousFiles;
+    char              **papszPreviousSRS;
+    GIntBig             nPreviousTime;
+    GIntBig             nStartTime;
+    std::map<CPLString, CPLXMLNode*> oMapPreviousFiles;
+
+    int         AnalyseRaster(const char* dsFileName,
                               DatasetProperty* psDatasetProperties);
 
+    int         ProbeDatasets(int iStart, int iEnd,
+                              GDALProgressFunc pfnProgress, void * pProgressData);
+    void        LoadPreviousFiles();
+    void        StoreFiles(VRTDatasetH hVRTDS);
+
     void        CreateVRTSeparate(VRTDatasetH hVRTDS);
     void        CreateVRTNonSeparate(VRTDatasetH hVRTDS);
 
@@ -232,11 +271,14 @@ class VRTBuilder
                            double minX, double minY, double maxX, double maxY,
                            int bSeparate, int bAllowProjectionDifference,
                            int bAddAlpha, int bHideNoData,
-                           const char* pszSrcNoData, const char* pszVRTNoData);
+                           const char* pszSrcNoData, const char* pszVRTNoData,
+                           int nNumThreads, int bIncremental);
 
                ~VRTBuilder();
 
         int     Build(GDALProgressFunc pfnProgress, void * pProgressData);
+
+        void    ProbeDataset(int iFile);
 };
 
 
@@ -252,7 +294,8 @@ VRTBuilder::VRTBuilder(const char* pszOutputFilename,
                        double minX, double minY, double maxX, double maxY,
                        int bSeparate, int bAllowProjectionDifference,
                        int bAddAlpha, int bHideNoData,
-                       const char* pszSrcNoData, const char* pszVRTNoData)
+                       const char* pszSrcNoData, const char* pszVRTNoData,
+                       int nNumThreads, int bIncremental)
 {
     this->pszOutputFilename = CPLStrdup(pszOutputFilename);
     this->nInputFiles = nInputFiles;
@@ -278,6 +321,8 @@ VRTBuilder::VRTBuilder(const char* pszOutputFilename,
     this->bHideNoData = bHideNoData;
     this->pszSrcNoData = (pszSrcNoData) ? CPLStrdup(pszSrcNoData) : NULL;
     this->pszVRTNoData = (pszVRTNoData) ? CPLStrdup(pszVRTNoData) : NULL;
+    this->nNumThreads = MAX(1, nNumThreads);
+    this->bIncremental = bIncremental;
 
     bUserExtent = FALSE;
     pszProjectionRef = NULL;
@@ -296,6 +341,10 @@ VRTBuilder::VRTBuilder(const char* pszOutputFilename,
     nVRTNoDataCount = 0;
     bHasRunBuild = FALSE;
     bHasDatasetMask = FALSE;
+    psPreviousFiles = NULL;
+    papszPreviousSRS = NULL;
+    nPreviousTime = 0;
+    nStartTime = 0;
 }
 
 /************************************************************************/
@@ -319,8 +368,21 @@ VRTBuilder::~VRTBuilder()
     {
         for(i=0;i<nInputFiles;i++)
         {
-            CPLFree(pasDatasetProperties[i].padfNoDataValues);
-            CPLFree(pasDatasetProperties[i].panHasNoData);
+            DatasetProperty* psDatasetProperties = &pasDatasetProperties[i];
+            CPLFree(psDatasetProperties->padfNoDataValues);
+            CPLFree(psDatasetProperties->panHasNoData);
+            CPLFree(psDatasetProperties->pszProjectionRef);
+            if (psDatasetProperties->pasBandProperties != NULL)
+            {
+                int j;
+                for(j=0;j<psDatasetProperties->nBandCount;j++)
+                {
+                    if (psDatasetProperties->pasBandProperties[j].colorTable)
+                        GDALDestroyColorTable(psDatasetProperties->pasBandProperties[j].colorTable);
+                }
+                CPLFree(psDatasetProperties->pasBandProperties);
+            }
+            CSLDestroy(psDatasetProperties->papszSubdatasets);
         }
     }
     CPLFree(pasDatasetProperties);
@@ -338,6 +400,10 @@ VRTBuilder::~VRTBuilder()
     CPLFree(pszProjectionRef);
     CPLFree(padfSrcNoData);
     CPLFree(padfVRTNoData);
+
+    if (psPreviousFiles != NULL)
+        CPLDestroyXMLNode(psPreviousFiles);
+    CPLFree(papszPreviousSRS);
 }
 
 /************************************************************************/
@@ -363,21 +429,68 @@ static int ProjAreEqual(const char* pszWKT1, const char* pszWKT2)
 }
 
 /************************************************************************/
-/*                           AnalyseRaster()                            */
+/*                            ProbeDataset()                            */
+/*                                                                      */
+/*      Open an input file and collect the properties needed to         */
+/*      analyse it. This is called from several threads at once, so    */
+/*      it only touches the properties of this file.                    */
 /************************************************************************/
 
-int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
-                                  DatasetProperty* psDatasetProperties)
+static int DeserializeDatasetProperty(CPLXMLNode* psFile, char** papszSRS,
+                                      DatasetProperty* psDatasetProperties);
+
+void VRTBuilder::ProbeDataset(int iFile)
 {
+    DatasetProperty* psDatasetProperties = &pasDatasetProperties[iFile];
+    const char* dsFileName = ppszInputFilenames[iFile];
+    int j;
+
+/* -------------------------------------------------------------------- */
+/*      In the -incremental mode, reuse the properties stored by the   */
+/*      previous run if the file has the same size and modification    */
+/*      time. As the modification time has a resolution of a second,  */
+/*      a file modified in the second the previous run started could   */
+/*      have been modified again after it was probed, so it is always  */
+/*      probed again.                                                  */
+/* -------------------------------------------------------------------- */
+    if (bIncremental)
+    {
+        VSIStatBufL sStat;
+        if (VSIStatL(dsFileName, &sStat) == 0)
+        {
+            psDatasetProperties->bStatOK = TRUE;
+            psDatasetProperties->nFileSize = (GIntBig) sStat.st_size;
+            psDatasetProperties->nMTime = (GIntBig) sStat.st_mtime;
+
+            std::map<CPLString, CPLXMLNode*>::iterator oIter =
+                oMapPreviousFiles.find(dsFileName);
+            if (oIter != oMapPreviousFiles.end() &&
+                psDatasetProperties->nMTime < nPreviousTime)
+            {
+                CPLXMLNode* psFile = oIter->second;
+                if (CPLScanUIntBig(CPLGetXMLValue(psFile, "Size", ""), 32) ==
+                        (GUIntBig) psDatasetProperties->nFileSize &&
+                    CPLScanUIntBig(CPLGetXMLValue(psFile, "MTime", ""), 32) ==
+                        (GUIntBig) psDatasetProperties->nMTime &&
+                    DeserializeDatasetProperty(psFile, papszPreviousSRS,
+                                               psDatasetProperties))
+                {
+                    psDatasetProperties->bOpened = TRUE;
+                    return;
+                }
+            }
+        }
+    }
+
+    GDALDatasetH hDS = GDALOpen(dsFileName, GA_ReadOnly );
+    if (hDS == NULL)
+        return;
+
+    psDatasetProperties->bOpened = TRUE;
+
     char** papszMetadata = GDALGetMetadata( hDS, "SUBDATASETS" );
     if( CSLCount(papszMetadata) > 0 && GDALGetRasterCount(hDS) == 0 )
     {
-        pasDatasetProperties =
-            (DatasetProperty*) CPLRealloc(pasDatasetProperties,
-                            (nInputFiles+CSLCount(papszMetadata))*sizeof(DatasetProperty));
-
-        ppszInputFilenames = (char**)CPLRealloc(ppszInputFilenames,
-                                sizeof(char*) * (nInputFiles+CSLCount(papszMetadata)));
         int count = 1;
         char subdatasetNameKey[256];
         sprintf(subdatasetNameKey, "SUBDATASET_%d_NAME", count);
@@ -385,20 +498,565 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
         {
             if (EQUALN(*papszMetadata, subdatasetNameKey, strlen(subdatasetNameKey)))
             {
-                memset(&pasDatasetProperties[nInputFiles], 0, sizeof(DatasetProperty));
-                ppszInputFilenames[nInputFiles++] =
-                        CPLStrdup(*papszMetadata+strlen(subdatasetNameKey)+1);
+                psDatasetProperties->papszSubdatasets =
+                    CSLAddString(psDatasetProperties->papszSubdatasets,
+                                 *papszMetadata+strlen(subdatasetNameKey)+1);
                 count++;
                 sprintf(subdatasetNameKey, "SUBDATASET_%d_NAME", count);
             }
             papszMetadata++;
         }
-        return FALSE;
+        GDALClose(hDS);
+        return;
     }
 
     const char* proj = GDALGetProjectionRef(hDS);
+    if (proj)
+        psDatasetProperties->pszProjectionRef = CPLStrdup(proj);
+    psDatasetProperties->bGotGeoTransform =
+        GDALGetGeoTransform(hDS, psDatasetProperties->adfGeoTransform) == CE_None;
+    psDatasetProperties->nRasterXSize = GDALGetRasterXSize(hDS);
+    psDatasetProperties->nRasterYSize = GDALGetRasterYSize(hDS);
+
+    psDatasetProperties->nBandCount = GDALGetRasterCount(hDS);
+    if (psDatasetProperties->nBandCount == 0)
+    {
+        GDALClose(hDS);
+        return;
+    }
+
+    GDALRasterBandH hFirstBand = GDALGetRasterBand( hDS, 1 );
+    GDALGetBlockSize(hFirstBand,
+                     &psDatasetProperties->nBlockXSize,
+                     &psDatasetProperties->nBlockYSize);
+    psDatasetProperties->bHasDatasetMask = GDALGetMaskFlags(hFirstBand) == GMF_PER_DATASET;
+    GDALGetBlockSize(GDALGetMaskBand(hFirstBand),
+                     &psDatasetProperties->nMaskBlockXSize,
+                     &psDatasetProperties->nMaskBlockYSize);
+
+    psDatasetProperties->pasBandProperties = (BandProperty*)
+        CPLCalloc(psDatasetProperties->nBandCount, sizeof(BandProperty));
+    for(j=0;j<psDatasetProperties->nBandCount;j++)
+    {
+        BandProperty* psBandProperties = &psDatasetProperties->pasBandProperties[j];
+        GDALRasterBandH hRasterBand = GDALGetRasterBand( hDS, j+1 );
+        psBandProperties->colorInterpretation =
+                GDALGetRasterColorInterpretation(hRasterBand);
+        psBandProperties->dataType = GDALGetRasterDataType(hRasterBand);
+        psBandProperties->colorTable = GDALGetRasterColorTable(hRasterBand);
+        if (psBandProperties->colorTable)
+            psBandProperties->colorTable = GDALCloneColorTable(psBandProperties->colorTable);
+        psBandProperties->noDataValue =
+                GDALGetRasterNoDataValue(hRasterBand, &psBandProperties->bHasNoData);
+    }
+
+    GDALClose(hDS);
+}
+
+/************************************************************************/
+/*                          ProbeDatasets()                             */
+/************************************************************************/
+
+/* Queue of the input files to probe, shared by the probing threads */
+typedef struct
+{
+    VRTBuilder *poBuilder;
+    void       *hMutex;
+    int         iStartFile;
+    int         iNextFile;
+    int         iEndFile;
+    int         nTotalFiles;
+    int         nDoneFiles;
+    int         bStop;
+    GDALProgressFunc pfnProgress;
+    void       *pProgressData;
+} ProbeJobQueue;
+
+typedef struct
+{
+    ProbeJobQueue *psQueue;
+    int         bMainThread;
+} ProbeThreadData;
+
+static int GetNextProbeJob(ProbeJobQueue* psQueue)
+{
+    int iFile = -1;
+
+    CPLAcquireMutex(psQueue->hMutex, 1000.0);
+    if (!psQueue->bStop && psQueue->iNextFile < psQueue->iEndFile)
+        iFile = psQueue->iNextFile ++;
+    CPLReleaseMutex(psQueue->hMutex);
+
+    return iFile;
+}
+
+/* Probe files until there are none left. Only the main thread reports */
+/* the progress */
+static CPLErr ProbeJob(void* pData)
+{
+    ProbeThreadData* psData = (ProbeThreadData*) pData;
+    ProbeJobQueue* psQueue = psData->psQueue;
+    int iFile;
+
+    while ((iFile = GetNextProbeJob(psQueue)) >= 0)
+    {
+        psQueue->poBuilder->ProbeDataset(iFile);
+
+        CPLAcquireMutex(psQueue->hMutex, 1000.0);
+        psQueue->nDoneFiles ++;
+        int nDoneFiles = psQueue->nDoneFiles;
+        CPLReleaseMutex(psQueue->hMutex);
+
+        if (psData->bMainThread &&
+            !psQueue->pfnProgress( 1.0 * (psQueue->iStartFile + nDoneFiles) /
+                                   psQueue->nTotalFiles,
+                                   NULL, psQueue->pProgressData))
+        {
+            /* The other threads stop after their current file */
+            CPLAcquireMutex(psQueue->hMutex, 1000.0);
+            psQueue->bStop = TRUE;
+            CPLReleaseMutex(psQueue->hMutex);
+            return CE_Failure;
+        }
+    }
+
+    return CE_None;
+}
+
+/* Probe the files from iStart to iEnd-1, with nNumThreads threads. */
+/* The calling thread takes part in the work and reports the progress */
+int VRTBuilder::ProbeDatasets(int iStart, int iEnd,
+                              GDALProgressFunc pfnProgress, void * pProgressData)
+{
+    ProbeJobQueue sQueue;
+    int nThreads = MAX(1, MIN(nNumThreads, iEnd - iStart));
+    int i;
+
+    sQueue.poBuilder = this;
+    sQueue.hMutex = CPLCreateMutex();
+    CPLReleaseMutex(sQueue.hMutex);
+    sQueue.iStartFile = iStart;
+    sQueue.iNextFile = iStart;
+    sQueue.iEndFile = iEnd;
+    sQueue.nTotalFiles = nInputFiles;
+    sQueue.nDoneFiles = 0;
+    sQueue.bStop = FALSE;
+    sQueue.pfnProgress = pfnProgress;
+    sQueue.pProgressData = pProgressData;
+
+    std::vector<ProbeThreadData> asThreadData(nThreads);
+    std::vector<void*> apThreadData(nThreads);
+
+    for(i=0;i<nThreads;i++)
+    {
+        asThreadData[i].psQueue = &sQueue;
+        asThreadData[i].bMainThread = (i == 0);
+        apThreadData[i] = &asThreadData[i];
+    }
+
+    /* The first job is run by this thread */
+    CPLErr eErr = CPLRunJobs(ProbeJob, &apThreadData[0], nThreads);
+
+    CPLDestroyMutex(sQueue.hMutex);
+
+    return eErr == CE_None;
+}
+
+/************************************************************************/
+/*                     SerializeDatasetProperty()                       */
+/************************************************************************/
+
+static CPLXMLNode* SerializeDatasetProperty(const char* dsFileName,
+                                            DatasetProperty* psDatasetProperties,
+                                            int iSRS)
+{
+    CPLXMLNode* psFile = CPLCreateXMLNode(NULL, CXT_Element, "File");
+    int j;
+
+    CPLSetXMLValue(psFile, "#Name", dsFileName);
+    CPLSetXMLValue(psFile, "#Size",
+                   CPLSPrintf(CPL_FRMT_GIB, psDatasetProperties->nFileSize));
+    CPLSetXMLValue(psFile, "#MTime",
+                   CPLSPrintf(CPL_FRMT_GIB, psDatasetProperties->nMTime));
+
+    for(j=0;psDatasetProperties->papszSubdatasets != NULL &&
+            psDatasetProperties->papszSubdatasets[j] != NULL;j++)
+    {
+        CPLCreateXMLElementAndValue(psFile, "Subdataset",
+                                    psDatasetProperties->papszSubdatasets[j]);
+    }
+    if (psDatasetProperties->papszSubdatasets != NULL)
+        return psFile;
+
+    CPLSetXMLValue(psFile, "#RasterXSize",
+                   CPLSPrintf("%d", psDatasetProperties->nRasterXSize));
+    CPLSetXMLValue(psFile, "#RasterYSize",
+                   CPLSPrintf("%d", psDatasetProperties->nRasterYSize));
+    if (iSRS >= 0)
+        CPLSetXMLValue(psFile, "#SRS", CPLSPrintf("%d", iSRS));
+    if (psDatasetProperties->bGotGeoTransform)
+    {
+        const double* padfGeoTransform = psDatasetProperties->adfGeoTransform;
+        CPLSetXMLValue(psFile, "GeoTransform",
+                       CPLSPrintf("%.16g,%.16g,%.16g,%.16g,%.16g,%.16g",
+                                  padfGeoTransform[0], padfGeoTransform[1],
+                                  padfGeoTransform[2], padfGeoTransform[3],
+                                  padfGeoTransform[4], padfGeoTransform[5]));
+    }
+    if (psDatasetProperties->nBandCount == 0)
+        return psFile;
+
+    CPLSetXMLValue(psFile, "#BlockXSize",
+                   CPLSPrintf("%d", psDatasetProperties->nBlockXSize));
+    CPLSetXMLValue(psFile, "#BlockYSize",
+                   CPLSPrintf("%d", psDatasetProperties->nBlockYSize));
+    if (psDatasetProperties->bHasDatasetMask)
+        CPLSetXMLValue(psFile, "#HasDatasetMask", "1");
+    CPLSetXMLValue(psFile, "#MaskBlockXSize",
+                   CPLSPrintf("%d", psDatasetProperties->nMaskBlockXSize));
+    CPLSetXMLValue(psFile, "#MaskBlockYSize",
+                   CPLSPrintf("%d", psDatasetProperties->nMaskBlockYSize));
+
+    for(j=0;j<psDatasetProperties->nBandCount;j++)
+    {
+        BandProperty* psBandProperties = &psDatasetProperties->pasBandProperties[j];
+        CPLXMLNode* psBand = CPLCreateXMLNode(psFile, CXT_Element, "Band");
+
+        CPLSetXMLValue(psBand, "#DataType",
+                       GDALGetDataTypeName(psBandProperties->dataType));
+        CPLSetXMLValue(psBand, "#ColorInterp",
+                       GDALGetColorInterpretationName(psBandProperties->colorInterpretation));
+        if (psBandProperties->bHasNoData)
+            CPLSetXMLValue(psBand, "#NoDataValue",
+                           CPLSPrintf("%.18g", psBandProperties->noDataValue));
+
+        if (psBandProperties->colorTable != NULL)
+        {
+            CPLXMLNode* psCT = CPLCreateXMLNode(psBand, CXT_Element, "ColorTable");
+            int i, nCount = GDALGetColorEntryCount(psBandProperties->colorTable);
+            for(i=0;i<nCount;i++)
+            {
+                const GDALColorEntry* psEntry =
+                    GDALGetColorEntry(psBandProperties->colorTable, i);
+                CPLXMLNode* psEntryNode = CPLCreateXMLNode(psCT, CXT_Element, "Entry");
+                CPLSetXMLValue(psEntryNode, "#c1", CPLSPrintf("%d", psEntry->c1));
+                CPLSetXMLValue(psEntryNode, "#c2", CPLSPrintf("%d", psEntry->c2));
+                CPLSetXMLValue(psEntryNode, "#c3", CPLSPrintf("%d", psEntry->c3));
+                CPLSetXMLValue(psEntryNode, "#c4", CPLSPrintf("%d", psEntry->c4));
+            }
+        }
+    }
+
+    return psFile;
+}
+
+/************************************************************************/
+/*                    DeserializeDatasetProperty()                      */
+/************************************************************************/
+
+static int DeserializeDatasetProperty(CPLXMLNode* psFile, char** papszSRS,
+                                      DatasetProperty* psDatasetProperties)
+{
+    CPLXMLNode* psIter;
+    int j;
+
+    for(psIter = psFile->psChild; psIter != NULL; psIter = psIter->psNext)
+    {
+        if (psIter->eType == CXT_Element && EQUAL(psIter->pszValue, "Subdataset"))
+            psDatasetProperties->papszSubdatasets =
+                CSLAddString(psDatasetProperties->papszSubdatasets,
+                             CPLGetXMLValue(psIter, NULL, ""));
+    }
+    if (psDatasetProperties->papszSubdatasets != NULL)
+        return TRUE;
+
+/* -------------------------------------------------------------------- */
+/*      Check the record before filling psDatasetProperties, so that    */
+/*      the file can be probed again from a clean state if it is bad.   */
+/* -------------------------------------------------------------------- */
+    int iSRS = -1;
+    const char* pszSRS = CPLGetXMLValue(psFile, "SRS", NULL);
+    if (pszSRS != NULL)
+    {
+        iSRS = atoi(pszSRS);
+        if (iSRS < 0 || iSRS >= CSLCount(papszSRS))
+            return FALSE;
+    }
+
+    char** papszGeoTransform = NULL;
+    const char* pszGeoTransform = CPLGetXMLValue(psFile, "GeoTransform", NULL);
+    if (pszGeoTransform != NULL)
+    {
+        papszGeoTransform = CSLTokenizeStringComplex(pszGeoTransform, ",", FALSE, FALSE);
+        if (CSLCount(papszGeoTransform) != 6)
+        {
+            CSLDestroy(papszGeoTransform);
+            return FALSE;
+        }
+    }
+
+    psDatasetProperties->nRasterXSize = atoi(CPLGetXMLValue(psFile, "RasterXSize", "0"));
+    psDatasetProperties->nRasterYSize = atoi(CPLGetXMLValue(psFile, "RasterYSize", "0"));
+
+    if (iSRS >= 0)
+        psDatasetProperties->pszProjectionRef = CPLStrdup(papszSRS[iSRS]);
+
+    if (papszGeoTransform != NULL)
+    {
+        for(j=0;j<6;j++)
+            psDatasetProperties->adfGeoTransform[j] = CPLAtofM(papszGeoTransform[j]);
+        CSLDestroy(papszGeoTransform);
+        psDatasetProperties->bGotGeoTransform = TRUE;
+    }
+
+    psDatasetProperties->nBlockXSize = atoi(CPLGetXMLValue(psFile, "BlockXSize", "0"));
+    psDatasetProperties->nBlockYSize = atoi(CPLGetXMLValue(psFile, "BlockYSize", "0"));
+    psDatasetProperties->bHasDatasetMask =
+        CSLTestBoolean(CPLGetXMLValue(psFile, "HasDatasetMask", "0"));
+    psDatasetProperties->nMaskBlockXSize = atoi(CPLGetXMLValue(psFile, "MaskBlockXSize", "0"));
+    psDatasetProperties->nMaskBlockYSize = atoi(CPLGetXMLValue(psFile, "MaskBlockYSize", "0"));
+
+    for(psIter = psFile->psChild; psIter != NULL; psIter = psIter->psNext)
+    {
+        if (psIter->eType == CXT_Element && EQUAL(psIter->pszValue, "Band"))
+            psDatasetProperties->nBandCount ++;
+    }
+    if (psDatasetProperties->nBandCount == 0)
+        return TRUE;
+
+    psDatasetProperties->pasBandProperties = (BandProperty*)
+        CPLCalloc(psDatasetProperties->nBandCount, sizeof(BandProperty));
+
+    j = 0;
+    for(psIter = psFile->psChild; psIter != NULL; psIter = psIter->psNext)
+    {
+        if (psIter->eType != CXT_Element || !EQUAL(psIter->pszValue, "Band"))
+            continue;
+
+        BandProperty* psBandProperties = &psDatasetProperties->pasBandProperties[j++];
+        psBandProperties->dataType =
+            GDALGetDataTypeByName(CPLGetXMLValue(psIter, "DataType", "Byte"));
+
+        const char* pszColorInterp = CPLGetXMLValue(psIter, "ColorInterp", "Undefined");
+        int iInterp;
+        psBandProperties->colorInterpretation = GCI_Undefined;
+        for(iInterp = 0; iInterp < 0xff; iInterp++)
+        {
+            const char *pszCandidate =
+                GDALGetColorInterpretationName((GDALColorInterp) iInterp);
+            if (pszCandidate != NULL && EQUAL(pszCandidate, pszColorInterp))
+            {
+                psBandProperties->colorInterpretation = (GDALColorInterp) iInterp;
+                break;
+            }
+        }
+
+        const char* pszNoData = CPLGetXMLValue(psIter, "NoDataValue", NULL);
+        if (pszNoData != NULL)
+        {
+            psBandProperties->bHasNoData = TRUE;
+            psBandProperties->noDataValue = CPLAtofM(pszNoData);
+        }
+
+        CPLXMLNode* psCT = CPLGetXMLNode(psIter, "ColorTable");
+        if (psCT != NULL)
+        {
+            CPLXMLNode* psEntryNode;
+            int iEntry = 0;
+            psBandProperties->colorTable = GDALCreateColorTable(GPI_RGB);
+            for(psEntryNode = psCT->psChild; psEntryNode != NULL;
+                psEntryNode = psEntryNode->psNext)
+            {
+                if (psEntryNode->eType != CXT_Element ||
+                    !EQUAL(psEntryNode->pszValue, "Entry"))
+                    continue;
+
+                GDALColorEntry sEntry;
+                sEntry.c1 = (short) atoi(CPLGetXMLValue(psEntryNode, "c1", "0"));
+                sEntry.c2 = (short) atoi(CPLGetXMLValue(psEntryNode, "c2", "0"));
+                sEntry.c3 = (short) atoi(CPLGetXMLValue(psEntryNode, "c3", "0"));
+                sEntry.c4 = (short) atoi(CPLGetXMLValue(psEntryNode, "c4", "255"));
+                GDALSetColorEntry(psBandProperties->colorTable, iEntry++, &sEntry);
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                         LoadPreviousFiles()                          */
+/*                                                                      */
+/*      Load the properties of the input files stored in the output     */
+/*      VRT by a previous run in the -incremental mode.                 */
+/************************************************************************/
+
+void VRTBuilder::LoadPreviousFiles()
+{
+    VSIStatBufL sStat;
+    if (VSIStatL(pszOutputFilename, &sStat) != 0)
+        return;
+
+    CPLXMLNode* psTree = CPLParseXMLFile(pszOutputFilename);
+    if (psTree == NULL)
+        return;
+
+    CPLXMLNode* psVRT = CPLGetXMLNode(psTree, "=VRTDataset");
+    CPLXMLNode* psIter;
+    for(psIter = (psVRT) ? psVRT->psChild : NULL; psIter != NULL; psIter = psIter->psNext)
+    {
+        if (psIter->eType == CXT_Element && EQUAL(psIter->pszValue, "Metadata") &&
+            EQUAL(CPLGetXMLValue(psIter, "domain", ""), FILE_RECORDS_DOMAIN))
+        {
+            psPreviousFiles = CPLGetXMLNode(psIter, "Files");
+            break;
+        }
+    }
+
+    if (psPreviousFiles == NULL)
+    {
+        CPLDestroyXMLNode(psTree);
+        return;
+    }
+
+    /* Keep only the Files subtree */
+    CPLRemoveXMLChild(psIter, psPreviousFiles);
+    CPLDestroyXMLNode(psTree);
+
+    nPreviousTime = CPLScanUIntBig(CPLGetXMLValue(psPreviousFiles, "Time", "0"), 32);
+
+    int nSRSCount = 0;
+    for(psIter = psPreviousFiles->psChild; psIter != NULL; psIter = psIter->psNext)
+    {
+        if (psIter->eType == CXT_Element && EQUAL(psIter->pszValue, "SRS"))
+            nSRSCount ++;
+    }
+    papszPreviousSRS = (char**) CPLCalloc(nSRSCount + 1, sizeof(char*));
+    nSRSCount = 0;
+
+    for(psIter = psPreviousFiles->psChild; psIter != NULL; psIter = psIter->psNext)
+    {
+        if (psIter->eType != CXT_Element)
+            continue;
+        if (EQUAL(psIter->pszValue, "SRS"))
+        {
+            papszPreviousSRS[nSRSCount++] = (char*) CPLGetXMLValue(psIter, NULL, "");
+        }
+        else if (EQUAL(psIter->pszValue, "File"))
+        {
+            const char* pszName = CPLGetXMLValue(psIter, "Name", NULL);
+            if (pszName != NULL)
+                oMapPreviousFiles[pszName] = psIter;
+        }
+    }
+}
+
+/************************************************************************/
+/*                             StoreFiles()                             */
+/*                                                                      */
+/*      Store the properties of the input files in the VRT, for the     */
+/*      next run in the -incremental mode.                              */
+/************************************************************************/
+
+void VRTBuilder::StoreFiles(VRTDatasetH hVRTDS)
+{
+    CPLXMLNode* psFiles = CPLCreateXMLNode(NULL, CXT_Element, "Files");
+    CPLXMLNode* psLastSRS = NULL;
+    CPLXMLNode* psFirstFile = NULL;
+    CPLXMLNode* psLastFile = NULL;
+    std::map<CPLString, int> oMapSRS;
+    int i;
+
+    /* The list of files can be long : we link the nodes ourselves */
+    /* rather than walking the list of children at each addition */
+    for(i=0;i<nInputFiles;i++)
+    {
+        DatasetProperty* psDatasetProperties = &pasDatasetProperties[i];
+        if (!psDatasetProperties->bOpened || !psDatasetProperties->bStatOK)
+            continue;
+
+        int iSRS = -1;
+        if (psDatasetProperties->pszProjectionRef != NULL)
+        {
+            std::map<CPLString, int>::iterator oIter =
+                oMapSRS.find(psDatasetProperties->pszProjectionRef);
+            if (oIter != oMapSRS.end())
+                iSRS = oIter->second;
+            else
+            {
+                iSRS = (int) oMapSRS.size();
+                oMapSRS[psDatasetProperties->pszProjectionRef] = iSRS;
+
+                CPLXMLNode* psSRS = CPLCreateXMLElementAndValue(
+                    NULL, "SRS", psDatasetProperties->pszProjectionRef);
+                if (psLastSRS == NULL)
+                    psFiles->psChild = psSRS;
+                else
+                    psLastSRS->psNext = psSRS;
+                psLastSRS = psSRS;
+            }
+        }
+
+        CPLXMLNode* psFile = SerializeDatasetProperty(ppszInputFilenames[i],
+                                                      psDatasetProperties, iSRS);
+        if (psLastFile == NULL)
+            psFirstFile = psFile;
+        else
+            psLastFile->psNext = psFile;
+        psLastFile = psFile;
+    }
+
+    if (psLastSRS == NULL)
+        psFiles->psChild = psFirstFile;
+    else
+        psLastSRS->psNext = psFirstFile;
+
+    /* The attribute must come before the children */
+    CPLXMLNode* psTime = CPLCreateXMLNode(NULL, CXT_Attribute, "Time");
+    CPLCreateXMLNode(psTime, CXT_Text, CPLSPrintf(CPL_FRMT_GIB, nStartTime));
+    psTime->psNext = psFiles->psChild;
+    psFiles->psChild = psTime;
+
+    char* pszXML = CPLSerializeXMLTree(psFiles);
+    char* apszMD[2];
+    apszMD[0] = pszXML;
+    apszMD[1] = NULL;
+    GDALSetMetadata(hVRTDS, apszMD, FILE_RECORDS_DOMAIN);
+    CPLFree(pszXML);
+    CPLDestroyXMLNode(psFiles);
+}
+
+/************************************************************************/
+/*                           AnalyseRaster()                            */
+/************************************************************************/
+
+int VRTBuilder::AnalyseRaster( const char* dsFileName,
+                               DatasetProperty* psDatasetProperties)
+{
+    char** papszSubdatasets = psDatasetProperties->papszSubdatasets;
+    if( papszSubdatasets != NULL )
+    {
+        int nSubdatasets = CSLCount(papszSubdatasets);
+        int i;
+
+        /* psDatasetProperties is invalidated by the reallocation */
+        pasDatasetProperties =
+            (DatasetProperty*) CPLRealloc(pasDatasetProperties,
+                            (nInputFiles+nSubdatasets)*sizeof(DatasetProperty));
+
+        ppszInputFilenames = (char**)CPLRealloc(ppszInputFilenames,
+                                sizeof(char*) * (nInputFiles+nSubdatasets));
+        for(i=0;i<nSubdatasets;i++)
+        {
+            memset(&pasDatasetProperties[nInputFiles], 0, sizeof(DatasetProperty));
+            ppszInputFilenames[nInputFiles++] = CPLStrdup(papszSubdatasets[i]);
+        }
+        return FALSE;
+    }
+
+    const char* proj = psDatasetProperties->pszProjectionRef;
     double* padfGeoTransform = psDatasetProperties->adfGeoTransform;
-    int bGotGeoTransform = GDALGetGeoTransform(hDS, padfGeoTransform) == CE_None;
+    int bGotGeoTransform = psDatasetProperties->bGotGeoTransform;
     if (bSeparate)
     {
         if (bFirst)
@@ -426,8 +1084,8 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
             return FALSE;
         }
         else if (!bHasGeoTransform &&
-                    (nRasterXSize != GDALGetRasterXSize(hDS) ||
-                    nRasterYSize != GDALGetRasterYSize(hDS)))
+                    (nRasterXSize != psDatasetProperties->nRasterXSize ||
+                    nRasterYSize != psDatasetProperties->nRasterYSize))
         {
             CPLError(CE_Warning, CPLE_NotSupported,
                     "gdalbuildvrt -separate cannot stack ungeoreferenced images that have not the same dimensions. Skipping %s",
@@ -466,28 +1124,22 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
         }
     }
 
-    psDatasetProperties->nRasterXSize = GDALGetRasterXSize(hDS);
-    psDatasetProperties->nRasterYSize = GDALGetRasterYSize(hDS);
     if (bFirst && bSeparate && !bGotGeoTransform)
     {
-        nRasterXSize = GDALGetRasterXSize(hDS);
-        nRasterYSize = GDALGetRasterYSize(hDS);
+        nRasterXSize = psDatasetProperties->nRasterXSize;
+        nRasterYSize = psDatasetProperties->nRasterYSize;
     }
 
     double ds_minX = padfGeoTransform[GEOTRSFRM_TOPLEFT_X];
     double ds_maxY = padfGeoTransform[GEOTRSFRM_TOPLEFT_Y];
     double ds_maxX = ds_minX +
-                GDALGetRasterXSize(hDS) *
+                psDatasetProperties->nRasterXSize *
                 padfGeoTransform[GEOTRSFRM_WE_RES];
     double ds_minY = ds_maxY +
-                GDALGetRasterYSize(hDS) *
+                psDatasetProperties->nRasterYSize *
                 padfGeoTransform[GEOTRSFRM_NS_RES];
 
-    GDALGetBlockSize(GDALGetRasterBand( hDS, 1 ),
-                        &psDatasetProperties->nBlockXSize,
-                        &psDatasetProperties->nBlockYSize);
-
-    int _nBands = GDALGetRasterCount(hDS);
+    int _nBands = psDatasetProperties->nBandCount;
     if (_nBands == 0)
     {
         CPLError(CE_Warning, CPLE_AppDefined,
@@ -503,17 +1155,13 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
     }
 
     /* For the -separate case */
-    psDatasetProperties->firstBandType = GDALGetRasterDataType(GDALGetRasterBand(hDS, 1));
+    psDatasetProperties->firstBandType = psDatasetProperties->pasBandProperties[0].dataType;
 
     psDatasetProperties->padfNoDataValues = (double*)CPLCalloc(sizeof(double), _nBands);
     psDatasetProperties->panHasNoData = (int*)CPLCalloc(sizeof(int), _nBands);
 
-    psDatasetProperties->bHasDatasetMask = GDALGetMaskFlags(GDALGetRasterBand(hDS, 1)) == GMF_PER_DATASET;
     if (psDatasetProperties->bHasDatasetMask)
         bHasDatasetMask = TRUE;
-    GDALGetBlockSize(GDALGetMaskBand(GDALGetRasterBand( hDS, 1 )),
-                        &psDatasetProperties->nMaskBlockXSize,
-                        &psDatasetProperties->nMaskBlockYSize);
 
     int j;
     for(j=0;j<_nBands;j++)
@@ -528,9 +1176,10 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
         }
         else
         {
-            psDatasetProperties->padfNoDataValues[j]  =
-                GDALGetRasterNoDataValue(GDALGetRasterBand(hDS, j+1),
-                                        &psDatasetProperties->panHasNoData[j]);
+            psDatasetProperties->panHasNoData[j] =
+                psDatasetProperties->pasBandProperties[j].bHasNoData;
+            psDatasetProperties->padfNoDataValues[j] =
+                psDatasetProperties->pasBandProperties[j].noDataValue;
         }
     }
 
@@ -552,14 +1201,14 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
             pasBandProperties = (BandProperty*)CPLMalloc(nBands*sizeof(BandProperty));
             for(j=0;j<nBands;j++)
             {
-                GDALRasterBandH hRasterBand = GDALGetRasterBand( hDS, j+1 );
+                BandProperty* psBandProperties = &psDatasetProperties->pasBandProperties[j];
                 pasBandProperties[j].colorInterpretation =
-                        GDALGetRasterColorInterpretation(hRasterBand);
-                pasBandProperties[j].dataType = GDALGetRasterDataType(hRasterBand);
+                        psBandProperties->colorInterpretation;
+                pasBandProperties[j].dataType = psBandProperties->dataType;
                 if (pasBandProperties[j].colorInterpretation == GCI_PaletteIndex)
                 {
                     pasBandProperties[j].colorTable =
-                            GDALGetRasterColorTable( hRasterBand );
+                            psBandProperties->colorTable;
                     if (pasBandProperties[j].colorTable)
                     {
                         pasBandProperties[j].colorTable =
@@ -579,8 +1228,8 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
                 }
                 else
                 {
-                    pasBandProperties[j].noDataValue =
-                            GDALGetRasterNoDataValue(hRasterBand, &pasBandProperties[j].bHasNoData);
+                    pasBandProperties[j].bHasNoData = psBandProperties->bHasNoData;
+                    pasBandProperties[j].noDataValue = psBandProperties->noDataValue;
                 }
             }
         }
@@ -610,9 +1259,9 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
             }
             for(j=0;j<nBands;j++)
             {
-                GDALRasterBandH hRasterBand = GDALGetRasterBand( hDS, j+1 );
-                if (pasBandProperties[j].colorInterpretation != GDALGetRasterColorInterpretation(hRasterBand) ||
-                    pasBandProperties[j].dataType != GDALGetRasterDataType(hRasterBand))
+                BandProperty* psBandProperties = &psDatasetProperties->pasBandProperties[j];
+                if (pasBandProperties[j].colorInterpretation != psBandProperties->colorInterpretation ||
+                    pasBandProperties[j].dataType != psBandProperties->dataType)
                 {
                     CPLError(CE_Warning, CPLE_NotSupported,
                                 "gdalbuildvrt does not support heterogenous band characteristics. Skipping %s",
@@ -621,7 +1270,7 @@ int VRTBuilder::AnalyseRaster( GDALDatasetH hDS, const char* dsFileName,
                 }
                 if (pasBandProperties[j].colorTable)
                 {
-                    GDALColorTableH colorTable = GDALGetRasterColorTable( hRasterBand );
+                    GDALColorTableH colorTable = psBandProperties->colorTable;
                     int nRefColorEntryCount = GDALGetColorEntryCount(pasBandProperties[j].colorTable);
                     int i;
                     if (colorTable == NULL ||
@@ -970,34 +1619,51 @@ int VRTBuilder::Build(GDALProgressFunc pfnProgress, void * pProgressData)
         }
     }
 
+    if (bIncremental)
+    {
+        nStartTime = (GIntBig) time(NULL);
+        LoadPreviousFiles();
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Open the input files, possibly with several threads, and then   */
+/*      analyse them in order. The subdatasets of the input files are   */
+/*      added at the end of the list, and probed in a next round.       */
+/* -------------------------------------------------------------------- */
     int nCountValid = 0;
-    for(i=0;i<nInputFiles;i++)
+    int iFirstToProbe = 0;
+    while (iFirstToProbe < nInputFiles)
     {
-        const char* dsFileName = ppszInputFilenames[i];
+        int iEnd = nInputFiles;
 
-        if (!pfnProgress( 1.0 * (i+1) / nInputFiles, NULL, pProgressData))
+        if (!ProbeDatasets(iFirstToProbe, iEnd, pfnProgress, pProgressData))
         {
             return CE_Failure;
         }
 
-        GDALDatasetH hDS = GDALOpen(ppszInputFilenames[i], GA_ReadOnly );
-        pasDatasetProperties[i].isFileOK = FALSE;
-
-        if (hDS)
+        for(i=iFirstToProbe;i<iEnd;i++)
         {
-            if (AnalyseRaster( hDS, dsFileName, &pasDatasetProperties[i] ))
+            const char* dsFileName = ppszInputFilenames[i];
+
+            pasDatasetProperties[i].isFileOK = FALSE;
+
+            if (pasDatasetProperties[i].bOpened)
             {
-                pasDatasetProperties[i].isFileOK = TRUE;
-                nCountValid ++;
-                bFirst = FALSE;
+                if (AnalyseRaster( dsFileName, &pasDatasetProperties[i] ))
+                {
+                    pasDatasetProperties[i].isFileOK = TRUE;
+                    nCountValid ++;
+                    bFirst = FALSE;
+                }
+            }
+            else
+            {
+                CPLError(CE_Warning, CPLE_AppDefined, 
+                         "Can't open %s. Skipping it", dsFileName);
             }
-            GDALClose(hDS);
-        }
-        else
-        {
-            CPLError(CE_Warning, CPLE_AppDefined, 
-                     "Can't open %s. Skipping it", dsFileName);
         }
+
+        iFirstToProbe = iEnd;
     }
 
     if (nCountValid == 0)
@@ -1059,6 +1725,9 @@ int VRTBuilder::Build(GDALProgressFunc pfnProgress, void * pProgressData)
         CreateVRTNonSeparate(hVRTDS);
     }
 
+    if (bIncremental)
+        StoreFiles(hVRTDS);
+
     GDALClose(hVRTDS);
 
     return CE_None;
@@ -1180,6 +1849,8 @@ int main( int nArgc, char ** papszArgv )
     int bHideNoData = FALSE;
     const char* pszSrcNoData = NULL;
     const char* pszVRTNoData = NULL;
+    int nNumThreads = 1;
+    int bIncremental = FALSE;
 
     /* Check strict compilation and runtime library version as we use C++ API */
     if (! GDAL_CHECK_VERSION(papszArgv[0]))
@@ -1284,6 +1955,19 @@ int main( int nArgc, char ** papszArgv )
         {
             pszVRTNoData = papszArgv[++iArg];
         }
+        else if ( EQUAL(papszArgv[iArg],"-num_threads") && iArg + 1 < nArgc)
+        {
+            nNumThreads = atoi(papszArgv[++iArg]);
+            if (nNumThreads < 1)
+            {
+                fprintf(stderr, "Invalid value for -num_threads\n");
+                Usage();
+            }
+        }
+        else if ( EQUAL(papszArgv[iArg],"-incremental") )
+        {
+            bIncremental = TRUE;
+        }
         else if ( papszArgv[iArg][0] == '-' )
         {
             printf("Unrecognized option : %s\n", papszArgv[iArg]);
@@ -1377,7 +2061,7 @@ int main( int nArgc, char ** papszArgv )
     VRTBuilder oBuilder(pszOutputFilename, nInputFiles, ppszInputFilenames,
                         eStrategy, we_res, ns_res, bTargetAlignedPixels, xmin, ymin, xmax, ymax,
                         bSeparate, bAllowProjectionDifference, bAddAlpha, bHideNoData,
-                        pszSrcNoData, pszVRTNoData);
+                        pszSrcNoData, pszVRTNoData, nNumThreads, bIncremental);
 
     oBuilder.Build(pfnProgress, NULL);
     
@@ -89,16 +89,11 @@
 #include "cpl_string.h"
 #include "gdal.h"
 #include "gdal_priv.h"
+#include "gdal_alg.h"
 #include "commonutils.h"
 
 CPL_CVSID("$Id$");
 
-#ifndef M_PI
-# define M_PI  3.1415926535897932384626433832795
-#endif
-
-#define INTERPOL(a,b) ((bSrcHasNoData && (ARE_REAL_EQUAL(a, fSrcNoDataValue) || ARE_REAL_EQUAL(b, fSrcNoDataValue))) ? fSrcNoDataValue : 2 * (a) - (b))
-
 /************************************************************************/
 /*                               Usage()                                */
 /************************************************************************/
@@ -112,20 +107,20 @@ static void Usage()
             "                 [-z ZFactor (default=1)] [-s scale* (default=1)] \n"
             "                 [-az Azimuth (default=315)] [-alt Altitude (default=45)]\n"
             "                 [-alg ZevenbergenThorne]\n"
-            "                 [-compute_edges] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
+            "                 [-compute_edges] [-num_threads n] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
             "\n"
             " - To generates a slope map from any GDAL-supported elevation raster :\n\n"
             "     gdaldem slope input_dem output_slope_map \n"
             "                 [-p use percent slope (default=degrees)] [-s scale* (default=1)]\n"
             "                 [-alg ZevenbergenThorne]\n"
-            "                 [-compute_edges] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
+            "                 [-compute_edges] [-num_threads n] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
             "\n"
             " - To generate an aspect map from any GDAL-supported elevation raster\n"
             "   Outputs a 32-bit float tiff with pixel values from 0-360 indicating azimuth :\n\n"
             "     gdaldem aspect input_dem output_aspect_map \n"
             "                 [-trigonometric] [-zero_for_flat]\n"
             "                 [-alg ZevenbergenThorne]\n"
-            "                 [-compute_edges] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
+            "                 [-compute_edges] [-num_threads n] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
             "\n"
             " - To generate a color relief map from any GDAL-supported elevation raster\n"
             "     gdaldem color-relief input_dem color_text_file output_color_relief_map\n"
@@ -135,15 +130,15 @@ static void Usage()
             "\n"
             " - To generate a Terrain Ruggedness Index (TRI) map from any GDAL-supported elevation raster\n"
             "     gdaldem TRI input_dem output_TRI_map\n"
-            "                 [-compute_edges] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
+            "                 [-compute_edges] [-num_threads n] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
             "\n"
             " - To generate a Topographic Position Index (TPI) map from any GDAL-supported elevation raster\n"
             "     gdaldem TPI input_dem output_TPI_map\n"
-            "                 [-compute_edges] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
+            "                 [-compute_edges] [-num_threads n] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
             "\n"
             " - To generate a roughness map from any GDAL-supported elevation raster\n"
             "     gdaldem roughness input_dem output_roughness_map\n"
-            "                 [-compute_edges] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
+            "                 [-compute_edges] [-num_threads n] [-b Band (default=1)] [-of format] [-co \"NAME=VALUE\"]* [-q]\n"
             "\n"
             " Notes : \n"
             "   Scale is the ratio of vertical units to horizontal\n"
@@ -151,556 +146,6 @@ static void Usage()
     exit( 1 );
 }
 
-/************************************************************************/
-/*                          ComputeVal()                                */
-/************************************************************************/
-
-typedef float (*GDALGeneric3x3ProcessingAlg) (float* pafWindow, float fDstNoDataValue, void* pData);
-
-static float ComputeVal(int bSrcHasNoData, float fSrcNoDataValue,
-                        float* afWin, float fDstNoDataValue,
-                        GDALGeneric3x3ProcessingAlg pfnAlg,
-                        void* pData,
-                        int bComputeAtEdges)
-{
-    if (bSrcHasNoData && ARE_REAL_EQUAL(afWin[4], fSrcNoDataValue))
-    {
-        return fDstNoDataValue;
-    }
-    else if (bSrcHasNoData)
-    {
-        int k;
-        for(k=0;k<9;k++)
-        {
-            if (ARE_REAL_EQUAL(afWin[k], fSrcNoDataValue))
-            {
-                if (bComputeAtEdges)
-                    afWin[k] = afWin[4];
-                else
-                    return fDstNoDataValue;
-            }
-        }
-    }
-
-    return pfnAlg(afWin, fDstNoDataValue, pData);
-}
-
-/************************************************************************/
-/*                  GDALGeneric3x3Processing()                          */
-/************************************************************************/
-
-CPLErr GDALGeneric3x3Processing  ( GDALRasterBandH hSrcBand,
-                                   GDALRasterBandH hDstBand,
-                                   GDALGeneric3x3ProcessingAlg pfnAlg,
-                                   void* pData,
-                                   int bComputeAtEdges,
-                                   GDALProgressFunc pfnProgress,
-                                   void * pProgressData)
-{
-    CPLErr eErr;
-    float *pafThreeLineWin; /* 3 line rotating source buffer */
-    float *pafOutputBuf;     /* 1 line destination buffer */
-    int i, j;
-
-    int bSrcHasNoData, bDstHasNoData;
-    float fSrcNoDataValue = 0.0, fDstNoDataValue = 0.0;
-
-    int nXSize = GDALGetRasterBandXSize(hSrcBand);
-    int nYSize = GDALGetRasterBandYSize(hSrcBand);
-
-    if (pfnProgress == NULL)
-        pfnProgress = GDALDummyProgress;
-
-/* -------------------------------------------------------------------- */
-/*      Initialize progress counter.                                    */
-/* -------------------------------------------------------------------- */
-    if( !pfnProgress( 0.0, NULL, pProgressData ) )
-    {
-        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-        return CE_Failure;
-    }
-
-    pafOutputBuf = (float *) CPLMalloc(sizeof(float)*nXSize);
-    pafThreeLineWin  = (float *) CPLMalloc(3*sizeof(float)*(nXSize+1));
-
-    fSrcNoDataValue = (float) GDALGetRasterNoDataValue(hSrcBand, &bSrcHasNoData);
-    fDstNoDataValue = (float) GDALGetRasterNoDataValue(hDstBand, &bDstHasNoData);
-    if (!bDstHasNoData)
-        fDstNoDataValue = 0.0;
-
-    // Move a 3x3 pafWindow over each cell 
-    // (where the cell in question is #4)
-    // 
-    //      0 1 2
-    //      3 4 5
-    //      6 7 8
-
-    /* Preload the first 2 lines */
-    for ( i = 0; i < 2 && i < nYSize; i++)
-    {
-        GDALRasterIO(   hSrcBand,
-                        GF_Read,
-                        0, i,
-                        nXSize, 1,
-                        pafThreeLineWin + i * nXSize,
-                        nXSize, 1,
-                        GDT_Float32,
-                        0, 0);
-    }
-    
-    if (bComputeAtEdges && nXSize >= 2 && nYSize >= 2)
-    {
-        for (j = 0; j < nXSize; j++)
-        {
-            float afWin[9];
-            int jmin = (j == 0) ? j : j - 1;
-            int jmax = (j == nXSize - 1) ? j : j + 1;
-
-            afWin[0] = INTERPOL(pafThreeLineWin[jmin], pafThreeLineWin[nXSize + jmin]);
-            afWin[1] = INTERPOL(pafThreeLineWin[j],    pafThreeLineWin[nXSize + j]);
-            afWin[2] = INTERPOL(pafThreeLineWin[jmax], pafThreeLineWin[nXSize + jmax]);
-            afWin[3] = pafThreeLineWin[jmin];
-            afWin[4] = pafThreeLineWin[j];
-            afWin[5] = pafThreeLineWin[jmax];
-            afWin[6] = pafThreeLineWin[nXSize + jmin];
-            afWin[7] = pafThreeLineWin[nXSize + j];
-            afWin[8] = pafThreeLineWin[nXSize + jmax];
-
-            pafOutputBuf[j] = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                         afWin, fDstNoDataValue,
-                                         pfnAlg, pData, bComputeAtEdges);
-        }
-        GDALRasterIO(hDstBand, GF_Write,
-                    0, 0, nXSize, 1,
-                    pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-    }
-    else
-    {
-        // Exclude the edges
-        for (j = 0; j < nXSize; j++)
-        {
-            pafOutputBuf[j] = fDstNoDataValue;
-        }
-        GDALRasterIO(hDstBand, GF_Write,
-                    0, 0, nXSize, 1,
-                    pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-    
-        if (nYSize > 1)
-        {
-            GDALRasterIO(hDstBand, GF_Write,
-                        0, nYSize - 1, nXSize, 1,
-                        pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-        }
-    }
-    
-    int nLine1Off = 0*nXSize;
-    int nLine2Off = 1*nXSize;
-    int nLine3Off = 2*nXSize;
-
-    for ( i = 1; i < nYSize-1; i++)
-    {
-        /* Read third line of the line buffer */
-        eErr = GDALRasterIO(   hSrcBand,
-                        GF_Read,
-                        0, i+1,
-                        nXSize, 1,
-                        pafThreeLineWin + nLine3Off,
-                        nXSize, 1,
-                        GDT_Float32,
-                        0, 0);
-        if (eErr != CE_None)
-            goto end;
-
-        if (bComputeAtEdges && nXSize >= 2)
-        {
-            float afWin[9];
-
-            j = 0;
-            afWin[0] = INTERPOL(pafThreeLineWin[nLine1Off + j], pafThreeLineWin[nLine1Off + j+1]);
-            afWin[1] = pafThreeLineWin[nLine1Off + j];
-            afWin[2] = pafThreeLineWin[nLine1Off + j+1];
-            afWin[3] = INTERPOL(pafThreeLineWin[nLine2Off + j], pafThreeLineWin[nLine2Off + j+1]);
-            afWin[4] = pafThreeLineWin[nLine2Off + j];
-            afWin[5] = pafThreeLineWin[nLine2Off + j+1];
-            afWin[6] = INTERPOL(pafThreeLineWin[nLine3Off + j], pafThreeLineWin[nLine3Off + j+1]);
-            afWin[7] = pafThreeLineWin[nLine3Off + j];
-            afWin[8] = pafThreeLineWin[nLine3Off + j+1];
-
-            pafOutputBuf[j] = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                         afWin, fDstNoDataValue,
-                                         pfnAlg, pData, bComputeAtEdges);
-            j = nXSize - 1;
-
-            afWin[0] = pafThreeLineWin[nLine1Off + j-1];
-            afWin[1] = pafThreeLineWin[nLine1Off + j];
-            afWin[2] = INTERPOL(pafThreeLineWin[nLine1Off + j], pafThreeLineWin[nLine1Off + j-1]);
-            afWin[3] = pafThreeLineWin[nLine2Off + j-1];
-            afWin[4] = pafThreeLineWin[nLine2Off + j];
-            afWin[5] = INTERPOL(pafThreeLineWin[nLine2Off + j], pafThreeLineWin[nLine2Off + j-1]);
-            afWin[6] = pafThreeLineWin[nLine3Off + j-1];
-            afWin[7] = pafThreeLineWin[nLine3Off + j];
-            afWin[8] = INTERPOL(pafThreeLineWin[nLine3Off + j], pafThreeLineWin[nLine3Off + j-1]);
-
-            pafOutputBuf[j] = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                         afWin, fDstNoDataValue,
-                                         pfnAlg, pData, bComputeAtEdges);
-        }
-        else
-        {
-            // Exclude the edges
-            pafOutputBuf[0] = fDstNoDataValue;
-            if (nXSize > 1)
-                pafOutputBuf[nXSize - 1] = fDstNoDataValue;
-        }
-
-        for (j = 1; j < nXSize - 1; j++)
-        {
-            float afWin[9];
-            afWin[0] = pafThreeLineWin[nLine1Off + j-1];
-            afWin[1] = pafThreeLineWin[nLine1Off + j];
-            afWin[2] = pafThreeLineWin[nLine1Off + j+1];
-            afWin[3] = pafThreeLineWin[nLine2Off + j-1];
-            afWin[4] = pafThreeLineWin[nLine2Off + j];
-            afWin[5] = pafThreeLineWin[nLine2Off + j+1];
-            afWin[6] = pafThreeLineWin[nLine3Off + j-1];
-            afWin[7] = pafThreeLineWin[nLine3Off + j];
-            afWin[8] = pafThreeLineWin[nLine3Off + j+1];
-
-            pafOutputBuf[j] = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                         afWin, fDstNoDataValue,
-                                         pfnAlg, pData, bComputeAtEdges);
-        }
-
-        /* -----------------------------------------
-         * Write Line to Raster
-         */
-        eErr = GDALRasterIO(hDstBand, GF_Write, 0, i, nXSize, 1,
-                     pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-        if (eErr != CE_None)
-            goto end;
-
-        if( !pfnProgress( 1.0 * (i+1) / nYSize, NULL, pProgressData ) )
-        {
-            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-            eErr = CE_Failure;
-            goto end;
-        }
-        
-        int nTemp = nLine1Off;
-        nLine1Off = nLine2Off;
-        nLine2Off = nLine3Off;
-        nLine3Off = nTemp;
-    }
-
-    if (bComputeAtEdges && nXSize >= 2 && nYSize >= 2)
-    {
-        for (j = 0; j < nXSize; j++)
-        {
-            float afWin[9];
-            int jmin = (j == 0) ? j : j - 1;
-            int jmax = (j == nXSize - 1) ? j : j + 1;
-
-            afWin[0] = pafThreeLineWin[nLine1Off + jmin];
-            afWin[1] = pafThreeLineWin[nLine1Off + j];
-            afWin[2] = pafThreeLineWin[nLine1Off + jmax];
-            afWin[3] = pafThreeLineWin[nLine2Off + jmin];
-            afWin[4] = pafThreeLineWin[nLine2Off + j];
-            afWin[5] = pafThreeLineWin[nLine2Off + jmax];
-            afWin[6] = INTERPOL(pafThreeLineWin[nLine2Off + jmin], pafThreeLineWin[nLine1Off + jmin]);
-            afWin[7] = INTERPOL(pafThreeLineWin[nLine2Off + j],    pafThreeLineWin[nLine1Off + j]);
-            afWin[8] = INTERPOL(pafThreeLineWin[nLine2Off + jmax], pafThreeLineWin[nLine1Off + jmax]);
-
-            pafOutputBuf[j] = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                         afWin, fDstNoDataValue,
-                                         pfnAlg, pData, bComputeAtEdges);
-        }
-        GDALRasterIO(hDstBand, GF_Write,
-                     0, i, nXSize, 1,
-                     pafOutputBuf, nXSize, 1, GDT_Float32, 0, 0);
-    }
-
-    pfnProgress( 1.0, NULL, pProgressData );
-    eErr = CE_None;
-
-end:
-    CPLFree(pafOutputBuf);
-    CPLFree(pafThreeLineWin);
-
-    return eErr;
-}
-
-
-/************************************************************************/
-/*                         GDALHillshade()                              */
-/************************************************************************/
-
-typedef struct
-{
-    double nsres;
-    double ewres;
-    double sin_altRadians;
-    double cos_altRadians_mul_z_scale_factor;
-    double azRadians;
-    double square_z_scale_factor;
-} GDALHillshadeAlgData;
-
-/* Unoptimized formulas are :
-    x = psData->z*((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
-        (afWin[2] + afWin[5] + afWin[5] + afWin[8])) /
-        (8.0 * psData->ewres * psData->scale);
-
-    y = psData->z*((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
-        (afWin[0] + afWin[1] + afWin[1] + afWin[2])) /
-        (8.0 * psData->nsres * psData->scale);
-
-    slope = M_PI / 2 - atan(sqrt(x*x + y*y));
-
-    aspect = atan2(y,x);
-
-    cang = sin(alt * degreesToRadians) * sin(slope) +
-           cos(alt * degreesToRadians) * cos(slope) *
-           cos(az * degreesToRadians - M_PI/2 - aspect);
-*/
-
-float GDALHillshadeAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    GDALHillshadeAlgData* psData = (GDALHillshadeAlgData*)pData;
-    double x, y, aspect, xx_plus_yy, cang;
-    
-    // First Slope ...
-    x = ((afWin[0] + afWin[3] + afWin[3] + afWin[6]) -
-        (afWin[2] + afWin[5] + afWin[5] + afWin[8])) / psData->ewres;
-
-    y = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) -
-        (afWin[0] + afWin[1] + afWin[1] + afWin[2])) / psData->nsres;
-
-    xx_plus_yy = x * x + y * y;
-
-    // ... then aspect...
-    aspect = atan2(y,x);
-
-    // ... then the shade value
-    cang = (psData->sin_altRadians -
-           psData->cos_altRadians_mul_z_scale_factor * sqrt(xx_plus_yy) *
-           sin(aspect - psData->azRadians)) /
-           sqrt(1 + psData->square_z_scale_factor * xx_plus_yy);
-
-    if (cang <= 0.0) 
-        cang = 1.0;
-    else
-        cang = 1.0 + (254.0 * cang);
-        
-    return (float) cang;
-}
-
-float GDALHillshadeZevenbergenThorneAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    GDALHillshadeAlgData* psData = (GDALHillshadeAlgData*)pData;
-    double x, y, aspect, xx_plus_yy, cang;
-    
-    // First Slope ...
-    x = (afWin[3] - afWin[5]) / psData->ewres;
-
-    y = (afWin[7] - afWin[1]) / psData->nsres;
-
-    xx_plus_yy = x * x + y * y;
-
-    // ... then aspect...
-    aspect = atan2(y,x);
-
-    // ... then the shade value
-    cang = (psData->sin_altRadians -
-           psData->cos_altRadians_mul_z_scale_factor * sqrt(xx_plus_yy) *
-           sin(aspect - psData->azRadians)) /
-           sqrt(1 + psData->square_z_scale_factor * xx_plus_yy);
-
-    if (cang <= 0.0) 
-        cang = 1.0;
-    else
-        cang = 1.0 + (254.0 * cang);
-        
-    return (float) cang;
-}
-
-void*  GDALCreateHillshadeData(double* adfGeoTransform,
-                               double z,
-                               double scale,
-                               double alt,
-                               double az,
-                               int bZevenbergenThorne)
-{
-    GDALHillshadeAlgData* pData =
-        (GDALHillshadeAlgData*)CPLMalloc(sizeof(GDALHillshadeAlgData));
-        
-    const double degreesToRadians = M_PI / 180.0;
-    pData->nsres = adfGeoTransform[5];
-    pData->ewres = adfGeoTransform[1];
-    pData->sin_altRadians = sin(alt * degreesToRadians);
-    pData->azRadians = az * degreesToRadians;
-    double z_scale_factor = z / (((bZevenbergenThorne) ? 2 : 8) * scale);
-    pData->cos_altRadians_mul_z_scale_factor =
-        cos(alt * degreesToRadians) * z_scale_factor;
-    pData->square_z_scale_factor = z_scale_factor * z_scale_factor;
-    return pData;
-}
-
-/************************************************************************/
-/*                         GDALSlope()                                  */
-/************************************************************************/
-
-typedef struct
-{
-    double nsres;
-    double ewres;
-    double scale;
-    int    slopeFormat;
-} GDALSlopeAlgData;
-
-float GDALSlopeHornAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    const double radiansToDegrees = 180.0 / M_PI;
-    GDALSlopeAlgData* psData = (GDALSlopeAlgData*)pData;
-    double dx, dy, key;
-    
-    dx = ((afWin[0] + afWin[3] + afWin[3] + afWin[6]) - 
-          (afWin[2] + afWin[5] + afWin[5] + afWin[8]))/psData->ewres;
-
-    dy = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) - 
-          (afWin[0] + afWin[1] + afWin[1] + afWin[2]))/psData->nsres;
-
-    key = (dx * dx + dy * dy);
-
-    if (psData->slopeFormat == 1) 
-        return (float) (atan(sqrt(key) / (8*psData->scale)) * radiansToDegrees);
-    else
-        return (float) (100*(sqrt(key) / (8*psData->scale)));
-}
-
-float GDALSlopeZevenbergenThorneAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    const double radiansToDegrees = 180.0 / M_PI;
-    GDALSlopeAlgData* psData = (GDALSlopeAlgData*)pData;
-    double dx, dy, key;
-    
-    dx = (afWin[3] - afWin[5])/psData->ewres;
-
-    dy = (afWin[7] - afWin[1])/psData->nsres;
-
-    key = (dx * dx + dy * dy);
-
-    if (psData->slopeFormat == 1) 
-        return (float) (atan(sqrt(key) / (2*psData->scale)) * radiansToDegrees);
-    else
-        return (float) (100*(sqrt(key) / (2*psData->scale)));
-}
-
-void*  GDALCreateSlopeData(double* adfGeoTransform,
-                           double scale,
-                           int slopeFormat)
-{
-    GDALSlopeAlgData* pData =
-        (GDALSlopeAlgData*)CPLMalloc(sizeof(GDALSlopeAlgData));
-        
-    pData->nsres = adfGeoTransform[5];
-    pData->ewres = adfGeoTransform[1];
-    pData->scale = scale;
-    pData->slopeFormat = slopeFormat;
-    return pData;
-}
-
-/************************************************************************/
-/*                         GDALAspect()                                 */
-/************************************************************************/
-
-typedef struct
-{
-    int bAngleAsAzimuth;
-} GDALAspectAlgData;
-
-float GDALAspectAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    const double degreesToRadians = M_PI / 180.0;
-    GDALAspectAlgData* psData = (GDALAspectAlgData*)pData;
-    double dx, dy;
-    float aspect;
-    
-    dx = ((afWin[2] + afWin[5] + afWin[5] + afWin[8]) -
-          (afWin[0] + afWin[3] + afWin[3] + afWin[6]));
-
-    dy = ((afWin[6] + afWin[7] + afWin[7] + afWin[8]) - 
-          (afWin[0] + afWin[1] + afWin[1] + afWin[2]));
-
-    aspect = (float) (atan2(dy,-dx) / degreesToRadians);
-
-    if (dx == 0 && dy == 0)
-    {
-        /* Flat area */
-        aspect = fDstNoDataValue;
-    } 
-    else if ( psData->bAngleAsAzimuth )
-    {
-        if (aspect > 90.0) 
-            aspect = 450.0f - aspect;
-        else
-            aspect = 90.0f - aspect;
-    }
-    else
-    {
-        if (aspect < 0)
-            aspect += 360.0;
-    }
-
-    if (aspect == 360.0) 
-        aspect = 0.0;
-
-    return aspect;
-}
-
-float GDALAspectZevenbergenThorneAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    const double degreesToRadians = M_PI / 180.0;
-    GDALAspectAlgData* psData = (GDALAspectAlgData*)pData;
-    double dx, dy;
-    float aspect;
-    
-    dx = (afWin[5] - afWin[3]);
-
-    dy = (afWin[7] - afWin[1]);
-
-    aspect = (float) (atan2(dy,-dx) / degreesToRadians);
-
-    if (dx == 0 && dy == 0)
-    {
-        /* Flat area */
-        aspect = fDstNoDataValue;
-    } 
-    else if ( psData->bAngleAsAzimuth )
-    {
-        if (aspect > 90.0) 
-            aspect = 450.0f - aspect;
-        else
-            aspect = 90.0f - aspect;
-    }
-    else
-    {
-        if (aspect < 0)
-            aspect += 360.0;
-    }
-
-    if (aspect == 360.0) 
-        aspect = 0.0;
-
-    return aspect;
-}
-void*  GDALCreateAspectData(int bAngleAsAzimuth)
-{
-    GDALAspectAlgData* pData =
-        (GDALAspectAlgData*)CPLMalloc(sizeof(GDALAspectAlgData));
-        
-    pData->bAngleAsAzimuth = bAngleAsAzimuth;
-    return pData;
-}
-
 /************************************************************************/
 /*                      GDALColorRelief()                               */
 /************************************************************************/
@@ -1081,43 +526,328 @@ ColorAssociation* GDALColorReliefParseColorFile(GDALRasterBandH hSrcBand,
     return pasColorAssociation;
 }
 
+/************************************************************************/
+/*                         ColorReliefLUT                               */
+/*                                                                      */
+/*      Lookup tables turning the source values into RGBA quadruplets,  */
+/*      so that the per-pixel cost is a table access instead of a       */
+/*      binary search in the color associations.                        */
+/*                                                                      */
+/*      Integer sources are read as Int32 and indexed directly : the    */
+/*      table covers the values from nMinValue to nMaxValue, which      */
+/*      extend at least one past the first and last color entries, so   */
+/*      that any value out of that range has the color of the nearest   */
+/*      bound.                                                          */
+/*                                                                      */
+/*      Other sources are read as Float32 and looked up in buckets      */
+/*      evenly spaced between the first and last color entries, their   */
+/*      number growing with the raster size up to                       */
+/*      COLOR_RELIEF_MAX_FLOAT_BUCKETS. A bucket holds the color of all */
+/*      its values, unless that color varies within the bucket, in      */
+/*      which case the value is computed exactly. The result is thus    */
+/*      identical to GDALColorReliefGetRGBA() for all values.           */
+/************************************************************************/
+
+#define COLOR_RELIEF_MIN_FLOAT_BUCKETS 65536
+#define COLOR_RELIEF_MAX_FLOAT_BUCKETS (1024 * 1024)
+#define COLOR_RELIEF_MAX_INT_ENTRIES  (16 * 1024 * 1024)
+
+typedef struct
+{
+    ColorAssociation*  pasColorAssociation;
+    int                nColorAssociation;
+    ColorSelectionMode eColorSelectionMode;
+
+    /* Integer sources */
+    GByte*             pabyPrecomputed;
+    int                nMinValue;
+    int                nMaxValue;
+
+    /* Floating point sources : index 0 is for the values below */
+    /* dfMinValue, 1 to nBuckets for the buckets, nBuckets + 1 for the */
+    /* values above dfMaxValue. */
+    GByte*             pabyBucketRGBA;
+    GByte*             pabyBucketVaries;
+    int                nBuckets;
+    double             dfMinValue;
+    double             dfMaxValue;
+    double             dfBucketScale;
+} ColorReliefLUT;
+
+/************************************************************************/
+/*                     GDALColorReliefIsSameRGBA()                      */
+/************************************************************************/
+
+static int GDALColorReliefIsSameRGBA(ColorReliefLUT* psLUT,
+                                     double dfVal, const GByte* pabyRGBA)
+{
+    int nR, nG, nB, nA;
+    GDALColorReliefGetRGBA  (psLUT->pasColorAssociation,
+                             psLUT->nColorAssociation,
+                             dfVal,
+                             psLUT->eColorSelectionMode,
+                             &nR, &nG, &nB, &nA);
+    return (GByte) nR == pabyRGBA[0] && (GByte) nG == pabyRGBA[1] &&
+           (GByte) nB == pabyRGBA[2] && (GByte) nA == pabyRGBA[3];
+}
+
+/************************************************************************/
+/*                       GDALColorReliefSetRGBA()                       */
+/************************************************************************/
+
+static void GDALColorReliefSetRGBA(ColorReliefLUT* psLUT,
+                                   double dfVal, GByte* pabyRGBA)
+{
+    int nR, nG, nB, nA;
+    GDALColorReliefGetRGBA  (psLUT->pasColorAssociation,
+                             psLUT->nColorAssociation,
+                             dfVal,
+                             psLUT->eColorSelectionMode,
+                             &nR, &nG, &nB, &nA);
+    pabyRGBA[0] = (GByte) nR;
+    pabyRGBA[1] = (GByte) nG;
+    pabyRGBA[2] = (GByte) nB;
+    pabyRGBA[3] = (GByte) nA;
+}
+
+/************************************************************************/
+/*                      GDALColorReliefPrecompute()                     */
+/************************************************************************/
+
 static
-GByte* GDALColorReliefPrecompute(GDALRasterBandH hSrcBand,
-                                 ColorAssociation* pasColorAssociation,
-                                 int nColorAssociation,
-                                 ColorSelectionMode eColorSelectionMode,
-                                 int* pnIndexOffset)
+void GDALColorReliefPrecompute(GDALRasterBandH hSrcBand,
+                               ColorReliefLUT* psLUT)
 {
     GDALDataType eDT = GDALGetRasterDataType(hSrcBand);
-    GByte* pabyPrecomputed = NULL;
-    int nIndexOffset = (eDT == GDT_Int16) ? 32768 : 0;
-    *pnIndexOffset = nIndexOffset;
     int nXSize = GDALGetRasterBandXSize(hSrcBand);
-    int nYSize = GDALGetRasterBandXSize(hSrcBand);
-    if (eDT == GDT_Byte ||
-        ((eDT == GDT_Int16 || eDT == GDT_UInt16) && nXSize * nYSize > 65536))
+    int nYSize = GDALGetRasterBandYSize(hSrcBand);
+    double dfPixels = (double)nXSize * nYSize;
+    ColorAssociation* pasColorAssociation = psLUT->pasColorAssociation;
+    int nColorAssociation = psLUT->nColorAssociation;
+
+    psLUT->pabyPrecomputed = NULL;
+    psLUT->pabyBucketRGBA = NULL;
+    psLUT->pabyBucketVaries = NULL;
+    psLUT->nBuckets = 0;
+
+    if (nColorAssociation == 0)
+        return;
+
+    double dfFirst = pasColorAssociation[0].dfVal;
+    double dfLast = pasColorAssociation[nColorAssociation - 1].dfVal;
+    if (CPLIsNan(dfFirst) || CPLIsNan(dfLast))
+        return;
+
+/* -------------------------------------------------------------------- */
+/*      Integer types : direct table from one before the first entry    */
+/*      to one after the last entry, clamped to the range of the type   */
+/*      as read into an Int32 buffer.                                   */
+/* -------------------------------------------------------------------- */
+    double dfTypeMin = 0, dfTypeMax = -1;
+    switch (eDT)
+    {
+        case GDT_Byte:   dfTypeMin = 0;          dfTypeMax = 255; break;
+        case GDT_UInt16: dfTypeMin = 0;          dfTypeMax = 65535; break;
+        case GDT_Int16:  dfTypeMin = -32768;     dfTypeMax = 32767; break;
+        case GDT_UInt32: dfTypeMin = 0;          dfTypeMax = INT_MAX; break;
+        case GDT_Int32:  dfTypeMin = INT_MIN;    dfTypeMax = INT_MAX; break;
+        default: break;
+    }
+
+    if (dfTypeMax >= dfTypeMin)
     {
-        int iMax = (eDT == GDT_Byte) ? 256: 65536;
-        pabyPrecomputed = (GByte*) VSIMalloc(4 * iMax);
-        if (pabyPrecomputed)
+        double dfMin = MAX(dfTypeMin, floor(dfFirst) - 1);
+        double dfMax = MIN(dfTypeMax, ceil(dfLast) + 1);
+        if (dfMax < dfMin)
+            dfMax = dfMin = (dfLast < dfTypeMin) ? dfTypeMin : dfTypeMax;
+        double dfEntries = dfMax - dfMin + 1;
+
+        if (dfEntries <= 65536 ||
+            (dfEntries <= COLOR_RELIEF_MAX_INT_ENTRIES && dfEntries <= dfPixels))
         {
-            int i;
-            for(i=0;i<iMax;i++)
+            int nEntries = (int) dfEntries;
+            psLUT->pabyPrecomputed = (GByte*) VSIMalloc2(4, nEntries);
+            if (psLUT->pabyPrecomputed)
             {
-                int nR, nG, nB, nA;
-                GDALColorReliefGetRGBA  (pasColorAssociation,
-                                         nColorAssociation,
-                                         i - nIndexOffset,
-                                         eColorSelectionMode,
-                                         &nR, &nG, &nB, &nA);
-                pabyPrecomputed[4 * i] = (GByte) nR;
-                pabyPrecomputed[4 * i + 1] = (GByte) nG;
-                pabyPrecomputed[4 * i + 2] = (GByte) nB;
-                pabyPrecomputed[4 * i + 3] = (GByte) nA;
+                psLUT->nMinValue = (int) dfMin;
+                psLUT->nMaxValue = (int) dfMax;
+                for (int i = 0; i < nEntries; i++)
+                {
+                    GDALColorReliefSetRGBA(psLUT, dfMin + i,
+                                           psLUT->pabyPrecomputed + 4 * i);
+                }
+                return;
             }
         }
     }
-    return pabyPrecomputed;
+
+/* -------------------------------------------------------------------- */
+/*      Otherwise bucket the range of the color entries, for rasters    */
+/*      large enough to amortize the table.                             */
+/* -------------------------------------------------------------------- */
+    if (!CPLIsFinite(dfFirst) || !CPLIsFinite(dfLast) ||
+        dfPixels <= COLOR_RELIEF_MIN_FLOAT_BUCKETS)
+        return;
+
+    /* About one bucket per 16 pixels */
+    int nBuckets = COLOR_RELIEF_MIN_FLOAT_BUCKETS;
+    while (nBuckets < COLOR_RELIEF_MAX_FLOAT_BUCKETS &&
+           nBuckets * 32.0 <= dfPixels)
+        nBuckets *= 2;
+    if (!(dfLast > dfFirst))
+        nBuckets = 0;
+    double dfStep = (nBuckets) ? (dfLast - dfFirst) / nBuckets : 0;
+    if (nBuckets && !CPLIsFinite(dfStep))
+        return;
+
+    psLUT->pabyBucketRGBA = (GByte*) VSIMalloc2(4, nBuckets + 2);
+    psLUT->pabyBucketVaries = (GByte*) VSIMalloc(nBuckets + 2);
+    if (psLUT->pabyBucketRGBA == NULL || psLUT->pabyBucketVaries == NULL)
+    {
+        VSIFree(psLUT->pabyBucketRGBA);
+        VSIFree(psLUT->pabyBucketVaries);
+        psLUT->pabyBucketRGBA = NULL;
+        psLUT->pabyBucketVaries = NULL;
+        return;
+    }
+    psLUT->nBuckets = nBuckets;
+    psLUT->dfMinValue = dfFirst;
+    psLUT->dfMaxValue = dfLast;
+    psLUT->dfBucketScale = (nBuckets) ? 1.0 / dfStep : 0;
+
+    /* Values strictly outside the color entries */
+    int bExact = (psLUT->eColorSelectionMode == COLOR_SELECTION_EXACT_ENTRY);
+    const ColorAssociation* psFirst = &pasColorAssociation[0];
+    const ColorAssociation* psLast = &pasColorAssociation[nColorAssociation-1];
+    GByte* pabyBelow = psLUT->pabyBucketRGBA;
+    GByte* pabyAbove = psLUT->pabyBucketRGBA + 4 * (nBuckets + 1);
+    pabyBelow[0] = (GByte) ((bExact) ? 0 : psFirst->nR);
+    pabyBelow[1] = (GByte) ((bExact) ? 0 : psFirst->nG);
+    pabyBelow[2] = (GByte) ((bExact) ? 0 : psFirst->nB);
+    pabyBelow[3] = (GByte) ((bExact) ? 0 : psFirst->nA);
+    pabyAbove[0] = (GByte) ((bExact) ? 0 : psLast->nR);
+    pabyAbove[1] = (GByte) ((bExact) ? 0 : psLast->nG);
+    pabyAbove[2] = (GByte) ((bExact) ? 0 : psLast->nB);
+    pabyAbove[3] = (GByte) ((bExact) ? 0 : psLast->nA);
+    psLUT->pabyBucketVaries[0] = FALSE;
+    psLUT->pabyBucketVaries[nBuckets + 1] = FALSE;
+
+    /* The color is monotonic between two successive entries, so a */
+    /* bucket containing no entry has a constant color if it has the */
+    /* same one at both ends. The ends are widened by a small margin */
+    /* to cover the rounding of the bucket index computation. */
+    double dfMargin = dfStep * 1e-3;
+    int iEntry = 0;
+    for (int i = 0; i < nBuckets; i++)
+    {
+        double dfStart = dfFirst + i * dfStep - dfMargin;
+        double dfEnd = dfFirst + (i + 1) * dfStep + dfMargin;
+        GByte* pabyRGBA = psLUT->pabyBucketRGBA + 4 * (i + 1);
+
+        while (iEntry < nColorAssociation &&
+               pasColorAssociation[iEntry].dfVal < dfStart)
+            iEntry++;
+
+        GDALColorReliefSetRGBA(psLUT, dfStart, pabyRGBA);
+        psLUT->pabyBucketVaries[i + 1] = (GByte)
+            ((iEntry < nColorAssociation &&
+              pasColorAssociation[iEntry].dfVal <= dfEnd) ||
+             !GDALColorReliefIsSameRGBA(psLUT, dfEnd, pabyRGBA));
+    }
+}
+
+/************************************************************************/
+/*                      GDALColorReliefTranslate()                      */
+/*                                                                      */
+/*      Write nComponents components of the colors of nCount source     */
+/*      values, starting at component nFirstComponent, the components   */
+/*      being nComponentSpace bytes apart in pabyDst.                   */
+/************************************************************************/
+
+static void GDALColorReliefTranslate(ColorReliefLUT* psLUT,
+                                     const int* panSrc,
+                                     const float* pafSrc,
+                                     int nCount,
+                                     int nFirstComponent,
+                                     int nComponents,
+                                     GByte* pabyDst,
+                                     int nComponentSpace)
+{
+    int j, k;
+
+    if (psLUT->nColorAssociation == 0)
+    {
+        for (k = 0; k < nComponents; k++)
+            memset(pabyDst + k * nComponentSpace, 0, nCount);
+        return;
+    }
+
+    if (psLUT->pabyPrecomputed)
+    {
+        const int nMinValue = psLUT->nMinValue;
+        const int nMaxValue = psLUT->nMaxValue;
+        const GByte* pabyLUT = psLUT->pabyPrecomputed + nFirstComponent;
+        for (j = 0; j < nCount; j++)
+        {
+            int nVal = panSrc[j];
+            if (nVal < nMinValue)
+                nVal = nMinValue;
+            else if (nVal > nMaxValue)
+                nVal = nMaxValue;
+            const GByte* pabyRGBA = pabyLUT + 4 * (nVal - nMinValue);
+            for (k = 0; k < nComponents; k++)
+                pabyDst[k * nComponentSpace + j] = pabyRGBA[k];
+        }
+        return;
+    }
+
+    GByte abyRGBA[4];
+    for (j = 0; j < nCount; j++)
+    {
+        const double dfVal = pafSrc[j];
+        const GByte* pabyRGBA = abyRGBA;
+
+        if (psLUT->pabyBucketRGBA)
+        {
+            int nIndex = -1;
+            if (dfVal < psLUT->dfMinValue)
+                nIndex = 0;
+            else if (dfVal > psLUT->dfMaxValue)
+                nIndex = psLUT->nBuckets + 1;
+            else if (psLUT->nBuckets && !CPLIsNan(dfVal))
+            {
+                nIndex = (int)((dfVal - psLUT->dfMinValue) *
+                               psLUT->dfBucketScale);
+                nIndex = 1 + MIN(nIndex, psLUT->nBuckets - 1);
+            }
+            if (nIndex >= 0 && !psLUT->pabyBucketVaries[nIndex])
+                pabyRGBA = psLUT->pabyBucketRGBA + 4 * nIndex;
+            else
+                GDALColorReliefSetRGBA(psLUT, dfVal, abyRGBA);
+        }
+        else
+            GDALColorReliefSetRGBA(psLUT, dfVal, abyRGBA);
+
+        for (k = 0; k < nComponents; k++)
+            pabyDst[k * nComponentSpace + j] = pabyRGBA[nFirstComponent + k];
+    }
+}
+
+/************************************************************************/
+/*                        GDALColorReliefFreeLUT()                      */
+/************************************************************************/
+
+static void GDALColorReliefFreeLUT(ColorReliefLUT* psLUT)
+{
+    CPLFree(psLUT->pasColorAssociation);
+    VSIFree(psLUT->pabyPrecomputed);
+    VSIFree(psLUT->pabyBucketRGBA);
+    VSIFree(psLUT->pabyBucketVaries);
+    psLUT->pasColorAssociation = NULL;
+    psLUT->nColorAssociation = 0;
+    psLUT->pabyPrecomputed = NULL;
+    psLUT->pabyBucketRGBA = NULL;
+    psLUT->pabyBucketVaries = NULL;
 }
 
 /************************************************************************/
@@ -1134,11 +864,7 @@ class GDALColorReliefDataset : public GDALDataset
 
     GDALDatasetH       hSrcDS;
     GDALRasterBandH    hSrcBand;
-    int                nColorAssociation;
-    ColorAssociation*  pasColorAssociation;
-    ColorSelectionMode eColorSelectionMode;
-    GByte*             pabyPrecomputed;
-    int                nIndexOffset;
+    ColorReliefLUT     sLUT;
     float*             pafSourceBuf;
     int*               panSourceBuf;
     int                nCurBlockXOff;
@@ -1183,11 +909,11 @@ GDALColorReliefDataset::GDALColorReliefDataset(
 {
     this->hSrcDS = hSrcDS;
     this->hSrcBand = hSrcBand;
-    nColorAssociation = 0;
-    pasColorAssociation =
+    sLUT.nColorAssociation = 0;
+    sLUT.pasColorAssociation =
             GDALColorReliefParseColorFile(hSrcBand, pszColorFilename,
-                                          &nColorAssociation);
-    this->eColorSelectionMode = eColorSelectionMode;
+                                          &sLUT.nColorAssociation);
+    sLUT.eColorSelectionMode = eColorSelectionMode;
     
     nRasterXSize = GDALGetRasterXSize(hSrcDS);
     nRasterYSize = GDALGetRasterYSize(hSrcDS);
@@ -1195,13 +921,7 @@ GDALColorReliefDataset::GDALColorReliefDataset(
     int nBlockXSize, nBlockYSize;
     GDALGetBlockSize( hSrcBand, &nBlockXSize, &nBlockYSize);
     
-    nIndexOffset = 0;
-    pabyPrecomputed =
-        GDALColorReliefPrecompute(hSrcBand,
-                                  pasColorAssociation,
-                                  nColorAssociation,
-                                  eColorSelectionMode,
-                                  &nIndexOffset);
+    GDALColorReliefPrecompute(hSrcBand, &sLUT);
     
     int i;
     for(i=0;i<((bAlpha) ? 4 : 3);i++)
@@ -1211,7 +931,7 @@ GDALColorReliefDataset::GDALColorReliefDataset(
     
     pafSourceBuf = NULL;
     panSourceBuf = NULL;
-    if (pabyPrecomputed)
+    if (sLUT.pabyPrecomputed)
         panSourceBuf = (int *) CPLMalloc(sizeof(int)*nBlockXSize*nBlockYSize);
     else
         pafSourceBuf = (float *) CPLMalloc(sizeof(float)*nBlockXSize*nBlockYSize);
@@ -1221,8 +941,7 @@ GDALColorReliefDataset::GDALColorReliefDataset(
 
 GDALColorReliefDataset::~GDALColorReliefDataset()
 {
-    CPLFree(pasColorAssociation);
-    CPLFree(pabyPrecomputed);
+    GDALColorReliefFreeLUT(&sLUT);
     CPLFree(panSourceBuf);
     CPLFree(pafSourceBuf);
 }
@@ -1288,31 +1007,9 @@ CPLErr GDALColorReliefRasterBand::IReadBlock( int nBlockXOff,
         }
     }
 
-    int j;
-    if (poGDS->panSourceBuf)
-    {
-        for ( j = 0; j < nCount; j++)
-        {
-            int nIndex = poGDS->panSourceBuf[j] + poGDS->nIndexOffset;
-            ((GByte*)pImage)[j] = poGDS->pabyPrecomputed[4*nIndex + nBand-1];
-        }
-    }
-    else
-    {
-        int anComponents[4];
-        for ( j = 0; j < nCount; j++)
-        {
-            GDALColorReliefGetRGBA  (poGDS->pasColorAssociation,
-                                     poGDS->nColorAssociation,
-                                     poGDS->pafSourceBuf[j],
-                                     poGDS->eColorSelectionMode,
-                                     &anComponents[0],
-                                     &anComponents[1],
-                                     &anComponents[2],
-                                     &anComponents[3]);
-            ((GByte*)pImage)[j] = (GByte) anComponents[nBand-1];
-        }
-    }
+    GDALColorReliefTranslate(&poGDS->sLUT,
+                             poGDS->panSourceBuf, poGDS->pafSourceBuf,
+                             nCount, nBand - 1, 1, (GByte*) pImage, 0);
     
     return CE_None;
 }
@@ -1339,12 +1036,14 @@ CPLErr GDALColorRelief (GDALRasterBandH hSrcBand,
         hDstBand3 == NULL)
         return CE_Failure;
 
-    int nColorAssociation = 0;
-    ColorAssociation* pasColorAssociation =
+    ColorReliefLUT sLUT;
+    sLUT.nColorAssociation = 0;
+    sLUT.pasColorAssociation =
             GDALColorReliefParseColorFile(hSrcBand, pszColorFilename,
-                                          &nColorAssociation);
-    if (pasColorAssociation == NULL)
+                                          &sLUT.nColorAssociation);
+    if (sLUT.pasColorAssociation == NULL)
         return CE_Failure;
+    sLUT.eColorSelectionMode = eColorSelectionMode;
 
     int nXSize = GDALGetRasterBandXSize(hSrcBand);
     int nYSize = GDALGetRasterBandYSize(hSrcBand);
@@ -1352,19 +1051,11 @@ CPLErr GDALColorRelief (GDALRasterBandH hSrcBand,
     if (pfnProgress == NULL)
         pfnProgress = GDALDummyProgress;
         
-    int nR = 0, nG = 0, nB = 0, nA = 0;
-    
 /* -------------------------------------------------------------------- */
-/*      Precompute the map from values to RGBA quadruplets              */
-/*      for GDT_Byte, GDT_Int16 or GDT_UInt16                           */
+/*      Precompute the map from values to RGBA quadruplets : a direct   */
+/*      table for integer types, buckets for the other ones.            */
 /* -------------------------------------------------------------------- */
-    int nIndexOffset = 0;
-    GByte* pabyPrecomputed =
-        GDALColorReliefPrecompute(hSrcBand,
-                                  pasColorAssociation,
-                                  nColorAssociation,
-                                  eColorSelectionMode,
-                                  &nIndexOffset);
+    GDALColorReliefPrecompute(hSrcBand, &sLUT);
 
 /* -------------------------------------------------------------------- */
 /*      Initialize progress counter.                                    */
@@ -1372,7 +1063,7 @@ CPLErr GDALColorRelief (GDALRasterBandH hSrcBand,
 
     float* pafSourceBuf = NULL;
     int* panSourceBuf = NULL;
-    if (pabyPrecomputed)
+    if (sLUT.pabyPrecomputed)
         panSourceBuf = (int *) CPLMalloc(sizeof(int)*nXSize);
     else
         pafSourceBuf = (float *) CPLMalloc(sizeof(float)*nXSize);
@@ -1380,7 +1071,7 @@ CPLErr GDALColorRelief (GDALRasterBandH hSrcBand,
     GByte* pabyDestBuf2  =  pabyDestBuf1 + nXSize;
     GByte* pabyDestBuf3  =  pabyDestBuf2 + nXSize;
     GByte* pabyDestBuf4  =  pabyDestBuf3 + nXSize;
-    int i, j;
+    int i;
 
     if( !pfnProgress( 0.0, NULL, pProgressData ) )
     {
@@ -1403,35 +1094,8 @@ CPLErr GDALColorRelief (GDALRasterBandH hSrcBand,
         if (eErr != CE_None)
             goto end;
 
-        if (panSourceBuf)
-        {
-            for ( j = 0; j < nXSize; j++)
-            {
-                int nIndex = panSourceBuf[j] + nIndexOffset;
-                pabyDestBuf1[j] = pabyPrecomputed[4 * nIndex];
-                pabyDestBuf2[j] = pabyPrecomputed[4 * nIndex + 1];
-                pabyDestBuf3[j] = pabyPrecomputed[4 * nIndex + 2];
-                pabyDestBuf4[j] = pabyPrecomputed[4 * nIndex + 3];
-            }
-        }
-        else
-        {
-            for ( j = 0; j < nXSize; j++)
-            {
-                GDALColorReliefGetRGBA  (pasColorAssociation,
-                                         nColorAssociation,
-                                         pafSourceBuf[j],
-                                         eColorSelectionMode,
-                                         &nR,
-                                         &nG,
-                                         &nB,
-                                         &nA);
-                pabyDestBuf1[j] = (GByte) nR;
-                pabyDestBuf2[j] = (GByte) nG;
-                pabyDestBuf3[j] = (GByte) nB;
-                pabyDestBuf4[j] = (GByte) nA;
-            }
-        }
+        GDALColorReliefTranslate(&sLUT, panSourceBuf, pafSourceBuf,
+                                 nXSize, 0, 4, pabyDestBuf1, nXSize);
         
         /* -----------------------------------------
          * Write Line to Raster
@@ -1478,11 +1142,10 @@ CPLErr GDALColorRelief (GDALRasterBandH hSrcBand,
     eErr = CE_None;
 
 end:
-    VSIFree(pabyPrecomputed);
+    GDALColorReliefFreeLUT(&sLUT);
     CPLFree(pafSourceBuf);
     CPLFree(panSourceBuf);
     CPLFree(pabyDestBuf1);
-    CPLFree(pasColorAssociation);
 
     return eErr;
 }
@@ -1636,100 +1299,34 @@ CPLErr GDALGenerateVRTColorRelief(const char* pszDstFilename,
 }
 
 
-/************************************************************************/
-/*                         GDALTRIAlg()                                 */
-/************************************************************************/
-
-float GDALTRIAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    // Terrain Ruggedness is average difference in height
-    return (fabs(afWin[0]-afWin[4]) +
-            fabs(afWin[1]-afWin[4]) +
-            fabs(afWin[2]-afWin[4]) +
-            fabs(afWin[3]-afWin[4]) +
-            fabs(afWin[5]-afWin[4]) +
-            fabs(afWin[6]-afWin[4]) +
-            fabs(afWin[7]-afWin[4]) +
-            fabs(afWin[8]-afWin[4]))/8;
-}
-
-
-/************************************************************************/
-/*                         GDALTPIAlg()                                 */
-/************************************************************************/
-
-float GDALTPIAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    // Terrain Position is the difference between
-    // The central cell and the mean of the surrounding cells
-    return afWin[4] - 
-            ((afWin[0]+
-              afWin[1]+
-              afWin[2]+
-              afWin[3]+
-              afWin[5]+
-              afWin[6]+
-              afWin[7]+
-              afWin[8])/8);
-}
-
-/************************************************************************/
-/*                     GDALRoughnessAlg()                               */
-/************************************************************************/
-
-float GDALRoughnessAlg (float* afWin, float fDstNoDataValue, void* pData)
-{
-    // Roughness is the largest difference
-    //  between any two cells
-
-    float pafRoughnessMin = afWin[0];
-    float pafRoughnessMax = afWin[0];
-
-    for ( int k = 1; k < 9; k++)
-    {
-        if (afWin[k] > pafRoughnessMax)
-        {
-            pafRoughnessMax=afWin[k];
-        }
-        if (afWin[k] < pafRoughnessMin)
-        {
-            pafRoughnessMin=afWin[k];
-        }
-    }
-    return pafRoughnessMax - pafRoughnessMin;
-}
-
 /************************************************************************/
 /* ==================================================================== */
 /*                       GDALGeneric3x3Dataset                        */
 /* ==================================================================== */
 /************************************************************************/
 
+/* Height of the blocks computed at once when generating a dataset */
+/* for a driver that only supports CreateCopy() */
+#define GENERIC_3X3_BLOCK_LINES 64
+
 class GDALGeneric3x3RasterBand;
 
 class GDALGeneric3x3Dataset : public GDALDataset
 {
     friend class GDALGeneric3x3RasterBand;
 
-    GDALGeneric3x3ProcessingAlg pfnAlg;
-    void*              pAlgData;
+    GDALDEMProcessorH  hProcessor;
     GDALDatasetH       hSrcDS;
-    GDALRasterBandH    hSrcBand;
-    float*             apafSourceBuf[3];
+    float*             pafLineBuf;
     int                bDstHasNoData;
     double             dfDstNoDataValue;
-    int                nCurLine;
-    int                bComputeAtEdges;
 
   public:
                         GDALGeneric3x3Dataset(GDALDatasetH hSrcDS,
-                                              GDALRasterBandH hSrcBand,
                                               GDALDataType eDstDataType,
                                               int bDstHasNoData,
                                               double dfDstNoDataValue,
-                                              GDALGeneric3x3ProcessingAlg pfnAlg,
-                                              void* pAlgData,
-                                              int bComputeAtEdges);
+                                              GDALDEMProcessorH hProcessor);
                        ~GDALGeneric3x3Dataset();
 
     CPLErr      GetGeoTransform( double * padfGeoTransform );
@@ -1745,11 +1342,7 @@ class GDALGeneric3x3Dataset : public GDALDataset
 class GDALGeneric3x3RasterBand : public GDALRasterBand
 {
     friend class GDALGeneric3x3Dataset;
-    int bSrcHasNoData;
-    float fSrcNoDataValue;
-    
-    void                    InitWidthNoData(void* pImage);
-    
+
   public:
                  GDALGeneric3x3RasterBand( GDALGeneric3x3Dataset *poDS,
                                            GDALDataType eDstDataType );
@@ -1760,21 +1353,15 @@ class GDALGeneric3x3RasterBand : public GDALRasterBand
 
 GDALGeneric3x3Dataset::GDALGeneric3x3Dataset(
                                      GDALDatasetH hSrcDS,
-                                     GDALRasterBandH hSrcBand,
                                      GDALDataType eDstDataType,
                                      int bDstHasNoData,
                                      double dfDstNoDataValue,
-                                     GDALGeneric3x3ProcessingAlg pfnAlg,
-                                     void* pAlgData,
-                                     int bComputeAtEdges)
+                                     GDALDEMProcessorH hProcessor)
 {
     this->hSrcDS = hSrcDS;
-    this->hSrcBand = hSrcBand;
-    this->pfnAlg = pfnAlg;
-    this->pAlgData = pAlgData;
+    this->hProcessor = hProcessor;
     this->bDstHasNoData = bDstHasNoData;
     this->dfDstNoDataValue = dfDstNoDataValue;
-    this->bComputeAtEdges = bComputeAtEdges;
     
     CPLAssert(eDstDataType == GDT_Byte || eDstDataType == GDT_Float32);
 
@@ -1782,19 +1369,16 @@ GDALGeneric3x3Dataset::GDALGeneric3x3Dataset(
     nRasterYSize = GDALGetRasterYSize(hSrcDS);
     
     SetBand(1, new GDALGeneric3x3RasterBand(this, eDstDataType));
-    
-    apafSourceBuf[0] = (float *) CPLMalloc(sizeof(float)*nRasterXSize);
-    apafSourceBuf[1] = (float *) CPLMalloc(sizeof(float)*nRasterXSize);
-    apafSourceBuf[2] = (float *) CPLMalloc(sizeof(float)*nRasterXSize);
 
-    nCurLine = -1;
+    pafLineBuf = NULL;
+    if (eDstDataType != GDT_Float32)
+        pafLineBuf = (float *) CPLMalloc(sizeof(float) * nRasterXSize *
+                        MIN(GENERIC_3X3_BLOCK_LINES, nRasterYSize));
 }
 
 GDALGeneric3x3Dataset::~GDALGeneric3x3Dataset()
 {
-    CPLFree(apafSourceBuf[0]);
-    CPLFree(apafSourceBuf[1]);
-    CPLFree(apafSourceBuf[2]);
+    CPLFree(pafLineBuf);
 }
 
 CPLErr GDALGeneric3x3Dataset::GetGeoTransform( double * padfGeoTransform )
@@ -1814,281 +1398,29 @@ GDALGeneric3x3RasterBand::GDALGeneric3x3RasterBand(GDALGeneric3x3Dataset *poDS,
     this->nBand = 1;
     eDataType = eDstDataType;
     nBlockXSize = poDS->GetRasterXSize();
-    nBlockYSize = 1;
-
-    bSrcHasNoData = FALSE;
-    fSrcNoDataValue = (float)GDALGetRasterNoDataValue(poDS->hSrcBand,
-                                                      &bSrcHasNoData);
-}
-
-void   GDALGeneric3x3RasterBand::InitWidthNoData(void* pImage)
-{
-    int j;
-    GDALGeneric3x3Dataset * poGDS = (GDALGeneric3x3Dataset *) poDS;
-    if (eDataType == GDT_Byte)
-    {
-        for(j=0;j<nBlockXSize;j++)
-            ((GByte*)pImage)[j] = (GByte) poGDS->dfDstNoDataValue;
-    }
-    else
-    {
-        for(j=0;j<nBlockXSize;j++)
-            ((float*)pImage)[j] = (float) poGDS->dfDstNoDataValue;
-    }
+    nBlockYSize = MIN(GENERIC_3X3_BLOCK_LINES, poDS->GetRasterYSize());
 }
 
 CPLErr GDALGeneric3x3RasterBand::IReadBlock( int nBlockXOff,
                                              int nBlockYOff,
                                              void *pImage )
 {
-    int i, j;
-    float fVal;
     GDALGeneric3x3Dataset * poGDS = (GDALGeneric3x3Dataset *) poDS;
+    int nYOff = nBlockYOff * nBlockYSize;
+    int nLines = MIN(nBlockYSize, nRasterYSize - nYOff);
+    float *pafBuf = (eDataType == GDT_Float32) ? (float *) pImage :
+                                                 poGDS->pafLineBuf;
 
-    if (poGDS->bComputeAtEdges && nRasterXSize >= 2 && nRasterYSize >= 2)
-    {
-        if (nBlockYOff == 0)
-        {
-            for(i=0;i<2;i++)
-            {
-                CPLErr eErr = GDALRasterIO( poGDS->hSrcBand,
-                                    GF_Read,
-                                    0, i, nBlockXSize, 1,
-                                    poGDS->apafSourceBuf[i+1],
-                                    nBlockXSize, 1,
-                                    GDT_Float32,
-                                    0, 0);
-                if (eErr != CE_None)
-                {
-                    InitWidthNoData(pImage);
-                    return eErr;
-                }
-            }
-            poGDS->nCurLine = 0;
-
-            for (j = 0; j < nRasterXSize; j++)
-            {
-                float afWin[9];
-                int jmin = (j == 0) ? j : j - 1;
-                int jmax = (j == nRasterXSize - 1) ? j : j + 1;
-
-                afWin[0] = INTERPOL(poGDS->apafSourceBuf[1][jmin], poGDS->apafSourceBuf[2][jmin]);
-                afWin[1] = INTERPOL(poGDS->apafSourceBuf[1][j],    poGDS->apafSourceBuf[2][j]);
-                afWin[2] = INTERPOL(poGDS->apafSourceBuf[1][jmax], poGDS->apafSourceBuf[2][jmax]);
-                afWin[3] = poGDS->apafSourceBuf[1][jmin];
-                afWin[4] = poGDS->apafSourceBuf[1][j];
-                afWin[5] = poGDS->apafSourceBuf[1][jmax];
-                afWin[6] = poGDS->apafSourceBuf[2][jmin];
-                afWin[7] = poGDS->apafSourceBuf[2][j];
-                afWin[8] = poGDS->apafSourceBuf[2][jmax];
-
-                fVal = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                    afWin, (float) poGDS->dfDstNoDataValue,
-                                    poGDS->pfnAlg,
-                                    poGDS->pAlgData,
-                                    poGDS->bComputeAtEdges);
-
-                if (eDataType == GDT_Byte)
-                    ((GByte*)pImage)[j] = (GByte) (fVal + 0.5);
-                else
-                    ((float*)pImage)[j] = fVal;
-            }
-
-            return CE_None;
-        }
-        else if (nBlockYOff == nRasterYSize - 1)
-        {
-            if (poGDS->nCurLine != nRasterYSize - 2)
-            {
-                for(i=0;i<2;i++)
-                {
-                    CPLErr eErr = GDALRasterIO( poGDS->hSrcBand,
-                                        GF_Read,
-                                        0, nRasterYSize - 2 + i, nBlockXSize, 1,
-                                        poGDS->apafSourceBuf[i+1],
-                                        nBlockXSize, 1,
-                                        GDT_Float32,
-                                        0, 0);
-                    if (eErr != CE_None)
-                    {
-                        InitWidthNoData(pImage);
-                        return eErr;
-                    }
-                }
-            }
+    CPLErr eErr = GDALDEMProcessLines(poGDS->hProcessor, nYOff, nLines,
+                                      pafBuf);
+    if (eErr != CE_None)
+        return eErr;
 
-            for (j = 0; j < nRasterXSize; j++)
-            {
-                float afWin[9];
-                int jmin = (j == 0) ? j : j - 1;
-                int jmax = (j == nRasterXSize - 1) ? j : j + 1;
-
-                afWin[0] = poGDS->apafSourceBuf[1][jmin];
-                afWin[1] = poGDS->apafSourceBuf[1][j];
-                afWin[2] = poGDS->apafSourceBuf[1][jmax];
-                afWin[3] = poGDS->apafSourceBuf[2][jmin];
-                afWin[4] = poGDS->apafSourceBuf[2][j];
-                afWin[5] = poGDS->apafSourceBuf[2][jmax];
-                afWin[6] = INTERPOL(poGDS->apafSourceBuf[2][jmin], poGDS->apafSourceBuf[1][jmin]);
-                afWin[7] = INTERPOL(poGDS->apafSourceBuf[2][j],    poGDS->apafSourceBuf[1][j]);
-                afWin[8] = INTERPOL(poGDS->apafSourceBuf[2][jmax], poGDS->apafSourceBuf[1][jmax]);
-
-                fVal = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                    afWin, (float) poGDS->dfDstNoDataValue,
-                                    poGDS->pfnAlg,
-                                    poGDS->pAlgData,
-                                    poGDS->bComputeAtEdges);
-
-                if (eDataType == GDT_Byte)
-                    ((GByte*)pImage)[j] = (GByte) (fVal + 0.5);
-                else
-                    ((float*)pImage)[j] = fVal;
-            }
-
-            return CE_None;
-        }
-    }
-    else if ( nBlockYOff == 0 || nBlockYOff == nRasterYSize - 1)
-    {
-        InitWidthNoData(pImage);
-        return CE_None;
-    }
-
-    if ( poGDS->nCurLine != nBlockYOff )
-    {
-        if (poGDS->nCurLine + 1 == nBlockYOff)
-        {
-            float* pafTmp =  poGDS->apafSourceBuf[0];
-            poGDS->apafSourceBuf[0] = poGDS->apafSourceBuf[1];
-            poGDS->apafSourceBuf[1] = poGDS->apafSourceBuf[2];
-            poGDS->apafSourceBuf[2] = pafTmp;
-
-            CPLErr eErr = GDALRasterIO( poGDS->hSrcBand,
-                                    GF_Read,
-                                    0, nBlockYOff + 1, nBlockXSize, 1,
-                                    poGDS->apafSourceBuf[2],
-                                    nBlockXSize, 1,
-                                    GDT_Float32,
-                                    0, 0);
-
-            if (eErr != CE_None)
-            {
-                InitWidthNoData(pImage);
-                return eErr;
-            }
-        }
-        else
-        {
-            for(i=0;i<3;i++)
-            {
-                CPLErr eErr = GDALRasterIO( poGDS->hSrcBand,
-                                    GF_Read,
-                                    0, nBlockYOff + i - 1, nBlockXSize, 1,
-                                    poGDS->apafSourceBuf[i],
-                                    nBlockXSize, 1,
-                                    GDT_Float32,
-                                    0, 0);
-                if (eErr != CE_None)
-                {
-                    InitWidthNoData(pImage);
-                    return eErr;
-                }
-            }
-        }
-
-        poGDS->nCurLine = nBlockYOff;
-    }
-
-    if (poGDS->bComputeAtEdges && nRasterXSize >= 2)
-    {
-        float afWin[9];
-
-        j = 0;
-        afWin[0] = INTERPOL(poGDS->apafSourceBuf[0][j], poGDS->apafSourceBuf[0][j+1]);
-        afWin[1] = poGDS->apafSourceBuf[0][j];
-        afWin[2] = poGDS->apafSourceBuf[0][j+1];
-        afWin[3] = INTERPOL(poGDS->apafSourceBuf[1][j], poGDS->apafSourceBuf[1][j+1]);
-        afWin[4] = poGDS->apafSourceBuf[1][j];
-        afWin[5] = poGDS->apafSourceBuf[1][j+1];
-        afWin[6] = INTERPOL(poGDS->apafSourceBuf[2][j], poGDS->apafSourceBuf[2][j+1]);
-        afWin[7] = poGDS->apafSourceBuf[2][j];
-        afWin[8] = poGDS->apafSourceBuf[2][j+1];
-
-        fVal = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                    afWin, (float) poGDS->dfDstNoDataValue,
-                                    poGDS->pfnAlg,
-                                    poGDS->pAlgData,
-                                    poGDS->bComputeAtEdges);
-
-        if (eDataType == GDT_Byte)
-            ((GByte*)pImage)[j] = (GByte) (fVal + 0.5);
-        else
-            ((float*)pImage)[j] = fVal;
-
-        j = nRasterXSize - 1;
-
-        afWin[0] = poGDS->apafSourceBuf[0][j-1];
-        afWin[1] = poGDS->apafSourceBuf[0][j];
-        afWin[2] = INTERPOL(poGDS->apafSourceBuf[0][j], poGDS->apafSourceBuf[0][j-1]);
-        afWin[3] = poGDS->apafSourceBuf[1][j-1];
-        afWin[4] = poGDS->apafSourceBuf[1][j];
-        afWin[5] = INTERPOL(poGDS->apafSourceBuf[1][j], poGDS->apafSourceBuf[1][j-1]);
-        afWin[6] = poGDS->apafSourceBuf[2][j-1];
-        afWin[7] = poGDS->apafSourceBuf[2][j];
-        afWin[8] = INTERPOL(poGDS->apafSourceBuf[2][j], poGDS->apafSourceBuf[2][j-1]);
-
-        fVal = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                    afWin, (float) poGDS->dfDstNoDataValue,
-                                    poGDS->pfnAlg,
-                                    poGDS->pAlgData,
-                                    poGDS->bComputeAtEdges);
-
-        if (eDataType == GDT_Byte)
-            ((GByte*)pImage)[j] = (GByte) (fVal + 0.5);
-        else
-            ((float*)pImage)[j] = fVal;
-    }
-    else
-    {
-        if (eDataType == GDT_Byte)
-        {
-            ((GByte*)pImage)[0] = (GByte) poGDS->dfDstNoDataValue;
-            if (nBlockXSize > 1)
-                ((GByte*)pImage)[nBlockXSize - 1] = (GByte) poGDS->dfDstNoDataValue;
-        }
-        else
-        {
-            ((float*)pImage)[0] = (float) poGDS->dfDstNoDataValue;
-            if (nBlockXSize > 1)
-                ((float*)pImage)[nBlockXSize - 1] = (float) poGDS->dfDstNoDataValue;
-        }
-    }
-
-
-    for(j=1;j<nBlockXSize - 1;j++)
+    if (eDataType == GDT_Byte)
     {
-        float afWin[9];
-        afWin[0] = poGDS->apafSourceBuf[0][j-1];
-        afWin[1] = poGDS->apafSourceBuf[0][j];
-        afWin[2] = poGDS->apafSourceBuf[0][j+1];
-        afWin[3] = poGDS->apafSourceBuf[1][j-1];
-        afWin[4] = poGDS->apafSourceBuf[1][j];
-        afWin[5] = poGDS->apafSourceBuf[1][j+1];
-        afWin[6] = poGDS->apafSourceBuf[2][j-1];
-        afWin[7] = poGDS->apafSourceBuf[2][j];
-        afWin[8] = poGDS->apafSourceBuf[2][j+1];
-
-        fVal = ComputeVal(bSrcHasNoData, fSrcNoDataValue,
-                                afWin, (float) poGDS->dfDstNoDataValue,
-                                poGDS->pfnAlg,
-                                poGDS->pAlgData,
-                                poGDS->bComputeAtEdges);
-
-        if (eDataType == GDT_Byte)
-            ((GByte*)pImage)[j] = (GByte) (fVal + 0.5);
-        else
-            ((float*)pImage)[j] = fVal;
-
+        int j;
+        for(j=0;j<nBlockXSize*nLines;j++)
+            ((GByte*)pImage)[j] = (GByte) (pafBuf[j] + 0.5);
     }
 
     return CE_None;
@@ -2157,6 +1489,7 @@ int main( int argc, char ** argv )
     int bZevenbergenThorne = FALSE;
 
     int bQuiet = FALSE;
+    int nThreads = 1;
     
     /* Check strict compilation and runtime library version as we use C++ API */
     if (! GDAL_CHECK_VERSION(argv[0]))
@@ -2295,6 +1628,11 @@ int main( int argc, char ** argv )
         {
             nBand = atoi(argv[++i]);
         }
+        else if( eUtilityMode != COLOR_RELIEF &&
+                 EQUAL(argv[i], "-num_threads") && i + 1 < argc )
+        {
+            nThreads = atoi(argv[++i]);
+        }
         else if ( EQUAL(argv[i], "-q") || EQUAL(argv[i], "-quiet") )
         {
             pfnProgress = GDALDummyProgress;
@@ -2408,36 +1746,29 @@ int main( int argc, char ** argv )
 
     double dfDstNoDataValue = 0;
     int bDstHasNoData = FALSE;
-    void* pData = NULL;
-    GDALGeneric3x3ProcessingAlg pfnAlg = NULL;
+    const char* pszProcessing = NULL;
+    char** papszDEMOptions = NULL;
 
     if (eUtilityMode == HILL_SHADE)
     {
         dfDstNoDataValue = 0;
         bDstHasNoData = TRUE;
-        pData = GDALCreateHillshadeData   (adfGeoTransform,
-                                           z,
-                                           scale,
-                                           alt,
-                                           az,
-                                           bZevenbergenThorne);
-        if (bZevenbergenThorne)
-            pfnAlg = GDALHillshadeZevenbergenThorneAlg;
-        else
-            pfnAlg = GDALHillshadeAlg;
+        pszProcessing = "hillshade";
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "Z_FACTOR",
+                                          CPLSPrintf("%.18g", z));
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "ALTITUDE",
+                                          CPLSPrintf("%.18g", alt));
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "AZIMUTH",
+                                          CPLSPrintf("%.18g", az));
     }
     else if (eUtilityMode == SLOPE)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-
-        pData = GDALCreateSlopeData(adfGeoTransform, scale, slopeFormat);
-        if (bZevenbergenThorne)
-            pfnAlg = GDALSlopeZevenbergenThorneAlg;
-        else
-            pfnAlg = GDALSlopeHornAlg;
+        pszProcessing = "slope";
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "SLOPE_FORMAT",
+                                    (slopeFormat == 1) ? "DEGREES" : "PERCENT");
     }
-
     else if (eUtilityMode == ASPECT)
     {
         if (!bZeroForFlat)
@@ -2445,31 +1776,39 @@ int main( int argc, char ** argv )
             dfDstNoDataValue = -9999;
             bDstHasNoData = TRUE;
         }
-
-        pData = GDALCreateAspectData(bAngleAsAzimuth);
-        if (bZevenbergenThorne)
-            pfnAlg = GDALAspectZevenbergenThorneAlg;
-        else
-            pfnAlg = GDALAspectAlg;
+        pszProcessing = "aspect";
+        if (!bAngleAsAzimuth)
+            papszDEMOptions = CSLSetNameValue(papszDEMOptions,
+                                              "TRIGONOMETRIC", "YES");
     }
     else if (eUtilityMode == TRI)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-        pfnAlg = GDALTRIAlg;
+        pszProcessing = "TRI";
     }
     else if (eUtilityMode == TPI)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-        pfnAlg = GDALTPIAlg;
+        pszProcessing = "TPI";
     }
     else if (eUtilityMode == ROUGHNESS)
     {
         dfDstNoDataValue = -9999;
         bDstHasNoData = TRUE;
-        pfnAlg = GDALRoughnessAlg;
-    }
+        pszProcessing = "roughness";
+    }
+
+    if (eUtilityMode == HILL_SHADE || eUtilityMode == SLOPE)
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "SCALE",
+                                          CPLSPrintf("%.18g", scale));
+    if (bZevenbergenThorne)
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "ALG",
+                                          "ZevenbergenThorne");
+    if (bComputeAtEdges)
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "COMPUTE_EDGES",
+                                          "YES");
     
     GDALDataType eDstDataType = (eUtilityMode == HILL_SHADE ||
                                  eUtilityMode == COLOR_RELIEF) ? GDT_Byte :
@@ -2487,7 +1826,7 @@ int main( int argc, char ** argv )
                                        bAddAlpha);
             GDALClose(hSrcDataset);
         
-            CPLFree(pData);
+            CSLDestroy(papszDEMOptions);
 
             GDALDestroyDriverManager();
             CSLDestroy( argv );
@@ -2508,6 +1847,7 @@ int main( int argc, char ** argv )
         GDALGetMetadataItem( hDriver, GDAL_DCAP_CREATECOPY, NULL ) != NULL)
     {
         GDALDatasetH hIntermediateDataset;
+        GDALDEMProcessorH hProcessor = NULL;
         
         if (eUtilityMode == COLOR_RELIEF)
             hIntermediateDataset = (GDALDatasetH)
@@ -2517,14 +1857,23 @@ int main( int argc, char ** argv )
                                             eColorSelectionMode,
                                             bAddAlpha);
         else
+        {
+            papszDEMOptions = CSLSetNameValue(papszDEMOptions, "DST_NODATA",
+                                    CPLSPrintf("%.18g", dfDstNoDataValue));
+            hProcessor = GDALDEMCreateProcessor(hSrcBand, pszProcessing,
+                                                papszDEMOptions);
+            if (hProcessor == NULL)
+            {
+                GDALDestroyDriverManager();
+                exit( 1 );
+            }
             hIntermediateDataset = (GDALDatasetH)
-                new GDALGeneric3x3Dataset(hSrcDataset, hSrcBand,
+                new GDALGeneric3x3Dataset(hSrcDataset,
                                           eDstDataType,
                                           bDstHasNoData,
                                           dfDstNoDataValue,
-                                          pfnAlg,
-                                          pData,
-                                          bComputeAtEdges);
+                                          hProcessor);
+        }
 
         GDALDatasetH hOutDS = GDALCreateCopy(
                                  hDriver, pszDstFilename, hIntermediateDataset, 
@@ -2534,9 +1883,10 @@ int main( int argc, char ** argv )
         if( hOutDS != NULL )
             GDALClose( hOutDS );
         GDALClose(hIntermediateDataset);
+        GDALDEMDestroyProcessor(hProcessor);
         GDALClose(hSrcDataset);
         
-        CPLFree(pData);
+        CSLDestroy(papszDEMOptions);
 
         GDALDestroyDriverManager();
         CSLDestroy( argv );
@@ -2588,17 +1938,19 @@ int main( int argc, char ** argv )
     {
         if (bDstHasNoData)
             GDALSetRasterNoDataValue(hDstBand, dfDstNoDataValue);
+
+        papszDEMOptions = CSLSetNameValue(papszDEMOptions, "NUM_THREADS",
+                                          CPLSPrintf("%d", nThreads));
         
-        GDALGeneric3x3Processing(hSrcBand, hDstBand,
-                                 pfnAlg, pData,
-                                 bComputeAtEdges,
-                                 pfnProgress, NULL);
+        GDALDEMProcessBand(hSrcBand, hDstBand,
+                           pszProcessing, papszDEMOptions,
+                           pfnProgress, NULL);
                                     
     }
 
     GDALClose(hSrcDataset);
     GDALClose(hDstDataset);
-    CPLFree(pData);
+    CSLDestroy(papszDEMOptions);
 
     GDALDestroyDriverManager();
     CSLDestroy( argv );
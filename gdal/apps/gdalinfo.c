@@ -571,10 +571,17 @@ int main( int argc, char ** argv )
 
         if ( bComputeChecksum)
         {
-            printf( "  Checksum=%d\n",
-                    GDALChecksumImage(hBand, 0, 0,
-                                      GDALGetRasterXSize(hDataset),
-                                      GDALGetRasterYSize(hDataset)));
+            /* reuse the checksum saved by GDALDatasetComputeRasterSummary() */
+            const char *pszChecksum =
+                GDALGetMetadataItem( hBand, "STATISTICS_CHECKSUM", NULL );
+
+            if( pszChecksum != NULL )
+                printf( "  Checksum=%d\n", atoi(pszChecksum) );
+            else
+                printf( "  Checksum=%d\n",
+                        GDALChecksumImage(hBand, 0, 0,
+                                          GDALGetRasterXSize(hDataset),
+                                          GDALGetRasterYSize(hDataset)));
         }
 
         dfNoData = GDALGetRasterNoDataValue( hBand, &bGotNodata );
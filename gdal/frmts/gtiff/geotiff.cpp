@@ -370,6 +370,10 @@ class GTiffDataset : public GDALPamDataset
   protected:
     virtual int         CloseDependentDatasets();
 
+    virtual CPLErr      GetPixelInterleavedBlock( int nXBlockOff, 
+                                                  int nYBlockOff,
+                                                  void **ppData );
+
   public:
                  GTiffDataset();
                  ~GTiffDataset();
@@ -483,6 +487,7 @@ public:
 
     virtual CPLErr IReadBlock( int, int, void * );
     virtual CPLErr IWriteBlock( int, int, void * );
+    virtual int    CanReadBlockDirect();
 
     virtual CPLErr IRasterIO( GDALRWFlag eRWFlag,
                                   int nXOff, int nYOff, int nXSize, int nYSize,
@@ -728,6 +733,23 @@ CPLErr GTiffRasterBand::IRasterIO( GDALRWFlag eRWFlag,
     return eErr;
 }
 
+/************************************************************************/
+/*                         CanReadBlockDirect()                         */
+/*                                                                      */
+/*      Pixel interleaved blocks are shared between bands through       */
+/*      the block cache, and split bands must be read in sequence.      */
+/************************************************************************/
+
+int GTiffRasterBand::CanReadBlockDirect()
+
+{
+    return (poGDS->nBands == 1 
+            || poGDS->nPlanarConfig == PLANARCONFIG_SEPARATE)
+        && !poGDS->bTreatAsRGBA
+        && !poGDS->bTreatAsSplit
+        && !poGDS->bTreatAsSplitBitmap;
+}
+
 /************************************************************************/
 /*                             IReadBlock()                             */
 /************************************************************************/
@@ -3459,6 +3481,48 @@ void GTiffDataset::Crystalize()
 }
 
 
+/************************************************************************/
+/*                      GetPixelInterleavedBlock()                      */
+/*                                                                      */
+/*      Hand the loaded block buffer of a contiguous multi-band file    */
+/*      to BlockBasedRasterIO(), so that it does not need to go         */
+/*      through the block cache of each band.                           */
+/************************************************************************/
+
+CPLErr GTiffDataset::GetPixelInterleavedBlock( int nXBlockOff, int nYBlockOff,
+                                               void **ppData )
+
+{
+    *ppData = NULL;
+
+    if( nPlanarConfig != PLANARCONFIG_CONTIG || nBands < 2
+        || bTreatAsRGBA || bTreatAsSplit || bTreatAsSplitBitmap
+        || (int) nBitsPerSample != 
+              GDALGetDataTypeSize(GetRasterBand(1)->GetRasterDataType()) )
+        return CE_None;
+
+    if( !SetDirectory() )
+        return CE_Failure;
+
+    int nBlocksPerRow = (nRasterXSize + nBlockXSize - 1) / nBlockXSize;
+    int nBlockId = nXBlockOff + nYBlockOff * nBlocksPerRow;
+
+/* -------------------------------------------------------------------- */
+/*      Missing blocks are filled with the nodata value by              */
+/*      IReadBlock(): let it handle them.                               */
+/* -------------------------------------------------------------------- */
+    if( !IsBlockAvailable(nBlockId) )
+        return CE_None;
+
+    CPLErr eErr = LoadBlockBuf( nBlockId );
+    if( eErr != CE_None )
+        return eErr;
+
+    *ppData = pabyBlockBuf;
+
+    return CE_None;
+}
+
 /************************************************************************/
 /*                          IsBlockAvailable()                          */
 /*                                                                      */
@@ -3734,6 +3798,7 @@ CPLErr GTiffDataset::RegisterNewOverviewDataset(toff_t nOverviewOffset)
                         nOverviewCount * (sizeof(void*)));
         papoOverviewDS[nOverviewCount-1] = poODS;
         poODS->poBaseDS = this;
+        poODS->SetIOMutexOwner( this );
         return CE_None;
     }
 }
@@ -3939,6 +4004,7 @@ CPLErr GTiffDataset::CreateInternalMaskOverviews(int nOvrBlockXSize,
                 {
                     poODS->bPromoteTo8Bits = CSLTestBoolean(CPLGetConfigOption("GDAL_TIFF_INTERNAL_MASK_TO_8BIT", "YES"));
                     poODS->poBaseDS = this;
+                    poODS->SetIOMutexOwner( this );
                     papoOverviewDS[i]->poMaskDS = poODS;
                     poMaskDS->nOverviewCount++;
                     poMaskDS->papoOverviewDS = (GTiffDataset **)
@@ -5346,6 +5412,9 @@ GDALDataset *GTiffDataset::Open( GDALOpenInfo * poOpenInfo )
 /*      Check for external overviews.                                   */
 /* -------------------------------------------------------------------- */
     poDS->oOvManager.Initialize( poDS, pszFilename, poOpenInfo->papszSiblingFiles );
+
+    /* Overviews and masks share the mutex, see SetIOMutexOwner() calls */
+    poDS->EnableWriteBehind();
     
     return poDS;
 }
@@ -6492,6 +6561,7 @@ void GTiffDataset::ScanDirectories()
                                nOverviewCount * (sizeof(void*)));
                 papoOverviewDS[nOverviewCount-1] = poODS;
                 poODS->poBaseDS = this;
+                poODS->SetIOMutexOwner( this );
             }
         }
             
@@ -6526,6 +6596,7 @@ void GTiffDataset::ScanDirectories()
             {
                 CPLDebug( "GTiff", "Opened band mask.\n");
                 poMaskDS->poBaseDS = this;
+                poMaskDS->SetIOMutexOwner( this );
                     
                 poMaskDS->bPromoteTo8Bits = CSLTestBoolean(CPLGetConfigOption("GDAL_TIFF_INTERNAL_MASK_TO_8BIT", "YES"));
             }
@@ -6559,6 +6630,7 @@ void GTiffDataset::ScanDirectories()
                         ((GTiffDataset*)papoOverviewDS[i])->poMaskDS = poDS;
                         poDS->bPromoteTo8Bits = CSLTestBoolean(CPLGetConfigOption("GDAL_TIFF_INTERNAL_MASK_TO_8BIT", "YES"));
                         poDS->poBaseDS = this;
+                        poDS->SetIOMutexOwner( this );
                         break;
                     }
                 }
@@ -7425,6 +7497,8 @@ GDALDataset *GTiffDataset::Create( const char * pszFilename,
 
     poDS->oOvManager.Initialize( poDS, pszFilename );
 
+    poDS->EnableWriteBehind();
+
     return( poDS );
 }
 
@@ -8782,6 +8856,7 @@ CPLErr GTiffDataset::CreateMaskBand(int nFlags)
             poMaskDS = NULL;
             return CE_Failure;
         }
+        poMaskDS->SetIOMutexOwner( this );
 
         return CE_None;
     }
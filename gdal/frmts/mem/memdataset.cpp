@@ -151,6 +151,16 @@ CPLErr MEMRasterBand::IReadBlock( int nBlockXOff, int nBlockYOff,
     return CE_None;
 }
 
+/************************************************************************/
+/*                         CanReadBlockDirect()                         */
+/************************************************************************/
+
+int MEMRasterBand::CanReadBlockDirect()
+
+{
+    return TRUE;
+}
+
 /************************************************************************/
 /*                            IWriteBlock()                             */
 /************************************************************************/
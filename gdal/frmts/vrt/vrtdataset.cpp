@@ -68,6 +68,8 @@ VRTDataset::VRTDataset( int nXSize, int nYSize )
     poDriver = (GDALDriver *) GDALGetDriverByName( "VRT" );
 
     bCompatibleForDatasetIO = -1;
+
+    nNumThreads = 0;
 }
 
 /************************************************************************/
@@ -197,6 +199,12 @@ CPLXMLNode *VRTDataset::SerializeToXML( const char *pszVRTPath )
     sprintf( szNumber, "%d", GetRasterYSize() );
     CPLSetXMLValue( psDSTree, "#rasterYSize", szNumber );
 
+    if( nNumThreads > 0 )
+    {
+        sprintf( szNumber, "%d", nNumThreads );
+        CPLSetXMLValue( psDSTree, "#numThreads", szNumber );
+    }
+
  /* -------------------------------------------------------------------- */
  /*      SRS                                                             */
  /* -------------------------------------------------------------------- */
@@ -334,6 +342,8 @@ CPLErr VRTDataset::XMLInit( CPLXMLNode *psTree, const char *pszVRTPath )
     if( pszVRTPath != NULL )
         this->pszVRTPath = CPLStrdup(pszVRTPath);
 
+    nNumThreads = atoi(CPLGetXMLValue(psTree, "numThreads", "0"));
+
 /* -------------------------------------------------------------------- */
 /*      Check for an SRS node.                                          */
 /* -------------------------------------------------------------------- */
@@ -947,6 +957,11 @@ CPLErr VRTDataset::AddBand( GDALDataType eType, char **papszOptions )
             if (pszFuncName != NULL)
                 poDerivedBand->SetPixelFunctionName(pszFuncName);
 
+            const char* pszExpression =
+                CSLFetchNameValue(papszOptions, "PixelFunctionExpression");
+            if (pszExpression != NULL)
+                poDerivedBand->SetPixelFunctionExpression(pszExpression);
+
             const char* pszTransferTypeName =
                 CSLFetchNameValue(papszOptions, "SourceTransferType");
             if (pszTransferTypeName != NULL) {
@@ -1252,6 +1267,23 @@ int VRTDataset::CheckCompatibleForDatasetIO()
     return nSources != 0;
 }
 
+/************************************************************************/
+/*                           GetNumThreads()                            */
+/*                                                                      */
+/*      Number of threads used to read the sources of a request. The    */
+/*      numThreads attribute of the VRTDataset element takes            */
+/*      precedence over the VRT_NUM_THREADS configuration option.       */
+/************************************************************************/
+
+int VRTDataset::GetNumThreads()
+
+{
+    if( nNumThreads > 0 )
+        return nNumThreads;
+
+    return MAX( 1, atoi(CPLGetConfigOption("VRT_NUM_THREADS", "1")) );
+}
+
 /************************************************************************/
 /*                              IRasterIO()                             */
 /************************************************************************/
@@ -1292,15 +1324,14 @@ CPLErr VRTDataset::IRasterIO( GDALRWFlag eRWFlag,
         /* Use the last band, because when sources reference a GDALProxyDataset, they */
         /* don't necessary instanciate all underlying rasterbands */
         VRTSourcedRasterBand* poBand = (VRTSourcedRasterBand* )papoBands[nBands - 1];
-        for(int iSource = 0; eErr == CE_None && iSource < poBand->nSources; iSource++)
-        {
-            VRTSimpleSource* poSource = (VRTSimpleSource* )poBand->papoSources[iSource];
-            eErr = poSource->DatasetRasterIO( nXOff, nYOff, nXSize, nYSize,
-                                              pData, nBufXSize, nBufYSize,
-                                              eBufType,
-                                              nBandCount, panBandMap,
-                                              nPixelSpace, nLineSpace, nBandSpace);
-        }
+        std::vector<int> anSources;
+        poBand->GetSourcesInWindow( nXOff, nYOff, nXSize, nYSize, anSources );
+        eErr = poBand->CompositeSources( anSources,
+                                         nXOff, nYOff, nXSize, nYSize,
+                                         pData, nBufXSize, nBufYSize,
+                                         eBufType,
+                                         nPixelSpace, nLineSpace,
+                                         nBandCount, panBandMap, nBandSpace );
         return eErr;
     }
 
@@ -88,6 +88,13 @@ public:
                                int *pnMaxSize, CPLHashSet* hSetFiles);
 
     virtual int    IsSimpleSource() { return FALSE; }
+
+    virtual int    GetDstWindow( int *pnXOff, int *pnYOff,
+                                 int *pnXSize, int *pnYSize );
+
+    /* incremented when the destination window of any source changes, */
+    /* so that the source indexes built over them can be invalidated */
+    static int     nDstWindowGeneration;
 };
 
 typedef VRTSource *(*VRTSourceParser)(CPLXMLNode *, const char *);
@@ -124,6 +131,8 @@ class CPL_DLL VRTDataset : public GDALDataset
     int            bCompatibleForDatasetIO;
     int            CheckCompatibleForDatasetIO();
 
+    int            nNumThreads;
+
   protected:
     virtual int         CloseDependentDatasets();
 
@@ -136,6 +145,9 @@ class CPL_DLL VRTDataset : public GDALDataset
     
     void SetWritable(int bWritable) { this->bWritable = bWritable; }
 
+    void          SetNumThreads( int nNumThreads ) { this->nNumThreads = nNumThreads; }
+    int           GetNumThreads();
+
     virtual CPLErr          CreateMaskBand( int nFlags );
     void SetMaskBand(VRTRasterBand* poMaskBand);
 
@@ -327,6 +339,35 @@ class CPL_DLL VRTRasterBand : public GDALRasterBand
     virtual int         IsSourcedRasterBand() { return FALSE; }
 };
 
+/************************************************************************/
+/*                            VRTSourceIndex                            */
+/*                                                                      */
+/*      Regular grid over the destination windows of the sources of     */
+/*      a band, so that only the sources intersecting a request need    */
+/*      to be visited.                                                  */
+/************************************************************************/
+
+class VRTSourceIndex
+{
+    int            nCellSize;
+    int            nCellsX;
+    int            nCellsY;
+    std::vector< std::vector<int> > aanCells;
+    std::vector<int> anUnindexed;
+
+  public:
+                   VRTSourceIndex( int nXSize, int nYSize,
+                                   int nSources, VRTSource **papoSources );
+
+    int            nIndexedSources;
+    VRTSource    **papoIndexedSources;
+    int            nIndexedGeneration;
+    int            bValid;
+
+    void           GetSources( int nXOff, int nYOff, int nXSize, int nYSize,
+                               std::vector<int>& anSources );
+};
+
 /************************************************************************/
 /*                         VRTSourcedRasterBand                         */
 /************************************************************************/
@@ -337,6 +378,9 @@ class CPL_DLL VRTSourcedRasterBand : public VRTRasterBand
     int            bAlreadyInIRasterIO;
     CPLString      osLastLocationInfo;
 
+    VRTSourceIndex *poSourceIndex;
+    void           InvalidateSourceIndex();
+
     void           Initialize( int nXSize, int nYSize );
 
   public:
@@ -369,6 +413,19 @@ class CPL_DLL VRTSourcedRasterBand : public VRTRasterBand
     virtual CPLXMLNode *   SerializeToXML( const char *pszVRTPath );
 
     CPLErr         AddSource( VRTSource * );
+    void           GetSourcesInWindow( int nXOff, int nYOff,
+                                       int nXSize, int nYSize,
+                                       std::vector<int>& anSources );
+    CPLErr         CompositeSources( const std::vector<int>& anSources,
+                                     int nXOff, int nYOff,
+                                     int nXSize, int nYSize,
+                                     void *pData,
+                                     int nBufXSize, int nBufYSize,
+                                     GDALDataType eBufType,
+                                     int nPixelSpace, int nLineSpace,
+                                     int nBandCount = 0,
+                                     int *panBandMap = NULL,
+                                     int nBandSpace = 0 );
     CPLErr         AddSimpleSource( GDALRasterBand *poSrcBand, 
                                     int nSrcXOff=-1, int nSrcYOff=-1, 
                                     int nSrcXSize=-1, int nSrcYSize=-1, 
@@ -427,6 +484,65 @@ class CPL_DLL VRTWarpedRasterBand : public VRTRasterBand
     virtual GDALRasterBand *GetOverview(int);
 };
 
+/************************************************************************/
+/*                            VRTExpression                             */
+/*                                                                      */
+/*      Band math expression over the sources of a derived band,        */
+/*      compiled once into a list of vector instructions.               */
+/************************************************************************/
+
+typedef struct
+{
+    int         eOp;
+    int         nDst;
+    int         anSlot[3];      /* -1 for a constant operand */
+    double      adfConst[3];
+} VRTExprInstr;
+
+class VRTExpression
+{
+    CPLString    osExpression;
+    int          nSources;
+    int          nSlots;
+    std::vector<VRTExprInstr> aoInstrs;
+    std::vector<int> anFreeSlots;
+
+    int          nResultSlot;
+    double       dfResultConst;
+
+    /* parser state */
+    const char  *pszNext;
+    int          bError;
+
+    typedef struct { int nSlot; double dfConst; } Operand;
+
+    void         SkipSpaces();
+    int          Accept( const char *pszToken );
+    void         SetError( const char *pszMsg );
+    Operand      Emit( int eOp, int nOperands, Operand *pasOperands );
+    Operand      ParseOr();
+    Operand      ParseAnd();
+    Operand      ParseComparison();
+    Operand      ParseSum();
+    Operand      ParseProduct();
+    Operand      ParseUnary();
+    Operand      ParsePower();
+    Operand      ParsePrimary();
+
+  public:
+                 VRTExpression();
+
+    void         SetExpression( const char *pszExpression );
+    int          Compile( const char *pszExpression, int nSources );
+
+    const char  *GetExpression() { return osExpression.c_str(); }
+    int          GetSourceCount() { return nSources; }
+    int          GetWorkSlotCount() { return nSlots - nSources; }
+
+    void         Evaluate( const double * const *papadfSources, int nValues,
+                           double *padfWork, double *padfResult );
+};
+
 /************************************************************************/
 /*                         VRTDerivedRasterBand                         */
 /************************************************************************/
@@ -438,6 +554,8 @@ class CPL_DLL VRTDerivedRasterBand : public VRTSourcedRasterBand
     char *pszFuncName;
     GDALDataType eSourceTransferType;
 
+    VRTExpression *poExpression;
+
     VRTDerivedRasterBand(GDALDataset *poDS, int nBand);
     VRTDerivedRasterBand(GDALDataset *poDS, int nBand, 
                          GDALDataType eType, int nXSize, int nYSize);
@@ -453,6 +571,15 @@ class CPL_DLL VRTDerivedRasterBand : public VRTSourcedRasterBand
 
     void SetPixelFunctionName(const char *pszFuncName);
     void SetSourceTransferType(GDALDataType eDataType);
+    CPLErr SetPixelFunctionExpression(const char *pszExpression);
+
+  private:
+    CPLErr ExpressionRasterIO( int nXOff, int nYOff, int nXSize, int nYSize,
+                               void * pData, int nBufXSize, int nBufYSize,
+                               GDALDataType eBufType,
+                               int nPixelSpace, int nLineSpace );
+
+  public:
 
     virtual CPLErr         XMLInit( CPLXMLNode *, const char * );
     virtual CPLXMLNode *   SerializeToXML( const char *pszVRTPath );
@@ -582,6 +709,9 @@ public:
     virtual int    IsSimpleSource() { return TRUE; }
     virtual const char* GetType() { return "SimpleSource"; }
 
+    virtual int    GetDstWindow( int *pnXOff, int *pnYOff,
+                                 int *pnXSize, int *pnYSize );
+
     GDALRasterBand* GetBand();
     int             IsSameExceptBandNumber(VRTSimpleSource* poOtherSource);
     CPLErr          DatasetRasterIO(
@@ -666,6 +796,11 @@ public:
                               void *pData, int nBufXSize, int nBufYSize, 
                               GDALDataType eBufType, 
                               int nPixelSpace, int nLineSpace );
+
+    virtual const char* GetType() { return "FilteredSource"; }
+
+    /* RasterIO() fills the whole buffer, whatever the DstRect is */
+    virtual int    GetDstWindow( int *, int *, int *, int * ) { return FALSE; }
 };
 
 /************************************************************************/
@@ -679,6 +814,10 @@ protected:
 
     double  *padfKernelCoefs;
 
+    /* Row and column factors of the kernel, when it is separable */
+    double  *padfRowCoefs;
+    double  *padfColumnCoefs;
+
     int     bNormalized;
 
 public:
@@ -50,6 +50,7 @@ VRTDerivedRasterBand::VRTDerivedRasterBand(GDALDataset *poDS, int nBand)
 {
     this->pszFuncName = NULL;
     this->eSourceTransferType = GDT_Unknown;
+    this->poExpression = NULL;
 }
 
 /************************************************************************/
@@ -64,6 +65,7 @@ VRTDerivedRasterBand::VRTDerivedRasterBand(GDALDataset *poDS, int nBand,
 {
     this->pszFuncName = NULL;
     this->eSourceTransferType = GDT_Unknown;
+    this->poExpression = NULL;
 }
 
 /************************************************************************/
@@ -77,6 +79,7 @@ VRTDerivedRasterBand::~VRTDerivedRasterBand()
         CPLFree(this->pszFuncName);
         this->pszFuncName = NULL;
     }
+    delete this->poExpression;
 }
 
 /************************************************************************/
@@ -199,6 +202,199 @@ void VRTDerivedRasterBand::SetSourceTransferType(GDALDataType eDataType)
     this->eSourceTransferType = eDataType;
 }
 
+/************************************************************************/
+/*                      SetPixelFunctionExpression()                    */
+/************************************************************************/
+
+/**
+ * Set a band math expression to be applied to this derived band,
+ * instead of a registered pixel function.
+ *
+ * The expression refers to the sources of the band as B1, B2, ... and
+ * may use the + - * / ^ operators, comparisons (< <= > >= == !=) and
+ * logical operators (&& || !) that evaluate to 1 or 0, and the
+ * sqrt, abs, exp, log, log10, sin, cos, tan, atan, floor, ceil,
+ * pow, min, max, atan2 and if(cond,a,b) functions, for example
+ * "(B2-B1)/(B2+B1)".  Computations are done in double precision.
+ *
+ * If the band already has sources, the expression is compiled right away
+ * so that errors are reported by this method.  Otherwise it is compiled
+ * on the first read.
+ *
+ * @param pszExpression the expression, or NULL to remove it.
+ *
+ * @return CE_None on success, CE_Failure if the expression is invalid.
+ *
+ * @since GDAL 1.10
+ */
+CPLErr VRTDerivedRasterBand::SetPixelFunctionExpression(const char *pszExpression)
+{
+    delete this->poExpression;
+    this->poExpression = NULL;
+
+    if (pszExpression == NULL || pszExpression[0] == '\0')
+        return CE_None;
+
+    this->poExpression = new VRTExpression();
+    this->poExpression->SetExpression(pszExpression);
+    if (nSources > 0
+        && !this->poExpression->Compile(pszExpression, nSources)) {
+        delete this->poExpression;
+        this->poExpression = NULL;
+        return CE_Failure;
+    }
+
+    return CE_None;
+}
+
+/************************************************************************/
+/*                         ExpressionRasterIO()                         */
+/*                                                                      */
+/*      Apply the band math expression.  The sources are read as        */
+/*      Float64 by strips of lines, and the expression is evaluated     */
+/*      on short runs of pixels of a line, so that its intermediate     */
+/*      results stay in the CPU cache.                                  */
+/************************************************************************/
+
+/* Target size of the source data of a strip */
+#define VRT_EXPR_STRIP_BYTES    (1024 * 1024)
+/* Number of pixels on which the expression is evaluated at a time */
+#define VRT_EXPR_CHUNK          1024
+
+CPLErr VRTDerivedRasterBand::ExpressionRasterIO(
+                                   int nXOff, int nYOff, int nXSize,
+                                   int nYSize, void * pData, int nBufXSize,
+                                   int nBufYSize, GDALDataType eBufType,
+                                   int nPixelSpace, int nLineSpace )
+{
+    CPLErr eErr = CE_None;
+    int iSource;
+
+/* -------------------------------------------------------------------- */
+/*      Do we have overviews that would be appropriate to satisfy       */
+/*      this request?                                                   */
+/* -------------------------------------------------------------------- */
+    if( (nBufXSize < nXSize || nBufYSize < nYSize)
+        && GetOverviewCount() > 0 )
+    {
+        if( OverviewRasterIO( GF_Read, nXOff, nYOff, nXSize, nYSize, 
+                              pData, nBufXSize, nBufYSize, 
+                              eBufType, nPixelSpace, nLineSpace ) == CE_None )
+            return CE_None;
+    }
+
+    /* Sources may have been added since the expression was compiled */
+    if (poExpression->GetSourceCount() != nSources) {
+        CPLString osExpression = poExpression->GetExpression();
+        if (!poExpression->Compile(osExpression, nSources))
+            return CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Requests at full resolution are processed by strips of lines.   */
+/*      Others are processed at once, as splitting them would change    */
+/*      the way source pixels are picked.                               */
+/* -------------------------------------------------------------------- */
+    int nStripLines = nBufYSize;
+    if (nBufXSize == nXSize && nBufYSize == nYSize) {
+        GIntBig nLineBytes = (GIntBig) MAX(1, nSources) * nBufXSize * sizeof(double);
+        nStripLines = (int) MAX(1, MIN((GIntBig) nBufYSize,
+                                       VRT_EXPR_STRIP_BYTES / nLineBytes));
+    }
+
+    size_t nStripValues = (size_t) nBufXSize * nStripLines;
+    double *padfStrips = (double *)
+        VSIMalloc2(MAX(1, nSources) * sizeof(double), nStripValues);
+    double *padfWork = (double *)
+        VSIMalloc2(MAX(1, poExpression->GetWorkSlotCount()) + 1,
+                   VRT_EXPR_CHUNK * sizeof(double));
+    std::vector<const double *> apadfSources(MAX(1, nSources));
+
+    if (padfStrips == NULL || padfWork == NULL) {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+                  "VRTDerivedRasterBand::ExpressionRasterIO(): "
+                  "Out of memory." );
+        VSIFree(padfStrips);
+        VSIFree(padfWork);
+        return CE_Failure;
+    }
+
+    double *padfResult = padfWork
+        + (size_t) poExpression->GetWorkSlotCount() * VRT_EXPR_CHUNK;
+
+    for (int iStripLine = 0; eErr == CE_None && iStripLine < nBufYSize;
+         iStripLine += nStripLines) {
+        int nLines = MIN(nStripLines, nBufYSize - iStripLine);
+
+/* -------------------------------------------------------------------- */
+/*      Load the sources, on top of the nodata value if there is one.   */
+/* -------------------------------------------------------------------- */
+        for (iSource = 0; eErr == CE_None && iSource < nSources; iSource++) {
+            double *padfStrip = padfStrips + iSource * nStripValues;
+            double dfInit = bNoDataValueSet ? dfNoDataValue : 0.0;
+
+            for (size_t i = 0; i < (size_t) nBufXSize * nLines; i++)
+                padfStrip[i] = dfInit;
+
+            if (nStripLines == nBufYSize)
+                eErr = papoSources[iSource]->RasterIO(
+                    nXOff, nYOff, nXSize, nYSize,
+                    padfStrip, nBufXSize, nBufYSize,
+                    GDT_Float64, sizeof(double), sizeof(double) * nBufXSize);
+            else
+                eErr = papoSources[iSource]->RasterIO(
+                    nXOff, nYOff + iStripLine, nXSize, nLines,
+                    padfStrip, nBufXSize, nLines,
+                    GDT_Float64, sizeof(double), sizeof(double) * nBufXSize);
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Evaluate the expression by runs of pixels of each line.         */
+/* -------------------------------------------------------------------- */
+        for (int iLine = 0; eErr == CE_None && iLine < nLines; iLine++) {
+            for (int iX = 0; iX < nBufXSize; iX += VRT_EXPR_CHUNK) {
+                int nValues = MIN(VRT_EXPR_CHUNK, nBufXSize - iX);
+                size_t nOffset = (size_t) iLine * nBufXSize + iX;
+
+                for (iSource = 0; iSource < nSources; iSource++)
+                    apadfSources[iSource] =
+                        padfStrips + iSource * nStripValues + nOffset;
+
+                poExpression->Evaluate(&apadfSources[0], nValues,
+                                       padfWork, padfResult);
+
+                /* Pixels for which a source is nodata are nodata */
+                if (bNoDataValueSet) {
+                    for (iSource = 0; iSource < nSources; iSource++) {
+                        const double *padfSrc = apadfSources[iSource];
+                        for (int i = 0; i < nValues; i++) {
+                            if (padfSrc[i] == dfNoDataValue
+                                || (CPLIsNan(padfSrc[i])
+                                    && CPLIsNan(dfNoDataValue)))
+                                padfResult[i] = dfNoDataValue;
+                        }
+                    }
+                    for (int i = 0; i < nValues; i++) {
+                        if (CPLIsNan(padfResult[i]))
+                            padfResult[i] = dfNoDataValue;
+                    }
+                }
+
+                GDALCopyWords(padfResult, GDT_Float64, sizeof(double),
+                              ((GByte *) pData)
+                              + (size_t) (iStripLine + iLine) * nLineSpace
+                              + (size_t) iX * nPixelSpace,
+                              eBufType, nPixelSpace, nValues);
+            }
+        }
+    }
+
+    VSIFree(padfStrips);
+    VSIFree(padfWork);
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                             IRasterIO()                              */
 /************************************************************************/
@@ -275,6 +471,11 @@ CPLErr VRTDerivedRasterBand::IRasterIO(GDALRWFlag eRWFlag,
         return CE_Failure;
     }
 
+    if( poExpression != NULL )
+        return ExpressionRasterIO( nXOff, nYOff, nXSize, nYSize,
+                                   pData, nBufXSize, nBufYSize,
+                                   eBufType, nPixelSpace, nLineSpace );
+
     typesize = GDALGetDataTypeSize(eBufType) / 8;
     if (GDALGetDataTypeSize(eBufType) % 8 > 0) typesize++;
     eSrcType = this->eSourceTransferType;
@@ -422,6 +623,12 @@ CPLErr VRTDerivedRasterBand::XMLInit(CPLXMLNode *psTree,
 	this->eSourceTransferType = GDALGetDataTypeByName(pszTypeName);
     }
 
+    /* ---- Read optional band math expression ---- */
+    const char *pszExpression =
+        CPLGetXMLValue(psTree, "PixelFunctionExpression", NULL);
+    if (pszExpression != NULL)
+        return SetPixelFunctionExpression(pszExpression);
+
     return CE_None;
 }
 
@@ -448,6 +655,9 @@ CPLXMLNode *VRTDerivedRasterBand::SerializeToXML(const char *pszVRTPath)
     if( this->eSourceTransferType != GDT_Unknown)
         CPLSetXMLValue(psTree, "SourceTransferType", 
 		       GDALGetDataTypeName(this->eSourceTransferType));
+    if( this->poExpression != NULL )
+        CPLSetXMLValue(psTree, "PixelFunctionExpression",
+                       this->poExpression->GetExpression());
 
     return psTree;
 }
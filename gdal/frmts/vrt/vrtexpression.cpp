@@ -0,0 +1,734 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  Virtual GDAL Datasets
+ * Purpose:  Compilation and evaluation of the band math expressions of
+ *           derived bands.
+ *
+ ******************************************************************************
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "vrtdataset.h"
+#include "cpl_string.h"
+
+CPL_CVSID("$Id$");
+
+/*
+ * The expression is compiled into a list of instructions working on
+ * "slots", each slot being a vector of values : the first slots are the
+ * values of the sources (B1, B2, ...), the following ones hold the
+ * intermediate results.  Operations on constants only are folded at
+ * compile time, and instructions that have a constant operand use a
+ * specific loop instead of a filled vector.
+ */
+
+enum
+{
+    VRT_EXPR_ADD, VRT_EXPR_SUB, VRT_EXPR_MUL, VRT_EXPR_DIV, VRT_EXPR_POW,
+    VRT_EXPR_MIN, VRT_EXPR_MAX, VRT_EXPR_ATAN2,
+    VRT_EXPR_LT, VRT_EXPR_LE, VRT_EXPR_GT, VRT_EXPR_GE,
+    VRT_EXPR_EQ, VRT_EXPR_NE, VRT_EXPR_AND, VRT_EXPR_OR,
+    VRT_EXPR_NEG, VRT_EXPR_NOT, VRT_EXPR_SQRT, VRT_EXPR_ABS,
+    VRT_EXPR_EXP, VRT_EXPR_LOG, VRT_EXPR_LOG10,
+    VRT_EXPR_SIN, VRT_EXPR_COS, VRT_EXPR_TAN, VRT_EXPR_ATAN,
+    VRT_EXPR_FLOOR, VRT_EXPR_CEIL,
+    VRT_EXPR_IF
+};
+
+typedef struct
+{
+    const char *pszName;
+    int         eOp;
+    int         nArgs;
+} VRTExprFunction;
+
+static const VRTExprFunction asFunctions[] =
+{
+    { "sqrt", VRT_EXPR_SQRT, 1 },
+    { "abs", VRT_EXPR_ABS, 1 },
+    { "exp", VRT_EXPR_EXP, 1 },
+    { "log", VRT_EXPR_LOG, 1 },
+    { "log10", VRT_EXPR_LOG10, 1 },
+    { "sin", VRT_EXPR_SIN, 1 },
+    { "cos", VRT_EXPR_COS, 1 },
+    { "tan", VRT_EXPR_TAN, 1 },
+    { "atan", VRT_EXPR_ATAN, 1 },
+    { "floor", VRT_EXPR_FLOOR, 1 },
+    { "ceil", VRT_EXPR_CEIL, 1 },
+    { "pow", VRT_EXPR_POW, 2 },
+    { "min", VRT_EXPR_MIN, 2 },
+    { "max", VRT_EXPR_MAX, 2 },
+    { "atan2", VRT_EXPR_ATAN2, 2 },
+    { "if", VRT_EXPR_IF, 3 },
+    { NULL, 0, 0 }
+};
+
+/************************************************************************/
+/*                          Operation functors                          */
+/************************************************************************/
+
+#define VRT_EXPR_BINARY_OP(name, expr) \
+    struct name { static inline double Eval( double a, double b ) { return expr; } };
+#define VRT_EXPR_UNARY_OP(name, expr) \
+    struct name { static inline double Eval( double a ) { return expr; } };
+
+VRT_EXPR_BINARY_OP( VRTExprAdd, a + b )
+VRT_EXPR_BINARY_OP( VRTExprSub, a - b )
+VRT_EXPR_BINARY_OP( VRTExprMul, a * b )
+VRT_EXPR_BINARY_OP( VRTExprDiv, a / b )
+VRT_EXPR_BINARY_OP( VRTExprPow, pow( a, b ) )
+VRT_EXPR_BINARY_OP( VRTExprMin, a < b ? a : b )
+VRT_EXPR_BINARY_OP( VRTExprMax, a > b ? a : b )
+VRT_EXPR_BINARY_OP( VRTExprAtan2, atan2( a, b ) )
+VRT_EXPR_BINARY_OP( VRTExprLT, a < b ? 1.0 : 0.0 )
+VRT_EXPR_BINARY_OP( VRTExprLE, a <= b ? 1.0 : 0.0 )
+VRT_EXPR_BINARY_OP( VRTExprGT, a > b ? 1.0 : 0.0 )
+VRT_EXPR_BINARY_OP( VRTExprGE, a >= b ? 1.0 : 0.0 )
+VRT_EXPR_BINARY_OP( VRTExprEQ, a == b ? 1.0 : 0.0 )
+VRT_EXPR_BINARY_OP( VRTExprNE, a != b ? 1.0 : 0.0 )
+VRT_EXPR_BINARY_OP( VRTExprAnd, (a != 0.0 && b != 0.0) ? 1.0 : 0.0 )
+VRT_EXPR_BINARY_OP( VRTExprOr, (a != 0.0 || b != 0.0) ? 1.0 : 0.0 )
+
+VRT_EXPR_UNARY_OP( VRTExprNeg, -a )
+VRT_EXPR_UNARY_OP( VRTExprNot, a == 0.0 ? 1.0 : 0.0 )
+VRT_EXPR_UNARY_OP( VRTExprSqrt, sqrt( a ) )
+VRT_EXPR_UNARY_OP( VRTExprAbs, fabs( a ) )
+VRT_EXPR_UNARY_OP( VRTExprExp, exp( a ) )
+VRT_EXPR_UNARY_OP( VRTExprLog, log( a ) )
+VRT_EXPR_UNARY_OP( VRTExprLog10, log10( a ) )
+VRT_EXPR_UNARY_OP( VRTExprSin, sin( a ) )
+VRT_EXPR_UNARY_OP( VRTExprCos, cos( a ) )
+VRT_EXPR_UNARY_OP( VRTExprTan, tan( a ) )
+VRT_EXPR_UNARY_OP( VRTExprAtan, atan( a ) )
+VRT_EXPR_UNARY_OP( VRTExprFloor, floor( a ) )
+VRT_EXPR_UNARY_OP( VRTExprCeil, ceil( a ) )
+
+/************************************************************************/
+/*                         VRTExprBinaryLoop()                          */
+/*                                                                      */
+/*      A NULL vector means that the constant is used instead.  At      */
+/*      least one of the operands is a vector.                          */
+/************************************************************************/
+
+template<class OP>
+static void VRTExprBinaryLoop( const double *padfA, double dfA,
+                               const double *padfB, double dfB,
+                               double *padfDst, int nValues )
+{
+    int i;
+
+    if( padfA != NULL && padfB != NULL )
+    {
+        for( i = 0; i < nValues; i++ )
+            padfDst[i] = OP::Eval( padfA[i], padfB[i] );
+    }
+    else if( padfA != NULL )
+    {
+        for( i = 0; i < nValues; i++ )
+            padfDst[i] = OP::Eval( padfA[i], dfB );
+    }
+    else
+    {
+        for( i = 0; i < nValues; i++ )
+            padfDst[i] = OP::Eval( dfA, padfB[i] );
+    }
+}
+
+/************************************************************************/
+/*                          VRTExprUnaryLoop()                          */
+/************************************************************************/
+
+template<class OP>
+static void VRTExprUnaryLoop( const double *padfA, double *padfDst,
+                              int nValues )
+{
+    for( int i = 0; i < nValues; i++ )
+        padfDst[i] = OP::Eval( padfA[i] );
+}
+
+/************************************************************************/
+/*                            VRTExprApply()                            */
+/************************************************************************/
+
+static void VRTExprApply( int eOp, const double **papadf,
+                          const double *padfConst,
+                          double *padfDst, int nValues )
+
+{
+    switch( eOp )
+    {
+#define BINARY_CASE(op, functor) \
+      case op: \
+        VRTExprBinaryLoop<functor>( papadf[0], padfConst[0], \
+                                    papadf[1], padfConst[1], \
+                                    padfDst, nValues ); \
+        break;
+#define UNARY_CASE(op, functor) \
+      case op: \
+        VRTExprUnaryLoop<functor>( papadf[0], padfDst, nValues ); \
+        break;
+
+      BINARY_CASE( VRT_EXPR_ADD, VRTExprAdd )
+      BINARY_CASE( VRT_EXPR_SUB, VRTExprSub )
+      BINARY_CASE( VRT_EXPR_MUL, VRTExprMul )
+      BINARY_CASE( VRT_EXPR_DIV, VRTExprDiv )
+      BINARY_CASE( VRT_EXPR_POW, VRTExprPow )
+      BINARY_CASE( VRT_EXPR_MIN, VRTExprMin )
+      BINARY_CASE( VRT_EXPR_MAX, VRTExprMax )
+      BINARY_CASE( VRT_EXPR_ATAN2, VRTExprAtan2 )
+      BINARY_CASE( VRT_EXPR_LT, VRTExprLT )
+      BINARY_CASE( VRT_EXPR_LE, VRTExprLE )
+      BINARY_CASE( VRT_EXPR_GT, VRTExprGT )
+      BINARY_CASE( VRT_EXPR_GE, VRTExprGE )
+      BINARY_CASE( VRT_EXPR_EQ, VRTExprEQ )
+      BINARY_CASE( VRT_EXPR_NE, VRTExprNE )
+      BINARY_CASE( VRT_EXPR_AND, VRTExprAnd )
+      BINARY_CASE( VRT_EXPR_OR, VRTExprOr )
+
+      UNARY_CASE( VRT_EXPR_NEG, VRTExprNeg )
+      UNARY_CASE( VRT_EXPR_NOT, VRTExprNot )
+      UNARY_CASE( VRT_EXPR_SQRT, VRTExprSqrt )
+      UNARY_CASE( VRT_EXPR_ABS, VRTExprAbs )
+      UNARY_CASE( VRT_EXPR_EXP, VRTExprExp )
+      UNARY_CASE( VRT_EXPR_LOG, VRTExprLog )
+      UNARY_CASE( VRT_EXPR_LOG10, VRTExprLog10 )
+      UNARY_CASE( VRT_EXPR_SIN, VRTExprSin )
+      UNARY_CASE( VRT_EXPR_COS, VRTExprCos )
+      UNARY_CASE( VRT_EXPR_TAN, VRTExprTan )
+      UNARY_CASE( VRT_EXPR_ATAN, VRTExprAtan )
+      UNARY_CASE( VRT_EXPR_FLOOR, VRTExprFloor )
+      UNARY_CASE( VRT_EXPR_CEIL, VRTExprCeil )
+
+#undef BINARY_CASE
+#undef UNARY_CASE
+
+      case VRT_EXPR_IF:
+      {
+          for( int i = 0; i < nValues; i++ )
+          {
+              double dfCond = papadf[0] ? papadf[0][i] : padfConst[0];
+              if( dfCond != 0.0 )
+                  padfDst[i] = papadf[1] ? papadf[1][i] : padfConst[1];
+              else
+                  padfDst[i] = papadf[2] ? papadf[2][i] : padfConst[2];
+          }
+          break;
+      }
+
+      default:
+        CPLAssert( FALSE );
+        break;
+    }
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*                            VRTExpression                             */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                           VRTExpression()                            */
+/************************************************************************/
+
+VRTExpression::VRTExpression()
+
+{
+    nSources = -1;
+    nSlots = 0;
+    nResultSlot = -1;
+    dfResultConst = 0.0;
+    pszNext = NULL;
+    bError = FALSE;
+}
+
+/************************************************************************/
+/*                           SetExpression()                            */
+/*                                                                      */
+/*      Set the expression without compiling it yet.                    */
+/************************************************************************/
+
+void VRTExpression::SetExpression( const char *pszExpression )
+
+{
+    osExpression = pszExpression;
+    nSources = -1;
+    aoInstrs.resize( 0 );
+}
+
+/************************************************************************/
+/*                              Compile()                               */
+/*                                                                      */
+/*      Compile the expression for a band with nSources sources, that   */
+/*      are referred to as B1 to Bn.  Errors are reported with          */
+/*      CPLError() and FALSE is returned.                               */
+/************************************************************************/
+
+int VRTExpression::Compile( const char *pszExpression, int nSources )
+
+{
+    this->nSources = nSources;
+    osExpression = pszExpression;
+    aoInstrs.resize( 0 );
+    nSlots = nSources;
+    anFreeSlots.resize( 0 );
+
+    pszNext = osExpression.c_str();
+    bError = FALSE;
+
+    Operand sResult = ParseOr();
+
+    SkipSpaces();
+    if( !bError && *pszNext != '\0' )
+        SetError( "unexpected character" );
+
+    if( bError )
+        return FALSE;
+
+    nResultSlot = sResult.nSlot;
+    dfResultConst = sResult.dfConst;
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                              SetError()                              */
+/************************************************************************/
+
+void VRTExpression::SetError( const char *pszMsg )
+
+{
+    if( bError )
+        return;
+
+    bError = TRUE;
+    CPLError( CE_Failure, CPLE_AppDefined,
+              "Invalid expression '%s': %s at offset %d.",
+              osExpression.c_str(), pszMsg,
+              (int) (pszNext - osExpression.c_str()) );
+}
+
+/************************************************************************/
+/*                             SkipSpaces()                             */
+/************************************************************************/
+
+void VRTExpression::SkipSpaces()
+
+{
+    while( *pszNext == ' ' || *pszNext == '\t'
+           || *pszNext == '\n' || *pszNext == '\r' )
+        pszNext++;
+}
+
+/************************************************************************/
+/*                               Accept()                               */
+/************************************************************************/
+
+int VRTExpression::Accept( const char *pszToken )
+
+{
+    SkipSpaces();
+
+    int nLen = strlen(pszToken);
+    if( strncmp( pszNext, pszToken, nLen ) != 0 )
+        return FALSE;
+
+    pszNext += nLen;
+    return TRUE;
+}
+
+/************************************************************************/
+/*                                Emit()                                */
+/*                                                                      */
+/*      Add an instruction, or fold it if all operands are constant.    */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::Emit( int eOp, int nOperands,
+                                            Operand *pasOperands )
+
+{
+    VRTExprInstr sInstr;
+    const double *apadf[3] = { NULL, NULL, NULL };
+    int i, bAllConst = TRUE;
+
+    sInstr.eOp = eOp;
+    for( i = 0; i < 3; i++ )
+    {
+        sInstr.anSlot[i] = i < nOperands ? pasOperands[i].nSlot : -1;
+        sInstr.adfConst[i] = i < nOperands ? pasOperands[i].dfConst : 0.0;
+        if( sInstr.anSlot[i] >= 0 )
+            bAllConst = FALSE;
+    }
+
+    Operand sResult;
+    sResult.nSlot = -1;
+    sResult.dfConst = 0.0;
+
+    if( bError )
+        return sResult;
+
+    if( bAllConst )
+    {
+        for( i = 0; i < nOperands; i++ )
+            apadf[i] = &(sInstr.adfConst[i]);
+        VRTExprApply( eOp, apadf, sInstr.adfConst, &sResult.dfConst, 1 );
+        return sResult;
+    }
+
+    /* Intermediate results are only used once, so their slots can */
+    /* be reused, including for the result of this instruction. */
+    for( i = 0; i < nOperands; i++ )
+    {
+        if( sInstr.anSlot[i] >= nSources )
+            anFreeSlots.push_back( sInstr.anSlot[i] );
+    }
+
+    if( anFreeSlots.size() > 0 )
+    {
+        sInstr.nDst = anFreeSlots.back();
+        anFreeSlots.pop_back();
+    }
+    else
+        sInstr.nDst = nSlots++;
+
+    aoInstrs.push_back( sInstr );
+
+    sResult.nSlot = sInstr.nDst;
+    return sResult;
+}
+
+/************************************************************************/
+/*                              ParseOr()                               */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParseOr()
+
+{
+    Operand asOp[2];
+
+    asOp[0] = ParseAnd();
+    while( !bError && Accept( "||" ) )
+    {
+        asOp[1] = ParseAnd();
+        asOp[0] = Emit( VRT_EXPR_OR, 2, asOp );
+    }
+
+    return asOp[0];
+}
+
+/************************************************************************/
+/*                              ParseAnd()                              */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParseAnd()
+
+{
+    Operand asOp[2];
+
+    asOp[0] = ParseComparison();
+    while( !bError && Accept( "&&" ) )
+    {
+        asOp[1] = ParseComparison();
+        asOp[0] = Emit( VRT_EXPR_AND, 2, asOp );
+    }
+
+    return asOp[0];
+}
+
+/************************************************************************/
+/*                          ParseComparison()                           */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParseComparison()
+
+{
+    Operand asOp[2];
+    int eOp;
+
+    asOp[0] = ParseSum();
+    if( bError )
+        return asOp[0];
+
+    if( Accept( "<=" ) )
+        eOp = VRT_EXPR_LE;
+    else if( Accept( ">=" ) )
+        eOp = VRT_EXPR_GE;
+    else if( Accept( "==" ) )
+        eOp = VRT_EXPR_EQ;
+    else if( Accept( "!=" ) )
+        eOp = VRT_EXPR_NE;
+    else if( Accept( "<" ) )
+        eOp = VRT_EXPR_LT;
+    else if( Accept( ">" ) )
+        eOp = VRT_EXPR_GT;
+    else
+        return asOp[0];
+
+    asOp[1] = ParseSum();
+    return Emit( eOp, 2, asOp );
+}
+
+/************************************************************************/
+/*                              ParseSum()                              */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParseSum()
+
+{
+    Operand asOp[2];
+
+    asOp[0] = ParseProduct();
+    while( !bError )
+    {
+        int eOp;
+        if( Accept( "+" ) )
+            eOp = VRT_EXPR_ADD;
+        else if( Accept( "-" ) )
+            eOp = VRT_EXPR_SUB;
+        else
+            break;
+
+        asOp[1] = ParseProduct();
+        asOp[0] = Emit( eOp, 2, asOp );
+    }
+
+    return asOp[0];
+}
+
+/************************************************************************/
+/*                            ParseProduct()                            */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParseProduct()
+
+{
+    Operand asOp[2];
+
+    asOp[0] = ParseUnary();
+    while( !bError )
+    {
+        int eOp;
+        if( Accept( "*" ) )
+            eOp = VRT_EXPR_MUL;
+        else if( Accept( "/" ) )
+            eOp = VRT_EXPR_DIV;
+        else
+            break;
+
+        asOp[1] = ParseUnary();
+        asOp[0] = Emit( eOp, 2, asOp );
+    }
+
+    return asOp[0];
+}
+
+/************************************************************************/
+/*                             ParseUnary()                             */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParseUnary()
+
+{
+    Operand sOp;
+
+    if( Accept( "-" ) )
+    {
+        sOp = ParseUnary();
+        return Emit( VRT_EXPR_NEG, 1, &sOp );
+    }
+    if( Accept( "+" ) )
+        return ParseUnary();
+    if( Accept( "!" ) )
+    {
+        sOp = ParseUnary();
+        return Emit( VRT_EXPR_NOT, 1, &sOp );
+    }
+
+    return ParsePower();
+}
+
+/************************************************************************/
+/*                             ParsePower()                             */
+/*                                                                      */
+/*      ^ is right associative, and binds tighter than unary minus on   */
+/*      its left : -B1^2 is -(B1^2).                                    */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParsePower()
+
+{
+    Operand asOp[2];
+
+    asOp[0] = ParsePrimary();
+    if( !bError && Accept( "^" ) )
+    {
+        asOp[1] = ParseUnary();
+        return Emit( VRT_EXPR_POW, 2, asOp );
+    }
+
+    return asOp[0];
+}
+
+/************************************************************************/
+/*                            ParsePrimary()                            */
+/************************************************************************/
+
+VRTExpression::Operand VRTExpression::ParsePrimary()
+
+{
+    Operand sOp;
+    sOp.nSlot = -1;
+    sOp.dfConst = 0.0;
+
+    SkipSpaces();
+
+/* -------------------------------------------------------------------- */
+/*      Parenthesized expression.                                       */
+/* -------------------------------------------------------------------- */
+    if( Accept( "(" ) )
+    {
+        sOp = ParseOr();
+        if( !bError && !Accept( ")" ) )
+            SetError( "')' expected" );
+        return sOp;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Number.                                                         */
+/* -------------------------------------------------------------------- */
+    if( (*pszNext >= '0' && *pszNext <= '9') || *pszNext == '.' )
+    {
+        char *pszEnd = NULL;
+        sOp.dfConst = CPLStrtod( pszNext, &pszEnd );
+        if( pszEnd == pszNext )
+            SetError( "invalid number" );
+        else
+            pszNext = pszEnd;
+        return sOp;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Source reference or function call.                              */
+/* -------------------------------------------------------------------- */
+    CPLString osName;
+    while( (*pszNext >= 'a' && *pszNext <= 'z')
+           || (*pszNext >= 'A' && *pszNext <= 'Z')
+           || (*pszNext >= '0' && *pszNext <= '9')
+           || *pszNext == '_' )
+        osName += *(pszNext++);
+
+    if( osName.size() == 0 )
+    {
+        SetError( *pszNext == '\0' ? "unexpected end" : "unexpected character" );
+        return sOp;
+    }
+
+    if( (osName[0] == 'B' || osName[0] == 'b') && osName.size() > 1
+        && strspn( osName.c_str() + 1, "0123456789" ) == osName.size() - 1 )
+    {
+        int iSource = atoi( osName.c_str() + 1 );
+        if( iSource < 1 || iSource > nSources )
+        {
+            SetError( CPLSPrintf( "%s does not refer to one of the %d sources",
+                                  osName.c_str(), nSources ) );
+            return sOp;
+        }
+        sOp.nSlot = iSource - 1;
+        return sOp;
+    }
+
+    const VRTExprFunction *psFunc;
+    for( psFunc = asFunctions; psFunc->pszName != NULL; psFunc++ )
+    {
+        if( EQUAL( psFunc->pszName, osName ) )
+            break;
+    }
+
+    if( psFunc->pszName == NULL )
+    {
+        SetError( CPLSPrintf( "unknown identifier '%s'", osName.c_str() ) );
+        return sOp;
+    }
+
+    Operand asArgs[3];
+    if( !Accept( "(" ) )
+    {
+        SetError( "'(' expected" );
+        return sOp;
+    }
+    for( int iArg = 0; iArg < psFunc->nArgs && !bError; iArg++ )
+    {
+        if( iArg > 0 && !Accept( "," ) )
+        {
+            SetError( CPLSPrintf( "%s() expects %d arguments",
+                                  psFunc->pszName, psFunc->nArgs ) );
+            break;
+        }
+        asArgs[iArg] = ParseOr();
+    }
+    if( !bError && !Accept( ")" ) )
+        SetError( "')' expected" );
+
+    return Emit( psFunc->eOp, psFunc->nArgs, asArgs );
+}
+
+/************************************************************************/
+/*                              Evaluate()                              */
+/*                                                                      */
+/*      Evaluate the expression on nValues values of each source.       */
+/*      padfWork must have room for GetWorkSlotCount() * nValues        */
+/*      values.                                                         */
+/************************************************************************/
+
+void VRTExpression::Evaluate( const double * const *papadfSources,
+                              int nValues,
+                              double *padfWork, double *padfResult )
+
+{
+    std::vector<double *> apadfSlots( nSlots );
+    int i;
+
+    for( i = 0; i < nSources; i++ )
+        apadfSlots[i] = (double *) papadfSources[i];
+    for( i = nSources; i < nSlots; i++ )
+        apadfSlots[i] = padfWork + (size_t) (i - nSources) * nValues;
+
+    for( size_t iInstr = 0; iInstr < aoInstrs.size(); iInstr++ )
+    {
+        const VRTExprInstr &sInstr = aoInstrs[iInstr];
+        const double *apadf[3];
+
+        for( i = 0; i < 3; i++ )
+            apadf[i] = sInstr.anSlot[i] >= 0 ? apadfSlots[sInstr.anSlot[i]]
+                                             : NULL;
+
+        VRTExprApply( sInstr.eOp, apadf, sInstr.adfConst,
+                      apadfSlots[sInstr.nDst], nValues );
+    }
+
+    if( nResultSlot < 0 )
+    {
+        for( i = 0; i < nValues; i++ )
+            padfResult[i] = dfResultConst;
+    }
+    else
+        memcpy( padfResult, apadfSlots[nResultSlot],
+                sizeof(double) * nValues );
+}
@@ -33,6 +33,9 @@
 
 CPL_CVSID("$Id$");
 
+/* Approximate size of the work buffer of one strip of a filtered request */
+#define VRT_FILTER_STRIP_BYTES  (1024 * 1024)
+
 /************************************************************************/
 /* ==================================================================== */
 /*                          VRTFilteredSource                           */
@@ -173,20 +176,35 @@ VRTFilteredSource::RasterIO( int nXOff, int nYOff, int nXSize, int nYSize,
         }
     }
 
+/* -------------------------------------------------------------------- */
+/*      The request is processed by strips of lines, so that the       */
+/*      working buffers stay of a reasonable size whatever the size    */
+/*      of the request.  Each strip is loaded with the extra edge      */
+/*      lines it needs above and below.  We don't go below a few       */
+/*      times the edge size, so that the edges re-read from one strip  */
+/*      to the next stay a small fraction of the data.                 */
+/* -------------------------------------------------------------------- */
+    int nPixelOffset, nLineOffset;
+    int nExtraXSize = nBufXSize + 2 * nExtraEdgePixels;
+    int nStripLines;
+
+    nPixelOffset = GDALGetDataTypeSize( eOperDataType ) / 8;
+    nLineOffset = nPixelOffset * nExtraXSize;
+
+    nStripLines = MAX( 1, MAX( 4 * nExtraEdgePixels,
+                               VRT_FILTER_STRIP_BYTES / nLineOffset ) );
+    nStripLines = MIN( nStripLines, nBufYSize );
+
 /* -------------------------------------------------------------------- */
 /*      Allocate the buffer of data into which our imagery will be      */
 /*      read, with the extra edge pixels as well. This will be the      */
 /*      source data fed into the filter.                                */
 /* -------------------------------------------------------------------- */
-    int nPixelOffset, nLineOffset;
-    int nExtraXSize = nBufXSize + 2 * nExtraEdgePixels;
-    int nExtraYSize = nBufYSize + 2 * nExtraEdgePixels;
     GByte *pabyWorkData;
 
-    // FIXME? : risk of multiplication overflow
     pabyWorkData = (GByte *) 
-        VSICalloc( nExtraXSize * nExtraYSize,
-                   (GDALGetDataTypeSize(eOperDataType) / 8) );
+        VSICalloc( nExtraXSize, 
+                   (nStripLines + 2 * nExtraEdgePixels) * nPixelOffset );
     
     if( pabyWorkData == NULL )
     {
@@ -195,91 +213,96 @@ VRTFilteredSource::RasterIO( int nXOff, int nYOff, int nXSize, int nYSize,
         return CE_Failure;
     }
 
-    nPixelOffset = GDALGetDataTypeSize( eOperDataType ) / 8;
-    nLineOffset = nPixelOffset * nExtraXSize;
-
 /* -------------------------------------------------------------------- */
 /*      Allocate the output buffer if the passed in output buffer is    */
 /*      not of the same type as our working format, or if the passed    */
 /*      in buffer has an unusual organization.                          */
 /* -------------------------------------------------------------------- */
-    GByte *pabyOutData;
+    GByte *pabyOutData = NULL;
 
-    if( nPixelSpace != nPixelOffset || nLineSpace != nLineOffset
+    if( nPixelSpace != nPixelOffset || nLineSpace != nPixelOffset * nBufXSize
         || eOperDataType != eBufType )
     {
         pabyOutData = (GByte *) 
-            VSIMalloc3(nBufXSize, nBufYSize, nPixelOffset );
+            VSIMalloc3(nBufXSize, nStripLines, nPixelOffset );
 
         if( pabyOutData == NULL )
         {
             CPLError( CE_Failure, CPLE_OutOfMemory, 
                       "Work buffer allocation failed." );
+            VSIFree( pabyWorkData );
             return CE_Failure;
         }
     }
-    else
-        pabyOutData = (GByte *) pData;
+
+    CPLErr eErr = CE_None;
+    int    iStripY;
+
+    for( iStripY = 0; iStripY < nBufYSize && eErr == CE_None; 
+         iStripY += nStripLines )
+    {
+        int nLines = MIN( nStripLines, nBufYSize - iStripY );
+        int nExtraYSize = nLines + 2 * nExtraEdgePixels;
+        GByte *pabyStripOutData;
+
+        if( pabyOutData != NULL )
+            pabyStripOutData = pabyOutData;
+        else
+            pabyStripOutData = ((GByte *) pData) + iStripY * nLineSpace;
 
 /* -------------------------------------------------------------------- */
 /*      Figure out the extended window that we want to load.  Note      */
 /*      that we keep track of the file window as well as the amount     */
 /*      we will need to edge fill past the edge of the source dataset.  */
 /* -------------------------------------------------------------------- */
-    int nTopFill=0, nLeftFill=0, nRightFill=0, nBottomFill=0;
-    int nFileXOff, nFileYOff, nFileXSize, nFileYSize;
+        int nTopFill=0, nLeftFill=0, nRightFill=0, nBottomFill=0;
+        int nFileXOff, nFileYOff, nFileXSize, nFileYSize;
 
-    nFileXOff = nXOff - nExtraEdgePixels;
-    nFileYOff = nYOff - nExtraEdgePixels;
-    nFileXSize = nExtraXSize;
-    nFileYSize = nExtraYSize;
+        nFileXOff = nXOff - nExtraEdgePixels;
+        nFileYOff = nYOff + iStripY - nExtraEdgePixels;
+        nFileXSize = nExtraXSize;
+        nFileYSize = nExtraYSize;
 
-    if( nFileXOff < 0 )
-    {
-        nLeftFill = -nFileXOff;
-        nFileXOff = 0;
-        nFileXSize -= nLeftFill;
-    }
+        if( nFileXOff < 0 )
+        {
+            nLeftFill = -nFileXOff;
+            nFileXOff = 0;
+            nFileXSize -= nLeftFill;
+        }
 
-    if( nFileYOff < 0 )
-    {
-        nTopFill = -nFileYOff;
-        nFileYOff = 0;
-        nFileYSize -= nTopFill;
-    }
+        if( nFileYOff < 0 )
+        {
+            nTopFill = -nFileYOff;
+            nFileYOff = 0;
+            nFileYSize -= nTopFill;
+        }
 
-    if( nFileXOff + nFileXSize > poRasterBand->GetXSize() )
-    {
-        nRightFill = nFileXOff + nFileXSize - poRasterBand->GetXSize();
-        nFileXSize -= nRightFill;
-    }
+        if( nFileXOff + nFileXSize > poRasterBand->GetXSize() )
+        {
+            nRightFill = nFileXOff + nFileXSize - poRasterBand->GetXSize();
+            nFileXSize -= nRightFill;
+        }
 
-    if( nFileYOff + nFileYSize > poRasterBand->GetYSize() )
-    {
-        nBottomFill = nFileYOff + nFileYSize - poRasterBand->GetYSize();
-        nFileYSize -= nBottomFill;
-    }
+        if( nFileYOff + nFileYSize > poRasterBand->GetYSize() )
+        {
+            nBottomFill = nFileYOff + nFileYSize - poRasterBand->GetYSize();
+            nFileYSize -= nBottomFill;
+        }
 
 /* -------------------------------------------------------------------- */
 /*      Load the data.                                                  */
 /* -------------------------------------------------------------------- */
-    CPLErr eErr;
-
-    eErr = 
-      VRTComplexSource::RasterIO( nFileXOff, nFileYOff, nFileXSize, nFileYSize,
-                                  pabyWorkData 
-                                  + nLineOffset * nTopFill
-                                  + nPixelOffset * nLeftFill,
-                                  nFileXSize, nFileYSize, eOperDataType, 
-                                  nPixelOffset, nLineOffset );
-
-    if( eErr != CE_None )
-    {
-        if( pabyWorkData != pData )
-            VSIFree( pabyWorkData );
-
-        return eErr;
-    }
+        eErr = 
+          VRTComplexSource::RasterIO( nFileXOff, nFileYOff, 
+                                      nFileXSize, nFileYSize,
+                                      pabyWorkData 
+                                      + nLineOffset * nTopFill
+                                      + nPixelOffset * nLeftFill,
+                                      nFileXSize, nFileYSize, eOperDataType, 
+                                      nPixelOffset, nLineOffset );
+
+        if( eErr != CE_None )
+            break;
 
 /* -------------------------------------------------------------------- */
 /*      Fill in missing areas.  Note that we replicate the edge         */
@@ -287,72 +310,71 @@ VRTFilteredSource::RasterIO( int nXOff, int nYOff, int nXSize, int nYSize,
 /*      more suitable for some times of filters.  We also don't mark    */
 /*      these pixels as "nodata" though perhaps we should.              */
 /* -------------------------------------------------------------------- */
-    if( nLeftFill != 0 || nRightFill != 0 )
-    {
-        for( i = nTopFill; i < nExtraYSize - nBottomFill; i++ )
+        if( nLeftFill != 0 || nRightFill != 0 )
         {
-            if( nLeftFill != 0 )
-                GDALCopyWords( pabyWorkData + nPixelOffset * nLeftFill
-                               + i * nLineOffset, eOperDataType, 0, 
-                               pabyWorkData + i * nLineOffset, eOperDataType, 
-                               nPixelOffset, nLeftFill );
-
-            if( nRightFill != 0 )
-                GDALCopyWords( pabyWorkData + i * nLineOffset
-                               + nPixelOffset * (nExtraXSize - nRightFill - 1),
-                               eOperDataType, 0, 
-                               pabyWorkData + i * nLineOffset
-                               + nPixelOffset * (nExtraXSize - nRightFill),
-                               eOperDataType, nPixelOffset, nRightFill );
+            for( i = nTopFill; i < nExtraYSize - nBottomFill; i++ )
+            {
+                if( nLeftFill != 0 )
+                    GDALCopyWords( pabyWorkData + nPixelOffset * nLeftFill
+                                   + i * nLineOffset, eOperDataType, 0, 
+                                   pabyWorkData + i * nLineOffset, 
+                                   eOperDataType, nPixelOffset, nLeftFill );
+
+                if( nRightFill != 0 )
+                    GDALCopyWords( pabyWorkData + i * nLineOffset
+                                   + nPixelOffset 
+                                   * (nExtraXSize - nRightFill - 1),
+                                   eOperDataType, 0, 
+                                   pabyWorkData + i * nLineOffset
+                                   + nPixelOffset * (nExtraXSize - nRightFill),
+                                   eOperDataType, nPixelOffset, nRightFill );
+            }
         }
-    }
 
-    for( i = 0; i < nTopFill; i++ )
-    {
-        memcpy( pabyWorkData + i * nLineOffset, 
-                pabyWorkData + nTopFill * nLineOffset, 
-                nLineOffset );
-    }
+        for( i = 0; i < nTopFill; i++ )
+        {
+            memcpy( pabyWorkData + i * nLineOffset, 
+                    pabyWorkData + nTopFill * nLineOffset, 
+                    nLineOffset );
+        }
 
-    for( i = nExtraYSize - nBottomFill; i < nExtraYSize; i++ )
-    {
-        memcpy( pabyWorkData + i * nLineOffset, 
-                pabyWorkData + (nExtraYSize - nBottomFill - 1) * nLineOffset, 
-                nLineOffset );
-    }
+        for( i = nExtraYSize - nBottomFill; i < nExtraYSize; i++ )
+        {
+            memcpy( pabyWorkData + i * nLineOffset, 
+                    pabyWorkData + (nExtraYSize - nBottomFill - 1) 
+                    * nLineOffset, 
+                    nLineOffset );
+        }
     
 /* -------------------------------------------------------------------- */
 /*      Filter the data.                                                */
 /* -------------------------------------------------------------------- */
-    eErr = FilterData( nBufXSize, nBufYSize, eOperDataType, 
-                       pabyWorkData, pabyOutData );
-
-    VSIFree( pabyWorkData );
-    if( eErr != CE_None )
-    {
-        if( pabyOutData != pData )
-            VSIFree( pabyOutData );
+        eErr = FilterData( nBufXSize, nLines, eOperDataType, 
+                           pabyWorkData, pabyStripOutData );
 
-        return eErr;
-    }
+        if( eErr != CE_None )
+            break;
     
 /* -------------------------------------------------------------------- */
 /*      Copy from work buffer to target buffer.                         */
 /* -------------------------------------------------------------------- */
-    if( pabyOutData != pData )
-    {
-        for( i = 0; i < nBufYSize; i++ )
+        if( pabyOutData != NULL )
         {
-            GDALCopyWords( pabyOutData + i * (nPixelOffset * nBufXSize),
-                           eOperDataType, nPixelOffset,
-                           ((GByte *) pData) + i * nLineSpace, 
-                           eBufType, nPixelSpace, nBufXSize );
+            for( i = 0; i < nLines; i++ )
+            {
+                GDALCopyWords( pabyOutData + i * (nPixelOffset * nBufXSize),
+                               eOperDataType, nPixelOffset,
+                               ((GByte *) pData) 
+                               + (iStripY + i) * nLineSpace, 
+                               eBufType, nPixelSpace, nBufXSize );
+            }
         }
-
-        VSIFree( pabyOutData );
     }
 
-    return CE_None;
+    VSIFree( pabyWorkData );
+    VSIFree( pabyOutData );
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -370,6 +392,8 @@ VRTKernelFilteredSource::VRTKernelFilteredSource()
 {
     GDALDataType aeSupTypes[] = { GDT_Float32 };
     padfKernelCoefs = NULL;
+    padfRowCoefs = NULL;
+    padfColumnCoefs = NULL;
     nKernelSize = 0;
     bNormalized = FALSE;
 
@@ -384,6 +408,8 @@ VRTKernelFilteredSource::~VRTKernelFilteredSource()
 
 {
     CPLFree( padfKernelCoefs );
+    CPLFree( padfRowCoefs );
+    CPLFree( padfColumnCoefs );
 }
 
 /************************************************************************/
@@ -422,6 +448,68 @@ CPLErr VRTKernelFilteredSource::SetKernel( int nNewKernelSize,
 
     SetExtraEdgePixels( (nNewKernelSize - 1) / 2 );
 
+/* -------------------------------------------------------------------- */
+/*      Check if the kernel is the outer product of a column and a     */
+/*      row vector (box, gaussian, sobel, ... kernels are), in which   */
+/*      case it can be applied as two 1D passes.  The factors are      */
+/*      taken from the row and the column of the largest coefficient.  */
+/* -------------------------------------------------------------------- */
+    CPLFree( padfRowCoefs );
+    CPLFree( padfColumnCoefs );
+    padfRowCoefs = NULL;
+    padfColumnCoefs = NULL;
+
+    int    i, j, iPivot = 0;
+    int    nCoefs = nKernelSize * nKernelSize;
+    double dfMaxAbs = 0.0;
+
+    for( i = 0; i < nCoefs; i++ )
+    {
+        if( fabs(padfKernelCoefs[i]) > dfMaxAbs )
+        {
+            dfMaxAbs = fabs(padfKernelCoefs[i]);
+            iPivot = i;
+        }
+    }
+
+    if( nKernelSize > 1 && dfMaxAbs > 0.0 )
+    {
+        int iPivotY = iPivot / nKernelSize, iPivotX = iPivot % nKernelSize;
+        int bSeparable = TRUE;
+
+        padfRowCoefs = (double *) CPLMalloc(sizeof(double) * nKernelSize);
+        padfColumnCoefs = (double *) CPLMalloc(sizeof(double) * nKernelSize);
+
+        for( i = 0; i < nKernelSize; i++ )
+        {
+            padfRowCoefs[i] = padfKernelCoefs[iPivotY * nKernelSize + i]
+                / padfKernelCoefs[iPivot];
+            padfColumnCoefs[i] = padfKernelCoefs[i * nKernelSize + iPivotX];
+        }
+
+        for( i = 0; i < nKernelSize && bSeparable; i++ )
+        {
+            for( j = 0; j < nKernelSize; j++ )
+            {
+                if( fabs(padfKernelCoefs[i * nKernelSize + j] 
+                         - padfColumnCoefs[i] * padfRowCoefs[j])
+                    > 1e-10 * dfMaxAbs )
+                {
+                    bSeparable = FALSE;
+                    break;
+                }
+            }
+        }
+
+        if( !bSeparable )
+        {
+            CPLFree( padfRowCoefs );
+            CPLFree( padfColumnCoefs );
+            padfRowCoefs = NULL;
+            padfColumnCoefs = NULL;
+        }
+    }
+
     return CE_None;
 }
 
@@ -448,15 +536,16 @@ FilterData( int nXSize, int nYSize, GDALDataType eType,
     CPLAssert( nExtraEdgePixels*2 + 1 == nKernelSize );
 
 /* -------------------------------------------------------------------- */
-/*      Float32 case.                                                   */
+/*      Float32 case, with nodata.  Nodata pixels are skipped, so the  */
+/*      kernel has to be applied pixel per pixel.                      */
 /* -------------------------------------------------------------------- */
-    if( eType == GDT_Float32 )
+    int bHasNoData;
+    float fNoData = (float) poRasterBand->GetNoDataValue(&bHasNoData);
+
+    if( bHasNoData )
     {
         int iX, iY;
 
-        int bHasNoData;
-        float fNoData = (float) poRasterBand->GetNoDataValue(&bHasNoData);
-
         for( iY = 0; iY < nYSize; iY++ )
         {
             for( iX = 0; iX < nXSize; iX++ )
@@ -468,7 +557,7 @@ FilterData( int nXSize, int nYSize, GDALDataType eType,
                 float  fCenter = ((float *)pabySrcData)[iIndex];
 
                 // Check if center srcpixel is NoData
-                if(!bHasNoData || fCenter != fNoData)
+                if(fCenter != fNoData)
                 {
                     for( iYY = 0; iYY < nKernelSize; iYY++ )
                     {
@@ -478,7 +567,7 @@ FilterData( int nXSize, int nYSize, GDALDataType eType,
 
                         for( i = 0; i < nKernelSize; i++, pafData++, iKern++ )
                         {
-                            if(!bHasNoData || *pafData != fNoData)
+                            if(*pafData != fNoData)
                             {
                                 dfSum += *pafData * padfKernelCoefs[iKern];
                                 dfKernSum += padfKernelCoefs[iKern];
@@ -501,8 +590,128 @@ FilterData( int nXSize, int nYSize, GDALDataType eType,
                     ((float *) pabyDstData)[iX + iY * nXSize] = fNoData;
             }
         }
+
+        return CE_None;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Float32 case, without nodata.  The kernel is applied a whole   */
+/*      line at a time, one coefficient after the other, so that the   */
+/*      inner loops run over contiguous pixels and can be vectorized   */
+/*      by the compiler.  The sum of each pixel is accumulated in the  */
+/*      same order as above.                                           */
+/* -------------------------------------------------------------------- */
+    int    iX, iY, iKern;
+    int    nSrcXSize = nXSize + 2 * nExtraEdgePixels;
+    int    nSrcYSize = nYSize + 2 * nExtraEdgePixels;
+    float  *pafSrcData = (float *) pabySrcData;
+    float  *pafDstData = (float *) pabyDstData;
+    double dfKernSum = 0.0;
+    double *padfLineSum;
+
+    for( iKern = 0; iKern < nKernelSize * nKernelSize; iKern++ )
+        dfKernSum += padfKernelCoefs[iKern];
+
+    padfLineSum = (double *) VSIMalloc2( nXSize, sizeof(double) );
+    if( padfLineSum == NULL )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory, 
+                  "Work buffer allocation failed." );
+        return CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      For a separable kernel, filter the lines horizontally first,   */
+/*      and then filter the result vertically.  This costs 2 * N       */
+/*      operations per pixel instead of N * N.                         */
+/* -------------------------------------------------------------------- */
+    double *padfRowFiltered = NULL;
+
+    if( padfRowCoefs != NULL
+        && CSLTestBoolean(CPLGetConfigOption("VRT_SEPARABLE_KERNEL", "YES")) )
+    {
+        padfRowFiltered = (double *) 
+            VSIMalloc3( nXSize, nSrcYSize, sizeof(double) );
     }
 
+    if( padfRowFiltered != NULL )
+    {
+        for( iY = 0; iY < nSrcYSize; iY++ )
+        {
+            double *padfLine = padfRowFiltered + (size_t) iY * nXSize;
+
+            for( iX = 0; iX < nXSize; iX++ )
+                padfLine[iX] = 0.0;
+
+            for( iKern = 0; iKern < nKernelSize; iKern++ )
+            {
+                const double dfCoef = padfRowCoefs[iKern];
+                const float *pafSrc = pafSrcData 
+                    + (size_t) iY * nSrcXSize + iKern;
+
+                for( iX = 0; iX < nXSize; iX++ )
+                    padfLine[iX] += dfCoef * pafSrc[iX];
+            }
+        }
+    }
+
+    for( iY = 0; iY < nYSize; iY++ )
+    {
+        for( iX = 0; iX < nXSize; iX++ )
+            padfLineSum[iX] = 0.0;
+
+        if( padfRowFiltered != NULL )
+        {
+            for( iKern = 0; iKern < nKernelSize; iKern++ )
+            {
+                const double dfCoef = padfColumnCoefs[iKern];
+                const double *padfSrc = padfRowFiltered 
+                    + (size_t) (iY + iKern) * nXSize;
+
+                for( iX = 0; iX < nXSize; iX++ )
+                    padfLineSum[iX] += dfCoef * padfSrc[iX];
+            }
+        }
+        else
+        {
+            int iYY, i;
+
+            for( iYY = 0, iKern = 0; iYY < nKernelSize; iYY++ )
+            {
+                for( i = 0; i < nKernelSize; i++, iKern++ )
+                {
+                    const double dfCoef = padfKernelCoefs[iKern];
+                    const float *pafSrc = pafSrcData 
+                        + (size_t) (iY + iYY) * nSrcXSize + i;
+
+                    for( iX = 0; iX < nXSize; iX++ )
+                        padfLineSum[iX] += dfCoef * pafSrc[iX];
+                }
+            }
+        }
+
+        float *pafDstLine = pafDstData + (size_t) iY * nXSize;
+
+        if( !bNormalized )
+        {
+            for( iX = 0; iX < nXSize; iX++ )
+                pafDstLine[iX] = (float) padfLineSum[iX];
+        }
+        else if( dfKernSum != 0.0 )
+        {
+            for( iX = 0; iX < nXSize; iX++ )
+                pafDstLine[iX] = (float) (padfLineSum[iX] / dfKernSum);
+        }
+        else
+        {
+            for( iX = 0; iX < nXSize; iX++ )
+                pafDstLine[iX] = 0.0;
+        }
+    }
+
+    VSIFree( padfRowFiltered );
+    VSIFree( padfLineSum );
+
     return CE_None;
 }
 
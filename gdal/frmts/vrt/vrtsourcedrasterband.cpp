@@ -30,9 +30,128 @@
 #include "vrtdataset.h"
 #include "cpl_minixml.h"
 #include "cpl_string.h"
+#include "cpl_multiproc.h"
+#include <algorithm>
 
 CPL_CVSID("$Id$");
 
+/* Bands with fewer sources than this are just scanned linearly */
+#define VRT_MIN_SOURCES_FOR_INDEX   64
+
+/* Requests smaller than this (in buffer pixels) are never read with */
+/* several threads, as starting them would cost more than it saves */
+#define VRT_MIN_PIXELS_FOR_THREADS  65536
+
+/* Bound on the number of sources whose conflicts are checked pairwise */
+#define VRT_MAX_SOURCES_PER_SCHEDULE 1024
+
+/************************************************************************/
+/* ==================================================================== */
+/*                            VRTSourceIndex                            */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                           VRTSourceIndex()                           */
+/************************************************************************/
+
+VRTSourceIndex::VRTSourceIndex( int nXSize, int nYSize,
+                                int nSources, VRTSource **papoSources )
+
+{
+    nIndexedSources = nSources;
+    papoIndexedSources = papoSources;
+    nIndexedGeneration = VRTSource::nDstWindowGeneration;
+    bValid = TRUE;
+
+/* -------------------------------------------------------------------- */
+/*      Aim at roughly one source per cell for a regular mosaic.        */
+/* -------------------------------------------------------------------- */
+    double dfCellSize = sqrt( (double)nXSize * nYSize / MAX(1,nSources) );
+    nCellSize = (int) MAX( 16.0, MIN( dfCellSize, (double)MAX(nXSize,nYSize) ) );
+    nCellsX = MAX( 1, (nXSize + nCellSize - 1) / nCellSize );
+    nCellsY = MAX( 1, (nYSize + nCellSize - 1) / nCellSize );
+
+    aanCells.resize( nCellsX * nCellsY );
+
+/* -------------------------------------------------------------------- */
+/*      Register each source in all the cells touched by its            */
+/*      destination window. The window is taken with its end           */
+/*      included, to match the miss test of GetSrcDstWindow(). Parts    */
+/*      outside of the band fall in the border cells.                   */
+/* -------------------------------------------------------------------- */
+    GIntBig nEntries = 0;
+    GIntBig nMaxEntries = (GIntBig) nSources * 32 + nCellsX * nCellsY;
+
+    for( int iSource = 0; iSource < nSources; iSource++ )
+    {
+        int nDstXOff, nDstYOff, nDstXSize, nDstYSize;
+
+        if( !papoSources[iSource]->GetDstWindow( &nDstXOff, &nDstYOff,
+                                                 &nDstXSize, &nDstYSize )
+            || nDstXSize < 0 || nDstYSize < 0 )
+        {
+            anUnindexed.push_back( iSource );
+            continue;
+        }
+
+        int nX0 = MAX( 0, MIN( nCellsX - 1, nDstXOff / nCellSize ) );
+        int nX1 = MAX( 0, MIN( nCellsX - 1, (nDstXOff + nDstXSize) / nCellSize ) );
+        int nY0 = MAX( 0, MIN( nCellsY - 1, nDstYOff / nCellSize ) );
+        int nY1 = MAX( 0, MIN( nCellsY - 1, (nDstYOff + nDstYSize) / nCellSize ) );
+
+        nEntries += (GIntBig)(nX1 - nX0 + 1) * (nY1 - nY0 + 1);
+        if( nEntries > nMaxEntries )
+        {
+            /* Mostly overlapping sources : the index would not help */
+            CPLDebug( "VRT", "Too many overlapping sources, not indexing them." );
+            bValid = FALSE;
+            aanCells.clear();
+            anUnindexed.clear();
+            return;
+        }
+
+        for( int iY = nY0; iY <= nY1; iY++ )
+        {
+            for( int iX = nX0; iX <= nX1; iX++ )
+                aanCells[iY * nCellsX + iX].push_back( iSource );
+        }
+    }
+}
+
+/************************************************************************/
+/*                             GetSources()                             */
+/*                                                                      */
+/*      Return the indices of the sources that may intersect the        */
+/*      window, in increasing order so that they get composited in     */
+/*      the same order as without the index.                            */
+/************************************************************************/
+
+void VRTSourceIndex::GetSources( int nXOff, int nYOff, int nXSize, int nYSize,
+                                 std::vector<int>& anSources )
+
+{
+    int nX0 = MAX( 0, MIN( nCellsX - 1, nXOff / nCellSize ) );
+    int nX1 = MAX( 0, MIN( nCellsX - 1, (nXOff + nXSize) / nCellSize ) );
+    int nY0 = MAX( 0, MIN( nCellsY - 1, nYOff / nCellSize ) );
+    int nY1 = MAX( 0, MIN( nCellsY - 1, (nYOff + nYSize) / nCellSize ) );
+
+    anSources = anUnindexed;
+
+    for( int iY = nY0; iY <= nY1; iY++ )
+    {
+        for( int iX = nX0; iX <= nX1; iX++ )
+        {
+            const std::vector<int>& anCell = aanCells[iY * nCellsX + iX];
+            anSources.insert( anSources.end(), anCell.begin(), anCell.end() );
+        }
+    }
+
+    std::sort( anSources.begin(), anSources.end() );
+    anSources.erase( std::unique( anSources.begin(), anSources.end() ),
+                     anSources.end() );
+}
+
 /************************************************************************/
 /* ==================================================================== */
 /*                          VRTSourcedRasterBand                        */
@@ -95,6 +214,7 @@ void VRTSourcedRasterBand::Initialize( int nXSize, int nYSize )
     papoSources = NULL;
     bEqualAreas = FALSE;
     bAlreadyInIRasterIO = FALSE;
+    poSourceIndex = NULL;
 }
 
 /************************************************************************/
@@ -118,7 +238,6 @@ CPLErr VRTSourcedRasterBand::IRasterIO( GDALRWFlag eRWFlag,
                                  int nPixelSpace, int nLineSpace )
 
 {
-    int         iSource;
     CPLErr      eErr = CE_None;
 
     if( eRWFlag == GF_Write )
@@ -207,19 +326,308 @@ CPLErr VRTSourcedRasterBand::IRasterIO( GDALRWFlag eRWFlag,
 /* -------------------------------------------------------------------- */
 /*      Overlay each source in turn over top this.                      */
 /* -------------------------------------------------------------------- */
-    for( iSource = 0; eErr == CE_None && iSource < nSources; iSource++ )
-    {
-        eErr = 
-            papoSources[iSource]->RasterIO( nXOff, nYOff, nXSize, nYSize, 
-                                            pData, nBufXSize, nBufYSize, 
-                                            eBufType, nPixelSpace, nLineSpace);
-    }
+    std::vector<int> anSources;
+    GetSourcesInWindow( nXOff, nYOff, nXSize, nYSize, anSources );
+
+    eErr = CompositeSources( anSources, nXOff, nYOff, nXSize, nYSize, 
+                             pData, nBufXSize, nBufYSize, 
+                             eBufType, nPixelSpace, nLineSpace );
     
     bAlreadyInIRasterIO = FALSE;
     
     return eErr;
 }
 
+/************************************************************************/
+/*                          VRTSourceJobQueue                           */
+/*                                                                      */
+/*      State shared by the threads reading a batch of sources.         */
+/************************************************************************/
+
+typedef struct
+{
+    VRTSource     **papoSources;
+    const int      *panJobs;
+    int             nJobs;
+    int             iNextJob;
+    void           *hJobMutex;
+
+    int             nXOff, nYOff, nXSize, nYSize;
+    void           *pData;
+    int             nBufXSize, nBufYSize;
+    GDALDataType    eBufType;
+    int             nPixelSpace, nLineSpace;
+    int             nBandCount;
+    int            *panBandMap;
+    int             nBandSpace;
+
+    int             bStop;          /* set once a source failed */
+} VRTSourceJobQueue;
+
+/************************************************************************/
+/*                         VRTReadOneSource()                           */
+/************************************************************************/
+
+static CPLErr VRTReadOneSource( VRTSource *poSource, 
+                                const VRTSourceJobQueue *psQ )
+
+{
+    if( psQ->nBandCount == 0 )
+        return poSource->RasterIO( psQ->nXOff, psQ->nYOff,
+                                   psQ->nXSize, psQ->nYSize,
+                                   psQ->pData, psQ->nBufXSize, psQ->nBufYSize,
+                                   psQ->eBufType,
+                                   psQ->nPixelSpace, psQ->nLineSpace );
+
+    /* Only simple sources are used for dataset level requests */
+    /* (see VRTDataset::CheckCompatibleForDatasetIO()) */
+    return ((VRTSimpleSource *) poSource)->DatasetRasterIO(
+                                   psQ->nXOff, psQ->nYOff,
+                                   psQ->nXSize, psQ->nYSize,
+                                   psQ->pData, psQ->nBufXSize, psQ->nBufYSize,
+                                   psQ->eBufType,
+                                   psQ->nBandCount, psQ->panBandMap,
+                                   psQ->nPixelSpace, psQ->nLineSpace,
+                                   psQ->nBandSpace );
+}
+
+/************************************************************************/
+/*                         VRTRunSourceJobs()                           */
+/*                                                                      */
+/*      Pick sources from the queue until it is empty, or until one     */
+/*      of them failed.  Run by each thread of CPLRunJobs().            */
+/************************************************************************/
+
+static CPLErr VRTRunSourceJobs( void *pQueue )
+
+{
+    VRTSourceJobQueue *psQ = (VRTSourceJobQueue *) pQueue;
+
+    while( TRUE )
+    {
+        int iJob;
+
+        CPLAcquireMutex( psQ->hJobMutex, 1000.0 );
+        if( psQ->bStop || psQ->iNextJob >= psQ->nJobs )
+        {
+            CPLReleaseMutex( psQ->hJobMutex );
+            return CE_None;
+        }
+        iJob = psQ->iNextJob++;
+        CPLReleaseMutex( psQ->hJobMutex );
+
+        CPLErr eErr = VRTReadOneSource( psQ->papoSources[psQ->panJobs[iJob]],
+                                        psQ );
+
+        if( eErr != CE_None )
+        {
+            CPLAcquireMutex( psQ->hJobMutex, 1000.0 );
+            psQ->bStop = TRUE;
+            CPLReleaseMutex( psQ->hJobMutex );
+            return eErr;
+        }
+    }
+}
+
+/************************************************************************/
+/*                        VRTSourceParallelKey()                        */
+/*                                                                      */
+/*      Return the name of the dataset read by the source if it can     */
+/*      be read concurrently with other sources, or NULL otherwise.     */
+/************************************************************************/
+
+static const char *VRTSourceParallelKey( VRTSource *poSource )
+
+{
+    if( !poSource->IsSimpleSource() )
+        return NULL;
+
+    /* Only those sources are known to write just into their DstRect */
+    const char *pszType = ((VRTSimpleSource *) poSource)->GetType();
+    if( !EQUAL(pszType, "SimpleSource") && !EQUAL(pszType, "ComplexSource")
+        && !EQUAL(pszType, "AveragedSource") )
+        return NULL;
+
+    GDALRasterBand *poBand = ((VRTSimpleSource *) poSource)->GetBand();
+    if( poBand == NULL || poBand->GetDataset() == NULL )
+        return NULL;
+
+    const char *pszName = poBand->GetDataset()->GetDescription();
+    if( pszName == NULL || pszName[0] == '\0' )
+        return NULL;
+
+    /* Nested VRTs may share underlying datasets with other sources */
+    if( EQUALN(pszName, "<VRTDataset", 11)
+        || EQUAL(CPLGetExtension(pszName), "vrt") )
+        return NULL;
+
+    return pszName;
+}
+
+/************************************************************************/
+/*                          CompositeSources()                          */
+/*                                                                      */
+/*      Overlay the passed sources, in order, over the buffer. If       */
+/*      several threads are allowed, consecutive sources writing to     */
+/*      disjoint parts of the buffer and reading different datasets     */
+/*      are read concurrently.  Sources overlapping an earlier one of   */
+/*      the same batch start a new batch, which preserves the           */
+/*      compositing order.                                              */
+/*                                                                      */
+/*      nBandCount is 0 for a band request, or the number of bands of   */
+/*      a dataset level request made of simple sources.                 */
+/************************************************************************/
+
+CPLErr VRTSourcedRasterBand::CompositeSources( const std::vector<int>& anSources,
+                                 int nXOff, int nYOff, int nXSize, int nYSize,
+                                 void * pData, int nBufXSize, int nBufYSize,
+                                 GDALDataType eBufType,
+                                 int nPixelSpace, int nLineSpace,
+                                 int nBandCount, int *panBandMap,
+                                 int nBandSpace )
+
+{
+    VRTSourceJobQueue sQueue;
+
+    sQueue.papoSources = papoSources;
+    sQueue.panJobs = NULL;
+    sQueue.nJobs = 0;
+    sQueue.iNextJob = 0;
+    sQueue.hJobMutex = NULL;
+    sQueue.nXOff = nXOff;
+    sQueue.nYOff = nYOff;
+    sQueue.nXSize = nXSize;
+    sQueue.nYSize = nYSize;
+    sQueue.pData = pData;
+    sQueue.nBufXSize = nBufXSize;
+    sQueue.nBufYSize = nBufYSize;
+    sQueue.eBufType = eBufType;
+    sQueue.nPixelSpace = nPixelSpace;
+    sQueue.nLineSpace = nLineSpace;
+    sQueue.nBandCount = nBandCount;
+    sQueue.panBandMap = panBandMap;
+    sQueue.nBandSpace = nBandSpace;
+    sQueue.bStop = FALSE;
+
+    int nThreads = 1;
+    if( poDS != NULL && anSources.size() > 1
+        && (GIntBig) nBufXSize * nBufYSize >= VRT_MIN_PIXELS_FOR_THREADS )
+        nThreads = ((VRTDataset *) poDS)->GetNumThreads();
+
+/* -------------------------------------------------------------------- */
+/*      Simple case : read the sources one after the other.             */
+/* -------------------------------------------------------------------- */
+    if( nThreads <= 1 )
+    {
+        CPLErr eErr = CE_None;
+        for( size_t i = 0; eErr == CE_None && i < anSources.size(); i++ )
+            eErr = VRTReadOneSource( papoSources[anSources[i]], &sQueue );
+        return eErr;
+    }
+
+    std::vector<void *> apQueues( nThreads, &sQueue );
+    CPLErr eErr = CE_None;
+
+    sQueue.hJobMutex = CPLCreateMutex();
+    CPLReleaseMutex( sQueue.hJobMutex );
+
+    for( size_t iChunk = 0; eErr == CE_None && iChunk < anSources.size();
+         iChunk += VRT_MAX_SOURCES_PER_SCHEDULE )
+    {
+        size_t nChunk = MIN( (size_t) VRT_MAX_SOURCES_PER_SCHEDULE,
+                             anSources.size() - iChunk );
+
+/* -------------------------------------------------------------------- */
+/*      Give each source a level greater than the one of all the        */
+/*      earlier sources it conflicts with : the ones writing into an    */
+/*      overlapping part of the buffer, or reading the same dataset.    */
+/*      The sources of a level can then be read concurrently, and the   */
+/*      levels one after the other, without changing the result.        */
+/*      Sources that cannot be read concurrently get a level of their   */
+/*      own.                                                            */
+/* -------------------------------------------------------------------- */
+        std::vector<int> anOutWindows( 4 * nChunk );
+        std::vector<int> anLevels( nChunk, -1 );
+        std::vector<const char *> apszKeys( nChunk );
+        std::vector< std::pair<int,int> > aoJobs;   /* (level, source) */
+        int nMaxLevel = -1, nBarrierLevel = -1;
+        size_t i, j;
+
+        for( i = 0; i < nChunk; i++ )
+        {
+            VRTSource *poSource = papoSources[anSources[iChunk + i]];
+            int *panWin = &anOutWindows[4 * i];
+            int nReqXOff, nReqYOff, nReqXSize, nReqYSize;
+
+            apszKeys[i] = VRTSourceParallelKey( poSource );
+
+            if( apszKeys[i] == NULL )
+            {
+                anLevels[i] = nBarrierLevel = nMaxLevel + 1;
+            }
+            else if( !((VRTSimpleSource *) poSource)->GetSrcDstWindow(
+                                nXOff, nYOff, nXSize, nYSize,
+                                nBufXSize, nBufYSize,
+                                &nReqXOff, &nReqYOff, &nReqXSize, &nReqYSize,
+                                panWin, panWin + 1, panWin + 2, panWin + 3 ) )
+            {
+                continue; /* does not touch the request at all */
+            }
+            else
+            {
+                anLevels[i] = nBarrierLevel + 1;
+
+                for( j = 0; j < i; j++ )
+                {
+                    const int *panOther = &anOutWindows[4 * j];
+
+                    if( apszKeys[j] == NULL || anLevels[j] < anLevels[i] )
+                        continue;
+
+                    if( (panWin[0] < panOther[0] + panOther[2]
+                         && panOther[0] < panWin[0] + panWin[2]
+                         && panWin[1] < panOther[1] + panOther[3]
+                         && panOther[1] < panWin[1] + panWin[3])
+                        || strcmp( apszKeys[i], apszKeys[j] ) == 0 )
+                        anLevels[i] = anLevels[j] + 1;
+                }
+            }
+
+            aoJobs.push_back( std::pair<int,int>( anLevels[i],
+                                                  anSources[iChunk + i] ) );
+            nMaxLevel = MAX( nMaxLevel, anLevels[i] );
+        }
+
+        /* Within a level, keep the original order of the sources */
+        std::sort( aoJobs.begin(), aoJobs.end() );
+
+/* -------------------------------------------------------------------- */
+/*      Read each level with the worker threads and this one.           */
+/* -------------------------------------------------------------------- */
+        std::vector<int> anBatch;
+
+        for( i = 0; eErr == CE_None && i < aoJobs.size(); )
+        {
+            anBatch.resize( 0 );
+            for( j = i; j < aoJobs.size() && aoJobs[j].first == aoJobs[i].first;
+                 j++ )
+                anBatch.push_back( aoJobs[j].second );
+            i = j;
+
+            sQueue.panJobs = &anBatch[0];
+            sQueue.nJobs = (int) anBatch.size();
+            sQueue.iNextJob = 0;
+
+            eErr = CPLRunJobs( VRTRunSourceJobs, &apQueues[0],
+                               MIN( nThreads, (int) anBatch.size() ) );
+        }
+    }
+
+    CPLDestroyMutex( sQueue.hJobMutex );
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                             IReadBlock()                             */
 /************************************************************************/
@@ -261,11 +669,69 @@ CPLErr VRTSourcedRasterBand::AddSource( VRTSource *poNewSource )
         CPLRealloc(papoSources, sizeof(void*) * nSources);
     papoSources[nSources-1] = poNewSource;
 
+    InvalidateSourceIndex();
+
     ((VRTDataset *)poDS)->SetNeedsFlush();
 
     return CE_None;
 }
 
+/************************************************************************/
+/*                        InvalidateSourceIndex()                       */
+/************************************************************************/
+
+void VRTSourcedRasterBand::InvalidateSourceIndex()
+
+{
+    delete poSourceIndex;
+    poSourceIndex = NULL;
+}
+
+/************************************************************************/
+/*                         GetSourcesInWindow()                         */
+/*                                                                      */
+/*      Return the indices of the sources that may contribute to the    */
+/*      passed window. When the band has many sources, a grid index     */
+/*      over their destination windows is lazily built so that the      */
+/*      cost of a request only depends on the number of sources it      */
+/*      actually touches.                                               */
+/************************************************************************/
+
+void VRTSourcedRasterBand::GetSourcesInWindow( int nXOff, int nYOff,
+                                               int nXSize, int nYSize,
+                                               std::vector<int>& anSources )
+
+{
+    if( nSources >= VRT_MIN_SOURCES_FOR_INDEX )
+    {
+        /* papoSources and nSources are public, and the destination */
+        /* window of a source may be changed after it was added, so check */
+        /* that the index is still in sync with them */
+        if( poSourceIndex != NULL
+            && (poSourceIndex->nIndexedSources != nSources
+                || poSourceIndex->papoIndexedSources != papoSources
+                || poSourceIndex->nIndexedGeneration
+                                    != VRTSource::nDstWindowGeneration) )
+            InvalidateSourceIndex();
+
+        if( poSourceIndex == NULL
+            && CSLTestBoolean(CPLGetConfigOption("VRT_SOURCE_INDEX", "YES")) )
+            poSourceIndex = new VRTSourceIndex( nRasterXSize, nRasterYSize,
+                                                nSources, papoSources );
+
+        if( poSourceIndex != NULL && poSourceIndex->bValid )
+        {
+            poSourceIndex->GetSources( nXOff, nYOff, nXSize, nYSize,
+                                       anSources );
+            return;
+        }
+    }
+
+    anSources.resize( nSources );
+    for( int iSource = 0; iSource < nSources; iSource++ )
+        anSources[iSource] = iSource;
+}
+
 /************************************************************************/
 /*                              VRTAddSource()                          */
 /************************************************************************/
@@ -900,6 +1366,7 @@ CPLErr VRTSourcedRasterBand::SetMetadataItem( const char *pszName,
         {
             delete papoSources[iSource];
             papoSources[iSource] = poSource;
+            InvalidateSourceIndex();
             ((VRTDataset *)poDS)->SetNeedsFlush();
             return CE_None;
         }
@@ -932,6 +1399,7 @@ CPLErr VRTSourcedRasterBand::SetMetadata( char **papszNewMD, const char *pszDoma
             CPLFree( papoSources );
             papoSources = NULL;
             nSources = 0;
+            InvalidateSourceIndex();
         }
 
         for( i = 0; i < CSLCount(papszNewMD); i++ )
@@ -985,6 +1453,8 @@ void VRTSourcedRasterBand::GetFileList(char*** ppapszFileList, int *pnSize,
 
 int VRTSourcedRasterBand::CloseDependentDatasets()
 {
+    InvalidateSourceIndex();
+
     if (nSources == 0)
         return FALSE;
 
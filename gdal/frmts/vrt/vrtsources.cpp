@@ -43,6 +43,8 @@ CPL_CVSID("$Id$");
 /* ==================================================================== */
 /************************************************************************/
 
+int VRTSource::nDstWindowGeneration = 0;
+
 VRTSource::~VRTSource()
 {
 }
@@ -56,6 +58,20 @@ void VRTSource::GetFileList(char*** ppapszFileList, int *pnSize,
 {
 }
 
+/************************************************************************/
+/*                            GetDstWindow()                            */
+/*                                                                      */
+/*      Returns the area of the band that the source may write to.     */
+/*      Sources that cannot tell return FALSE and are then assumed to   */
+/*      touch every request.                                            */
+/************************************************************************/
+
+int VRTSource::GetDstWindow( int *pnXOff, int *pnYOff,
+                             int *pnXSize, int *pnYSize )
+{
+    return FALSE;
+}
+
 /************************************************************************/
 /* ==================================================================== */
 /*                          VRTSimpleSource                             */
@@ -150,6 +166,28 @@ void VRTSimpleSource::SetDstWindow( int nNewXOff, int nNewYOff,
     nDstYOff = nNewYOff;
     nDstXSize = nNewXSize;
     nDstYSize = nNewYSize;
+
+    VRTSource::nDstWindowGeneration++;
+}
+
+/************************************************************************/
+/*                            GetDstWindow()                            */
+/************************************************************************/
+
+int VRTSimpleSource::GetDstWindow( int *pnXOff, int *pnYOff,
+                                   int *pnXSize, int *pnYSize )
+
+{
+    if( nDstXSize == -1 && nDstXOff == -1
+        && nDstYSize == -1 && nDstYOff == -1 )
+        return FALSE;
+
+    *pnXOff = nDstXOff;
+    *pnYOff = nDstYOff;
+    *pnXSize = nDstXSize;
+    *pnYSize = nDstYSize;
+
+    return TRUE;
 }
 
 /************************************************************************/
@@ -448,6 +486,7 @@ CPLErr VRTSimpleSource::XMLInit( CPLXMLNode *psSrc, const char *pszVRTPath )
     {
         nDstXOff = nDstYOff = nDstXSize = nDstYSize = -1;
     }
+    VRTSource::nDstWindowGeneration++;
 
     return CE_None;
 }
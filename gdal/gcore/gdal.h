@@ -350,6 +350,10 @@ CPLErr CPL_DLL CPL_STDCALL GDALDatasetAdviseRead( GDALDatasetH hDS,
     int nBXSize, int nBYSize, GDALDataType eBDataType,
     int nBandCount, int *panBandCount, char **papszOptions );
 
+CPLErr CPL_DLL CPL_STDCALL GDALDatasetComputeRasterSummary( GDALDatasetH hDS,
+    int nBandCount, int *panBandList, char **papszOptions,
+    GDALProgressFunc pfnProgress, void *pProgressData );
+
 const char CPL_DLL * CPL_STDCALL GDALGetProjectionRef( GDALDatasetH );
 CPLErr CPL_DLL CPL_STDCALL GDALSetProjection( GDALDatasetH, const char * );
 CPLErr CPL_DLL CPL_STDCALL GDALGetGeoTransform( GDALDatasetH, double * );
@@ -470,6 +474,12 @@ CPLErr CPL_DLL CPL_STDCALL GDALComputeRasterStatistics(
     GDALRasterBandH, int bApproxOK, 
     double *pdfMin, double *pdfMax, double *pdfMean, double *pdfStdDev,
     GDALProgressFunc pfnProgress, void *pProgressData );
+CPLErr CPL_DLL CPL_STDCALL GDALComputeRasterStatisticsAndHistogram(
+    GDALRasterBandH, int bApproxOK,
+    double *pdfMin, double *pdfMax, double *pdfMean, double *pdfStdDev,
+    double dfHistMin, double dfHistMax, int nBuckets, int *panHistogram,
+    int bIncludeOutOfRange,
+    GDALProgressFunc pfnProgress, void *pProgressData );
 CPLErr CPL_DLL CPL_STDCALL GDALSetRasterStatistics( 
     GDALRasterBandH hBand, 
     double dfMin, double dfMax, double dfMean, double dfStdDev );
@@ -768,6 +778,27 @@ GIntBig CPL_DLL CPL_STDCALL GDALGetCacheMax64(void);
 GIntBig CPL_DLL CPL_STDCALL GDALGetCacheUsed64(void);
 
 int CPL_DLL CPL_STDCALL GDALFlushCacheBlock(void);
+char CPL_DLL ** CPL_STDCALL GDALGetCacheStatistics(void);
+void CPL_DLL CPL_STDCALL GDALResetCacheStatistics(void);
+char CPL_DLL ** CPL_STDCALL GDALDatasetGetCacheStatistics( GDALDatasetH );
+
+/*! Priority classes of the blocks in the raster block cache. */
+typedef enum {
+    /*! Evicted first, once above a reserve */  GBP_Streaming = 0,
+    /*! Least recently used evicted */          GBP_Normal = 1,
+    /*! Evicted only if nothing else can be */  GBP_Pinned = 2
+} GDALBlockPriority;
+
+void CPL_DLL CPL_STDCALL GDALDatasetSetCachePriority( GDALDatasetH, 
+                                                      GDALBlockPriority );
+GDALBlockPriority CPL_DLL CPL_STDCALL 
+GDALDatasetGetCachePriority( GDALDatasetH );
+void CPL_DLL CPL_STDCALL GDALSetRasterCachePriority( GDALRasterBandH, 
+                                                     GDALBlockPriority );
+GDALBlockPriority CPL_DLL CPL_STDCALL 
+GDALGetRasterCachePriority( GDALRasterBandH );
+void CPL_DLL CPL_STDCALL GDALDatasetSetCacheQuota( GDALDatasetH, GIntBig );
+GIntBig CPL_DLL CPL_STDCALL GDALDatasetGetCacheQuota( GDALDatasetH );
 
 CPL_C_END
 
@@ -43,6 +43,7 @@ class GDALRasterAttributeTable;
 class GDALProxyDataset;
 class GDALProxyRasterBand;
 class GDALAsyncReader;
+class GDALRasterBlock;
 
 /* -------------------------------------------------------------------- */
 /*      Pull in the public declarations.  This gets the C apis, and     */
@@ -234,6 +235,65 @@ class CPL_DLL GDALOpenInfo
 
 };
 
+/* ******************************************************************** */
+/*                         GDALBlockPrefetcher                          */
+/* ******************************************************************** */
+
+class GDALDataset;
+
+//! Background loading of the blocks of a window into the block cache.
+
+class CPL_DLL GDALBlockPrefetcher
+{
+    GDALDataset        *poDS;
+
+    void               *hThreadMutex;
+    void               *hCond;     /* signaled after each loaded block */
+    volatile int        bRunning;
+    volatile int        bStop;
+    GIntBig             nWorkerPID;
+
+    /* (band number, x block offset, y block offset) triplets */
+    std::vector<int>    anBlocks;
+
+    /* The block being loaded: it is in the cache, but not read yet */
+    int                 nCurBand;
+    int                 nCurXBlock;
+    int                 nCurYBlock;
+
+    static void         ThreadMain( void * );
+
+  public:
+                        GDALBlockPrefetcher( GDALDataset * );
+                       ~GDALBlockPrefetcher();
+
+    int                 Start( int nXOff, int nYOff, int nXSize, int nYSize,
+                               int nBandCount, int *panBandMap );
+    int                 Wait( int bAbort = FALSE );
+    void                WaitForBlock( int nBand, int nXBlock, int nYBlock );
+};
+
+/* ******************************************************************** */
+/*                          GDALCacheCounters                           */
+/* ******************************************************************** */
+
+//! Counters of the block cache activity of the whole cache, or a dataset.
+
+typedef struct
+{
+    GIntBig     nHits;
+    GIntBig     nMisses;
+    GIntBig     nBytesRead;
+    double      dfReadTime;
+    GIntBig     nDirtyFlushes;
+    GIntBig     nBytesWritten;
+    double      dfWriteTime;
+    GIntBig     nEvictions;
+    GIntBig     nSyncFlushes;
+    double      dfSyncFlushTime;
+    GIntBig     nWriteBehindFlushes;
+} GDALCacheCounters;
+
 /* ******************************************************************** */
 /*                             GDALDataset                              */
 /* ******************************************************************** */
@@ -276,6 +336,27 @@ class CPL_DLL GDALDataset : public GDALMajorObject
     int         nRefCount;
     int         bShared;
 
+    GDALBlockPrefetcher *poPrefetcher;
+
+    void        *hIOMutex;
+    GDALDataset *poIOMutexOwner;
+    void        SetIOMutexOwner( GDALDataset * );
+    void        EnableWriteBehind();
+
+    GDALCacheCounters sCacheCounters;
+
+    /* Block cache policy, see SetCachePriority() and SetCacheQuota() */
+    int         bCachePolicyInitialized;
+    GDALBlockPriority eCachePriority;
+    GIntBig     nCacheQuota;
+    GIntBig     nCacheUsed;     /* protected by the block cache mutex */
+    void        InitCachePolicy();
+
+    /* Blocks of this dataset in each block cache list, in the same order,
+       so that the quota is enforced without walking the whole cache */
+    GDALRasterBlock *apoCacheOldest[GBP_Pinned + 2];
+    GDALRasterBlock *apoCacheNewest[GBP_Pinned + 2];
+
                 GDALDataset(void);
     void        RasterInitialize( int, int );
     void        SetBand( int, GDALRasterBand * );
@@ -294,9 +375,13 @@ class CPL_DLL GDALDataset : public GDALMajorObject
                                int, int *, int, int, int );
     void   BlockBasedFlushCache();
 
+    virtual CPLErr GetPixelInterleavedBlock( int nXBlockOff, int nYBlockOff,
+                                             void **ppData );
+
     virtual int         CloseDependentDatasets();
 
     friend class GDALRasterBand;
+    friend class GDALRasterBlock;
     
   public:
     virtual     ~GDALDataset();
@@ -333,6 +418,31 @@ class CPL_DLL GDALDataset : public GDALMajorObject
                                int nBandCount, int *panBandList,
                                char **papszOptions );
 
+    int         StartPrefetch( int nXOff, int nYOff, int nXSize, int nYSize,
+                               int nBandCount, int *panBandList );
+    int         WaitForPrefetch( int bAbort = FALSE )
+                    { return poPrefetcher != NULL
+                          && poPrefetcher->Wait( bAbort ); }
+    void        WaitForPrefetchedBlock( int nBand, int nXBlock, int nYBlock )
+                    { if( poPrefetcher != NULL )
+                          poPrefetcher->WaitForBlock( nBand, nXBlock,
+                                                      nYBlock ); }
+
+    void        EnterIO();
+    void        LeaveIO();
+
+    char      **GetCacheStatistics();
+
+    void        SetCachePriority( GDALBlockPriority );
+    GDALBlockPriority GetCachePriority();
+    void        SetCacheQuota( GIntBig nBytes );
+    GIntBig     GetCacheQuota();
+
+    CPLErr      ComputeRasterSummary( int nBandCount, int *panBandList,
+                                      char **papszOptions,
+                                      GDALProgressFunc pfnProgress,
+                                      void *pProgressData );
+
     virtual CPLErr          CreateMaskBand( int nFlags );
 
     virtual GDALAsyncReader* 
@@ -363,6 +473,23 @@ class CPL_DLL GDALDataset : public GDALMajorObject
     void ReportError(CPLErr eErrClass, int err_no, const char *fmt, ...)  CPL_PRINT_FUNC_FORMAT (4, 5);
 };
 
+/* ******************************************************************** */
+/*                         GDALDatasetIOHolder                          */
+/* ******************************************************************** */
+
+//! Holds the I/O mutex of a dataset, if it has one, while in scope.
+
+class CPL_DLL GDALDatasetIOHolder
+{
+    GDALDataset *poDS;
+
+  public:
+                GDALDatasetIOHolder( GDALDataset *poDSIn ) : poDS( poDSIn )
+                    { if( poDS != NULL ) poDS->EnterIO(); }
+               ~GDALDatasetIOHolder()
+                    { if( poDS != NULL ) poDS->LeaveIO(); }
+};
+
 /* ******************************************************************** */
 /*                           GDALRasterBlock                            */
 /* ******************************************************************** */
@@ -389,6 +516,19 @@ class CPL_DLL GDALRasterBlock
     GDALRasterBlock     *poNext;
     GDALRasterBlock     *poPrevious;
 
+    int                 nList;      /* LRU list the block is in, or -1 */
+
+    GDALRasterBlock     *poDSNext;      /* same list, same dataset */
+    GDALRasterBlock     *poDSPrevious;
+
+    int         GetSizeInBytes()
+                    { return (nXSize * nYSize * GDALGetDataTypeSize(eType)+7)/8; }
+
+    void        *GetDatasetIOMutex();
+
+    static void WriteBehindThread( void * );
+    static GDALCacheCounters *GetDatasetCounters( GDALRasterBand * );
+
   public:
                 GDALRasterBlock( GDALRasterBand *, int, int );
     virtual     ~GDALRasterBlock();
@@ -417,10 +557,24 @@ class CPL_DLL GDALRasterBlock
     /// @return source raster band of the raster block.
     GDALRasterBand *GetBand() { return poBand; }
 
-    static int  FlushCacheBlock();
+    static int  FlushCacheBlock( GDALDataset *poOnlyDS = NULL );
     static void Verify();
-
-    static int  SafeLockBlock( GDALRasterBlock ** );
+    static void ForgetBand( GDALRasterBand * );
+
+    static int  IsWriteBehindEnabled();
+    static void NotifyIOMutexReleased();
+
+    static double GetClock();
+    static double GetIOClock();
+    static void RecordDriverRead( GDALRasterBand *, int bCacheMiss,
+                                  int nBytes, double dfTime );
+    static void RecordDriverWrite( GDALRasterBand *, int bDirtyFlush,
+                                   int nBytes, double dfTime );
+    static char **GetCacheStatistics( GDALDataset * );
+    static void ResetCacheStatistics();
+    static void DumpCacheStatistics( GDALDataset * );
+
+    static int  SafeLockBlock( GDALRasterBlock **, int bCountHit = FALSE );
 };
 
 /* ******************************************************************** */
@@ -451,6 +605,90 @@ public:
                                    int, const GDALColorEntry * );
 };
 
+/* ******************************************************************** */
+/*                      GDALRasterStatsAccumulator                      */
+/* ******************************************************************** */
+
+//! Statistics and histogram of raster data accumulated block by block.
+
+class CPL_DLL GDALRasterStatsAccumulator
+{
+    GDALDataType eDataType;
+    int         bSignedByte;
+    int         bGotNoData;
+    double      dfNoDataValue;
+    int         nNoDataByte;    /* unsigned byte equal to nodata, or -1 */
+
+    int         bStats;
+    GIntBig     nCount;
+    double      dfMin;
+    double      dfMax;
+    double      dfSum;          /* integer data of at most 16 bits */
+    double      dfSum2;
+    double      dfMean;         /* other data types */
+    double      dfM2;
+
+    int         bHistogram;
+    double      dfHistMin;
+    double      dfHistMax;
+    double      dfHistScale;
+    int         nBuckets;
+    int         bIncludeOutOfRange;
+    GUIntBig   *panBuckets;
+
+    /* occurrences of each value of integer data of at most 16 bits */
+    int         nValueOffset;
+    int         nValueCount;
+    GUIntBig   *panValueCounts;
+
+    int         bChecksum;
+    int         nChecksumXSize;
+    GUInt32     nChecksum;
+
+    void        Reset();
+    void        MergeSums( GIntBig nCountIn, double dfMinIn, double dfMaxIn,
+                           double dfSumIn, double dfSum2In );
+    void        MergeMoments( GIntBig nCountIn, double dfMinIn, double dfMaxIn,
+                              double dfMeanIn, double dfM2In );
+
+    template<class T> void AddValues( const T *, int, int, int, int );
+    void        AddValueCounts( const void *, int, int, int );
+    void        AddByteStats( const GByte *, int, int, int );
+    void        AddFloat32Stats( const float *, int, int, int );
+    void        AddChecksum( const void *, int, int, int, int, int );
+
+  public:
+                GDALRasterStatsAccumulator( GDALDataType eDataType,
+                                            int bSignedByte,
+                                            int bGotNoData,
+                                            double dfNoDataValue );
+               ~GDALRasterStatsAccumulator();
+
+    void        RequestStatistics();
+    void        RequestHistogram( double dfMin, double dfMax, int nBuckets,
+                                  int bIncludeOutOfRange );
+    void        RequestChecksum( int nRasterXSize );
+
+    GDALRasterStatsAccumulator *Clone() const;
+
+    void        AddBlock( const void *pData, int nXSize, int nYSize,
+                          int nLineSpace, int nXOff = 0, int nYOff = 0 );
+    void        Merge( const GDALRasterStatsAccumulator *poOther );
+
+    int         GetStatistics( double *pdfMin, double *pdfMax,
+                               double *pdfMean, double *pdfStdDev,
+                               GIntBig *pnValidCount = NULL ) const;
+    void        GetHistogram( int *panHistogram ) const;
+    int         GetChecksum() const;
+
+    static CPLErr AccumulateBlocks( int nBandCount, GDALRasterBand **papoBands,
+                                    GDALRasterStatsAccumulator **papoAccums,
+                                    int nSampleRate, int bFailOnReadError,
+                                    const char *pszMessage,
+                                    GDALProgressFunc pfnProgress,
+                                    void *pProgressData );
+};
+
 /* ******************************************************************** */
 /*                            GDALRasterBand                            */
 /* ******************************************************************** */
@@ -494,12 +732,16 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     bool        bOwnMask;
     int         nMaskFlags;
 
+    int         nCachePriority; /* -1 for the one of the dataset */
+
     friend class GDALDataset;
     friend class GDALProxyRasterBand;
+    friend class GDALBlockPrefetcher;
 
   protected:
     virtual CPLErr IReadBlock( int, int, void * ) = 0;
     virtual CPLErr IWriteBlock( int, int, void * );
+    virtual int    CanReadBlockDirect();
     virtual CPLErr IRasterIO( GDALRWFlag, int, int, int, int,
                               void *, int, int, GDALDataType,
                               int, int );
@@ -510,7 +752,14 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     int            InitBlockInfo();
 
     CPLErr         AdoptBlock( int, int, GDALRasterBlock * );
-    GDALRasterBlock *TryGetLockedBlockRef( int nXBlockOff, int nYBlockYOff );
+    GDALRasterBlock *TryGetLockedBlockRef( int nXBlockOff, int nYBlockYOff,
+                                           int bCountHit = FALSE );
+
+    CPLErr         AccumulateStatistics( GDALRasterStatsAccumulator *poAccum,
+                                         int bApproxOK, int bFailOnReadError,
+                                         const char *pszMessage,
+                                         GDALProgressFunc pfnProgress,
+                                         void *pProgressData );
 
   public:
                 GDALRasterBand();
@@ -537,6 +786,9 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
                                         int bJustInitialize = FALSE );
     CPLErr      FlushBlock( int = -1, int = -1, int bWriteDirtyBlock = TRUE );
 
+    void        SetCachePriority( GDALBlockPriority );
+    GDALBlockPriority GetCachePriority();
+
     unsigned char*  GetIndexColorTranslationTo(/* const */ GDALRasterBand* poReferenceBand,
                                                unsigned char* pTranslationTable = NULL,
                                                int* pApproximateMatching = NULL);
@@ -573,6 +825,13 @@ class CPL_DLL GDALRasterBand : public GDALMajorObject
     virtual CPLErr SetStatistics( double dfMin, double dfMax, 
                                   double dfMean, double dfStdDev );
     virtual CPLErr ComputeRasterMinMax( int, double* );
+    CPLErr         ComputeStatisticsAndHistogram( int bApproxOK,
+                                      double *pdfMin, double *pdfMax,
+                                      double *pdfMean, double *pdfStdDev,
+                                      double dfHistMin, double dfHistMax,
+                                      int nBuckets, int *panHistogram,
+                                      int bIncludeOutOfRange,
+                                      GDALProgressFunc, void *pProgressData );
 
     virtual int HasArbitraryOverviews();
     virtual int GetOverviewCount();
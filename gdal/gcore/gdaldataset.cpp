@@ -194,6 +194,16 @@ GDALDataset::GDALDataset()
     papoBands = NULL;
     nRefCount = 1;
     bShared = FALSE;
+    poPrefetcher = NULL;
+    hIOMutex = NULL;
+    poIOMutexOwner = NULL;
+    memset( &sCacheCounters, 0, sizeof(sCacheCounters) );
+    bCachePolicyInitialized = FALSE;
+    eCachePriority = GBP_Normal;
+    nCacheQuota = 0;
+    nCacheUsed = 0;
+    memset( apoCacheOldest, 0, sizeof(apoCacheOldest) );
+    memset( apoCacheNewest, 0, sizeof(apoCacheNewest) );
 
 /* -------------------------------------------------------------------- */
 /*      Add this dataset to the open dataset list.                      */
@@ -299,6 +309,18 @@ GDALDataset::~GDALDataset()
         }
     }
 
+/* -------------------------------------------------------------------- */
+/*      Stop any background prefetching before the bands go away.      */
+/*      Derived classes are already destroyed at this point, so         */
+/*      GDALClose() normally took care of it before.                    */
+/* -------------------------------------------------------------------- */
+    if( poPrefetcher != NULL )
+    {
+        poPrefetcher->Wait( TRUE );
+        delete poPrefetcher;
+        poPrefetcher = NULL;
+    }
+
 /* -------------------------------------------------------------------- */
 /*      Destroy the raster bands if they exist.                         */
 /* -------------------------------------------------------------------- */
@@ -309,6 +331,11 @@ GDALDataset::~GDALDataset()
     }
 
     CPLFree( papoBands );
+
+    if( hIOMutex != NULL )
+        CPLDestroyMutex( hIOMutex );
+
+    GDALRasterBlock::DumpCacheStatistics( this );
 }
 
 /************************************************************************/
@@ -333,6 +360,10 @@ void GDALDataset::FlushCache()
 {
     int         i;
 
+    WaitForPrefetch();
+
+    GDALDatasetIOHolder oIOHolder( this );
+
     // This sometimes happens if a dataset is destroyed before completely
     // built. 
 
@@ -431,6 +462,28 @@ void GDALDataset::BlockBasedFlushCache()
     }
 }
 
+/************************************************************************/
+/*                      GetPixelInterleavedBlock()                      */
+/*                                                                      */
+/*      Drivers of pixel interleaved formats may override this to       */
+/*      return in *ppData the decoded block of all the bands, in the    */
+/*      band data type and band order, with a pixel stride of           */
+/*      nBands words.  The buffer remains owned by the dataset and is   */
+/*      only valid until the next IO on it.  *ppData is set to NULL     */
+/*      when the block cannot be provided that way, in which case       */
+/*      BlockBasedRasterIO() goes through the block cache for this      */
+/*      block, and still asks for the next ones.                        */
+/************************************************************************/
+
+CPLErr GDALDataset::GetPixelInterleavedBlock( int nXBlockOff, int nYBlockOff,
+                                              void **ppData )
+
+{
+    *ppData = NULL;
+
+    return CE_None;
+}
+
 /************************************************************************/
 /*                          RasterInitialize()                          */
 /*                                                                      */
@@ -1596,6 +1649,10 @@ CPLErr GDALDataset::RasterIO( GDALRWFlag eRWFlag,
     int bNeedToFreeBandMap = FALSE;
     CPLErr eErr = CE_None;
 
+    WaitForPrefetch();
+
+    GDALDatasetIOHolder oIOHolder( this );
+
     if( NULL == pData )
     {
         ReportError( CE_Failure, CPLE_AppDefined,
@@ -1904,7 +1961,11 @@ int CPL_STDCALL GDALGetAccess( GDALDatasetH hDS )
  * nBandCount bands.
  *
  * @param papszOptions a list of name=value strings with special control 
- * options.  Normally this is NULL.
+ * options.  Normally this is NULL.  The default implementation recognises
+ * PREFETCH=YES to load the blocks of the window into the block cache in a
+ * background thread (see StartPrefetch()) when the request is at full
+ * resolution, and prefetching is enabled with the GDAL_PREFETCH
+ * configuration option.
  *
  * @return CE_Failure if the request is invalid and CE_None if it works or
  * is ignored. 
@@ -1919,6 +1980,12 @@ CPLErr GDALDataset::AdviseRead( int nXOff, int nYOff, int nXSize, int nYSize,
 {
     int iBand;
 
+    if( CSLFetchBoolean( papszOptions, "PREFETCH", FALSE )
+        && nBufXSize == nXSize && nBufYSize == nYSize )
+    {
+        StartPrefetch( nXOff, nYOff, nXSize, nYSize, nBandCount, panBandMap );
+    }
+
     for( iBand = 0; iBand < nBandCount; iBand++ )
     {
         CPLErr eErr;
@@ -1939,6 +2006,459 @@ CPLErr GDALDataset::AdviseRead( int nXOff, int nYOff, int nXSize, int nYSize,
     return CE_None;
 }
 
+/************************************************************************/
+/*                           StartPrefetch()                            */
+/************************************************************************/
+
+/**
+ * \brief Start loading a window into the block cache in the background.
+ *
+ * The blocks of the requested bands intersecting the window are read
+ * through GetLockedBlockRef() by a worker thread, so that a later RasterIO()
+ * on the window is served from the block cache while the caller did
+ * something else in the meantime (typically writing the previous chunk of
+ * data to another dataset).
+ *
+ * Only as many blocks as fit in half of the currently unused block cache
+ * are loaded, so that prefetched blocks do not evict each other, nor other
+ * datasets blocks.  Any previous prefetch on this dataset is completed first.
+ *
+ * Until the prefetch has completed, the dataset must not be used from
+ * another thread.  RasterIO(), FlushCache() and GDALClose() on the dataset,
+ * and RasterIO(), ReadBlock() and WriteBlock() on its bands
+ * wait for it implicitly; WaitForPrefetch() can be used to wait explicitly.
+ * Errors are not reported by the worker thread: blocks that failed to load
+ * are read again, and errors reported, by the subsequent RasterIO().
+ *
+ * Prefetching is disabled unless the GDAL_PREFETCH configuration option is
+ * set to YES.  The worker thread adds blocks to the block arrays of the
+ * bands, which are not locked: it must not run while another thread may
+ * evict blocks of the same bands from the cache, for instance when that
+ * thread needs cache memory to write blocks of another dataset, as these
+ * evictions update the same arrays.
+ *
+ * @param nXOff The pixel offset to the top left corner of the window.
+ * @param nYOff The line offset to the top left corner of the window.
+ * @param nXSize The width of the window in pixels.
+ * @param nYSize The height of the window in lines.
+ * @param nBandCount the number of bands to prefetch.
+ * @param panBandMap the list of nBandCount band numbers, or NULL to select
+ * the first nBandCount bands.
+ *
+ * @return TRUE if a background prefetch was started.
+ *
+ * @since GDAL 1.10
+ */
+
+int GDALDataset::StartPrefetch( int nXOff, int nYOff, int nXSize, int nYSize,
+                                int nBandCount, int *panBandMap )
+
+{
+    if( !CSLTestBoolean( CPLGetConfigOption( "GDAL_PREFETCH", "NO" ) ) )
+        return FALSE;
+
+    if( poPrefetcher == NULL )
+        poPrefetcher = new GDALBlockPrefetcher( this );
+
+    return poPrefetcher->Start( nXOff, nYOff, nXSize, nYSize,
+                                nBandCount, panBandMap );
+}
+
+/************************************************************************/
+/*                              EnterIO()                               */
+/************************************************************************/
+
+/**
+ * \brief Acquire the I/O mutex of the dataset.
+ *
+ * Datasets on which the driver enabled write-behind of dirty blocks (see
+ * EnableWriteBehind()) have a recursive mutex, which is held by the thread
+ * doing I/O on the dataset.  RasterIO() and FlushCache() on the dataset,
+ * and RasterIO(), ReadBlock(), WriteBlock(), FlushCache() and
+ * GetLockedBlockRef() on its bands hold it, and the background writer only
+ * writes the dirty blocks of a dataset when it can acquire it without
+ * waiting.
+ *
+ * Datasets sharing their file handle with another dataset, such as the
+ * overviews of a GeoTIFF file, use the mutex of that dataset, as set by the
+ * driver with SetIOMutexOwner().
+ *
+ * Does nothing for other datasets.  Each call must be balanced by a call to
+ * LeaveIO(), which GDALDatasetIOHolder does.
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALDataset::EnterIO()
+
+{
+    GDALDataset *poOwner = poIOMutexOwner != NULL ? poIOMutexOwner : this;
+
+    if( poOwner->hIOMutex != NULL )
+        CPLAcquireMutex( poOwner->hIOMutex, 1000.0 );
+}
+
+/************************************************************************/
+/*                              LeaveIO()                               */
+/************************************************************************/
+
+/**
+ * \brief Release the I/O mutex of the dataset acquired by EnterIO().
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALDataset::LeaveIO()
+
+{
+    GDALDataset *poOwner = poIOMutexOwner != NULL ? poIOMutexOwner : this;
+
+    if( poOwner->hIOMutex != NULL )
+    {
+        CPLReleaseMutex( poOwner->hIOMutex );
+        GDALRasterBlock::NotifyIOMutexReleased();
+    }
+}
+
+/************************************************************************/
+/*                         EnableWriteBehind()                          */
+/************************************************************************/
+
+/**
+ * \brief Let the background writer write the dirty blocks of the dataset.
+ *
+ * The dirty blocks of a dataset are written by the background writer only
+ * if its driver opted in by calling this method, when the dataset is
+ * opened or created in update mode, before any I/O.  The driver must then
+ * hold the I/O mutex (see EnterIO()) whenever it accesses the file handle
+ * outside of the GDALDataset and GDALRasterBand methods that already do,
+ * and make the datasets sharing that handle use the same mutex with
+ * SetIOMutexOwner().
+ *
+ * Does nothing unless the GDAL_CACHE_WRITE_BEHIND configuration option is
+ * set to YES (see GDALRasterBlock::IsWriteBehindEnabled()) and the dataset
+ * is in update mode.
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALDataset::EnableWriteBehind()
+
+{
+    if( hIOMutex != NULL || eAccess != GA_Update
+        || !GDALRasterBlock::IsWriteBehindEnabled() )
+        return;
+
+    hIOMutex = CPLCreateMutex();
+    CPLReleaseMutex( hIOMutex );
+}
+
+/************************************************************************/
+/*                         GetCacheStatistics()                         */
+/************************************************************************/
+
+/**
+ * \brief Get counters of the block cache activity of the dataset.
+ *
+ * The counters are those of GDALGetCacheStatistics(), except CACHE_MAX,
+ * CACHE_DIRTY and the LOCK_ ones, restricted to the blocks of the bands of
+ * this dataset.
+ * For drivers relying on other datasets, such as VRT, the blocks read from
+ * the sources are accounted to the source datasets.
+ *
+ * This method is the same as the C function
+ * GDALDatasetGetCacheStatistics().
+ *
+ * @return a list of NAME=VALUE strings, to be freed with CSLDestroy().
+ *
+ * @since GDAL 1.10
+ */
+
+char **GDALDataset::GetCacheStatistics()
+
+{
+    return GDALRasterBlock::GetCacheStatistics( this );
+}
+
+/************************************************************************/
+/*                   GDALDatasetGetCacheStatistics()                    */
+/************************************************************************/
+
+/**
+ * \brief Get counters of the block cache activity of the dataset.
+ *
+ * @see GDALDataset::GetCacheStatistics()
+ */
+
+char ** CPL_STDCALL GDALDatasetGetCacheStatistics( GDALDatasetH hDS )
+
+{
+    VALIDATE_POINTER1( hDS, "GDALDatasetGetCacheStatistics", NULL );
+
+    return ((GDALDataset *) hDS)->GetCacheStatistics();
+}
+
+/************************************************************************/
+/*                          InitCachePolicy()                           */
+/************************************************************************/
+
+/**
+ * \brief Read the default block cache policy of the driver.
+ *
+ * The GDAL_CACHE_PRIORITY_<driver> configuration option can be set to
+ * STREAMING, NORMAL or PINNED, and GDAL_CACHE_QUOTA_<driver> to a quota in
+ * bytes, or in megabytes if less than 100000 like GDAL_CACHEMAX, where
+ * <driver> is the short name of the driver, for instance
+ * GDAL_CACHE_QUOTA_GTiff.  Nothing is done until the driver of the dataset
+ * is known.
+ */
+
+void GDALDataset::InitCachePolicy()
+
+{
+    if( bCachePolicyInitialized || poDriver == NULL )
+        return;
+
+    bCachePolicyInitialized = TRUE;
+
+    const char *pszDriver = poDriver->GetDescription();
+    const char *pszValue = 
+        CPLGetConfigOption( CPLSPrintf( "GDAL_CACHE_PRIORITY_%s", pszDriver ),
+                            NULL );
+
+    if( pszValue != NULL )
+    {
+        if( EQUAL(pszValue,"STREAMING") )
+            eCachePriority = GBP_Streaming;
+        else if( EQUAL(pszValue,"NORMAL") )
+            eCachePriority = GBP_Normal;
+        else if( EQUAL(pszValue,"PINNED") )
+            eCachePriority = GBP_Pinned;
+        else
+            CPLError( CE_Warning, CPLE_IllegalArg,
+                      "Unrecognised GDAL_CACHE_PRIORITY_%s value: %s",
+                      pszDriver, pszValue );
+    }
+
+    pszValue = CPLGetConfigOption( CPLSPrintf( "GDAL_CACHE_QUOTA_%s", 
+                                               pszDriver ), NULL );
+    if( pszValue != NULL )
+    {
+        GIntBig nQuota = (GIntBig) CPLScanUIntBig( pszValue, 
+                                                   strlen(pszValue) );
+        if( nQuota < 100000 )
+            nQuota *= 1024 * 1024;
+        nCacheQuota = nQuota;
+    }
+}
+
+/************************************************************************/
+/*                          SetCachePriority()                          */
+/************************************************************************/
+
+/**
+ * \brief Set the block cache priority class of the dataset.
+ *
+ * The class applies to the blocks of the bands of the dataset for which
+ * GDALRasterBand::SetCachePriority() was not called.  Blocks of the
+ * GBP_Streaming class, for instance those of a dataset read once
+ * sequentially, are evicted before the others once they use more than
+ * the GDAL_CACHE_STREAMING_RESERVE percentage of the cache max (10 by
+ * default), so that they do not push frequently used blocks out of the
+ * cache.  Blocks of the GBP_Pinned class are only evicted when no other
+ * block can be.  The blocks already in the cache move to the new class the
+ * next time they are used.
+ *
+ * The default is GBP_Normal, unless the GDAL_CACHE_PRIORITY_<driver>
+ * configuration option is set (see InitCachePolicy()).
+ *
+ * This method is the same as the C function GDALDatasetSetCachePriority().
+ *
+ * @param ePriority the priority class.
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALDataset::SetCachePriority( GDALBlockPriority ePriority )
+
+{
+    InitCachePolicy();
+    eCachePriority = ePriority;
+}
+
+/************************************************************************/
+/*                    GDALDatasetSetCachePriority()                     */
+/************************************************************************/
+
+/**
+ * \brief Set the block cache priority class of the dataset.
+ *
+ * @see GDALDataset::SetCachePriority()
+ */
+
+void CPL_STDCALL GDALDatasetSetCachePriority( GDALDatasetH hDS, 
+                                              GDALBlockPriority ePriority )
+
+{
+    VALIDATE_POINTER0( hDS, "GDALDatasetSetCachePriority" );
+
+    ((GDALDataset *) hDS)->SetCachePriority( ePriority );
+}
+
+/************************************************************************/
+/*                          GetCachePriority()                          */
+/************************************************************************/
+
+/**
+ * \brief Get the block cache priority class of the dataset.
+ *
+ * This method is the same as the C function GDALDatasetGetCachePriority().
+ *
+ * @return the priority class.
+ *
+ * @since GDAL 1.10
+ */
+
+GDALBlockPriority GDALDataset::GetCachePriority()
+
+{
+    InitCachePolicy();
+    return eCachePriority;
+}
+
+/************************************************************************/
+/*                    GDALDatasetGetCachePriority()                     */
+/************************************************************************/
+
+/**
+ * \brief Get the block cache priority class of the dataset.
+ *
+ * @see GDALDataset::GetCachePriority()
+ */
+
+GDALBlockPriority CPL_STDCALL GDALDatasetGetCachePriority( GDALDatasetH hDS )
+
+{
+    VALIDATE_POINTER1( hDS, "GDALDatasetGetCachePriority", GBP_Normal );
+
+    return ((GDALDataset *) hDS)->GetCachePriority();
+}
+
+/************************************************************************/
+/*                           SetCacheQuota()                            */
+/************************************************************************/
+
+/**
+ * \brief Set the block cache quota of the dataset.
+ *
+ * When a new block of one of the bands of the dataset is loaded in the
+ * cache while its blocks use more than the quota, the blocks of the
+ * dataset are evicted, by priority class and oldest first, until they fit
+ * in it again, regardless of the memory used by other datasets.  This
+ * prevents one dataset from monopolizing the cache.
+ *
+ * The default is no quota, unless the GDAL_CACHE_QUOTA_<driver>
+ * configuration option is set (see InitCachePolicy()).  The memory used
+ * is reported as CACHE_USED by GetCacheStatistics().
+ *
+ * This method is the same as the C function GDALDatasetSetCacheQuota().
+ *
+ * @param nBytes the quota in bytes, or 0 for no quota.
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALDataset::SetCacheQuota( GIntBig nBytes )
+
+{
+    InitCachePolicy();
+    nCacheQuota = nBytes;
+}
+
+/************************************************************************/
+/*                      GDALDatasetSetCacheQuota()                      */
+/************************************************************************/
+
+/**
+ * \brief Set the block cache quota of the dataset.
+ *
+ * @see GDALDataset::SetCacheQuota()
+ */
+
+void CPL_STDCALL GDALDatasetSetCacheQuota( GDALDatasetH hDS, GIntBig nBytes )
+
+{
+    VALIDATE_POINTER0( hDS, "GDALDatasetSetCacheQuota" );
+
+    ((GDALDataset *) hDS)->SetCacheQuota( nBytes );
+}
+
+/************************************************************************/
+/*                           GetCacheQuota()                            */
+/************************************************************************/
+
+/**
+ * \brief Get the block cache quota of the dataset.
+ *
+ * This method is the same as the C function GDALDatasetGetCacheQuota().
+ *
+ * @return the quota in bytes, or 0 if there is none.
+ *
+ * @since GDAL 1.10
+ */
+
+GIntBig GDALDataset::GetCacheQuota()
+
+{
+    InitCachePolicy();
+    return nCacheQuota;
+}
+
+/************************************************************************/
+/*                      GDALDatasetGetCacheQuota()                      */
+/************************************************************************/
+
+/**
+ * \brief Get the block cache quota of the dataset.
+ *
+ * @see GDALDataset::GetCacheQuota()
+ */
+
+GIntBig CPL_STDCALL GDALDatasetGetCacheQuota( GDALDatasetH hDS )
+
+{
+    VALIDATE_POINTER1( hDS, "GDALDatasetGetCacheQuota", 0 );
+
+    return ((GDALDataset *) hDS)->GetCacheQuota();
+}
+
+/************************************************************************/
+/*                          SetIOMutexOwner()                           */
+/************************************************************************/
+
+/**
+ * \brief Share the I/O mutex of another dataset.
+ *
+ * Drivers must call this on the datasets that access the same file handle
+ * as another dataset (typically overviews and masks), before any I/O, so that
+ * the background writer of dirty blocks never accesses the file handle
+ * while another thread uses one of these datasets.  The owner must outlive
+ * this dataset.
+ *
+ * @param poOwner the dataset whose I/O mutex is to be used.
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALDataset::SetIOMutexOwner( GDALDataset *poOwner )
+
+{
+    if( poOwner != NULL && poOwner->poIOMutexOwner != NULL )
+        poOwner = poOwner->poIOMutexOwner;
+
+    poIOMutexOwner = (poOwner == this) ? NULL : poOwner;
+}
+
 /************************************************************************/
 /*                       GDALDatasetAdviseRead()                        */
 /************************************************************************/
@@ -1963,6 +2483,337 @@ GDALDatasetAdviseRead( GDALDatasetH hDS,
                                               papszOptions );
 }
 
+/************************************************************************/
+/*                        ComputeRasterSummary()                        */
+/************************************************************************/
+
+/**
+ * \brief Compute statistics, histogram and checksum of bands in one pass.
+ *
+ * Computes any combination of the statistics, the default histogram, the
+ * checksum and the number of valid pixels of the requested bands, while
+ * reading each block only once.  The blocks at the same position in all
+ * the bands with the same block size are read together, which also
+ * benefits pixel interleaved formats.
+ *
+ * The results are saved on the bands, in the .aux.xml file for formats
+ * relying on PAM, where the usual methods will find them:
+ * <ul>
+ * <li>the statistics with SetStatistics(), returned by GetStatistics().</li>
+ * <li>the histogram with SetDefaultHistogram(), returned by
+ * GetDefaultHistogram(), for bands supporting it.</li>
+ * <li>the checksum, the one of GDALChecksumImage() for the whole band, in
+ * the STATISTICS_CHECKSUM metadata item, which is reported by gdalinfo
+ * -checksum instead of computing it again.</li>
+ * <li>the number of valid pixels, those which are not nodata nor NaN,
+ * in the STATISTICS_VALID_COUNT metadata item.</li>
+ * </ul>
+ *
+ * All the pixels are read: this is the equivalent of ComputeStatistics()
+ * with bApproxOK set to FALSE.  The blocks are processed by the number of
+ * threads set with the GDAL_NUM_THREADS configuration option.
+ *
+ * The following options are supported:
+ * <ul>
+ * <li>STATISTICS=YES/NO: compute the statistics (YES by default).</li>
+ * <li>HISTOGRAM=YES/NO: compute the histogram (YES by default).</li>
+ * <li>CHECKSUM=YES/NO: compute the checksum (YES by default).</li>
+ * <li>VALID_COUNT=YES/NO: compute the number of valid pixels (YES by
+ * default).</li>
+ * <li>HISTOGRAM_MIN=val, HISTOGRAM_MAX=val: the bounds of the histogram.
+ * By default these are those used by GetDefaultHistogram(): -0.5 and 255.5
+ * for Byte data, otherwise the approximate minimum and maximum, widened by
+ * half a bucket, and no histogram is computed for bands without any valid
+ * pixel.  The approximate minimum and maximum are taken from the saved
+ * statistics if any, and are not saved when computed.  Values out of these
+ * bounds are counted in the first or last bucket.</li>
+ * <li>HISTOGRAM_BUCKETS=n: the number of buckets of the histogram (256 by
+ * default).</li>
+ * </ul>
+ *
+ * This method is the same as the C function
+ * GDALDatasetComputeRasterSummary().
+ *
+ * @param nBandCount the number of bands, or 0 for all bands.
+ * @param panBandList the list of nBandCount band numbers, or NULL to
+ * select the first nBandCount bands.
+ * @param papszOptions the options, or NULL.
+ * @param pfnProgress a function to call to report progress, or NULL.
+ * @param pProgressData application data to pass to the progress function.
+ *
+ * @return CE_None on success, or CE_Failure if an error occurs or processing
+ * is terminated by the user.
+ *
+ * @since GDAL 1.10
+ */
+
+CPLErr GDALDataset::ComputeRasterSummary( int nBandCount, int *panBandList,
+                                          char **papszOptions,
+                                          GDALProgressFunc pfnProgress,
+                                          void *pProgressData )
+
+{
+    int    bStats = CSLFetchBoolean( papszOptions, "STATISTICS", TRUE );
+    int    bHistogram = CSLFetchBoolean( papszOptions, "HISTOGRAM", TRUE );
+    int    bChecksum = CSLFetchBoolean( papszOptions, "CHECKSUM", TRUE );
+    int    bValidCount = CSLFetchBoolean( papszOptions, "VALID_COUNT", TRUE );
+    int    nBuckets = atoi( CSLFetchNameValueDef( papszOptions,
+                                                  "HISTOGRAM_BUCKETS", "256" ) );
+    const char *pszHistMin = CSLFetchNameValue( papszOptions, "HISTOGRAM_MIN" );
+    const char *pszHistMax = CSLFetchNameValue( papszOptions, "HISTOGRAM_MAX" );
+    CPLErr eErr = CE_None;
+    int    iBand, iOther;
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
+
+    if( nBandCount == 0 )
+    {
+        nBandCount = GetRasterCount();
+        panBandList = NULL;
+    }
+
+    if( nBandCount == 0 || (!bStats && !bHistogram && !bChecksum
+                            && !bValidCount) )
+        return CE_None;
+
+    if( bHistogram && nBuckets < 1 )
+    {
+        ReportError( CE_Failure, CPLE_IllegalArg,
+                     "Illegal HISTOGRAM_BUCKETS value: %d", nBuckets );
+        return CE_Failure;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Set up an accumulator for each band.                            */
+/* -------------------------------------------------------------------- */
+    GDALRasterBand **papoBands = (GDALRasterBand **)
+        CPLCalloc( sizeof(GDALRasterBand *), nBandCount );
+    GDALRasterStatsAccumulator **papoAccums = (GDALRasterStatsAccumulator **)
+        CPLCalloc( sizeof(GDALRasterStatsAccumulator *), nBandCount );
+    double *padfHistMin = (double *) CPLCalloc( sizeof(double), nBandCount );
+    double *padfHistMax = (double *) CPLCalloc( sizeof(double), nBandCount );
+    int    *pabHistogram = (int *) CPLCalloc( sizeof(int), nBandCount );
+
+    for( iBand = 0; iBand < nBandCount && eErr == CE_None; iBand++ )
+    {
+        int nBand = panBandList ? panBandList[iBand] : iBand + 1;
+        GDALRasterBand *poBand = GetRasterBand( nBand );
+
+        if( poBand == NULL )
+        {
+            ReportError( CE_Failure, CPLE_IllegalArg,
+                         "ComputeRasterSummary(): Illegal band #%d", nBand );
+            eErr = CE_Failure;
+            break;
+        }
+
+        int    bGotNoDataValue;
+        double dfNoDataValue = poBand->GetNoDataValue( &bGotNoDataValue );
+        const char* pszPixelType =
+            poBand->GetMetadataItem( "PIXELTYPE", "IMAGE_STRUCTURE" );
+        int bSignedByte = (pszPixelType != NULL
+                           && EQUAL(pszPixelType, "SIGNEDBYTE"));
+
+        papoBands[iBand] = poBand;
+        papoAccums[iBand] =
+            new GDALRasterStatsAccumulator( poBand->GetRasterDataType(),
+                                            bSignedByte, bGotNoDataValue,
+                                            dfNoDataValue );
+
+        if( bStats || bValidCount )
+            papoAccums[iBand]->RequestStatistics();
+        if( bChecksum )
+            papoAccums[iBand]->RequestChecksum( poBand->GetXSize() );
+
+        if( !bHistogram )
+            continue;
+
+/* -------------------------------------------------------------------- */
+/*      The default histogram bounds need the approximate range.        */
+/*      Unlike GetStatistics(), computing it must not save              */
+/*      approximate statistics on the band.                             */
+/* -------------------------------------------------------------------- */
+        double dfHistMin = -0.5, dfHistMax = 255.5;
+
+        if( (pszHistMin == NULL || pszHistMax == NULL)
+            && (poBand->GetRasterDataType() != GDT_Byte || bSignedByte) )
+        {
+            // No histogram for bands without any valid pixel.
+            CPLPushErrorHandler( CPLQuietErrorHandler );
+            CPLErr eStatsErr = poBand->GetStatistics( TRUE, FALSE,
+                                                      &dfHistMin, &dfHistMax,
+                                                      NULL, NULL );
+            if( eStatsErr != CE_None )
+            {
+                double adfMinMax[2];
+
+                eStatsErr = poBand->ComputeRasterMinMax( TRUE, adfMinMax );
+                dfHistMin = adfMinMax[0];
+                dfHistMax = adfMinMax[1];
+            }
+            CPLPopErrorHandler();
+
+            if( eStatsErr != CE_None )
+            {
+                CPLErrorReset();
+                continue;
+            }
+
+            double dfHalfBucket = (dfHistMax - dfHistMin) / (2 * nBuckets);
+            dfHistMin -= dfHalfBucket;
+            dfHistMax += dfHalfBucket;
+        }
+
+        if( pszHistMin != NULL )
+            dfHistMin = CPLAtof( pszHistMin );
+        if( pszHistMax != NULL )
+            dfHistMax = CPLAtof( pszHistMax );
+
+        pabHistogram[iBand] = TRUE;
+        padfHistMin[iBand] = dfHistMin;
+        padfHistMax[iBand] = dfHistMax;
+        papoAccums[iBand]->RequestHistogram( dfHistMin, dfHistMax, nBuckets,
+                                             TRUE );
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Process together the bands with the same block size.            */
+/* -------------------------------------------------------------------- */
+    int *pabDone = (int *) CPLCalloc( sizeof(int), nBandCount );
+    GDALRasterBand **papoGroupBands = (GDALRasterBand **)
+        CPLCalloc( sizeof(GDALRasterBand *), nBandCount );
+    GDALRasterStatsAccumulator **papoGroupAccums =
+        (GDALRasterStatsAccumulator **)
+        CPLCalloc( sizeof(GDALRasterStatsAccumulator *), nBandCount );
+    int nBandsDone = 0;
+
+    for( iBand = 0; iBand < nBandCount && eErr == CE_None; iBand++ )
+    {
+        int nBlockXSize, nBlockYSize, nGroupCount = 0;
+
+        if( pabDone[iBand] )
+            continue;
+
+        papoBands[iBand]->GetBlockSize( &nBlockXSize, &nBlockYSize );
+
+        for( iOther = iBand; iOther < nBandCount; iOther++ )
+        {
+            int nOtherXSize, nOtherYSize;
+
+            papoBands[iOther]->GetBlockSize( &nOtherXSize, &nOtherYSize );
+            if( pabDone[iOther] || nOtherXSize != nBlockXSize
+                || nOtherYSize != nBlockYSize )
+                continue;
+
+            pabDone[iOther] = TRUE;
+            papoGroupBands[nGroupCount] = papoBands[iOther];
+            papoGroupAccums[nGroupCount] = papoAccums[iOther];
+            nGroupCount++;
+        }
+
+        void *pScaledProgress =
+            GDALCreateScaledProgress( nBandsDone / (double) nBandCount,
+                                      (nBandsDone + nGroupCount)
+                                      / (double) nBandCount,
+                                      pfnProgress, pProgressData );
+
+        eErr = GDALRasterStatsAccumulator::AccumulateBlocks(
+            nGroupCount, papoGroupBands, papoGroupAccums, 1, TRUE,
+            "Compute Raster Summary", GDALScaledProgress, pScaledProgress );
+
+        GDALDestroyScaledProgress( pScaledProgress );
+        nBandsDone += nGroupCount;
+    }
+
+    CPLFree( pabDone );
+    CPLFree( papoGroupBands );
+    CPLFree( papoGroupAccums );
+
+/* -------------------------------------------------------------------- */
+/*      Save the results.                                               */
+/* -------------------------------------------------------------------- */
+    for( iBand = 0; iBand < nBandCount && eErr == CE_None; iBand++ )
+    {
+        GDALRasterBand *poBand = papoBands[iBand];
+        GDALRasterStatsAccumulator *poAccum = papoAccums[iBand];
+        double  dfMin, dfMax, dfMean, dfStdDev;
+        GIntBig nValidCount;
+
+        if( poAccum->GetStatistics( &dfMin, &dfMax, &dfMean, &dfStdDev,
+                                    &nValidCount ) && bStats )
+            poBand->SetStatistics( dfMin, dfMax, dfMean, dfStdDev );
+
+        if( bValidCount )
+            poBand->SetMetadataItem( "STATISTICS_VALID_COUNT",
+                                     CPLSPrintf( CPL_FRMT_GIB, nValidCount ) );
+
+        if( bChecksum )
+            poBand->SetMetadataItem( "STATISTICS_CHECKSUM",
+                                     CPLSPrintf( "%d",
+                                                 poAccum->GetChecksum() ) );
+
+        if( pabHistogram[iBand] )
+        {
+            int *panHistogram = (int *) CPLMalloc( sizeof(int) * nBuckets );
+
+            poAccum->GetHistogram( panHistogram );
+
+            // Not all bands can save a histogram.
+            CPLPushErrorHandler( CPLQuietErrorHandler );
+            poBand->SetDefaultHistogram( padfHistMin[iBand],
+                                         padfHistMax[iBand],
+                                         nBuckets, panHistogram );
+            CPLPopErrorHandler();
+
+            CPLFree( panHistogram );
+        }
+    }
+
+    if( eErr == CE_None )
+        pfnProgress( 1.0, "Compute Raster Summary", pProgressData );
+
+    for( iBand = 0; iBand < nBandCount; iBand++ )
+        delete papoAccums[iBand];
+
+    CPLFree( papoBands );
+    CPLFree( papoAccums );
+    CPLFree( padfHistMin );
+    CPLFree( padfHistMax );
+    CPLFree( pabHistogram );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                  GDALDatasetComputeRasterSummary()                   */
+/************************************************************************/
+
+/**
+ * \brief Compute statistics, histogram and checksum of bands in one pass.
+ *
+ * @see GDALDataset::ComputeRasterSummary()
+ *
+ * @since GDAL 1.10
+ */
+
+CPLErr CPL_STDCALL
+GDALDatasetComputeRasterSummary( GDALDatasetH hDS,
+                                 int nBandCount, int *panBandList,
+                                 char **papszOptions,
+                                 GDALProgressFunc pfnProgress,
+                                 void *pProgressData )
+
+{
+    VALIDATE_POINTER1( hDS, "GDALDatasetComputeRasterSummary", CE_Failure );
+
+    return ((GDALDataset *) hDS)->ComputeRasterSummary( nBandCount,
+                                                        panBandList,
+                                                        papszOptions,
+                                                        pfnProgress,
+                                                        pProgressData );
+}
+
 /************************************************************************/
 /*                            GetFileList()                             */
 /************************************************************************/
@@ -2390,6 +3241,12 @@ void CPL_STDCALL GDALClose( GDALDatasetH hDS )
     VALIDATE_POINTER0( hDS, "GDALClose" );
 
     GDALDataset *poDS = (GDALDataset *) hDS;
+
+    /* The driver specific destructor runs before ~GDALDataset(), so any */
+    /* background prefetching must be stopped first.  This is done */
+    /* before taking hDLMutex that the prefetching thread might need. */
+    poDS->WaitForPrefetch( TRUE );
+
     CPLMutexHolderD( &hDLMutex );
     CPLLocaleC  oLocaleForcer;
 
@@ -29,6 +29,7 @@
  ****************************************************************************/
 
 #include "gdal_priv.h"
+#include "cpl_multiproc.h"
 
 CPL_CVSID("$Id: gdaldataset.cpp 16796 2009-04-17 23:35:04Z normanb $");
 
@@ -318,3 +319,263 @@ GDALDefaultAsyncReader::GetNextUpdatedRegion(double dfTimeout,
         return GARIO_ERROR;
 }
 
+
+/************************************************************************/
+/* ==================================================================== */
+/*                        GDALBlockPrefetcher                           */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*                        GDALBlockPrefetcher()                         */
+/************************************************************************/
+
+GDALBlockPrefetcher::GDALBlockPrefetcher( GDALDataset *poDSIn )
+
+{
+    poDS = poDSIn;
+    hThreadMutex = NULL;
+    hCond = NULL;
+    bRunning = FALSE;
+    bStop = FALSE;
+    nWorkerPID = 0;
+    nCurBand = 0;
+    nCurXBlock = 0;
+    nCurYBlock = 0;
+}
+
+/************************************************************************/
+/*                        ~GDALBlockPrefetcher()                        */
+/************************************************************************/
+
+GDALBlockPrefetcher::~GDALBlockPrefetcher()
+
+{
+    Wait( TRUE );
+
+    if( hThreadMutex != NULL )
+    {
+        CPLDestroyCond( hCond );
+        CPLDestroyMutex( hThreadMutex );
+    }
+}
+
+/************************************************************************/
+/*                             ThreadMain()                             */
+/************************************************************************/
+
+void GDALBlockPrefetcher::ThreadMain( void *pThreadData )
+
+{
+    GDALBlockPrefetcher *poThis = (GDALBlockPrefetcher *) pThreadData;
+
+    CPLAcquireMutex( poThis->hThreadMutex, 1000.0 );
+    poThis->nWorkerPID = CPLGetPID();
+    CPLReleaseMutex( poThis->hThreadMutex );
+
+    /* Errors will be reported by the RasterIO() reading the window */
+    CPLPushErrorHandler( CPLQuietErrorHandler );
+
+    for( size_t i = 0; i + 2 < poThis->anBlocks.size() && !poThis->bStop;
+         i += 3 )
+    {
+        GDALRasterBand *poBand = 
+            poThis->poDS->GetRasterBand( poThis->anBlocks[i] );
+
+/* -------------------------------------------------------------------- */
+/*      Never let this thread flush blocks out of the cache: that       */
+/*      could write dirty blocks of datasets in use in other threads.   */
+/* -------------------------------------------------------------------- */
+        int nBlockXSize, nBlockYSize;
+        poBand->GetBlockSize( &nBlockXSize, &nBlockYSize );
+        GIntBig nBlockBytes = (GIntBig) nBlockXSize * nBlockYSize
+            * (GDALGetDataTypeSize(poBand->GetRasterDataType()) / 8);
+
+        if( GDALGetCacheUsed64() + nBlockBytes > GDALGetCacheMax64() )
+            break;
+
+        CPLAcquireMutex( poThis->hThreadMutex, 1000.0 );
+        poThis->nCurBand = poThis->anBlocks[i];
+        poThis->nCurXBlock = poThis->anBlocks[i+1];
+        poThis->nCurYBlock = poThis->anBlocks[i+2];
+        CPLReleaseMutex( poThis->hThreadMutex );
+
+        GDALRasterBlock *poBlock = 
+            poBand->GetLockedBlockRef( poThis->anBlocks[i+1],
+                                       poThis->anBlocks[i+2] );
+        if( poBlock != NULL )
+            poBlock->DropLock();
+
+        CPLAcquireMutex( poThis->hThreadMutex, 1000.0 );
+        poThis->nCurBand = 0;
+        CPLCondBroadcast( poThis->hCond );
+        CPLReleaseMutex( poThis->hThreadMutex );
+    }
+
+    CPLPopErrorHandler();
+
+    poThis->anBlocks.resize( 0 );
+
+    /* The object must not be used after the mutex is released, as */
+    /* waiters may destroy it. */
+    CPLAcquireMutex( poThis->hThreadMutex, 1000.0 );
+    poThis->bRunning = FALSE;
+    CPLCondBroadcast( poThis->hCond );
+    CPLReleaseMutex( poThis->hThreadMutex );
+}
+
+/************************************************************************/
+/*                               Start()                                */
+/*                                                                      */
+/*      Collect the blocks of the window that are not already           */
+/*      cached, up to half of the cache size, make room for them in     */
+/*      the cache and launch the worker thread.  Returns TRUE if a      */
+/*      worker has been launched.                                       */
+/************************************************************************/
+
+int GDALBlockPrefetcher::Start( int nXOff, int nYOff, int nXSize, int nYSize,
+                                int nBandCount, int *panBandMap )
+
+{
+    Wait();
+
+    if( nXOff < 0 || nYOff < 0 || nXSize < 1 || nYSize < 1
+        || nXOff + nXSize > poDS->GetRasterXSize()
+        || nYOff + nYSize > poDS->GetRasterYSize() )
+        return FALSE;
+
+    GIntBig nBudget = GDALGetCacheMax64() / 2;
+    GIntBig nNeeded = 0;
+    int iBand;
+
+    anBlocks.resize( 0 );
+
+    for( iBand = 0; iBand < nBandCount; iBand++ )
+    {
+        int nBand = (panBandMap != NULL) ? panBandMap[iBand] : iBand + 1;
+        GDALRasterBand *poBand = poDS->GetRasterBand( nBand );
+
+        if( poBand == NULL )
+            return FALSE;
+
+        int nBlockXSize, nBlockYSize;
+        poBand->GetBlockSize( &nBlockXSize, &nBlockYSize );
+        if( nBlockXSize <= 0 || nBlockYSize <= 0 )
+            continue;
+
+        GIntBig nBlockBytes = (GIntBig) nBlockXSize * nBlockYSize
+            * (GDALGetDataTypeSize(poBand->GetRasterDataType()) / 8);
+
+        int nXBlock, nYBlock;
+        for( nYBlock = nYOff / nBlockYSize;
+             nYBlock <= (nYOff + nYSize - 1) / nBlockYSize; 
+             nYBlock++ )
+        {
+            for( nXBlock = nXOff / nBlockXSize;
+                 nXBlock <= (nXOff + nXSize - 1) / nBlockXSize;
+                 nXBlock++ )
+            {
+                GDALRasterBlock *poBlock = 
+                    poBand->TryGetLockedBlockRef( nXBlock, nYBlock );
+                if( poBlock != NULL )
+                {
+                    poBlock->DropLock();
+                    continue;
+                }
+
+                if( nNeeded + nBlockBytes > nBudget )
+                    break;
+                nNeeded += nBlockBytes;
+
+                anBlocks.push_back( nBand );
+                anBlocks.push_back( nXBlock );
+                anBlocks.push_back( nYBlock );
+            }
+        }
+    }
+
+    if( anBlocks.size() == 0 )
+        return FALSE;
+
+/* -------------------------------------------------------------------- */
+/*      Evict from this thread what reading the window would evict      */
+/*      anyway, so that the worker does not need to.                    */
+/* -------------------------------------------------------------------- */
+    while( GDALGetCacheUsed64() + nNeeded > GDALGetCacheMax64() )
+    {
+        if( !GDALFlushCacheBlock() )
+            break;
+    }
+
+    if( hThreadMutex == NULL )
+    {
+        hThreadMutex = CPLCreateMutex();
+        CPLReleaseMutex( hThreadMutex );
+        hCond = CPLCreateCond();
+    }
+
+    bStop = FALSE;
+    bRunning = TRUE;
+    nWorkerPID = 0;
+
+    if( CPLCreateThread( ThreadMain, this ) == -1 )
+    {
+        bRunning = FALSE;
+        anBlocks.resize( 0 );
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                                Wait()                                */
+/*                                                                      */
+/*      Wait for the worker to be done.  If bAbort is set, the          */
+/*      worker stops after the block currently being loaded.            */
+/*      Returns TRUE if a worker was running.                           */
+/************************************************************************/
+
+int GDALBlockPrefetcher::Wait( int bAbort )
+
+{
+    if( bAbort )
+        bStop = TRUE;
+
+    if( hThreadMutex == NULL )
+        return FALSE;
+
+    CPLAcquireMutex( hThreadMutex, 1000.0 );
+
+    /* The worker itself does not wait, when reentering through a driver */
+    int bWasRunning = bRunning && nWorkerPID != CPLGetPID();
+    while( bRunning && nWorkerPID != CPLGetPID() )
+        CPLCondWait( hCond, hThreadMutex );
+
+    CPLReleaseMutex( hThreadMutex );
+
+    return bWasRunning;
+}
+
+/************************************************************************/
+/*                            WaitForBlock()                            */
+/*                                                                      */
+/*      Wait for the worker to be done with the block, if it is the     */
+/*      one being loaded.                                               */
+/************************************************************************/
+
+void GDALBlockPrefetcher::WaitForBlock( int nBand, int nXBlock, int nYBlock )
+
+{
+    if( !bRunning )
+        return;
+
+    CPLAcquireMutex( hThreadMutex, 1000.0 );
+
+    while( bRunning && nWorkerPID != CPLGetPID()
+           && nCurBand == nBand && nCurXBlock == nXBlock
+           && nCurYBlock == nYBlock )
+        CPLCondWait( hCond, hThreadMutex );
+
+    CPLReleaseMutex( hThreadMutex );
+}
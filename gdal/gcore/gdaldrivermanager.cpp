@@ -186,6 +186,11 @@ GDALDriverManager::~GDALDriverManager()
         delete papoDSList[i];
     }
 
+/* -------------------------------------------------------------------- */
+/*      Report the block cache activity, if requested.                  */
+/* -------------------------------------------------------------------- */
+    GDALRasterBlock::DumpCacheStatistics( NULL );
+
 /* -------------------------------------------------------------------- */
 /*      Destroy the existing drivers.                                   */
 /* -------------------------------------------------------------------- */
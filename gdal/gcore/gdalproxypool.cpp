@@ -30,6 +30,7 @@
 
 #include "gdal_proxy.h"
 #include "cpl_multiproc.h"
+#include "cpl_atomic_ops.h"
 
 CPL_CVSID("$Id$");
 
@@ -38,10 +39,12 @@ void** GDALGetphDLMutex();
 void GDALSetResponsiblePIDForCurrentThread(GIntBig responsiblePID);
 GIntBig GDALGetResponsiblePIDForCurrentThread();
 
-/* We *must* share the same mutex as the gdaldataset.cpp file, as we are */
-/* doing GDALOpen() calls that can indirectly call GDALOpenShared() on */
-/* an auxiliary dataset ... */
-/* Then we could get dead-locks in multi-threaded use case */
+/* The creation and destruction of the pool singleton *must* share the same */
+/* mutex as the gdaldataset.cpp file, as they can happen while a dataset is */
+/* opened by GDALOpenShared(). The pool itself is protected by per-shard */
+/* mutexes that are never held while we are doing GDALOpen() or GDALClose() */
+/* calls, as they can indirectly call GDALOpenShared() on an auxiliary */
+/* dataset ... Otherwise we could get dead-locks in multi-threaded use case */
 
 /* ******************************************************************** */
 /*                         GDALDatasetPool                              */
@@ -50,6 +53,16 @@ GIntBig GDALGetResponsiblePIDForCurrentThread();
 /* This class is a singleton that maintains a pool of opened datasets */
 /* The cache uses a LRU strategy */
 
+/* The pool is split in shards, each one with its own mutex, hash index */
+/* and LRU list. An entry is identified by its filename and by the */
+/* responsible PID of the thread that created the proxy dataset, and both */
+/* are used to select its shard, so that threads working on different */
+/* datasets rarely contend on the same mutex. The GDALOpen() and */
+/* GDALClose() calls are done without holding the shard mutex. */
+/* The number of entries of the whole pool is counted atomically. A shard */
+/* may grow beyond its share while the pool is not full, and once it is, */
+/* a shard without any entry not in use takes one from the other shards. */
+
 class GDALDatasetPool;
 static GDALDatasetPool* singleton = NULL;
 
@@ -62,10 +75,28 @@ struct _GDALProxyPoolCacheEntry
     /* Ref count of the cached dataset */
     int           refCount;
 
+    /* Set while the dataset is being opened, by the thread openingPID */
+    int           bOpening;
+    GIntBig       openingPID;
+
+    int           iShard;
+    unsigned long nHash;
+
     GDALProxyPoolCacheEntry* prev;
     GDALProxyPoolCacheEntry* next;
 };
 
+typedef struct
+{
+    void                    *hMutex;
+    /* Signaled when a dataset of the shard has been opened */
+    void                    *hCond;
+    CPLHashSet              *hEntrySet;
+    int                      currentSize;
+    GDALProxyPoolCacheEntry *firstEntry;
+    GDALProxyPoolCacheEntry *lastEntry;
+} GDALDatasetPoolShard;
+
 class GDALDatasetPool
 {
     private:
@@ -76,13 +107,18 @@ class GDALDatasetPool
         int refCount;
 
         int maxSize;
-        int currentSize;
-        GDALProxyPoolCacheEntry* firstEntry;
-        GDALProxyPoolCacheEntry* lastEntry;
-
-        /* This variable prevents a dataset that is going to be opened in GDALDatasetPool::_RefDataset */
-        /* from increasing refCount if, during its opening, it creates a GDALProxyPoolDataset */
-        /* We increment it before opening or closing a cached dataset and decrement it afterwards */
+        volatile int currentSize;
+
+        int nShards;
+        int shardMaxSize;
+        GDALDatasetPoolShard* pasShards;
+
+        /* This variable prevents the pool from being destroyed while the */
+        /* driver manager is being destroyed (see PreventDestroy()) */
+        /* A dataset that is going to be opened or closed by the pool must */
+        /* not increase or decrease refCount either if, during its opening, */
+        /* it creates a GDALProxyPoolDataset. This is tracked per thread */
+        /* (see IsOpeningInThisThread()) as the opening is done without lock */
         /* The typical use case is a VRT made of simple sources that are VRT */
         /* We don't want the "inner" VRT to take a reference on the pool, otherwise there is */
         /* a high chance that this reference will not be dropped and the pool remain ghost */
@@ -90,12 +126,20 @@ class GDALDatasetPool
 
         /* Caution : to be sure that we don't run out of entries, size must be at */
         /* least greater or equal than the maximum number of threads */
-        GDALDatasetPool(int maxSize);
+        GDALDatasetPool(int maxSize, int nShards);
         ~GDALDatasetPool();
         GDALProxyPoolCacheEntry* _RefDataset(const char* pszFileName, GDALAccess eAccess);
+        int StealEntry(GDALDatasetPoolShard* psShard, GDALDataset** ppoDS,
+                       GIntBig* pResponsiblePID);
+        void _UnrefDataset(GDALProxyPoolCacheEntry* cacheEntry);
+
+        static void BeginOpeningInThisThread();
+        static void EndOpeningInThisThread();
+        static int  IsOpeningInThisThread();
+        static void CloseDataset(GDALDataset* poDS, GIntBig responsiblePID);
 
         void ShowContent();
-        void CheckLinks();
+        void CheckLinks(GDALDatasetPoolShard* psShard);
 
     public:
         static void Ref();
@@ -107,19 +151,54 @@ class GDALDatasetPool
         static void ForceDestroy();
 };
 
+/************************************************************************/
+/*                     Entry hash set callbacks                         */
+/************************************************************************/
+
+static unsigned long GDALProxyPoolEntryHash(const char* pszFileName,
+                                            GIntBig responsiblePID)
+{
+    return CPLHashSetHashStr(pszFileName) 
+        ^ (unsigned long) (responsiblePID * 2654435761U);
+}
+
+static unsigned long hash_func_cache_entry(const void* elt)
+{
+    return ((const GDALProxyPoolCacheEntry*) elt)->nHash;
+}
+
+static int equal_func_cache_entry(const void* elt1, const void* elt2)
+{
+    const GDALProxyPoolCacheEntry* entry1 = (const GDALProxyPoolCacheEntry*) elt1;
+    const GDALProxyPoolCacheEntry* entry2 = (const GDALProxyPoolCacheEntry*) elt2;
+    return entry1->responsiblePID == entry2->responsiblePID &&
+           strcmp(entry1->pszFileName, entry2->pszFileName) == 0;
+}
 
 /************************************************************************/
 /*                         GDALDatasetPool()                            */
 /************************************************************************/
 
-GDALDatasetPool::GDALDatasetPool(int maxSize)
+GDALDatasetPool::GDALDatasetPool(int maxSize, int nShards)
 {
     this->maxSize = maxSize;
+    this->nShards = nShards;
+    shardMaxSize = MAX(1, maxSize / nShards);
     currentSize = 0;
-    firstEntry = NULL;
-    lastEntry = NULL;
     refCount = 0;
     refCountOfDisableRefCount = 0;
+
+    pasShards = (GDALDatasetPoolShard*) 
+        CPLCalloc(nShards, sizeof(GDALDatasetPoolShard));
+    for(int i=0;i<nShards;i++)
+    {
+        pasShards[i].hMutex = CPLCreateMutex();
+        CPLReleaseMutex(pasShards[i].hMutex);
+        pasShards[i].hCond = CPLCreateCond();
+        pasShards[i].hEntrySet = CPLHashSetNew(hash_func_cache_entry,
+                                               equal_func_cache_entry,
+                                               NULL);
+    }
 }
 
 /************************************************************************/
@@ -128,21 +207,28 @@ GDALDatasetPool::GDALDatasetPool(int maxSize)
 
 GDALDatasetPool::~GDALDatasetPool()
 {
-    GDALProxyPoolCacheEntry* cur = firstEntry;
     GIntBig responsiblePID = GDALGetResponsiblePIDForCurrentThread();
-    while(cur)
+    for(int i=0;i<nShards;i++)
     {
-        GDALProxyPoolCacheEntry* next = cur->next;
-        CPLFree(cur->pszFileName);
-        CPLAssert(cur->refCount == 0);
-        if (cur->poDS)
+        GDALProxyPoolCacheEntry* cur = pasShards[i].firstEntry;
+        while(cur)
         {
-            GDALSetResponsiblePIDForCurrentThread(cur->responsiblePID);
-            GDALClose(cur->poDS);
+            GDALProxyPoolCacheEntry* next = cur->next;
+            CPLFree(cur->pszFileName);
+            CPLAssert(cur->refCount == 0);
+            if (cur->poDS)
+            {
+                GDALSetResponsiblePIDForCurrentThread(cur->responsiblePID);
+                GDALClose(cur->poDS);
+            }
+            CPLFree(cur);
+            cur = next;
         }
-        CPLFree(cur);
-        cur = next;
+        CPLHashSetDestroy(pasShards[i].hEntrySet);
+        CPLDestroyCond(pasShards[i].hCond);
+        CPLDestroyMutex(pasShards[i].hMutex);
     }
+    CPLFree(pasShards);
     GDALSetResponsiblePIDForCurrentThread(responsiblePID);
 }
 
@@ -152,14 +238,17 @@ GDALDatasetPool::~GDALDatasetPool()
 
 void GDALDatasetPool::ShowContent()
 {
-    GDALProxyPoolCacheEntry* cur = firstEntry;
     int i = 0;
-    while(cur)
+    for(int iShard=0;iShard<nShards;iShard++)
     {
-        printf("[%d] pszFileName=%s, refCount=%d, responsiblePID=%d\n",
-               i, cur->pszFileName, cur->refCount, (int)cur->responsiblePID);
-        i++;
-        cur = cur->next;
+        GDALProxyPoolCacheEntry* cur = pasShards[iShard].firstEntry;
+        while(cur)
+        {
+            printf("[%d] shard=%d, pszFileName=%s, refCount=%d, responsiblePID=%d\n",
+                   i, iShard, cur->pszFileName, cur->refCount, (int)cur->responsiblePID);
+            i++;
+            cur = cur->next;
+        }
     }
 }
 
@@ -167,19 +256,115 @@ void GDALDatasetPool::ShowContent()
 /*                             CheckLinks()                             */
 /************************************************************************/
 
-void GDALDatasetPool::CheckLinks()
+void GDALDatasetPool::CheckLinks(GDALDatasetPoolShard* psShard)
 {
-    GDALProxyPoolCacheEntry* cur = firstEntry;
+    GDALProxyPoolCacheEntry* cur = psShard->firstEntry;
     int i = 0;
     while(cur)
     {
-        CPLAssert(cur == firstEntry || cur->prev->next == cur);
-        CPLAssert(cur == lastEntry || cur->next->prev == cur);
+        CPLAssert(cur == psShard->firstEntry || cur->prev->next == cur);
+        CPLAssert(cur == psShard->lastEntry || cur->next->prev == cur);
         i++;
-	CPLAssert(cur->next != NULL || cur == lastEntry);
+        CPLAssert(cur->next != NULL || cur == psShard->lastEntry);
         cur = cur->next;
     }
-    CPLAssert(i == currentSize);
+    CPLAssert(i == psShard->currentSize);
+    CPLAssert(i == CPLHashSetSize(psShard->hEntrySet));
+}
+
+/************************************************************************/
+/*                      BeginOpeningInThisThread()                      */
+/*                                                                      */
+/*      Counts, per thread, the GDALOpen() and GDALClose() calls made   */
+/*      by the pool that are in progress.                               */
+/************************************************************************/
+
+void GDALDatasetPool::BeginOpeningInThisThread()
+{
+    size_t nCount = (size_t) CPLGetTLS(CTLS_PROXYPOOLOPENING);
+    CPLSetTLS(CTLS_PROXYPOOLOPENING, (void*) (nCount + 1), FALSE);
+}
+
+void GDALDatasetPool::EndOpeningInThisThread()
+{
+    size_t nCount = (size_t) CPLGetTLS(CTLS_PROXYPOOLOPENING);
+    CPLAssert(nCount > 0);
+    CPLSetTLS(CTLS_PROXYPOOLOPENING, (void*) (nCount - 1), FALSE);
+}
+
+int GDALDatasetPool::IsOpeningInThisThread()
+{
+    return CPLGetTLS(CTLS_PROXYPOOLOPENING) != NULL;
+}
+
+/************************************************************************/
+/*                            CloseDataset()                            */
+/************************************************************************/
+
+void GDALDatasetPool::CloseDataset(GDALDataset* poDS, GIntBig responsiblePID)
+{
+    if (poDS == NULL)
+        return;
+
+    /* Close by pretending we are the thread that GDALOpen'ed this */
+    /* dataset */
+    GIntBig curResponsiblePID = GDALGetResponsiblePIDForCurrentThread();
+
+    BeginOpeningInThisThread();
+    GDALSetResponsiblePIDForCurrentThread(responsiblePID);
+    GDALClose(poDS);
+    GDALSetResponsiblePIDForCurrentThread(curResponsiblePID);
+    EndOpeningInThisThread();
+}
+
+/************************************************************************/
+/*                            StealEntry()                              */
+/*                                                                      */
+/*      Removes the least recently used entry that is not in use from   */
+/*      the shards other than psShard. Its pool slot is handed over to  */
+/*      the caller, that must close the returned dataset. Must be       */
+/*      called without holding any shard mutex.                         */
+/************************************************************************/
+
+int GDALDatasetPool::StealEntry(GDALDatasetPoolShard* psShard,
+                                GDALDataset** ppoDS, GIntBig* pResponsiblePID)
+{
+    int iShard = (int) (psShard - pasShards);
+
+    for(int i=1;i<nShards;i++)
+    {
+        GDALDatasetPoolShard* psOther = &pasShards[(iShard + i) % nShards];
+        CPLMutexHolderD( &(psOther->hMutex) );
+
+        GDALProxyPoolCacheEntry* cur = psOther->lastEntry;
+        while (cur != NULL && cur->refCount != 0)
+            cur = cur->prev;
+        if (cur == NULL)
+            continue;
+
+        CPLHashSetRemove(psOther->hEntrySet, cur);
+        if (cur->prev)
+            cur->prev->next = cur->next;
+        else
+            psOther->firstEntry = cur->next;
+        if (cur->next)
+            cur->next->prev = cur->prev;
+        else
+            psOther->lastEntry = cur->prev;
+        psOther->currentSize --;
+
+#ifdef DEBUG_PROXY_POOL
+        CheckLinks(psOther);
+#endif
+
+        *ppoDS = cur->poDS;
+        *pResponsiblePID = cur->responsiblePID;
+        CPLFree(cur->pszFileName);
+        CPLFree(cur);
+        return TRUE;
+    }
+
+    return FALSE;
 }
 
 /************************************************************************/
@@ -188,48 +373,100 @@ void GDALDatasetPool::CheckLinks()
 
 GDALProxyPoolCacheEntry* GDALDatasetPool::_RefDataset(const char* pszFileName, GDALAccess eAccess)
 {
-    GDALProxyPoolCacheEntry* cur = firstEntry;
     GIntBig responsiblePID = GDALGetResponsiblePIDForCurrentThread();
-    GDALProxyPoolCacheEntry* lastEntryWithZeroRefCount = NULL;
+    GDALProxyPoolCacheEntry sKey;
+    GDALProxyPoolCacheEntry* cur;
+    GDALDataset* poDSToClose = NULL;
+    GIntBig responsiblePIDToClose = 0;
+    int bHasSlot = FALSE;
 
-    while(cur)
+    sKey.pszFileName = (char*) pszFileName;
+    sKey.responsiblePID = responsiblePID;
+    sKey.nHash = GDALProxyPoolEntryHash(pszFileName, responsiblePID);
+
+    GDALDatasetPoolShard* psShard = &pasShards[sKey.nHash % nShards];
+
+    CPLAcquireMutex(psShard->hMutex, 1000.0);
+
+    while (TRUE)
     {
-        GDALProxyPoolCacheEntry* next = cur->next;
+        while( (cur = (GDALProxyPoolCacheEntry*)
+                            CPLHashSetLookup(psShard->hEntrySet, &sKey)) != NULL
+               && cur->bOpening && cur->openingPID != CPLGetPID() )
+        {
+            /* Another thread is opening it on behalf of the same */
+            /* responsible PID : wait for it to be done */
+            CPLCondWait(psShard->hCond, psShard->hMutex);
+        }
 
-        if (strcmp(cur->pszFileName, pszFileName) == 0 &&
-            cur->responsiblePID == responsiblePID)
+        if (cur != NULL)
         {
-            if (cur != firstEntry)
+            if (cur != psShard->firstEntry)
             {
                 /* Move to begin */
                 if (cur->next)
                     cur->next->prev = cur->prev;
                 else
-                    lastEntry = cur->prev;
+                    psShard->lastEntry = cur->prev;
                 cur->prev->next = cur->next;
                 cur->prev = NULL;
-                firstEntry->prev = cur;
-                cur->next = firstEntry;
-                firstEntry = cur;
+                psShard->firstEntry->prev = cur;
+                cur->next = psShard->firstEntry;
+                psShard->firstEntry = cur;
 
 #ifdef DEBUG_PROXY_POOL
-                CheckLinks();
+                CheckLinks(psShard);
 #endif
             }
 
             cur->refCount ++;
+            CPLReleaseMutex(psShard->hMutex);
+
+            /* Another thread has opened it while we were taking an */
+            /* entry from another shard : give its slot back */
+            if (bHasSlot)
+            {
+                CPLAtomicDec(&currentSize);
+                CloseDataset(poDSToClose, responsiblePIDToClose);
+            }
             return cur;
         }
 
-        if (cur->refCount == 0)
-            lastEntryWithZeroRefCount = cur;
+        if (bHasSlot)
+            break;
 
-        cur = next;
-    }
+/* -------------------------------------------------------------------- */
+/*      Look for the least recently used entry of this shard that is    */
+/*      not in use, if the shard or the whole pool is full.             */
+/* -------------------------------------------------------------------- */
+        if (psShard->currentSize >= shardMaxSize || currentSize >= maxSize)
+        {
+            cur = psShard->lastEntry;
+            while (cur != NULL && cur->refCount != 0)
+                cur = cur->prev;
+            if (cur != NULL)
+                break;
+        }
 
-    if (currentSize == maxSize)
-    {
-        if (lastEntryWithZeroRefCount == NULL)
+/* -------------------------------------------------------------------- */
+/*      Otherwise take a new slot of the pool. The slots are counted    */
+/*      atomically as the shards are filled concurrently.               */
+/* -------------------------------------------------------------------- */
+        if (CPLAtomicInc(&currentSize) <= maxSize)
+        {
+            bHasSlot = TRUE;
+            break;
+        }
+        CPLAtomicDec(&currentSize);
+
+/* -------------------------------------------------------------------- */
+/*      The pool is full : take the slot of an entry that is not in     */
+/*      use in another shard. Our shard is not locked meanwhile, so     */
+/*      the dataset must be looked up again.                            */
+/* -------------------------------------------------------------------- */
+        CPLReleaseMutex(psShard->hMutex);
+
+        if (!StealEntry(psShard, &poDSToClose, &responsiblePIDToClose))
         {
             CPLError(CE_Failure, CPLE_AppDefined,
                      "Too many threads are running for the current value of the dataset pool size (%d).\n"
@@ -237,73 +474,94 @@ GDALProxyPoolCacheEntry* GDALDatasetPool::_RefDataset(const char* pszFileName, G
                      "Try increasing GDAL_MAX_DATASET_POOL_SIZE.", maxSize);
             return NULL;
         }
+        bHasSlot = TRUE;
 
-        CPLFree(lastEntryWithZeroRefCount->pszFileName);
-        lastEntryWithZeroRefCount->pszFileName = NULL;
-        if (lastEntryWithZeroRefCount->poDS)
-        {
-            /* Close by pretending we are the thread that GDALOpen'ed this */
-            /* dataset */
-            GDALSetResponsiblePIDForCurrentThread(lastEntryWithZeroRefCount->responsiblePID);
-
-            refCountOfDisableRefCount ++;
-            GDALClose(lastEntryWithZeroRefCount->poDS);
-            refCountOfDisableRefCount --;
-
-            lastEntryWithZeroRefCount->poDS = NULL;
-            GDALSetResponsiblePIDForCurrentThread(responsiblePID);
-        }
+        CPLAcquireMutex(psShard->hMutex, 1000.0);
+    }
 
+    if (!bHasSlot)
+    {
         /* Recycle this entry for the to-be-openeded dataset and */
-        /* moves it to the top of the list */
-        if (lastEntryWithZeroRefCount->prev)
-            lastEntryWithZeroRefCount->prev->next = lastEntryWithZeroRefCount->next;
-        else
-            CPLAssert(0);
-        if (lastEntryWithZeroRefCount->next)
-            lastEntryWithZeroRefCount->next->prev = lastEntryWithZeroRefCount->prev;
-        else
+        /* moves it to the top of the list. Its dataset will be */
+        /* closed once the mutex has been released */
+        CPLHashSetRemove(psShard->hEntrySet, cur);
+        CPLFree(cur->pszFileName);
+        cur->pszFileName = NULL;
+        poDSToClose = cur->poDS;
+        responsiblePIDToClose = cur->responsiblePID;
+
+        if (cur != psShard->firstEntry)
         {
-            CPLAssert(lastEntryWithZeroRefCount == lastEntry);
-            lastEntry->prev->next = NULL;
-            lastEntry = lastEntry->prev;
+            if (cur->next)
+                cur->next->prev = cur->prev;
+            else
+                psShard->lastEntry = cur->prev;
+            cur->prev->next = cur->next;
+            cur->prev = NULL;
+            cur->next = psShard->firstEntry;
+            psShard->firstEntry->prev = cur;
+            psShard->firstEntry = cur;
         }
-        lastEntryWithZeroRefCount->prev = NULL;
-        lastEntryWithZeroRefCount->next = firstEntry;
-        firstEntry->prev = lastEntryWithZeroRefCount;
-        cur = firstEntry = lastEntryWithZeroRefCount;
-#ifdef DEBUG_PROXY_POOL
-        CheckLinks();
-#endif
     }
     else
     {
         /* Prepend */
         cur = (GDALProxyPoolCacheEntry*) CPLMalloc(sizeof(GDALProxyPoolCacheEntry));
-        if (lastEntry == NULL)
-            lastEntry = cur;
+        if (psShard->lastEntry == NULL)
+            psShard->lastEntry = cur;
         cur->prev = NULL;
-        cur->next = firstEntry;
-        if (firstEntry)
-            firstEntry->prev = cur;
-        firstEntry = cur;
-        currentSize ++;
-#ifdef DEBUG_PROXY_POOL
-        CheckLinks();
-#endif
+        cur->next = psShard->firstEntry;
+        if (psShard->firstEntry)
+            psShard->firstEntry->prev = cur;
+        psShard->firstEntry = cur;
+        psShard->currentSize ++;
     }
 
     cur->pszFileName = CPLStrdup(pszFileName);
     cur->responsiblePID = responsiblePID;
+    cur->nHash = sKey.nHash;
+    cur->iShard = (int) (psShard - pasShards);
     cur->refCount = 1;
+    cur->poDS = NULL;
+    cur->bOpening = TRUE;
+    cur->openingPID = CPLGetPID();
+    CPLHashSetInsert(psShard->hEntrySet, cur);
+
+#ifdef DEBUG_PROXY_POOL
+    CheckLinks(psShard);
+#endif
+
+    CPLReleaseMutex(psShard->hMutex);
+
+/* -------------------------------------------------------------------- */
+/*      Close the dataset of the recycled entry, and open the new one.  */
+/* -------------------------------------------------------------------- */
+    CloseDataset(poDSToClose, responsiblePIDToClose);
 
-    refCountOfDisableRefCount ++;
-    cur->poDS = (GDALDataset*) GDALOpen(pszFileName, eAccess);
-    refCountOfDisableRefCount --;
+    BeginOpeningInThisThread();
+    GDALDataset* poDS = (GDALDataset*) GDALOpen(pszFileName, eAccess);
+    EndOpeningInThisThread();
+
+    CPLAcquireMutex(psShard->hMutex, 1000.0);
+    cur->poDS = poDS;
+    cur->bOpening = FALSE;
+    CPLCondBroadcast(psShard->hCond);
+    CPLReleaseMutex(psShard->hMutex);
 
     return cur;
 }
 
+/************************************************************************/
+/*                           _UnrefDataset()                            */
+/************************************************************************/
+
+void GDALDatasetPool::_UnrefDataset(GDALProxyPoolCacheEntry* cacheEntry)
+{
+    GDALDatasetPoolShard* psShard = &pasShards[cacheEntry->iShard];
+    CPLMutexHolderD( &(psShard->hMutex) );
+    cacheEntry->refCount --;
+}
+
 /************************************************************************/
 /*                                 Ref()                                */
 /************************************************************************/
@@ -314,11 +572,15 @@ void GDALDatasetPool::Ref()
     if (singleton == NULL)
     {
         int maxSize = atoi(CPLGetConfigOption("GDAL_MAX_DATASET_POOL_SIZE", "100"));
-        if (maxSize < 2 || maxSize > 1000)
+        if (maxSize < 2 || maxSize > 100000)
             maxSize = 100;
-        singleton = new GDALDatasetPool(maxSize);
+        int nShards = atoi(CPLGetConfigOption("GDAL_DATASET_POOL_SHARDS",
+                                              CPLSPrintf("%d", MIN(16, MAX(1, maxSize / 16)))));
+        if (nShards < 1 || nShards > maxSize)
+            nShards = 1;
+        singleton = new GDALDatasetPool(maxSize, nShards);
     }
-    if (singleton->refCountOfDisableRefCount == 0)
+    if (singleton->refCountOfDisableRefCount == 0 && !IsOpeningInThisThread())
       singleton->refCount++;
 }
 
@@ -350,7 +612,7 @@ void GDALDatasetPool::Unref()
         CPLAssert(0);
         return;
     }
-    if (singleton->refCountOfDisableRefCount == 0)
+    if (singleton->refCountOfDisableRefCount == 0 && !IsOpeningInThisThread())
     {
       singleton->refCount--;
       if (singleton->refCount == 0)
@@ -386,7 +648,6 @@ void GDALDatasetPoolForceDestroy()
 
 GDALProxyPoolCacheEntry* GDALDatasetPool::RefDataset(const char* pszFileName, GDALAccess eAccess)
 {
-    CPLMutexHolderD( GDALGetphDLMutex() );
     return singleton->_RefDataset(pszFileName, eAccess);
 }
 
@@ -396,8 +657,7 @@ GDALProxyPoolCacheEntry* GDALDatasetPool::RefDataset(const char* pszFileName, GD
 
 void GDALDatasetPool::UnrefDataset(GDALProxyPoolCacheEntry* cacheEntry)
 {
-    CPLMutexHolderD( GDALGetphDLMutex() );
-    cacheEntry->refCount --;
+    singleton->_UnrefDataset(cacheEntry);
 }
 
 CPL_C_START
@@ -69,6 +69,8 @@ GDALRasterBand::GDALRasterBand()
     bOwnMask = false;
     nMaskFlags = 0;
 
+    nCachePriority = -1;
+
     nBlockReads = 0;
     bForceCachedIO =  CSLTestBoolean( 
         CPLGetConfigOption( "GDAL_FORCE_CACHING", "NO") );
@@ -87,6 +89,7 @@ GDALRasterBand::~GDALRasterBand()
 
 {
     FlushCache();
+    GDALRasterBlock::ForgetBand( this );
 
     CPLFree( papoBlocks );
 
@@ -184,6 +187,10 @@ CPLErr GDALRasterBand::RasterIO( GDALRWFlag eRWFlag,
                                  int nLineSpace )
 
 {
+    if( poDS != NULL )
+        poDS->WaitForPrefetch();
+
+    GDALDatasetIOHolder oIOHolder( poDS );
 
     if( NULL == pData )
     {
@@ -387,6 +394,11 @@ CPLErr GDALRasterBand::ReadBlock( int nXBlockOff, int nYBlockOff,
                                    void * pImage )
 
 {
+    if( poDS != NULL )
+        poDS->WaitForPrefetch();
+
+    GDALDatasetIOHolder oIOHolder( poDS );
+
 /* -------------------------------------------------------------------- */
 /*      Validate arguments.                                             */
 /* -------------------------------------------------------------------- */
@@ -418,7 +430,15 @@ CPLErr GDALRasterBand::ReadBlock( int nXBlockOff, int nYBlockOff,
 /* -------------------------------------------------------------------- */
 /*      Invoke underlying implementation method.                        */
 /* -------------------------------------------------------------------- */
-    return( IReadBlock( nXBlockOff, nYBlockOff, pImage ) );
+    double dfStartTime = GDALRasterBlock::GetIOClock();
+    CPLErr eErr = IReadBlock( nXBlockOff, nYBlockOff, pImage );
+
+    GDALRasterBlock::RecordDriverRead( 
+        this, FALSE, 
+        nBlockXSize * nBlockYSize * (GDALGetDataTypeSize(eDataType) / 8),
+        GDALRasterBlock::GetIOClock() - dfStartTime );
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -458,6 +478,22 @@ CPLErr GDALRasterBand::IWriteBlock( int, int, void * )
     return( CE_Failure );
 }
 
+/************************************************************************/
+/*                         CanReadBlockDirect()                         */
+/*                                                                      */
+/*      Returns TRUE if IReadBlock() may be passed a caller buffer      */
+/*      instead of the data of a cached block, so that block aligned    */
+/*      RasterIO() requests bypass the block cache.  Drivers whose      */
+/*      IReadBlock() relies on the block being in the cache, or that    */
+/*      must read blocks in sequence, should keep the default.          */
+/************************************************************************/
+
+int GDALRasterBand::CanReadBlockDirect()
+
+{
+    return FALSE;
+}
+
 /************************************************************************/
 /*                             WriteBlock()                             */
 /************************************************************************/
@@ -490,6 +526,11 @@ CPLErr GDALRasterBand::WriteBlock( int nXBlockOff, int nYBlockOff,
                                    void * pImage )
 
 {
+    if( poDS != NULL )
+        poDS->WaitForPrefetch();
+
+    GDALDatasetIOHolder oIOHolder( poDS );
+
 /* -------------------------------------------------------------------- */
 /*      Validate arguments.                                             */
 /* -------------------------------------------------------------------- */
@@ -539,7 +580,15 @@ CPLErr GDALRasterBand::WriteBlock( int nXBlockOff, int nYBlockOff,
 /* -------------------------------------------------------------------- */
 /*      Invoke underlying implementation method.                        */
 /* -------------------------------------------------------------------- */
-    return( IWriteBlock( nXBlockOff, nYBlockOff, pImage ) );
+    double dfStartTime = GDALRasterBlock::GetIOClock();
+    CPLErr eErr = IWriteBlock( nXBlockOff, nYBlockOff, pImage );
+
+    GDALRasterBlock::RecordDriverWrite( 
+        this, FALSE, 
+        nBlockXSize * nBlockYSize * (GDALGetDataTypeSize(eDataType) / 8),
+        GDALRasterBlock::GetIOClock() - dfStartTime );
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -899,6 +948,8 @@ CPLErr GDALRasterBand::FlushCache()
     if (papoBlocks == NULL)
         return eGlobalErr;
 
+    GDALDatasetIOHolder oIOHolder( poDS );
+
 /* -------------------------------------------------------------------- */
 /*      Flush all blocks in memory ... this case is without subblocking.*/
 /* -------------------------------------------------------------------- */
@@ -1107,12 +1158,16 @@ CPLErr GDALRasterBand::FlushBlock( int nXBlockOff, int nYBlockOff, int bWriteDir
  *
  * @param nYBlockOff the vertical block offset, with zero indicating
  * the top most block, 1 the next block and so forth.
+ *
+ * @param bCountHit TRUE if the block is requested for its content, so that
+ * finding it counts as a cache hit in the cache statistics.
  * 
  * @return NULL if block not available, or locked block pointer. 
  */
 
 GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff, 
-                                                       int nYBlockOff )
+                                                       int nYBlockOff,
+                                                       int bCountHit )
 
 {
     int             nBlockIndex = 0;
@@ -1150,7 +1205,7 @@ GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff,
     {
         nBlockIndex = nXBlockOff + nYBlockOff * nBlocksPerRow;
         
-        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex );
+        GDALRasterBlock::SafeLockBlock( papoBlocks + nBlockIndex, bCountHit );
 
         return papoBlocks[nBlockIndex];
     }
@@ -1173,7 +1228,8 @@ GDALRasterBlock *GDALRasterBand::TryGetLockedBlockRef( int nXBlockOff,
     int nBlockInSubBlock = WITHIN_SUBBLOCK(nXBlockOff)
         + WITHIN_SUBBLOCK(nYBlockOff) * SUBBLOCK_SIZE;
 
-    GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock );
+    GDALRasterBlock::SafeLockBlock( papoSubBlockGrid + nBlockInSubBlock,
+                                    bCountHit );
 
     return papoSubBlockGrid[nBlockInSubBlock];
 }
@@ -1220,9 +1276,21 @@ GDALRasterBlock * GDALRasterBand::GetLockedBlockRef( int nXBlockOff,
     GDALRasterBlock *poBlock = NULL;
 
 /* -------------------------------------------------------------------- */
-/*      Try and fetch from cache.                                       */
+/*      Try and fetch from cache.  A block being loaded by a prefetch   */
+/*      (see GDALDataset::StartPrefetch()) is already in the cache,     */
+/*      but not read yet.                                               */
 /* -------------------------------------------------------------------- */
-    poBlock = TryGetLockedBlockRef( nXBlockOff, nYBlockOff );
+    if( poDS != NULL )
+        poDS->WaitForPrefetchedBlock( nBand, nXBlockOff, nYBlockOff );
+
+    poBlock = TryGetLockedBlockRef( nXBlockOff, nYBlockOff, TRUE );
+
+/* -------------------------------------------------------------------- */
+/*      Otherwise, the driver must not be used by the prefetch at the   */
+/*      same time, and the prefetch may have loaded the block.          */
+/* -------------------------------------------------------------------- */
+    if( poBlock == NULL && poDS != NULL && poDS->WaitForPrefetch() )
+        poBlock = TryGetLockedBlockRef( nXBlockOff, nYBlockOff, TRUE );
 
 /* -------------------------------------------------------------------- */
 /*      If we didn't find it in our memory cache, instantiate a         */
@@ -1231,6 +1299,8 @@ GDALRasterBlock * GDALRasterBand::GetLockedBlockRef( int nXBlockOff,
 /* -------------------------------------------------------------------- */
     if( poBlock == NULL )
     {
+        GDALDatasetIOHolder oIOHolder( poDS );
+
         if( !InitBlockInfo() )
             return( NULL );
 
@@ -1276,8 +1346,21 @@ GDALRasterBlock * GDALRasterBand::GetLockedBlockRef( int nXBlockOff,
             return( NULL );
         }
 
-        if( !bJustInitialize
-         && IReadBlock(nXBlockOff,nYBlockOff,poBlock->GetDataRef()) != CE_None)
+        CPLErr eErr = CE_None;
+
+        if( !bJustInitialize )
+        {
+            double dfStartTime = GDALRasterBlock::GetIOClock();
+
+            eErr = IReadBlock( nXBlockOff, nYBlockOff, poBlock->GetDataRef() );
+
+            GDALRasterBlock::RecordDriverRead( 
+                this, TRUE,
+                nBlockXSize * nBlockYSize * (GDALGetDataTypeSize(eDataType)/8),
+                GDALRasterBlock::GetIOClock() - dfStartTime );
+        }
+
+        if( eErr != CE_None )
         {
             poBlock->DropLock();
             FlushBlock( nXBlockOff, nYBlockOff );
@@ -2687,6 +2770,100 @@ GDALDatasetH CPL_STDCALL GDALGetBandDataset( GDALRasterBandH hBand )
     return (GDALDatasetH) poBand->GetDataset();
 }
 
+/************************************************************************/
+/*                        AccumulateStatistics()                        */
+/************************************************************************/
+
+/**
+ * \brief Feed the band values used for statistics to an accumulator.
+ *
+ * If bApproxOK is TRUE, a reduced resolution image is read if the band
+ * has arbitrary overviews, otherwise only a subset of the blocks are read.
+ * Overviews without arbitrary resolution are selected by the callers.
+ *
+ * @see GDALRasterStatsAccumulator::AccumulateBlocks()
+ *
+ * @param poAccum the accumulator.
+ * @param bApproxOK TRUE if a sampling of the values is sufficient.
+ * @param bFailOnReadError TRUE to fail if a block cannot be read, FALSE
+ * to skip it.
+ * @param pszMessage the progress message.
+ * @param pfnProgress function to report progress to completion.
+ * @param pProgressData application data to pass to pfnProgress.
+ *
+ * @return CE_None on success, or CE_Failure if something goes wrong.
+ */
+
+CPLErr GDALRasterBand::AccumulateStatistics( GDALRasterStatsAccumulator *poAccum,
+                                             int bApproxOK,
+                                             int bFailOnReadError,
+                                             const char *pszMessage,
+                                             GDALProgressFunc pfnProgress,
+                                             void *pProgressData )
+
+{
+    if( bApproxOK && HasArbitraryOverviews() )
+    {
+/* -------------------------------------------------------------------- */
+/*      Figure out how much the image should be reduced to get an       */
+/*      approximate value.                                              */
+/* -------------------------------------------------------------------- */
+        void    *pData;
+        int     nXReduced, nYReduced;
+        double  dfReduction = sqrt(
+            (double)nRasterXSize * nRasterYSize / GDALSTAT_APPROX_NUMSAMPLES );
+
+        if ( dfReduction > 1.0 )
+        {
+            nXReduced = (int)( nRasterXSize / dfReduction );
+            nYReduced = (int)( nRasterYSize / dfReduction );
+
+            // Catch the case of huge resizing ratios here
+            if ( nXReduced == 0 )
+                nXReduced = 1;
+            if ( nYReduced == 0 )
+                nYReduced = 1;
+        }
+        else
+        {
+            nXReduced = nRasterXSize;
+            nYReduced = nRasterYSize;
+        }
+
+        pData =
+            CPLMalloc(GDALGetDataTypeSize(eDataType)/8 * nXReduced * nYReduced);
+
+        CPLErr eErr = IRasterIO( GF_Read, 0, 0, nRasterXSize, nRasterYSize, pData,
+                   nXReduced, nYReduced, eDataType, 0, 0 );
+        if ( eErr == CE_None )
+            poAccum->AddBlock( pData, nXReduced, nYReduced, nXReduced );
+
+        CPLFree( pData );
+        return eErr;
+    }
+
+    if( !InitBlockInfo() )
+        return CE_Failure;
+
+/* -------------------------------------------------------------------- */
+/*      Figure out the ratio of blocks we will read to get an           */
+/*      approximate value.                                              */
+/* -------------------------------------------------------------------- */
+    int nSampleRate;
+
+    if ( bApproxOK )
+        nSampleRate = 
+            (int) MAX( 1, sqrt((double) nBlocksPerRow * nBlocksPerColumn) );
+    else
+        nSampleRate = 1;
+
+    GDALRasterBand *poThis = this;
+
+    return GDALRasterStatsAccumulator::AccumulateBlocks(
+        1, &poThis, &poAccum, nSampleRate, bFailOnReadError,
+        pszMessage, pfnProgress, pProgressData );
+}
+
 /************************************************************************/
 /*                            GetHistogram()                            */
 /************************************************************************/
@@ -2761,7 +2938,7 @@ CPLErr GDALRasterBand::GetHistogram( double dfMin, double dfMax,
 /* -------------------------------------------------------------------- */
 /*      Read actual data and build histogram.                           */
 /* -------------------------------------------------------------------- */
-    double      dfScale;
+    memset( panHistogram, 0, sizeof(int) * nBuckets );
 
     if( !pfnProgress( 0.0, "Compute Histogram", pProgressData ) )
     {
@@ -2769,338 +2946,20 @@ CPLErr GDALRasterBand::GetHistogram( double dfMin, double dfMax,
         return CE_Failure;
     }
 
-    dfScale = nBuckets / (dfMax - dfMin);
-    memset( panHistogram, 0, sizeof(int) * nBuckets );
-
     const char* pszPixelType = GetMetadataItem("PIXELTYPE", "IMAGE_STRUCTURE");
     int bSignedByte = (pszPixelType != NULL && EQUAL(pszPixelType, "SIGNEDBYTE"));
 
-    if ( bApproxOK && HasArbitraryOverviews() )
-    {
-/* -------------------------------------------------------------------- */
-/*      Figure out how much the image should be reduced to get an       */
-/*      approximate value.                                              */
-/* -------------------------------------------------------------------- */
-        void    *pData;
-        int     nXReduced, nYReduced;
-        double  dfReduction = sqrt(
-            (double)nRasterXSize * nRasterYSize / GDALSTAT_APPROX_NUMSAMPLES );
-
-        if ( dfReduction > 1.0 )
-        {
-            nXReduced = (int)( nRasterXSize / dfReduction );
-            nYReduced = (int)( nRasterYSize / dfReduction );
-
-            // Catch the case of huge resizing ratios here
-            if ( nXReduced == 0 )
-                nXReduced = 1;
-            if ( nYReduced == 0 )
-                nYReduced = 1;
-        }
-        else
-        {
-            nXReduced = nRasterXSize;
-            nYReduced = nRasterYSize;
-        }
-
-        pData =
-            CPLMalloc(GDALGetDataTypeSize(eDataType)/8 * nXReduced * nYReduced);
-
-        CPLErr eErr = IRasterIO( GF_Read, 0, 0, nRasterXSize, nRasterYSize, pData,
-                   nXReduced, nYReduced, eDataType, 0, 0 );
-        if ( eErr != CE_None )
-        {
-            CPLFree(pData);
-            return eErr;
-        }
-        
-        /* this isn't the fastest way to do this, but is easier for now */
-        for( int iY = 0; iY < nYReduced; iY++ )
-        {
-            for( int iX = 0; iX < nXReduced; iX++ )
-            {
-                int    iOffset = iX + iY * nXReduced;
-                int    nIndex;
-                double dfValue = 0.0;
-
-                switch( eDataType )
-                {
-                  case GDT_Byte:
-                  {
-                    if (bSignedByte)
-                        dfValue = ((signed char *)pData)[iOffset];
-                    else
-                        dfValue = ((GByte *)pData)[iOffset];
-                    break;
-                  }
-                  case GDT_UInt16:
-                    dfValue = ((GUInt16 *)pData)[iOffset];
-                    break;
-                  case GDT_Int16:
-                    dfValue = ((GInt16 *)pData)[iOffset];
-                    break;
-                  case GDT_UInt32:
-                    dfValue = ((GUInt32 *)pData)[iOffset];
-                    break;
-                  case GDT_Int32:
-                    dfValue = ((GInt32 *)pData)[iOffset];
-                    break;
-                  case GDT_Float32:
-                    dfValue = ((float *)pData)[iOffset];
-                    if (CPLIsNan(dfValue))
-                        continue;
-                    break;
-                  case GDT_Float64:
-                    dfValue = ((double *)pData)[iOffset];
-                    if (CPLIsNan(dfValue))
-                        continue;
-                    break;
-                  case GDT_CInt16:
-                    {
-                        double dfReal = ((GInt16 *)pData)[iOffset*2];
-                        double dfImag = ((GInt16 *)pData)[iOffset*2+1];
-                        if ( CPLIsNan(dfReal) || CPLIsNan(dfImag) )
-                            continue;
-                        dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                    }
-                    break;
-                  case GDT_CInt32:
-                    {
-                        double dfReal = ((GInt32 *)pData)[iOffset*2];
-                        double dfImag = ((GInt32 *)pData)[iOffset*2+1];
-                        if ( CPLIsNan(dfReal) || CPLIsNan(dfImag) )
-                            continue;
-                        dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                    }
-                    break;
-                  case GDT_CFloat32:
-                    {
-                        double dfReal = ((float *)pData)[iOffset*2];
-                        double dfImag = ((float *)pData)[iOffset*2+1];
-                        if ( CPLIsNan(dfReal) || CPLIsNan(dfImag) )
-                            continue;
-                        dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                    }
-                    break;
-                  case GDT_CFloat64:
-                    {
-                        double dfReal = ((double *)pData)[iOffset*2];
-                        double dfImag = ((double *)pData)[iOffset*2+1];
-                        if ( CPLIsNan(dfReal) || CPLIsNan(dfImag) )
-                            continue;
-                        dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                    }
-                    break;
-                  default:
-                    CPLAssert( FALSE );
-                }
-
-                nIndex = (int) floor((dfValue - dfMin) * dfScale);
-                
-                if( nIndex < 0 )
-                {
-                    if( bIncludeOutOfRange )
-                        panHistogram[0]++;
-                }
-                else if( nIndex >= nBuckets )
-                {
-                    if( bIncludeOutOfRange )
-                        panHistogram[nBuckets-1]++;
-                }
-                else
-                {
-                    panHistogram[nIndex]++;
-                }
-            }
-        }
-
-        CPLFree( pData );
-    }
-
-    else    // No arbitrary overviews
-    {
-        int         nSampleRate;
-
-        if( !InitBlockInfo() )
-            return CE_Failure;
-    
-/* -------------------------------------------------------------------- */
-/*      Figure out the ratio of blocks we will read to get an           */
-/*      approximate value.                                              */
-/* -------------------------------------------------------------------- */
-
-        if ( bApproxOK )
-        {
-            nSampleRate = 
-                (int) MAX(1,sqrt((double) nBlocksPerRow * nBlocksPerColumn));
-        }
-        else
-            nSampleRate = 1;
-    
-/* -------------------------------------------------------------------- */
-/*      Read the blocks, and add to histogram.                          */
-/* -------------------------------------------------------------------- */
-        for( int iSampleBlock = 0; 
-             iSampleBlock < nBlocksPerRow * nBlocksPerColumn;
-             iSampleBlock += nSampleRate )
-        {
-            int  iXBlock, iYBlock, nXCheck, nYCheck;
-            GDALRasterBlock *poBlock;
-            void* pData;
-
-            if( !pfnProgress( iSampleBlock
-                              / ((double)nBlocksPerRow * nBlocksPerColumn),
-                              "Compute Histogram", pProgressData ) )
-                return CE_Failure;
-
-            iYBlock = iSampleBlock / nBlocksPerRow;
-            iXBlock = iSampleBlock - nBlocksPerRow * iYBlock;
-            
-            poBlock = GetLockedBlockRef( iXBlock, iYBlock );
-            if( poBlock == NULL )
-                return CE_Failure;
-            if( poBlock->GetDataRef() == NULL )
-            {
-                poBlock->DropLock();
-                return CE_Failure;
-            }
-            
-            pData = poBlock->GetDataRef();
-            
-            if( (iXBlock+1) * nBlockXSize > GetXSize() )
-                nXCheck = GetXSize() - iXBlock * nBlockXSize;
-            else
-                nXCheck = nBlockXSize;
-
-            if( (iYBlock+1) * nBlockYSize > GetYSize() )
-                nYCheck = GetYSize() - iYBlock * nBlockYSize;
-            else
-                nYCheck = nBlockYSize;
-
-            /* this is a special case for a common situation */
-            if( eDataType == GDT_Byte && !bSignedByte
-                && dfScale == 1.0 && (dfMin >= -0.5 && dfMin <= 0.5)
-                && nYCheck == nBlockYSize && nXCheck == nBlockXSize
-                && nBuckets == 256 )
-            {
-                int    nPixels = nXCheck * nYCheck;
-                GByte  *pabyData = (GByte *) pData;
-                
-                for( int i = 0; i < nPixels; i++ )
-                    panHistogram[pabyData[i]]++;
-
-                poBlock->DropLock();
-                continue; /* to next sample block */
-            }
-
-            /* this isn't the fastest way to do this, but is easier for now */
-            for( int iY = 0; iY < nYCheck; iY++ )
-            {
-                for( int iX = 0; iX < nXCheck; iX++ )
-                {
-                    int    iOffset = iX + iY * nBlockXSize;
-                    int    nIndex;
-                    double dfValue = 0.0;
+    GDALRasterStatsAccumulator oAccum( eDataType, bSignedByte, FALSE, 0.0 );
+    CPLErr eErr;
 
-                    switch( eDataType )
-                    {
-                      case GDT_Byte:
-                      {
-                        if (bSignedByte)
-                            dfValue = ((signed char *) pData)[iOffset];
-                        else
-                            dfValue = ((GByte *) pData)[iOffset];
-                        break;
-                      }
-                      case GDT_UInt16:
-                        dfValue = ((GUInt16 *) pData)[iOffset];
-                        break;
-                      case GDT_Int16:
-                        dfValue = ((GInt16 *) pData)[iOffset];
-                        break;
-                      case GDT_UInt32:
-                        dfValue = ((GUInt32 *) pData)[iOffset];
-                        break;
-                      case GDT_Int32:
-                        dfValue = ((GInt32 *) pData)[iOffset];
-                        break;
-                      case GDT_Float32:
-                        dfValue = ((float *) pData)[iOffset];
-                        if (CPLIsNan(dfValue))
-                            continue;
-                        break;
-                      case GDT_Float64:
-                        dfValue = ((double *) pData)[iOffset];
-                        if (CPLIsNan(dfValue))
-                            continue;
-                        break;
-                      case GDT_CInt16:
-                        {
-                            double  dfReal =
-                                ((GInt16 *) pData)[iOffset*2];
-                            double  dfImag =
-                                ((GInt16 *) pData)[iOffset*2+1];
-                            dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                        }
-                        break;
-                      case GDT_CInt32:
-                        {
-                            double  dfReal =
-                                ((GInt32 *) pData)[iOffset*2];
-                            double  dfImag =
-                                ((GInt32 *) pData)[iOffset*2+1];
-                            dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                        }
-                        break;
-                      case GDT_CFloat32:
-                        {
-                            double  dfReal =
-                                ((float *) pData)[iOffset*2];
-                            double  dfImag =
-                                ((float *) pData)[iOffset*2+1];
-                            if ( CPLIsNan(dfReal) || CPLIsNan(dfImag) )
-                                continue;
-                            dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                        }
-                        break;
-                      case GDT_CFloat64:
-                        {
-                            double  dfReal =
-                                ((double *) pData)[iOffset*2];
-                            double  dfImag =
-                                ((double *) pData)[iOffset*2+1];
-                            if ( CPLIsNan(dfReal) || CPLIsNan(dfImag) )
-                                continue;
-                            dfValue = sqrt( dfReal * dfReal + dfImag * dfImag );
-                        }
-                        break;
-                      default:
-                        CPLAssert( FALSE );
-                        return CE_Failure;
-                    }
-                    
-                    nIndex = (int) floor((dfValue - dfMin) * dfScale);
+    oAccum.RequestHistogram( dfMin, dfMax, nBuckets, bIncludeOutOfRange );
 
-                    if( nIndex < 0 )
-                    {
-                        if( bIncludeOutOfRange )
-                            panHistogram[0]++;
-                    }
-                    else if( nIndex >= nBuckets )
-                    {
-                        if( bIncludeOutOfRange )
-                            panHistogram[nBuckets-1]++;
-                    }
-                    else
-                    {
-                        panHistogram[nIndex]++;
-                    }
-                }
-            }
+    eErr = AccumulateStatistics( &oAccum, bApproxOK, TRUE, "Compute Histogram",
+                                 pfnProgress, pProgressData );
+    if( eErr != CE_None )
+        return eErr;
 
-            poBlock->DropLock();
-        }
-    }
+    oAccum.GetHistogram( panHistogram );
 
     pfnProgress( 1.0, "Compute Histogram", pProgressData );
 
@@ -3457,6 +3316,9 @@ CPLErr CPL_STDCALL GDALGetRasterStatistics(
  * Once computed, the statistics will generally be "set" back on the 
  * raster band using SetStatistics(). 
  *
+ * Starting with GDAL 1.10, the blocks are processed by the number of threads
+ * set with the GDAL_NUM_THREADS configuration option (1 by default).
+ *
  * This method is the same as the C function GDALComputeRasterStatistics().
  *
  * @param bApproxOK If TRUE statistics may be computed based on overviews
@@ -3509,10 +3371,8 @@ GDALRasterBand::ComputeStatistics( int bApproxOK,
 /* -------------------------------------------------------------------- */
 /*      Read actual data and compute statistics.                        */
 /* -------------------------------------------------------------------- */
-    double      dfMin = 0.0, dfMax = 0.0;
-    int         bGotNoDataValue, bFirstValue = TRUE;
-    double      dfNoDataValue, dfSum = 0.0, dfSum2 = 0.0;
-    GIntBig     nSampleCount = 0;
+    int         bGotNoDataValue;
+    double      dfNoDataValue;
 
     if( !pfnProgress( 0.0, "Compute Statistics", pProgressData ) )
     {
@@ -3521,277 +3381,194 @@ GDALRasterBand::ComputeStatistics( int bApproxOK,
     }
 
     dfNoDataValue = GetNoDataValue( &bGotNoDataValue );
-    bGotNoDataValue = bGotNoDataValue && !CPLIsNan(dfNoDataValue);
 
     const char* pszPixelType = GetMetadataItem("PIXELTYPE", "IMAGE_STRUCTURE");
     int bSignedByte = (pszPixelType != NULL && EQUAL(pszPixelType, "SIGNEDBYTE"));
-    
-    if ( bApproxOK && HasArbitraryOverviews() )
+
+    GDALRasterStatsAccumulator oAccum( eDataType, bSignedByte,
+                                       bGotNoDataValue, dfNoDataValue );
+    CPLErr eErr;
+
+    oAccum.RequestStatistics();
+
+    eErr = AccumulateStatistics( &oAccum, bApproxOK, FALSE,
+                                 "Compute Statistics",
+                                 pfnProgress, pProgressData );
+    if( eErr != CE_None )
+        return eErr;
+
+    if( !pfnProgress( 1.0, "Compute Statistics", pProgressData ) )
     {
+        ReportError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
 /* -------------------------------------------------------------------- */
-/*      Figure out how much the image should be reduced to get an       */
-/*      approximate value.                                              */
+/*      Save computed information.                                      */
 /* -------------------------------------------------------------------- */
-        void    *pData;
-        int     nXReduced, nYReduced;
-        double  dfReduction = sqrt(
-            (double)nRasterXSize * nRasterYSize / GDALSTAT_APPROX_NUMSAMPLES );
+    double dfMin, dfMax, dfMean, dfStdDev;
+    int    bValid = oAccum.GetStatistics( &dfMin, &dfMax, &dfMean, &dfStdDev );
 
-        if ( dfReduction > 1.0 )
-        {
-            nXReduced = (int)( nRasterXSize / dfReduction );
-            nYReduced = (int)( nRasterYSize / dfReduction );
+    if( bValid )
+        SetStatistics( dfMin, dfMax, dfMean, dfStdDev );
 
-            // Catch the case of huge resizing ratios here
-            if ( nXReduced == 0 )
-                nXReduced = 1;
-            if ( nYReduced == 0 )
-                nYReduced = 1;
-        }
-        else
-        {
-            nXReduced = nRasterXSize;
-            nYReduced = nRasterYSize;
-        }
+/* -------------------------------------------------------------------- */
+/*      Record results.                                                 */
+/* -------------------------------------------------------------------- */
+    if( pdfMin != NULL )
+        *pdfMin = dfMin;
+    if( pdfMax != NULL )
+        *pdfMax = dfMax;
 
-        pData =
-            CPLMalloc(GDALGetDataTypeSize(eDataType)/8 * nXReduced * nYReduced);
+    if( pdfMean != NULL )
+        *pdfMean = dfMean;
 
-        CPLErr eErr = IRasterIO( GF_Read, 0, 0, nRasterXSize, nRasterYSize, pData,
-                   nXReduced, nYReduced, eDataType, 0, 0 );
-        if ( eErr != CE_None )
-        {
-            CPLFree(pData);
-            return eErr;
-        }
+    if( pdfStdDev != NULL )
+        *pdfStdDev = dfStdDev;
 
-        /* this isn't the fastest way to do this, but is easier for now */
-        for( int iY = 0; iY < nYReduced; iY++ )
-        {
-            for( int iX = 0; iX < nXReduced; iX++ )
-            {
-                int    iOffset = iX + iY * nXReduced;
-                double dfValue = 0.0;
+    if( bValid )
+        return CE_None;
+    else
+    {
+        ReportError( CE_Failure, CPLE_AppDefined,
+        "Failed to compute statistics, no valid pixels found in sampling." );
+        return CE_Failure;
+    }
+}
 
-                switch( eDataType )
-                {
-                  case GDT_Byte:
-                  {
-                    if (bSignedByte)
-                        dfValue = ((signed char *)pData)[iOffset];
-                    else
-                        dfValue = ((GByte *)pData)[iOffset];
-                    break;
-                  }
-                  case GDT_UInt16:
-                    dfValue = ((GUInt16 *)pData)[iOffset];
-                    break;
-                  case GDT_Int16:
-                    dfValue = ((GInt16 *)pData)[iOffset];
-                    break;
-                  case GDT_UInt32:
-                    dfValue = ((GUInt32 *)pData)[iOffset];
-                    break;
-                  case GDT_Int32:
-                    dfValue = ((GInt32 *)pData)[iOffset];
-                    break;
-                  case GDT_Float32:
-                    dfValue = ((float *)pData)[iOffset];
-                    if (CPLIsNan(dfValue))
-                        continue;
-                    break;
-                  case GDT_Float64:
-                    dfValue = ((double *)pData)[iOffset];
-                    if (CPLIsNan(dfValue))
-                        continue;
-                    break;
-                  case GDT_CInt16:
-                    dfValue = ((GInt16 *)pData)[iOffset*2];
-                    break;
-                  case GDT_CInt32:
-                    dfValue = ((GInt32 *)pData)[iOffset*2];
-                    break;
-                  case GDT_CFloat32:
-                    dfValue = ((float *)pData)[iOffset*2];
-                    if( CPLIsNan(dfValue) )
-                        continue;
-                    break;
-                  case GDT_CFloat64:
-                    dfValue = ((double *)pData)[iOffset*2];
-                    if( CPLIsNan(dfValue) )
-                        continue;
-                    break;
-                  default:
-                    CPLAssert( FALSE );
-                }
-                
-                if( bGotNoDataValue && ARE_REAL_EQUAL(dfValue, dfNoDataValue) )
-                    continue;
+/************************************************************************/
+/*                    GDALComputeRasterStatistics()                     */
+/************************************************************************/
 
-                if( bFirstValue )
-                {
-                    dfMin = dfMax = dfValue;
-                    bFirstValue = FALSE;
-                }
-                else
-                {
-                    dfMin = MIN(dfMin,dfValue);
-                    dfMax = MAX(dfMax,dfValue);
-                }
+/**
+  * \brief Compute image statistics. 
+  *
+  * @see GDALRasterBand::ComputeStatistics()
+  */
+
+CPLErr CPL_STDCALL GDALComputeRasterStatistics( 
+        GDALRasterBandH hBand, int bApproxOK, 
+        double *pdfMin, double *pdfMax, double *pdfMean, double *pdfStdDev,
+        GDALProgressFunc pfnProgress, void *pProgressData )
 
-                dfSum += dfValue;
-                dfSum2 += dfValue * dfValue;
+{
+    VALIDATE_POINTER1( hBand, "GDALComputeRasterStatistics", CE_Failure );
 
-                nSampleCount++;
-            }
-        }
+    GDALRasterBand *poBand = static_cast<GDALRasterBand*>(hBand);
 
-        CPLFree( pData );
-    }
+    return poBand->ComputeStatistics( 
+        bApproxOK, pdfMin, pdfMax, pdfMean, pdfStdDev,
+        pfnProgress, pProgressData );
+}
 
-    else    // No arbitrary overviews
-    {
-        int     nSampleRate;
-        
-        if( !InitBlockInfo() )
-            return CE_Failure;
+/************************************************************************/
+/*                   ComputeStatisticsAndHistogram()                    */
+/************************************************************************/
+
+/**
+ * \brief Compute image statistics and histogram in a single pass.
+ *
+ * This computes the same statistics as ComputeStatistics(), and the same
+ * histogram as GetHistogram() (nodata values are excluded from the
+ * statistics but not from the histogram), while reading the raster only
+ * once.  When bApproxOK is TRUE, the sampling is the one of
+ * ComputeStatistics().
+ *
+ * The statistics are "set" back on the raster band using SetStatistics(),
+ * but the histogram is not saved: use SetDefaultHistogram() for this.
+ *
+ * This method is the same as the C function
+ * GDALComputeRasterStatisticsAndHistogram().
+ *
+ * @param bApproxOK If TRUE statistics may be computed based on overviews
+ * or a subset of all tiles.
+ * @param pdfMin Location into which to load image minimum (may be NULL).
+ * @param pdfMax Location into which to load image maximum (may be NULL).
+ * @param pdfMean Location into which to load image mean (may be NULL).
+ * @param pdfStdDev Location into which to load image standard deviation
+ * (may be NULL).
+ * @param dfHistMin the lower bound of the histogram.
+ * @param dfHistMax the upper bound of the histogram.
+ * @param nBuckets the number of buckets in panHistogram.
+ * @param panHistogram array into which the histogram totals are placed.
+ * @param bIncludeOutOfRange if TRUE values below the histogram range will
+ * mapped into panHistogram[0], and values above will be mapped into
+ * panHistogram[nBuckets-1] otherwise out of range values are discarded.
+ * @param pfnProgress a function to call to report progress, or NULL.
+ * @param pProgressData application data to pass to the progress function.
+ *
+ * @return CE_None on success, or CE_Failure if an error occurs, no valid
+ * pixel is found or processing is terminated by the user.
+ *
+ * @since GDAL 1.10
+ */
+
+CPLErr
+GDALRasterBand::ComputeStatisticsAndHistogram( int bApproxOK,
+                                               double *pdfMin, double *pdfMax,
+                                               double *pdfMean,
+                                               double *pdfStdDev,
+                                               double dfHistMin,
+                                               double dfHistMax,
+                                               int nBuckets, int *panHistogram,
+                                               int bIncludeOutOfRange,
+                                               GDALProgressFunc pfnProgress,
+                                               void *pProgressData )
+
+{
+    CPLAssert( NULL != panHistogram );
+
+    if( pfnProgress == NULL )
+        pfnProgress = GDALDummyProgress;
 
 /* -------------------------------------------------------------------- */
-/*      Figure out the ratio of blocks we will read to get an           */
-/*      approximate value.                                              */
+/*      If we have overview bands, use them.                            */
 /* -------------------------------------------------------------------- */
-        if ( bApproxOK )
-        {
-            nSampleRate = 
-                (int)MAX( 1, sqrt((double)nBlocksPerRow * nBlocksPerColumn) );
-        }
-        else
-            nSampleRate = 1;
+    if( bApproxOK && GetOverviewCount() > 0 && !HasArbitraryOverviews() )
+    {
+        GDALRasterBand *poBand;
 
-        for( int iSampleBlock = 0; 
-             iSampleBlock < nBlocksPerRow * nBlocksPerColumn;
-             iSampleBlock += nSampleRate )
-        {
-            int  iXBlock, iYBlock, nXCheck, nYCheck;
-            GDALRasterBlock *poBlock;
-            void* pData;
-
-            iYBlock = iSampleBlock / nBlocksPerRow;
-            iXBlock = iSampleBlock - nBlocksPerRow * iYBlock;
-            
-            poBlock = GetLockedBlockRef( iXBlock, iYBlock );
-            if( poBlock == NULL )
-                continue;
-            if( poBlock->GetDataRef() == NULL )
-            {
-                poBlock->DropLock();
-                continue;
-            }
-            
-            pData = poBlock->GetDataRef();
-            
-            if( (iXBlock+1) * nBlockXSize > GetXSize() )
-                nXCheck = GetXSize() - iXBlock * nBlockXSize;
-            else
-                nXCheck = nBlockXSize;
+        poBand = GetRasterSampleOverview( GDALSTAT_APPROX_NUMSAMPLES );
 
-            if( (iYBlock+1) * nBlockYSize > GetYSize() )
-                nYCheck = GetYSize() - iYBlock * nBlockYSize;
-            else
-                nYCheck = nBlockYSize;
+        if( poBand != this )
+            return poBand->ComputeStatisticsAndHistogram(
+                FALSE, pdfMin, pdfMax, pdfMean, pdfStdDev,
+                dfHistMin, dfHistMax, nBuckets, panHistogram,
+                bIncludeOutOfRange, pfnProgress, pProgressData );
+    }
 
-            /* this isn't the fastest way to do this, but is easier for now */
-            for( int iY = 0; iY < nYCheck; iY++ )
-            {
-                for( int iX = 0; iX < nXCheck; iX++ )
-                {
-                    int    iOffset = iX + iY * nBlockXSize;
-                    double dfValue = 0.0;
+/* -------------------------------------------------------------------- */
+/*      Read actual data.                                               */
+/* -------------------------------------------------------------------- */
+    int         bGotNoDataValue;
+    double      dfNoDataValue;
 
-                    switch( eDataType )
-                    {
-                      case GDT_Byte:
-                      {
-                        if (bSignedByte)
-                            dfValue = ((signed char *)pData)[iOffset];
-                        else
-                            dfValue = ((GByte *)pData)[iOffset];
-                        break;
-                      }
-                      case GDT_UInt16:
-                        dfValue = ((GUInt16 *)pData)[iOffset];
-                        break;
-                      case GDT_Int16:
-                        dfValue = ((GInt16 *)pData)[iOffset];
-                        break;
-                      case GDT_UInt32:
-                        dfValue = ((GUInt32 *)pData)[iOffset];
-                        break;
-                      case GDT_Int32:
-                        dfValue = ((GInt32 *)pData)[iOffset];
-                        break;
-                      case GDT_Float32:
-                        dfValue = ((float *)pData)[iOffset];
-                        if (CPLIsNan(dfValue))
-                            continue;
-                        break;
-                      case GDT_Float64:
-                        dfValue = ((double *)pData)[iOffset];
-                        if (CPLIsNan(dfValue))
-                            continue;
-                        break;
-                      case GDT_CInt16:
-                        dfValue = ((GInt16 *)pData)[iOffset*2];
-                        break;
-                      case GDT_CInt32:
-                        dfValue = ((GInt32 *)pData)[iOffset*2];
-                        break;
-                      case GDT_CFloat32:
-                        dfValue = ((float *)pData)[iOffset*2];
-                        if( CPLIsNan(dfValue) )
-                            continue;
-                        break;
-                      case GDT_CFloat64:
-                        dfValue = ((double *)pData)[iOffset*2];
-                        if( CPLIsNan(dfValue) )
-                            continue;
-                        break;
-                      default:
-                        CPLAssert( FALSE );
-                    }
+    memset( panHistogram, 0, sizeof(int) * nBuckets );
 
-                    if( bGotNoDataValue && ARE_REAL_EQUAL(dfValue, dfNoDataValue) )
-                        continue;
+    if( !pfnProgress( 0.0, "Compute Statistics", pProgressData ) )
+    {
+        ReportError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
 
-                    if( bFirstValue )
-                    {
-                        dfMin = dfMax = dfValue;
-                        bFirstValue = FALSE;
-                    }
-                    else
-                    {
-                        dfMin = MIN(dfMin,dfValue);
-                        dfMax = MAX(dfMax,dfValue);
-                    }
+    dfNoDataValue = GetNoDataValue( &bGotNoDataValue );
 
-                    dfSum += dfValue;
-                    dfSum2 += dfValue * dfValue;
+    const char* pszPixelType = GetMetadataItem("PIXELTYPE", "IMAGE_STRUCTURE");
+    int bSignedByte = (pszPixelType != NULL && EQUAL(pszPixelType, "SIGNEDBYTE"));
 
-                    nSampleCount++;
-                }
-            }
+    GDALRasterStatsAccumulator oAccum( eDataType, bSignedByte,
+                                       bGotNoDataValue, dfNoDataValue );
+    CPLErr eErr;
 
-            poBlock->DropLock();
+    oAccum.RequestStatistics();
+    oAccum.RequestHistogram( dfHistMin, dfHistMax, nBuckets,
+                             bIncludeOutOfRange );
 
-            if ( !pfnProgress(iSampleBlock
-                              / ((double)(nBlocksPerRow*nBlocksPerColumn)),
-                              "Compute Statistics", pProgressData) )
-            {
-                ReportError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
-                return CE_Failure;
-            }
-        }
-    }
+    eErr = AccumulateStatistics( &oAccum, bApproxOK, TRUE,
+                                 "Compute Statistics",
+                                 pfnProgress, pProgressData );
+    if( eErr != CE_None )
+        return eErr;
 
     if( !pfnProgress( 1.0, "Compute Statistics", pProgressData ) )
     {
@@ -3800,29 +3577,26 @@ GDALRasterBand::ComputeStatistics( int bApproxOK,
     }
 
 /* -------------------------------------------------------------------- */
-/*      Save computed information.                                      */
+/*      Save and record results.                                        */
 /* -------------------------------------------------------------------- */
-    double dfMean = dfSum / nSampleCount;
-    double dfStdDev = sqrt((dfSum2 / nSampleCount) - (dfMean * dfMean));
+    double dfMin, dfMax, dfMean, dfStdDev;
+    int    bValid = oAccum.GetStatistics( &dfMin, &dfMax, &dfMean, &dfStdDev );
 
-    if( nSampleCount > 0 )
+    if( bValid )
         SetStatistics( dfMin, dfMax, dfMean, dfStdDev );
 
-/* -------------------------------------------------------------------- */
-/*      Record results.                                                 */
-/* -------------------------------------------------------------------- */
     if( pdfMin != NULL )
         *pdfMin = dfMin;
     if( pdfMax != NULL )
         *pdfMax = dfMax;
-
     if( pdfMean != NULL )
         *pdfMean = dfMean;
-
     if( pdfStdDev != NULL )
         *pdfStdDev = dfStdDev;
 
-    if( nSampleCount > 0 )
+    oAccum.GetHistogram( panHistogram );
+
+    if( bValid )
         return CE_None;
     else
     {
@@ -3833,27 +3607,35 @@ GDALRasterBand::ComputeStatistics( int bApproxOK,
 }
 
 /************************************************************************/
-/*                    GDALComputeRasterStatistics()                     */
+/*              GDALComputeRasterStatisticsAndHistogram()               */
 /************************************************************************/
 
 /**
-  * \brief Compute image statistics. 
+  * \brief Compute image statistics and histogram in a single pass.
   *
-  * @see GDALRasterBand::ComputeStatistics()
+  * @see GDALRasterBand::ComputeStatisticsAndHistogram()
+  *
+  * @since GDAL 1.10
   */
 
-CPLErr CPL_STDCALL GDALComputeRasterStatistics( 
-        GDALRasterBandH hBand, int bApproxOK, 
+CPLErr CPL_STDCALL GDALComputeRasterStatisticsAndHistogram(
+        GDALRasterBandH hBand, int bApproxOK,
         double *pdfMin, double *pdfMax, double *pdfMean, double *pdfStdDev,
+        double dfHistMin, double dfHistMax, int nBuckets, int *panHistogram,
+        int bIncludeOutOfRange,
         GDALProgressFunc pfnProgress, void *pProgressData )
 
 {
-    VALIDATE_POINTER1( hBand, "GDALComputeRasterStatistics", CE_Failure );
+    VALIDATE_POINTER1( hBand, "GDALComputeRasterStatisticsAndHistogram",
+                       CE_Failure );
+    VALIDATE_POINTER1( panHistogram, "GDALComputeRasterStatisticsAndHistogram",
+                       CE_Failure );
 
     GDALRasterBand *poBand = static_cast<GDALRasterBand*>(hBand);
 
-    return poBand->ComputeStatistics( 
+    return poBand->ComputeStatisticsAndHistogram(
         bApproxOK, pdfMin, pdfMax, pdfMean, pdfStdDev,
+        dfHistMin, dfHistMax, nBuckets, panHistogram, bIncludeOutOfRange,
         pfnProgress, pProgressData );
 }
 
@@ -3993,268 +3775,31 @@ CPLErr GDALRasterBand::ComputeRasterMinMax( int bApproxOK,
 /* -------------------------------------------------------------------- */
 /*      Read actual data and compute minimum and maximum.               */
 /* -------------------------------------------------------------------- */
-    int     bGotNoDataValue, bFirstValue = TRUE;
+    int     bGotNoDataValue;
     double  dfNoDataValue;
 
     dfNoDataValue = GetNoDataValue( &bGotNoDataValue );
-    bGotNoDataValue = bGotNoDataValue && !CPLIsNan(dfNoDataValue);
 
     const char* pszPixelType = GetMetadataItem("PIXELTYPE", "IMAGE_STRUCTURE");
     int bSignedByte = (pszPixelType != NULL && EQUAL(pszPixelType, "SIGNEDBYTE"));
-    
-    if ( bApproxOK && HasArbitraryOverviews() )
-    {
-/* -------------------------------------------------------------------- */
-/*      Figure out how much the image should be reduced to get an       */
-/*      approximate value.                                              */
-/* -------------------------------------------------------------------- */
-        void    *pData;
-        int     nXReduced, nYReduced;
-        double  dfReduction = sqrt(
-            (double)nRasterXSize * nRasterYSize / GDALSTAT_APPROX_NUMSAMPLES );
-
-        if ( dfReduction > 1.0 )
-        {
-            nXReduced = (int)( nRasterXSize / dfReduction );
-            nYReduced = (int)( nRasterYSize / dfReduction );
-
-            // Catch the case of huge resizing ratios here
-            if ( nXReduced == 0 )
-                nXReduced = 1;
-            if ( nYReduced == 0 )
-                nYReduced = 1;
-        }
-        else
-        {
-            nXReduced = nRasterXSize;
-            nYReduced = nRasterYSize;
-        }
-
-        pData =
-            CPLMalloc(GDALGetDataTypeSize(eDataType)/8 * nXReduced * nYReduced);
 
-        CPLErr eErr = IRasterIO( GF_Read, 0, 0, nRasterXSize, nRasterYSize, pData,
-                   nXReduced, nYReduced, eDataType, 0, 0 );
-        if ( eErr != CE_None )
-        {
-            CPLFree(pData);
-            return eErr;
-        }
-        
-        /* this isn't the fastest way to do this, but is easier for now */
-        for( int iY = 0; iY < nYReduced; iY++ )
-        {
-            for( int iX = 0; iX < nXReduced; iX++ )
-            {
-                int    iOffset = iX + iY * nXReduced;
-                double dfValue = 0.0;
-
-                switch( eDataType )
-                {
-                  case GDT_Byte:
-                  {
-                    if (bSignedByte)
-                        dfValue = ((signed char *)pData)[iOffset];
-                    else
-                        dfValue = ((GByte *)pData)[iOffset];
-                    break;
-                  }
-                  case GDT_UInt16:
-                    dfValue = ((GUInt16 *)pData)[iOffset];
-                    break;
-                  case GDT_Int16:
-                    dfValue = ((GInt16 *)pData)[iOffset];
-                    break;
-                  case GDT_UInt32:
-                    dfValue = ((GUInt32 *)pData)[iOffset];
-                    break;
-                  case GDT_Int32:
-                    dfValue = ((GInt32 *)pData)[iOffset];
-                    break;
-                  case GDT_Float32:
-                    dfValue = ((float *)pData)[iOffset];
-                    if (CPLIsNan(dfValue))
-                        continue;
-                    break;
-                  case GDT_Float64:
-                    dfValue = ((double *)pData)[iOffset];
-                    if (CPLIsNan(dfValue))
-                        continue;
-                    break;
-                  case GDT_CInt16:
-                    dfValue = ((GInt16 *)pData)[iOffset*2];
-                    break;
-                  case GDT_CInt32:
-                    dfValue = ((GInt32 *)pData)[iOffset*2];
-                    break;
-                  case GDT_CFloat32:
-                    dfValue = ((float *)pData)[iOffset*2];
-                    if( CPLIsNan(dfValue) )
-                        continue;
-                    break;
-                  case GDT_CFloat64:
-                    dfValue = ((double *)pData)[iOffset*2];
-                    if( CPLIsNan(dfValue) )
-                        continue;
-                    break;
-                  default:
-                    CPLAssert( FALSE );
-                }
-                
-                if( bGotNoDataValue && ARE_REAL_EQUAL(dfValue, dfNoDataValue) )
-                    continue;
-
-                if( bFirstValue )
-                {
-                    dfMin = dfMax = dfValue;
-                    bFirstValue = FALSE;
-                }
-                else
-                {
-                    dfMin = MIN(dfMin,dfValue);
-                    dfMax = MAX(dfMax,dfValue);
-                }
-            }
-        }
-
-        CPLFree( pData );
-    }
+    GDALRasterStatsAccumulator oAccum( eDataType, bSignedByte,
+                                       bGotNoDataValue, dfNoDataValue );
+    CPLErr eErr;
 
-    else    // No arbitrary overviews
-    {
-        int     nSampleRate;
+    oAccum.RequestStatistics();
 
-        if( !InitBlockInfo() )
-            return CE_Failure;
-
-/* -------------------------------------------------------------------- */
-/*      Figure out the ratio of blocks we will read to get an           */
-/*      approximate value.                                              */
-/* -------------------------------------------------------------------- */
-        if ( bApproxOK )
-        {
-            nSampleRate = 
-                (int) MAX(1,sqrt((double) nBlocksPerRow * nBlocksPerColumn));
-        }
-        else
-            nSampleRate = 1;
-        
-        for( int iSampleBlock = 0; 
-             iSampleBlock < nBlocksPerRow * nBlocksPerColumn;
-             iSampleBlock += nSampleRate )
-        {
-            int  iXBlock, iYBlock, nXCheck, nYCheck;
-            GDALRasterBlock *poBlock;
-            void* pData;
-
-            iYBlock = iSampleBlock / nBlocksPerRow;
-            iXBlock = iSampleBlock - nBlocksPerRow * iYBlock;
-            
-            poBlock = GetLockedBlockRef( iXBlock, iYBlock );
-            if( poBlock == NULL )
-                continue;
-            if( poBlock->GetDataRef() == NULL )
-            {
-                poBlock->DropLock();
-                continue;
-            }
-            
-            pData = poBlock->GetDataRef();
-            
-            if( (iXBlock+1) * nBlockXSize > GetXSize() )
-                nXCheck = GetXSize() - iXBlock * nBlockXSize;
-            else
-                nXCheck = nBlockXSize;
-
-            if( (iYBlock+1) * nBlockYSize > GetYSize() )
-                nYCheck = GetYSize() - iYBlock * nBlockYSize;
-            else
-                nYCheck = nBlockYSize;
-                
-            /* this isn't the fastest way to do this, but is easier for now */
-            for( int iY = 0; iY < nYCheck; iY++ )
-            {
-                for( int iX = 0; iX < nXCheck; iX++ )
-                {
-                    int    iOffset = iX + iY * nBlockXSize;
-                    double dfValue = 0.0;
-
-                    switch( eDataType )
-                    {
-                      case GDT_Byte:
-                      {
-                        if (bSignedByte)
-                            dfValue = ((signed char *) pData)[iOffset];
-                        else
-                            dfValue = ((GByte *) pData)[iOffset];
-                        break;
-                      }
-                      case GDT_UInt16:
-                        dfValue = ((GUInt16 *) pData)[iOffset];
-                        break;
-                      case GDT_Int16:
-                        dfValue = ((GInt16 *) pData)[iOffset];
-                        break;
-                      case GDT_UInt32:
-                        dfValue = ((GUInt32 *) pData)[iOffset];
-                        break;
-                      case GDT_Int32:
-                        dfValue = ((GInt32 *) pData)[iOffset];
-                        break;
-                      case GDT_Float32:
-                        dfValue = ((float *) pData)[iOffset];
-                        if( CPLIsNan(dfValue) )
-                            continue;
-                        break;
-                      case GDT_Float64:
-                        dfValue = ((double *) pData)[iOffset];
-                        if( CPLIsNan(dfValue) )
-                            continue;
-                        break;
-                      case GDT_CInt16:
-                        dfValue = ((GInt16 *) pData)[iOffset*2];
-                        break;
-                      case GDT_CInt32:
-                        dfValue = ((GInt32 *) pData)[iOffset*2];
-                        break;
-                      case GDT_CFloat32:
-                        dfValue = ((float *) pData)[iOffset*2];
-                        if( CPLIsNan(dfValue) )
-                            continue;
-                        break;
-                      case GDT_CFloat64:
-                        dfValue = ((double *) pData)[iOffset*2];
-                        if( CPLIsNan(dfValue) )
-                            continue;
-                        break;
-                      default:
-                        CPLAssert( FALSE );
-                    }
-                    
-                    if( bGotNoDataValue && ARE_REAL_EQUAL(dfValue, dfNoDataValue) )
-                        continue;
-
-                    if( bFirstValue )
-                    {
-                        dfMin = dfMax = dfValue;
-                        bFirstValue = FALSE;
-                    }
-                    else
-                    {
-                        dfMin = MIN(dfMin,dfValue);
-                        dfMax = MAX(dfMax,dfValue);
-                    }
-                }
-            }
+    eErr = AccumulateStatistics( &oAccum, bApproxOK, FALSE, NULL,
+                                 GDALDummyProgress, NULL );
+    if( eErr != CE_None )
+        return eErr;
 
-            poBlock->DropLock();
-        }
-    }
+    int bValid = oAccum.GetStatistics( &dfMin, &dfMax, NULL, NULL );
 
     adfMinMax[0] = dfMin;
     adfMinMax[1] = dfMax;
 
-    if (bFirstValue)
+    if( !bValid )
     {
         ReportError( CE_Failure, CPLE_AppDefined,
             "Failed to compute min/max, no valid pixels found in sampling." );
@@ -4900,6 +4445,96 @@ void GDALRasterBand::SetFlushBlockErr( CPLErr eErr )
     eFlushBlockErr = eErr;
 }
 
+/************************************************************************/
+/*                          SetCachePriority()                          */
+/************************************************************************/
+
+/**
+ * \brief Set the block cache priority class of the band.
+ *
+ * This overrides the class of the dataset (see 
+ * GDALDataset::SetCachePriority()) for the blocks of this band only.  For
+ * instance, the overview bands of a dataset served as tiles can be given
+ * the GBP_Pinned class so that they stay in the cache while full resolution
+ * blocks come and go.
+ *
+ * This method is the same as the C function GDALSetRasterCachePriority().
+ *
+ * @param ePriority the priority class.
+ *
+ * @since GDAL 1.10
+ */
+
+void GDALRasterBand::SetCachePriority( GDALBlockPriority ePriority )
+
+{
+    nCachePriority = ePriority;
+}
+
+/************************************************************************/
+/*                     GDALSetRasterCachePriority()                     */
+/************************************************************************/
+
+/**
+ * \brief Set the block cache priority class of the band.
+ *
+ * @see GDALRasterBand::SetCachePriority()
+ */
+
+void CPL_STDCALL GDALSetRasterCachePriority( GDALRasterBandH hBand,
+                                             GDALBlockPriority ePriority )
+
+{
+    VALIDATE_POINTER0( hBand, "GDALSetRasterCachePriority" );
+
+    ((GDALRasterBand *) hBand)->SetCachePriority( ePriority );
+}
+
+/************************************************************************/
+/*                          GetCachePriority()                          */
+/************************************************************************/
+
+/**
+ * \brief Get the block cache priority class of the band.
+ *
+ * This method is the same as the C function GDALGetRasterCachePriority().
+ *
+ * @return the class set with SetCachePriority(), or else the one of the
+ * dataset.
+ *
+ * @since GDAL 1.10
+ */
+
+GDALBlockPriority GDALRasterBand::GetCachePriority()
+
+{
+    if( nCachePriority >= 0 )
+        return (GDALBlockPriority) nCachePriority;
+
+    if( poDS != NULL )
+        return poDS->GetCachePriority();
+
+    return GBP_Normal;
+}
+
+/************************************************************************/
+/*                     GDALGetRasterCachePriority()                     */
+/************************************************************************/
+
+/**
+ * \brief Get the block cache priority class of the band.
+ *
+ * @see GDALRasterBand::GetCachePriority()
+ */
+
+GDALBlockPriority CPL_STDCALL GDALGetRasterCachePriority( GDALRasterBandH hBand )
+
+{
+    VALIDATE_POINTER1( hBand, "GDALGetRasterCachePriority", GBP_Normal );
+
+    return ((GDALRasterBand *) hBand)->GetCachePriority();
+}
+
 /************************************************************************/
 /*                            ReportError()                             */
 /************************************************************************/
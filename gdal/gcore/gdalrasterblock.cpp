@@ -30,6 +30,13 @@
 
 #include "gdal_priv.h"
 #include "cpl_multiproc.h"
+#include "cpl_hash_set.h"
+
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#endif
 
 CPL_CVSID("$Id$");
 
@@ -37,11 +44,323 @@ static int bCacheMaxInitialized = FALSE;
 static GIntBig nCacheMax = 40 * 1024*1024;
 static volatile GIntBig nCacheUsed = 0;
 
-static volatile GDALRasterBlock *poOldest = NULL;    /* tail */
-static volatile GDALRasterBlock *poNewest = NULL;    /* head */
+/* One LRU list per priority class, indexed by GDALBlockPriority, and the
+   probation FIFO of the normal class with the 2Q policy */
+#define GRB_LIST_PROBATION  (GBP_Pinned + 1)
+#define GRB_LIST_COUNT      (GBP_Pinned + 2)
+
+static volatile GDALRasterBlock *apoOldest[GRB_LIST_COUNT];    /* tails */
+static volatile GDALRasterBlock *apoNewest[GRB_LIST_COUNT];    /* heads */
+static volatile GIntBig anListUsed[GRB_LIST_COUNT];
+
+/* Share of the cache that streaming blocks may use before being evicted
+   ahead of the normal ones, in percent of the cache max */
+static int nStreamingReservePct = -1;   /* -1 until configured */
+
+/* Replacement policy of the normal class, see GDALGetCachePolicy() */
+#define GRB_POLICY_LRU      0
+#define GRB_POLICY_2Q       1
+
+static int nCachePolicy = -1;           /* -1 until configured */
+
+/* Shares of the cache max for the probation FIFO ("Kin") and for the 
+   history of the blocks evicted from it ("Kout"), as in the 2Q paper */
+#define GRB_2Q_PROBATION_PCT    25
+#define GRB_2Q_HISTORY_PCT      50
+
+/* History of the blocks evicted from the probation FIFO, protected by
+   hRBMutex.  Entries are only compared, and those of a destroyed band are
+   invalidated by GDALRasterBlock::ForgetBand(). */
+typedef struct _GDALEvictedBlock
+{
+    GDALRasterBand *poBand;
+    int             nXOff;
+    int             nYOff;
+    int             nSize;
+    int             bValid;     /* FALSE once the block was loaded again */
+    struct _GDALEvictedBlock *psNext;
+} GDALEvictedBlock;
+
+static CPLHashSet *hEvictedBlockSet = NULL;
+static GDALEvictedBlock *psEvictedOldest = NULL;
+static GDALEvictedBlock *psEvictedNewest = NULL;
+static GIntBig nEvictedSize = 0;
 
 static void *hRBMutex = NULL;
 
+/* Counters of the cache activity, protected by hRBMutex */
+static volatile GIntBig nCacheDirty = 0;
+static GDALCacheCounters sCacheCounters;
+static GIntBig nCacheLockWaits = 0;
+static double  dfCacheLockWaitTime = 0.0;
+
+/* Write-behind of dirty blocks, see GDALRasterBlock::MarkDirty().  Only
+   the dirty blocks of the datasets with an I/O mutex are counted in
+   nWriteBehindDirty, as the writer cannot write the others. */
+static int nIOTiming = -1;              /* -1 until configured */
+static int nDirtyHighWaterPct = -1;     /* -1 until configured */
+static volatile GIntBig nWriteBehindDirty = 0;
+static volatile int bWriteBehindRunning = FALSE;
+static int bWriteBehindWaiting = FALSE;
+static void *hWriteBehindCond = NULL;
+
+/************************************************************************/
+/* ==================================================================== */
+/*                         GDALCacheMutexHolder                         */
+/*                                                                      */
+/*      Holds hRBMutex like CPLMutexHolderD(), and accounts for the     */
+/*      time spent waiting when it is contended.                        */
+/* ==================================================================== */
+/************************************************************************/
+
+class GDALCacheMutexHolder
+{
+  public:
+    GDALCacheMutexHolder()
+    {
+        if( hRBMutex == NULL )
+            CPLCreateOrAcquireMutex( &hRBMutex, 1000.0 );
+        else if( !CPLAcquireMutex( hRBMutex, 0.0 ) )
+        {
+            double dfStartTime = GDALRasterBlock::GetClock();
+
+            CPLAcquireMutex( hRBMutex, 1000.0 );
+            nCacheLockWaits++;
+            dfCacheLockWaitTime += GDALRasterBlock::GetClock() - dfStartTime;
+        }
+    }
+
+    ~GDALCacheMutexHolder()
+    {
+        CPLReleaseMutex( hRBMutex );
+    }
+};
+
+/************************************************************************/
+/*                       GDALGetDirtyHighWater()                        */
+/************************************************************************/
+
+static GIntBig GDALGetDirtyHighWater()
+
+{
+    if( nDirtyHighWaterPct < 0 )
+    {
+        nDirtyHighWaterPct = 
+            atoi( CPLGetConfigOption( "GDAL_CACHE_DIRTY_HIGH_WATER", "50" ) );
+        if( nDirtyHighWaterPct < 1 || nDirtyHighWaterPct > 100 )
+        {
+            CPLError( CE_Warning, CPLE_AppDefined,
+                      "Invalid value for GDAL_CACHE_DIRTY_HIGH_WATER. "
+                      "Using default value." );
+            nDirtyHighWaterPct = 50;
+        }
+    }
+
+    return GDALGetCacheMax64() / 100 * nDirtyHighWaterPct;
+}
+
+/************************************************************************/
+/*                      GDALWakeUpWriteBehind()                         */
+/*                                                                      */
+/*      Wake the background writer up if it waits for a block to       */
+/*      write.  Must be called with hRBMutex held.                      */
+/************************************************************************/
+
+static void GDALWakeUpWriteBehind()
+
+{
+    if( bWriteBehindWaiting )
+    {
+        bWriteBehindWaiting = FALSE;
+        CPLCondBroadcast( hWriteBehindCond );
+    }
+}
+
+/************************************************************************/
+/*                     GDALGetStreamingReserve()                        */
+/************************************************************************/
+
+static GIntBig GDALGetStreamingReserve()
+
+{
+    if( nStreamingReservePct < 0 )
+    {
+        nStreamingReservePct = 
+            atoi( CPLGetConfigOption( "GDAL_CACHE_STREAMING_RESERVE", "10" ) );
+        if( nStreamingReservePct < 0 || nStreamingReservePct > 100 )
+        {
+            CPLError( CE_Warning, CPLE_IllegalArg,
+                      "GDAL_CACHE_STREAMING_RESERVE must be between 0 and 100."
+                      " Using 10." );
+            nStreamingReservePct = 10;
+        }
+    }
+
+    return GDALGetCacheMax64() / 100 * nStreamingReservePct;
+}
+
+/************************************************************************/
+/*                         GDALGetCachePolicy()                         */
+/************************************************************************/
+
+static int GDALGetCachePolicy()
+
+{
+    if( nCachePolicy < 0 )
+    {
+        const char *pszPolicy = CPLGetConfigOption( "GDAL_CACHE_POLICY", 
+                                                    "LRU" );
+
+        if( EQUAL(pszPolicy,"2Q") )
+            nCachePolicy = GRB_POLICY_2Q;
+        else
+        {
+            if( !EQUAL(pszPolicy,"LRU") )
+                CPLError( CE_Warning, CPLE_IllegalArg,
+                          "Unrecognised GDAL_CACHE_POLICY value: %s. "
+                          "Using LRU.", pszPolicy );
+            nCachePolicy = GRB_POLICY_LRU;
+        }
+    }
+
+    return nCachePolicy;
+}
+
+/************************************************************************/
+/*                      GDALGetProbationMaxSize()                       */
+/************************************************************************/
+
+static GIntBig GDALGetProbationMaxSize()
+
+{
+    /* Blocks left in the probation FIFO after a switch to LRU go first */
+    if( GDALGetCachePolicy() != GRB_POLICY_2Q )
+        return 0;
+
+    return GDALGetCacheMax64() / 100 * GRB_2Q_PROBATION_PCT;
+}
+
+/************************************************************************/
+/*                   Evicted block history functions.                   */
+/*                                                                      */
+/*      Must be called with hRBMutex held.                              */
+/************************************************************************/
+
+static unsigned long GDALEvictedBlockHashFunc( const void *elt )
+
+{
+    const GDALEvictedBlock *psBlock = (const GDALEvictedBlock *) elt;
+
+    return (unsigned long) (size_t) psBlock->poBand
+        ^ ((unsigned long) psBlock->nXOff * 2654435761UL)
+        ^ ((unsigned long) psBlock->nYOff * 40503UL);
+}
+
+static int GDALEvictedBlockEqualFunc( const void *elt1, const void *elt2 )
+
+{
+    const GDALEvictedBlock *psBlock1 = (const GDALEvictedBlock *) elt1;
+    const GDALEvictedBlock *psBlock2 = (const GDALEvictedBlock *) elt2;
+
+    return psBlock1->poBand == psBlock2->poBand
+        && psBlock1->nXOff == psBlock2->nXOff
+        && psBlock1->nYOff == psBlock2->nYOff;
+}
+
+static void GDALClearEvictedBlocks()
+
+{
+    while( psEvictedOldest != NULL )
+    {
+        GDALEvictedBlock *psNext = psEvictedOldest->psNext;
+        CPLFree( psEvictedOldest );
+        psEvictedOldest = psNext;
+    }
+    psEvictedNewest = NULL;
+    nEvictedSize = 0;
+
+    if( hEvictedBlockSet != NULL )
+    {
+        CPLHashSetDestroy( hEvictedBlockSet );
+        hEvictedBlockSet = NULL;
+    }
+}
+
+static void GDALRememberEvictedBlock( GDALRasterBand *poBand, 
+                                      int nXOff, int nYOff, int nSize )
+
+{
+    GDALEvictedBlock sKey;
+
+    sKey.poBand = poBand;
+    sKey.nXOff = nXOff;
+    sKey.nYOff = nYOff;
+
+    if( hEvictedBlockSet == NULL )
+        hEvictedBlockSet = CPLHashSetNew( GDALEvictedBlockHashFunc,
+                                          GDALEvictedBlockEqualFunc, NULL );
+    else if( CPLHashSetLookup( hEvictedBlockSet, &sKey ) != NULL )
+        return;
+
+    GDALEvictedBlock *psBlock = 
+        (GDALEvictedBlock *) CPLMalloc( sizeof(GDALEvictedBlock) );
+
+    *psBlock = sKey;
+    psBlock->nSize = nSize;
+    psBlock->bValid = TRUE;
+    psBlock->psNext = NULL;
+
+    CPLHashSetInsert( hEvictedBlockSet, psBlock );
+    if( psEvictedNewest != NULL )
+        psEvictedNewest->psNext = psBlock;
+    else
+        psEvictedOldest = psBlock;
+    psEvictedNewest = psBlock;
+
+/* -------------------------------------------------------------------- */
+/*      Forget the oldest entries beyond the history size.  Entries     */
+/*      of blocks loaded again are still accounted until they are       */
+/*      dropped, so that the list stays bounded.                        */
+/* -------------------------------------------------------------------- */
+    GIntBig nMaxSize = GDALGetCacheMax64() / 100 * GRB_2Q_HISTORY_PCT;
+
+    nEvictedSize += nSize;
+    while( nEvictedSize > nMaxSize && psEvictedOldest != psEvictedNewest )
+    {
+        GDALEvictedBlock *psOldest = psEvictedOldest;
+
+        psEvictedOldest = psOldest->psNext;
+        nEvictedSize -= psOldest->nSize;
+        if( psOldest->bValid )
+            CPLHashSetRemove( hEvictedBlockSet, psOldest );
+        CPLFree( psOldest );
+    }
+}
+
+static int GDALForgetEvictedBlock( GDALRasterBand *poBand, 
+                                   int nXOff, int nYOff )
+
+{
+    GDALEvictedBlock sKey;
+
+    if( hEvictedBlockSet == NULL )
+        return FALSE;
+
+    sKey.poBand = poBand;
+    sKey.nXOff = nXOff;
+    sKey.nYOff = nYOff;
+
+    GDALEvictedBlock *psBlock = (GDALEvictedBlock *) 
+        CPLHashSetLookup( hEvictedBlockSet, &sKey );
+    if( psBlock == NULL )
+        return FALSE;
+
+    CPLHashSetRemove( hEvictedBlockSet, psBlock );
+    psBlock->bValid = FALSE;
+
+    return TRUE;
+}
+
 
 /************************************************************************/
 /*                          GDALSetCacheMax()                           */
@@ -81,6 +400,9 @@ void CPL_STDCALL GDALSetCacheMax( int nNewSizeInBytes )
  * capabilities. This function will not make any attempt to check the
  * consistency of the passed value with the effective capabilities of the OS.
  *
+ * The GDAL_CACHE_POLICY configuration option is read again by this
+ * function (see GDALRasterBlock).
+ *
  * @param nNewSizeInBytes the maximum number of bytes for caching.
  *
  * @since GDAL 1.8.0
@@ -90,6 +412,7 @@ void CPL_STDCALL GDALSetCacheMax64( GIntBig nNewSizeInBytes )
 
 {
     nCacheMax = nNewSizeInBytes;
+    nCachePolicy = -1;
 
 /* -------------------------------------------------------------------- */
 /*      Flush blocks till we are under the new limit or till we         */
@@ -233,6 +556,84 @@ GIntBig CPL_STDCALL GDALGetCacheUsed64()
     return nCacheUsed;
 }
 
+/************************************************************************/
+/*                       GDALGetCacheStatistics()                       */
+/************************************************************************/
+
+/**
+ * \brief Get counters of the block cache activity.
+ *
+ * Returns a list of NAME=VALUE strings, with the following items:
+ * <ul>
+ * <li>CACHE_MAX: the maximum cache memory, in bytes.</li>
+ * <li>CACHE_USED: the cache memory in use, in bytes.</li>
+ * <li>CACHE_DIRTY: the size of the modified blocks, not yet written, in
+ * bytes.</li>
+ * <li>HITS: the number of block requests served from the cache.</li>
+ * <li>MISSES: the number of block requests that had to be read by the
+ * driver.</li>
+ * <li>BYTES_READ: the size of the blocks read by drivers, in bytes.</li>
+ * <li>READ_TIME: the time spent reading them, in seconds (see below).</li>
+ * <li>DIRTY_FLUSHES: the number of dirty blocks written from the
+ * cache.</li>
+ * <li>BYTES_WRITTEN: the size of the blocks written by drivers, from the
+ * cache or with GDALRasterBand::WriteBlock(), in bytes.</li>
+ * <li>WRITE_TIME: the time spent writing them, in seconds (see below).</li>
+ * <li>EVICTIONS: the number of blocks flushed to recover memory.</li>
+ * <li>SYNC_FLUSHES: the number of those which were dirty, and thus were
+ * written by the thread requesting memory.</li>
+ * <li>SYNC_FLUSH_TIME: the time spent in those writes, in seconds.</li>
+ * <li>WRITE_BEHIND_FLUSHES: the number of dirty blocks written by the
+ * background writer (see GDALRasterBlock::MarkDirty()).</li>
+ * <li>LOCK_WAITS: the number of times a thread had to wait for another
+ * one to release the cache mutex.</li>
+ * <li>LOCK_WAIT_TIME: the time spent waiting, in seconds.</li>
+ * </ul>
+ *
+ * GDALDatasetGetCacheStatistics() returns the same counters, except
+ * CACHE_MAX, CACHE_DIRTY and the LOCK_ ones, for the blocks of one
+ * dataset.
+ *
+ * READ_TIME and WRITE_TIME are only measured if the GDAL_CACHE_TIMING
+ * configuration option is set to YES, as reading the clock around each
+ * block read or write is not free.  They are 0 otherwise.
+ *
+ * If the GDAL_CACHE_STATISTICS configuration option is set to YES, the
+ * counters of each dataset are written to the standard error output when it
+ * is closed, and the global ones when GDALDestroyDriverManager() is called.
+ * The option can also be set to the name of a file to append them to.
+ *
+ * @return a list to be freed with CSLDestroy().
+ *
+ * @since GDAL 1.10
+ */
+
+char ** CPL_STDCALL GDALGetCacheStatistics()
+
+{
+    return GDALRasterBlock::GetCacheStatistics( NULL );
+}
+
+/************************************************************************/
+/*                      GDALResetCacheStatistics()                      */
+/************************************************************************/
+
+/**
+ * \brief Reset the global counters of the block cache activity.
+ *
+ * The counters returned by GDALGetCacheStatistics() are set back to zero,
+ * except CACHE_MAX, CACHE_USED and CACHE_DIRTY.  Those of the datasets are
+ * not affected.
+ *
+ * @since GDAL 1.10
+ */
+
+void CPL_STDCALL GDALResetCacheStatistics()
+
+{
+    GDALRasterBlock::ResetCacheStatistics();
+}
+
 /************************************************************************/
 /*                        GDALFlushCacheBlock()                         */
 /*                                                                      */
@@ -270,6 +671,17 @@ int CPL_STDCALL GDALFlushCacheBlock()
  * a least recently used (LRU) list and an upper cache limit (see
  * GDALSetCacheMax()) under which the cache size is normally kept. 
  *
+ * With the GDAL_CACHE_POLICY configuration option set to 2Q instead of
+ * LRU, the default, blocks of the normal priority class (see 
+ * GDALRasterBand::SetCachePriority()) are first loaded in a probation
+ * FIFO list, using up to a quarter of the cache, where being used again
+ * does not change their position.  Only blocks loaded again shortly after
+ * being evicted from that list, i.e. which are still in a history of
+ * evicted blocks worth half of the cache, go to the LRU list.  A full
+ * scan of a large raster then only replaces the blocks of the probation
+ * list, instead of the whole working set.  This is the "2Q" algorithm of
+ * Johnson and Shasha (VLDB 1994).
+ *
  * Some blocks in the cache may be modified relative to the state on disk
  * (they are marked "Dirty") and must be flushed to disk before they can
  * be discarded.  Other (Clean) blocks may just be discarded if their memory
@@ -301,34 +713,112 @@ int CPL_STDCALL GDALFlushCacheBlock()
  * for a new cache block would put cache memory use over the established
  * limit.   
  *
+ * Threads that must not write into datasets in use by other threads, such
+ * as the reader of GDALDatasetCopyWholeRaster(), set the
+ * CTLS_FLUSHCLEANBLOCKSONLY thread local flag, in which case only blocks
+ * that are not dirty are candidates.  Dirty blocks of datasets with an
+ * I/O mutex (see GDALDataset::EnterIO()) are only candidates if the mutex
+ * can be acquired without waiting.
+ *
+ * The oldest candidate of the streaming priority class is flushed first if
+ * the blocks of that class use more than the GDAL_CACHE_STREAMING_RESERVE
+ * percentage of the cache max (10 by default), then the oldest one of the
+ * normal class, then the oldest one of the streaming class, and blocks of
+ * the pinned class only if there is no other candidate (see
+ * GDALRasterBand::SetCachePriority()).  With the 2Q policy, the normal
+ * class is made of the probation list, whose blocks are evicted first
+ * while it is above its size, and of the LRU list.
+ *
  * C++ analog to the C function GDALFlushCacheBlock().
  * 
+ * @param poOnlyDS if not NULL, only blocks of this dataset are candidates,
+ * and only the lists of its own blocks are walked.
+ *
  * @return TRUE if successful or FALSE if no flushable block is found.
  */
 
-int GDALRasterBlock::FlushCacheBlock()
+int GDALRasterBlock::FlushCacheBlock( GDALDataset *poOnlyDS )
 
 {
-    int nXOff, nYOff;
+    int nXOff, nYOff, bDirty, bProbation, nSizeInBytes;
     GDALRasterBand *poBand;
+    void *hDSMutex = NULL;
+    int bCleanOnly = CPLGetTLS( CTLS_FLUSHCLEANBLOCKSONLY ) != NULL;
+    GIntBig nStreamingReserve = GDALGetStreamingReserve();
 
     {
-        CPLMutexHolderD( &hRBMutex );
-        GDALRasterBlock *poTarget = (GDALRasterBlock *) poOldest;
+        GDALCacheMutexHolder oHolder;
+        GDALRasterBlock *poTarget = NULL;
+        int anLists[GRB_LIST_COUNT];
+        int nLists = 0;
+        int bStreamingFirst = anListUsed[GBP_Streaming] > nStreamingReserve;
+
+        if( bStreamingFirst )
+            anLists[nLists++] = GBP_Streaming;
+        if( anListUsed[GRB_LIST_PROBATION] > GDALGetProbationMaxSize() )
+        {
+            anLists[nLists++] = GRB_LIST_PROBATION;
+            anLists[nLists++] = GBP_Normal;
+        }
+        else
+        {
+            anLists[nLists++] = GBP_Normal;
+            anLists[nLists++] = GRB_LIST_PROBATION;
+        }
+        if( !bStreamingFirst )
+            anLists[nLists++] = GBP_Streaming;
+        anLists[nLists++] = GBP_Pinned;
+
+        for( int iList = 0; iList < nLists && poTarget == NULL; iList++ )
+        {
+            if( poOnlyDS != NULL )
+                poTarget = poOnlyDS->apoCacheOldest[anLists[iList]];
+            else
+                poTarget = (GDALRasterBlock *) apoOldest[anLists[iList]];
 
-        while( poTarget != NULL && poTarget->GetLockCount() > 0 ) 
-            poTarget = poTarget->poPrevious;
+            while( poTarget != NULL )
+            {
+                if( poTarget->GetLockCount() == 0 )
+                {
+                    if( !poTarget->GetDirty() )
+                        break;
+
+                    if( !bCleanOnly )
+                    {
+                        hDSMutex = poTarget->GetDatasetIOMutex();
+                        if( hDSMutex == NULL 
+                            || CPLAcquireMutex( hDSMutex, 0.0 ) )
+                            break;
+                        hDSMutex = NULL;
+                    }
+                }
+                if( poOnlyDS != NULL )
+                    poTarget = poTarget->poDSPrevious;
+                else
+                    poTarget = poTarget->poPrevious;
+            }
+        }
         
         if( poTarget == NULL )
             return FALSE;
 
-        poTarget->Detach();
-
         nXOff = poTarget->GetXOff();
         nYOff = poTarget->GetYOff();
         poBand = poTarget->GetBand();
+        bDirty = poTarget->GetDirty();
+        bProbation = poTarget->nList == GRB_LIST_PROBATION;
+        nSizeInBytes = poTarget->GetSizeInBytes();
+
+        poTarget->Detach();
+
+        GDALCacheCounters *psDSCounters = GetDatasetCounters( poBand );
+        sCacheCounters.nEvictions++;
+        if( psDSCounters != NULL )
+            psDSCounters->nEvictions++;
     }
 
+    double dfStartTime = bDirty ? GetClock() : 0.0;
+
     CPLErr eErr = poBand->FlushBlock( nXOff, nYOff );
     if (eErr != CE_None)
     {
@@ -336,9 +826,478 @@ int GDALRasterBlock::FlushCacheBlock()
         poBand->SetFlushBlockErr(eErr);
     }
 
+    /* Only now, as FlushBlock() touches the block before deleting it */
+    if( bProbation )
+    {
+        GDALCacheMutexHolder oHolder;
+        GDALRememberEvictedBlock( poBand, nXOff, nYOff, nSizeInBytes );
+    }
+
+    if( bDirty )
+    {
+        double dfTime = GetClock() - dfStartTime;
+
+        GDALCacheMutexHolder oHolder;
+        GDALCacheCounters *psDSCounters = GetDatasetCounters( poBand );
+
+        sCacheCounters.nSyncFlushes++;
+        sCacheCounters.dfSyncFlushTime += dfTime;
+        if( psDSCounters != NULL )
+        {
+            psDSCounters->nSyncFlushes++;
+            psDSCounters->dfSyncFlushTime += dfTime;
+        }
+    }
+
+    if( hDSMutex != NULL )
+        CPLReleaseMutex( hDSMutex );
+
     return TRUE;
 }
 
+/************************************************************************/
+/*                        IsWriteBehindEnabled()                        */
+/************************************************************************/
+
+/**
+ * \brief Return whether dirty blocks are written in the background.
+ *
+ * Write-behind is enabled by setting the GDAL_CACHE_WRITE_BEHIND
+ * configuration option to YES, which is checked when a driver supporting
+ * it opens or creates a dataset in update mode (see 
+ * GDALDataset::EnableWriteBehind()).  The threshold above which it starts
+ * is set with the GDAL_CACHE_DIRTY_HIGH_WATER configuration option, in
+ * percent of the cache maximum (50 by default), read once.
+ *
+ * @return TRUE if the background writer is enabled.
+ *
+ * @since GDAL 1.10
+ */
+
+int GDALRasterBlock::IsWriteBehindEnabled()
+
+{
+    return CSLTestBoolean( 
+        CPLGetConfigOption( "GDAL_CACHE_WRITE_BEHIND", "NO" ) );
+}
+
+/************************************************************************/
+/*                       NotifyIOMutexReleased()                        */
+/************************************************************************/
+
+/**
+ * Tell the background writer that the I/O mutex of a dataset was
+ * released, so that the dirty blocks it could not write may now be.
+ */
+
+void GDALRasterBlock::NotifyIOMutexReleased()
+
+{
+    if( !bWriteBehindRunning )
+        return;
+
+    GDALCacheMutexHolder oHolder;
+    GDALWakeUpWriteBehind();
+}
+
+/************************************************************************/
+/*                         GetDatasetIOMutex()                          */
+/************************************************************************/
+
+/* Must be called with hRBMutex held, so that the dataset cannot go away. */
+
+void *GDALRasterBlock::GetDatasetIOMutex()
+
+{
+    GDALDataset *poDS = poBand != NULL ? poBand->GetDataset() : NULL;
+
+    if( poDS == NULL )
+        return NULL;
+    if( poDS->poIOMutexOwner != NULL )
+        poDS = poDS->poIOMutexOwner;
+
+    return poDS->hIOMutex;
+}
+
+/************************************************************************/
+/*                         WriteBehindThread()                          */
+/************************************************************************/
+
+/**
+ * Write dirty blocks until their size goes back under half of the high
+ * water mark.
+ *
+ * The oldest dirty block not locked, whose dataset I/O mutex can be
+ * acquired without waiting, is written at each step, and stays in the
+ * cache, clean.  When no such block is found, the thread waits until a
+ * dataset I/O mutex is released or the dirty blocks change.  It stops
+ * once under the low water mark, and will be started again by
+ * MarkDirty().  Errors are saved on the band to be reported later, as when
+ * flushing blocks to recover memory.
+ */
+
+void GDALRasterBlock::WriteBehindThread( void * )
+
+{
+    static int bFlag = TRUE;
+
+    /* Blocks of datasets not locked by this thread must not be written */
+    CPLSetTLS( CTLS_FLUSHCLEANBLOCKSONLY, (void *) &bFlag, FALSE );
+
+    while( TRUE )
+    {
+        GDALRasterBlock *poTarget = NULL;
+        void *hDSMutex = NULL;
+
+        {
+            GDALCacheMutexHolder oHolder;
+
+            if( nWriteBehindDirty <= GDALGetDirtyHighWater() / 2 )
+            {
+                bWriteBehindRunning = FALSE;
+                break;
+            }
+
+            for( int iList = 0; iList < GRB_LIST_COUNT && poTarget == NULL;
+                 iList++ )
+            {
+                for( poTarget = (GDALRasterBlock *) apoOldest[iList]; 
+                     poTarget != NULL; 
+                     poTarget = poTarget->poPrevious )
+                {
+                    if( poTarget->GetDirty() && poTarget->GetLockCount() == 0 )
+                    {
+                        hDSMutex = poTarget->GetDatasetIOMutex();
+                        if( hDSMutex != NULL 
+                            && CPLAcquireMutex( hDSMutex, 0.0 ) )
+                            break;
+                        hDSMutex = NULL;
+                    }
+                }
+            }
+
+            if( poTarget == NULL )
+            {
+                /* hRBMutex is held once, by oHolder */
+                bWriteBehindWaiting = TRUE;
+                CPLCondWait( hWriteBehindCond, hRBMutex );
+                continue;
+            }
+
+            poTarget->AddLock();
+        }
+
+        CPLErr eErr = poTarget->Write();
+        if( eErr != CE_None )
+            poTarget->GetBand()->SetFlushBlockErr( eErr );
+
+        {
+            GDALCacheMutexHolder oHolder;
+            GDALCacheCounters *psDSCounters = 
+                GetDatasetCounters( poTarget->GetBand() );
+
+            poTarget->DropLock();
+            sCacheCounters.nWriteBehindFlushes++;
+            if( psDSCounters != NULL )
+                psDSCounters->nWriteBehindFlushes++;
+        }
+
+        CPLReleaseMutex( hDSMutex );
+    }
+
+    CPLSetTLS( CTLS_FLUSHCLEANBLOCKSONLY, NULL, FALSE );
+}
+
+/************************************************************************/
+/*                              GetClock()                              */
+/************************************************************************/
+
+/**
+ * Wall clock time in seconds, used to measure the time spent in drivers
+ * and waiting for the cache.
+ */
+
+double GDALRasterBlock::GetClock()
+
+{
+#ifdef WIN32
+    return GetTickCount() / 1000.0;
+#else
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+/************************************************************************/
+/*                             GetIOClock()                             */
+/************************************************************************/
+
+/**
+ * Same as GetClock(), to measure the time spent in drivers, if the
+ * GDAL_CACHE_TIMING configuration option is set to YES (read once).
+ * Returns 0 otherwise.
+ */
+
+double GDALRasterBlock::GetIOClock()
+
+{
+    if( nIOTiming < 0 )
+        nIOTiming = CSLTestBoolean( 
+            CPLGetConfigOption( "GDAL_CACHE_TIMING", "NO" ) );
+
+    return nIOTiming ? GetClock() : 0.0;
+}
+
+/************************************************************************/
+/*                         GetDatasetCounters()                         */
+/************************************************************************/
+
+/* Must be called with hRBMutex held. */
+
+GDALCacheCounters *GDALRasterBlock::GetDatasetCounters( GDALRasterBand *poBand )
+
+{
+    GDALDataset *poDS = poBand != NULL ? poBand->GetDataset() : NULL;
+
+    if( poDS == NULL )
+        return NULL;
+
+    return &(poDS->sCacheCounters);
+}
+
+/************************************************************************/
+/*                          RecordDriverRead()                          */
+/************************************************************************/
+
+/**
+ * Account for a block read by a driver.
+ *
+ * @param poBand the band of the block.
+ * @param bCacheMiss TRUE if the block was requested from the cache.
+ * @param nBytes the size of the block.
+ * @param dfTime the time spent in IReadBlock(), in seconds.
+ */
+
+void GDALRasterBlock::RecordDriverRead( GDALRasterBand *poBand, 
+                                        int bCacheMiss,
+                                        int nBytes, double dfTime )
+
+{
+    GDALCacheMutexHolder oHolder;
+    GDALCacheCounters *apsCounters[2];
+
+    apsCounters[0] = &sCacheCounters;
+    apsCounters[1] = GetDatasetCounters( poBand );
+
+    for( int i = 0; i < 2 && apsCounters[i] != NULL; i++ )
+    {
+        if( bCacheMiss )
+            apsCounters[i]->nMisses++;
+        apsCounters[i]->nBytesRead += nBytes;
+        apsCounters[i]->dfReadTime += dfTime;
+    }
+}
+
+/************************************************************************/
+/*                         RecordDriverWrite()                          */
+/************************************************************************/
+
+/**
+ * Account for a block written by a driver.
+ *
+ * @param poBand the band of the block.
+ * @param bDirtyFlush TRUE if the block was a dirty block of the cache.
+ * @param nBytes the size of the block.
+ * @param dfTime the time spent in IWriteBlock(), in seconds.
+ */
+
+void GDALRasterBlock::RecordDriverWrite( GDALRasterBand *poBand, 
+                                         int bDirtyFlush,
+                                         int nBytes, double dfTime )
+
+{
+    GDALCacheMutexHolder oHolder;
+    GDALCacheCounters *apsCounters[2];
+
+    apsCounters[0] = &sCacheCounters;
+    apsCounters[1] = GetDatasetCounters( poBand );
+
+    for( int i = 0; i < 2 && apsCounters[i] != NULL; i++ )
+    {
+        if( bDirtyFlush )
+            apsCounters[i]->nDirtyFlushes++;
+        apsCounters[i]->nBytesWritten += nBytes;
+        apsCounters[i]->dfWriteTime += dfTime;
+    }
+}
+
+/************************************************************************/
+/*                         GetCacheStatistics()                         */
+/************************************************************************/
+
+/**
+ * \brief Get counters of the block cache activity.
+ *
+ * @param poDS the dataset whose counters are requested, or NULL for the
+ * global ones.
+ *
+ * @return a list of NAME=VALUE strings, to be freed with CSLDestroy().  See
+ * GDALGetCacheStatistics() for the items.
+ */
+
+char **GDALRasterBlock::GetCacheStatistics( GDALDataset *poDS )
+
+{
+    char **papszStats = NULL;
+    GIntBig nMax = GDALGetCacheMax64();
+    GDALCacheCounters sCounters;
+
+    GDALCacheMutexHolder oHolder;
+
+    if( poDS == NULL )
+    {
+        sCounters = sCacheCounters;
+
+        papszStats = CSLSetNameValue( papszStats, "CACHE_MAX",
+                                      CPLSPrintf( CPL_FRMT_GIB, nMax ) );
+        papszStats = CSLSetNameValue( papszStats, "CACHE_USED",
+                                      CPLSPrintf( CPL_FRMT_GIB, nCacheUsed ) );
+        papszStats = CSLSetNameValue( papszStats, "CACHE_DIRTY",
+                                      CPLSPrintf( CPL_FRMT_GIB, nCacheDirty ) );
+    }
+    else
+    {
+        sCounters = poDS->sCacheCounters;
+
+        papszStats = CSLSetNameValue( papszStats, "CACHE_USED",
+                                      CPLSPrintf( CPL_FRMT_GIB, 
+                                                  poDS->nCacheUsed ) );
+    }
+
+    papszStats = CSLSetNameValue( papszStats, "HITS",
+                                  CPLSPrintf( CPL_FRMT_GIB, sCounters.nHits ) );
+    papszStats = CSLSetNameValue( papszStats, "MISSES",
+                                  CPLSPrintf( CPL_FRMT_GIB, 
+                                              sCounters.nMisses ) );
+    papszStats = CSLSetNameValue( papszStats, "BYTES_READ",
+                                  CPLSPrintf( CPL_FRMT_GIB, 
+                                              sCounters.nBytesRead ) );
+    papszStats = CSLSetNameValue( papszStats, "READ_TIME",
+                                  CPLSPrintf( "%.6f", sCounters.dfReadTime ) );
+    papszStats = CSLSetNameValue( papszStats, "DIRTY_FLUSHES",
+                                  CPLSPrintf( CPL_FRMT_GIB, 
+                                              sCounters.nDirtyFlushes ) );
+    papszStats = CSLSetNameValue( papszStats, "BYTES_WRITTEN",
+                                  CPLSPrintf( CPL_FRMT_GIB, 
+                                              sCounters.nBytesWritten ) );
+    papszStats = CSLSetNameValue( papszStats, "WRITE_TIME",
+                                  CPLSPrintf( "%.6f", sCounters.dfWriteTime ) );
+    papszStats = CSLSetNameValue( papszStats, "EVICTIONS",
+                                  CPLSPrintf( CPL_FRMT_GIB, 
+                                              sCounters.nEvictions ) );
+    papszStats = CSLSetNameValue( papszStats, "SYNC_FLUSHES",
+                                  CPLSPrintf( CPL_FRMT_GIB,
+                                              sCounters.nSyncFlushes ) );
+    papszStats = CSLSetNameValue( papszStats, "SYNC_FLUSH_TIME",
+                                  CPLSPrintf( "%.6f", 
+                                              sCounters.dfSyncFlushTime ) );
+    papszStats = CSLSetNameValue( papszStats, "WRITE_BEHIND_FLUSHES",
+                                  CPLSPrintf( CPL_FRMT_GIB,
+                                              sCounters.nWriteBehindFlushes ) );
+
+    if( poDS == NULL )
+    {
+        papszStats = CSLSetNameValue( papszStats, "LOCK_WAITS",
+                                      CPLSPrintf( CPL_FRMT_GIB, 
+                                                  nCacheLockWaits ) );
+        papszStats = CSLSetNameValue( papszStats, "LOCK_WAIT_TIME",
+                                      CPLSPrintf( "%.6f", 
+                                                  dfCacheLockWaitTime ) );
+    }
+
+    return papszStats;
+}
+
+/************************************************************************/
+/*                        ResetCacheStatistics()                        */
+/************************************************************************/
+
+/**
+ * \brief Reset the global counters of the block cache activity.
+ */
+
+void GDALRasterBlock::ResetCacheStatistics()
+
+{
+    GDALCacheMutexHolder oHolder;
+
+    memset( &sCacheCounters, 0, sizeof(sCacheCounters) );
+    nCacheLockWaits = 0;
+    dfCacheLockWaitTime = 0.0;
+}
+
+/************************************************************************/
+/*                        DumpCacheStatistics()                         */
+/************************************************************************/
+
+/**
+ * \brief Write the counters of the block cache activity if requested.
+ *
+ * Does nothing unless the GDAL_CACHE_STATISTICS configuration option is
+ * set, to YES for the standard error output, or to a file name to append
+ * to.  Nothing is written for datasets that did not use the cache.
+ *
+ * @param poDS the dataset whose counters are written, or NULL for the
+ * global ones.
+ */
+
+void GDALRasterBlock::DumpCacheStatistics( GDALDataset *poDS )
+
+{
+    const char *pszOutput = CPLGetConfigOption( "GDAL_CACHE_STATISTICS", 
+                                                NULL );
+
+    if( pszOutput == NULL || !CSLTestBoolean( pszOutput ) )
+        return;
+
+    if( poDS != NULL )
+    {
+        const GDALCacheCounters *psCounters = &(poDS->sCacheCounters);
+
+        if( psCounters->nHits == 0 && psCounters->nMisses == 0 
+            && psCounters->nBytesRead == 0 && psCounters->nBytesWritten == 0 )
+            return;
+    }
+
+    FILE *fp = stderr;
+    if( !EQUAL(pszOutput,"YES") && !EQUAL(pszOutput,"ON") 
+        && !EQUAL(pszOutput,"TRUE") && !EQUAL(pszOutput,"1") )
+    {
+        fp = VSIFOpen( pszOutput, "a" );
+        if( fp == NULL )
+        {
+            CPLError( CE_Failure, CPLE_OpenFailed,
+                      "Cannot open %s for GDAL_CACHE_STATISTICS.", pszOutput );
+            return;
+        }
+    }
+
+    char **papszStats = GetCacheStatistics( poDS );
+
+    fprintf( fp, "Block cache statistics of %s:", 
+             poDS != NULL ? poDS->GetDescription() : "the process" );
+    for( int i = 0; papszStats != NULL && papszStats[i] != NULL; i++ )
+        fprintf( fp, " %s", papszStats[i] );
+    fprintf( fp, "\n" );
+
+    CSLDestroy( papszStats );
+
+    if( fp != stderr )
+        VSIFClose( fp );
+}
+
 /************************************************************************/
 /*                          GDALRasterBlock()                           */
 /************************************************************************/
@@ -373,6 +1332,8 @@ GDALRasterBlock::GDALRasterBlock( GDALRasterBand *poBandIn,
     nLockCount = 0;
 
     poNext = poPrevious = NULL;
+    poDSNext = poDSPrevious = NULL;
+    nList = -1;
 
     nXOff = nXOffIn;
     nYOff = nYOffIn;
@@ -393,17 +1354,37 @@ GDALRasterBlock::~GDALRasterBlock()
 {
     Detach();
 
-    if( pData != NULL )
+    if( pData != NULL || bDirty )
     {
-        int nSizeInBytes;
+        int nSizeInBytes = GetSizeInBytes();
+        int bHadData = pData != NULL;
 
         VSIFree( pData );
-
-        nSizeInBytes = (nXSize * nYSize * GDALGetDataTypeSize(eType)+7)/8;
+        pData = NULL;
 
         {
-            CPLMutexHolderD( &hRBMutex );
-            nCacheUsed -= nSizeInBytes;
+            GDALCacheMutexHolder oHolder;
+            if( bHadData )
+            {
+                GDALDataset *poDS = poBand->GetDataset();
+
+                nCacheUsed -= nSizeInBytes;
+                if( poDS != NULL )
+                    poDS->nCacheUsed -= nSizeInBytes;
+
+                /* Drop the history, and its band pointers, once idle */
+                if( nCacheUsed == 0 )
+                    GDALClearEvictedBlocks();
+            }
+            if( bDirty )
+            {
+                nCacheDirty -= nSizeInBytes;
+                if( GetDatasetIOMutex() != NULL )
+                {
+                    nWriteBehindDirty -= nSizeInBytes;
+                    GDALWakeUpWriteBehind();
+                }
+            }
         }
     }
 
@@ -430,14 +1411,17 @@ GDALRasterBlock::~GDALRasterBlock()
 void GDALRasterBlock::Detach()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    GDALCacheMutexHolder oHolder;
 
-    if( poOldest == this )
-        poOldest = poPrevious;
+    if( nList < 0 )
+        return;
+
+    if( apoOldest[nList] == this )
+        apoOldest[nList] = poPrevious;
 
-    if( poNewest == this )
+    if( apoNewest[nList] == this )
     {
-        poNewest = poNext;
+        apoNewest[nList] = poNext;
     }
 
     if( poPrevious != NULL )
@@ -448,6 +1432,67 @@ void GDALRasterBlock::Detach()
 
     poPrevious = NULL;
     poNext = NULL;
+
+/* -------------------------------------------------------------------- */
+/*      Remove it from the list of the blocks of its dataset too.       */
+/* -------------------------------------------------------------------- */
+    GDALDataset *poDS = poBand->GetDataset();
+
+    if( poDS != NULL )
+    {
+        if( poDS->apoCacheOldest[nList] == this )
+            poDS->apoCacheOldest[nList] = poDSPrevious;
+
+        if( poDS->apoCacheNewest[nList] == this )
+            poDS->apoCacheNewest[nList] = poDSNext;
+
+        if( poDSPrevious != NULL )
+            poDSPrevious->poDSNext = poDSNext;
+
+        if( poDSNext != NULL )
+            poDSNext->poDSPrevious = poDSPrevious;
+    }
+
+    poDSPrevious = NULL;
+    poDSNext = NULL;
+
+    anListUsed[nList] -= GetSizeInBytes();
+    nList = -1;
+}
+
+/************************************************************************/
+/*                             ForgetBand()                             */
+/************************************************************************/
+
+/**
+ * Forget the evicted block history of a band.
+ *
+ * Called when the band is destroyed, so that a band later allocated at
+ * the same address does not inherit its history.  The entries stay in
+ * the list until they are dropped, so that the history size accounting
+ * is unchanged.
+ *
+ * @param poBand the band being destroyed.
+ */
+
+void GDALRasterBlock::ForgetBand( GDALRasterBand *poBand )
+
+{
+    if( hEvictedBlockSet == NULL )
+        return;
+
+    GDALCacheMutexHolder oHolder;
+
+    for( GDALEvictedBlock *psBlock = psEvictedOldest; 
+         psBlock != NULL; 
+         psBlock = psBlock->psNext )
+    {
+        if( psBlock->poBand == poBand && psBlock->bValid )
+        {
+            CPLHashSetRemove( hEvictedBlockSet, psBlock );
+            psBlock->bValid = FALSE;
+        }
+    }
 }
 
 /************************************************************************/
@@ -462,13 +1507,21 @@ void GDALRasterBlock::Detach()
 void GDALRasterBlock::Verify()
 
 {
-    CPLMutexHolderD( &hRBMutex );
-
-    CPLAssert( (poNewest == NULL && poOldest == NULL)
-               || (poNewest != NULL && poOldest != NULL) );
+    GDALCacheMutexHolder oHolder;
 
-    if( poNewest != NULL )
+    for( int iList = 0; iList < GRB_LIST_COUNT; iList++ )
     {
+        volatile GDALRasterBlock *poNewest = apoNewest[iList];
+#ifdef DEBUG
+        volatile GDALRasterBlock *poOldest = apoOldest[iList];
+#endif
+
+        CPLAssert( (poNewest == NULL && poOldest == NULL)
+                   || (poNewest != NULL && poOldest != NULL) );
+
+        if( poNewest == NULL )
+            continue;
+
         CPLAssert( poNewest->poPrevious == NULL );
         CPLAssert( poOldest->poNext == NULL );
         
@@ -476,6 +1529,8 @@ void GDALRasterBlock::Verify()
              poBlock != NULL;
              poBlock = poBlock->poNext )
         {
+            CPLAssert( poBlock->nList == iList );
+
             if( poBlock->poPrevious )
             {
                 CPLAssert( poBlock->poPrevious->poNext == poBlock );
@@ -485,6 +1540,11 @@ void GDALRasterBlock::Verify()
             {
                 CPLAssert( poBlock->poNext->poPrevious == poBlock );
             }
+
+            if( poBlock->poDSPrevious )
+            {
+                CPLAssert( poBlock->poDSPrevious->poDSNext == poBlock );
+            }
         }
     }
 }
@@ -514,10 +1574,16 @@ CPLErr GDALRasterBlock::Write()
 
     MarkClean();
 
-    if (poBand->eFlushBlockErr == CE_None)
-        return poBand->IWriteBlock( nXOff, nYOff, pData );
-    else
+    if (poBand->eFlushBlockErr != CE_None)
         return poBand->eFlushBlockErr;
+
+    double dfStartTime = GetIOClock();
+    CPLErr eErr = poBand->IWriteBlock( nXOff, nYOff, pData );
+
+    RecordDriverWrite( poBand, TRUE, GetSizeInBytes(),
+                       GetIOClock() - dfStartTime );
+
+    return eErr;
 }
 
 /************************************************************************/
@@ -528,40 +1594,64 @@ CPLErr GDALRasterBlock::Write()
  * Push block to top of LRU (least-recently used) list.
  *
  * This method is normally called when a block is used to keep track 
- * that it has been recently used. 
+ * that it has been recently used.  The block is moved to the list of the
+ * priority class of its band (see GDALRasterBand::GetCachePriority()) if
+ * it is in another one.  With the 2Q policy, blocks of the probation list
+ * are left in place, and new blocks of the normal class are put in it 
+ * unless they were recently evicted from it.
  */
 
 void GDALRasterBlock::Touch()
 
 {
-    CPLMutexHolderD( &hRBMutex );
+    GDALCacheMutexHolder oHolder;
+    int nNewList = poBand->GetCachePriority();
 
-    if( poNewest == this )
-        return;
+    if( nNewList == GBP_Normal && GDALGetCachePolicy() == GRB_POLICY_2Q )
+    {
+        if( nList == GRB_LIST_PROBATION )
+            return;
 
-    if( poOldest == this )
-        poOldest = this->poPrevious;
-    
-    if( poPrevious != NULL )
-        poPrevious->poNext = poNext;
+        if( nList != GBP_Normal 
+            && !GDALForgetEvictedBlock( poBand, nXOff, nYOff ) )
+            nNewList = GRB_LIST_PROBATION;
+    }
 
-    if( poNext != NULL )
-        poNext->poPrevious = poPrevious;
+    if( nList == nNewList && apoNewest[nList] == this )
+        return;
+
+    Detach();
 
     poPrevious = NULL;
-    poNext = (GDALRasterBlock *) poNewest;
+    poNext = (GDALRasterBlock *) apoNewest[nNewList];
 
-    if( poNewest != NULL )
+    if( apoNewest[nNewList] != NULL )
     {
-        CPLAssert( poNewest->poPrevious == NULL );
-        poNewest->poPrevious = this;
+        CPLAssert( apoNewest[nNewList]->poPrevious == NULL );
+        apoNewest[nNewList]->poPrevious = this;
     }
-    poNewest = this;
+    apoNewest[nNewList] = this;
     
-    if( poOldest == NULL )
+    if( apoOldest[nNewList] == NULL )
     {
         CPLAssert( poPrevious == NULL && poNext == NULL );
-        poOldest = this;
+        apoOldest[nNewList] = this;
+    }
+
+    nList = nNewList;
+    anListUsed[nList] += GetSizeInBytes();
+
+    GDALDataset *poDS = poBand->GetDataset();
+
+    if( poDS != NULL )
+    {
+        poDSNext = poDS->apoCacheNewest[nList];
+        if( poDSNext != NULL )
+            poDSNext->poDSPrevious = this;
+        poDS->apoCacheNewest[nList] = this;
+
+        if( poDS->apoCacheOldest[nList] == NULL )
+            poDS->apoCacheOldest[nList] = this;
     }
 #ifdef ENABLE_DEBUG
     Verify();
@@ -576,7 +1666,9 @@ void GDALRasterBlock::Touch()
  * Allocate memory for block.
  *
  * This method allocates memory for the block, and attempts to flush other
- * blocks, if necessary, to bring the total cache size back within the limits.
+ * blocks, if necessary, to bring the total cache size back within the limits,
+ * and the cache memory used by the dataset of the block within its quota 
+ * (see GDALDataset::SetCacheQuota()).
  * The newly allocated block is touched and will be considered most recently
  * used in the LRU list. 
  * 
@@ -586,10 +1678,11 @@ void GDALRasterBlock::Touch()
 CPLErr GDALRasterBlock::Internalize()
 
 {
-    CPLMutexHolderD( &hRBMutex );
     void        *pNewData;
     int         nSizeInBytes;
     GIntBig     nCurCacheMax = GDALGetCacheMax64();
+    GDALDataset *poDS = poBand->GetDataset();
+    GIntBig     nQuota = poDS != NULL ? poDS->GetCacheQuota() : 0;
 
     /* No risk of overflow as it is checked in GDALRasterBand::InitBlockInfo() */
     nSizeInBytes = nXSize * nYSize * (GDALGetDataTypeSize(eType) / 8);
@@ -609,11 +1702,25 @@ CPLErr GDALRasterBlock::Internalize()
     pData = pNewData;
 
 /* -------------------------------------------------------------------- */
-/*      Flush old blocks if we are nearing our memory limit.            */
+/*      Flush old blocks if we are nearing our memory limit.  The       */
+/*      cache mutex is not held while blocks are flushed, so that a     */
+/*      thread writing a dirty block never waits for a thread holding   */
+/*      it.                                                             */
 /* -------------------------------------------------------------------- */
-    AddLock(); /* don't flush this block! */
+    {
+        GDALCacheMutexHolder oHolder;
+        AddLock(); /* don't flush this block! */
+        nCacheUsed += nSizeInBytes;
+        if( poDS != NULL )
+            poDS->nCacheUsed += nSizeInBytes;
+    }
+
+    while( nQuota > 0 && poDS->nCacheUsed > nQuota )
+    {
+        if( !FlushCacheBlock( poDS ) )
+            break;
+    }
 
-    nCacheUsed += nSizeInBytes;
     while( nCacheUsed > nCurCacheMax )
     {
         GIntBig nOldCacheUsed = nCacheUsed;
@@ -627,8 +1734,11 @@ CPLErr GDALRasterBlock::Internalize()
 /* -------------------------------------------------------------------- */
 /*      Add this block to the list.                                     */
 /* -------------------------------------------------------------------- */
-    Touch();
-    DropLock();
+    {
+        GDALCacheMutexHolder oHolder;
+        Touch();
+        DropLock();
+    }
 
     return( CE_None );
 }
@@ -642,12 +1752,42 @@ CPLErr GDALRasterBlock::Internalize()
  *
  * A dirty block is one that has been modified and will need to be written
  * to disk before it can be flushed.
+ *
+ * If write-behind is enabled on the dataset of the block (see 
+ * GDALDataset::EnableWriteBehind()) and the size of the dirty blocks of
+ * such datasets goes above the high water mark, a background thread is
+ * started to write the oldest dirty blocks, so that threads needing cache
+ * memory later find clean blocks to discard instead of having to write
+ * dirty blocks themselves.
  */
 
 void GDALRasterBlock::MarkDirty()
 
 {
+    GDALCacheMutexHolder oHolder;
+
+    if( bDirty )
+        return;
+
     bDirty = TRUE;
+    nCacheDirty += GetSizeInBytes();
+
+    if( GetDatasetIOMutex() == NULL )
+        return;
+
+    nWriteBehindDirty += GetSizeInBytes();
+
+    if( bWriteBehindRunning )
+        GDALWakeUpWriteBehind();
+    else if( nWriteBehindDirty > GDALGetDirtyHighWater() )
+    {
+        if( hWriteBehindCond == NULL )
+            hWriteBehindCond = CPLCreateCond();
+
+        bWriteBehindRunning = TRUE;
+        if( CPLCreateThread( WriteBehindThread, NULL ) == -1 )
+            bWriteBehindRunning = FALSE;
+    }
 }
 
 
@@ -665,7 +1805,19 @@ void GDALRasterBlock::MarkDirty()
 void GDALRasterBlock::MarkClean()
 
 {
+    GDALCacheMutexHolder oHolder;
+
+    if( !bDirty )
+        return;
+
     bDirty = FALSE;
+    nCacheDirty -= GetSizeInBytes();
+
+    if( GetDatasetIOMutex() != NULL )
+    {
+        nWriteBehindDirty -= GetSizeInBytes();
+        GDALWakeUpWriteBehind();
+    }
 }
 
 /************************************************************************/
@@ -682,19 +1834,32 @@ void GDALRasterBlock::MarkClean()
  * safely NULL, in which case this method does nothing. 
  *
  * @param ppBlock Pointer to the block pointer to try and lock/touch.
+ * @param bCountHit TRUE to count the block as a cache hit if it is found,
+ * while the mutex is held.
  */
  
-int GDALRasterBlock::SafeLockBlock( GDALRasterBlock ** ppBlock )
+int GDALRasterBlock::SafeLockBlock( GDALRasterBlock ** ppBlock,
+                                    int bCountHit )
 
 {
     CPLAssert( NULL != ppBlock );
 
-    CPLMutexHolderD( &hRBMutex );
+    GDALCacheMutexHolder oHolder;
 
     if( *ppBlock != NULL )
     {
         (*ppBlock)->AddLock();
         (*ppBlock)->Touch();
+
+        if( bCountHit )
+        {
+            GDALCacheCounters *psDSCounters = 
+                GetDatasetCounters( (*ppBlock)->GetBand() );
+
+            sCacheCounters.nHits++;
+            if( psDSCounters != NULL )
+                psDSCounters->nHits++;
+        }
         
         return TRUE;
     }
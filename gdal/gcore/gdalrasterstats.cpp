@@ -0,0 +1,1376 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  GDAL Core
+ * Purpose:  Accumulation of the statistics and histogram of raster blocks.
+ *
+ ******************************************************************************
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+#include "gdal_priv.h"
+#include "cpl_multiproc.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define GDAL_STATS_SSE2
+#include <emmintrin.h>
+#endif
+
+CPL_CVSID("$Id$");
+
+/*
+ * Byte, UInt16 and Int16 data are accumulated as the number of occurrences
+ * of each value, from which the statistics and any histogram are derived
+ * at the end: this is a single increment per pixel, without any branch
+ * for nodata or conversion to double.  When only the statistics of
+ * unsigned Byte data are needed, the sums are directly computed 16 pixels
+ * at a time.
+ *
+ * The statistics of other data types are computed for each block from
+ * the sums of the differences to the first valid value of the block, and
+ * the mean and sum of squared deviations of the blocks are then merged.
+ * This avoids the loss of precision of the sum of squares of large values.
+ */
+
+/************************************************************************/
+/*                       GDALStatsUseValueSums()                        */
+/*                                                                      */
+/*      Whether the statistics are computed from exact sums of values   */
+/*      rather than from merged moments.                                */
+/************************************************************************/
+
+static int GDALStatsUseValueSums( GDALDataType eDataType )
+
+{
+    return eDataType == GDT_Byte || eDataType == GDT_UInt16
+        || eDataType == GDT_Int16;
+}
+
+/************************************************************************/
+/*                     GDALRasterStatsAccumulator()                     */
+/************************************************************************/
+
+GDALRasterStatsAccumulator::GDALRasterStatsAccumulator( GDALDataType eDataTypeIn,
+                                                        int bSignedByteIn,
+                                                        int bGotNoDataIn,
+                                                        double dfNoDataValueIn )
+
+{
+    eDataType = eDataTypeIn;
+    bSignedByte = (eDataType == GDT_Byte && bSignedByteIn);
+    bGotNoData = bGotNoDataIn && !CPLIsNan(dfNoDataValueIn);
+    dfNoDataValue = dfNoDataValueIn;
+
+    nNoDataByte = -1;
+    if( bGotNoData && eDataType == GDT_Byte && !bSignedByte )
+    {
+        for( int i = 0; i < 256 && nNoDataByte < 0; i++ )
+        {
+            if( ARE_REAL_EQUAL((double) i, dfNoDataValue) )
+                nNoDataByte = i;
+        }
+    }
+
+    bStats = FALSE;
+    bHistogram = FALSE;
+    dfHistMin = 0.0;
+    dfHistMax = 0.0;
+    dfHistScale = 0.0;
+    nBuckets = 0;
+    bIncludeOutOfRange = FALSE;
+    panBuckets = NULL;
+
+    nValueOffset = 0;
+    nValueCount = 0;
+    panValueCounts = NULL;
+
+    bChecksum = FALSE;
+    nChecksumXSize = 0;
+    nChecksum = 0;
+
+    if( eDataType == GDT_Byte )
+    {
+        nValueOffset = bSignedByte ? 128 : 0;
+        nValueCount = 256;
+    }
+    else if( eDataType == GDT_UInt16 || eDataType == GDT_Int16 )
+    {
+        nValueOffset = (eDataType == GDT_Int16) ? 32768 : 0;
+        nValueCount = 65536;
+    }
+
+    Reset();
+}
+
+/************************************************************************/
+/*                    ~GDALRasterStatsAccumulator()                     */
+/************************************************************************/
+
+GDALRasterStatsAccumulator::~GDALRasterStatsAccumulator()
+
+{
+    CPLFree( panBuckets );
+    CPLFree( panValueCounts );
+}
+
+/************************************************************************/
+/*                               Reset()                                */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::Reset()
+
+{
+    nCount = 0;
+    dfMin = 0.0;
+    dfMax = 0.0;
+    dfSum = 0.0;
+    dfSum2 = 0.0;
+    dfMean = 0.0;
+    dfM2 = 0.0;
+}
+
+/************************************************************************/
+/*                         RequestStatistics()                          */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::RequestStatistics()
+
+{
+    bStats = TRUE;
+
+/* -------------------------------------------------------------------- */
+/*      Unsigned Byte statistics are computed directly, unless a        */
+/*      histogram is requested too.                                     */
+/* -------------------------------------------------------------------- */
+    if( nValueCount > 0 && panValueCounts == NULL
+        && (eDataType != GDT_Byte || bSignedByte || bHistogram) )
+        panValueCounts = (GUIntBig *) CPLCalloc( sizeof(GUIntBig),
+                                                 nValueCount );
+}
+
+/************************************************************************/
+/*                          RequestHistogram()                          */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::RequestHistogram( double dfMinIn,
+                                                   double dfMaxIn,
+                                                   int nBucketsIn,
+                                                   int bIncludeOutOfRangeIn )
+
+{
+    bHistogram = TRUE;
+    dfHistMin = dfMinIn;
+    dfHistMax = dfMaxIn;
+    nBuckets = nBucketsIn;
+    dfHistScale = nBuckets / (dfHistMax - dfHistMin);
+    bIncludeOutOfRange = bIncludeOutOfRangeIn;
+
+    CPLFree( panBuckets );
+    panBuckets = NULL;
+
+    if( nValueCount > 0 )
+    {
+        if( panValueCounts == NULL )
+            panValueCounts = (GUIntBig *) CPLCalloc( sizeof(GUIntBig),
+                                                     nValueCount );
+    }
+    else
+        panBuckets = (GUIntBig *) CPLCalloc( sizeof(GUIntBig), nBuckets );
+}
+
+/************************************************************************/
+/*                          RequestChecksum()                           */
+/*                                                                      */
+/*      Request the checksum of GDALChecksumImage() over the whole      */
+/*      band, for which the blocks must be added with their offset.     */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::RequestChecksum( int nRasterXSize )
+
+{
+    bChecksum = TRUE;
+    nChecksumXSize = nRasterXSize;
+}
+
+/************************************************************************/
+/*                               Clone()                                */
+/*                                                                      */
+/*      Create an empty accumulator with the same requests.             */
+/************************************************************************/
+
+GDALRasterStatsAccumulator *GDALRasterStatsAccumulator::Clone() const
+
+{
+    GDALRasterStatsAccumulator *poClone =
+        new GDALRasterStatsAccumulator( eDataType, bSignedByte,
+                                        bGotNoData, dfNoDataValue );
+
+    if( bHistogram )
+        poClone->RequestHistogram( dfHistMin, dfHistMax, nBuckets,
+                                   bIncludeOutOfRange );
+    if( bStats )
+        poClone->RequestStatistics();
+    if( bChecksum )
+        poClone->RequestChecksum( nChecksumXSize );
+
+    return poClone;
+}
+
+/************************************************************************/
+/*                             MergeSums()                              */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::MergeSums( GIntBig nCountIn,
+                                            double dfMinIn, double dfMaxIn,
+                                            double dfSumIn, double dfSum2In )
+
+{
+    if( nCountIn == 0 )
+        return;
+
+    if( nCount == 0 )
+    {
+        dfMin = dfMinIn;
+        dfMax = dfMaxIn;
+    }
+    else
+    {
+        dfMin = MIN(dfMin, dfMinIn);
+        dfMax = MAX(dfMax, dfMaxIn);
+    }
+
+    nCount += nCountIn;
+    dfSum += dfSumIn;
+    dfSum2 += dfSum2In;
+}
+
+/************************************************************************/
+/*                            MergeMoments()                            */
+/*                                                                      */
+/*      Merge the mean and sum of squared deviations of a set of        */
+/*      values (Chan et al. pairwise update).                           */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::MergeMoments( GIntBig nCountIn,
+                                               double dfMinIn, double dfMaxIn,
+                                               double dfMeanIn, double dfM2In )
+
+{
+    if( nCountIn == 0 )
+        return;
+
+    if( dfM2In < 0.0 )
+        dfM2In = 0.0;
+
+    if( nCount == 0 )
+    {
+        nCount = nCountIn;
+        dfMin = dfMinIn;
+        dfMax = dfMaxIn;
+        dfMean = dfMeanIn;
+        dfM2 = dfM2In;
+        return;
+    }
+
+    dfMin = MIN(dfMin, dfMinIn);
+    dfMax = MAX(dfMax, dfMaxIn);
+
+    if( CPLIsInf(dfMean) || CPLIsInf(dfMeanIn) )
+    {
+        // Infinite values give an infinite mean, as a plain sum would,
+        // and an undefined deviation.
+        nCount += nCountIn;
+        dfMean += dfMeanIn;
+        dfM2 = dfMean - dfMean;
+        return;
+    }
+
+    double dfTotal = (double) nCount + (double) nCountIn;
+    double dfDelta = dfMeanIn - dfMean;
+
+    dfMean += dfDelta * ((double) nCountIn / dfTotal);
+    dfM2 += dfM2In
+        + dfDelta * dfDelta * ((double) nCount * (double) nCountIn / dfTotal);
+    nCount += nCountIn;
+}
+
+/************************************************************************/
+/*                         GDALStatsGetBucket()                         */
+/*                                                                      */
+/*      Return the histogram bucket of a value, or -1 if it is          */
+/*      discarded.                                                      */
+/************************************************************************/
+
+static inline int GDALStatsGetBucket( double dfValue, double dfMin,
+                                      double dfScale, int nBuckets,
+                                      int bIncludeOutOfRange )
+
+{
+    int nIndex = (int) floor((dfValue - dfMin) * dfScale);
+
+    if( nIndex < 0 )
+        return bIncludeOutOfRange ? 0 : -1;
+    else if( nIndex >= nBuckets )
+        return bIncludeOutOfRange ? nBuckets - 1 : -1;
+
+    return nIndex;
+}
+
+/************************************************************************/
+/*                             AddValues()                              */
+/*                                                                      */
+/*      Generic accumulation, converting each value to double.  The     */
+/*      statistics of complex data are those of the real part, while    */
+/*      the histogram is the one of the magnitude.                      */
+/************************************************************************/
+
+template<class T>
+void GDALRasterStatsAccumulator::AddValues( const T *pData,
+                                            int nXSize, int nYSize,
+                                            int nLineSpace, int bComplex )
+
+{
+    const int nComponents = bComplex ? 2 : 1;
+
+    /* local copies, as the compiler may not know that the histogram */
+    /* updates do not modify the members */
+    GUIntBig * const panHist = panBuckets;
+    const double dfHMin = dfHistMin, dfHScale = dfHistScale;
+    const int    nHBuckets = nBuckets, bHOutOfRange = bIncludeOutOfRange;
+    const int    bDoStats = bStats, bDoNoData = bGotNoData;
+    const double dfNoData = dfNoDataValue;
+
+    GIntBig   nBlockCount = 0;
+    double    dfBlockMin = 0.0, dfBlockMax = 0.0;
+    double    dfShift = 0.0, dfSumD = 0.0, dfSumD2 = 0.0;
+
+    for( int iY = 0; iY < nYSize; iY++ )
+    {
+        const T *pLine = pData + (size_t) iY * nLineSpace * nComponents;
+
+        for( int iX = 0; iX < nXSize; iX++ )
+        {
+            double dfValue = pLine[iX * nComponents];
+
+            if( panHist != NULL )
+            {
+                double dfHistValue = dfValue;
+
+                if( bComplex )
+                {
+                    double dfImag = pLine[iX * 2 + 1];
+
+                    if( CPLIsNan(dfImag) )
+                        dfHistValue = dfImag;
+                    else
+                        dfHistValue = sqrt( dfValue * dfValue
+                                            + dfImag * dfImag );
+                }
+
+                if( !CPLIsNan(dfHistValue) )
+                {
+                    int nIndex = GDALStatsGetBucket( dfHistValue, dfHMin,
+                                                     dfHScale, nHBuckets,
+                                                     bHOutOfRange );
+                    if( nIndex >= 0 )
+                        panHist[nIndex]++;
+                }
+            }
+
+            if( !bDoStats || CPLIsNan(dfValue) )
+                continue;
+
+            if( bDoNoData && ARE_REAL_EQUAL(dfValue, dfNoData) )
+                continue;
+
+            if( nBlockCount == 0 )
+            {
+                dfBlockMin = dfBlockMax = dfValue;
+                dfShift = CPLIsInf(dfValue) ? 0.0 : dfValue;
+            }
+            else if( dfValue < dfBlockMin )
+                dfBlockMin = dfValue;
+            else if( dfValue > dfBlockMax )
+                dfBlockMax = dfValue;
+
+            double dfDelta = dfValue - dfShift;
+            dfSumD += dfDelta;
+            dfSumD2 += dfDelta * dfDelta;
+            nBlockCount++;
+        }
+    }
+
+    if( nBlockCount > 0 )
+        MergeMoments( nBlockCount, dfBlockMin, dfBlockMax,
+                      dfShift + dfSumD / nBlockCount,
+                      dfSumD2 - dfSumD * dfSumD / nBlockCount );
+}
+
+/************************************************************************/
+/*                        GDALStatsCountValues()                        */
+/************************************************************************/
+
+template<class T>
+static void GDALStatsCountValues( const T *pData, int nXSize, int nYSize,
+                                  int nLineSpace, int nValueOffset,
+                                  GUIntBig *panValueCounts )
+
+{
+    GUIntBig *panCounts = panValueCounts + nValueOffset;
+
+    for( int iY = 0; iY < nYSize; iY++ )
+    {
+        const T *pLine = pData + (size_t) iY * nLineSpace;
+
+        for( int iX = 0; iX < nXSize; iX++ )
+            panCounts[pLine[iX]]++;
+    }
+}
+
+/************************************************************************/
+/*                           AddValueCounts()                           */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::AddValueCounts( const void *pData,
+                                                 int nXSize, int nYSize,
+                                                 int nLineSpace )
+
+{
+    switch( eDataType )
+    {
+      case GDT_Byte:
+        if( bSignedByte )
+            GDALStatsCountValues( (const signed char *) pData, nXSize, nYSize,
+                                  nLineSpace, nValueOffset, panValueCounts );
+        else
+            GDALStatsCountValues( (const GByte *) pData, nXSize, nYSize,
+                                  nLineSpace, nValueOffset, panValueCounts );
+        break;
+
+      case GDT_UInt16:
+        GDALStatsCountValues( (const GUInt16 *) pData, nXSize, nYSize,
+                              nLineSpace, nValueOffset, panValueCounts );
+        break;
+
+      case GDT_Int16:
+        GDALStatsCountValues( (const GInt16 *) pData, nXSize, nYSize,
+                              nLineSpace, nValueOffset, panValueCounts );
+        break;
+
+      default:
+        CPLAssert( FALSE );
+    }
+}
+
+/************************************************************************/
+/*                            AddByteStats()                            */
+/*                                                                      */
+/*      Statistics of unsigned Byte data, excluding nNoDataByte.        */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::AddByteStats( const GByte *pabyData,
+                                               int nXSize, int nYSize,
+                                               int nLineSpace )
+
+{
+    GUIntBig nSum = 0, nSum2 = 0, nNoDataCount = 0;
+    int      nBlockMin = 255, nBlockMax = 0;
+    int      iX, iY;
+
+#ifdef GDAL_STATS_SSE2
+    const __m128i xmm_zero = _mm_setzero_si128();
+    const __m128i xmm_nodata = _mm_set1_epi8( (char) nNoDataByte );
+    __m128i xmm_min = _mm_set1_epi8( (char) 255 );
+    __m128i xmm_max = xmm_zero;
+    __m128i xmm_sum = xmm_zero;         /* 2 x 64 bits */
+    __m128i xmm_sum2 = xmm_zero;        /* 2 x 64 bits */
+    __m128i xmm_nodata_sum = xmm_zero;  /* 255 per nodata pixel */
+#endif
+
+    for( iY = 0; iY < nYSize; iY++ )
+    {
+        const GByte *pabyLine = pabyData + (size_t) iY * nLineSpace;
+
+        iX = 0;
+
+#ifdef GDAL_STATS_SSE2
+        /* The sums of squares of 4096 x 16 pixels fit in 4 x 32 bits. */
+        while( iX + 16 <= nXSize )
+        {
+            __m128i xmm_sum2_32 = xmm_zero;
+            int nIter;
+
+            for( nIter = 0; nIter < 4096 && iX + 16 <= nXSize;
+                 nIter++, iX += 16 )
+            {
+                __m128i xmm_v =
+                    _mm_loadu_si128( (const __m128i *) (pabyLine + iX) );
+
+                if( nNoDataByte >= 0 )
+                {
+                    // Nodata is replaced by 255 for the minimum, and
+                    // by 0 for the maximum and the sums.
+                    __m128i xmm_eq = _mm_cmpeq_epi8( xmm_v, xmm_nodata );
+                    xmm_nodata_sum =
+                        _mm_add_epi64( xmm_nodata_sum,
+                                       _mm_sad_epu8( xmm_eq, xmm_zero ) );
+                    xmm_min = _mm_min_epu8( xmm_min,
+                                            _mm_or_si128( xmm_v, xmm_eq ) );
+                    xmm_v = _mm_andnot_si128( xmm_eq, xmm_v );
+                }
+                else
+                    xmm_min = _mm_min_epu8( xmm_min, xmm_v );
+
+                xmm_max = _mm_max_epu8( xmm_max, xmm_v );
+                xmm_sum = _mm_add_epi64( xmm_sum,
+                                         _mm_sad_epu8( xmm_v, xmm_zero ) );
+
+                __m128i xmm_lo = _mm_unpacklo_epi8( xmm_v, xmm_zero );
+                __m128i xmm_hi = _mm_unpackhi_epi8( xmm_v, xmm_zero );
+                xmm_sum2_32 =
+                    _mm_add_epi32( xmm_sum2_32,
+                                   _mm_add_epi32(
+                                       _mm_madd_epi16( xmm_lo, xmm_lo ),
+                                       _mm_madd_epi16( xmm_hi, xmm_hi ) ) );
+            }
+
+            xmm_sum2 = _mm_add_epi64( xmm_sum2,
+                                      _mm_unpacklo_epi32( xmm_sum2_32,
+                                                          xmm_zero ) );
+            xmm_sum2 = _mm_add_epi64( xmm_sum2,
+                                      _mm_unpackhi_epi32( xmm_sum2_32,
+                                                          xmm_zero ) );
+        }
+#endif
+
+        for( ; iX < nXSize; iX++ )
+        {
+            int nValue = pabyLine[iX];
+
+            if( nValue == nNoDataByte )
+            {
+                nNoDataCount++;
+                continue;
+            }
+
+            nBlockMin = MIN(nBlockMin, nValue);
+            nBlockMax = MAX(nBlockMax, nValue);
+            nSum += nValue;
+            nSum2 += nValue * nValue;
+        }
+    }
+
+#ifdef GDAL_STATS_SSE2
+    GUIntBig anLanes[2];
+    GByte    abyLanes[16];
+
+    _mm_storeu_si128( (__m128i *) anLanes, xmm_sum );
+    nSum += anLanes[0] + anLanes[1];
+    _mm_storeu_si128( (__m128i *) anLanes, xmm_sum2 );
+    nSum2 += anLanes[0] + anLanes[1];
+    _mm_storeu_si128( (__m128i *) anLanes, xmm_nodata_sum );
+    nNoDataCount += (anLanes[0] + anLanes[1]) / 255;
+
+    _mm_storeu_si128( (__m128i *) abyLanes, xmm_min );
+    for( iX = 0; iX < 16; iX++ )
+        nBlockMin = MIN(nBlockMin, abyLanes[iX]);
+    _mm_storeu_si128( (__m128i *) abyLanes, xmm_max );
+    for( iX = 0; iX < 16; iX++ )
+        nBlockMax = MAX(nBlockMax, abyLanes[iX]);
+#endif
+
+    GIntBig nBlockCount = (GIntBig) nXSize * nYSize - (GIntBig) nNoDataCount;
+
+    if( nBlockCount > 0 )
+        MergeSums( nBlockCount, nBlockMin, nBlockMax,
+                   (double) nSum, (double) nSum2 );
+}
+
+/************************************************************************/
+/*                          AddFloat32Stats()                           */
+/*                                                                      */
+/*      Statistics of Float32 data without nodata value.                */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::AddFloat32Stats( const float *pafData,
+                                                  int nXSize, int nYSize,
+                                                  int nLineSpace )
+
+{
+#ifdef GDAL_STATS_SSE2
+    static const int anNaNCount[16] =
+        { 4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0 };
+    float  fShift = 0.0f;
+    int    bFound = FALSE;
+    int    iX, iY;
+
+/* -------------------------------------------------------------------- */
+/*      The first valid value is the shift of the sums, and also        */
+/*      replaces NaN for the minimum and maximum.                       */
+/* -------------------------------------------------------------------- */
+    for( iY = 0; iY < nYSize && !bFound; iY++ )
+    {
+        const float *pafLine = pafData + (size_t) iY * nLineSpace;
+
+        for( iX = 0; iX < nXSize; iX++ )
+        {
+            if( !CPLIsNan(pafLine[iX]) )
+            {
+                fShift = pafLine[iX];
+                bFound = TRUE;
+                break;
+            }
+        }
+    }
+
+    if( !bFound )
+        return;
+
+    const __m128  xmm_fill = _mm_set1_ps( fShift );
+    __m128  xmm_min = xmm_fill;
+    __m128  xmm_max = xmm_fill;
+    double  dfBlockMin = fShift, dfBlockMax = fShift;
+
+    if( CPLIsInf(fShift) )
+        fShift = 0.0f;
+
+    const __m128d xmm_shiftd = _mm_set1_pd( fShift );
+    __m128d xmm_sum_lo = _mm_setzero_pd();
+    __m128d xmm_sum_hi = _mm_setzero_pd();
+    __m128d xmm_sum2_lo = _mm_setzero_pd();
+    __m128d xmm_sum2_hi = _mm_setzero_pd();
+    GIntBig nNaNCount = 0;
+    double  dfSumD = 0.0, dfSumD2 = 0.0;
+
+    for( iY = 0; iY < nYSize; iY++ )
+    {
+        const float *pafLine = pafData + (size_t) iY * nLineSpace;
+
+        for( iX = 0; iX + 4 <= nXSize; iX += 4 )
+        {
+            __m128 xmm_v = _mm_loadu_ps( pafLine + iX );
+            __m128 xmm_ord = _mm_cmpord_ps( xmm_v, xmm_v );
+
+            nNaNCount += anNaNCount[_mm_movemask_ps( xmm_ord )];
+            xmm_v = _mm_or_ps( _mm_and_ps( xmm_ord, xmm_v ),
+                               _mm_andnot_ps( xmm_ord, xmm_fill ) );
+
+            xmm_min = _mm_min_ps( xmm_min, xmm_v );
+            xmm_max = _mm_max_ps( xmm_max, xmm_v );
+
+            __m128d xmm_lo = _mm_sub_pd( _mm_cvtps_pd( xmm_v ), xmm_shiftd );
+            __m128d xmm_hi = _mm_sub_pd(
+                _mm_cvtps_pd( _mm_movehl_ps( xmm_v, xmm_v ) ), xmm_shiftd );
+
+            xmm_sum_lo = _mm_add_pd( xmm_sum_lo, xmm_lo );
+            xmm_sum_hi = _mm_add_pd( xmm_sum_hi, xmm_hi );
+            xmm_sum2_lo = _mm_add_pd( xmm_sum2_lo, _mm_mul_pd( xmm_lo, xmm_lo ) );
+            xmm_sum2_hi = _mm_add_pd( xmm_sum2_hi, _mm_mul_pd( xmm_hi, xmm_hi ) );
+        }
+
+        for( ; iX < nXSize; iX++ )
+        {
+            double dfValue = pafLine[iX];
+
+            if( CPLIsNan(dfValue) )
+            {
+                nNaNCount++;
+                continue;
+            }
+
+            dfBlockMin = MIN(dfBlockMin, dfValue);
+            dfBlockMax = MAX(dfBlockMax, dfValue);
+
+            double dfDelta = dfValue - fShift;
+            dfSumD += dfDelta;
+            dfSumD2 += dfDelta * dfDelta;
+        }
+    }
+
+    double adfLanes[2];
+    float  afLanes[4];
+
+    _mm_storeu_pd( adfLanes, _mm_add_pd( xmm_sum_lo, xmm_sum_hi ) );
+    dfSumD += adfLanes[0] + adfLanes[1];
+    _mm_storeu_pd( adfLanes, _mm_add_pd( xmm_sum2_lo, xmm_sum2_hi ) );
+    dfSumD2 += adfLanes[0] + adfLanes[1];
+
+    _mm_storeu_ps( afLanes, xmm_min );
+    for( iX = 0; iX < 4; iX++ )
+        dfBlockMin = MIN(dfBlockMin, afLanes[iX]);
+    _mm_storeu_ps( afLanes, xmm_max );
+    for( iX = 0; iX < 4; iX++ )
+        dfBlockMax = MAX(dfBlockMax, afLanes[iX]);
+
+    GIntBig nBlockCount = (GIntBig) nXSize * nYSize - nNaNCount;
+
+    MergeMoments( nBlockCount, dfBlockMin, dfBlockMax,
+                  fShift + dfSumD / nBlockCount,
+                  dfSumD2 - dfSumD * dfSumD / nBlockCount );
+#else
+    AddValues( pafData, nXSize, nYSize, nLineSpace, FALSE );
+#endif
+}
+
+/************************************************************************/
+/*                       GDALStatsChecksumValue()                       */
+/*                                                                      */
+/*      The value of a sample in the checksum, converted to Int32 as    */
+/*      GDALCopyWords() does for integer data and GDALChecksumImage()   */
+/*      for floating point data.                                        */
+/************************************************************************/
+
+static inline GInt32 GDALStatsChecksumValue( GByte nValue )
+{
+    return nValue;
+}
+
+static inline GInt32 GDALStatsChecksumValue( GUInt16 nValue )
+{
+    return nValue;
+}
+
+static inline GInt32 GDALStatsChecksumValue( GInt16 nValue )
+{
+    return nValue;
+}
+
+static inline GInt32 GDALStatsChecksumValue( GUInt32 nValue )
+{
+    return nValue > 2147483647U ? 2147483647 : (GInt32) nValue;
+}
+
+static inline GInt32 GDALStatsChecksumValue( GInt32 nValue )
+{
+    return nValue;
+}
+
+static inline GInt32 GDALStatsChecksumValue( double dfValue )
+{
+    if( CPLIsNan(dfValue) || CPLIsInf(dfValue) )
+        return -2147483647 - 1;
+
+    dfValue += 0.5;
+
+    if( dfValue < -2147483647.0 )
+        return -2147483647;
+    else if( dfValue > 2147483647 )
+        return 2147483647;
+    else
+        return (GInt32) floor(dfValue);
+}
+
+static inline GInt32 GDALStatsChecksumValue( float fValue )
+{
+    return GDALStatsChecksumValue( (double) fValue );
+}
+
+/************************************************************************/
+/*                         GDALStatsChecksum()                          */
+/*                                                                      */
+/*      Sum of the checksum terms of a block.  The prime of a sample    */
+/*      depends on its index in the whole band, and the 16 bit          */
+/*      checksum is the sum of all terms modulo 65536.                  */
+/************************************************************************/
+
+template<class T>
+static GUInt32 GDALStatsChecksum( const T *pData, int nXSize, int nYSize,
+                                  int nLineSpace, int nComponents,
+                                  int nRasterXSize, int nXOff, int nYOff )
+
+{
+    static const int anPrimes[11] =
+        { 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43 };
+    GUInt32 nSum = 0;
+
+    for( int iY = 0; iY < nYSize; iY++ )
+    {
+        const T *pLine = pData + (size_t) iY * nLineSpace * nComponents;
+        int iPrime = (int) ((((GIntBig) (nYOff + iY) * nRasterXSize + nXOff)
+                             * nComponents) % 11);
+
+        for( int i = 0; i < nXSize * nComponents; i++ )
+        {
+            nSum += (GUInt32) (GDALStatsChecksumValue( pLine[i] )
+                               % anPrimes[iPrime]);
+            if( ++iPrime == 11 )
+                iPrime = 0;
+        }
+    }
+
+    return nSum;
+}
+
+/************************************************************************/
+/*                            AddChecksum()                             */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::AddChecksum( const void *pData,
+                                              int nXSize, int nYSize,
+                                              int nLineSpace,
+                                              int nXOff, int nYOff )
+
+{
+    switch( eDataType )
+    {
+      case GDT_Byte:
+        nChecksum += GDALStatsChecksum( (const GByte *) pData, nXSize, nYSize,
+                                        nLineSpace, 1, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_UInt16:
+        nChecksum += GDALStatsChecksum( (const GUInt16 *) pData, nXSize,
+                                        nYSize, nLineSpace, 1, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_Int16:
+        nChecksum += GDALStatsChecksum( (const GInt16 *) pData, nXSize,
+                                        nYSize, nLineSpace, 1, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_UInt32:
+        nChecksum += GDALStatsChecksum( (const GUInt32 *) pData, nXSize,
+                                        nYSize, nLineSpace, 1, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_Int32:
+        nChecksum += GDALStatsChecksum( (const GInt32 *) pData, nXSize,
+                                        nYSize, nLineSpace, 1, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_Float32:
+        nChecksum += GDALStatsChecksum( (const float *) pData, nXSize,
+                                        nYSize, nLineSpace, 1, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_Float64:
+        nChecksum += GDALStatsChecksum( (const double *) pData, nXSize,
+                                        nYSize, nLineSpace, 1, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_CInt16:
+        nChecksum += GDALStatsChecksum( (const GInt16 *) pData, nXSize,
+                                        nYSize, nLineSpace, 2, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_CInt32:
+        nChecksum += GDALStatsChecksum( (const GInt32 *) pData, nXSize,
+                                        nYSize, nLineSpace, 2, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_CFloat32:
+        nChecksum += GDALStatsChecksum( (const float *) pData, nXSize,
+                                        nYSize, nLineSpace, 2, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      case GDT_CFloat64:
+        nChecksum += GDALStatsChecksum( (const double *) pData, nXSize,
+                                        nYSize, nLineSpace, 2, nChecksumXSize,
+                                        nXOff, nYOff );
+        break;
+      default:
+        CPLAssert( FALSE );
+    }
+}
+
+/************************************************************************/
+/*                              AddBlock()                              */
+/*                                                                      */
+/*      Accumulate a buffer of nXSize x nYSize values of the data       */
+/*      type, with nLineSpace values between the start of lines.        */
+/*      nXOff and nYOff are the position of the buffer in the band,     */
+/*      only needed for the checksum.                                   */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::AddBlock( const void *pData,
+                                           int nXSize, int nYSize,
+                                           int nLineSpace,
+                                           int nXOff, int nYOff )
+
+{
+    if( bChecksum )
+        AddChecksum( pData, nXSize, nYSize, nLineSpace, nXOff, nYOff );
+
+    if( !bStats && !bHistogram )
+        return;
+
+    if( panValueCounts != NULL )
+    {
+        AddValueCounts( pData, nXSize, nYSize, nLineSpace );
+        return;
+    }
+
+    switch( eDataType )
+    {
+      case GDT_Byte:
+        AddByteStats( (const GByte *) pData, nXSize, nYSize, nLineSpace );
+        break;
+      case GDT_UInt32:
+        AddValues( (const GUInt32 *) pData, nXSize, nYSize, nLineSpace,
+                   FALSE );
+        break;
+      case GDT_Int32:
+        AddValues( (const GInt32 *) pData, nXSize, nYSize, nLineSpace,
+                   FALSE );
+        break;
+      case GDT_Float32:
+        if( bStats && !bHistogram && !bGotNoData )
+            AddFloat32Stats( (const float *) pData, nXSize, nYSize,
+                             nLineSpace );
+        else
+            AddValues( (const float *) pData, nXSize, nYSize, nLineSpace,
+                       FALSE );
+        break;
+      case GDT_Float64:
+        AddValues( (const double *) pData, nXSize, nYSize, nLineSpace,
+                   FALSE );
+        break;
+      case GDT_CInt16:
+        AddValues( (const GInt16 *) pData, nXSize, nYSize, nLineSpace,
+                   TRUE );
+        break;
+      case GDT_CInt32:
+        AddValues( (const GInt32 *) pData, nXSize, nYSize, nLineSpace,
+                   TRUE );
+        break;
+      case GDT_CFloat32:
+        AddValues( (const float *) pData, nXSize, nYSize, nLineSpace,
+                   TRUE );
+        break;
+      case GDT_CFloat64:
+        AddValues( (const double *) pData, nXSize, nYSize, nLineSpace,
+                   TRUE );
+        break;
+      default:
+        CPLAssert( FALSE );
+    }
+}
+
+/************************************************************************/
+/*                               Merge()                                */
+/*                                                                      */
+/*      Add the values accumulated by a clone of this accumulator.      */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::Merge( const GDALRasterStatsAccumulator *poOther )
+
+{
+    int i;
+
+    if( panValueCounts != NULL && poOther->panValueCounts != NULL )
+    {
+        for( i = 0; i < nValueCount; i++ )
+            panValueCounts[i] += poOther->panValueCounts[i];
+    }
+
+    if( panBuckets != NULL && poOther->panBuckets != NULL )
+    {
+        for( i = 0; i < nBuckets; i++ )
+            panBuckets[i] += poOther->panBuckets[i];
+    }
+
+    nChecksum += poOther->nChecksum;
+
+    if( GDALStatsUseValueSums( eDataType ) )
+        MergeSums( poOther->nCount, poOther->dfMin, poOther->dfMax,
+                   poOther->dfSum, poOther->dfSum2 );
+    else
+        MergeMoments( poOther->nCount, poOther->dfMin, poOther->dfMax,
+                      poOther->dfMean, poOther->dfM2 );
+}
+
+/************************************************************************/
+/*                           GetStatistics()                            */
+/*                                                                      */
+/*      Return FALSE if no valid value was accumulated.                 */
+/************************************************************************/
+
+int GDALRasterStatsAccumulator::GetStatistics( double *pdfMin, double *pdfMax,
+                                               double *pdfMean,
+                                               double *pdfStdDev,
+                                               GIntBig *pnValidCount ) const
+
+{
+    GIntBig nTotal = nCount;
+    double  dfMinOut = dfMin, dfMaxOut = dfMax;
+    double  dfSumOut = dfSum, dfSum2Out = dfSum2;
+
+    if( panValueCounts != NULL )
+    {
+        for( int i = 0; i < nValueCount; i++ )
+        {
+            if( panValueCounts[i] == 0 )
+                continue;
+
+            double dfValue = i - nValueOffset;
+            double dfCount = (double) panValueCounts[i];
+
+            if( bGotNoData && ARE_REAL_EQUAL(dfValue, dfNoDataValue) )
+                continue;
+
+            if( nTotal == 0 )
+                dfMinOut = dfValue;
+            dfMaxOut = dfValue;
+
+            nTotal += (GIntBig) panValueCounts[i];
+            dfSumOut += dfCount * dfValue;
+            dfSum2Out += dfCount * dfValue * dfValue;
+        }
+    }
+
+    double dfMeanOut = 0.0, dfStdDevOut = 0.0;
+
+    if( nTotal > 0 )
+    {
+        if( GDALStatsUseValueSums( eDataType ) )
+        {
+            dfMeanOut = dfSumOut / nTotal;
+            dfStdDevOut = sqrt((dfSum2Out / nTotal) - (dfMeanOut * dfMeanOut));
+        }
+        else
+        {
+            dfMeanOut = dfMean;
+            dfStdDevOut = sqrt(dfM2 / nTotal);
+        }
+    }
+
+    if( pdfMin != NULL )
+        *pdfMin = dfMinOut;
+    if( pdfMax != NULL )
+        *pdfMax = dfMaxOut;
+    if( pdfMean != NULL )
+        *pdfMean = dfMeanOut;
+    if( pdfStdDev != NULL )
+        *pdfStdDev = dfStdDevOut;
+    if( pnValidCount != NULL )
+        *pnValidCount = nTotal;
+
+    return nTotal > 0;
+}
+
+/************************************************************************/
+/*                            GetHistogram()                            */
+/************************************************************************/
+
+void GDALRasterStatsAccumulator::GetHistogram( int *panHistogram ) const
+
+{
+    int i;
+
+    memset( panHistogram, 0, sizeof(int) * nBuckets );
+
+    if( panValueCounts != NULL )
+    {
+        for( i = 0; i < nValueCount; i++ )
+        {
+            if( panValueCounts[i] == 0 )
+                continue;
+
+            int nIndex = GDALStatsGetBucket( (double) (i - nValueOffset),
+                                             dfHistMin, dfHistScale, nBuckets,
+                                             bIncludeOutOfRange );
+            if( nIndex >= 0 )
+                panHistogram[nIndex] += (int) panValueCounts[i];
+        }
+    }
+    else if( panBuckets != NULL )
+    {
+        for( i = 0; i < nBuckets; i++ )
+            panHistogram[i] = (int) panBuckets[i];
+    }
+}
+
+/************************************************************************/
+/*                            GetChecksum()                             */
+/************************************************************************/
+
+int GDALRasterStatsAccumulator::GetChecksum() const
+
+{
+    return (int) (nChecksum & 0xffff);
+}
+
+/************************************************************************/
+/*                            GDALStatsJob                              */
+/************************************************************************/
+
+typedef struct
+{
+    int               nBandCount;
+    GDALRasterBand  **papoBands;
+    int               nBlockXSize;
+    int               nBlockYSize;
+    int               nBlocksPerRow;
+    int               nSampleRate;
+    int               nSamples;
+    int               bFailOnReadError;
+
+    const char       *pszMessage;
+    GDALProgressFunc  pfnProgress;
+    void             *pProgressData;
+
+    void             *hMutex;
+    CPLErr            eErr;
+    int               nNextSample;
+    int               nSamplesDone;
+} GDALStatsJob;
+
+typedef struct
+{
+    GDALStatsJob                *psJob;
+    GDALRasterStatsAccumulator **papoAccums;
+    int                          bMainThread;
+} GDALStatsThreadData;
+
+/************************************************************************/
+/*                         GDALStatsRunBlocks()                         */
+/*                                                                      */
+/*      Accumulate sample blocks until none are left.  The blocks are   */
+/*      fetched under the job mutex as the drivers and the block        */
+/*      cache are not thread safe, but accumulated outside of it.       */
+/************************************************************************/
+
+static void GDALStatsRunBlocks( GDALStatsJob *psJob,
+                                GDALRasterStatsAccumulator **papoAccums,
+                                int bMainThread )
+
+{
+    GDALRasterBand *poFirstBand = psJob->papoBands[0];
+    GDALRasterBlock **papoBlocks = (GDALRasterBlock **)
+        CPLCalloc( sizeof(GDALRasterBlock *), psJob->nBandCount );
+    int iBand;
+
+    while( TRUE )
+    {
+        int  iSample, iXBlock, iYBlock, nXCheck, nYCheck;
+        double dfComplete;
+
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+
+        iSample = psJob->nNextSample++;
+        if( iSample >= psJob->nSamples || psJob->eErr != CE_None )
+        {
+            CPLReleaseMutex( psJob->hMutex );
+            break;
+        }
+
+        iYBlock = (iSample * psJob->nSampleRate) / psJob->nBlocksPerRow;
+        iXBlock = iSample * psJob->nSampleRate
+            - psJob->nBlocksPerRow * iYBlock;
+
+        for( iBand = 0; iBand < psJob->nBandCount; iBand++ )
+        {
+            GDALRasterBlock *poBlock =
+                psJob->papoBands[iBand]->GetLockedBlockRef( iXBlock, iYBlock );
+
+            if( poBlock != NULL && poBlock->GetDataRef() == NULL )
+            {
+                poBlock->DropLock();
+                poBlock = NULL;
+            }
+            if( poBlock == NULL && psJob->bFailOnReadError )
+                psJob->eErr = CE_Failure;
+
+            papoBlocks[iBand] = poBlock;
+        }
+
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( (iXBlock+1) * psJob->nBlockXSize > poFirstBand->GetXSize() )
+            nXCheck = poFirstBand->GetXSize() - iXBlock * psJob->nBlockXSize;
+        else
+            nXCheck = psJob->nBlockXSize;
+
+        if( (iYBlock+1) * psJob->nBlockYSize > poFirstBand->GetYSize() )
+            nYCheck = poFirstBand->GetYSize() - iYBlock * psJob->nBlockYSize;
+        else
+            nYCheck = psJob->nBlockYSize;
+
+        for( iBand = 0; iBand < psJob->nBandCount; iBand++ )
+        {
+            if( papoBlocks[iBand] != NULL )
+                papoAccums[iBand]->AddBlock( papoBlocks[iBand]->GetDataRef(),
+                                             nXCheck, nYCheck,
+                                             psJob->nBlockXSize,
+                                             iXBlock * psJob->nBlockXSize,
+                                             iYBlock * psJob->nBlockYSize );
+        }
+
+        CPLAcquireMutex( psJob->hMutex, 1000.0 );
+        for( iBand = 0; iBand < psJob->nBandCount; iBand++ )
+        {
+            if( papoBlocks[iBand] != NULL )
+                papoBlocks[iBand]->DropLock();
+        }
+        psJob->nSamplesDone++;
+        dfComplete = psJob->nSamplesDone / (double) psJob->nSamples;
+        CPLReleaseMutex( psJob->hMutex );
+
+        if( bMainThread
+            && !psJob->pfnProgress( dfComplete, psJob->pszMessage,
+                                    psJob->pProgressData ) )
+        {
+            CPLAcquireMutex( psJob->hMutex, 1000.0 );
+            psJob->eErr = CE_Failure;
+            CPLReleaseMutex( psJob->hMutex );
+
+            CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        }
+    }
+
+    CPLFree( papoBlocks );
+}
+
+/************************************************************************/
+/*                           GDALStatsJobFunc()                         */
+/************************************************************************/
+
+static CPLErr GDALStatsJobFunc( void *pData )
+
+{
+    GDALStatsThreadData *psThreadData = (GDALStatsThreadData *) pData;
+    GDALStatsJob *psJob = psThreadData->psJob;
+
+    GDALStatsRunBlocks( psJob, psThreadData->papoAccums,
+                        psThreadData->bMainThread );
+
+    CPLAcquireMutex( psJob->hMutex, 1000.0 );
+    CPLErr eErr = psJob->eErr;
+    CPLReleaseMutex( psJob->hMutex );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                          AccumulateBlocks()                          */
+/************************************************************************/
+
+/**
+ * \brief Feed the blocks of bands to accumulators.
+ *
+ * The bands must have the same size and block size.  The blocks at the
+ * same position in all bands are read together, and one of every
+ * nSampleRate block positions is read.
+ *
+ * The blocks are accumulated by the number of threads set by the
+ * GDAL_NUM_THREADS configuration option (1 by default), each one with
+ * clones of the accumulators that are merged at the end.
+ *
+ * @param nBandCount the number of bands.
+ * @param papoBands the bands.
+ * @param papoAccums the accumulator of each band.
+ * @param nSampleRate the ratio of block positions read.
+ * @param bFailOnReadError TRUE to fail if a block cannot be read, FALSE
+ * to skip it.
+ * @param pszMessage the progress message.
+ * @param pfnProgress function to report progress to completion.
+ * @param pProgressData application data to pass to pfnProgress.
+ *
+ * @return CE_None on success, or CE_Failure if something goes wrong.
+ */
+
+CPLErr GDALRasterStatsAccumulator::AccumulateBlocks(
+    int nBandCount, GDALRasterBand **papoBands,
+    GDALRasterStatsAccumulator **papoAccums,
+    int nSampleRate, int bFailOnReadError,
+    const char *pszMessage, GDALProgressFunc pfnProgress, void *pProgressData )
+
+{
+    GDALRasterBand *poFirstBand = papoBands[0];
+    GDALStatsJob sJob;
+    int i, iBand;
+
+    if( poFirstBand->GetDataset() != NULL )
+        poFirstBand->GetDataset()->WaitForPrefetch();
+
+    poFirstBand->GetBlockSize( &sJob.nBlockXSize, &sJob.nBlockYSize );
+
+    int nBlocksPerColumn = (poFirstBand->GetYSize() + sJob.nBlockYSize - 1)
+        / sJob.nBlockYSize;
+
+    sJob.nBandCount = nBandCount;
+    sJob.papoBands = papoBands;
+    sJob.nBlocksPerRow = (poFirstBand->GetXSize() + sJob.nBlockXSize - 1)
+        / sJob.nBlockXSize;
+    sJob.nSampleRate = nSampleRate;
+    sJob.nSamples = (sJob.nBlocksPerRow * nBlocksPerColumn + nSampleRate - 1)
+        / nSampleRate;
+    sJob.bFailOnReadError = bFailOnReadError;
+    sJob.pszMessage = pszMessage;
+    sJob.pfnProgress = pfnProgress;
+    sJob.pProgressData = pProgressData;
+    sJob.eErr = CE_None;
+    sJob.nNextSample = 0;
+    sJob.nSamplesDone = 0;
+    sJob.hMutex = CPLCreateMutex();
+    CPLReleaseMutex( sJob.hMutex );
+
+/* -------------------------------------------------------------------- */
+/*      Process blocks in this thread and in the worker threads, each   */
+/*      one with its own accumulators.                                  */
+/* -------------------------------------------------------------------- */
+    int nThreads = atoi( CPLGetConfigOption( "GDAL_NUM_THREADS", "1" ) );
+
+    nThreads = MAX( 1, MIN( nThreads, sJob.nSamples ) );
+
+    GDALStatsThreadData *pasThreadData = (GDALStatsThreadData *)
+        CPLCalloc( sizeof(GDALStatsThreadData), nThreads );
+    void **papThreadData = (void **) CPLCalloc( sizeof(void *), nThreads );
+
+    for( i = 0; i < nThreads; i++ )
+    {
+        pasThreadData[i].psJob = &sJob;
+        pasThreadData[i].bMainThread = (i == 0);
+        if( i == 0 )
+            pasThreadData[i].papoAccums = papoAccums;
+        else
+        {
+            pasThreadData[i].papoAccums = (GDALRasterStatsAccumulator **)
+                CPLMalloc( sizeof(GDALRasterStatsAccumulator *) * nBandCount );
+            for( iBand = 0; iBand < nBandCount; iBand++ )
+                pasThreadData[i].papoAccums[iBand] =
+                    papoAccums[iBand]->Clone();
+        }
+        papThreadData[i] = pasThreadData + i;
+    }
+
+    /* The first job is run by this thread, which reports progress */
+    CPLErr eErr = CPLRunJobs( GDALStatsJobFunc, papThreadData, nThreads );
+    if( sJob.eErr == CE_None )
+        sJob.eErr = eErr;
+
+/* -------------------------------------------------------------------- */
+/*      Merge the accumulators of the other threads.                    */
+/* -------------------------------------------------------------------- */
+    for( i = 1; i < nThreads; i++ )
+    {
+        for( iBand = 0; iBand < nBandCount; iBand++ )
+        {
+            papoAccums[iBand]->Merge( pasThreadData[i].papoAccums[iBand] );
+            delete pasThreadData[i].papoAccums[iBand];
+        }
+        CPLFree( pasThreadData[i].papoAccums );
+    }
+
+    CPLFree( papThreadData );
+    CPLFree( pasThreadData );
+    CPLDestroyMutex( sJob.hMutex );
+
+    return sJob.eErr;
+}
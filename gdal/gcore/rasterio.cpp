@@ -29,6 +29,7 @@
  ****************************************************************************/
 
 #include "gdal_priv.h"
+#include "cpl_multiproc.h"
 
 // Define a list of "C++" compilers that have broken template support or
 // broken scoping so we can fall back on the legacy implementation of
@@ -79,6 +80,84 @@ CPLErr GDALRasterBand::IRasterIO( GDALRWFlag eRWFlag,
         return eErr;
     }
 
+/* ==================================================================== */
+/*      Reading a column of blocks, in the band data type and with      */
+/*      packed spacing: the buffer has exactly the layout of the        */
+/*      blocks, so let the driver decode the whole blocks straight      */
+/*      into it rather than going through the block cache.  Blocks     */
+/*      already cached (possibly dirty), and the first and last ones    */
+/*      if only partly requested, are taken from the cache.             */
+/* ==================================================================== */
+    if( eRWFlag == GF_Read
+        && eBufType == eDataType
+        && nPixelSpace == nBufDataSize
+        && nLineSpace == nPixelSpace * nXSize
+        && nXSize == nBlockXSize
+        && nBufXSize == nXSize 
+        && nBufYSize == nYSize
+        && nBlockYSize > 0
+        && (nXOff % nBlockXSize) == 0
+        && nXOff + nXSize <= nRasterXSize
+        && nYOff + nYSize <= nRasterYSize
+        && !bForceCachedIO
+        && CanReadBlockDirect() )
+    {
+        size_t  nBlockLineBytes = (size_t) nBlockXSize * nBandDataSize;
+        int     nChunkYSize;
+
+        nLBlockX = nXOff / nBlockXSize;
+        for( iBufYOff = 0; iBufYOff < nBufYSize; iBufYOff += nChunkYSize )
+        {
+            GByte *pabyDstChunk = (GByte *) pData
+                + iBufYOff * nBlockLineBytes;
+            int    nYInBlock;
+
+            iSrcY = nYOff + iBufYOff;
+            nLBlockY = iSrcY / nBlockYSize;
+            nYInBlock = iSrcY - nLBlockY * nBlockYSize;
+            nChunkYSize = MIN( nBlockYSize - nYInBlock, nBufYSize - iBufYOff );
+
+            poBlock = TryGetLockedBlockRef( nLBlockX, nLBlockY, TRUE );
+            if( poBlock == NULL && nChunkYSize < nBlockYSize )
+            {
+                poBlock = GetLockedBlockRef( nLBlockX, nLBlockY );
+                if( poBlock == NULL )
+                    return CE_Failure;
+            }
+
+            if( poBlock != NULL )
+            {
+                pabySrcBlock = (GByte *) poBlock->GetDataRef();
+                if( pabySrcBlock != NULL )
+                    memcpy( pabyDstChunk, 
+                            pabySrcBlock + nYInBlock * nBlockLineBytes, 
+                            nChunkYSize * nBlockLineBytes );
+                poBlock->DropLock();
+
+                if( pabySrcBlock == NULL )
+                    return CE_Failure;
+                continue;
+            }
+
+            double dfStartTime = GDALRasterBlock::GetIOClock();
+            CPLErr eErr = IReadBlock( nLBlockX, nLBlockY, pabyDstChunk );
+
+            GDALRasterBlock::RecordDriverRead( 
+                this, TRUE, (int) (nBlockYSize * nBlockLineBytes),
+                GDALRasterBlock::GetIOClock() - dfStartTime );
+
+            if( eErr != CE_None )
+            {
+                ReportError( eErr, CPLE_AppDefined,
+                             "IReadBlock failed at X offset %d, Y offset %d",
+                             nLBlockX, nLBlockY );
+                return eErr;
+            }
+        }
+
+        return CE_None;
+    }
+
 /* ==================================================================== */
 /*      A common case is the data requested with the destination        */
 /*      is packed, and the block width is the raster width.             */
@@ -2301,6 +2380,132 @@ int GDALDatasetGetBestOverviewLevel(GDALDataset* poDS,
                                         nBufXSize, nBufYSize);
 }
 
+/************************************************************************/
+/*                   GDALCopyPixelInterleavedChunk()                    */
+/*                                                                      */
+/*      Copy a window of a pixel interleaved block of nSrcBands         */
+/*      bands into the requested bands of a RasterIO() buffer.          */
+/************************************************************************/
+
+static void 
+GDALCopyPixelInterleavedChunk( const GByte *pabySrc, int nSrcBands,
+                               int nSrcLineSpace, GDALDataType eSrcType,
+                               GByte *pabyDst, GDALDataType eBufType,
+                               int nPixelSpace, int nLineSpace, int nBandSpace,
+                               int nBandCount, const int *panBandMap,
+                               int nXSize, int nYSize )
+
+{
+    int nSrcWordSize = GDALGetDataTypeSize( eSrcType ) / 8;
+    int nSrcPixelSpace = nSrcWordSize * nSrcBands;
+    int iBand, iY;
+
+/* -------------------------------------------------------------------- */
+/*      Is the buffer laid out exactly as the block?  Then copy         */
+/*      whole lines.                                                    */
+/* -------------------------------------------------------------------- */
+    int bSameLayout = (eSrcType == eBufType 
+                       && nBandCount == nSrcBands
+                       && nPixelSpace == nSrcPixelSpace
+                       && nBandSpace == nSrcWordSize);
+
+    for( iBand = 0; bSameLayout && iBand < nBandCount; iBand++ )
+    {
+        if( panBandMap[iBand] != iBand + 1 )
+            bSameLayout = FALSE;
+    }
+
+    if( bSameLayout )
+    {
+        for( iY = 0; iY < nYSize; iY++ )
+            memcpy( pabyDst + (size_t)iY * nLineSpace, 
+                    pabySrc + (size_t)iY * nSrcLineSpace,
+                    (size_t)nXSize * nSrcPixelSpace );
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Byte data to a pixel interleaved buffer: the common RGB(A)      */
+/*      case, for which we shuffle all the bands of a pixel at once.    */
+/* -------------------------------------------------------------------- */
+    if( eSrcType == GDT_Byte && eBufType == GDT_Byte && nBandSpace == 1 )
+    {
+        for( iY = 0; iY < nYSize; iY++ )
+        {
+            const GByte *pabySrcLine = pabySrc + (size_t)iY * nSrcLineSpace;
+            GByte *pabyDstLine = pabyDst + (size_t)iY * nLineSpace;
+            int iX;
+
+            if( nBandCount == 3 )
+            {
+                const GByte *pabyS0 = pabySrcLine + panBandMap[0] - 1;
+                const GByte *pabyS1 = pabySrcLine + panBandMap[1] - 1;
+                const GByte *pabyS2 = pabySrcLine + panBandMap[2] - 1;
+
+                for( iX = 0; iX < nXSize; iX++ )
+                {
+                    pabyDstLine[0] = *pabyS0;
+                    pabyDstLine[1] = *pabyS1;
+                    pabyDstLine[2] = *pabyS2;
+                    pabyS0 += nSrcBands;
+                    pabyS1 += nSrcBands;
+                    pabyS2 += nSrcBands;
+                    pabyDstLine += nPixelSpace;
+                }
+            }
+            else if( nBandCount == 4 )
+            {
+                const GByte *pabyS0 = pabySrcLine + panBandMap[0] - 1;
+                const GByte *pabyS1 = pabySrcLine + panBandMap[1] - 1;
+                const GByte *pabyS2 = pabySrcLine + panBandMap[2] - 1;
+                const GByte *pabyS3 = pabySrcLine + panBandMap[3] - 1;
+
+                for( iX = 0; iX < nXSize; iX++ )
+                {
+                    pabyDstLine[0] = *pabyS0;
+                    pabyDstLine[1] = *pabyS1;
+                    pabyDstLine[2] = *pabyS2;
+                    pabyDstLine[3] = *pabyS3;
+                    pabyS0 += nSrcBands;
+                    pabyS1 += nSrcBands;
+                    pabyS2 += nSrcBands;
+                    pabyS3 += nSrcBands;
+                    pabyDstLine += nPixelSpace;
+                }
+            }
+            else
+            {
+                for( iX = 0; iX < nXSize; iX++ )
+                {
+                    for( iBand = 0; iBand < nBandCount; iBand++ )
+                        pabyDstLine[iBand] = 
+                            pabySrcLine[panBandMap[iBand] - 1];
+                    pabySrcLine += nSrcBands;
+                    pabyDstLine += nPixelSpace;
+                }
+            }
+        }
+        return;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      General case: a strided copy (with data type conversion) of     */
+/*      each band, line by line.                                        */
+/* -------------------------------------------------------------------- */
+    for( iY = 0; iY < nYSize; iY++ )
+    {
+        for( iBand = 0; iBand < nBandCount; iBand++ )
+        {
+            GDALCopyWords( (void *) (pabySrc + (size_t)iY * nSrcLineSpace
+                                    + (panBandMap[iBand] - 1) * nSrcWordSize),
+                           eSrcType, nSrcPixelSpace,
+                           pabyDst + (size_t)iY * nLineSpace 
+                                   + (size_t)iBand * nBandSpace,
+                           eBufType, nPixelSpace, nXSize );
+        }
+    }
+}
+
 /************************************************************************/
 /*                         BlockBasedRasterIO()                         */
 /*                                                                      */
@@ -2406,6 +2611,27 @@ GDALDataset::BlockBasedRasterIO( GDALRWFlag eRWFlag,
     {
         int nChunkYSize, nChunkXSize, nChunkXOff, nChunkYOff;
 
+/* -------------------------------------------------------------------- */
+/*      When reading, the driver may be able to hand us its decoded     */
+/*      pixel interleaved blocks so that we de-interleave all the       */
+/*      bands in one pass, instead of going through the block cache     */
+/*      of each band.                                                   */
+/* -------------------------------------------------------------------- */
+        int bInterleavedRead = (eRWFlag == GF_Read && !bForceCachedIO);
+        int nDSDataSize = GDALGetDataTypeSize( eDataType ) / 8;
+
+        for( iBand = 0; bInterleavedRead && iBand < nBands; iBand++ )
+        {
+            int nThisBlockXSize, nThisBlockYSize;
+            GDALRasterBand *poBand = GetRasterBand( iBand + 1 );
+
+            poBand->GetBlockSize( &nThisBlockXSize, &nThisBlockYSize );
+            if( poBand->GetRasterDataType() != eDataType
+                || nThisBlockXSize != nBlockXSize
+                || nThisBlockYSize != nBlockYSize )
+                bInterleavedRead = FALSE;
+        }
+
         for( iBufYOff = 0; iBufYOff < nBufYSize; iBufYOff += nChunkYSize )
         {
             nChunkYSize = nBlockYSize;
@@ -2432,6 +2658,56 @@ GDALDataset::BlockBasedRasterIO( GDALRWFlag eRWFlag,
                     + iBufXOff * nPixelSpace 
                     + iBufYOff * nLineSpace;
 
+                if( bInterleavedRead )
+                {
+                    int nXBlock = nChunkXOff / nBlockXSize;
+                    int nYBlock = nChunkYOff / nBlockYSize;
+                    GByte *pabyBlock = NULL;
+
+                    /* Cached, possibly dirty, blocks take precedence */
+                    int bCached = FALSE;
+                    for( iBand = 0; !bCached && iBand < nBandCount; iBand++ )
+                    {
+                        poBlock = GetRasterBand(panBandMap[iBand])->
+                            TryGetLockedBlockRef( nXBlock, nYBlock );
+                        if( poBlock != NULL )
+                        {
+                            poBlock->DropLock();
+                            bCached = TRUE;
+                        }
+                    }
+
+                    if( !bCached )
+                    {
+                        eErr = GetPixelInterleavedBlock( nXBlock, nYBlock,
+                                                         (void **) &pabyBlock );
+                        if( eErr != CE_None )
+                            return eErr;
+                    }
+
+                    if( pabyBlock != NULL )
+                    {
+                        int nSrcLineSpace = nBlockXSize * nBands * nDSDataSize;
+
+                        GDALCopyPixelInterleavedChunk( 
+                            pabyBlock 
+                            + (nChunkYOff - nYBlock * nBlockYSize) 
+                                                        * nSrcLineSpace
+                            + (nChunkXOff - nXBlock * nBlockXSize) 
+                                                * nBands * nDSDataSize,
+                            nBands, nSrcLineSpace, eDataType,
+                            pabyChunkData, eBufType, 
+                            nPixelSpace, nLineSpace, nBandSpace,
+                            nBandCount, panBandMap,
+                            nChunkXSize, nChunkYSize );
+                        continue;
+                    }
+
+                    /* Otherwise, such as for a sparse block that the  */
+                    /* driver fills itself, this block only goes       */
+                    /* through the block cache.                        */
+                }
+
                 for( iBand = 0; iBand < nBandCount; iBand++ )
                 {
                     GDALRasterBand *poBand = GetRasterBand(panBandMap[iBand]);
@@ -2769,6 +3045,503 @@ static void GDALCopyWholeRasterGetSwathSize(GDALRasterBand *poSrcPrototypeBand,
     *pnSwathLines = nSwathLines;
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*                           GDALSwathCopier                            */
+/* ==================================================================== */
+/************************************************************************/
+
+/************************************************************************/
+/*      Copies a list of swaths from a source to a destination, either  */
+/*      whole datasets (a swath covering one band, or all bands pixel   */
+/*      interleaved) or single bands.                                   */
+/*                                                                      */
+/*      With GDAL_SWATH_BUFFERS set to more than 1, a reader thread     */
+/*      reads and converts the next swaths into spare buffers while     */
+/*      this thread writes the current one, so that decoding the        */
+/*      source and encoding the destination overlap.  As the source     */
+/*      driver must then be usable from another thread, this is not     */
+/*      the default.  Otherwise swaths are read and written in turn,    */
+/*      the next one being prefetched into the block cache if           */
+/*      GDAL_PREFETCH is set to YES, which also reads the source from   */
+/*      another thread and is not the default either.                  */
+/************************************************************************/
+
+typedef struct
+{
+    int     nBand;          /* 0 for all bands, pixel interleaved */
+    int     nXOff;
+    int     nYOff;
+    int     nXSize;
+    int     nYSize;
+    double  dfComplete;     /* progress once written */
+} GDALCopySwath;
+
+typedef struct
+{
+    CPLErr    eErrClass;
+    int       nErrNo;
+    CPLString osMsg;
+    int       iSwath;
+} GDALCopyDeferredError;
+
+class GDALSwathCopier
+{
+  public:
+    GDALDataset    *poSrcDS;
+    GDALDataset    *poDstDS;
+    GDALRasterBand *poSrcBand;
+    GDALRasterBand *poDstBand;
+    int             nBandCount;
+    GDALDataType    eDT;
+    size_t          nBufferSize;
+    std::vector<GDALCopySwath> asSwaths;
+
+                    GDALSwathCopier();
+
+    void            AddSwaths( int nBand, int nXSize, int nYSize,
+                               int nSwathCols, int nSwathLines,
+                               double dfCompleteBase, double dfCompleteScale );
+    CPLErr          Run( GDALProgressFunc pfnProgress, void *pProgressData );
+
+  private:
+    /* Pipeline state, shared with the reader thread under hMutex */
+    void           *hMutex;
+    void           *hCond;          /* signaled on any state change */
+    CPLJoinableThread *hReaderThread;
+    int             nBuffers;
+    GByte         **papabyBuffers;
+    int             nSwathsRead;
+    int             nSwathsWritten;
+    int             iSwathReading;
+    CPLErr          eReadErr;
+    int             bStop;
+    std::vector<GDALCopyDeferredError> aoErrors;
+
+    CPLErr          SwathIO( GDALRWFlag eRWFlag, const GDALCopySwath &sSwath,
+                             void *pBuffer );
+    CPLErr          RunSequential( void *pBuffer, GDALProgressFunc pfnProgress,
+                                   void *pProgressData );
+    CPLErr          RunPipelined( GDALProgressFunc pfnProgress,
+                                  void *pProgressData );
+    void            ReplayErrors( int iLastSwath );
+
+    static void     ReaderThreadMain( void *pData );
+    static void CPL_STDCALL ReaderErrorHandler( CPLErr eErrClass, int nErrNo,
+                                                const char *pszMsg );
+};
+
+/************************************************************************/
+/*                          GDALSwathCopier()                           */
+/************************************************************************/
+
+GDALSwathCopier::GDALSwathCopier()
+
+{
+    poSrcDS = poDstDS = NULL;
+    poSrcBand = poDstBand = NULL;
+    nBandCount = 0;
+    eDT = GDT_Byte;
+    nBufferSize = 0;
+
+    hMutex = NULL;
+    hCond = NULL;
+    hReaderThread = NULL;
+    nBuffers = 0;
+    papabyBuffers = NULL;
+    nSwathsRead = 0;
+    nSwathsWritten = 0;
+    iSwathReading = 0;
+    eReadErr = CE_None;
+    bStop = FALSE;
+}
+
+/************************************************************************/
+/*                             AddSwaths()                              */
+/*                                                                      */
+/*      Append the swaths covering a band (or all bands), in row        */
+/*      major order.  The progress goes from dfCompleteBase to          */
+/*      dfCompleteBase + dfCompleteScale as lines are completed.        */
+/************************************************************************/
+
+void GDALSwathCopier::AddSwaths( int nBand, int nXSize, int nYSize,
+                                 int nSwathCols, int nSwathLines,
+                                 double dfCompleteBase,
+                                 double dfCompleteScale )
+
+{
+    int iX, iY;
+
+    for( iY = 0; iY < nYSize; iY += nSwathLines )
+    {
+        for( iX = 0; iX < nXSize; iX += nSwathCols )
+        {
+            GDALCopySwath sSwath;
+
+            sSwath.nBand = nBand;
+            sSwath.nXOff = iX;
+            sSwath.nYOff = iY;
+            sSwath.nXSize = MIN(nSwathCols, nXSize - iX);
+            sSwath.nYSize = MIN(nSwathLines, nYSize - iY);
+            sSwath.dfComplete = dfCompleteBase
+                + dfCompleteScale * (iY + sSwath.nYSize) / (double) nYSize;
+            asSwaths.push_back( sSwath );
+        }
+    }
+}
+
+/************************************************************************/
+/*                              SwathIO()                               */
+/************************************************************************/
+
+CPLErr GDALSwathCopier::SwathIO( GDALRWFlag eRWFlag,
+                                 const GDALCopySwath &sSwath, void *pBuffer )
+
+{
+    if( eRWFlag == GF_Read ? poSrcBand != NULL : poDstBand != NULL )
+    {
+        GDALRasterBand *poBand = (eRWFlag == GF_Read) ? poSrcBand : poDstBand;
+
+        return poBand->RasterIO( eRWFlag, sSwath.nXOff, sSwath.nYOff,
+                                 sSwath.nXSize, sSwath.nYSize,
+                                 pBuffer, sSwath.nXSize, sSwath.nYSize,
+                                 eDT, 0, 0 );
+    }
+
+    GDALDataset *poDS = (eRWFlag == GF_Read) ? poSrcDS : poDstDS;
+    int nBand = sSwath.nBand;
+
+    return poDS->RasterIO( eRWFlag, sSwath.nXOff, sSwath.nYOff,
+                           sSwath.nXSize, sSwath.nYSize,
+                           pBuffer, sSwath.nXSize, sSwath.nYSize, eDT,
+                           (nBand > 0) ? 1 : nBandCount,
+                           (nBand > 0) ? &nBand : NULL,
+                           0, 0, 0 );
+}
+
+/************************************************************************/
+/*                                Run()                                 */
+/************************************************************************/
+
+CPLErr GDALSwathCopier::Run( GDALProgressFunc pfnProgress,
+                             void *pProgressData )
+
+{
+    GDALDataset *poSrcOwner = poSrcBand ? poSrcBand->GetDataset() : poSrcDS;
+    GDALDataset *poDstOwner = poDstBand ? poDstBand->GetDataset() : poDstDS;
+
+/* -------------------------------------------------------------------- */
+/*      The pipeline needs the source and destination to be distinct    */
+/*      datasets, and the block cache to hold the swaths read ahead     */
+/*      besides the one being written, so that reading does not evict   */
+/*      blocks that are not completely written yet.                     */
+/* -------------------------------------------------------------------- */
+    nBuffers = atoi( CPLGetConfigOption( "GDAL_SWATH_BUFFERS", "1" ) );
+    if( nBuffers > (int) asSwaths.size() )
+        nBuffers = (int) asSwaths.size();
+
+    if( nBuffers > 1
+        && (poSrcOwner == NULL || poDstOwner == NULL
+            || poSrcOwner == poDstOwner
+            || (GIntBig) nBufferSize * (nBuffers + 1) > GDALGetCacheMax64()) )
+    {
+        CPLDebug( "GDAL", "Swath copy not pipelined." );
+        nBuffers = 1;
+    }
+    if( nBuffers < 1 )
+        nBuffers = 1;
+
+    papabyBuffers = (GByte **) CPLCalloc( sizeof(GByte *), nBuffers );
+    for( int i = 0; i < nBuffers; i++ )
+    {
+        papabyBuffers[i] = (GByte *) VSIMalloc( nBufferSize );
+        if( papabyBuffers[i] == NULL )
+        {
+            if( i == 0 )
+            {
+                CPLError( CE_Failure, CPLE_OutOfMemory,
+                          "Failed to allocate " CPL_FRMT_GUIB
+                          " byte swath buffer.",
+                          (GUIntBig) nBufferSize );
+                CPLFree( papabyBuffers );
+                papabyBuffers = NULL;
+                return CE_Failure;
+            }
+
+            /* Do with the buffers we got */
+            nBuffers = i;
+            break;
+        }
+    }
+
+    CPLErr eErr;
+
+    if( nBuffers > 1 )
+        eErr = RunPipelined( pfnProgress, pProgressData );
+    else
+        eErr = RunSequential( papabyBuffers[0], pfnProgress, pProgressData );
+
+    for( int i = 0; i < nBuffers; i++ )
+        VSIFree( papabyBuffers[i] );
+    CPLFree( papabyBuffers );
+    papabyBuffers = NULL;
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                           RunSequential()                            */
+/************************************************************************/
+
+CPLErr GDALSwathCopier::RunSequential( void *pBuffer,
+                                       GDALProgressFunc pfnProgress,
+                                       void *pProgressData )
+
+{
+    CPLErr eErr = CE_None;
+    size_t iSwath;
+
+/* -------------------------------------------------------------------- */
+/*      Reading a swath can overlap with writing the previous one if    */
+/*      prefetching is enabled, unless both sides are the same          */
+/*      object, or the cache cannot hold the next source swath          */
+/*      besides the current one being written.                          */
+/* -------------------------------------------------------------------- */
+    int bPrefetch = poSrcBand == NULL && poSrcDS != poDstDS
+        && CSLTestBoolean( CPLGetConfigOption( "GDAL_PREFETCH", "NO" ) )
+        && (GIntBig) nBufferSize * 3 <= GDALGetCacheMax64();
+
+    for( iSwath = 0; iSwath < asSwaths.size() && eErr == CE_None; iSwath++ )
+    {
+        const GDALCopySwath &sSwath = asSwaths[iSwath];
+
+        eErr = SwathIO( GF_Read, sSwath, pBuffer );
+
+/* -------------------------------------------------------------------- */
+/*      Load the next swath in the background while writing this one.  */
+/* -------------------------------------------------------------------- */
+        if( eErr == CE_None && bPrefetch && iSwath + 1 < asSwaths.size() )
+        {
+            const GDALCopySwath &sNext = asSwaths[iSwath + 1];
+            int nNextBand = sNext.nBand;
+
+            poSrcDS->StartPrefetch( sNext.nXOff, sNext.nYOff,
+                                    sNext.nXSize, sNext.nYSize,
+                                    (nNextBand > 0) ? 1 : nBandCount,
+                                    (nNextBand > 0) ? &nNextBand : NULL );
+        }
+
+        if( eErr == CE_None )
+            eErr = SwathIO( GF_Write, sSwath, pBuffer );
+
+        if( eErr == CE_None
+            && !pfnProgress( sSwath.dfComplete, NULL, pProgressData ) )
+        {
+            eErr = CE_Failure;
+            CPLError( CE_Failure, CPLE_UserInterrupt,
+                      "User terminated CreateCopy()" );
+        }
+    }
+
+    if( bPrefetch )
+        poSrcDS->WaitForPrefetch( TRUE );
+
+    return eErr;
+}
+
+/************************************************************************/
+/*                         ReaderErrorHandler()                         */
+/*                                                                      */
+/*      Errors of the reader thread are kept to be reported by the      */
+/*      writing thread, in order, once it reaches the swath during      */
+/*      which they were emitted.                                        */
+/************************************************************************/
+
+void CPL_STDCALL GDALSwathCopier::ReaderErrorHandler( CPLErr eErrClass,
+                                                      int nErrNo,
+                                                      const char *pszMsg )
+
+{
+    GDALSwathCopier *poThis =
+        (GDALSwathCopier *) CPLGetErrorHandlerUserData();
+    GDALCopyDeferredError oError;
+
+    oError.eErrClass = eErrClass;
+    oError.nErrNo = nErrNo;
+    oError.osMsg = pszMsg;
+
+    CPLMutexHolderD( &(poThis->hMutex) );
+    oError.iSwath = poThis->iSwathReading;
+    poThis->aoErrors.push_back( oError );
+}
+
+/************************************************************************/
+/*                            ReplayErrors()                            */
+/*                                                                      */
+/*      Report the errors of the reader up to iLastSwath.  Must be      */
+/*      called with hMutex held.                                        */
+/************************************************************************/
+
+void GDALSwathCopier::ReplayErrors( int iLastSwath )
+
+{
+    size_t i;
+
+    for( i = 0; i < aoErrors.size() && aoErrors[i].iSwath <= iLastSwath; i++ )
+    {
+        if( aoErrors[i].eErrClass == CE_Debug )
+            CPLDebug( "GDAL", "%s", aoErrors[i].osMsg.c_str() );
+        else
+            CPLError( aoErrors[i].eErrClass, aoErrors[i].nErrNo,
+                      "%s", aoErrors[i].osMsg.c_str() );
+    }
+    aoErrors.erase( aoErrors.begin(), aoErrors.begin() + i );
+}
+
+/************************************************************************/
+/*                          ReaderThreadMain()                          */
+/************************************************************************/
+
+void GDALSwathCopier::ReaderThreadMain( void *pData )
+
+{
+    GDALSwathCopier *poThis = (GDALSwathCopier *) pData;
+
+    /* Never write blocks of the destination from this thread */
+    CPLSetTLS( CTLS_FLUSHCLEANBLOCKSONLY, (void *) poThis, FALSE );
+    CPLPushErrorHandlerEx( ReaderErrorHandler, poThis );
+
+    int nSwaths = (int) poThis->asSwaths.size();
+    int iSwath;
+
+    for( iSwath = 0; iSwath < nSwaths; iSwath++ )
+    {
+/* -------------------------------------------------------------------- */
+/*      Wait for the buffer of this swath to have been written.         */
+/* -------------------------------------------------------------------- */
+        CPLAcquireMutex( poThis->hMutex, 1000.0 );
+        poThis->iSwathReading = iSwath;
+        while( !poThis->bStop
+               && iSwath - poThis->nSwathsWritten >= poThis->nBuffers )
+            CPLCondWait( poThis->hCond, poThis->hMutex );
+        int bStop = poThis->bStop;
+        CPLReleaseMutex( poThis->hMutex );
+
+        if( bStop )
+            break;
+
+        CPLErr eErr =
+            poThis->SwathIO( GF_Read, poThis->asSwaths[iSwath],
+                             poThis->papabyBuffers[iSwath % poThis->nBuffers] );
+
+        CPLAcquireMutex( poThis->hMutex, 1000.0 );
+        if( eErr == CE_None )
+            poThis->nSwathsRead = iSwath + 1;
+        else
+            poThis->eReadErr = eErr;
+        CPLCondBroadcast( poThis->hCond );
+        CPLReleaseMutex( poThis->hMutex );
+
+        if( eErr != CE_None )
+            break;
+    }
+
+    CPLPopErrorHandler();
+    CPLSetTLS( CTLS_FLUSHCLEANBLOCKSONLY, NULL, FALSE );
+}
+
+/************************************************************************/
+/*                            RunPipelined()                            */
+/************************************************************************/
+
+CPLErr GDALSwathCopier::RunPipelined( GDALProgressFunc pfnProgress,
+                                      void *pProgressData )
+
+{
+    CPLErr eErr = CE_None;
+    int nSwaths = (int) asSwaths.size();
+    int iSwath;
+
+    CPLDebug( "GDAL", "Swath copy pipelined with %d buffers.", nBuffers );
+
+    hMutex = CPLCreateMutex();
+    CPLReleaseMutex( hMutex );
+    hCond = CPLCreateCond();
+
+    nSwathsRead = 0;
+    nSwathsWritten = 0;
+    iSwathReading = 0;
+    eReadErr = CE_None;
+    bStop = FALSE;
+
+    if( hCond != NULL )
+        hReaderThread = CPLCreateJoinableThread( ReaderThreadMain, this );
+
+    if( hReaderThread == NULL )
+    {
+        CPLDestroyCond( hCond );
+        CPLDestroyMutex( hMutex );
+        hCond = hMutex = NULL;
+        return RunSequential( papabyBuffers[0], pfnProgress, pProgressData );
+    }
+
+    for( iSwath = 0; iSwath < nSwaths && eErr == CE_None; iSwath++ )
+    {
+/* -------------------------------------------------------------------- */
+/*      Wait for the reader to be done with this swath.                 */
+/* -------------------------------------------------------------------- */
+        CPLAcquireMutex( hMutex, 1000.0 );
+        while( nSwathsRead <= iSwath && eReadErr == CE_None )
+            CPLCondWait( hCond, hMutex );
+        ReplayErrors( iSwath );
+        if( nSwathsRead <= iSwath )
+            eErr = eReadErr;
+        CPLReleaseMutex( hMutex );
+
+        if( eErr != CE_None )
+            break;
+
+/* -------------------------------------------------------------------- */
+/*      Write it, and hand its buffer back to the reader.               */
+/* -------------------------------------------------------------------- */
+        const GDALCopySwath &sSwath = asSwaths[iSwath];
+
+        eErr = SwathIO( GF_Write, sSwath,
+                        papabyBuffers[iSwath % nBuffers] );
+
+        CPLAcquireMutex( hMutex, 1000.0 );
+        nSwathsWritten = iSwath + 1;
+        CPLCondBroadcast( hCond );
+        CPLReleaseMutex( hMutex );
+
+        if( eErr == CE_None
+            && !pfnProgress( sSwath.dfComplete, NULL, pProgressData ) )
+        {
+            eErr = CE_Failure;
+            CPLError( CE_Failure, CPLE_UserInterrupt,
+                      "User terminated CreateCopy()" );
+        }
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Stop the reader and wait for it.                                */
+/* -------------------------------------------------------------------- */
+    CPLAcquireMutex( hMutex, 1000.0 );
+    bStop = TRUE;
+    CPLCondBroadcast( hCond );
+    CPLReleaseMutex( hMutex );
+
+    CPLJoinThread( hReaderThread );
+    hReaderThread = NULL;
+
+    aoErrors.clear();
+    CPLDestroyCond( hCond );
+    CPLDestroyMutex( hMutex );
+    hCond = hMutex = NULL;
+
+    return eErr;
+}
+
 /************************************************************************/
 /*                     GDALDatasetCopyWholeRaster()                     */
 /************************************************************************/
@@ -2791,6 +3564,18 @@ static void GDALCopyWholeRasterGetSwathSize(GDALRasterBand *poSrcPrototypeBand,
  * on target dataset block sizes to achieve best compression.  More options may be supported in
  * the future.  
  *
+ * Reading and writing can overlap: with the GDAL_SWATH_BUFFERS
+ * configuration option set to 2 (double buffering) or more, a worker
+ * thread reads the next swaths, converted to the destination data type,
+ * into spare buffers while a swath is written.  The source is then read
+ * from another thread, so this must only be enabled with drivers that
+ * allow it.  By default (1) swaths are read and written in turn.  The
+ * pipeline is only used if the block cache can hold one more swath than
+ * there are buffers.  With a single buffer, and the GDAL_PREFETCH
+ * configuration option set to YES, the next swath is loaded into the block
+ * cache while a swath is written (see GDALDataset::StartPrefetch()), which
+ * also reads the source from another thread.
+ *
  * @param hSrcDS the source dataset
  * @param hDstDS the destination dataset
  * @param papszOptions transfer hints in "StringList" Name=Value format.
@@ -2810,7 +3595,6 @@ CPLErr CPL_STDCALL GDALDatasetCopyWholeRaster(
 
     GDALDataset *poSrcDS = (GDALDataset *) hSrcDS;
     GDALDataset *poDstDS = (GDALDataset *) hDstDS;
-    CPLErr eErr = CE_None;
 
     if( pfnProgress == NULL )
         pfnProgress = GDALDummyProgress;
@@ -2897,125 +3681,38 @@ CPLErr CPL_STDCALL GDALDatasetCopyWholeRaster(
     if( bInterleave)
         nPixelSize *= nBandCount;
 
-    void *pSwathBuf = VSIMalloc3(nSwathCols, nSwathLines, nPixelSize );
-    if( pSwathBuf == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                "Failed to allocate %d*%d*%d byte swath buffer in\n"
-                "GDALDatasetCopyWholeRaster()",
-                nSwathCols, nSwathLines, nPixelSize );
-        return CE_Failure;
-    }
-
     CPLDebug( "GDAL", 
             "GDALDatasetCopyWholeRaster(): %d*%d swaths, bInterleave=%d", 
             nSwathCols, nSwathLines, bInterleave );
 
-/* ==================================================================== */
-/*      Band oriented (uninterleaved) case.                             */
-/* ==================================================================== */
-    if( !bInterleave )
-    {
-        int iBand, iX, iY;
-
-        for( iBand = 0; iBand < nBandCount && eErr == CE_None; iBand++ )
-        {
-            int nBand = iBand+1;
-
-            for( iY = 0; iY < nYSize && eErr == CE_None; iY += nSwathLines )
-            {
-                int nThisLines = nSwathLines;
-
-                if( iY + nThisLines > nYSize )
-                    nThisLines = nYSize - iY;
+/* -------------------------------------------------------------------- */
+/*      List the swaths: band by band in the band oriented              */
+/*      (uninterleaved) case, or all bands at once in the pixel         */
+/*      interleaved case, and copy them.                                */
+/* -------------------------------------------------------------------- */
+    GDALSwathCopier oCopier;
 
-                for( iX = 0; iX < nXSize && eErr == CE_None; iX += nSwathCols )
-                {
-                    int nThisCols = nSwathCols;
-
-                    if( iX + nThisCols > nXSize )
-                        nThisCols = nXSize - iX;
-
-                    eErr = poSrcDS->RasterIO( GF_Read, 
-                                            iX, iY, nThisCols, nThisLines,
-                                            pSwathBuf, nThisCols, nThisLines, 
-                                            eDT, 1, &nBand, 
-                                            0, 0, 0 );
-
-                    if( eErr == CE_None )
-                        eErr = poDstDS->RasterIO( GF_Write, 
-                                                iX, iY, nThisCols, nThisLines,
-                                                pSwathBuf, nThisCols, nThisLines, 
-                                                eDT, 1, &nBand,
-                                                0, 0, 0 );
-
-                    if( eErr == CE_None 
-                        && !pfnProgress( 
-                            iBand / (float)nBandCount
-                            + (iY+nThisLines) / (float) (nYSize*nBandCount),
-                            NULL, pProgressData ) )
-                    {
-                        eErr = CE_Failure;
-                        CPLError( CE_Failure, CPLE_UserInterrupt, 
-                                "User terminated CreateCopy()" );
-                    }
-                }
-            }
-        }
-    }
+    oCopier.poSrcDS = poSrcDS;
+    oCopier.poDstDS = poDstDS;
+    oCopier.nBandCount = nBandCount;
+    oCopier.eDT = eDT;
+    oCopier.nBufferSize = (size_t) nSwathCols * nSwathLines * nPixelSize;
 
-/* ==================================================================== */
-/*      Pixel interleaved case.                                         */
-/* ==================================================================== */
-    else /* if( bInterleave ) */
+    if( !bInterleave )
     {
-        int iY, iX;
-
-        for( iY = 0; iY < nYSize && eErr == CE_None; iY += nSwathLines )
-        {
-            int nThisLines = nSwathLines;
-
-            if( iY + nThisLines > nYSize )
-                nThisLines = nYSize - iY;
+        int iBand;
 
-            for( iX = 0; iX < nXSize && eErr == CE_None; iX += nSwathCols )
-            {
-                int nThisCols = nSwathCols;
-
-                if( iX + nThisCols > nXSize )
-                    nThisCols = nXSize - iX;
-
-                eErr = poSrcDS->RasterIO( GF_Read, 
-                                        iX, iY, nThisCols, nThisLines,
-                                        pSwathBuf, nThisCols, nThisLines, 
-                                        eDT, nBandCount, NULL, 
-                                        0, 0, 0 );
-
-                if( eErr == CE_None )
-                    eErr = poDstDS->RasterIO( GF_Write, 
-                                            iX, iY, nThisCols, nThisLines,
-                                            pSwathBuf, nThisCols, nThisLines, 
-                                            eDT, nBandCount, NULL, 
-                                            0, 0, 0 );
-
-                if( eErr == CE_None 
-                    && !pfnProgress( (iY+nThisLines) / (float) nYSize,
-                                    NULL, pProgressData ) )
-                {
-                    eErr = CE_Failure;
-                    CPLError( CE_Failure, CPLE_UserInterrupt, 
-                            "User terminated CreateCopy()" );
-                }
-            }
-        }
+        for( iBand = 0; iBand < nBandCount; iBand++ )
+            oCopier.AddSwaths( iBand + 1, nXSize, nYSize,
+                               nSwathCols, nSwathLines,
+                               iBand / (double) nBandCount,
+                               1.0 / nBandCount );
     }
+    else
+        oCopier.AddSwaths( 0, nXSize, nYSize, nSwathCols, nSwathLines,
+                           0.0, 1.0 );
 
-/* -------------------------------------------------------------------- */
-/*      Cleanup                                                         */
-/* -------------------------------------------------------------------- */
-    CPLFree( pSwathBuf );
-
-    return eErr;
+    return oCopier.Run( pfnProgress, pProgressData );
 }
 
 
@@ -3038,6 +3735,9 @@ CPLErr CPL_STDCALL GDALDatasetCopyWholeRaster(
  * force alignment on target dataset block sizes to achieve best compression.
  * More options may be supported in the future.
  *
+ * Reading and writing can overlap in the same way as in
+ * GDALDatasetCopyWholeRaster(), when the bands belong to different datasets.
+ *
  * @param hSrcBand the source band
  * @param hDstBand the destination band
  * @param papszOptions transfer hints in "StringList" Name=Value format.
@@ -3057,7 +3757,6 @@ CPLErr CPL_STDCALL GDALRasterBandCopyWholeRaster(
 
     GDALRasterBand *poSrcBand = (GDALRasterBand *) hSrcBand;
     GDALRasterBand *poDstBand = (GDALRasterBand *) hDstBand;
-    CPLErr eErr = CE_None;
 
     if( pfnProgress == NULL )
         pfnProgress = GDALDummyProgress;
@@ -3109,67 +3808,18 @@ CPLErr CPL_STDCALL GDALRasterBandCopyWholeRaster(
 
     int nPixelSize = (GDALGetDataTypeSize(eDT) / 8);
 
-    void *pSwathBuf = VSIMalloc3(nSwathCols, nSwathLines, nPixelSize );
-    if( pSwathBuf == NULL )
-    {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                "Failed to allocate %d*%d*%d byte swath buffer in\n"
-                "GDALRasterBandCopyWholeRaster()",
-                nSwathCols, nSwathLines, nPixelSize );
-        return CE_Failure;
-    }
-
     CPLDebug( "GDAL",
             "GDALRasterBandCopyWholeRaster(): %d*%d swaths",
             nSwathCols, nSwathLines );
 
-/* ==================================================================== */
-/*      Band oriented (uninterleaved) case.                             */
-/* ==================================================================== */
-
-    int iX, iY;
-
-    for( iY = 0; iY < nYSize && eErr == CE_None; iY += nSwathLines )
-    {
-        int nThisLines = nSwathLines;
+    GDALSwathCopier oCopier;
 
-        if( iY + nThisLines > nYSize )
-            nThisLines = nYSize - iY;
+    oCopier.poSrcBand = poSrcBand;
+    oCopier.poDstBand = poDstBand;
+    oCopier.nBandCount = 1;
+    oCopier.eDT = eDT;
+    oCopier.nBufferSize = (size_t) nSwathCols * nSwathLines * nPixelSize;
+    oCopier.AddSwaths( 1, nXSize, nYSize, nSwathCols, nSwathLines, 0.0, 1.0 );
 
-        for( iX = 0; iX < nXSize && eErr == CE_None; iX += nSwathCols )
-        {
-            int nThisCols = nSwathCols;
-
-            if( iX + nThisCols > nXSize )
-                nThisCols = nXSize - iX;
-
-            eErr = poSrcBand->RasterIO( GF_Read,
-                                    iX, iY, nThisCols, nThisLines,
-                                    pSwathBuf, nThisCols, nThisLines,
-                                    eDT, 0, 0 );
-
-            if( eErr == CE_None )
-                eErr = poDstBand->RasterIO( GF_Write,
-                                        iX, iY, nThisCols, nThisLines,
-                                        pSwathBuf, nThisCols, nThisLines,
-                                        eDT, 0, 0 );
-
-            if( eErr == CE_None
-                && !pfnProgress(
-                    (iY+nThisLines) / (float) (nYSize),
-                    NULL, pProgressData ) )
-            {
-                eErr = CE_Failure;
-                CPLError( CE_Failure, CPLE_UserInterrupt,
-                        "User terminated CreateCopy()" );
-            }
-        }
-    }
-
-/* -------------------------------------------------------------------- */
-/*      Cleanup                                                         */
-/* -------------------------------------------------------------------- */
-    CPLFree( pSwathBuf );
-
-    return eErr;
+    return oCopier.Run( pfnProgress, pProgressData );
 }
@@ -390,6 +390,91 @@ int CPLCreateThread( CPLThreadFunc pfnMain, void *pArg )
     return -1;
 }
 
+/************************************************************************/
+/*                      CPLCreateJoinableThread()                       */
+/************************************************************************/
+
+CPLJoinableThread* CPLCreateJoinableThread( CPLThreadFunc pfnMain,
+                                            void *pThreadArg )
+
+{
+    CPLDebug( "CPLCreateJoinableThread", "Fails to dummy implementation" );
+
+    return NULL;
+}
+
+/************************************************************************/
+/*                           CPLJoinThread()                            */
+/************************************************************************/
+
+void CPLJoinThread( CPLJoinableThread* hJoinableThread )
+
+{
+}
+
+/************************************************************************/
+/*                           CPLCreateCond()                            */
+/*                                                                      */
+/*      There is no other thread to wait for, so conditions are         */
+/*      never waited on.                                                */
+/************************************************************************/
+
+void *CPLCreateCond()
+
+{
+    return NULL;
+}
+
+/************************************************************************/
+/*                            CPLCondWait()                             */
+/************************************************************************/
+
+void CPLCondWait( void *hCond, void* hMutex )
+
+{
+}
+
+/************************************************************************/
+/*                          CPLCondTimedWait()                          */
+/*                                                                      */
+/*      Returns TRUE if the condition was signaled before the           */
+/*      timeout, as far as the caller can tell.                         */
+/************************************************************************/
+
+static int CPLCondTimedWait( void *hCond, void* hMutex,
+                             double dfWaitInSeconds )
+
+{
+    return FALSE;
+}
+
+/************************************************************************/
+/*                           CPLCondSignal()                            */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+}
+
+/************************************************************************/
+/*                           CPLDestroyCond()                           */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+}
+
 /************************************************************************/
 /*                              CPLSleep()                              */
 /************************************************************************/
@@ -683,6 +768,222 @@ int CPLCreateThread( CPLThreadFunc pfnMain, void *pThreadArg )
     return nThreadId;
 }
 
+/************************************************************************/
+/*                      CPLCreateJoinableThread()                       */
+/************************************************************************/
+
+struct _CPLJoinableThread
+{
+    HANDLE hThread;
+};
+
+CPLJoinableThread* CPLCreateJoinableThread( CPLThreadFunc pfnMain,
+                                            void *pThreadArg )
+
+{
+    DWORD  nThreadId;
+    CPLStdCallThreadInfo *psInfo;
+    CPLJoinableThread *psJoinableThread;
+
+    psInfo = (CPLStdCallThreadInfo*) CPLCalloc(sizeof(CPLStdCallThreadInfo),1);
+    psInfo->pAppData = pThreadArg;
+    psInfo->pfnMain = pfnMain;
+
+    psJoinableThread = (CPLJoinableThread *)
+        CPLCalloc(sizeof(CPLJoinableThread),1);
+    psJoinableThread->hThread = CreateThread( NULL, 0, CPLStdCallThreadJacket,
+                                              psInfo, 0, &nThreadId );
+
+    if( psJoinableThread->hThread == NULL )
+    {
+        CPLFree( psInfo );
+        CPLFree( psJoinableThread );
+        return NULL;
+    }
+
+    return psJoinableThread;
+}
+
+/************************************************************************/
+/*                           CPLJoinThread()                            */
+/************************************************************************/
+
+void CPLJoinThread( CPLJoinableThread* hJoinableThread )
+
+{
+    if( hJoinableThread == NULL )
+        return;
+
+    WaitForSingleObject( hJoinableThread->hThread, INFINITE );
+    CloseHandle( hJoinableThread->hThread );
+    CPLFree( hJoinableThread );
+}
+
+/************************************************************************/
+/*                           CPLCreateCond()                            */
+/*                                                                      */
+/*      Conditions are emulated with one auto-reset event per           */
+/*      waiting thread, kept in a list of waiters.                      */
+/************************************************************************/
+
+typedef struct _CPLWaiterItem
+{
+    HANDLE hEvent;
+    struct _CPLWaiterItem* psNext;
+} CPLWaiterItem;
+
+typedef struct
+{
+    void          *hInternalMutex;
+    CPLWaiterItem *psWaiterList;
+} CPLWin32Cond;
+
+void *CPLCreateCond()
+
+{
+    CPLWin32Cond* psCond = (CPLWin32Cond*) CPLCalloc(sizeof(CPLWin32Cond),1);
+
+    psCond->hInternalMutex = CPLCreateMutex();
+    if( psCond->hInternalMutex == NULL )
+    {
+        CPLFree( psCond );
+        return NULL;
+    }
+    CPLReleaseMutex( psCond->hInternalMutex );
+
+    return psCond;
+}
+
+/************************************************************************/
+/*                            CPLCondWait()                             */
+/************************************************************************/
+
+static int CPLCondWaitInternal( void *hCond, void* hClientMutex,
+                                DWORD nMilliseconds )
+
+{
+    CPLWin32Cond* psCond = (CPLWin32Cond*) hCond;
+    HANDLE hEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+    CPLWaiterItem* psItem;
+    int bSignaled = TRUE;
+
+    if( hEvent == NULL )
+        return FALSE;
+
+    psItem = (CPLWaiterItem*) CPLMalloc(sizeof(CPLWaiterItem));
+    psItem->hEvent = hEvent;
+
+    CPLAcquireMutex( psCond->hInternalMutex, 1000.0 );
+    psItem->psNext = psCond->psWaiterList;
+    psCond->psWaiterList = psItem;
+    CPLReleaseMutex( psCond->hInternalMutex );
+
+    /* The event is auto-reset, so a signal sent between the release */
+    /* of the client mutex and the wait is not lost. */
+    CPLReleaseMutex( hClientMutex );
+    if( WaitForSingleObject( hEvent, nMilliseconds ) != WAIT_OBJECT_0 )
+    {
+        /* Unless a signal came in the meantime, the item is still in */
+        /* the list and must be removed. */
+        CPLWaiterItem** ppsLink = &(psCond->psWaiterList);
+
+        CPLAcquireMutex( psCond->hInternalMutex, 1000.0 );
+        while( *ppsLink != NULL && *ppsLink != psItem )
+            ppsLink = &((*ppsLink)->psNext);
+        if( *ppsLink != NULL )
+        {
+            *ppsLink = psItem->psNext;
+            CPLFree( psItem );
+            bSignaled = FALSE;
+        }
+        CPLReleaseMutex( psCond->hInternalMutex );
+    }
+    CPLAcquireMutex( hClientMutex, 1000.0 );
+
+    /* Otherwise the item has been freed by the thread that signaled us */
+    CloseHandle( hEvent );
+
+    return bSignaled;
+}
+
+void CPLCondWait( void *hCond, void* hClientMutex )
+
+{
+    CPLCondWaitInternal( hCond, hClientMutex, INFINITE );
+}
+
+/************************************************************************/
+/*                          CPLCondTimedWait()                          */
+/*                                                                      */
+/*      Returns TRUE if the condition was signaled before the           */
+/*      timeout.                                                        */
+/************************************************************************/
+
+static int CPLCondTimedWait( void *hCond, void* hClientMutex,
+                             double dfWaitInSeconds )
+
+{
+    return CPLCondWaitInternal( hCond, hClientMutex,
+                                (DWORD) (dfWaitInSeconds * 1000.0) );
+}
+
+/************************************************************************/
+/*                           CPLCondSignal()                            */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+    CPLWin32Cond* psCond = (CPLWin32Cond*) hCond;
+    CPLWaiterItem* psItem;
+
+    CPLAcquireMutex( psCond->hInternalMutex, 1000.0 );
+    psItem = psCond->psWaiterList;
+    if( psItem != NULL )
+    {
+        psCond->psWaiterList = psItem->psNext;
+        SetEvent( psItem->hEvent );
+        CPLFree( psItem );
+    }
+    CPLReleaseMutex( psCond->hInternalMutex );
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+    CPLWin32Cond* psCond = (CPLWin32Cond*) hCond;
+    CPLWaiterItem* psItem;
+
+    CPLAcquireMutex( psCond->hInternalMutex, 1000.0 );
+    while( (psItem = psCond->psWaiterList) != NULL )
+    {
+        psCond->psWaiterList = psItem->psNext;
+        SetEvent( psItem->hEvent );
+        CPLFree( psItem );
+    }
+    CPLReleaseMutex( psCond->hInternalMutex );
+}
+
+/************************************************************************/
+/*                           CPLDestroyCond()                           */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+    CPLWin32Cond* psCond = (CPLWin32Cond*) hCond;
+
+    if( psCond == NULL )
+        return;
+
+    CPLDestroyMutex( psCond->hInternalMutex );
+    CPLFree( psCond );
+}
+
 /************************************************************************/
 /*                              CPLSleep()                              */
 /************************************************************************/
@@ -757,6 +1058,7 @@ void CPLCleanupTLS()
 
 #include <pthread.h>
 #include <time.h>
+#include <sys/time.h>
 
   /************************************************************************/
   /* ==================================================================== */
@@ -854,8 +1156,15 @@ int CPLAcquireMutex( void *hMutexIn, double dfWaitInSeconds )
 {
     int err;
 
-    /* we need to add timeout support */
-    err =  pthread_mutex_lock( (pthread_mutex_t *) hMutexIn );
+    /* we need to add timeout support, only the no wait case is handled */
+    if( dfWaitInSeconds == 0.0 )
+    {
+        err = pthread_mutex_trylock( (pthread_mutex_t *) hMutexIn );
+        if( err == EBUSY )
+            return FALSE;
+    }
+    else
+        err = pthread_mutex_lock( (pthread_mutex_t *) hMutexIn );
     
     if( err != 0 )
     {
@@ -1024,6 +1333,144 @@ int CPLCreateThread( CPLThreadFunc pfnMain, void *pThreadArg )
     return 1; /* can we return the actual thread pid? */
 }
 
+/************************************************************************/
+/*                      CPLCreateJoinableThread()                       */
+/************************************************************************/
+
+struct _CPLJoinableThread
+{
+    pthread_t hThread;
+};
+
+CPLJoinableThread* CPLCreateJoinableThread( CPLThreadFunc pfnMain,
+                                            void *pThreadArg )
+
+{
+    CPLStdCallThreadInfo *psInfo;
+    CPLJoinableThread *psJoinableThread;
+
+    psInfo = (CPLStdCallThreadInfo*) CPLCalloc(sizeof(CPLStdCallThreadInfo),1);
+    psInfo->pAppData = pThreadArg;
+    psInfo->pfnMain = pfnMain;
+
+    psJoinableThread = (CPLJoinableThread *)
+        CPLCalloc(sizeof(CPLJoinableThread),1);
+
+    if( pthread_create( &(psJoinableThread->hThread), NULL,
+                        CPLStdCallThreadJacket, (void *) psInfo ) != 0 )
+    {
+        CPLFree( psInfo );
+        CPLFree( psJoinableThread );
+        return NULL;
+    }
+
+    return psJoinableThread;
+}
+
+/************************************************************************/
+/*                           CPLJoinThread()                            */
+/************************************************************************/
+
+void CPLJoinThread( CPLJoinableThread* hJoinableThread )
+
+{
+    if( hJoinableThread == NULL )
+        return;
+
+    pthread_join( hJoinableThread->hThread, NULL );
+    CPLFree( hJoinableThread );
+}
+
+/************************************************************************/
+/*                           CPLCreateCond()                            */
+/************************************************************************/
+
+void *CPLCreateCond()
+
+{
+    pthread_cond_t* pCond =
+        (pthread_cond_t* ) malloc(sizeof(pthread_cond_t));
+
+    if( pCond != NULL && pthread_cond_init( pCond, NULL ) != 0 )
+    {
+        free( pCond );
+        pCond = NULL;
+    }
+
+    return pCond;
+}
+
+/************************************************************************/
+/*                            CPLCondWait()                             */
+/*                                                                      */
+/*      The mutex must be held exactly once by the calling thread.      */
+/************************************************************************/
+
+void CPLCondWait( void *hCond, void* hMutex )
+
+{
+    pthread_cond_wait( (pthread_cond_t *) hCond, (pthread_mutex_t *) hMutex );
+}
+
+/************************************************************************/
+/*                          CPLCondTimedWait()                          */
+/*                                                                      */
+/*      Returns TRUE if the condition was signaled, or the wait         */
+/*      spuriously interrupted, before the timeout.                     */
+/************************************************************************/
+
+static int CPLCondTimedWait( void *hCond, void* hMutex,
+                             double dfWaitInSeconds )
+
+{
+    struct timeval  sNow;
+    struct timespec sDeadline;
+    double          dfDeadline;
+
+    gettimeofday( &sNow, NULL );
+    dfDeadline = sNow.tv_sec + sNow.tv_usec / 1000000.0 + dfWaitInSeconds;
+    sDeadline.tv_sec = (time_t) floor(dfDeadline);
+    sDeadline.tv_nsec = (long) ((dfDeadline - sDeadline.tv_sec) * 1000000000);
+
+    return pthread_cond_timedwait( (pthread_cond_t *) hCond,
+                                   (pthread_mutex_t *) hMutex,
+                                   &sDeadline ) == 0;
+}
+
+/************************************************************************/
+/*                           CPLCondSignal()                            */
+/************************************************************************/
+
+void CPLCondSignal( void *hCond )
+
+{
+    pthread_cond_signal( (pthread_cond_t *) hCond );
+}
+
+/************************************************************************/
+/*                          CPLCondBroadcast()                          */
+/************************************************************************/
+
+void CPLCondBroadcast( void *hCond )
+
+{
+    pthread_cond_broadcast( (pthread_cond_t *) hCond );
+}
+
+/************************************************************************/
+/*                           CPLDestroyCond()                           */
+/************************************************************************/
+
+void CPLDestroyCond( void *hCond )
+
+{
+    if( hCond == NULL )
+        return;
+
+    pthread_cond_destroy( (pthread_cond_t *) hCond );
+    free( hCond );
+}
+
 /************************************************************************/
 /*                              CPLSleep()                              */
 /************************************************************************/
@@ -1143,3 +1590,320 @@ void CPLSetTLSWithFreeFunc( int nIndex, void *pData, CPLTLSFreeFunc pfnFree )
     papTLSList[nIndex] = pData;
     papTLSList[CTLS_MAX + nIndex] = (void*) pfnFree;
 }
+
+/************************************************************************/
+/* ==================================================================== */
+/*                             CPLRunJobs()                             */
+/*                                                                      */
+/*      Implementation independent pool of worker threads, on top of    */
+/*      the primitives above.                                           */
+/* ==================================================================== */
+/************************************************************************/
+
+#define CPL_MAX_JOB_THREADS   64
+#define CPL_JOB_THREAD_IDLE_TIME  10.0   /* seconds before an idle worker exits */
+
+typedef struct
+{
+    CPLErr  eErrClass;
+    int     nErrNo;
+    char   *pszMsg;
+} CPLJobError;
+
+typedef struct _CPLJobBatch
+{
+    CPLJobFunc   pfnJob;
+    void       **papJobData;
+    int          nJobs;
+    int          iNextJob;      /* first job not started yet */
+    int          nJobsDone;
+    CPLErr       eErr;          /* worst error of the finished jobs */
+
+    int          nErrors;
+    CPLJobError *pasErrors;     /* errors emitted by the pool threads */
+
+    void        *hDoneCond;     /* signaled when the last job is done */
+
+    struct _CPLJobBatch *psNext;
+} CPLJobBatch;
+
+static void        *hJobMutex = NULL;
+static void        *hJobCond = NULL;           /* signaled on new jobs */
+static CPLJobBatch *psPendingBatches = NULL;   /* with jobs not started */
+static int          nJobThreads = 0;
+static int          nIdleJobThreads = 0;
+static int          nMaxJobThreads = CPL_MAX_JOB_THREADS;
+
+/************************************************************************/
+/*                          CPLTakeNextJob()                            */
+/*                                                                      */
+/*      Must be called with hJobMutex held.                             */
+/************************************************************************/
+
+static int CPLTakeNextJob( CPLJobBatch *psBatch )
+
+{
+    int iJob = psBatch->iNextJob++;
+
+    if( psBatch->iNextJob == psBatch->nJobs )
+    {
+        CPLJobBatch **ppsLink = &psPendingBatches;
+
+        while( *ppsLink != psBatch )
+            ppsLink = &((*ppsLink)->psNext);
+        *ppsLink = psBatch->psNext;
+    }
+
+    return iJob;
+}
+
+/************************************************************************/
+/*                            CPLJobDone()                              */
+/*                                                                      */
+/*      Must be called with hJobMutex held.                             */
+/************************************************************************/
+
+static void CPLJobDone( CPLJobBatch *psBatch, CPLErr eErr )
+
+{
+    if( eErr > psBatch->eErr )
+        psBatch->eErr = eErr;
+
+    if( ++psBatch->nJobsDone == psBatch->nJobs )
+        CPLCondSignal( psBatch->hDoneCond );
+}
+
+/************************************************************************/
+/*                         CPLJobErrorHandler()                         */
+/*                                                                      */
+/*      Keep the errors of the pool threads, so that they are           */
+/*      reported by the thread that submitted the jobs.                 */
+/************************************************************************/
+
+static void CPL_STDCALL CPLJobErrorHandler( CPLErr eErrClass, int nErrNo,
+                                            const char *pszMsg )
+
+{
+    CPLJobBatch *psBatch = (CPLJobBatch *) CPLGetErrorHandlerUserData();
+    CPLJobError *psError;
+
+    CPLAcquireMutex( hJobMutex, 1000.0 );
+    psBatch->pasErrors = (CPLJobError *)
+        CPLRealloc( psBatch->pasErrors,
+                    sizeof(CPLJobError) * (psBatch->nErrors + 1) );
+    psError = psBatch->pasErrors + psBatch->nErrors++;
+    psError->eErrClass = eErrClass;
+    psError->nErrNo = nErrNo;
+    psError->pszMsg = CPLStrdup( pszMsg );
+    CPLReleaseMutex( hJobMutex );
+}
+
+/************************************************************************/
+/*                        CPLGetMaxJobThreads()                         */
+/*                                                                      */
+/*      The number of worker threads of the pool is limited by          */
+/*      GDAL_NUM_THREADS, less the calling thread which runs jobs too,  */
+/*      and by CPL_MAX_JOB_THREADS.                                     */
+/************************************************************************/
+
+static int CPLGetMaxJobThreads()
+
+{
+    const char *pszNumThreads = CPLGetConfigOption( "GDAL_NUM_THREADS", NULL );
+    int nMaxThreads;
+
+    if( pszNumThreads == NULL )
+        return CPL_MAX_JOB_THREADS;
+
+    nMaxThreads = atoi( pszNumThreads ) - 1;
+    if( nMaxThreads < 0 )
+        nMaxThreads = 0;
+    else if( nMaxThreads > CPL_MAX_JOB_THREADS )
+        nMaxThreads = CPL_MAX_JOB_THREADS;
+
+    return nMaxThreads;
+}
+
+/************************************************************************/
+/*                          CPLJobThreadMain()                          */
+/*                                                                      */
+/*      Run the pending jobs, and exit after staying idle for           */
+/*      CPL_JOB_THREAD_IDLE_TIME, or when the pool has more workers     */
+/*      than allowed by the last call to CPLRunJobs().                  */
+/************************************************************************/
+
+static void CPLJobThreadMain( void * )
+
+{
+    CPLAcquireMutex( hJobMutex, 1000.0 );
+
+    while( TRUE )
+    {
+        int bSignaled = TRUE;
+
+        while( psPendingBatches == NULL && bSignaled
+               && nJobThreads <= nMaxJobThreads )
+        {
+            nIdleJobThreads++;
+            bSignaled = CPLCondTimedWait( hJobCond, hJobMutex,
+                                          CPL_JOB_THREAD_IDLE_TIME );
+            nIdleJobThreads--;
+        }
+
+        if( psPendingBatches == NULL || nJobThreads > nMaxJobThreads )
+        {
+            nJobThreads--;
+            CPLReleaseMutex( hJobMutex );
+            return;
+        }
+
+        CPLJobBatch *psBatch = psPendingBatches;
+        int iJob = CPLTakeNextJob( psBatch );
+        CPLReleaseMutex( hJobMutex );
+
+        CPLPushErrorHandlerEx( CPLJobErrorHandler, psBatch );
+        CPLErr eErr = psBatch->pfnJob( psBatch->papJobData[iJob] );
+        CPLPopErrorHandler();
+
+        CPLAcquireMutex( hJobMutex, 1000.0 );
+        CPLJobDone( psBatch, eErr );
+    }
+}
+
+/************************************************************************/
+/*                             CPLRunJobs()                             */
+/************************************************************************/
+
+/**
+ * Run jobs concurrently and wait for them.
+ *
+ * pfnJob is called once for each of the nJobs entries of papJobData,
+ * by the calling thread and by a pool of worker threads kept from a call
+ * to the next one.  The first job is always run by the calling thread,
+ * which then runs the jobs that no worker has taken, so all the jobs are
+ * run even if no thread can be created, and jobs may themselves call
+ * CPLRunJobs().  The errors emitted by the jobs
+ * run in the worker threads are reported by the calling thread before
+ * returning.
+ *
+ * The pool is shared by all the callers, and has at most GDAL_NUM_THREADS
+ * minus one worker threads if this configuration option is set, and 64
+ * otherwise, as read by the last call.  Workers idle for 10 seconds, or
+ * above that limit, exit.  With the stub
+ * implementation the jobs are run one after the other by the calling
+ * thread.
+ *
+ * @param pfnJob the function running one job.
+ * @param papJobData the nJobs arguments of pfnJob.
+ * @param nJobs the number of jobs.
+ *
+ * @return the most severe of the errors returned by the jobs.
+ *
+ * @since GDAL 1.10
+ */
+
+CPLErr CPLRunJobs( CPLJobFunc pfnJob, void **papJobData, int nJobs )
+
+{
+    CPLJobBatch sBatch;
+    CPLErr eErr;
+    int i;
+
+    if( nJobs <= 0 )
+        return CE_None;
+    if( nJobs == 1 )
+        return pfnJob( papJobData[0] );
+
+    memset( &sBatch, 0, sizeof(sBatch) );
+    sBatch.pfnJob = pfnJob;
+    sBatch.papJobData = papJobData;
+    sBatch.nJobs = nJobs;
+    sBatch.eErr = CE_None;
+    sBatch.hDoneCond = CPLCreateCond();
+
+    CPLCreateOrAcquireMutex( &hJobMutex, 1000.0 );
+    if( hJobCond == NULL )
+        hJobCond = CPLCreateCond();
+
+/* -------------------------------------------------------------------- */
+/*      Without conditions (stub implementation), run the jobs one      */
+/*      after the other.                                                */
+/* -------------------------------------------------------------------- */
+    if( hJobCond == NULL || sBatch.hDoneCond == NULL )
+    {
+        CPLReleaseMutex( hJobMutex );
+        CPLDestroyCond( sBatch.hDoneCond );
+
+        for( i = 0; i < nJobs; i++ )
+        {
+            eErr = pfnJob( papJobData[i] );
+            if( eErr > sBatch.eErr )
+                sBatch.eErr = eErr;
+        }
+        return sBatch.eErr;
+    }
+
+/* -------------------------------------------------------------------- */
+/*      Queue the jobs, and make sure that enough workers wait for      */
+/*      them.  If a thread cannot be created, this thread runs the      */
+/*      jobs itself.                                                    */
+/* -------------------------------------------------------------------- */
+    sBatch.iNextJob = 1;
+    sBatch.psNext = psPendingBatches;
+    psPendingBatches = &sBatch;
+
+    nMaxJobThreads = CPLGetMaxJobThreads();
+
+    for( i = nIdleJobThreads; i < nJobs - 1
+             && nJobThreads < nMaxJobThreads; i++ )
+    {
+        if( CPLCreateThread( CPLJobThreadMain, NULL ) == -1 )
+            break;
+        nJobThreads++;
+    }
+    CPLCondBroadcast( hJobCond );
+
+/* -------------------------------------------------------------------- */
+/*      Run the first job, then the ones not taken by a worker yet.     */
+/* -------------------------------------------------------------------- */
+    CPLReleaseMutex( hJobMutex );
+    eErr = pfnJob( papJobData[0] );
+    CPLAcquireMutex( hJobMutex, 1000.0 );
+    CPLJobDone( &sBatch, eErr );
+
+    while( sBatch.iNextJob < nJobs )
+    {
+        int iJob = CPLTakeNextJob( &sBatch );
+        CPLReleaseMutex( hJobMutex );
+
+        eErr = pfnJob( papJobData[iJob] );
+
+        CPLAcquireMutex( hJobMutex, 1000.0 );
+        CPLJobDone( &sBatch, eErr );
+    }
+
+    while( sBatch.nJobsDone < nJobs )
+        CPLCondWait( sBatch.hDoneCond, hJobMutex );
+
+    CPLReleaseMutex( hJobMutex );
+
+    CPLDestroyCond( sBatch.hDoneCond );
+
+/* -------------------------------------------------------------------- */
+/*      Report the errors of the workers.                               */
+/* -------------------------------------------------------------------- */
+    for( i = 0; i < sBatch.nErrors; i++ )
+    {
+        CPLJobError *psError = sBatch.pasErrors + i;
+
+        if( psError->eErrClass == CE_Debug )
+            CPLDebug( "CPL", "%s", psError->pszMsg );
+        else
+            CPLError( psError->eErrClass, psError->nErrNo,
+                      "%s", psError->pszMsg );
+        CPLFree( psError->pszMsg );
+    }
+    CPLFree( sBatch.pasErrors );
+
+    return sBatch.eErr;
+}
@@ -31,6 +31,7 @@
 #define _CPL_MULTIPROC_H_INCLUDED_
 
 #include "cpl_port.h"
+#include "cpl_error.h"
 
 /*
 ** There are three primary implementations of the multi-process support
@@ -55,16 +56,57 @@ typedef void (*CPLThreadFunc)(void *);
 void CPL_DLL *CPLLockFile( const char *pszPath, double dfWaitInSeconds );
 void  CPL_DLL CPLUnlockFile( void *hLock );
 
+/*
+** Mutexes are recursive, and CPLCreateMutex() returns the new mutex
+** acquired by the calling thread.  The timeout of CPLAcquireMutex() is
+** only fully honoured by the win32 implementation: the pthread one waits
+** without limit, except that since GDAL 1.10 a timeout of 0.0 only tries
+** to acquire the mutex and returns FALSE at once if another thread holds
+** it, as the win32 implementation always did.
+*/
+
 void CPL_DLL *CPLCreateMutex();
 int   CPL_DLL CPLCreateOrAcquireMutex( void **, double dfWaitInSeconds );
 int   CPL_DLL CPLAcquireMutex( void *hMutex, double dfWaitInSeconds );
 void  CPL_DLL CPLReleaseMutex( void *hMutex );
 void  CPL_DLL CPLDestroyMutex( void *hMutex );
 
+/*
+** Condition variables (since GDAL 1.10).  CPLCondWait() must be called
+** with the mutex held exactly once by the calling thread, as it is
+** released while waiting.  CPLCreateCond() returns NULL with the stub
+** implementation, where there is no other thread to wait for.
+*/
+
+void CPL_DLL *CPLCreateCond();
+void  CPL_DLL CPLCondWait( void *hCond, void *hMutex );
+void  CPL_DLL CPLCondSignal( void *hCond );
+void  CPL_DLL CPLCondBroadcast( void *hCond );
+void  CPL_DLL CPLDestroyCond( void *hCond );
+
 GIntBig CPL_DLL CPLGetPID();
 int   CPL_DLL CPLCreateThread( CPLThreadFunc pfnMain, void *pArg );
 void  CPL_DLL CPLSleep( double dfWaitInSeconds );
 
+/*
+** Threads that can be waited for with CPLJoinThread(), which frees the
+** handle (since GDAL 1.10).  CPLCreateJoinableThread() returns NULL if
+** the thread cannot be created.
+*/
+
+typedef struct _CPLJoinableThread CPLJoinableThread;
+CPLJoinableThread CPL_DLL *CPLCreateJoinableThread( CPLThreadFunc pfnMain,
+                                                    void *pArg );
+void  CPL_DLL CPLJoinThread( CPLJoinableThread *hJoinableThread );
+
+/*
+** Concurrent jobs run by a pool of worker threads (since GDAL 1.10), see
+** CPLRunJobs() in cpl_multiproc.cpp.
+*/
+
+typedef CPLErr (*CPLJobFunc)( void *pJobData );
+CPLErr CPL_DLL CPLRunJobs( CPLJobFunc pfnJob, void **papJobData, int nJobs );
+
 const char CPL_DLL *CPLGetThreadingModel();
 
 CPL_C_END
@@ -108,6 +150,8 @@ class CPL_DLL CPLMutexHolder
 #define CTLS_VERSIONINFO_LICENCE       13         /* gdal_misc.cpp */
 #define CTLS_CONFIGOPTIONS             14         /* cpl_conv.cpp */
 #define CTLS_FINDFILE                  15         /* cpl_findfile.cpp */
+#define CTLS_PROXYPOOLOPENING          16         /* gdalproxypool.cpp */
+#define CTLS_FLUSHCLEANBLOCKSONLY      17         /* gdalrasterblock.cpp */
 
 #define CTLS_MAX                       32         
 
@@ -220,6 +220,11 @@ void CPL_DLL VSIInstallSparseFileHandler(void);
 void VSIInstallTarFileHandler(void); /* No reason to export that */
 void CPL_DLL VSICleanupFileManager(void);
 
+void CPL_DLL VSIGetSharedCacheStatistics( GUIntBig *pnHits, GUIntBig *pnMisses,
+                                          GUIntBig *pnBytesUsed,
+                                          GUIntBig *pnBytesMax );
+void CPL_DLL VSICleanupSharedCache(void);
+
 VSILFILE CPL_DLL *VSIFileFromMemBuffer( const char *pszFilename,
                                     GByte *pabyData, 
                                     vsi_l_offset nDataLength,
@@ -186,6 +186,8 @@ public:
 };
 
 VSIVirtualHandle* VSICreateBufferedReaderHandle(VSIVirtualHandle* poBaseHandle);
-VSIVirtualHandle* VSICreateCachedFile( VSIVirtualHandle* poBaseHandle );
+VSIVirtualHandle* VSICreateCachedFile( VSIVirtualHandle* poBaseHandle,
+                                       const char* pszFilename = NULL );
+void VSIInvalidateSharedCache( const char* pszFilename );
 
 #endif /* ndef CPL_VSI_VIRTUAL_H_INCLUDED */
@@ -784,4 +784,6 @@ void VSICleanupFileManager()
         delete poManager;
         poManager = NULL;
     }
+
+    VSICleanupSharedCache();
 }
@@ -28,6 +28,7 @@
  ****************************************************************************/
 
 #include "cpl_vsi_virtual.h"
+#include "cpl_multiproc.h"
 
 CPL_CVSID("$Id$");
 
@@ -58,6 +59,321 @@ public:
     GByte          abyData[CHUNK_SIZE];
 };
 
+/************************************************************************/
+/* ==================================================================== */
+/*                          VSISharedChunkCache                         */
+/* ==================================================================== */
+/*                                                                      */
+/*      Process wide cache of file chunks, keyed by filename, file      */
+/*      size and chunk index.  It is used by VSICachedFile handles      */
+/*      created with a filename when VSI_CACHE_SHARED is enabled, so    */
+/*      that several handles on the same file (possibly in different    */
+/*      threads) share the data already read.                           */
+/************************************************************************/
+
+class VSISharedChunkKey
+{
+public:
+    CPLString      osFilename;
+    vsi_l_offset   nFileSize;
+    size_t         iBlock;
+
+    VSISharedChunkKey( const CPLString& osFilenameIn,
+                       vsi_l_offset nFileSizeIn, size_t iBlockIn ) :
+        osFilename(osFilenameIn), nFileSize(nFileSizeIn), iBlock(iBlockIn) {}
+
+    bool operator< (const VSISharedChunkKey& oOther) const
+    {
+        if( iBlock != oOther.iBlock )
+            return iBlock < oOther.iBlock;
+        if( nFileSize != oOther.nFileSize )
+            return nFileSize < oOther.nFileSize;
+        return osFilename < oOther.osFilename;
+    }
+};
+
+class VSISharedChunk
+{
+public:
+    VSISharedChunk( const VSISharedChunkKey& oKeyIn ) : oKey(oKeyIn)
+    {
+        poLRUPrev = poLRUNext = NULL;
+        nDataFilled = 0;
+    }
+
+    VSISharedChunkKey oKey;
+
+    VSISharedChunk *poLRUPrev;   /* towards most recently used */
+    VSISharedChunk *poLRUNext;   /* towards least recently used */
+
+    size_t         nDataFilled;
+    GByte          abyData[CHUNK_SIZE];
+};
+
+class VSISharedChunkCache
+{
+    void          *hMutex;
+
+    std::map<VSISharedChunkKey, VSISharedChunk*> oMapChunks;
+
+    VSISharedChunk *poMRU;
+    VSISharedChunk *poLRU;
+
+    GUIntBig       nCacheUsed;
+    GUIntBig       nCacheMax;
+
+    GUIntBig       nHits;
+    GUIntBig       nMisses;
+
+    void           Unlink( VSISharedChunk *poChunk );
+    void           PushFront( VSISharedChunk *poChunk );
+    void           Remove( VSISharedChunk *poChunk );
+
+public:
+                   VSISharedChunkCache();
+                  ~VSISharedChunkCache();
+
+    int            Fetch( const VSISharedChunkKey& oKey,
+                          size_t nOffsetInChunk, size_t nLength,
+                          GByte *pabyDest, size_t *pnCopied );
+    int            Contains( const VSISharedChunkKey& oKey );
+    void           Insert( const VSISharedChunkKey& oKey,
+                           const GByte *pabyData, size_t nDataFilled );
+    void           Invalidate( const char *pszFilename );
+
+    void           GetStatistics( GUIntBig *pnHits, GUIntBig *pnMisses,
+                                  GUIntBig *pnBytesUsed,
+                                  GUIntBig *pnBytesMax );
+};
+
+static void *hSharedCacheMutex = NULL;
+static VSISharedChunkCache *poSharedCache = NULL;
+
+/************************************************************************/
+/*                        VSIGetSharedCache()                           */
+/************************************************************************/
+
+static VSISharedChunkCache *VSIGetSharedCache()
+
+{
+    CPLMutexHolderD( &hSharedCacheMutex );
+
+    if( poSharedCache == NULL )
+        poSharedCache = new VSISharedChunkCache();
+
+    return poSharedCache;
+}
+
+/************************************************************************/
+/*                        VSISharedChunkCache()                         */
+/************************************************************************/
+
+VSISharedChunkCache::VSISharedChunkCache()
+
+{
+    hMutex = NULL;
+    poMRU = NULL;
+    poLRU = NULL;
+    nCacheUsed = 0;
+    nCacheMax = CPLScanUIntBig(
+        CPLGetConfigOption( "VSI_SHARED_CACHE_SIZE", "25000000" ), 40 );
+    nHits = 0;
+    nMisses = 0;
+}
+
+/************************************************************************/
+/*                       ~VSISharedChunkCache()                         */
+/************************************************************************/
+
+VSISharedChunkCache::~VSISharedChunkCache()
+
+{
+    std::map<VSISharedChunkKey, VSISharedChunk*>::iterator oIter;
+    for( oIter = oMapChunks.begin(); oIter != oMapChunks.end(); ++oIter )
+        delete oIter->second;
+
+    if( hMutex != NULL )
+        CPLDestroyMutex( hMutex );
+}
+
+/************************************************************************/
+/*                               Unlink()                               */
+/*                                                                      */
+/*      Detach the chunk from the LRU list.  Caller holds the mutex.    */
+/************************************************************************/
+
+void VSISharedChunkCache::Unlink( VSISharedChunk *poChunk )
+
+{
+    if( poChunk->poLRUPrev != NULL )
+        poChunk->poLRUPrev->poLRUNext = poChunk->poLRUNext;
+    else
+        poMRU = poChunk->poLRUNext;
+
+    if( poChunk->poLRUNext != NULL )
+        poChunk->poLRUNext->poLRUPrev = poChunk->poLRUPrev;
+    else
+        poLRU = poChunk->poLRUPrev;
+
+    poChunk->poLRUPrev = poChunk->poLRUNext = NULL;
+}
+
+/************************************************************************/
+/*                             PushFront()                              */
+/************************************************************************/
+
+void VSISharedChunkCache::PushFront( VSISharedChunk *poChunk )
+
+{
+    poChunk->poLRUPrev = NULL;
+    poChunk->poLRUNext = poMRU;
+    if( poMRU != NULL )
+        poMRU->poLRUPrev = poChunk;
+    poMRU = poChunk;
+    if( poLRU == NULL )
+        poLRU = poChunk;
+}
+
+/************************************************************************/
+/*                               Remove()                               */
+/************************************************************************/
+
+void VSISharedChunkCache::Remove( VSISharedChunk *poChunk )
+
+{
+    Unlink( poChunk );
+    oMapChunks.erase( poChunk->oKey );
+    nCacheUsed -= poChunk->nDataFilled;
+    delete poChunk;
+}
+
+/************************************************************************/
+/*                               Fetch()                                */
+/*                                                                      */
+/*      Copy nLength bytes starting at nOffsetInChunk of the chunk      */
+/*      into pabyDest if the chunk is cached.  The number of bytes      */
+/*      actually copied, which might be less than requested at the      */
+/*      end of file, is returned in *pnCopied.                          */
+/************************************************************************/
+
+int VSISharedChunkCache::Fetch( const VSISharedChunkKey& oKey,
+                                size_t nOffsetInChunk, size_t nLength,
+                                GByte *pabyDest, size_t *pnCopied )
+
+{
+    CPLMutexHolderD( &hMutex );
+
+    std::map<VSISharedChunkKey, VSISharedChunk*>::iterator oIter =
+        oMapChunks.find( oKey );
+    if( oIter == oMapChunks.end() )
+    {
+        nMisses++;
+        return FALSE;
+    }
+
+    nHits++;
+
+    VSISharedChunk *poChunk = oIter->second;
+    if( poMRU != poChunk )
+    {
+        Unlink( poChunk );
+        PushFront( poChunk );
+    }
+
+    size_t nCopied = 0;
+    if( nOffsetInChunk < poChunk->nDataFilled )
+    {
+        nCopied = poChunk->nDataFilled - nOffsetInChunk;
+        if( nCopied > nLength )
+            nCopied = nLength;
+        memcpy( pabyDest, poChunk->abyData + nOffsetInChunk, nCopied );
+    }
+    *pnCopied = nCopied;
+
+    return TRUE;
+}
+
+/************************************************************************/
+/*                              Contains()                              */
+/************************************************************************/
+
+int VSISharedChunkCache::Contains( const VSISharedChunkKey& oKey )
+
+{
+    CPLMutexHolderD( &hMutex );
+
+    return oMapChunks.find( oKey ) != oMapChunks.end();
+}
+
+/************************************************************************/
+/*                               Insert()                               */
+/************************************************************************/
+
+void VSISharedChunkCache::Insert( const VSISharedChunkKey& oKey,
+                                  const GByte *pabyData, size_t nDataFilled )
+
+{
+    CPLMutexHolderD( &hMutex );
+
+    /* Another handle might have loaded the same chunk in the meantime */
+    if( oMapChunks.find( oKey ) != oMapChunks.end() )
+        return;
+
+    VSISharedChunk *poChunk = new VSISharedChunk( oKey );
+    poChunk->nDataFilled = nDataFilled;
+    memcpy( poChunk->abyData, pabyData, nDataFilled );
+
+    oMapChunks[oKey] = poChunk;
+    PushFront( poChunk );
+    nCacheUsed += nDataFilled;
+
+    while( nCacheUsed > nCacheMax && poLRU != NULL && poLRU != poChunk )
+        Remove( poLRU );
+}
+
+/************************************************************************/
+/*                             Invalidate()                             */
+/*                                                                      */
+/*      Drop all the chunks of a file, or of all files if NULL.         */
+/************************************************************************/
+
+void VSISharedChunkCache::Invalidate( const char *pszFilename )
+
+{
+    CPLMutexHolderD( &hMutex );
+
+    VSISharedChunk *poChunk = poMRU;
+    while( poChunk != NULL )
+    {
+        VSISharedChunk *poNext = poChunk->poLRUNext;
+        if( pszFilename == NULL
+            || strcmp(poChunk->oKey.osFilename, pszFilename) == 0 )
+            Remove( poChunk );
+        poChunk = poNext;
+    }
+}
+
+/************************************************************************/
+/*                           GetStatistics()                            */
+/************************************************************************/
+
+void VSISharedChunkCache::GetStatistics( GUIntBig *pnHits, GUIntBig *pnMisses,
+                                         GUIntBig *pnBytesUsed,
+                                         GUIntBig *pnBytesMax )
+
+{
+    CPLMutexHolderD( &hMutex );
+
+    if( pnHits )
+        *pnHits = nHits;
+    if( pnMisses )
+        *pnMisses = nMisses;
+    if( pnBytesUsed )
+        *pnBytesUsed = nCacheUsed;
+    if( pnBytesMax )
+        *pnBytesMax = nCacheMax;
+}
+
 /************************************************************************/
 /* ==================================================================== */
 /*                             VSICachedFile                            */
@@ -67,7 +383,7 @@ public:
 class VSICachedFile : public VSIVirtualHandle
 { 
   public:
-    VSICachedFile( VSIVirtualHandle * );
+    VSICachedFile( VSIVirtualHandle *, const char *pszFilename = NULL );
     ~VSICachedFile() { Close(); }
 
     void          FlushLRU();
@@ -75,7 +391,13 @@ class VSICachedFile : public VSIVirtualHandle
                               void *pBuffer, size_t nBufferSize );
     void          Demote( VSICacheChunk * );
 
+    size_t        ReadShared( void *pBuffer, size_t nToRead );
+
     VSIVirtualHandle *poBase;
+
+    /* Non NULL when chunks are stored in the process wide shared cache */
+    VSISharedChunkCache *poShared;
+    CPLString     osFilename;
     
     vsi_l_offset  nOffset;
     vsi_l_offset  nFileSize;
@@ -101,11 +423,19 @@ class VSICachedFile : public VSIVirtualHandle
 /*                           VSICachedFile()                            */
 /************************************************************************/
 
-VSICachedFile::VSICachedFile( VSIVirtualHandle *poBaseHandle )
+VSICachedFile::VSICachedFile( VSIVirtualHandle *poBaseHandle,
+                              const char *pszFilename )
 
 {
     poBase = poBaseHandle;
 
+    poShared = NULL;
+    if( pszFilename != NULL )
+    {
+        poShared = VSIGetSharedCache();
+        osFilename = pszFilename;
+    }
+
     nCacheUsed = 0;
     nCacheMax = CPLScanUIntBig( 
         CPLGetConfigOption( "VSI_CACHE_SIZE", "25000000" ), 40 );
@@ -361,6 +691,9 @@ size_t VSICachedFile::Read( void * pBuffer, size_t nSize, size_t nCount )
     if( nOffset >= nFileSize )
         return 0;
 
+    if( poShared != NULL )
+        return ReadShared( pBuffer, nSize * nCount ) / nSize;
+
 /* ==================================================================== */
 /*      Make sure the cache is loaded for the whole request region.     */
 /* ==================================================================== */
@@ -421,6 +754,89 @@ size_t VSICachedFile::Read( void * pBuffer, size_t nSize, size_t nCount )
     return nAmountCopied / nSize;
 }
 
+/************************************************************************/
+/*                             ReadShared()                             */
+/*                                                                      */
+/*      Read through the process wide shared cache.  Runs of chunks     */
+/*      missing from the cache are read in one go from the base         */
+/*      handle, and then published to the shared cache.                 */
+/************************************************************************/
+
+size_t VSICachedFile::ReadShared( void * pBuffer, size_t nToRead )
+
+{
+    GByte *pabyBuffer = (GByte *) pBuffer;
+    size_t nAmountCopied = 0;
+
+    while( nAmountCopied < nToRead && nOffset + nAmountCopied < nFileSize )
+    {
+        vsi_l_offset nCurOffset = nOffset + nAmountCopied;
+        size_t iBlock = (size_t) (nCurOffset / CHUNK_SIZE);
+        size_t nOffsetInChunk = (size_t) (nCurOffset - iBlock * (vsi_l_offset)CHUNK_SIZE);
+        size_t nThisCopy = 0;
+
+        if( poShared->Fetch( VSISharedChunkKey(osFilename, nFileSize, iBlock),
+                             nOffsetInChunk, nToRead - nAmountCopied,
+                             pabyBuffer + nAmountCopied, &nThisCopy ) )
+        {
+            if( nThisCopy == 0 )
+                break;
+            nAmountCopied += nThisCopy;
+            continue;
+        }
+
+/* -------------------------------------------------------------------- */
+/*      Cache miss: load this chunk and the following missing ones      */
+/*      needed by the request.                                          */
+/* -------------------------------------------------------------------- */
+        size_t nEndBlock = (size_t) ((nOffset + nToRead - 1) / CHUNK_SIZE);
+        size_t nBlockCount = 1;
+        while( iBlock + nBlockCount <= nEndBlock
+               && !poShared->Contains( VSISharedChunkKey(osFilename, nFileSize,
+                                                         iBlock + nBlockCount) ) )
+            nBlockCount++;
+
+        GByte *pabyWorkBuffer = (GByte *)
+            VSIMalloc( nBlockCount * CHUNK_SIZE );
+        if( pabyWorkBuffer == NULL )
+            break;
+
+        size_t nDataRead = 0;
+        if( poBase->Seek( iBlock * (vsi_l_offset)CHUNK_SIZE, SEEK_SET ) == 0 )
+            nDataRead = poBase->Read( pabyWorkBuffer, 1,
+                                      nBlockCount * CHUNK_SIZE );
+
+        for( size_t i = 0; i * CHUNK_SIZE < nDataRead; i++ )
+        {
+            size_t nFilled = nDataRead - i * CHUNK_SIZE;
+            if( nFilled > CHUNK_SIZE )
+                nFilled = CHUNK_SIZE;
+            poShared->Insert( VSISharedChunkKey(osFilename, nFileSize,
+                                                iBlock + i),
+                              pabyWorkBuffer + i * CHUNK_SIZE, nFilled );
+        }
+
+        if( nOffsetInChunk < nDataRead )
+        {
+            nThisCopy = nDataRead - nOffsetInChunk;
+            if( nThisCopy > nToRead - nAmountCopied )
+                nThisCopy = nToRead - nAmountCopied;
+            memcpy( pabyBuffer + nAmountCopied,
+                    pabyWorkBuffer + nOffsetInChunk, nThisCopy );
+        }
+
+        CPLFree( pabyWorkBuffer );
+
+        if( nThisCopy == 0 )
+            break;
+        nAmountCopied += nThisCopy;
+    }
+
+    nOffset += nAmountCopied;
+
+    return nAmountCopied;
+}
+
 /************************************************************************/
 /*                               Write()                                */
 /************************************************************************/
@@ -459,8 +875,88 @@ int VSICachedFile::Flush()
 /************************************************************************/
 
 VSIVirtualHandle *
-VSICreateCachedFile( VSIVirtualHandle *poBaseHandle )
+VSICreateCachedFile( VSIVirtualHandle *poBaseHandle, const char *pszFilename )
 
 {
-    return new VSICachedFile( poBaseHandle );
+    if( pszFilename != NULL
+        && !CSLTestBoolean( CPLGetConfigOption( "VSI_CACHE_SHARED", "FALSE" ) ) )
+        pszFilename = NULL;
+
+    return new VSICachedFile( poBaseHandle, pszFilename );
+}
+
+/************************************************************************/
+/*                      VSIInvalidateSharedCache()                      */
+/************************************************************************/
+
+/**
+ * \brief Discard shared cache content for a file.
+ *
+ * Filesystem handlers opting into the shared cache must call this when
+ * a file is opened for update, removed or renamed.
+ *
+ * @param pszFilename the filename, or NULL to discard the whole cache.
+ */
+
+void VSIInvalidateSharedCache( const char *pszFilename )
+
+{
+    CPLMutexHolderD( &hSharedCacheMutex );
+
+    if( poSharedCache != NULL )
+        poSharedCache->Invalidate( pszFilename );
+}
+
+/************************************************************************/
+/*                    VSIGetSharedCacheStatistics()                     */
+/************************************************************************/
+
+/**
+ * \brief Fetch statistics on the shared VSI chunk cache.
+ *
+ * The shared cache is used when both the VSI_CACHE and VSI_CACHE_SHARED
+ * configuration options are set to TRUE.  Its size is controlled by the
+ * VSI_SHARED_CACHE_SIZE configuration option (in bytes, 25 000 000 by
+ * default).  Hits and misses are counted per chunk lookup.
+ *
+ * Any of the output pointers may be NULL.
+ *
+ * @param pnHits number of chunk lookups satisfied from the cache.
+ * @param pnMisses number of chunk lookups that required reading the file.
+ * @param pnBytesUsed number of bytes currently held in the cache.
+ * @param pnBytesMax maximum number of bytes held in the cache.
+ *
+ * @since GDAL 1.10
+ */
+
+void VSIGetSharedCacheStatistics( GUIntBig *pnHits, GUIntBig *pnMisses,
+                                  GUIntBig *pnBytesUsed, GUIntBig *pnBytesMax )
+
+{
+    VSIGetSharedCache()->GetStatistics( pnHits, pnMisses,
+                                        pnBytesUsed, pnBytesMax );
+}
+
+/************************************************************************/
+/*                        VSICleanupSharedCache()                       */
+/************************************************************************/
+
+/**
+ * \brief Release the shared VSI chunk cache.
+ *
+ * All cached chunks are freed and the statistics are reset.  The
+ * VSI_SHARED_CACHE_SIZE configuration option will be read again on next
+ * use.  This must not be called while handles using the shared cache are
+ * still open.
+ *
+ * @since GDAL 1.10
+ */
+
+void VSICleanupSharedCache()
+
+{
+    CPLMutexHolderD( &hSharedCacheMutex );
+
+    delete poSharedCache;
+    poSharedCache = NULL;
 }
@@ -400,10 +400,12 @@ VSIUnixStdioFilesystemHandler::Open( const char *pszFilename,
     if( (EQUAL(pszAccess,"r") || EQUAL(pszAccess,"rb"))
         && CSLTestBoolean( CPLGetConfigOption( "VSI_CACHE", "FALSE" ) ) )
     {
-        return VSICreateCachedFile( poHandle );
+        return VSICreateCachedFile( poHandle, pszFilename );
     }
     else
     {
+        if( !EQUAL(pszAccess,"r") && !EQUAL(pszAccess,"rb") )
+            VSIInvalidateSharedCache( pszFilename );
         return poHandle;
     }
 }
@@ -427,6 +429,7 @@ int VSIUnixStdioFilesystemHandler::Stat( const char * pszFilename,
 int VSIUnixStdioFilesystemHandler::Unlink( const char * pszFilename )
 
 {
+    VSIInvalidateSharedCache( pszFilename );
     return unlink( pszFilename );
 }
 
@@ -438,6 +441,8 @@ int VSIUnixStdioFilesystemHandler::Rename( const char *oldpath,
                                            const char *newpath )
 
 {
+    VSIInvalidateSharedCache( oldpath );
+    VSIInvalidateSharedCache( newpath );
     return rename( oldpath, newpath );
 }
 
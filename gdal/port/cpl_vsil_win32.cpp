@@ -442,10 +442,12 @@ VSIVirtualHandle *VSIWin32FilesystemHandler::Open( const char *pszFilename,
     if( (EQUAL(pszAccess,"r") || EQUAL(pszAccess,"rb"))
         && CSLTestBoolean( CPLGetConfigOption( "VSI_CACHE", "FALSE" ) ) )
     {
-        return VSICreateCachedFile( poHandle );
+        return VSICreateCachedFile( poHandle, pszFilename );
     }
     else
     {
+        if( !EQUAL(pszAccess,"r") && !EQUAL(pszAccess,"rb") )
+            VSIInvalidateSharedCache( pszFilename );
         return poHandle;
     }
 }
@@ -489,6 +491,8 @@ int VSIWin32FilesystemHandler::Stat( const char * pszFilename,
 int VSIWin32FilesystemHandler::Unlink( const char * pszFilename )
 
 {
+    VSIInvalidateSharedCache( pszFilename );
+
 #if (defined(WIN32) && _MSC_VER >= 1310) || __MSVCRT_VERSION__ >= 0x0601
     if( CSLTestBoolean(
             CPLGetConfigOption( "GDAL_FILENAME_IS_UTF8", "YES" ) ) )
@@ -516,6 +520,9 @@ int VSIWin32FilesystemHandler::Rename( const char *oldpath,
                                            const char *newpath )
 
 {
+    VSIInvalidateSharedCache( oldpath );
+    VSIInvalidateSharedCache( newpath );
+
 #if (defined(WIN32) && _MSC_VER >= 1310) || __MSVCRT_VERSION__ >= 0x0601
     if( CSLTestBoolean(
             CPLGetConfigOption( "GDAL_FILENAME_IS_UTF8", "YES" ) ) )
@@ -77,6 +77,10 @@ while i < len(argv):
     elif arg == '-q' or arg == '-quiet':
         quiet_flag = 1
         
+    elif arg == '-o':
+        i = i + 1
+        options.append(argv[i])
+
     elif arg == '-nomask':
         mask = 'none'
         
@@ -43,7 +43,8 @@ gdal_proximity.py srcfile dstfile [-srcband n] [-dstband n]
                   [-of format] [-co name=value]*
                   [-ot Byte/Int16/Int32/Float32/etc]
                   [-values n,n,n] [-distunits PIXEL/GEO]
-                  [-maxdist n] [-nodata n] [-fixed-buf-val n] [-q] """)
+                  [-maxdist n] [-nodata n] [-fixed-buf-val n]
+                  [-exact] [-num_threads n] [-q] """)
     sys.exit(1)
 
 # =============================================================================
@@ -102,6 +103,13 @@ while i < len(argv):
         i = i + 1
         options.append( 'FIXED_BUF_VAL=' + argv[i] )
 
+    elif arg == '-exact':
+        options.append( 'ALGORITHM=EXACT' )
+
+    elif arg == '-num_threads':
+        i = i + 1
+        options.append( 'NUM_THREADS=' + argv[i] )
+
     elif arg == '-srcband':
         i = i + 1
         src_band_n = int(argv[i])
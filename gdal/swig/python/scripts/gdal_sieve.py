@@ -86,6 +86,10 @@ while i < len(argv):
         i = i + 1
         threshold = int(argv[i])
         
+    elif arg == '-o':
+        i = i + 1
+        options.append(argv[i])
+
     elif arg == '-nomask':
         mask = 'none'
         
@@ -177,7 +181,7 @@ else:
     prog_func = gdal.TermProgress
     
 result = gdal.SieveFilter( srcband, maskband, dstband,
-                           threshold, connectedness, 
+                           threshold, connectedness, options,
                            callback = prog_func )
     
 src_ds = None